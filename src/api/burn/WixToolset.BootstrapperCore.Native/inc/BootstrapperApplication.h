@@ -1558,3 +1558,21 @@ extern "C" typedef HRESULT(WINAPI *PFN_BOOTSTRAPPER_APPLICATION_CREATE)(
     __in const BOOTSTRAPPER_CREATE_ARGS* pArgs,
     __inout BOOTSTRAPPER_CREATE_RESULTS* pResults
     );
+
+struct BOOTSTRAPPER_PREPARE_ARGS
+{
+    DWORD cbSize;
+    BOOTSTRAPPER_COMMAND* pCommand;
+};
+
+struct BOOTSTRAPPER_PREPARE_RESULTS
+{
+    DWORD cbSize;
+};
+
+// Optional export called as soon as the BA payloads are extracted, before BootstrapperApplicationCreate.
+// The engine is not available yet; the BA may only start background work that Create later waits on.
+extern "C" typedef HRESULT(WINAPI *PFN_BOOTSTRAPPER_APPLICATION_PREPARE)(
+    __in const BOOTSTRAPPER_PREPARE_ARGS* pArgs,
+    __inout BOOTSTRAPPER_PREPARE_RESULTS* pResults
+    );
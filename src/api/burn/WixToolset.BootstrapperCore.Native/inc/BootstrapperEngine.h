@@ -111,6 +111,8 @@ enum BOOTSTRAPPER_ENGINE_MESSAGE
     BOOTSTRAPPER_ENGINE_MESSAGE_LAUNCHAPPROVEDEXE,
     BOOTSTRAPPER_ENGINE_MESSAGE_SETUPDATESOURCE,
     BOOTSTRAPPER_ENGINE_MESSAGE_COMPAREVERSIONS,
+    BOOTSTRAPPER_ENGINE_MESSAGE_GETVARIABLES,
+    BOOTSTRAPPER_ENGINE_MESSAGE_SETVARIABLES,
 };
 
 typedef struct _BAENGINE_APPLY_ARGS
@@ -232,6 +234,25 @@ typedef struct _BAENGINE_GETVARIABLENUMERIC_RESULTS
     LONGLONG llValue;
 } BAENGINE_GETVARIABLENUMERIC_RESULTS;
 
+typedef struct _BAENGINE_GETVARIABLES_ARGS
+{
+    DWORD cbSize;
+    DWORD cVariables;
+    const LPCWSTR* rgwzVariables;
+} BAENGINE_GETVARIABLES_ARGS;
+
+typedef struct _BAENGINE_GETVARIABLES_RESULTS
+{
+    DWORD cbSize;
+    // Receives the values as null-terminated strings packed one after the other, in the order of rgwzVariables.
+    // Variables that do not exist receive an empty string.
+    LPWSTR wzValues;
+    // Should be initialized to the size of wzValues.
+    SIZE_T cchValues;
+    // Should point to cVariables HRESULTs, which receive S_OK or E_NOTFOUND for each variable.
+    HRESULT* rghrVariables;
+} BAENGINE_GETVARIABLES_RESULTS;
+
 typedef struct _BAENGINE_GETVARIABLESTRING_ARGS
 {
     DWORD cbSize;
@@ -402,6 +423,21 @@ typedef struct _BAENGINE_SETVARIABLENUMERIC_RESULTS
     DWORD cbSize;
 } BAENGINE_SETVARIABLENUMERIC_RESULTS;
 
+typedef struct _BAENGINE_SETVARIABLES_ARGS
+{
+    DWORD cbSize;
+    DWORD cVariables;
+    const LPCWSTR* rgwzVariables;
+    // A NULL value clears the variable.
+    const LPCWSTR* rgwzValues;
+    BOOL fFormatted;
+} BAENGINE_SETVARIABLES_ARGS;
+
+typedef struct _BAENGINE_SETVARIABLES_RESULTS
+{
+    DWORD cbSize;
+} BAENGINE_SETVARIABLES_RESULTS;
+
 typedef struct _BAENGINE_SETVARIABLESTRING_ARGS
 {
     DWORD cbSize;
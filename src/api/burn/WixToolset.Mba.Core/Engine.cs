@@ -195,6 +195,52 @@ namespace WixToolset.Mba.Core
             }
         }
 
+        /// <inheritdoc/>
+        public string[] GetVariableStrings(string[] names)
+        {
+            var values = new string[names.Length];
+            if (names.Length == 0)
+            {
+                return values;
+            }
+
+            var results = new int[names.Length];
+            var cchValues = new IntPtr(names.Length * 80);
+            var pValues = IntPtr.Zero;
+            try
+            {
+                int ret;
+                do
+                {
+                    Marshal.FreeCoTaskMem(pValues);
+                    pValues = Marshal.AllocCoTaskMem(cchValues.ToInt32() * UnicodeEncoding.CharSize);
+
+                    ret = this.engine.GetVariables(names.Length, names, pValues, ref cchValues, results);
+                } while (NativeMethods.E_MOREDATA == ret);
+
+                if (ret != NativeMethods.S_OK)
+                {
+                    throw new Win32Exception(ret);
+                }
+
+                // The values come back packed one after the other.
+                var pValue = pValues;
+                for (var i = 0; i < names.Length; ++i)
+                {
+                    var value = Marshal.PtrToStringUni(pValue);
+                    values[i] = NativeMethods.S_OK == results[i] ? value : null;
+
+                    pValue = new IntPtr(pValue.ToInt64() + (value.Length + 1) * UnicodeEncoding.CharSize);
+                }
+
+                return values;
+            }
+            finally
+            {
+                Marshal.FreeCoTaskMem(pValues);
+            }
+        }
+
         /// <inheritdoc/>
         public string GetVariableVersion(string name)
         {
@@ -297,6 +343,17 @@ namespace WixToolset.Mba.Core
             }
         }
 
+        /// <inheritdoc/>
+        public void SetVariableStrings(string[] names, string[] values, bool formatted)
+        {
+            if (names.Length != values.Length)
+            {
+                throw new ArgumentException("There must be a value for each name.", nameof(values));
+            }
+
+            this.engine.SetVariables(names.Length, names, values, formatted);
+        }
+
         /// <inheritdoc/>
         public void SetVariableVersion(string name, string value)
         {
@@ -280,6 +280,28 @@ namespace WixToolset.Mba.Core
             [MarshalAs(UnmanagedType.LPWStr)] string wzVersion2,
             [MarshalAs(UnmanagedType.I4)] out int pnResult
             );
+
+        /// <summary>
+        /// See <see cref="IEngine.GetVariableStrings(string[])"/>.
+        /// </summary>
+        [PreserveSig]
+        int GetVariables(
+            int cVariables,
+            [MarshalAs(UnmanagedType.LPArray, ArraySubType = UnmanagedType.LPWStr, SizeParamIndex = 0)] string[] rgwzVariables,
+            IntPtr wzValues,
+            ref IntPtr pcchValues,
+            [MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 0), Out] int[] rghrVariables
+            );
+
+        /// <summary>
+        /// See <see cref="IEngine.SetVariableStrings(string[], string[], bool)"/>.
+        /// </summary>
+        void SetVariables(
+            int cVariables,
+            [MarshalAs(UnmanagedType.LPArray, ArraySubType = UnmanagedType.LPWStr, SizeParamIndex = 0)] string[] rgwzVariables,
+            [MarshalAs(UnmanagedType.LPArray, ArraySubType = UnmanagedType.LPWStr, SizeParamIndex = 0)] string[] rgwzValues,
+            [MarshalAs(UnmanagedType.Bool)] bool fFormatted
+            );
     }
 
     /// <summary>
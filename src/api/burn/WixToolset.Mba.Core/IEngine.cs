@@ -98,6 +98,13 @@ namespace WixToolset.Mba.Core
         /// <param name="name">The name of the variable.</param>
         string GetVariableString(string name);
 
+        /// <summary>
+        /// Gets many string variables from the engine in a single call.
+        /// </summary>
+        /// <param name="names">The names of the variables.</param>
+        /// <returns>The value of each variable in the order of <paramref name="names"/>, or null for a variable that does not exist.</returns>
+        string[] GetVariableStrings(string[] names);
+
         /// <summary>
         /// Gets <see cref="Version"/> variables for the engine.
         /// </summary>
@@ -191,6 +198,14 @@ namespace WixToolset.Mba.Core
         /// <param name="formatted">False if the value is a literal string.</param>
         void SetVariableString(string name, string value, bool formatted);
 
+        /// <summary>
+        /// Sets many string variables in the engine in a single call.
+        /// </summary>
+        /// <param name="names">The names of the variables.</param>
+        /// <param name="values">The value to set for each variable, in the order of <paramref name="names"/>.</param>
+        /// <param name="formatted">False if the values are literal strings.</param>
+        void SetVariableStrings(string[] names, string[] values, bool formatted);
+
         /// <summary>
         /// Sets version variables for the engine.
         /// </summary>
@@ -576,6 +576,58 @@ public: // IBootstrapperEngine
         return hr;
     }
 
+    virtual STDMETHODIMP GetVariables(
+        __in DWORD cVariables,
+        __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+        __out_ecount_opt(*pcchValues) LPWSTR wzValues,
+        __inout SIZE_T* pcchValues,
+        __out_ecount(cVariables) HRESULT* rghrVariables
+        )
+    {
+        HRESULT hr = S_OK;
+        BAENGINE_GETVARIABLES_ARGS args = { };
+        BAENGINE_GETVARIABLES_RESULTS results = { };
+
+        ExitOnNull(pcchValues, hr, E_INVALIDARG, "pcchValues is required");
+
+        args.cbSize = sizeof(args);
+        args.cVariables = cVariables;
+        args.rgwzVariables = rgwzVariables;
+
+        results.cbSize = sizeof(results);
+        results.wzValues = wzValues;
+        results.cchValues = *pcchValues;
+        results.rghrVariables = rghrVariables;
+
+        hr = m_pfnBAEngineProc(BOOTSTRAPPER_ENGINE_MESSAGE_GETVARIABLES, &args, &results, m_pvBAEngineProcContext);
+
+        *pcchValues = results.cchValues;
+
+    LExit:
+        return hr;
+    }
+
+    virtual STDMETHODIMP SetVariables(
+        __in DWORD cVariables,
+        __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+        __in_ecount(cVariables) const LPCWSTR* rgwzValues,
+        __in BOOL fFormatted
+        )
+    {
+        BAENGINE_SETVARIABLES_ARGS args = { };
+        BAENGINE_SETVARIABLES_RESULTS results = { };
+
+        args.cbSize = sizeof(args);
+        args.cVariables = cVariables;
+        args.rgwzVariables = rgwzVariables;
+        args.rgwzValues = rgwzValues;
+        args.fFormatted = fFormatted;
+
+        results.cbSize = sizeof(results);
+
+        return m_pfnBAEngineProc(BOOTSTRAPPER_ENGINE_MESSAGE_SETVARIABLES, &args, &results, m_pvBAEngineProcContext);
+    }
+
 public:
     HRESULT Init()
     {
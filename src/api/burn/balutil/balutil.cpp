@@ -365,6 +365,113 @@ LExit:
 }
 
 
+DAPI_(HRESULT) BalGetStringVariables(
+    __in DWORD cVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+    __inout_ecount(cVariables) LPWSTR* rgsczValues
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!vpEngine)
+    {
+        hr = E_POINTER;
+        ExitOnRootFailure(hr, "BalInitialize() must be called first.");
+    }
+
+    hr = BalGetStringVariablesFromEngine(vpEngine, cVariables, rgwzVariables, rgsczValues);
+
+LExit:
+    return hr;
+}
+
+
+// The values may be sensitive, if a variable is hidden should keep its value encrypted and SecureZeroFree.
+DAPI_(HRESULT) BalGetStringVariablesFromEngine(
+    __in IBootstrapperEngine* pEngine,
+    __in DWORD cVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+    __inout_ecount(cVariables) LPWSTR* rgsczValues
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT* rghrVariables = NULL;
+    LPWSTR sczValues = NULL;
+    SIZE_T cch = 0;
+    LPCWSTR wzValue = NULL;
+    SIZE_T cchValue = 0;
+
+    if (!cVariables)
+    {
+        ExitFunction();
+    }
+
+    rghrVariables = static_cast<HRESULT*>(MemAlloc(sizeof(HRESULT) * cVariables, TRUE));
+    ExitOnNull(rghrVariables, hr, E_OUTOFMEMORY, "Failed to allocate variable results.");
+
+    cch = min(STRSAFE_MAX_LENGTH, cVariables * VARIABLE_GROW_FACTOR);
+    hr = StrAllocSecure(&sczValues, cch);
+    ExitOnFailure(hr, "Failed to pre-allocate values.");
+
+    hr = pEngine->GetVariables(cVariables, rgwzVariables, sczValues, &cch, rghrVariables);
+    if (E_MOREDATA == hr)
+    {
+        hr = StrAllocSecure(&sczValues, cch);
+        ExitOnFailure(hr, "Failed to allocate values.");
+
+        hr = pEngine->GetVariables(cVariables, rgwzVariables, sczValues, &cch, rghrVariables);
+    }
+    ExitOnFailure(hr, "Failed to get variables from engine.");
+
+    // Split the packed values back out.
+    wzValue = sczValues;
+    for (DWORD i = 0; i < cVariables; ++i)
+    {
+        cchValue = lstrlenW(wzValue);
+
+        if (SUCCEEDED(rghrVariables[i]))
+        {
+            hr = StrAllocStringSecure(rgsczValues + i, wzValue, cchValue);
+            ExitOnFailure(hr, "Failed to copy value of variable: %ls", rgwzVariables[i]);
+        }
+        else
+        {
+            ReleaseNullStr(rgsczValues[i]);
+        }
+
+        wzValue += cchValue + 1;
+    }
+
+LExit:
+    StrSecureZeroFreeString(sczValues);
+    ReleaseMem(rghrVariables);
+
+    return hr;
+}
+
+
+DAPI_(HRESULT) BalSetStringVariables(
+    __in DWORD cVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzValues,
+    __in BOOL fFormatted
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!vpEngine)
+    {
+        hr = E_POINTER;
+        ExitOnRootFailure(hr, "BalInitialize() must be called first.");
+    }
+
+    hr = vpEngine->SetVariables(cVariables, rgwzVariables, rgwzValues, fFormatted);
+
+LExit:
+    return hr;
+}
+
+
 DAPI_(HRESULT) BalGetVersionVariable(
     __in_z LPCWSTR wzVariable,
     __inout LPWSTR* psczValue
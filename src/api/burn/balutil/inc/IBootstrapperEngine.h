@@ -137,4 +137,19 @@ DECLARE_INTERFACE_IID_(IBootstrapperEngine, IUnknown, "6480D616-27A0-44D7-905B-8
         __in_z LPCWSTR wzVersion2,
         __out int* pnResult
         ) = 0;
+
+    STDMETHOD(GetVariables)(
+        __in DWORD cVariables,
+        __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+        __out_ecount_opt(*pcchValues) LPWSTR wzValues,
+        __inout SIZE_T* pcchValues,
+        __out_ecount(cVariables) HRESULT* rghrVariables
+        ) = 0;
+
+    STDMETHOD(SetVariables)(
+        __in DWORD cVariables,
+        __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+        __in_ecount(cVariables) const LPCWSTR* rgwzValues,
+        __in BOOL fFormatted
+        ) = 0;
 };
@@ -186,6 +186,45 @@ DAPI_(HRESULT) BalGetStringVariableFromEngine(
     __inout LPWSTR* psczValue
     );
 
+/*******************************************************************
+BalGetStringVariables - gets strings from many variables in the engine
+    with a single engine call. Variables that do not exist get NULL.
+
+ Note: Use StrFree() to release each value in rgsczValues.
+********************************************************************/
+DAPI_(HRESULT) BalGetStringVariables(
+    __in DWORD cVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+    __inout_ecount(cVariables) LPWSTR* rgsczValues
+    );
+
+/*******************************************************************
+BalGetStringVariablesFromEngine - gets strings from many variables in
+    the engine with a single engine call. Variables that do not exist
+    get NULL.
+
+ Note: Use StrFree() to release each value in rgsczValues.
+********************************************************************/
+DAPI_(HRESULT) BalGetStringVariablesFromEngine(
+    __in IBootstrapperEngine* pEngine,
+    __in DWORD cVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+    __inout_ecount(cVariables) LPWSTR* rgsczValues
+    );
+
+/*******************************************************************
+BalSetStringVariables - sets many string variables in the engine with
+    a single engine call.
+    If the values contain unexpanded variables, set fFormatted to true.
+
+********************************************************************/
+DAPI_(HRESULT) BalSetStringVariables(
+    __in DWORD cVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzValues,
+    __in BOOL fFormatted
+    );
+
 /*******************************************************************
 BalSetStringVariable - sets a string variable in the engine.
     If the value contains unexpanded variables, set fFormatted to true.
@@ -80,6 +80,7 @@ namespace WixToolset.Data.Symbols
         Visible = 0x2,
         Win64 = 0x4,
         Vital = 0x8,
+        Parallel = 0x10,
     }
 
     public class WixBundlePackageSymbol : IntermediateSymbol
@@ -273,5 +274,21 @@ namespace WixToolset.Data.Symbols
                 }
             }
         }
+
+        public bool Parallel
+        {
+            get { return this.Attributes.HasFlag(WixBundlePackageAttributes.Parallel); }
+            set
+            {
+                if (value)
+                {
+                    this.Attributes |= WixBundlePackageAttributes.Parallel;
+                }
+                else
+                {
+                    this.Attributes &= ~WixBundlePackageAttributes.Parallel;
+                }
+            }
+        }
     }
 }
@@ -35,6 +35,8 @@ namespace WixToolset.Data
                 new IntermediateFieldDefinition(nameof(WixBundleSymbolFields.InProgressName), IntermediateFieldType.String),
                 new IntermediateFieldDefinition(nameof(WixBundleSymbolFields.CommandLineVariables), IntermediateFieldType.String),
                 new IntermediateFieldDefinition(nameof(WixBundleSymbolFields.DisableModify), IntermediateFieldType.String),
+                new IntermediateFieldDefinition(nameof(WixBundleSymbolFields.ProgressUpdatesPerSecond), IntermediateFieldType.Number),
+                new IntermediateFieldDefinition(nameof(WixBundleSymbolFields.ProgressPercentageStep), IntermediateFieldType.Number),
             },
             typeof(WixBundleSymbol));
     }
@@ -71,6 +73,8 @@ namespace WixToolset.Data.Symbols
         InProgressName,
         CommandLineVariables,
         DisableModify,
+        ProgressUpdatesPerSecond,
+        ProgressPercentageStep,
     }
 
     [Flags]
@@ -264,6 +268,18 @@ namespace WixToolset.Data.Symbols
             set => this.Set((int)WixBundleSymbolFields.DisableModify, value.ToString().ToLowerInvariant());
         }
 
+        public int? ProgressUpdatesPerSecond
+        {
+            get => this.Fields[(int)WixBundleSymbolFields.ProgressUpdatesPerSecond].AsNullableNumber();
+            set => this.Set((int)WixBundleSymbolFields.ProgressUpdatesPerSecond, value);
+        }
+
+        public int? ProgressPercentageStep
+        {
+            get => this.Fields[(int)WixBundleSymbolFields.ProgressPercentageStep].AsNullableNumber();
+            set => this.Set((int)WixBundleSymbolFields.ProgressPercentageStep, value);
+        }
+
         public PackagingType DefaultPackagingType => (this.Compressed.HasValue && !this.Compressed.Value) ? PackagingType.External : PackagingType.Embedded;
 
         public bool DisableRemove
@@ -51,6 +51,22 @@ LExit:
     return hr;
 }
 
+static HRESULT BAEngineGetVariables(
+    __in BOOTSTRAPPER_ENGINE_CONTEXT* pContext,
+    __in const LPVOID pvArgs,
+    __inout LPVOID pvResults
+    )
+{
+    HRESULT hr = S_OK;
+    ValidateMessageArgs(hr, pvArgs, BAENGINE_GETVARIABLES_ARGS, pArgs);
+    ValidateMessageResults(hr, pvResults, BAENGINE_GETVARIABLES_RESULTS, pResults);
+
+    hr = ExternalEngineGetVariables(pContext->pEngineState, pArgs->cVariables, pArgs->rgwzVariables, pResults->wzValues, &pResults->cchValues, pResults->rghrVariables);
+
+LExit:
+    return hr;
+}
+
 static HRESULT BAEngineGetVariableVersion(
     __in BOOTSTRAPPER_ENGINE_CONTEXT* pContext,
     __in const LPVOID pvArgs,
@@ -267,6 +283,22 @@ LExit:
     return hr;
 }
 
+static HRESULT BAEngineSetVariables(
+    __in BOOTSTRAPPER_ENGINE_CONTEXT* pContext,
+    __in const LPVOID pvArgs,
+    __inout LPVOID pvResults
+    )
+{
+    HRESULT hr = S_OK;
+    ValidateMessageArgs(hr, pvArgs, BAENGINE_SETVARIABLES_ARGS, pArgs);
+    ValidateMessageResults(hr, pvResults, BAENGINE_SETVARIABLES_RESULTS, pResults);
+
+    hr = ExternalEngineSetVariables(pContext->pEngineState, pArgs->cVariables, pArgs->rgwzVariables, pArgs->rgwzValues, pArgs->fFormatted);
+
+LExit:
+    return hr;
+}
+
 static HRESULT BAEngineSetVariableVersion(
     __in BOOTSTRAPPER_ENGINE_CONTEXT* pContext,
     __in const LPVOID pvArgs,
@@ -519,6 +551,12 @@ HRESULT WINAPI EngineForApplicationProc(
     case BOOTSTRAPPER_ENGINE_MESSAGE_COMPAREVERSIONS:
         hr = BAEngineCompareVersions(pContext, pvArgs, pvResults);
         break;
+    case BOOTSTRAPPER_ENGINE_MESSAGE_GETVARIABLES:
+        hr = BAEngineGetVariables(pContext, pvArgs, pvResults);
+        break;
+    case BOOTSTRAPPER_ENGINE_MESSAGE_SETVARIABLES:
+        hr = BAEngineSetVariables(pContext, pvArgs, pvResults);
+        break;
     default:
         hr = E_NOTIMPL;
         break;
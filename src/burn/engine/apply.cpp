@@ -54,6 +54,14 @@ typedef struct _BURN_CACHE_PROGRESS_CONTEXT
     HRESULT hrError;
 } BURN_CACHE_PROGRESS_CONTEXT;
 
+typedef struct _BURN_PARALLEL_EXECUTE_GROUP
+{
+    CRITICAL_SECTION cs;
+    DWORD cExecutedPackages;
+    DWORD dwRunningPercentage;      // sum of the progress of the packages still running in the group.
+    DWORD dwOverallPercentage;      // highest overall progress reported while the group runs.
+} BURN_PARALLEL_EXECUTE_GROUP;
+
 typedef struct _BURN_EXECUTE_CONTEXT
 {
     BURN_CACHE* pCache;
@@ -64,8 +72,30 @@ typedef struct _BURN_EXECUTE_CONTEXT
     DWORD cExecutedPackages;
     DWORD cExecutePackagesTotal;
     BOOL fAbandonedProcess;
+
+    HANDLE hParallelBegin;          // only set in a parallel group, signaled once the BA was told the package began.
+    HANDLE hParallelPreviousWorker; // only set in a parallel group, package complete waits for this thread to exit.
+    HANDLE hParallelPreviousElevatedWorker; // only set in a parallel group, the elevated pipe waits for this thread to exit.
+    BURN_PARALLEL_EXECUTE_GROUP* pParallelGroup; // only set in a parallel group, counts the executed packages for every thread.
+    DWORD dwParallelPercentage;     // only set in a parallel group, this package's share of the group's running progress.
 } BURN_EXECUTE_CONTEXT;
 
+typedef struct _BURN_PARALLEL_EXECUTE_WORKER
+{
+    BURN_ENGINE_STATE* pEngineState;
+    BURN_EXECUTE_ACTION* pExecuteAction;
+    BURN_PACKAGE* pPackage;
+    BOOL fElevated;
+
+    BURN_EXECUTE_CONTEXT context;
+    BURN_EXECUTE_ACTION_CHECKPOINT* pCheckpoint;
+    HANDLE hThread;
+
+    HRESULT hr;
+    BOOL fSuspend;
+    BOOTSTRAPPER_APPLY_RESTART restart;
+} BURN_PARALLEL_EXECUTE_WORKER;
+
 
 // internal function declarations
 static HRESULT WINAPI AuthenticationRequired(
@@ -198,6 +228,43 @@ static HRESULT DoExecuteAction(
     __out BOOL* pfSuspend,
     __out BOOTSTRAPPER_APPLY_RESTART* pRestart
     );
+static HRESULT DoExecuteParallelGroup(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in DWORD iFirstAction,
+    __in DWORD cActions,
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __inout BURN_EXECUTE_ACTION_CHECKPOINT** ppCheckpoint,
+    __out BOOL* pfSuspend,
+    __out BOOTSTRAPPER_APPLY_RESTART* pRestart
+    );
+static DWORD WINAPI ParallelExecuteThreadProc(
+    __in LPVOID pvContext
+    );
+static BOOL ParallelWorkersStopped(
+    __in BURN_PARALLEL_EXECUTE_WORKER* rgWorkers,
+    __in DWORD cWorkers
+    );
+static void NotifyParallelPackageBegin(
+    __in BURN_EXECUTE_CONTEXT* pContext
+    );
+static void WaitForParallelPackageCompleteTurn(
+    __in BURN_EXECUTE_CONTEXT* pContext
+    );
+static void WaitForParallelElevatedTurn(
+    __in BURN_EXECUTE_CONTEXT* pContext
+    );
+static void JoinParallelWorkers(
+    __in BURN_PARALLEL_EXECUTE_WORKER* rgWorkers,
+    __in DWORD cWorkers
+    );
+static void UpdateExecutedPackages(
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __in BOOL fRollback
+    );
+static DWORD CalculateExecuteOverallProgress(
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __in DWORD dwPackagePercentage
+    );
 static HRESULT DoRollbackActions(
     __in BURN_ENGINE_STATE* pEngineState,
     __in BURN_EXECUTE_CONTEXT* pContext,
@@ -345,6 +412,11 @@ static HRESULT ExecutePackageComplete(
     __out BOOL* pfRetry,
     __out BOOL* pfSuspend
     );
+static void BeginExecuteDetectSnapshot(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __deref_opt_out_z_opt LPWSTR* psczChildSnapshotFile
+    );
 
 
 // function definitions
@@ -566,6 +638,7 @@ extern "C" HRESULT ApplyCache(
     DWORD dwCheckpoint = 0;
     BURN_CACHE_CONTEXT cacheContext = { };
     BURN_PACKAGE* pPackage = NULL;
+    BURN_TRACE_SPAN traceSpan = { };
 
     hr = UserExperienceOnCacheBegin(pUX);
     ExitOnRootFailure(hr, "BA aborted cache.");
@@ -597,7 +670,11 @@ extern "C" HRESULT ApplyCache(
             break;
 
         case BURN_CACHE_ACTION_TYPE_LAYOUT_BUNDLE:
+            TracingSpanBegin(&traceSpan, L"ApplyLayoutBundle", pCacheAction->bundleLayout.sczExecutableName, i);
+
             hr = ApplyLayoutBundle(&cacheContext, pCacheAction->bundleLayout.pPayloadGroup, pCacheAction->bundleLayout.sczExecutableName, pCacheAction->bundleLayout.sczUnverifiedPath, pCacheAction->bundleLayout.qwBundleSize);
+
+            TracingSpanEnd(&traceSpan, hr);
             ExitOnFailure(hr, "Failed cache action: %ls", L"layout bundle");
 
             hr = ReportOverallProgressTicks(pUX, FALSE, pPlan->cOverallProgressTicksTotal, pContext);
@@ -608,6 +685,8 @@ extern "C" HRESULT ApplyCache(
         case BURN_CACHE_ACTION_TYPE_PACKAGE:
             pPackage = pCacheAction->package.pPackage;
 
+            TracingSpanBegin(&traceSpan, L"ApplyCachePackage", pPackage->sczId, i);
+
             if (!cacheContext.wzLayoutDirectory)
             {
                 if (!pPackage->fPerMachine || INVALID_HANDLE_VALUE == cacheContext.hPipe)
@@ -624,6 +703,8 @@ extern "C" HRESULT ApplyCache(
             }
 
             hr = ApplyCachePackage(&cacheContext, pPackage);
+
+            TracingSpanEnd(&traceSpan, hr);
             ExitOnFailure(hr, "Failed cache action: %ls", L"cache package");
 
             hr = ReportOverallProgressTicks(pUX, FALSE, pPlan->cOverallProgressTicksTotal, pContext);
@@ -633,7 +714,11 @@ extern "C" HRESULT ApplyCache(
 
         case BURN_CACHE_ACTION_TYPE_CONTAINER:
             Assert(pPlan->sczLayoutDirectory);
+            TracingSpanBegin(&traceSpan, L"ApplyLayoutContainer", pCacheAction->container.pContainer->sczId, i);
+
             hr = ApplyLayoutContainer(&cacheContext, pCacheAction->container.pContainer);
+
+            TracingSpanEnd(&traceSpan, hr);
             ExitOnFailure(hr, "Failed cache action: %ls", L"layout container");
             
             break;
@@ -652,6 +737,8 @@ extern "C" HRESULT ApplyCache(
     }
 
 LExit:
+    TracingSpanEnd(&traceSpan, hr);
+
     pContext->dwCacheCheckpoint = dwCheckpoint;
 
     // Clean up any remanents in the cache.
@@ -758,8 +845,23 @@ extern "C" HRESULT ApplyExecute(
             fSeekRollbackBoundaryEnd = FALSE;
         }
 
-        // Execute the action.
-        hr = DoExecuteAction(pEngineState, pExecuteAction, &context, &pCheckpoint, pfSuspend, pRestart);
+        // Execute the action, or the whole run of actions whose packages may execute concurrently.
+        if (pExecuteAction->dwParallelGroup)
+        {
+            DWORD cGroupActions = 1;
+            while (i + cGroupActions < pEngineState->plan.cExecuteActions && pExecuteAction->dwParallelGroup == pEngineState->plan.rgExecuteActions[i + cGroupActions].dwParallelGroup)
+            {
+                ++cGroupActions;
+            }
+
+            hr = DoExecuteParallelGroup(pEngineState, i, cGroupActions, &context, &pCheckpoint, pfSuspend, pRestart);
+
+            i += cGroupActions - 1;
+        }
+        else
+        {
+            hr = DoExecuteAction(pEngineState, pExecuteAction, &context, &pCheckpoint, pfSuspend, pRestart);
+        }
 
         if (*pfSuspend || BOOTSTRAPPER_APPLY_RESTART_INITIATED == *pRestart)
         {
@@ -2453,6 +2555,327 @@ LExit:
     return hr;
 }
 
+static HRESULT DoExecuteParallelGroup(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in DWORD iFirstAction,
+    __in DWORD cActions,
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __inout BURN_EXECUTE_ACTION_CHECKPOINT** ppCheckpoint,
+    __out BOOL* pfSuspend,
+    __out BOOTSTRAPPER_APPLY_RESTART* pRestart
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_PARALLEL_EXECUTE_WORKER* rgWorkers = NULL;
+    DWORD cWorkers = 0;
+    DWORD* rgiRegistrationActions = NULL;
+    DWORD cRegistrationActions = 0;
+    HANDLE hPreviousElevatedWorker = NULL;
+    BURN_PARALLEL_EXECUTE_GROUP group = { };
+    HANDLE rghWait[2] = { };
+    DWORD dwSignaledIndex = 0;
+
+    ::InitializeCriticalSection(&group.cs);
+    group.cExecutedPackages = pContext->cExecutedPackages;
+
+    // Every thread in the group shares the executed package count and takes turns talking to the BA.
+    pContext->pParallelGroup = &group;
+    pContext->pUX->fParallelExecute = TRUE;
+
+    rgWorkers = static_cast<BURN_PARALLEL_EXECUTE_WORKER*>(MemAlloc(sizeof(BURN_PARALLEL_EXECUTE_WORKER) * cActions, TRUE));
+    ExitOnNull(rgWorkers, hr, E_OUTOFMEMORY, "Failed to allocate parallel execute workers.");
+
+    rgiRegistrationActions = static_cast<DWORD*>(MemAlloc(sizeof(DWORD) * cActions, TRUE));
+    ExitOnNull(rgiRegistrationActions, hr, E_OUTOFMEMORY, "Failed to allocate parallel registration actions.");
+
+    LogStringLine(REPORT_STANDARD, "Executing parallel group %u with %u actions.", pEngineState->plan.rgExecuteActions[iFirstAction].dwParallelGroup, cActions);
+
+    for (DWORD i = 0; i < cActions; ++i)
+    {
+        BURN_EXECUTE_ACTION* pExecuteAction = pEngineState->plan.rgExecuteActions + iFirstAction + i;
+        BURN_PARALLEL_EXECUTE_WORKER* pWorker = NULL;
+
+        if (pExecuteAction->fDeleted)
+        {
+            continue;
+        }
+
+        // Stop starting packages once one of the running packages failed or asked to suspend or restart.
+        if (ParallelWorkersStopped(rgWorkers, cWorkers))
+        {
+            break;
+        }
+
+        switch (pExecuteAction->type)
+        {
+        case BURN_EXECUTE_ACTION_TYPE_BUNDLE_PACKAGE: __fallthrough;
+        case BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE: __fallthrough;
+        case BURN_EXECUTE_ACTION_TYPE_MSU_PACKAGE:
+            pWorker = rgWorkers + cWorkers;
+            ++cWorkers;
+
+            pWorker->pEngineState = pEngineState;
+            pWorker->pExecuteAction = pExecuteAction;
+            pWorker->pPackage = BURN_EXECUTE_ACTION_TYPE_BUNDLE_PACKAGE == pExecuteAction->type ? pExecuteAction->bundlePackage.pPackage :
+                                BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE == pExecuteAction->type ? pExecuteAction->exePackage.pPackage :
+                                pExecuteAction->msuPackage.pPackage;
+            pWorker->fElevated = pWorker->pPackage->fPerMachine;
+
+            pWorker->context = *pContext;
+            pWorker->context.wzExecutingPackageId = NULL;
+            pWorker->context.dwParallelPercentage = 0;
+            pWorker->context.hParallelPreviousWorker = 1 < cWorkers ? rgWorkers[cWorkers - 2].hThread : NULL;
+            pWorker->context.hParallelPreviousElevatedWorker = pWorker->fElevated ? hPreviousElevatedWorker : NULL;
+            pWorker->pCheckpoint = *ppCheckpoint;
+
+            pWorker->context.hParallelBegin = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+            ExitOnNullWithLastError(pWorker->context.hParallelBegin, hr, "Failed to create parallel package begin event.");
+
+            pWorker->hThread = ::CreateThread(NULL, 0, ParallelExecuteThreadProc, pWorker, 0, NULL);
+            ExitOnNullWithLastError(pWorker->hThread, hr, "Failed to create parallel execute thread.");
+
+            if (pWorker->fElevated)
+            {
+                hPreviousElevatedWorker = pWorker->hThread;
+            }
+
+            // Keep the BA's package begin callbacks in plan order.
+            rghWait[0] = pWorker->context.hParallelBegin;
+            rghWait[1] = pWorker->hThread;
+
+            hr = AppWaitForMultipleObjects(countof(rghWait), rghWait, FALSE, INFINITE, &dwSignaledIndex);
+            ExitOnFailure(hr, "Failed to wait for parallel package to begin.");
+            break;
+
+        case BURN_EXECUTE_ACTION_TYPE_PACKAGE_PROVIDER: __fallthrough;
+        case BURN_EXECUTE_ACTION_TYPE_PACKAGE_DEPENDENCY:
+            // Registration follows its own package, so it runs once the whole group is done.
+            rgiRegistrationActions[cRegistrationActions] = iFirstAction + i;
+            ++cRegistrationActions;
+            break;
+
+        default:
+            // A checkpoint does not wait for the running packages. It moves past packages that have
+            // only started, so a failure anywhere in the group rolls back the whole group.
+            hr = DoExecuteAction(pEngineState, pExecuteAction, pContext, ppCheckpoint, pfSuspend, pRestart);
+            ExitOnFailure(hr, "Failed to execute action in parallel group.");
+            break;
+        }
+    }
+
+    JoinParallelWorkers(rgWorkers, cWorkers);
+
+    if (ParallelWorkersStopped(rgWorkers, cWorkers))
+    {
+        ExitFunction();
+    }
+
+    // Registration goes over the elevated pipe for per-machine packages, so it waits until no package is running.
+    for (DWORD i = 0; i < cRegistrationActions; ++i)
+    {
+        hr = DoExecuteAction(pEngineState, pEngineState->plan.rgExecuteActions + rgiRegistrationActions[i], pContext, ppCheckpoint, pfSuspend, pRestart);
+        ExitOnFailure(hr, "Failed to execute registration action in parallel group.");
+    }
+
+LExit:
+    // Wait for every package to complete before reporting the result of the group.
+    for (DWORD i = 0; i < cWorkers; ++i)
+    {
+        BURN_PARALLEL_EXECUTE_WORKER* pWorker = rgWorkers + i;
+
+        if (pWorker->hThread)
+        {
+            ::WaitForSingleObject(pWorker->hThread, INFINITE);
+
+            if (SUCCEEDED(hr) && FAILED(pWorker->hr))
+            {
+                hr = pWorker->hr;
+            }
+
+            *pfSuspend |= pWorker->fSuspend;
+
+            if (*pRestart < pWorker->restart)
+            {
+                *pRestart = pWorker->restart;
+            }
+        }
+    }
+
+    pContext->pUX->fParallelExecute = FALSE;
+    pContext->pParallelGroup = NULL;
+    pContext->cExecutedPackages = group.cExecutedPackages;
+    ::DeleteCriticalSection(&group.cs);
+
+    for (DWORD i = 0; i < cWorkers; ++i)
+    {
+        ReleaseHandle(rgWorkers[i].hThread);
+        ReleaseHandle(rgWorkers[i].context.hParallelBegin);
+    }
+
+    ReleaseMem(rgiRegistrationActions);
+    ReleaseMem(rgWorkers);
+
+    return hr;
+}
+
+static DWORD WINAPI ParallelExecuteThreadProc(
+    __in LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_PARALLEL_EXECUTE_WORKER* pWorker = reinterpret_cast<BURN_PARALLEL_EXECUTE_WORKER*>(pvContext);
+    BOOL fComInitialized = FALSE;
+
+    // initialize COM
+    hr = ::CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    ExitOnFailure(hr, "Failed to initialize COM on parallel execute thread.");
+    fComInitialized = TRUE;
+
+    hr = DoExecuteAction(pWorker->pEngineState, pWorker->pExecuteAction, &pWorker->context, &pWorker->pCheckpoint, &pWorker->fSuspend, &pWorker->restart);
+
+LExit:
+    pWorker->hr = hr;
+
+    if (fComInitialized)
+    {
+        ::CoUninitialize();
+    }
+
+    return (DWORD)hr;
+}
+
+static BOOL ParallelWorkersStopped(
+    __in BURN_PARALLEL_EXECUTE_WORKER* rgWorkers,
+    __in DWORD cWorkers
+    )
+{
+    for (DWORD i = 0; i < cWorkers; ++i)
+    {
+        BURN_PARALLEL_EXECUTE_WORKER* pWorker = rgWorkers + i;
+
+        if (pWorker->hThread && WAIT_OBJECT_0 == ::WaitForSingleObject(pWorker->hThread, 0) &&
+            (FAILED(pWorker->hr) || pWorker->fSuspend || BOOTSTRAPPER_APPLY_RESTART_INITIATED == pWorker->restart))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void NotifyParallelPackageBegin(
+    __in BURN_EXECUTE_CONTEXT* pContext
+    )
+{
+    if (pContext->hParallelBegin)
+    {
+        ::SetEvent(pContext->hParallelBegin);
+    }
+}
+
+static void WaitForParallelPackageCompleteTurn(
+    __in BURN_EXECUTE_CONTEXT* pContext
+    )
+{
+    // Package complete callbacks are delivered to the BA in plan order.
+    if (pContext->hParallelPreviousWorker)
+    {
+        ::WaitForSingleObject(pContext->hParallelPreviousWorker, INFINITE);
+    }
+}
+
+static void WaitForParallelElevatedTurn(
+    __in BURN_EXECUTE_CONTEXT* pContext
+    )
+{
+    // The elevated pipe only serves one package at a time, so elevated packages take turns in plan order
+    // while per-user packages keep running next to them.
+    if (pContext->hParallelPreviousElevatedWorker)
+    {
+        ::WaitForSingleObject(pContext->hParallelPreviousElevatedWorker, INFINITE);
+    }
+}
+
+static void JoinParallelWorkers(
+    __in BURN_PARALLEL_EXECUTE_WORKER* rgWorkers,
+    __in DWORD cWorkers
+    )
+{
+    for (DWORD i = 0; i < cWorkers; ++i)
+    {
+        if (rgWorkers[i].hThread)
+        {
+            ::WaitForSingleObject(rgWorkers[i].hThread, INFINITE);
+        }
+    }
+}
+
+static void UpdateExecutedPackages(
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __in BOOL fRollback
+    )
+{
+    BURN_PARALLEL_EXECUTE_GROUP* pGroup = pContext->pParallelGroup;
+
+    if (pGroup)
+    {
+        ::EnterCriticalSection(&pGroup->cs);
+
+        pGroup->cExecutedPackages += fRollback ? -1 : 1;
+        pGroup->dwRunningPercentage -= pContext->dwParallelPercentage;
+        pContext->dwParallelPercentage = 0;
+
+        ::LeaveCriticalSection(&pGroup->cs);
+    }
+    else
+    {
+        pContext->cExecutedPackages += fRollback ? -1 : 1;
+    }
+}
+
+static DWORD CalculateExecuteOverallProgress(
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __in DWORD dwPackagePercentage
+    )
+{
+    DWORD dwOverallProgress = 0;
+    BURN_PARALLEL_EXECUTE_GROUP* pGroup = pContext->pParallelGroup;
+
+    if (!pContext->cExecutePackagesTotal)
+    {
+        ExitFunction();
+    }
+
+    if (pGroup)
+    {
+        // The running packages all count towards the overall progress and packages finish out of order,
+        // so only ever report the highest overall progress seen during the group.
+        ::EnterCriticalSection(&pGroup->cs);
+
+        pGroup->dwRunningPercentage += dwPackagePercentage - pContext->dwParallelPercentage;
+        pContext->dwParallelPercentage = dwPackagePercentage;
+
+        dwOverallProgress = (pGroup->cExecutedPackages * 100 + pGroup->dwRunningPercentage) / pContext->cExecutePackagesTotal;
+        if (dwOverallProgress < pGroup->dwOverallPercentage)
+        {
+            dwOverallProgress = pGroup->dwOverallPercentage;
+        }
+        else
+        {
+            pGroup->dwOverallPercentage = dwOverallProgress;
+        }
+
+        ::LeaveCriticalSection(&pGroup->cs);
+    }
+    else
+    {
+        dwOverallProgress = (pContext->cExecutedPackages * 100 + dwPackagePercentage) / pContext->cExecutePackagesTotal;
+    }
+
+LExit:
+    return dwOverallProgress;
+}
+
 static HRESULT DoRollbackActions(
     __in BURN_ENGINE_STATE* pEngineState,
     __in BURN_EXECUTE_CONTEXT* pContext,
@@ -2651,6 +3074,8 @@ static HRESULT ExecuteRelatedBundle(
     hr = UserExperienceInterpretExecuteResult(&pEngineState->userExperience, fRollback, message.dwUIHint, nResult);
     ExitOnRootFailure(hr, "BA aborted related bundle progress.");
 
+    BeginExecuteDetectSnapshot(pEngineState, pContext, &pExecuteAction->relatedBundle.sczDetectSnapshot);
+
     // Execute package.
     if (pPackage->fPerMachine)
     {
@@ -2670,7 +3095,7 @@ static HRESULT ExecuteRelatedBundle(
     hr = UserExperienceInterpretExecuteResult(&pEngineState->userExperience, fRollback, message.dwUIHint, nResult);
     ExitOnRootFailure(hr, "BA aborted related bundle progress.");
 
-    pContext->cExecutedPackages += fRollback ? -1 : 1;
+    UpdateExecutedPackages(pContext, fRollback);
 
     hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted related bundle execute progress.");
@@ -2746,6 +3171,7 @@ static HRESULT ExecuteBundlePackage(
     int nResult = 0;
     BOOL fBeginCalled = FALSE;
     BOOL fExecuted = FALSE;
+    BURN_TRACE_SPAN traceSpan = { };
     BURN_PACKAGE* pPackage = pExecuteAction->bundlePackage.pPackage;
 
     Assert(pContext->fRollback == fRollback);
@@ -2758,8 +3184,11 @@ static HRESULT ExecuteBundlePackage(
     pContext->wzExecutingPackageId = pPackage->sczId;
     fBeginCalled = TRUE;
 
+    TracingSpanBegin(&traceSpan, L"ExecuteBundlePackage", pPackage->sczId, fRollback);
+
     // Send package execute begin to BA.
     hr = UserExperienceOnExecutePackageBegin(&pEngineState->userExperience, pPackage->sczId, !fRollback, pExecuteAction->bundlePackage.action, INSTALLUILEVEL_NOCHANGE, FALSE);
+    NotifyParallelPackageBegin(pContext);
     ExitOnRootFailure(hr, "BA aborted execute BUNDLE package begin.");
 
     message.type = GENERIC_EXECUTE_MESSAGE_PROGRESS;
@@ -2771,9 +3200,13 @@ static HRESULT ExecuteBundlePackage(
 
     fExecuted = TRUE;
 
+    BeginExecuteDetectSnapshot(pEngineState, pContext, &pExecuteAction->bundlePackage.sczDetectSnapshot);
+
     // Execute package.
     if (pPackage->fPerMachine)
     {
+        WaitForParallelElevatedTurn(pContext);
+
         hrExecute = ElevationExecuteBundlePackage(pEngineState->companionConnection.hPipe, pExecuteAction, &pEngineState->variables, fRollback, GenericExecuteMessageHandler, pContext, pRestart);
         ExitOnFailure(hrExecute, "Failed to configure per-machine BUNDLE package.");
     }
@@ -2790,12 +3223,14 @@ static HRESULT ExecuteBundlePackage(
     hr = UserExperienceInterpretExecuteResult(&pEngineState->userExperience, fRollback, message.dwUIHint, nResult);
     ExitOnRootFailure(hr, "BA aborted BUNDLE progress.");
 
-    pContext->cExecutedPackages += fRollback ? -1 : 1;
+    UpdateExecutedPackages(pContext, fRollback);
 
     hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted BUNDLE package execute progress.");
 
 LExit:
+    TracingSpanEnd(&traceSpan, FAILED(hrExecute) ? hrExecute : hr);
+
     if (fExecuted)
     {
         BundlePackageEngineUpdateInstallRegistrationState(pExecuteAction, hrExecute);
@@ -2804,6 +3239,7 @@ LExit:
     if (fBeginCalled)
     {
         pPackage->fAbandonedProcess = pContext->fAbandonedProcess;
+        WaitForParallelPackageCompleteTurn(pContext);
         hr = ExecutePackageComplete(pEngineState, pPackage->sczId, pPackage->fVital, pPackage->fAbandonedProcess, hr, hrExecute, fRollback, pRestart, pfRetry, pfSuspend);
     }
 
@@ -2826,6 +3262,7 @@ static HRESULT ExecuteExePackage(
     int nResult = 0;
     BOOL fBeginCalled = FALSE;
     BOOL fExecuted = FALSE;
+    BURN_TRACE_SPAN traceSpan = { };
     BURN_PACKAGE* pPackage = pExecuteAction->exePackage.pPackage;
 
     Assert(pContext->fRollback == fRollback);
@@ -2838,8 +3275,11 @@ static HRESULT ExecuteExePackage(
     pContext->wzExecutingPackageId = pPackage->sczId;
     fBeginCalled = TRUE;
 
+    TracingSpanBegin(&traceSpan, L"ExecuteExePackage", pPackage->sczId, fRollback);
+
     // Send package execute begin to BA.
     hr = UserExperienceOnExecutePackageBegin(&pEngineState->userExperience, pPackage->sczId, !fRollback, pExecuteAction->exePackage.action, INSTALLUILEVEL_NOCHANGE, FALSE);
+    NotifyParallelPackageBegin(pContext);
     ExitOnRootFailure(hr, "BA aborted execute EXE package begin.");
 
     message.type = GENERIC_EXECUTE_MESSAGE_PROGRESS;
@@ -2851,9 +3291,13 @@ static HRESULT ExecuteExePackage(
 
     fExecuted = TRUE;
 
+    BeginExecuteDetectSnapshot(pEngineState, pContext, pPackage->Exe.fBundle ? &pExecuteAction->exePackage.sczDetectSnapshot : NULL);
+
     // Execute package.
     if (pPackage->fPerMachine)
     {
+        WaitForParallelElevatedTurn(pContext);
+
         hrExecute = ElevationExecuteExePackage(pEngineState->companionConnection.hPipe, pExecuteAction, &pEngineState->variables, fRollback, GenericExecuteMessageHandler, pContext, pRestart);
         ExitOnFailure(hrExecute, "Failed to configure per-machine EXE package.");
     }
@@ -2870,12 +3314,14 @@ static HRESULT ExecuteExePackage(
     hr = UserExperienceInterpretExecuteResult(&pEngineState->userExperience, fRollback, message.dwUIHint, nResult);
     ExitOnRootFailure(hr, "BA aborted EXE progress.");
 
-    pContext->cExecutedPackages += fRollback ? -1 : 1;
+    UpdateExecutedPackages(pContext, fRollback);
 
     hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted EXE package execute progress.");
 
 LExit:
+    TracingSpanEnd(&traceSpan, FAILED(hrExecute) ? hrExecute : hr);
+
     if (fExecuted)
     {
         ExeEngineUpdateInstallRegistrationState(pExecuteAction, hrExecute);
@@ -2884,6 +3330,7 @@ LExit:
     if (fBeginCalled)
     {
         pPackage->fAbandonedProcess = pContext->fAbandonedProcess;
+        WaitForParallelPackageCompleteTurn(pContext);
         hr = ExecutePackageComplete(pEngineState, pPackage->sczId, pPackage->fVital, pPackage->fAbandonedProcess, hr, hrExecute, fRollback, pRestart, pfRetry, pfSuspend);
     }
 
@@ -2905,6 +3352,7 @@ static HRESULT ExecuteMsiPackage(
     HRESULT hrExecute = S_OK;
     BOOL fBeginCalled = FALSE;
     BOOL fExecuted = FALSE;
+    BURN_TRACE_SPAN traceSpan = { };
     BURN_PACKAGE* pPackage = pExecuteAction->msiPackage.pPackage;
 
     Assert(pContext->fRollback == fRollback);
@@ -2917,12 +3365,17 @@ static HRESULT ExecuteMsiPackage(
     pContext->wzExecutingPackageId = pPackage->sczId;
     fBeginCalled = TRUE;
 
+    TracingSpanBegin(&traceSpan, L"ExecuteMsiPackage", pPackage->sczId, fRollback);
+
     // Send package execute begin to BA.
     hr = UserExperienceOnExecutePackageBegin(&pEngineState->userExperience, pPackage->sczId, !fRollback, pExecuteAction->msiPackage.action, pExecuteAction->msiPackage.uiLevel, pExecuteAction->msiPackage.fDisableExternalUiHandler);
+    NotifyParallelPackageBegin(pContext);
     ExitOnRootFailure(hr, "BA aborted execute MSI package begin.");
 
     fExecuted = TRUE;
 
+    BeginExecuteDetectSnapshot(pEngineState, pContext, NULL);
+
     // execute package
     if (pPackage->fPerMachine)
     {
@@ -2931,16 +3384,18 @@ static HRESULT ExecuteMsiPackage(
     }
     else
     {
-        hrExecute = MsiEngineExecutePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, fRollback, MsiExecuteMessageHandler, pContext, pRestart);
+        hrExecute = MsiEngineExecutePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, fRollback, MsiExecuteMessageHandler, pContext, TRUE, pRestart);
         ExitOnFailure(hrExecute, "Failed to configure per-user MSI package.");
     }
 
-    pContext->cExecutedPackages += fRollback ? -1 : 1;
+    UpdateExecutedPackages(pContext, fRollback);
 
     hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted MSI package execute progress.");
 
 LExit:
+    TracingSpanEnd(&traceSpan, FAILED(hrExecute) ? hrExecute : hr);
+
     if (fExecuted)
     {
         MsiEngineUpdateInstallRegistrationState(pExecuteAction, fRollback, hrExecute, fInsideMsiTransaction);
@@ -2949,6 +3404,7 @@ LExit:
     if (fBeginCalled)
     {
         Assert(!pContext->fAbandonedProcess);
+        WaitForParallelPackageCompleteTurn(pContext);
         hr = ExecutePackageComplete(pEngineState, pPackage->sczId, pPackage->fVital, FALSE, hr, hrExecute, fRollback, pRestart, pfRetry, pfSuspend);
     }
 
@@ -2970,6 +3426,7 @@ static HRESULT ExecuteMspPackage(
     HRESULT hrExecute = S_OK;
     BOOL fBeginCalled = FALSE;
     BOOL fExecuted = FALSE;
+    BURN_TRACE_SPAN traceSpan = { };
     BURN_PACKAGE* pPackage = pExecuteAction->mspTarget.pPackage;
 
     Assert(pContext->fRollback == fRollback);
@@ -2982,6 +3439,8 @@ static HRESULT ExecuteMspPackage(
     pContext->wzExecutingPackageId = pPackage->sczId;
     fBeginCalled = TRUE;
 
+    TracingSpanBegin(&traceSpan, L"ExecuteMspPackage", pPackage->sczId, fRollback);
+
     // Send package execute begin to BA.
     hr = UserExperienceOnExecutePackageBegin(&pEngineState->userExperience, pPackage->sczId, !fRollback, pExecuteAction->mspTarget.action, pExecuteAction->mspTarget.uiLevel, pExecuteAction->mspTarget.fDisableExternalUiHandler);
     ExitOnRootFailure(hr, "BA aborted execute MSP package begin.");
@@ -2997,6 +3456,8 @@ static HRESULT ExecuteMspPackage(
 
     fExecuted = TRUE;
 
+    BeginExecuteDetectSnapshot(pEngineState, pContext, NULL);
+
     // execute package
     if (pExecuteAction->mspTarget.fPerMachineTarget)
     {
@@ -3005,16 +3466,18 @@ static HRESULT ExecuteMspPackage(
     }
     else
     {
-        hrExecute = MspEngineExecutePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, fRollback, MsiExecuteMessageHandler, pContext, pRestart);
+        hrExecute = MspEngineExecutePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, fRollback, MsiExecuteMessageHandler, pContext, TRUE, pRestart);
         ExitOnFailure(hrExecute, "Failed to configure per-user MSP package.");
     }
 
-    pContext->cExecutedPackages += fRollback ? -1 : 1;
+    UpdateExecutedPackages(pContext, fRollback);
 
     hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted MSP package execute progress.");
 
 LExit:
+    TracingSpanEnd(&traceSpan, FAILED(hrExecute) ? hrExecute : hr);
+
     if (fExecuted)
     {
         MspEngineUpdateInstallRegistrationState(pExecuteAction, hrExecute, fInsideMsiTransaction);
@@ -3046,6 +3509,7 @@ static HRESULT ExecuteMsuPackage(
     int nResult = 0;
     BOOL fBeginCalled = FALSE;
     BOOL fExecuted = FALSE;
+    BURN_TRACE_SPAN traceSpan = { };
     BURN_PACKAGE* pPackage = pExecuteAction->msuPackage.pPackage;
 
     Assert(pContext->fRollback == fRollback);
@@ -3058,8 +3522,11 @@ static HRESULT ExecuteMsuPackage(
     pContext->wzExecutingPackageId = pPackage->sczId;
     fBeginCalled = TRUE;
 
+    TracingSpanBegin(&traceSpan, L"ExecuteMsuPackage", pPackage->sczId, fRollback);
+
     // Send package execute begin to BA.
     hr = UserExperienceOnExecutePackageBegin(&pEngineState->userExperience, pPackage->sczId, !fRollback, pExecuteAction->msuPackage.action, INSTALLUILEVEL_NOCHANGE, FALSE);
+    NotifyParallelPackageBegin(pContext);
     ExitOnRootFailure(hr, "BA aborted execute MSU package begin.");
 
     message.type = GENERIC_EXECUTE_MESSAGE_PROGRESS;
@@ -3071,9 +3538,13 @@ static HRESULT ExecuteMsuPackage(
 
     fExecuted = TRUE;
 
+    BeginExecuteDetectSnapshot(pEngineState, pContext, NULL);
+
     // execute package
     if (pPackage->fPerMachine)
     {
+        WaitForParallelElevatedTurn(pContext);
+
         hrExecute = ElevationExecuteMsuPackage(pEngineState->companionConnection.hPipe, pExecuteAction, fRollback, fStopWusaService, GenericExecuteMessageHandler, pContext, pRestart);
         ExitOnFailure(hrExecute, "Failed to configure per-machine MSU package.");
     }
@@ -3090,12 +3561,14 @@ static HRESULT ExecuteMsuPackage(
     hr = UserExperienceInterpretExecuteResult(&pEngineState->userExperience, fRollback, message.dwUIHint, nResult);
     ExitOnRootFailure(hr, "BA aborted MSU progress.");
 
-    pContext->cExecutedPackages += fRollback ? -1 : 1;
+    UpdateExecutedPackages(pContext, fRollback);
 
     hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted MSU package execute progress.");
 
 LExit:
+    TracingSpanEnd(&traceSpan, FAILED(hrExecute) ? hrExecute : hr);
+
     if (fExecuted)
     {
         MsuEngineUpdateInstallRegistrationState(pExecuteAction, hrExecute);
@@ -3104,6 +3577,7 @@ LExit:
     if (fBeginCalled)
     {
         pPackage->fAbandonedProcess = pContext->fAbandonedProcess;
+        WaitForParallelPackageCompleteTurn(pContext);
         hr = ExecutePackageComplete(pEngineState, pPackage->sczId, pPackage->fVital, pPackage->fAbandonedProcess, hr, hrExecute, fRollback, pRestart, pfRetry, pfSuspend);
     }
 
@@ -3402,6 +3876,8 @@ static HRESULT ExecuteUninstallMsiCompatiblePackage(
     hr = UserExperienceOnExecutePackageBegin(&pEngineState->userExperience, pContext->wzExecutingPackageId, !fRollback, action, uiLevel, fDisableExternalUiHandler);
     ExitOnRootFailure(hr, "BA aborted execute MSI compatible package begin.");
 
+    BeginExecuteDetectSnapshot(pEngineState, pContext, NULL);
+
     // execute package
     if (pParentPackage->fPerMachine)
     {
@@ -3410,11 +3886,11 @@ static HRESULT ExecuteUninstallMsiCompatiblePackage(
     }
     else
     {
-        hrExecute = MsiEngineUninstallCompatiblePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, fRollback, MsiExecuteMessageHandler, pContext, pRestart);
+        hrExecute = MsiEngineUninstallCompatiblePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, fRollback, MsiExecuteMessageHandler, pContext, TRUE, pRestart);
         ExitOnFailure(hrExecute, "Failed to uninstall per-user MSI compatible package.");
     }
 
-    pContext->cExecutedPackages += fRollback ? -1 : 1;
+    UpdateExecutedPackages(pContext, fRollback);
 
     hr = ReportOverallProgressTicks(&pEngineState->userExperience, fRollback, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
     ExitOnRootFailure(hr, "BA aborted MSI compatible package execute progress.");
@@ -3489,7 +3965,7 @@ static int GenericExecuteMessageHandler(
     {
     case GENERIC_EXECUTE_MESSAGE_PROGRESS:
         {
-            DWORD dwOverallProgress = pContext->cExecutePackagesTotal ? (pContext->cExecutedPackages * 100 + pMessage->progress.dwPercentage) / (pContext->cExecutePackagesTotal) : 0;
+            DWORD dwOverallProgress = CalculateExecuteOverallProgress(pContext, pMessage->progress.dwPercentage);
             UserExperienceOnExecuteProgress(pContext->pUX, pContext->wzExecutingPackageId, pMessage->progress.dwPercentage, dwOverallProgress, &nResult); // ignore return value.
         }
         break;
@@ -3543,7 +4019,7 @@ static int MsiExecuteMessageHandler(
     {
     case WIU_MSI_EXECUTE_MESSAGE_PROGRESS:
         {
-        DWORD dwOverallProgress = pContext->cExecutePackagesTotal ? (pContext->cExecutedPackages * 100 + pMessage->progress.dwPercentage) / (pContext->cExecutePackagesTotal) : 0;
+        DWORD dwOverallProgress = CalculateExecuteOverallProgress(pContext, pMessage->progress.dwPercentage);
         UserExperienceOnExecuteProgress(pContext->pUX, pContext->wzExecutingPackageId, pMessage->progress.dwPercentage, dwOverallProgress, &nResult); // ignore return value.
         }
         break;
@@ -3659,3 +4135,31 @@ static HRESULT ExecutePackageComplete(
 
     return hr;
 }
+
+static void BeginExecuteDetectSnapshot(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __deref_opt_out_z_opt LPWSTR* psczChildSnapshotFile
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczWorkingFolder = NULL;
+
+    // The snapshot only saves the child bundle a full detect so failing to pass it along is not an error.
+    if (psczChildSnapshotFile)
+    {
+        hr = CacheEnsureBaseWorkingFolder(pContext->pCache, &sczWorkingFolder);
+        if (FAILED(hr))
+        {
+            ReleaseNullStr(sczWorkingFolder);
+        }
+    }
+
+    hr = DetectSnapshotBeginExecute(&pEngineState->detectSnapshot, sczWorkingFolder, psczChildSnapshotFile);
+    if (FAILED(hr))
+    {
+        LogStringLine(REPORT_WARNING, "Failed to pass detect snapshot to child bundle, hr: 0x%x", hr);
+    }
+
+    ReleaseStr(sczWorkingFolder);
+}
@@ -29,6 +29,7 @@ static HRESULT ExecuteBundle(
     __in_z_opt LPCWSTR wzIgnoreDependencies,
     __in_z_opt LPCWSTR wzAncestors,
     __in_z_opt LPCWSTR wzEngineWorkingDirectory,
+    __in_z_opt LPCWSTR wzDetectSnapshot,
     __out BOOTSTRAPPER_APPLY_RESTART* pRestart
     );
 static HRESULT DetectArpEntry(
@@ -257,13 +258,15 @@ extern "C" HRESULT BundlePackageEngineDetectPackage(
     )
 {
     HRESULT hr = S_OK;
+    const BUNDLE_INSTALL_CONTEXT rgInstallContexts[] = { BUNDLE_INSTALL_CONTEXT_MACHINE, BUNDLE_INSTALL_CONTEXT_USER };
     BUNDLE_QUERY_CONTEXT queryContext = { };
 
     queryContext.pPackage = pPackage;
     queryContext.pUserExperience = pUserExperience;
 
-    hr = BundleQueryRelatedBundles(
-        BUNDLE_INSTALL_CONTEXT_MACHINE,
+    hr = BundleQueryRelatedBundlesForContexts(
+        rgInstallContexts,
+        countof(rgInstallContexts),
         const_cast<LPCWSTR*>(pPackage->Bundle.rgsczDetectCodes),
         pPackage->Bundle.cDetectCodes,
         const_cast<LPCWSTR*>(pPackage->Bundle.rgsczUpgradeCodes),
@@ -274,21 +277,7 @@ extern "C" HRESULT BundlePackageEngineDetectPackage(
         pPackage->Bundle.cPatchCodes,
         QueryRelatedBundlesCallback,
         &queryContext);
-    ExitOnFailure(hr, "Failed to query per-machine related bundle packages.");
-
-    hr = BundleQueryRelatedBundles(
-        BUNDLE_INSTALL_CONTEXT_USER,
-        const_cast<LPCWSTR*>(pPackage->Bundle.rgsczDetectCodes),
-        pPackage->Bundle.cDetectCodes,
-        const_cast<LPCWSTR*>(pPackage->Bundle.rgsczUpgradeCodes),
-        pPackage->Bundle.cUpgradeCodes,
-        const_cast<LPCWSTR*>(pPackage->Bundle.rgsczAddonCodes),
-        pPackage->Bundle.cAddonCodes,
-        const_cast<LPCWSTR*>(pPackage->Bundle.rgsczPatchCodes),
-        pPackage->Bundle.cPatchCodes,
-        QueryRelatedBundlesCallback,
-        &queryContext);
-    ExitOnFailure(hr, "Failed to query per-user related bundle packages.");
+    ExitOnFailure(hr, "Failed to query related bundle packages.");
 
     if (queryContext.fNewerFound)
     {
@@ -618,10 +607,11 @@ extern "C" HRESULT BundlePackageEngineExecutePackage(
     LPCWSTR wzIgnoreDependencies = pExecuteAction->bundlePackage.sczIgnoreDependencies;
     LPCWSTR wzAncestors = pExecuteAction->bundlePackage.sczAncestors;
     LPCWSTR wzEngineWorkingDirectory = pExecuteAction->bundlePackage.sczEngineWorkingDirectory;
+    LPCWSTR wzDetectSnapshot = pExecuteAction->bundlePackage.sczDetectSnapshot;
     BOOTSTRAPPER_RELATION_TYPE relationType = BOOTSTRAPPER_RELATION_CHAIN_PACKAGE;
     BURN_PACKAGE* pPackage = pExecuteAction->bundlePackage.pPackage;
 
-    return ExecuteBundle(pCache, pVariables, fRollback, fCacheAvailable, pfnGenericMessageHandler, pvContext, action, relationType, pPackage, FALSE, wzParent, wzIgnoreDependencies, wzAncestors, wzEngineWorkingDirectory, pRestart);
+    return ExecuteBundle(pCache, pVariables, fRollback, fCacheAvailable, pfnGenericMessageHandler, pvContext, action, relationType, pPackage, FALSE, wzParent, wzIgnoreDependencies, wzAncestors, wzEngineWorkingDirectory, wzDetectSnapshot, pRestart);
 }
 
 extern "C" HRESULT BundlePackageEngineExecuteRelatedBundle(
@@ -639,11 +629,12 @@ extern "C" HRESULT BundlePackageEngineExecuteRelatedBundle(
     LPCWSTR wzIgnoreDependencies = pExecuteAction->relatedBundle.sczIgnoreDependencies;
     LPCWSTR wzAncestors = pExecuteAction->relatedBundle.sczAncestors;
     LPCWSTR wzEngineWorkingDirectory = pExecuteAction->relatedBundle.sczEngineWorkingDirectory;
+    LPCWSTR wzDetectSnapshot = pExecuteAction->relatedBundle.sczDetectSnapshot;
     BURN_RELATED_BUNDLE* pRelatedBundle = pExecuteAction->relatedBundle.pRelatedBundle;
     BOOTSTRAPPER_RELATION_TYPE relationType = ConvertRelationType(pRelatedBundle->planRelationType);
     BURN_PACKAGE* pPackage = &pRelatedBundle->package;
 
-    return ExecuteBundle(pCache, pVariables, fRollback, TRUE, pfnGenericMessageHandler, pvContext, action, relationType, pPackage, TRUE, wzParent, wzIgnoreDependencies, wzAncestors, wzEngineWorkingDirectory, pRestart);
+    return ExecuteBundle(pCache, pVariables, fRollback, TRUE, pfnGenericMessageHandler, pvContext, action, relationType, pPackage, TRUE, wzParent, wzIgnoreDependencies, wzAncestors, wzEngineWorkingDirectory, wzDetectSnapshot, pRestart);
 }
 
 extern "C" void BundlePackageEngineUpdateInstallRegistrationState(
@@ -746,6 +737,7 @@ static HRESULT ExecuteBundle(
     __in_z_opt LPCWSTR wzIgnoreDependencies,
     __in_z_opt LPCWSTR wzAncestors,
     __in_z_opt LPCWSTR wzEngineWorkingDirectory,
+    __in_z_opt LPCWSTR wzDetectSnapshot,
     __out BOOTSTRAPPER_APPLY_RESTART* pRestart
     )
 {
@@ -984,6 +976,9 @@ static HRESULT ExecuteBundle(
         ExitOnFailure(hr, "Failed to append the custom working directory to the bundlepackage command line.");
     }
 
+    hr = CoreAppendDetectSnapshotToCommandLine(wzDetectSnapshot, &sczBaseCommand);
+    ExitOnFailure(hr, "Failed to append %ls", BURN_COMMANDLINE_SWITCH_DETECT_SNAPSHOT);
+
     hr = CoreAppendFileHandleSelfToCommandLine(sczExecutablePath, &hExecutableFile, &sczBaseCommand, NULL);
     ExitOnFailure(hr, "Failed to append %ls", BURN_COMMANDLINE_SWITCH_FILEHANDLE_SELF);
 
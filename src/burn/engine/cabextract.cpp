@@ -5,6 +5,10 @@
 #include <fdi.h>
 
 #define ARRAY_GROWTH_SIZE 2
+#define CAB_WRITERS 3
+#define CAB_WRITE_SLOTS 4
+#define CAB_WRITE_SLOT_SIZE (1024 * 1024)
+#define CAB_MAPPING_VIEW_SIZE (4 * 1024 * 1024)
 
 const LPSTR INVALID_CAB_NAME = "<the>.cab";
 
@@ -55,6 +59,55 @@ static INT_PTR CloseFileInfoCallback(
     __in BURN_CONTAINER_CONTEXT* pContext,
     __inout FDINOTIFICATION *pFDINotify
     );
+static HRESULT CreateTargetFile(
+    __in BURN_CONTAINER_CONTEXT* pContext,
+    __in_z LPCWSTR wzTargetFile,
+    __in LONG cbFile,
+    __in_opt BURN_CONTAINER_STREAM_TARGET* pTarget
+    );
+static BURN_CONTAINER_STREAM_TARGET* FindStreamTarget(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
+    __in_z LPCWSTR wzStreamName
+    );
+static HRESULT StartWriters(
+    __in BURN_CONTAINER_CONTEXT* pContext
+    );
+static HRESULT StopWriters(
+    __in BURN_CONTAINER_CONTEXT* pContext
+    );
+static HRESULT StartWriter(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
+    __in BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter
+    );
+static HRESULT StopWriter(
+    __in BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter
+    );
+static DWORD WINAPI WriterThreadProc(
+    __in LPVOID lpThreadParameter
+    );
+static HRESULT FlushWriter(
+    __in BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter
+    );
+static BURN_CONTAINER_CONTEXT_CABINET_WRITER* SelectWriter(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
+    __in BOOL fPriority
+    );
+static HRESULT AcquireWriteSlot(
+    __in BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter,
+    __out BURN_CONTAINER_CONTEXT_CABINET_WRITE** ppWrite
+    );
+static HRESULT PublishWriteSlot(
+    __in BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter
+    );
+static HRESULT QueueTargetWrite(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
+    __in_bcount(cb) const BYTE* pb,
+    __in DWORD cb
+    );
+static HRESULT QueueTargetClose(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
+    __in_opt const FILETIME* pft
+    );
 static LPVOID DIAMONDAPI CabAlloc(
     __in DWORD dwSize
     );
@@ -84,6 +137,28 @@ static long FAR DIAMONDAPI CabSeek(
 static int FAR DIAMONDAPI CabClose(
     __in INT_PTR hf
     );
+static HRESULT MapContainer(
+    __in BURN_CONTAINER_CONTEXT* pContext
+    );
+static HRESULT MapContainerView(
+    __in BURN_CONTAINER_CONTEXT* pContext,
+    __in DWORD64 qwPosition
+    );
+static void UnmapContainer(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext
+    );
+static HRESULT ReadFromMapping(
+    __in BURN_CONTAINER_CONTEXT* pContext,
+    __in BURN_CONTAINER_CONTEXT_CABINET_VIRTUAL_FILE_POINTER* pVfp,
+    __out_bcount(cb) LPVOID pv,
+    __in DWORD cb,
+    __out DWORD* pcbRead
+    );
+static HRESULT CopyFromMapping(
+    __out_bcount(cb) LPVOID pvDestination,
+    __in_bcount(cb) const BYTE* pbSource,
+    __in DWORD cb
+    );
 static HRESULT AddVirtualFilePointer(
     __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
     __in HANDLE hFile,
@@ -142,6 +217,17 @@ extern "C" HRESULT CabExtractOpen(
     pContext->Cabinet.hOperationCompleteEvent = ::CreateEventW(NULL, TRUE, FALSE, NULL);
     ExitOnNullWithLastError(pContext->Cabinet.hOperationCompleteEvent, hr, "Failed to create operation complete event.");
 
+    // Serve cabinet reads straight out of a mapping of the container when possible,
+    // otherwise fall back to reading the file.
+    pContext->Cabinet.qwOpenTicks = ::GetTickCount64();
+
+    hr = MapContainer(pContext);
+    if (FAILED(hr))
+    {
+        LogStringLine(REPORT_VERBOSE, "Could not map container, reading it from the file instead, hr: 0x%x", hr);
+        hr = S_OK;
+    }
+
     // create extraction thread
     pContext->Cabinet.hThread = ::CreateThread(NULL, 0, ExtractThreadProc, pContext, 0, NULL);
     ExitOnNullWithLastError(pContext->Cabinet.hThread, hr, "Failed to create extraction thread.");
@@ -243,6 +329,50 @@ LExit:
     return hr;
 }
 
+extern "C" HRESULT CabExtractStreamsToFiles(
+    __in BURN_CONTAINER_CONTEXT* pContext,
+    __in_ecount(cTargets) BURN_CONTAINER_STREAM_TARGET* rgTargets,
+    __in DWORD cTargets,
+    __in_opt HANDLE hPriorityWrittenEvent
+    )
+{
+    HRESULT hr = S_OK;
+    LONG cPriority = 0;
+
+    for (DWORD i = 0; i < cTargets; ++i)
+    {
+        if (rgTargets[i].fPriority)
+        {
+            ++cPriority;
+        }
+    }
+
+    // set operation to extract the rest of the cabinet in one pass
+    pContext->Cabinet.operation = BURN_CAB_OPERATION_STREAMS_TO_FILES;
+    pContext->Cabinet.rgStreamTargets = rgTargets;
+    pContext->Cabinet.cStreamTargets = cTargets;
+    pContext->Cabinet.iNextStreamTarget = 0;
+    pContext->Cabinet.cPendingPriority = cPriority;
+    pContext->Cabinet.hPriorityWrittenEvent = cPriority ? hPriorityWrittenEvent : NULL;
+
+    if (!cPriority && hPriorityWrittenEvent && !::SetEvent(hPriorityWrittenEvent))
+    {
+        ExitWithLastError(hr, "Failed to set priority written event.");
+    }
+
+    // begin operation and wait
+    hr = BeginAndWaitForOperation(pContext);
+    ExitOnFailure(hr, "Failed to begin and wait for operation.");
+
+LExit:
+    // clear targets, the writers are stopped before the operation completes
+    pContext->Cabinet.rgStreamTargets = NULL;
+    pContext->Cabinet.cStreamTargets = 0;
+    pContext->Cabinet.hPriorityWrittenEvent = NULL;
+
+    return hr;
+}
+
 extern "C" HRESULT CabExtractClose(
     __in BURN_CONTAINER_CONTEXT* pContext
     )
@@ -266,11 +396,23 @@ extern "C" HRESULT CabExtractClose(
         ExitOnFailure(hr, "Failed to wait for thread to terminate.");
     }
 
+    if (pContext->Cabinet.cReads)
+    {
+        LogStringLine(REPORT_VERBOSE, "Read %llu bytes from container in %u reads over %llu ms using %hs.", pContext->Cabinet.qwBytesRead, pContext->Cabinet.cReads, ::GetTickCount64() - pContext->Cabinet.qwOpenTicks, pContext->Cabinet.hMapping ? "a memory mapping" : "file I/O");
+    }
+
+    if (pContext->Cabinet.cFileWrites)
+    {
+        LogStringLine(REPORT_VERBOSE, "Wrote %llu bytes of extracted files in %u writes across %u writers.", pContext->Cabinet.qwBytesWritten, pContext->Cabinet.cFileWrites, CAB_WRITERS);
+    }
+
 LExit:
+    UnmapContainer(&pContext->Cabinet);
     ReleaseHandle(pContext->Cabinet.hThread);
     ReleaseHandle(pContext->Cabinet.hBeginOperationEvent);
     ReleaseHandle(pContext->Cabinet.hOperationCompleteEvent);
     ReleaseMem(pContext->Cabinet.rgVirtualFilePointers);
+    ReleaseStr(pContext->Cabinet.sczBatchStreamName);
     ReleaseStr(pContext->Cabinet.sczFile);
 
     return hr;
@@ -356,6 +498,10 @@ static DWORD WINAPI ExtractThreadProc(
     // save context in TLS storage
     vpContext = pContext;
 
+    // start the threads that write extracted files
+    hr = StartWriters(pContext);
+    ExitOnFailure(hr, "Failed to start cabinet writers.");
+
     // create FDI context
     hfdi = ::FDICreate(CabAlloc, CabFree, CabOpen, CabRead, CabWrite, CabClose, CabSeek, cpuUNKNOWN, &erf);
     ExitOnNull(hfdi, hr, E_FAIL, "Failed to initialize cabinet.dll.");
@@ -423,37 +569,50 @@ static DWORD WINAPI ExtractThreadProc(
         ExitOnFailure(hr, "Failed to extract all files from container, erf: %d:%X:%d", erf.fError, erf.erfOper, erf.erfType);
     }
 
-    // set operation complete event
-    if (!::SetEvent(pContext->Cabinet.hOperationCompleteEvent))
+    // make sure every extracted file is on disk before reporting the end of the cabinet
+    hr = StopWriters(pContext);
+    ExitOnFailure(hr, "Failed to write extracted files.");
+
+    for (;;)
     {
-        ExitWithLastError(hr, "Failed to set operation complete event.");
-    }
+        // set operation complete event
+        if (!::SetEvent(pContext->Cabinet.hOperationCompleteEvent))
+        {
+            ExitWithLastError(hr, "Failed to set operation complete event.");
+        }
 
-    // wait for begin operation event
-    hr = AppWaitForSingleObject(pContext->Cabinet.hBeginOperationEvent, INFINITE);
-    ExitOnFailure(hr, "Failed to wait for begin operation event.");
+        // wait for begin operation event
+        hr = AppWaitForSingleObject(pContext->Cabinet.hBeginOperationEvent, INFINITE);
+        ExitOnFailure(hr, "Failed to wait for begin operation event.");
 
-    if (!::ResetEvent(pContext->Cabinet.hBeginOperationEvent))
-    {
-        ExitWithLastError(hr, "Failed to reset begin operation event.");
-    }
+        if (!::ResetEvent(pContext->Cabinet.hBeginOperationEvent))
+        {
+            ExitWithLastError(hr, "Failed to reset begin operation event.");
+        }
 
-    // read operation
-    switch (pContext->Cabinet.operation)
-    {
-    case BURN_CAB_OPERATION_NEXT_STREAM:
-        ExitFunction1(hr = E_NOMOREITEMS);
-        break;
+        // read operation
+        switch (pContext->Cabinet.operation)
+        {
+        case BURN_CAB_OPERATION_NEXT_STREAM:
+            ExitFunction1(hr = E_NOMOREITEMS);
+            break;
 
-    case BURN_CAB_OPERATION_CLOSE:
-        ExitFunction1(hr = S_OK);
+        case BURN_CAB_OPERATION_STREAMS_TO_FILES:
+            // nothing is left to extract.
+            break;
 
-    default:
-        hr = E_INVALIDSTATE;
-        ExitOnRootFailure(hr, "Invalid operation for this state.");
+        case BURN_CAB_OPERATION_CLOSE:
+            ExitFunction1(hr = S_OK);
+
+        default:
+            hr = E_INVALIDSTATE;
+            ExitOnRootFailure(hr, "Invalid operation for this state.");
+        }
     }
 
 LExit:
+    StopWriters(pContext);
+
     if (hfdi)
     {
         ::FDIDestroy(hfdi);
@@ -506,35 +665,62 @@ static INT_PTR CopyFileCallback(
     HRESULT hr = S_OK;
     INT_PTR ipResult = 1; // result to return on success
     LPWSTR pwzPath = NULL;
-    LARGE_INTEGER li = { };
+    BURN_CONTAINER_STREAM_TARGET* pTarget = NULL;
 
-    // set operation complete event
-    if (!::SetEvent(pContext->Cabinet.hOperationCompleteEvent))
+    // surface a failed write of an earlier stream before starting another one
+    hr = pContext->Cabinet.hrWrite;
+    ExitOnFailure(hr, "Failed to write extracted file.");
+
+    // A batch extracts the rest of the cabinet without handing each stream back to the caller.
+    if (BURN_CAB_OPERATION_STREAMS_TO_FILES != pContext->Cabinet.operation)
     {
-        ExitWithLastError(hr, "Failed to set operation complete event.");
-    }
+        // set operation complete event
+        if (!::SetEvent(pContext->Cabinet.hOperationCompleteEvent))
+        {
+            ExitWithLastError(hr, "Failed to set operation complete event.");
+        }
 
-    // wait for begin operation event
-    hr = AppWaitForSingleObject(pContext->Cabinet.hBeginOperationEvent, INFINITE);
-    ExitOnFailure(hr, "Failed to wait for begin operation event.");
+        // wait for begin operation event
+        hr = AppWaitForSingleObject(pContext->Cabinet.hBeginOperationEvent, INFINITE);
+        ExitOnFailure(hr, "Failed to wait for begin operation event.");
 
-    if (!::ResetEvent(pContext->Cabinet.hBeginOperationEvent))
-    {
-        ExitWithLastError(hr, "Failed to reset begin operation event.");
+        if (!::ResetEvent(pContext->Cabinet.hBeginOperationEvent))
+        {
+            ExitWithLastError(hr, "Failed to reset begin operation event.");
+        }
+
+        // read operation
+        switch (pContext->Cabinet.operation)
+        {
+        case BURN_CAB_OPERATION_NEXT_STREAM: __fallthrough;
+        case BURN_CAB_OPERATION_STREAMS_TO_FILES:
+            break;
+
+        case BURN_CAB_OPERATION_CLOSE:
+            ExitFunction1(hr = E_ABORT);
+
+        default:
+            hr = E_INVALIDSTATE;
+            ExitOnRootFailure(hr, "Invalid operation for this state.");
+        }
     }
 
-    // read operation
-    switch (pContext->Cabinet.operation)
+    if (BURN_CAB_OPERATION_STREAMS_TO_FILES == pContext->Cabinet.operation)
     {
-    case BURN_CAB_OPERATION_NEXT_STREAM:
-        break;
+        hr = StrAllocStringAnsi(&pContext->Cabinet.sczBatchStreamName, pFDINotify->psz1, 0, CP_UTF8);
+        ExitOnFailure(hr, "Failed to copy stream name: %hs", pFDINotify->psz1);
 
-    case BURN_CAB_OPERATION_CLOSE:
-        ExitFunction1(hr = E_ABORT);
+        pTarget = FindStreamTarget(&pContext->Cabinet, pContext->Cabinet.sczBatchStreamName);
+        if (!pTarget)
+        {
+            ExitWithRootFailure(hr, E_NOTFOUND, "Failed to find target for stream: %ls", pContext->Cabinet.sczBatchStreamName);
+        }
 
-    default:
-        hr = E_INVALIDSTATE;
-        ExitOnRootFailure(hr, "Invalid operation for this state.");
+        hr = CreateTargetFile(pContext, pTarget->wzTargetFile, pFDINotify->cb, pTarget);
+        ExitOnFailure(hr, "Failed to create target for stream: %ls", pContext->Cabinet.sczBatchStreamName);
+
+        pTarget->fExtracted = TRUE;
+        ExitFunction();
     }
 
     // copy stream name
@@ -560,31 +746,8 @@ static INT_PTR CopyFileCallback(
     switch (pContext->Cabinet.operation)
     {
     case BURN_CAB_OPERATION_STREAM_TO_FILE:
-        // create file
-        pContext->Cabinet.hTargetFile = ::CreateFileW(pContext->Cabinet.wzTargetFile, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (INVALID_HANDLE_VALUE == pContext->Cabinet.hTargetFile)
-        {
-            ExitWithLastError(hr, "Failed to create file: %ls", pContext->Cabinet.wzTargetFile);
-        }
-
-        // set file size
-        li.QuadPart = pFDINotify->cb;
-        if (!::SetFilePointerEx(pContext->Cabinet.hTargetFile, li, NULL, FILE_BEGIN))
-        {
-            ExitWithLastError(hr, "Failed to set file pointer to end of file.");
-        }
-
-        if (!::SetEndOfFile(pContext->Cabinet.hTargetFile))
-        {
-            ExitWithLastError(hr, "Failed to set end of file.");
-        }
-
-        li.QuadPart = 0;
-        if (!::SetFilePointerEx(pContext->Cabinet.hTargetFile, li, NULL, FILE_BEGIN))
-        {
-            ExitWithLastError(hr, "Failed to set file pointer to beginning of file.");
-        }
-
+        hr = CreateTargetFile(pContext, pContext->Cabinet.wzTargetFile, pFDINotify->cb, NULL);
+        ExitOnFailure(hr, "Failed to create target for stream.");
         break;
 
     case BURN_CAB_OPERATION_STREAM_TO_BUFFER:
@@ -626,23 +789,34 @@ static INT_PTR CloseFileInfoCallback(
     INT_PTR ipResult = 1; // result to return on success
     FILETIME ftLocal = { };
     FILETIME ft = { };
+    const FILETIME* pft = NULL;
 
     // read operation
     switch (pContext->Cabinet.operation)
     {
-    case BURN_CAB_OPERATION_STREAM_TO_FILE:
+    case BURN_CAB_OPERATION_STREAM_TO_FILE: __fallthrough;
+    case BURN_CAB_OPERATION_STREAMS_TO_FILES:
         // Make a best effort to set the time on the new file before
         // we close it.
         if (::DosDateTimeToFileTime(pFDINotify->date, pFDINotify->time, &ftLocal))
         {
             if (::LocalFileTimeToFileTime(&ftLocal, &ft))
             {
-                ::SetFileTime(pContext->Cabinet.hTargetFile, &ft, &ft, &ft);
+                pft = &ft;
             }
         }
 
-        // close file
-        ReleaseFile(pContext->Cabinet.hTargetFile);
+        // the writer thread closes the file after its data is written
+        hr = QueueTargetClose(&pContext->Cabinet, pft);
+        ExitOnFailure(hr, "Failed to queue close of extracted file.");
+
+        // A single stream is only complete once its file is on disk, so a
+        // failed write is reported for this stream rather than a later one.
+        if (BURN_CAB_OPERATION_STREAM_TO_FILE == pContext->Cabinet.operation)
+        {
+            hr = FlushWriter(pContext->Cabinet.pTargetWriter);
+            ExitOnFailure(hr, "Failed to write extracted file: %ls", pContext->Cabinet.wzTargetFile);
+        }
         break;
 
     case BURN_CAB_OPERATION_STREAM_TO_BUFFER:
@@ -676,6 +850,489 @@ LExit:
     return SUCCEEDED(hr) ? ipResult : -1;
 }
 
+static HRESULT CreateTargetFile(
+    __in BURN_CONTAINER_CONTEXT* pContext,
+    __in_z LPCWSTR wzTargetFile,
+    __in LONG cbFile,
+    __in_opt BURN_CONTAINER_STREAM_TARGET* pTarget
+    )
+{
+    HRESULT hr = S_OK;
+    LARGE_INTEGER li = { };
+
+    // every write for this file goes to the same writer
+    pContext->Cabinet.pTargetWriter = SelectWriter(&pContext->Cabinet, pTarget && pTarget->fPriority);
+    pContext->Cabinet.pStreamTarget = pTarget;
+    pContext->Cabinet.wzCurrentTargetFile = wzTargetFile;
+
+    // create file
+    pContext->Cabinet.hTargetFile = ::CreateFileW(wzTargetFile, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == pContext->Cabinet.hTargetFile)
+    {
+        ExitWithLastError(hr, "Failed to create file: %ls", wzTargetFile);
+    }
+
+    // set file size
+    li.QuadPart = cbFile;
+    if (!::SetFilePointerEx(pContext->Cabinet.hTargetFile, li, NULL, FILE_BEGIN))
+    {
+        ExitWithLastError(hr, "Failed to set file pointer to end of file.");
+    }
+
+    if (!::SetEndOfFile(pContext->Cabinet.hTargetFile))
+    {
+        ExitWithLastError(hr, "Failed to set end of file.");
+    }
+
+    li.QuadPart = 0;
+    if (!::SetFilePointerEx(pContext->Cabinet.hTargetFile, li, NULL, FILE_BEGIN))
+    {
+        ExitWithLastError(hr, "Failed to set file pointer to beginning of file.");
+    }
+
+LExit:
+    return hr;
+}
+
+static BURN_CONTAINER_STREAM_TARGET* FindStreamTarget(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
+    __in_z LPCWSTR wzStreamName
+    )
+{
+    // Streams usually come out of the cabinet in the order the targets were
+    // listed, so start looking where the last match left off.
+    for (DWORD i = 0; i < pCabinetContext->cStreamTargets; ++i)
+    {
+        DWORD iTarget = (pCabinetContext->iNextStreamTarget + i) % pCabinetContext->cStreamTargets;
+        BURN_CONTAINER_STREAM_TARGET* pTarget = pCabinetContext->rgStreamTargets + iTarget;
+
+        if (!pTarget->fExtracted && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, pTarget->wzStreamName, -1, wzStreamName, -1))
+        {
+            pCabinetContext->iNextStreamTarget = iTarget + 1;
+            return pTarget;
+        }
+    }
+
+    return NULL;
+}
+
+static HRESULT StartWriters(
+    __in BURN_CONTAINER_CONTEXT* pContext
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext = &pContext->Cabinet;
+
+    pCabinetContext->rgWriters = (BURN_CONTAINER_CONTEXT_CABINET_WRITER*)MemAlloc(sizeof(BURN_CONTAINER_CONTEXT_CABINET_WRITER) * CAB_WRITERS, TRUE);
+    ExitOnNull(pCabinetContext->rgWriters, hr, E_OUTOFMEMORY, "Failed to allocate cabinet writers.");
+
+    pCabinetContext->cWriters = CAB_WRITERS;
+    pCabinetContext->iNextWriter = 0;
+    pCabinetContext->pTargetWriter = NULL;
+    pCabinetContext->pStreamTarget = NULL;
+    pCabinetContext->hrWrite = S_OK;
+
+    for (DWORD i = 0; i < pCabinetContext->cWriters; ++i)
+    {
+        hr = StartWriter(pCabinetContext, pCabinetContext->rgWriters + i);
+        ExitOnFailure(hr, "Failed to start cabinet writer.");
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT StopWriters(
+    __in BURN_CONTAINER_CONTEXT* pContext
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrWriter = S_OK;
+    BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext = &pContext->Cabinet;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter = NULL;
+
+    if (!pCabinetContext->rgWriters)
+    {
+        ExitFunction();
+    }
+
+    // A stream that was abandoned part way still owns its file.
+    if (INVALID_HANDLE_VALUE != pCabinetContext->hTargetFile && pCabinetContext->pTargetWriter && pCabinetContext->pTargetWriter->hThread)
+    {
+        hr = QueueTargetClose(pCabinetContext, NULL);
+    }
+
+    for (DWORD i = 0; i < pCabinetContext->cWriters; ++i)
+    {
+        pWriter = pCabinetContext->rgWriters + i;
+
+        hrWriter = StopWriter(pWriter);
+        if (SUCCEEDED(hr))
+        {
+            hr = hrWriter;
+        }
+
+        pCabinetContext->qwBytesWritten += pWriter->qwBytesWritten;
+        pCabinetContext->cFileWrites += pWriter->cFileWrites;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pCabinetContext->hrWrite;
+    }
+
+LExit:
+    ReleaseFile(pCabinetContext->hTargetFile);
+    ReleaseNullMem(pCabinetContext->rgWriters);
+    pCabinetContext->cWriters = 0;
+    pCabinetContext->pTargetWriter = NULL;
+    pCabinetContext->pStreamTarget = NULL;
+
+    return hr;
+}
+
+static HRESULT StartWriter(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
+    __in BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter
+    )
+{
+    HRESULT hr = S_OK;
+
+    pWriter->pCabinetContext = pCabinetContext;
+
+    pWriter->rgSlots = (BURN_CONTAINER_CONTEXT_CABINET_WRITE*)MemAlloc(sizeof(BURN_CONTAINER_CONTEXT_CABINET_WRITE) * CAB_WRITE_SLOTS, TRUE);
+    ExitOnNull(pWriter->rgSlots, hr, E_OUTOFMEMORY, "Failed to allocate cabinet write slots.");
+
+    pWriter->cSlots = CAB_WRITE_SLOTS;
+
+    pWriter->hSlotFreeSemaphore = ::CreateSemaphoreW(NULL, CAB_WRITE_SLOTS, CAB_WRITE_SLOTS, NULL);
+    ExitOnNullWithLastError(pWriter->hSlotFreeSemaphore, hr, "Failed to create write slot free semaphore.");
+
+    pWriter->hPendingSemaphore = ::CreateSemaphoreW(NULL, 0, CAB_WRITE_SLOTS, NULL);
+    ExitOnNullWithLastError(pWriter->hPendingSemaphore, hr, "Failed to create write pending semaphore.");
+
+    pWriter->hThread = ::CreateThread(NULL, 0, WriterThreadProc, pWriter, 0, NULL);
+    ExitOnNullWithLastError(pWriter->hThread, hr, "Failed to create cabinet writer thread.");
+
+LExit:
+    return hr;
+}
+
+static HRESULT StopWriter(
+    __in BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITE* pWrite = NULL;
+    DWORD dwExitCode = 0;
+
+    if (pWriter->hThread)
+    {
+        hr = AcquireWriteSlot(pWriter, &pWrite);
+        if (SUCCEEDED(hr))
+        {
+            pWrite->fStop = TRUE;
+
+            hr = PublishWriteSlot(pWriter);
+        }
+
+        // If the stop could not be queued the writer has already exited.
+        AppWaitForSingleObject(pWriter->hThread, INFINITE);
+
+        if (SUCCEEDED(hr) && ::GetExitCodeThread(pWriter->hThread, &dwExitCode))
+        {
+            hr = static_cast<HRESULT>(dwExitCode);
+        }
+    }
+
+    // Close any file the writer never got to.
+    for (DWORD i = 0; pWriter->rgSlots && i < pWriter->cSlots; ++i)
+    {
+        pWrite = pWriter->rgSlots + i;
+
+        if (pWrite->fCloseFile)
+        {
+            ReleaseFile(pWrite->hFile);
+        }
+
+        ReleaseMem(pWrite->pbData);
+    }
+
+    ReleaseNullMem(pWriter->rgSlots);
+    pWriter->cSlots = 0;
+    ReleaseNullHandle(pWriter->hThread);
+    ReleaseNullHandle(pWriter->hPendingSemaphore);
+    ReleaseNullHandle(pWriter->hSlotFreeSemaphore);
+
+    return hr;
+}
+
+static DWORD WINAPI WriterThreadProc(
+    __in LPVOID lpThreadParameter
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter = (BURN_CONTAINER_CONTEXT_CABINET_WRITER*)lpThreadParameter;
+    BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext = pWriter->pCabinetContext;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITE* pWrite = NULL;
+
+    for (;;)
+    {
+        hr = AppWaitForSingleObject(pWriter->hPendingSemaphore, INFINITE);
+        ExitOnFailure(hr, "Failed to wait for pending cabinet write.");
+
+        pWrite = pWriter->rgSlots + pWriter->iConsumeSlot;
+        if (pWrite->fStop)
+        {
+            break;
+        }
+
+        // Once any write fails keep draining the queue so the extraction thread
+        // never blocks, but only close the files.
+        if (pWrite->cbData && SUCCEEDED(pCabinetContext->hrWrite))
+        {
+            hr = FileWriteHandle(pWrite->hFile, pWrite->pbData, pWrite->cbData);
+            if (FAILED(hr))
+            {
+                LogErrorString(hr, "Failed to write extracted file: %ls", pWrite->wzFile);
+                pCabinetContext->hrWrite = hr;
+            }
+            else
+            {
+                pWriter->qwBytesWritten += pWrite->cbData;
+                ++pWriter->cFileWrites;
+            }
+        }
+
+        if (pWrite->fCloseFile)
+        {
+            if (pWrite->fSetFileTime)
+            {
+                ::SetFileTime(pWrite->hFile, &pWrite->ftFile, &pWrite->ftFile, &pWrite->ftFile);
+            }
+
+            ReleaseFile(pWrite->hFile);
+
+            if (pWrite->pTarget)
+            {
+                pWrite->pTarget->qwWrittenTicks = ::GetTickCount64();
+
+                // The last priority file on disk lets the caller start using them while the rest are extracted.
+                if (pWrite->pTarget->fPriority && 0 == ::InterlockedDecrement(&pCabinetContext->cPendingPriority) && pCabinetContext->hPriorityWrittenEvent)
+                {
+                    ::SetEvent(pCabinetContext->hPriorityWrittenEvent);
+                }
+            }
+        }
+
+        pWrite->hFile = INVALID_HANDLE_VALUE;
+        pWrite->cbData = 0;
+        pWrite->fCloseFile = FALSE;
+        pWrite->fSetFileTime = FALSE;
+        pWrite->pTarget = NULL;
+        pWrite->wzFile = NULL;
+
+        pWriter->iConsumeSlot = (pWriter->iConsumeSlot + 1) % pWriter->cSlots;
+
+        if (!::ReleaseSemaphore(pWriter->hSlotFreeSemaphore, 1, NULL))
+        {
+            ExitWithLastError(hr, "Failed to release cabinet write slot.");
+        }
+    }
+
+    hr = S_OK;
+
+LExit:
+    return (DWORD)hr;
+}
+
+static HRESULT FlushWriter(
+    __in BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE rghWait[2] = { };
+    DWORD dwSignaledIndex = 0;
+    DWORD cAcquired = 0;
+
+    // Holding every slot means the writer has finished everything queued to it.
+    rghWait[0] = pWriter->hSlotFreeSemaphore;
+    rghWait[1] = pWriter->hThread;
+
+    while (cAcquired < pWriter->cSlots)
+    {
+        hr = AppWaitForMultipleObjects(countof(rghWait), rghWait, FALSE, INFINITE, &dwSignaledIndex);
+        ExitOnFailure(hr, "Failed to wait for cabinet writer to finish.");
+
+        if (1 == dwSignaledIndex)
+        {
+            ExitWithRootFailure(hr, E_UNEXPECTED, "Cabinet writer thread exited unexpectedly.");
+        }
+
+        ++cAcquired;
+    }
+
+    hr = pWriter->pCabinetContext->hrWrite;
+
+LExit:
+    if (cAcquired && !::ReleaseSemaphore(pWriter->hSlotFreeSemaphore, cAcquired, NULL) && SUCCEEDED(hr))
+    {
+        hr = HRESULT_FROM_WIN32(::GetLastError());
+    }
+
+    return hr;
+}
+
+static BURN_CONTAINER_CONTEXT_CABINET_WRITER* SelectWriter(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
+    __in BOOL fPriority
+    )
+{
+    // The first writer is kept for priority files; everything else is spread over the rest.
+    if (fPriority || 1 == pCabinetContext->cWriters)
+    {
+        return pCabinetContext->rgWriters;
+    }
+
+    pCabinetContext->iNextWriter = pCabinetContext->iNextWriter % (pCabinetContext->cWriters - 1) + 1;
+
+    return pCabinetContext->rgWriters + pCabinetContext->iNextWriter;
+}
+
+static HRESULT AcquireWriteSlot(
+    __in BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter,
+    __out BURN_CONTAINER_CONTEXT_CABINET_WRITE** ppWrite
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE rghWait[2] = { };
+    DWORD dwSignaledIndex = 0;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITE* pWrite = pWriter->rgSlots + pWriter->iProduceSlot;
+
+    if (!pWriter->fProduceSlotAcquired)
+    {
+        // wait for the writer to free a slot, or to exit
+        rghWait[0] = pWriter->hSlotFreeSemaphore;
+        rghWait[1] = pWriter->hThread;
+
+        hr = AppWaitForMultipleObjects(countof(rghWait), rghWait, FALSE, INFINITE, &dwSignaledIndex);
+        ExitOnFailure(hr, "Failed to wait for free cabinet write slot.");
+
+        if (1 == dwSignaledIndex)
+        {
+            ExitWithRootFailure(hr, E_UNEXPECTED, "Cabinet writer thread exited unexpectedly.");
+        }
+
+        if (!pWrite->pbData)
+        {
+            pWrite->pbData = static_cast<BYTE*>(MemAlloc(CAB_WRITE_SLOT_SIZE, FALSE));
+            ExitOnNull(pWrite->pbData, hr, E_OUTOFMEMORY, "Failed to allocate cabinet write buffer.");
+        }
+
+        pWrite->hFile = pWriter->pCabinetContext->hTargetFile;
+        pWrite->wzFile = pWriter->pCabinetContext->wzCurrentTargetFile;
+        pWrite->cbData = 0;
+        pWriter->fProduceSlotAcquired = TRUE;
+    }
+
+    *ppWrite = pWrite;
+
+LExit:
+    return hr;
+}
+
+static HRESULT PublishWriteSlot(
+    __in BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter
+    )
+{
+    HRESULT hr = S_OK;
+
+    pWriter->iProduceSlot = (pWriter->iProduceSlot + 1) % pWriter->cSlots;
+    pWriter->fProduceSlotAcquired = FALSE;
+
+    if (!::ReleaseSemaphore(pWriter->hPendingSemaphore, 1, NULL))
+    {
+        ExitWithLastError(hr, "Failed to queue cabinet write.");
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT QueueTargetWrite(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
+    __in_bcount(cb) const BYTE* pb,
+    __in DWORD cb
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter = pCabinetContext->pTargetWriter;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITE* pWrite = NULL;
+    DWORD cbCopy = 0;
+
+    // Coalesce the small chunks FDI hands out into large writes.
+    while (cb)
+    {
+        hr = pCabinetContext->hrWrite;
+        ExitOnFailure(hr, "Failed to write extracted file.");
+
+        hr = AcquireWriteSlot(pWriter, &pWrite);
+        ExitOnFailure(hr, "Failed to acquire cabinet write slot.");
+
+        cbCopy = CAB_WRITE_SLOT_SIZE - pWrite->cbData;
+        if (cbCopy > cb)
+        {
+            cbCopy = cb;
+        }
+
+        memcpy_s(pWrite->pbData + pWrite->cbData, CAB_WRITE_SLOT_SIZE - pWrite->cbData, pb, cbCopy);
+        pWrite->cbData += cbCopy;
+        pb += cbCopy;
+        cb -= cbCopy;
+
+        if (CAB_WRITE_SLOT_SIZE == pWrite->cbData)
+        {
+            hr = PublishWriteSlot(pWriter);
+            ExitOnFailure(hr, "Failed to publish cabinet write slot.");
+        }
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT QueueTargetClose(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
+    __in_opt const FILETIME* pft
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITER* pWriter = pCabinetContext->pTargetWriter;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITE* pWrite = NULL;
+
+    hr = AcquireWriteSlot(pWriter, &pWrite);
+    ExitOnFailure(hr, "Failed to acquire cabinet write slot.");
+
+    // the slot owns the file from here on
+    pWrite->fCloseFile = TRUE;
+    pWrite->fSetFileTime = NULL != pft;
+    if (pft)
+    {
+        pWrite->ftFile = *pft;
+    }
+    pWrite->pTarget = pCabinetContext->pStreamTarget;
+
+    pCabinetContext->hTargetFile = INVALID_HANDLE_VALUE;
+    pCabinetContext->pStreamTarget = NULL;
+    pCabinetContext->wzCurrentTargetFile = NULL;
+
+    hr = PublishWriteSlot(pWriter);
+    ExitOnFailure(hr, "Failed to publish cabinet write slot.");
+
+LExit:
+    return hr;
+}
+
 static LPVOID DIAMONDAPI CabAlloc(
     __in DWORD dwSize
     )
@@ -734,14 +1391,28 @@ static UINT FAR DIAMONDAPI CabRead(
     BURN_CONTAINER_CONTEXT* pContext = vpContext;
     HANDLE hFile = (HANDLE)hf;
     DWORD cbRead = 0;
+    BURN_CONTAINER_CONTEXT_CABINET_VIRTUAL_FILE_POINTER* pVfp = GetVirtualFilePointer(&pContext->Cabinet, hFile);
 
-    ReadIfVirtualFilePointer(&pContext->Cabinet, hFile, cb);
+    if (pVfp && pContext->Cabinet.hMapping)
+    {
+        hr = ReadFromMapping(pContext, pVfp, pv, cb, &cbRead);
+        ExitOnFailure(hr, "Failed to read from container mapping during cabinet extraction.");
+    }
 
-    if (!::ReadFile(hFile, pv, cb, &cbRead, NULL))
+    // Read from the file when there is no mapping, including when a view of it could not be mapped.
+    if (!pVfp || !pContext->Cabinet.hMapping)
     {
-        ExitWithLastError(hr, "Failed to read during cabinet extraction.");
+        ReadIfVirtualFilePointer(&pContext->Cabinet, hFile, cb);
+
+        if (!::ReadFile(hFile, pv, cb, &cbRead, NULL))
+        {
+            ExitWithLastError(hr, "Failed to read during cabinet extraction.");
+        }
     }
 
+    pContext->Cabinet.qwBytesRead += cbRead;
+    ++pContext->Cabinet.cReads;
+
 LExit:
     pContext->Cabinet.hrError = hr;
     return FAILED(hr) ? -1 : cbRead;
@@ -759,12 +1430,13 @@ static UINT FAR DIAMONDAPI CabWrite(
 
     switch (pContext->Cabinet.operation)
     {
-    case BURN_CAB_OPERATION_STREAM_TO_FILE:
-        // write file
-        if (!::WriteFile(pContext->Cabinet.hTargetFile, pv, cb, &cbWrite, NULL))
-        {
-            ExitWithLastError(hr, "Failed to write during cabinet extraction.");
-        }
+    case BURN_CAB_OPERATION_STREAM_TO_FILE: __fallthrough;
+    case BURN_CAB_OPERATION_STREAMS_TO_FILES:
+        // hand the data to the writer thread
+        hr = QueueTargetWrite(&pContext->Cabinet, reinterpret_cast<const BYTE*>(pv), cb);
+        ExitOnFailure(hr, "Failed to write during cabinet extraction.");
+
+        cbWrite = cb;
         break;
 
     case BURN_CAB_OPERATION_STREAM_TO_BUFFER:
@@ -852,6 +1524,159 @@ static int FAR DIAMONDAPI CabClose(
     return 0;
 }
 
+static HRESULT MapContainer(
+    __in BURN_CONTAINER_CONTEXT* pContext
+    )
+{
+    HRESULT hr = S_OK;
+    SYSTEM_INFO systemInfo = { };
+
+    if (!pContext->qwSize)
+    {
+        ExitFunction1(hr = E_NOTIMPL);
+    }
+
+    ::GetSystemInfo(&systemInfo);
+    pContext->Cabinet.dwAllocationGranularity = systemInfo.dwAllocationGranularity;
+
+    // Only the mapping is created here, views of it are mapped as reads move through the container.
+    pContext->Cabinet.hMapping = ::CreateFileMappingW(pContext->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!pContext->Cabinet.hMapping)
+    {
+        ExitFunction1(hr = HRESULT_FROM_WIN32(::GetLastError()));
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT MapContainerView(
+    __in BURN_CONTAINER_CONTEXT* pContext,
+    __in DWORD64 qwPosition
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext = &pContext->Cabinet;
+    DWORD64 qwContainerEnd = pContext->qwOffset + pContext->qwSize;
+    DWORD64 qwViewEnd = 0;
+    ULARGE_INTEGER uliViewOffset = { };
+
+    if (pCabinetContext->pvView)
+    {
+        ::UnmapViewOfFile(pCabinetContext->pvView);
+        pCabinetContext->pvView = NULL;
+    }
+
+    // Views must start on the allocation granularity, so the view may start a little before the position.
+    pCabinetContext->qwViewOffset = qwPosition - (qwPosition % pCabinetContext->dwAllocationGranularity);
+    qwViewEnd = pCabinetContext->qwViewOffset + CAB_MAPPING_VIEW_SIZE;
+    if (qwViewEnd > qwContainerEnd)
+    {
+        qwViewEnd = qwContainerEnd;
+    }
+
+    pCabinetContext->cbView = static_cast<DWORD>(qwViewEnd - pCabinetContext->qwViewOffset);
+    uliViewOffset.QuadPart = pCabinetContext->qwViewOffset;
+
+    pCabinetContext->pvView = ::MapViewOfFile(pCabinetContext->hMapping, FILE_MAP_READ, uliViewOffset.HighPart, uliViewOffset.LowPart, pCabinetContext->cbView);
+    if (!pCabinetContext->pvView)
+    {
+        pCabinetContext->cbView = 0;
+        ExitFunction1(hr = HRESULT_FROM_WIN32(::GetLastError()));
+    }
+
+LExit:
+    return hr;
+}
+
+static void UnmapContainer(
+    __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext
+    )
+{
+    if (pCabinetContext->pvView)
+    {
+        ::UnmapViewOfFile(pCabinetContext->pvView);
+        pCabinetContext->pvView = NULL;
+    }
+
+    pCabinetContext->cbView = 0;
+    ReleaseHandle(pCabinetContext->hMapping);
+}
+
+static HRESULT ReadFromMapping(
+    __in BURN_CONTAINER_CONTEXT* pContext,
+    __in BURN_CONTAINER_CONTEXT_CABINET_VIRTUAL_FILE_POINTER* pVfp,
+    __out_bcount(cb) LPVOID pv,
+    __in DWORD cb,
+    __out DWORD* pcbRead
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext = &pContext->Cabinet;
+    DWORD64 qwContainerEnd = pContext->qwOffset + pContext->qwSize;
+    DWORD64 qwPosition = static_cast<DWORD64>(pVfp->liPosition.QuadPart);
+    DWORD cbRead = 0;
+
+    if (pVfp->liPosition.QuadPart < static_cast<LONGLONG>(pContext->qwOffset))
+    {
+        hr = E_INVALIDARG;
+        ExitOnRootFailure(hr, "Cannot read before the start of the container.");
+    }
+
+    // Like reading past the end of a file, reading past the end of the container returns what is left.
+    while (cbRead < cb && qwPosition < qwContainerEnd)
+    {
+        if (!pCabinetContext->pvView || qwPosition < pCabinetContext->qwViewOffset || pCabinetContext->qwViewOffset + pCabinetContext->cbView <= qwPosition)
+        {
+            hr = MapContainerView(pContext, qwPosition);
+            if (FAILED(hr))
+            {
+                // Nothing has been consumed yet, so the caller reads the same range from the file instead.
+                LogStringLine(REPORT_VERBOSE, "Could not map container view, reading it from the file instead, hr: 0x%x", hr);
+                UnmapContainer(pCabinetContext);
+
+                ExitFunction1(hr = S_OK);
+            }
+        }
+
+        DWORD64 qwAvailable = pCabinetContext->qwViewOffset + pCabinetContext->cbView - qwPosition;
+        DWORD cbCopy = qwAvailable < cb - cbRead ? static_cast<DWORD>(qwAvailable) : cb - cbRead;
+
+        hr = CopyFromMapping(static_cast<BYTE*>(pv) + cbRead, static_cast<const BYTE*>(pCabinetContext->pvView) + (qwPosition - pCabinetContext->qwViewOffset), cbCopy);
+        ExitOnRootFailure(hr, "Failed to copy 0x%x bytes from container mapping.", cbCopy);
+
+        cbRead += cbCopy;
+        qwPosition += cbCopy;
+    }
+
+    pVfp->liPosition.QuadPart = static_cast<LONGLONG>(qwPosition);
+    *pcbRead = cbRead;
+
+LExit:
+    return hr;
+}
+
+static HRESULT CopyFromMapping(
+    __out_bcount(cb) LPVOID pvDestination,
+    __in_bcount(cb) const BYTE* pbSource,
+    __in DWORD cb
+    )
+{
+    HRESULT hr = S_OK;
+
+    // Mapped pages are read from the file on demand, so an I/O error shows up as an exception.
+    __try
+    {
+        memcpy_s(pvDestination, cb, pbSource, cb);
+    }
+    __except (EXCEPTION_IN_PAGE_ERROR == GetExceptionCode() ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+    }
+
+    return hr;
+}
+
 static HRESULT AddVirtualFilePointer(
     __in BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext,
     __in HANDLE hFile,
@@ -30,6 +30,12 @@ HRESULT CabExtractStreamToBuffer(
 HRESULT CabExtractSkipStream(
     __in BURN_CONTAINER_CONTEXT* pContext
     );
+HRESULT CabExtractStreamsToFiles(
+    __in BURN_CONTAINER_CONTEXT* pContext,
+    __in_ecount(cTargets) BURN_CONTAINER_STREAM_TARGET* rgTargets,
+    __in DWORD cTargets,
+    __in_opt HANDLE hPriorityWrittenEvent
+    );
 HRESULT CabExtractClose(
     __in BURN_CONTAINER_CONTEXT* pContext
     );
@@ -2292,6 +2292,9 @@ static HRESULT VerifyHash(
     DWORD64 qwHashedBytes = 0;
     LPWSTR pszExpected = NULL;
     LPWSTR pszActual = NULL;
+    BURN_TRACE_SPAN traceSpan = { };
+
+    TracingSpanBegin(&traceSpan, L"VerifyHash", wzUnverifiedPayloadPath, cacheStep);
 
     hr = SendCacheBeginMessage(pfnCacheMessageHandler, pContext, cacheStep);
     ExitOnFailure(hr, "Aborted cache verify hash begin.");
@@ -2328,6 +2331,8 @@ static HRESULT VerifyHash(
 LExit:
     SendCacheCompleteMessage(pfnCacheMessageHandler, pContext, hr);
 
+    TracingSpanEnd(&traceSpan, hr);
+
     ReleaseStr(pszActual);
     ReleaseStr(pszExpected);
 
@@ -342,6 +342,26 @@ extern "C" HRESULT ContainerSkipStream(
     return hr;
 }
 
+extern "C" HRESULT ContainerStreamsToFiles(
+    __in BURN_CONTAINER_CONTEXT* pContext,
+    __in_ecount(cTargets) BURN_CONTAINER_STREAM_TARGET* rgTargets,
+    __in DWORD cTargets,
+    __in_opt HANDLE hPriorityWrittenEvent
+    )
+{
+    HRESULT hr = S_OK;
+
+    switch (pContext->type)
+    {
+    case BURN_CONTAINER_TYPE_CABINET:
+        hr = CabExtractStreamsToFiles(pContext, rgTargets, cTargets, hPriorityWrittenEvent);
+        break;
+    }
+
+//LExit:
+    return hr;
+}
+
 extern "C" HRESULT ContainerClose(
     __in BURN_CONTAINER_CONTEXT* pContext
     )
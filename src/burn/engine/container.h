@@ -49,6 +49,7 @@ enum BURN_CAB_OPERATION
     BURN_CAB_OPERATION_STREAM_TO_FILE,
     BURN_CAB_OPERATION_STREAM_TO_BUFFER,
     BURN_CAB_OPERATION_SKIP_STREAM,
+    BURN_CAB_OPERATION_STREAMS_TO_FILES,
     BURN_CAB_OPERATION_CLOSE,
 };
 
@@ -103,6 +104,46 @@ typedef struct _BURN_CONTAINER_CONTEXT_CABINET_VIRTUAL_FILE_POINTER
     LARGE_INTEGER liPosition;
 } BURN_CONTAINER_CONTEXT_CABINET_VIRTUAL_FILE_POINTER;
 
+typedef struct _BURN_CONTAINER_STREAM_TARGET
+{
+    LPCWSTR wzStreamName;
+    LPCWSTR wzTargetFile;
+    BOOL fPriority;             // written by a dedicated writer so bulk files queued ahead of it cannot delay it.
+    BOOL fExtracted;
+    DWORD64 qwWrittenTicks;     // when the file was closed on disk.
+} BURN_CONTAINER_STREAM_TARGET;
+
+typedef struct _BURN_CONTAINER_CONTEXT_CABINET_WRITE
+{
+    HANDLE hFile;
+    BYTE* pbData;
+    DWORD cbData;
+
+    BOOL fCloseFile;            // close hFile once the data is written.
+    BOOL fSetFileTime;
+    FILETIME ftFile;
+    BURN_CONTAINER_STREAM_TARGET* pTarget;
+    LPCWSTR wzFile;             // target file, used to report a failed write.
+    BOOL fStop;                 // tells the writer thread there is nothing more to write.
+} BURN_CONTAINER_CONTEXT_CABINET_WRITE;
+
+typedef struct _BURN_CONTAINER_CONTEXT_CABINET_WRITER
+{
+    struct _BURN_CONTAINER_CONTEXT_CABINET* pCabinetContext;
+
+    HANDLE hThread;
+    HANDLE hSlotFreeSemaphore;
+    HANDLE hPendingSemaphore;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITE* rgSlots;
+    DWORD cSlots;
+    DWORD iProduceSlot;
+    DWORD iConsumeSlot;
+    BOOL fProduceSlotAcquired;
+
+    DWORD64 qwBytesWritten;
+    DWORD cFileWrites;
+} BURN_CONTAINER_CONTEXT_CABINET_WRITER;
+
 typedef struct _BURN_CONTAINER_CONTEXT_CABINET
 {
     LPWSTR sczFile;
@@ -121,8 +162,39 @@ typedef struct _BURN_CONTAINER_CONTEXT_CABINET
     DWORD cbTargetBuffer;
     DWORD iTargetBuffer;
 
+    BURN_CONTAINER_STREAM_TARGET* rgStreamTargets;
+    DWORD cStreamTargets;
+    DWORD iNextStreamTarget;
+    LPWSTR sczBatchStreamName;
+    HANDLE hPriorityWrittenEvent;       // set once every priority target is closed on disk.
+    volatile LONG cPendingPriority;
+
+    // decompressed file data is handed to a small pool of writer threads, each fed through
+    // its own ring of buffers. A file stays on one writer so its writes remain in order.
+    BURN_CONTAINER_CONTEXT_CABINET_WRITER* rgWriters;
+    DWORD cWriters;
+    DWORD iNextWriter;
+    BURN_CONTAINER_CONTEXT_CABINET_WRITER* pTargetWriter;
+    BURN_CONTAINER_STREAM_TARGET* pStreamTarget;
+    LPCWSTR wzCurrentTargetFile;
+    volatile HRESULT hrWrite;
+    DWORD64 qwBytesWritten;
+    DWORD cFileWrites;
+
     BURN_CONTAINER_CONTEXT_CABINET_VIRTUAL_FILE_POINTER* rgVirtualFilePointers;
     DWORD cVirtualFilePointers;
+
+    // read-only mapping of the container file, when it could be mapped. Reads go through a bounded
+    // view that slides along the container so large containers fit in the address space of a 32-bit process.
+    HANDLE hMapping;
+    LPVOID pvView;
+    DWORD64 qwViewOffset; // file offset of the start of the view.
+    DWORD cbView;
+    DWORD dwAllocationGranularity;
+
+    ULONGLONG qwOpenTicks;
+    DWORD64 qwBytesRead;
+    DWORD cReads;
 } BURN_CONTAINER_CONTEXT_CABINET;
 
 typedef struct _BURN_CONTAINER_CONTEXT
@@ -185,6 +257,12 @@ HRESULT ContainerStreamToBuffer(
 HRESULT ContainerSkipStream(
     __in BURN_CONTAINER_CONTEXT* pContext
     );
+HRESULT ContainerStreamsToFiles(
+    __in BURN_CONTAINER_CONTEXT* pContext,
+    __in_ecount(cTargets) BURN_CONTAINER_STREAM_TARGET* rgTargets,
+    __in DWORD cTargets,
+    __in_opt HANDLE hPriorityWrittenEvent
+    );
 HRESULT ContainerClose(
     __in BURN_CONTAINER_CONTEXT* pContext
     );
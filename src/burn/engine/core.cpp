@@ -96,25 +96,38 @@ extern "C" HRESULT CoreInitialize(
     LPWSTR sczStreamName = NULL;
     BYTE* pbBuffer = NULL;
     SIZE_T cbBuffer = 0;
-    BURN_CONTAINER_CONTEXT containerContext = { };
+    BURN_CONTAINER_CONTEXT* pContainerContext = NULL;
     LPWSTR sczSourceProcessFolder = NULL;
+    MEM_ARENA_HANDLE hPreviousArena = NULL;
 
     // Initialize variables.
     hr = VariableInitialize(&pEngineState->variables);
     ExitOnFailure(hr, "Failed to initialize variables.");
 
-    // Open attached UX container.
-    hr = ContainerOpenUX(&pEngineState->section, &containerContext);
+    // Open attached UX container. It is allocated so the UX payloads can keep extracting after this returns.
+    pContainerContext = (BURN_CONTAINER_CONTEXT*)MemAlloc(sizeof(BURN_CONTAINER_CONTEXT), TRUE);
+    ExitOnNull(pContainerContext, hr, E_OUTOFMEMORY, "Failed to allocate UX container context.");
+
+    hr = ContainerOpenUX(&pEngineState->section, pContainerContext);
     ExitOnFailure(hr, "Failed to open attached UX container.");
 
     // Load manifest.
-    hr = ContainerNextStream(&containerContext, &sczStreamName);
+    hr = ContainerNextStream(pContainerContext, &sczStreamName);
     ExitOnFailure(hr, "Failed to open manifest stream.");
 
-    hr = ContainerStreamToBuffer(&containerContext, &pbBuffer, &cbBuffer);
+    hr = ContainerStreamToBuffer(pContainerContext, &pbBuffer, &cbBuffer);
     ExitOnFailure(hr, "Failed to get manifest stream from container.");
 
+    // Everything parsed from the manifest lives until UninitializeEngineState, so carve it out of an arena
+    // that is released in one shot instead of making tens of thousands of small heap allocations. Size the
+    // reservation from the manifest so small bundles do not tie up address space; anything past it falls
+    // back to the process heap.
+    hr = MemArenaCreate(cbBuffer * 4, &pEngineState->hManifestArena);
+    ExitOnFailure(hr, "Failed to create manifest arena.");
+
+    hPreviousArena = MemArenaBeginScope(pEngineState->hManifestArena);
     hr = ManifestLoadXmlFromBuffer(pbBuffer, cbBuffer, pEngineState);
+    MemArenaEndScope(hPreviousArena);
     ExitOnFailure(hr, "Failed to load manifest.");
 
     hr = ContainersInitialize(&pEngineState->containers, &pEngineState->section);
@@ -182,8 +195,11 @@ extern "C" HRESULT CoreInitialize(
         hr = UserExperienceEnsureWorkingFolder(&pEngineState->cache, &pEngineState->userExperience.sczTempDirectory);
         ExitOnFailure(hr, "Failed to get unique temporary folder for bootstrapper application.");
 
-        hr = PayloadExtractUXContainer(&pEngineState->userExperience.payloads, &containerContext, pEngineState->userExperience.sczTempDirectory);
-        ExitOnFailure(hr, "Failed to extract bootstrapper application payloads.");
+        // The payloads are extracted in the background. The BA DLL is loaded as soon as it is on disk and
+        // everything else is waited for before the BA is prepared or created.
+        hr = PayloadExtractUXContainer(&pEngineState->userExperience.payloads, pContainerContext, pEngineState->userExperience.sczTempDirectory, &pEngineState->userExperience.extraction);
+        pContainerContext = NULL;
+        ExitOnFailure(hr, "Failed to start extracting bootstrapper application payloads.");
 
         hr = PathConcat(pEngineState->userExperience.sczTempDirectory, L"BootstrapperApplicationData.xml", &pEngineState->command.wzBootstrapperApplicationDataPath);
         ExitOnFailure(hr, "Failed to get BootstrapperApplicationDataPath.");
@@ -194,7 +210,11 @@ extern "C" HRESULT CoreInitialize(
 
 LExit:
     ReleaseStr(sczSourceProcessFolder);
-    ContainerClose(&containerContext);
+    if (pContainerContext)
+    {
+        ContainerClose(pContainerContext);
+        MemFree(pContainerContext);
+    }
     ReleaseStr(sczStreamName);
     ReleaseStr(sczSanitizedCommandLine);
     ReleaseMem(pbBuffer);
@@ -308,6 +328,10 @@ extern "C" HRESULT CoreDetect(
     BOOL fDetectBegan = FALSE;
     BURN_PACKAGE* pPackage = NULL;
     HRESULT hrFirstPackageFailure = S_OK;
+    BURN_TRACE_SPAN traceSpan = { };
+    BURN_TRACE_SPAN packageTraceSpan = { };
+
+    TracingSpanBegin(&traceSpan, L"CoreDetect", NULL, pEngineState->packages.cPackages);
 
     LogId(REPORT_STANDARD, MSG_DETECT_BEGIN, pEngineState->packages.cPackages);
 
@@ -320,6 +344,27 @@ extern "C" HRESULT CoreDetect(
     hr = RegistrationSetDynamicVariables(&pEngineState->registration, &pEngineState->variables);
     ExitOnFailure(hr, "Failed to reset the dynamic registration variables during detect.");
 
+    // The first detect can reuse the query results the parent bundle captured right before launching us.
+    DetectSnapshotReset(&pEngineState->detectSnapshot);
+
+    if (pEngineState->internalCommand.sczDetectSnapshotFile)
+    {
+        hr = DetectSnapshotLoad(&pEngineState->detectSnapshot, pEngineState->internalCommand.sczDetectSnapshotFile, pEngineState->internalCommand.fInitiallyElevated);
+        if (SUCCEEDED(hr))
+        {
+            LogStringLine(REPORT_STANDARD, "Loaded %u detect results from parent snapshot: %ls", pEngineState->detectSnapshot.cEntries, pEngineState->internalCommand.sczDetectSnapshotFile);
+        }
+        else
+        {
+            LogStringLine(REPORT_STANDARD, "Ignoring parent detect snapshot: %ls, hr: 0x%x", pEngineState->internalCommand.sczDetectSnapshotFile, hr);
+            hr = S_OK;
+        }
+
+        ReleaseNullStr(pEngineState->internalCommand.sczDetectSnapshotFile);
+    }
+
+    pEngineState->detectSnapshot.fRecording = TRUE;
+
     fDetectBegan = TRUE;
     hr = UserExperienceOnDetectBegin(&pEngineState->userExperience, pEngineState->registration.fCached, pEngineState->registration.detectedRegistrationType, pEngineState->packages.cPackages);
     ExitOnRootFailure(hr, "UX aborted detect begin.");
@@ -363,8 +408,12 @@ extern "C" HRESULT CoreDetect(
     {
         pPackage = pEngineState->packages.rgPackages + i;
 
+        TracingSpanBegin(&packageTraceSpan, L"DetectPackage", pPackage->sczId, pPackage->type);
+
         hr = DetectPackage(pEngineState, pPackage);
 
+        TracingSpanEnd(&packageTraceSpan, hr);
+
         // If the package detection failed, ensure the package state is set to unknown.
         if (FAILED(hr))
         {
@@ -430,9 +479,12 @@ LExit:
     }
 
     pEngineState->userExperience.hwndDetect = NULL;
+    pEngineState->detectSnapshot.fRecording = FALSE;
 
     LogId(REPORT_STANDARD, MSG_DETECT_COMPLETE, hr, !fDetectBegan ? "(failed)" : LoggingRegistrationTypeToString(pEngineState->registration.detectedRegistrationType), !fDetectBegan ? "(failed)" : LoggingBoolToString(pEngineState->registration.fCached), FAILED(hr) ? "(failed)" : LoggingBoolToString(pEngineState->registration.fEligibleForCleanup));
 
+    TracingSpanEnd(&traceSpan, hr);
+
     return hr;
 }
 
@@ -446,6 +498,10 @@ extern "C" HRESULT CorePlan(
     BURN_PACKAGE* pUpgradeBundlePackage = NULL;
     BURN_PACKAGE* pForwardCompatibleBundlePackage = NULL;
     BOOL fContinuePlanning = TRUE; // assume we won't skip planning due to dependencies.
+    BURN_TRACE_SPAN traceSpan = { };
+    ULONGLONG qwPlanStart = ::GetTickCount64();
+
+    TracingSpanBegin(&traceSpan, L"CorePlan", NULL, action);
 
     LogId(REPORT_STANDARD, MSG_PLAN_BEGIN, pEngineState->packages.cPackages, LoggingBurnActionToString(action));
 
@@ -560,6 +616,9 @@ extern "C" HRESULT CorePlan(
                 // Schedule the update of related bundles last.
                 hr = PlanRelatedBundlesComplete(&pEngineState->userExperience, &pEngineState->registration, &pEngineState->plan, &pEngineState->log, &pEngineState->variables, dwExecuteActionEarlyIndex);
                 ExitOnFailure(hr, "Failed to schedule related bundles.");
+
+                // Now that every execute action is in place, find the ones that can run concurrently.
+                PlanParallelExecuteActions(&pEngineState->plan);
             }
         }
     }
@@ -583,8 +642,12 @@ LExit:
         UserExperienceOnPlanComplete(&pEngineState->userExperience, hr);
     }
 
+    // Includes the time spent in BA plan callbacks, which is what a re-plan costs the UI.
+    LogId(REPORT_VERBOSE, MSG_PLAN_TIMING, static_cast<DWORD>(::GetTickCount64() - qwPlanStart), pEngineState->packages.cPackages, pEngineState->plan.cExecuteActions, pEngineState->plan.cRollbackActions, pEngineState->plan.cCacheActions);
     LogId(REPORT_STANDARD, MSG_PLAN_COMPLETE, hr);
 
+    TracingSpanEnd(&traceSpan, hr);
+
     return hr;
 }
 
@@ -613,6 +676,9 @@ extern "C" HRESULT CoreElevate(
         }
         ExitOnFailure(hr, "Failed to actually elevate.");
 
+        // A new elevated process needs all of the variables on the first sync.
+        pEngineState->variables.qwElevatedChangeCount = 0;
+
         hr = VariableSetNumeric(&pEngineState->variables, BURN_BUNDLE_ELEVATED, TRUE, TRUE);
         ExitOnFailure(hr, "Failed to overwrite the %ls built-in variable.", BURN_BUNDLE_ELEVATED);
     }
@@ -1161,6 +1227,13 @@ extern "C" HRESULT CoreCreateCleanRoomCommandLine(
         ExitOnFailure(hr, "Failed to append ignored dependencies to command-line.");
     }
 
+    hr = CoreAppendDetectSnapshotToCommandLine(pInternalCommand->sczDetectSnapshotFile, psczCommandLine);
+    ExitOnFailure(hr, "Failed to append %ls", BURN_COMMANDLINE_SWITCH_DETECT_SNAPSHOT);
+
+    // The clean room process does all the work, so it writes the trace instead of this process.
+    hr = CoreAppendTraceToCommandLine(pInternalCommand->sczTraceFile, psczCommandLine);
+    ExitOnFailure(hr, "Failed to append %ls", BURN_COMMANDLINE_SWITCH_TRACE);
+
     hr = CoreRecreateCommandLine(psczCommandLine, pCommand->action, pInternalCommand, pCommand, pCommand->relationType, pCommand->fPassthrough);
     ExitOnFailure(hr, "Failed to recreate clean room command-line.");
 
@@ -1331,6 +1404,46 @@ LExit:
     return hr;
 }
 
+extern "C" HRESULT CoreAppendDetectSnapshotToCommandLine(
+    __in_z_opt LPCWSTR wzDetectSnapshotFile,
+    __deref_inout_z LPWSTR* psczCommandLine
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (wzDetectSnapshotFile && *wzDetectSnapshotFile)
+    {
+        hr = StrAllocConcatFormatted(psczCommandLine, L" -%ls", BURN_COMMANDLINE_SWITCH_DETECT_SNAPSHOT);
+        ExitOnFailure(hr, "Failed to append the detect snapshot switch to the command line.");
+
+        hr = AppAppendCommandLineArgument(psczCommandLine, wzDetectSnapshotFile);
+        ExitOnFailure(hr, "Failed to append the detect snapshot path to the command line.");
+    }
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT CoreAppendTraceToCommandLine(
+    __in_z_opt LPCWSTR wzTraceFile,
+    __deref_inout_z LPWSTR* psczCommandLine
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (wzTraceFile && *wzTraceFile)
+    {
+        hr = StrAllocConcatFormatted(psczCommandLine, L" -%ls", BURN_COMMANDLINE_SWITCH_TRACE);
+        ExitOnFailure(hr, "Failed to append the trace switch to the command line.");
+
+        hr = AppAppendCommandLineArgument(psczCommandLine, wzTraceFile);
+        ExitOnFailure(hr, "Failed to append the trace path to the command line.");
+    }
+
+LExit:
+    return hr;
+}
+
 
 extern "C" void CoreCleanup(
     __in BURN_ENGINE_STATE* pEngineState
@@ -1559,6 +1672,32 @@ extern "C" HRESULT CoreParseCommandLine(
 
                 pInternalCommand->dwLoggingAttributes |= BURN_LOGGING_ATTRIBUTE_APPEND;
             }
+            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, &argv[i][1], -1, BURN_COMMANDLINE_SWITCH_TRACE, -1))
+            {
+                if (i + 1 >= argc)
+                {
+                    fInvalidCommandLine = TRUE;
+                    ExitOnRootFailure(hr = E_INVALIDARG, "Must specify a path for trace file.");
+                }
+
+                ++i;
+
+                hr = PathExpand(&pInternalCommand->sczTraceFile, argv[i], PATH_EXPAND_FULLPATH);
+                ExitOnFailure(hr, "Failed to copy trace file path.");
+            }
+            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, &argv[i][1], -1, BURN_COMMANDLINE_SWITCH_DETECT_SNAPSHOT, -1))
+            {
+                if (i + 1 >= argc)
+                {
+                    fInvalidCommandLine = TRUE;
+                    ExitOnRootFailure(hr = E_INVALIDARG, "Must specify a path for detect snapshot.");
+                }
+
+                ++i;
+
+                hr = PathExpand(&pInternalCommand->sczDetectSnapshotFile, argv[i], PATH_EXPAND_FULLPATH);
+                ExitOnFailure(hr, "Failed to copy detect snapshot path.");
+            }
             else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, &argv[i][1], lstrlenW(BURN_COMMANDLINE_SWITCH_LOG_MODE), BURN_COMMANDLINE_SWITCH_LOG_MODE, -1))
             {
                 // Get a pointer to the next character after the switch.
@@ -2216,7 +2355,7 @@ static HRESULT DetectPackage(
         break;
 
     case BURN_PACKAGE_TYPE_MSI:
-        hr = MsiEngineDetectPackage(pPackage, &pEngineState->registration, &pEngineState->userExperience);
+        hr = MsiEngineDetectPackage(pPackage, &pEngineState->registration, &pEngineState->userExperience, &pEngineState->detectSnapshot);
         break;
 
     case BURN_PACKAGE_TYPE_MSP:
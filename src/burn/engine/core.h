@@ -20,6 +20,8 @@ const LPCWSTR BURN_COMMANDLINE_SWITCH_EMBEDDED = L"burn.embedded";
 const LPCWSTR BURN_COMMANDLINE_SWITCH_RUNONCE = L"burn.runonce";
 const LPCWSTR BURN_COMMANDLINE_SWITCH_LOG_APPEND = L"burn.log.append";
 const LPCWSTR BURN_COMMANDLINE_SWITCH_LOG_MODE = L"burn.log.mode";
+const LPCWSTR BURN_COMMANDLINE_SWITCH_TRACE = L"burn.trace";
+const LPCWSTR BURN_COMMANDLINE_SWITCH_DETECT_SNAPSHOT = L"burn.detect.snapshot";
 const LPCWSTR BURN_COMMANDLINE_SWITCH_RELATED_DETECT = L"burn.related.detect";
 const LPCWSTR BURN_COMMANDLINE_SWITCH_RELATED_UPGRADE = L"burn.related.upgrade";
 const LPCWSTR BURN_COMMANDLINE_SWITCH_RELATED_ADDON = L"burn.related.addon";
@@ -110,6 +112,9 @@ typedef struct _BURN_ENGINE_COMMAND
 
     DWORD dwLoggingAttributes;
     LPWSTR sczLogFile;
+
+    LPWSTR sczTraceFile;
+    LPWSTR sczDetectSnapshotFile;
 } BURN_ENGINE_COMMAND;
 
 typedef struct _BURN_ENGINE_STATE
@@ -153,7 +158,12 @@ typedef struct _BURN_ENGINE_STATE
 
     BURN_PLAN plan;
 
+    BURN_DETECT_SNAPSHOT detectSnapshot;
+
     DWORD dwElevatedLoggingTlsId;
+    CRITICAL_SECTION csElevatedPipe; // serializes messages the elevated process sends its companion from more than one thread.
+
+    MEM_ARENA_HANDLE hManifestArena;
 
     LPWSTR sczBundleEngineWorkingPath;
     BURN_PIPE_CONNECTION companionConnection;
@@ -288,6 +298,14 @@ HRESULT CoreAppendEngineWorkingDirectoryToCommandLine(
     __deref_inout_z LPWSTR* psczCommandLine,
     __deref_inout_z_opt LPWSTR* psczObfuscatedCommandLine
     );
+HRESULT CoreAppendDetectSnapshotToCommandLine(
+    __in_z_opt LPCWSTR wzDetectSnapshotFile,
+    __deref_inout_z LPWSTR* psczCommandLine
+    );
+HRESULT CoreAppendTraceToCommandLine(
+    __in_z_opt LPCWSTR wzTraceFile,
+    __deref_inout_z LPWSTR* psczCommandLine
+    );
 void CoreCleanup(
     __in BURN_ENGINE_STATE* pEngineState
     );
@@ -30,6 +30,32 @@ static HRESULT DownloadUpdateFeed(
     __deref_inout_z LPWSTR* psczTempFile
     );
 
+static BOOL IsCacheableQueryResult(
+    __in HRESULT hrResult
+    );
+
+static HRESULT FindSnapshotEntry(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzKey,
+    __out BURN_DETECT_SNAPSHOT_ENTRY** ppEntry
+    );
+
+static HRESULT AddSnapshotEntry(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzKey,
+    __in HRESULT hrResult,
+    __in_z_opt LPCWSTR wzValue,
+    __in DWORD dwValue,
+    __out_opt BURN_DETECT_SNAPSHOT_ENTRY** ppEntry
+    );
+
+static HRESULT GetCurrentUserSid(
+    __deref_out_z LPWSTR* psczSid
+    );
+static HRESULT VerifySnapshotOwner(
+    __in_z LPCWSTR wzFile
+    );
+
 // function definitions
 
 extern "C" void DetectReset(
@@ -247,6 +273,396 @@ LExit:
     return hr;
 }
 
+extern "C" void DetectSnapshotInitialize(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot
+    )
+{
+    ::InitializeCriticalSection(&pSnapshot->csSnapshot);
+}
+
+extern "C" void DetectSnapshotUninitialize(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot
+    )
+{
+    DetectSnapshotReset(pSnapshot);
+
+    ReleaseStr(pSnapshot->sczFile);
+    ::DeleteCriticalSection(&pSnapshot->csSnapshot);
+
+    // clear struct
+    memset(pSnapshot, 0, sizeof(BURN_DETECT_SNAPSHOT));
+}
+
+extern "C" void DetectSnapshotReset(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot
+    )
+{
+    ReleaseNullDict(pSnapshot->sdEntries);
+
+    for (DWORD i = 0; i < pSnapshot->cEntries; ++i)
+    {
+        BURN_DETECT_SNAPSHOT_ENTRY* pEntry = pSnapshot->rgEntries + i;
+
+        ReleaseStr(pEntry->sczKey);
+        ReleaseStr(pEntry->sczValue);
+    }
+
+    ReleaseNullMem(pSnapshot->rgEntries);
+    pSnapshot->cEntries = 0;
+
+    pSnapshot->fRecording = FALSE;
+    pSnapshot->fStale = FALSE;
+    pSnapshot->fWritten = FALSE;
+}
+
+extern "C" HRESULT DetectSnapshotLoad(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzFile,
+    __in BOOL fElevated
+    )
+{
+    HRESULT hr = S_OK;
+    BYTE* pbBuffer = NULL;
+    SIZE_T cbBuffer = 0;
+    SIZE_T iBuffer = 0;
+    DWORD dwVersion = 0;
+    DWORD64 qwCreated = 0;
+    ULARGE_INTEGER uliNow = { };
+    FILETIME ftNow = { };
+    LPWSTR sczSnapshotSid = NULL;
+    LPWSTR sczCurrentSid = NULL;
+    DWORD cEntries = 0;
+    LPWSTR sczKey = NULL;
+    DWORD dwResult = 0;
+    LPWSTR sczValue = NULL;
+    DWORD dwValue = 0;
+
+    DetectSnapshotReset(pSnapshot);
+
+    // An elevated bundle must not trust a snapshot that a non-elevated process could have written.
+    if (fElevated)
+    {
+        hr = VerifySnapshotOwner(wzFile);
+        ExitOnFailure(hr, "Failed to verify detect snapshot owner.");
+    }
+
+    hr = FileRead(&pbBuffer, &cbBuffer, wzFile);
+    ExitOnFailure(hr, "Failed to read detect snapshot: %ls", wzFile);
+
+    hr = BuffReadNumber(pbBuffer, cbBuffer, &iBuffer, &dwVersion);
+    ExitOnFailure(hr, "Failed to read detect snapshot version.");
+
+    if (BURN_DETECT_SNAPSHOT_VERSION != dwVersion)
+    {
+        ExitWithRootFailure(hr, E_INVALIDDATA, "Unsupported detect snapshot version: %u", dwVersion);
+    }
+
+    hr = BuffReadNumber64(pbBuffer, cbBuffer, &iBuffer, &qwCreated);
+    ExitOnFailure(hr, "Failed to read detect snapshot creation time.");
+
+    // Anything else may have changed the machine since the parent's detect, so only trust recent snapshots.
+    ::GetSystemTimeAsFileTime(&ftNow);
+    uliNow.LowPart = ftNow.dwLowDateTime;
+    uliNow.HighPart = ftNow.dwHighDateTime;
+
+    if (uliNow.QuadPart < qwCreated || (uliNow.QuadPart - qwCreated) / 10000000ULL > BURN_DETECT_SNAPSHOT_MAX_AGE_SECONDS)
+    {
+        ExitWithRootFailure(hr, E_INVALIDDATA, "Detect snapshot is too old to use.");
+    }
+
+    // Per-user Windows Installer queries are only valid for the user that made them.
+    hr = BuffReadString(pbBuffer, cbBuffer, &iBuffer, &sczSnapshotSid);
+    ExitOnFailure(hr, "Failed to read detect snapshot user.");
+
+    hr = GetCurrentUserSid(&sczCurrentSid);
+    ExitOnFailure(hr, "Failed to get current user.");
+
+    if (CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, sczSnapshotSid, -1, sczCurrentSid, -1))
+    {
+        ExitWithRootFailure(hr, E_INVALIDDATA, "Detect snapshot was captured for a different user: %ls", sczSnapshotSid);
+    }
+
+    hr = BuffReadNumber(pbBuffer, cbBuffer, &iBuffer, &cEntries);
+    ExitOnFailure(hr, "Failed to read detect snapshot entry count.");
+
+    for (DWORD i = 0; i < cEntries; ++i)
+    {
+        hr = BuffReadString(pbBuffer, cbBuffer, &iBuffer, &sczKey);
+        ExitOnFailure(hr, "Failed to read detect snapshot key.");
+
+        hr = BuffReadNumber(pbBuffer, cbBuffer, &iBuffer, &dwResult);
+        ExitOnFailure(hr, "Failed to read detect snapshot result.");
+
+        hr = BuffReadString(pbBuffer, cbBuffer, &iBuffer, &sczValue);
+        ExitOnFailure(hr, "Failed to read detect snapshot value.");
+
+        hr = BuffReadNumber(pbBuffer, cbBuffer, &iBuffer, &dwValue);
+        ExitOnFailure(hr, "Failed to read detect snapshot number.");
+
+        if (!IsCacheableQueryResult(static_cast<HRESULT>(dwResult)))
+        {
+            ExitWithRootFailure(hr, E_INVALIDDATA, "Detect snapshot contains an unexpected result: 0x%x", dwResult);
+        }
+
+        hr = AddSnapshotEntry(pSnapshot, sczKey, static_cast<HRESULT>(dwResult), sczValue, dwValue, NULL);
+        ExitOnFailure(hr, "Failed to add detect snapshot entry: %ls", sczKey);
+    }
+
+LExit:
+    if (FAILED(hr))
+    {
+        DetectSnapshotReset(pSnapshot);
+    }
+
+    ReleaseStr(sczValue);
+    ReleaseStr(sczKey);
+    ReleaseStr(sczCurrentSid);
+    ReleaseStr(sczSnapshotSid);
+    ReleaseMem(pbBuffer);
+
+    return hr;
+}
+
+extern "C" HRESULT DetectSnapshotSave(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzFile
+    )
+{
+    HRESULT hr = S_OK;
+    BYTE* pbBuffer = NULL;
+    SIZE_T cbBuffer = 0;
+    FILETIME ftNow = { };
+    ULARGE_INTEGER uliNow = { };
+    LPWSTR sczSid = NULL;
+
+    ::GetSystemTimeAsFileTime(&ftNow);
+    uliNow.LowPart = ftNow.dwLowDateTime;
+    uliNow.HighPart = ftNow.dwHighDateTime;
+
+    hr = GetCurrentUserSid(&sczSid);
+    ExitOnFailure(hr, "Failed to get current user.");
+
+    hr = BuffWriteNumber(&pbBuffer, &cbBuffer, BURN_DETECT_SNAPSHOT_VERSION);
+    ExitOnFailure(hr, "Failed to write detect snapshot version.");
+
+    hr = BuffWriteNumber64(&pbBuffer, &cbBuffer, uliNow.QuadPart);
+    ExitOnFailure(hr, "Failed to write detect snapshot creation time.");
+
+    hr = BuffWriteString(&pbBuffer, &cbBuffer, sczSid);
+    ExitOnFailure(hr, "Failed to write detect snapshot user.");
+
+    hr = BuffWriteNumber(&pbBuffer, &cbBuffer, pSnapshot->cEntries);
+    ExitOnFailure(hr, "Failed to write detect snapshot entry count.");
+
+    for (DWORD i = 0; i < pSnapshot->cEntries; ++i)
+    {
+        BURN_DETECT_SNAPSHOT_ENTRY* pEntry = pSnapshot->rgEntries + i;
+
+        hr = BuffWriteString(&pbBuffer, &cbBuffer, pEntry->sczKey);
+        ExitOnFailure(hr, "Failed to write detect snapshot key.");
+
+        hr = BuffWriteNumber(&pbBuffer, &cbBuffer, static_cast<DWORD>(pEntry->hrResult));
+        ExitOnFailure(hr, "Failed to write detect snapshot result.");
+
+        hr = BuffWriteString(&pbBuffer, &cbBuffer, pEntry->sczValue);
+        ExitOnFailure(hr, "Failed to write detect snapshot value.");
+
+        hr = BuffWriteNumber(&pbBuffer, &cbBuffer, pEntry->dwValue);
+        ExitOnFailure(hr, "Failed to write detect snapshot number.");
+    }
+
+    hr = FileWrite(wzFile, FILE_ATTRIBUTE_NORMAL, pbBuffer, cbBuffer, NULL);
+    ExitOnFailure(hr, "Failed to write detect snapshot: %ls", wzFile);
+
+LExit:
+    ReleaseStr(sczSid);
+    ReleaseBuffer(pbBuffer);
+
+    return hr;
+}
+
+extern "C" HRESULT DetectSnapshotBeginExecute(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z_opt LPCWSTR wzWorkingFolder,
+    __deref_opt_out_z_opt LPWSTR* psczChildSnapshotFile
+    )
+{
+    HRESULT hr = S_OK;
+
+    ::EnterCriticalSection(&pSnapshot->csSnapshot);
+
+    if (psczChildSnapshotFile)
+    {
+        ReleaseNullStr(*psczChildSnapshotFile);
+
+        // Only hand the snapshot to the child if nothing has executed since detect.
+        if (!pSnapshot->fStale && pSnapshot->cEntries && wzWorkingFolder)
+        {
+            if (!pSnapshot->fWritten)
+            {
+                hr = PathConcatRelativeToFullyQualifiedBase(wzWorkingFolder, BURN_DETECT_SNAPSHOT_FILE_NAME, &pSnapshot->sczFile);
+                ExitOnFailure(hr, "Failed to build detect snapshot path.");
+
+                hr = DetectSnapshotSave(pSnapshot, pSnapshot->sczFile);
+                ExitOnFailure(hr, "Failed to save detect snapshot.");
+
+                pSnapshot->fWritten = TRUE;
+            }
+
+            hr = StrAllocString(psczChildSnapshotFile, pSnapshot->sczFile, 0);
+            ExitOnFailure(hr, "Failed to copy detect snapshot path.");
+        }
+    }
+
+LExit:
+    // Whatever happens next may change the machine state the snapshot describes.
+    pSnapshot->fStale = TRUE;
+
+    ::LeaveCriticalSection(&pSnapshot->csSnapshot);
+
+    return hr;
+}
+
+extern "C" HRESULT DetectSnapshotGetProductInfo(
+    __in_opt BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzProductCode,
+    __in MSIINSTALLCONTEXT context,
+    __in_z LPCWSTR wzProperty,
+    __deref_out_z LPWSTR* psczValue
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrQuery = S_OK;
+    LPWSTR sczKey = NULL;
+    LPWSTR sczValue = NULL;
+    BURN_DETECT_SNAPSHOT_ENTRY* pEntry = NULL;
+
+    if (!pSnapshot || !pSnapshot->fRecording)
+    {
+        ExitFunction1(hr = WiuGetProductInfoEx(wzProductCode, NULL, context, wzProperty, psczValue));
+    }
+
+    hr = StrAllocFormatted(&sczKey, L"ProductInfo\t%ls\t%u\t%ls", wzProductCode, context, wzProperty);
+    ExitOnFailure(hr, "Failed to format detect snapshot key.");
+
+    hr = FindSnapshotEntry(pSnapshot, sczKey, &pEntry);
+    if (E_NOTFOUND == hr)
+    {
+        hrQuery = WiuGetProductInfoEx(wzProductCode, NULL, context, wzProperty, &sczValue);
+        if (!IsCacheableQueryResult(hrQuery))
+        {
+            ExitFunction1(hr = hrQuery);
+        }
+
+        hr = AddSnapshotEntry(pSnapshot, sczKey, hrQuery, sczValue, 0, &pEntry);
+    }
+    ExitOnFailure(hr, "Failed to get detect snapshot entry: %ls", sczKey);
+
+    if (SUCCEEDED(pEntry->hrResult))
+    {
+        hr = StrAllocString(psczValue, pEntry->sczValue ? pEntry->sczValue : L"", 0);
+        ExitOnFailure(hr, "Failed to copy product info from detect snapshot.");
+    }
+
+    hr = pEntry->hrResult;
+
+LExit:
+    ReleaseStr(sczValue);
+    ReleaseStr(sczKey);
+
+    return hr;
+}
+
+extern "C" HRESULT DetectSnapshotEnumRelatedProducts(
+    __in_opt BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzUpgradeCode,
+    __in DWORD iProductIndex,
+    __out_ecount(MAX_GUID_CHARS + 1) LPWSTR wzProductCode
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrQuery = S_OK;
+    LPWSTR sczKey = NULL;
+    BURN_DETECT_SNAPSHOT_ENTRY* pEntry = NULL;
+
+    if (!pSnapshot || !pSnapshot->fRecording)
+    {
+        ExitFunction1(hr = WiuEnumRelatedProducts(wzUpgradeCode, iProductIndex, wzProductCode));
+    }
+
+    hr = StrAllocFormatted(&sczKey, L"RelatedProduct\t%ls\t%u", wzUpgradeCode, iProductIndex);
+    ExitOnFailure(hr, "Failed to format detect snapshot key.");
+
+    hr = FindSnapshotEntry(pSnapshot, sczKey, &pEntry);
+    if (E_NOTFOUND == hr)
+    {
+        hrQuery = WiuEnumRelatedProducts(wzUpgradeCode, iProductIndex, wzProductCode);
+        if (!IsCacheableQueryResult(hrQuery))
+        {
+            ExitFunction1(hr = hrQuery);
+        }
+
+        hr = AddSnapshotEntry(pSnapshot, sczKey, hrQuery, SUCCEEDED(hrQuery) ? wzProductCode : NULL, 0, &pEntry);
+    }
+    ExitOnFailure(hr, "Failed to get detect snapshot entry: %ls", sczKey);
+
+    if (SUCCEEDED(pEntry->hrResult))
+    {
+        hr = ::StringCchCopyW(wzProductCode, MAX_GUID_CHARS + 1, pEntry->sczValue ? pEntry->sczValue : L"");
+        ExitOnFailure(hr, "Failed to copy related product code from detect snapshot.");
+    }
+
+    hr = pEntry->hrResult;
+
+LExit:
+    ReleaseStr(sczKey);
+
+    return hr;
+}
+
+extern "C" HRESULT DetectSnapshotQueryFeatureState(
+    __in_opt BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzProductCode,
+    __in_z LPCWSTR wzFeature,
+    __out INSTALLSTATE* pInstallState
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrQuery = S_OK;
+    LPWSTR sczKey = NULL;
+    INSTALLSTATE installState = INSTALLSTATE_UNKNOWN;
+    BURN_DETECT_SNAPSHOT_ENTRY* pEntry = NULL;
+
+    if (!pSnapshot || !pSnapshot->fRecording)
+    {
+        ExitFunction1(hr = WiuQueryFeatureState(wzProductCode, wzFeature, pInstallState));
+    }
+
+    hr = StrAllocFormatted(&sczKey, L"FeatureState\t%ls\t%ls", wzProductCode, wzFeature);
+    ExitOnFailure(hr, "Failed to format detect snapshot key.");
+
+    hr = FindSnapshotEntry(pSnapshot, sczKey, &pEntry);
+    if (E_NOTFOUND == hr)
+    {
+        hrQuery = WiuQueryFeatureState(wzProductCode, wzFeature, &installState);
+        if (!IsCacheableQueryResult(hrQuery))
+        {
+            ExitFunction1(hr = hrQuery);
+        }
+
+        hr = AddSnapshotEntry(pSnapshot, sczKey, hrQuery, NULL, static_cast<DWORD>(installState), &pEntry);
+    }
+    ExitOnFailure(hr, "Failed to get detect snapshot entry: %ls", sczKey);
+
+    *pInstallState = static_cast<INSTALLSTATE>(pEntry->dwValue);
+    hr = pEntry->hrResult;
+
+LExit:
+    ReleaseStr(sczKey);
+
+    return hr;
+}
+
 static HRESULT WINAPI AuthenticationRequired(
     __in LPVOID pData,
     __in HINTERNET hUrl,
@@ -424,3 +840,147 @@ LExit:
 
     return hr;
 }
+
+static BOOL IsCacheableQueryResult(
+    __in HRESULT hrResult
+    )
+{
+    // Only remember answers that describe the machine, never transient failures.
+    return SUCCEEDED(hrResult) ||
+           E_NOMOREITEMS == hrResult ||
+           HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT) == hrResult ||
+           HRESULT_FROM_WIN32(ERROR_UNKNOWN_PROPERTY) == hrResult;
+}
+
+static HRESULT FindSnapshotEntry(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzKey,
+    __out BURN_DETECT_SNAPSHOT_ENTRY** ppEntry
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!pSnapshot->sdEntries)
+    {
+        ExitFunction1(hr = E_NOTFOUND);
+    }
+
+    hr = DictGetValue(pSnapshot->sdEntries, wzKey, reinterpret_cast<void**>(ppEntry));
+
+LExit:
+    return hr;
+}
+
+static HRESULT AddSnapshotEntry(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzKey,
+    __in HRESULT hrResult,
+    __in_z_opt LPCWSTR wzValue,
+    __in DWORD dwValue,
+    __out_opt BURN_DETECT_SNAPSHOT_ENTRY** ppEntry
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_DETECT_SNAPSHOT_ENTRY* pEntry = NULL;
+
+    if (!pSnapshot->sdEntries)
+    {
+        hr = DictCreateWithEmbeddedKey(&pSnapshot->sdEntries, 0, reinterpret_cast<void**>(&pSnapshot->rgEntries), offsetof(BURN_DETECT_SNAPSHOT_ENTRY, sczKey), DICT_FLAG_CASEINSENSITIVE);
+        ExitOnFailure(hr, "Failed to create detect snapshot dictionary.");
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pSnapshot->rgEntries), pSnapshot->cEntries, 1, sizeof(BURN_DETECT_SNAPSHOT_ENTRY), 32);
+    ExitOnFailure(hr, "Failed to grow detect snapshot.");
+
+    pEntry = pSnapshot->rgEntries + pSnapshot->cEntries;
+    memset(pEntry, 0, sizeof(BURN_DETECT_SNAPSHOT_ENTRY));
+
+    hr = StrAllocString(&pEntry->sczKey, wzKey, 0);
+    ExitOnFailure(hr, "Failed to copy detect snapshot key.");
+
+    if (wzValue && *wzValue)
+    {
+        hr = StrAllocString(&pEntry->sczValue, wzValue, 0);
+        ExitOnFailure(hr, "Failed to copy detect snapshot value.");
+    }
+
+    pEntry->hrResult = hrResult;
+    pEntry->dwValue = dwValue;
+
+    hr = DictAddValue(pSnapshot->sdEntries, pEntry);
+    ExitOnFailure(hr, "Failed to index detect snapshot entry.");
+
+    ++pSnapshot->cEntries;
+
+    if (ppEntry)
+    {
+        *ppEntry = pEntry;
+    }
+
+LExit:
+    if (FAILED(hr) && pEntry)
+    {
+        ReleaseNullStr(pEntry->sczKey);
+        ReleaseNullStr(pEntry->sczValue);
+    }
+
+    return hr;
+}
+
+static HRESULT GetCurrentUserSid(
+    __deref_out_z LPWSTR* psczSid
+    )
+{
+    HRESULT hr = S_OK;
+    TOKEN_USER* pTokenUser = NULL;
+    LPWSTR pwzSid = NULL;
+
+    hr = ProcTokenUser(::GetCurrentProcess(), &pTokenUser);
+    ExitOnFailure(hr, "Failed to get user from process token.");
+
+    if (!::ConvertSidToStringSidW(pTokenUser->User.Sid, &pwzSid))
+    {
+        ExitWithLastError(hr, "Failed to convert user SID to string.");
+    }
+
+    hr = StrAllocString(psczSid, pwzSid, 0);
+    ExitOnFailure(hr, "Failed to copy user SID.");
+
+LExit:
+    if (pwzSid)
+    {
+        ::LocalFree(pwzSid);
+    }
+
+    ReleaseMem(pTokenUser);
+
+    return hr;
+}
+
+static HRESULT VerifySnapshotOwner(
+    __in_z LPCWSTR wzFile
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    PSID pOwner = NULL;
+    PSECURITY_DESCRIPTOR pSecurityDescriptor = NULL;
+
+    er = ::GetNamedSecurityInfoW(wzFile, SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION, &pOwner, NULL, NULL, NULL, &pSecurityDescriptor);
+    ExitOnWin32Error(er, hr, "Failed to get owner of detect snapshot: %ls", wzFile);
+
+    // Files created by an elevated process are owned by the Administrators group (or SYSTEM), which
+    // a non-elevated process cannot assign.
+    if (!::IsWellKnownSid(pOwner, WinBuiltinAdministratorsSid) && !::IsWellKnownSid(pOwner, WinLocalSystemSid))
+    {
+        ExitWithRootFailure(hr, E_ACCESSDENIED, "Detect snapshot was not written by an elevated process: %ls", wzFile);
+    }
+
+LExit:
+    if (pSecurityDescriptor)
+    {
+        ::LocalFree(pSecurityDescriptor);
+    }
+
+    return hr;
+}
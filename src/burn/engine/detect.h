@@ -9,9 +9,37 @@ extern "C" {
 
 // constants
 
+const DWORD BURN_DETECT_SNAPSHOT_VERSION = 1;
+const DWORD BURN_DETECT_SNAPSHOT_MAX_AGE_SECONDS = 10 * 60;
+const LPCWSTR BURN_DETECT_SNAPSHOT_FILE_NAME = L"detect.snapshot";
+
 
 // structs
 
+typedef struct _BURN_DETECT_SNAPSHOT_ENTRY
+{
+    LPWSTR sczKey;
+    HRESULT hrResult;
+    LPWSTR sczValue;
+    DWORD dwValue;
+} BURN_DETECT_SNAPSHOT_ENTRY;
+
+// Results of the Windows Installer queries made during detect. A parent bundle
+// hands the snapshot to the child bundles it launches so they can skip the same
+// queries, as long as no package has executed since the parent's detect.
+typedef struct _BURN_DETECT_SNAPSHOT
+{
+    CRITICAL_SECTION csSnapshot;
+    BOOL fRecording;
+    BOOL fStale;
+    BOOL fWritten;
+    LPWSTR sczFile;
+
+    BURN_DETECT_SNAPSHOT_ENTRY* rgEntries;
+    DWORD cEntries;
+    STRINGDICT_HANDLE sdEntries;
+} BURN_DETECT_SNAPSHOT;
+
 
 // functions
 
@@ -38,6 +66,57 @@ HRESULT DetectUpdate(
     __in BURN_UPDATE* pUpdate
     );
 
+void DetectSnapshotInitialize(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot
+    );
+
+void DetectSnapshotUninitialize(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot
+    );
+
+void DetectSnapshotReset(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot
+    );
+
+HRESULT DetectSnapshotLoad(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzFile,
+    __in BOOL fElevated
+    );
+
+HRESULT DetectSnapshotSave(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzFile
+    );
+
+HRESULT DetectSnapshotBeginExecute(
+    __in BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z_opt LPCWSTR wzWorkingFolder,
+    __deref_opt_out_z_opt LPWSTR* psczChildSnapshotFile
+    );
+
+HRESULT DetectSnapshotGetProductInfo(
+    __in_opt BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzProductCode,
+    __in MSIINSTALLCONTEXT context,
+    __in_z LPCWSTR wzProperty,
+    __deref_out_z LPWSTR* psczValue
+    );
+
+HRESULT DetectSnapshotEnumRelatedProducts(
+    __in_opt BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzUpgradeCode,
+    __in DWORD iProductIndex,
+    __out_ecount(MAX_GUID_CHARS + 1) LPWSTR wzProductCode
+    );
+
+HRESULT DetectSnapshotQueryFeatureState(
+    __in_opt BURN_DETECT_SNAPSHOT* pSnapshot,
+    __in_z LPCWSTR wzProductCode,
+    __in_z LPCWSTR wzFeature,
+    __out INSTALLSTATE* pInstallState
+    );
+
 #if defined(__cplusplus)
 }
 #endif
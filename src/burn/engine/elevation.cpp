@@ -92,6 +92,7 @@ typedef struct _BURN_ELEVATION_CHILD_MESSAGE_CONTEXT
 {
     DWORD dwLoggingTlsId;
     HANDLE hPipe;
+    CRITICAL_SECTION* pcsPipe; // serializes sends on hPipe with logging from other threads.
     HANDLE* phLock;
     BOOL* pfDisabledAutomaticUpdates;
     BOOL* pfApplying;
@@ -264,7 +265,7 @@ static HRESULT OnExecuteExePackage(
     __in SIZE_T cbData
     );
 static HRESULT OnExecuteMsiPackage(
-    __in HANDLE hPipe,
+    __in BURN_ELEVATION_CHILD_MESSAGE_CONTEXT* pContext,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -272,7 +273,7 @@ static HRESULT OnExecuteMsiPackage(
     __in SIZE_T cbData
     );
 static HRESULT OnExecuteMspPackage(
-    __in HANDLE hPipe,
+    __in BURN_ELEVATION_CHILD_MESSAGE_CONTEXT* pContext,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -288,7 +289,7 @@ static HRESULT OnExecuteMsuPackage(
     __in SIZE_T cbData
     );
 static HRESULT OnUninstallMsiCompatiblePackage(
-    __in HANDLE hPipe,
+    __in BURN_ELEVATION_CHILD_MESSAGE_CONTEXT* pContext,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -379,6 +380,18 @@ static HRESULT ElevatedOnSystemRestorePointComplete(
     __in HANDLE hPipe,
     __in HRESULT hrStatus
     );
+static HRESULT WriteDetectSnapshot(
+    __deref_inout_bcount(*pcbData) BYTE** ppbData,
+    __inout SIZE_T* pcbData,
+    __in_z_opt LPCWSTR wzDetectSnapshot
+    );
+static HRESULT ReadDetectSnapshot(
+    __in BURN_CACHE* pCache,
+    __in_bcount(cbData) BYTE* pbData,
+    __in SIZE_T cbData,
+    __inout SIZE_T* piData,
+    __deref_out_z_opt LPWSTR* psczDetectSnapshot
+    );
 
 
 // function definitions
@@ -462,6 +475,7 @@ extern "C" HRESULT ElevationApplyInitialize(
     HRESULT hr = S_OK;
     BYTE* pbData = NULL;
     SIZE_T cbData = 0;
+    DWORD64 qwVariablesChangeCount = 0;
     DWORD dwResult = 0;
     BURN_ELEVATION_APPLY_INITIALIZE_MESSAGE_CONTEXT context = { };
 
@@ -477,13 +491,15 @@ extern "C" HRESULT ElevationApplyInitialize(
     hr = BuffWriteNumber(&pbData, &cbData, (DWORD)!pPlan->pInternalCommand->fDisableSystemRestore);
     ExitOnFailure(hr, "Failed to write system restore point action to message buffer.");
     
-    hr = VariableSerialize(pVariables, FALSE, &pbData, &cbData);
+    hr = VariableSerializeChanges(pVariables, pVariables->qwElevatedChangeCount, &pbData, &cbData, &qwVariablesChangeCount);
     ExitOnFailure(hr, "Failed to write variables.");
 
     // send message
     hr = PipeSendMessage(hPipe, BURN_ELEVATION_MESSAGE_TYPE_APPLY_INITIALIZE, pbData, cbData, ProcessApplyInitializeMessages, &context, &dwResult);
     ExitOnFailure(hr, "Failed to send message to per-machine process.");
 
+    pVariables->qwElevatedChangeCount = qwVariablesChangeCount;
+
     hr = (HRESULT)dwResult;
 
     // Best effort to keep the sequence of BA events sane.
@@ -542,6 +558,7 @@ extern "C" HRESULT ElevationSessionBegin(
     HRESULT hr = S_OK;
     BYTE* pbData = NULL;
     SIZE_T cbData = 0;
+    DWORD64 qwVariablesChangeCount = 0;
     DWORD dwResult = 0;
 
     // serialize message data
@@ -566,13 +583,15 @@ extern "C" HRESULT ElevationSessionBegin(
     hr = BuffWriteNumber(&pbData, &cbData, (DWORD)registrationType);
     ExitOnFailure(hr, "Failed to write registration type to message buffer.");
 
-    hr = VariableSerialize(pVariables, FALSE, &pbData, &cbData);
+    hr = VariableSerializeChanges(pVariables, pVariables->qwElevatedChangeCount, &pbData, &cbData, &qwVariablesChangeCount);
     ExitOnFailure(hr, "Failed to write variables.");
 
     // send message
     hr = PipeSendMessage(hPipe, BURN_ELEVATION_MESSAGE_TYPE_SESSION_BEGIN, pbData, cbData, NULL, NULL, &dwResult);
     ExitOnFailure(hr, "Failed to send message to per-machine process.");
 
+    pVariables->qwElevatedChangeCount = qwVariablesChangeCount;
+
     hr = (HRESULT)dwResult;
 
 LExit:
@@ -834,6 +853,7 @@ extern "C" HRESULT ElevationExecuteRelatedBundle(
     HRESULT hr = S_OK;
     BYTE* pbData = NULL;
     SIZE_T cbData = 0;
+    DWORD64 qwVariablesChangeCount = 0;
     BURN_ELEVATION_GENERIC_MESSAGE_CONTEXT context = { };
     DWORD dwResult = 0;
 
@@ -859,7 +879,10 @@ extern "C" HRESULT ElevationExecuteRelatedBundle(
     hr = BuffWriteString(&pbData, &cbData, pExecuteAction->relatedBundle.sczEngineWorkingDirectory);
     ExitOnFailure(hr, "Failed to write the custom working directory to the message buffer.");
 
-    hr = VariableSerialize(pVariables, FALSE, &pbData, &cbData);
+    hr = WriteDetectSnapshot(&pbData, &cbData, pExecuteAction->relatedBundle.sczDetectSnapshot);
+    ExitOnFailure(hr, "Failed to write the detect snapshot to the message buffer.");
+
+    hr = VariableSerializeChanges(pVariables, pVariables->qwElevatedChangeCount, &pbData, &cbData, &qwVariablesChangeCount);
     ExitOnFailure(hr, "Failed to write variables.");
 
     // send message
@@ -869,6 +892,8 @@ extern "C" HRESULT ElevationExecuteRelatedBundle(
     hr = PipeSendMessage(hPipe, BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_RELATED_BUNDLE, pbData, cbData, ProcessGenericExecuteMessages, &context, &dwResult);
     ExitOnFailure(hr, "Failed to send BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_RELATED_BUNDLE message to per-machine process.");
 
+    pVariables->qwElevatedChangeCount = qwVariablesChangeCount;
+
     hr = ProcessResult(dwResult, pRestart);
 
 LExit:
@@ -894,6 +919,7 @@ extern "C" HRESULT ElevationExecuteBundlePackage(
     HRESULT hr = S_OK;
     BYTE* pbData = NULL;
     SIZE_T cbData = 0;
+    DWORD64 qwVariablesChangeCount = 0;
     BURN_ELEVATION_GENERIC_MESSAGE_CONTEXT context = { };
     DWORD dwResult = 0;
 
@@ -922,7 +948,10 @@ extern "C" HRESULT ElevationExecuteBundlePackage(
     hr = BuffWriteString(&pbData, &cbData, pExecuteAction->bundlePackage.sczEngineWorkingDirectory);
     ExitOnFailure(hr, "Failed to write the custom working directory to the message buffer.");
 
-    hr = VariableSerialize(pVariables, FALSE, &pbData, &cbData);
+    hr = WriteDetectSnapshot(&pbData, &cbData, pExecuteAction->bundlePackage.sczDetectSnapshot);
+    ExitOnFailure(hr, "Failed to write the detect snapshot to the message buffer.");
+
+    hr = VariableSerializeChanges(pVariables, pVariables->qwElevatedChangeCount, &pbData, &cbData, &qwVariablesChangeCount);
     ExitOnFailure(hr, "Failed to write variables.");
 
     // send message
@@ -932,6 +961,8 @@ extern "C" HRESULT ElevationExecuteBundlePackage(
     hr = PipeSendMessage(hPipe, BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_BUNDLE_PACKAGE, pbData, cbData, ProcessGenericExecuteMessages, &context, &dwResult);
     ExitOnFailure(hr, "Failed to send BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_BUNDLE_PACKAGE message to per-machine process.");
 
+    pVariables->qwElevatedChangeCount = qwVariablesChangeCount;
+
     hr = ProcessResult(dwResult, pRestart);
 
 LExit:
@@ -957,6 +988,7 @@ extern "C" HRESULT ElevationExecuteExePackage(
     HRESULT hr = S_OK;
     BYTE* pbData = NULL;
     SIZE_T cbData = 0;
+    DWORD64 qwVariablesChangeCount = 0;
     BURN_ELEVATION_GENERIC_MESSAGE_CONTEXT context = { };
     DWORD dwResult = 0;
 
@@ -976,7 +1008,10 @@ extern "C" HRESULT ElevationExecuteExePackage(
     hr = BuffWriteString(&pbData, &cbData, pExecuteAction->exePackage.sczEngineWorkingDirectory);
     ExitOnFailure(hr, "Failed to write the custom working directory to the message buffer.");
 
-    hr = VariableSerialize(pVariables, FALSE, &pbData, &cbData);
+    hr = WriteDetectSnapshot(&pbData, &cbData, pExecuteAction->exePackage.sczDetectSnapshot);
+    ExitOnFailure(hr, "Failed to write the detect snapshot to the message buffer.");
+
+    hr = VariableSerializeChanges(pVariables, pVariables->qwElevatedChangeCount, &pbData, &cbData, &qwVariablesChangeCount);
     ExitOnFailure(hr, "Failed to write variables.");
 
     // send message
@@ -986,6 +1021,8 @@ extern "C" HRESULT ElevationExecuteExePackage(
     hr = PipeSendMessage(hPipe, BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_EXE_PACKAGE, pbData, cbData, ProcessGenericExecuteMessages, &context, &dwResult);
     ExitOnFailure(hr, "Failed to send BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_EXE_PACKAGE message to per-machine process.");
 
+    pVariables->qwElevatedChangeCount = qwVariablesChangeCount;
+
     hr = ProcessResult(dwResult, pRestart);
 
 LExit:
@@ -1098,6 +1135,7 @@ extern "C" HRESULT ElevationExecuteMsiPackage(
     HRESULT hr = S_OK;
     BYTE* pbData = NULL;
     SIZE_T cbData = 0;
+    DWORD64 qwVariablesChangeCount = 0;
     BURN_ELEVATION_MSI_MESSAGE_CONTEXT context = { };
     DWORD dwResult = 0;
 
@@ -1145,7 +1183,7 @@ extern "C" HRESULT ElevationExecuteMsiPackage(
         ExitOnFailure(hr, "Failed to write slipstream patch action to message buffer.");
     }
 
-    hr = VariableSerialize(pVariables, FALSE, &pbData, &cbData);
+    hr = VariableSerializeChanges(pVariables, pVariables->qwElevatedChangeCount, &pbData, &cbData, &qwVariablesChangeCount);
     ExitOnFailure(hr, "Failed to write variables.");
 
 
@@ -1156,6 +1194,8 @@ extern "C" HRESULT ElevationExecuteMsiPackage(
     hr = PipeSendMessage(hPipe, BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_MSI_PACKAGE, pbData, cbData, ProcessMsiPackageMessages, &context, &dwResult);
     ExitOnFailure(hr, "Failed to send BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_MSI_PACKAGE message to per-machine process.");
 
+    pVariables->qwElevatedChangeCount = qwVariablesChangeCount;
+
     hr = ProcessResult(dwResult, pRestart);
 
 LExit:
@@ -1182,6 +1222,7 @@ extern "C" HRESULT ElevationExecuteMspPackage(
     HRESULT hr = S_OK;
     BYTE* pbData = NULL;
     SIZE_T cbData = 0;
+    DWORD64 qwVariablesChangeCount = 0;
     BURN_ELEVATION_MSI_MESSAGE_CONTEXT context = { };
     DWORD dwResult = 0;
 
@@ -1222,7 +1263,7 @@ extern "C" HRESULT ElevationExecuteMspPackage(
         ExitOnFailure(hr, "Failed to write ordered patch id to message buffer.");
     }
 
-    hr = VariableSerialize(pVariables, FALSE, &pbData, &cbData);
+    hr = VariableSerializeChanges(pVariables, pVariables->qwElevatedChangeCount, &pbData, &cbData, &qwVariablesChangeCount);
     ExitOnFailure(hr, "Failed to write variables.");
 
     hr = BuffWriteNumber(&pbData, &cbData, (DWORD)fRollback);
@@ -1235,6 +1276,8 @@ extern "C" HRESULT ElevationExecuteMspPackage(
     hr = PipeSendMessage(hPipe, BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_MSP_PACKAGE, pbData, cbData, ProcessMsiPackageMessages, &context, &dwResult);
     ExitOnFailure(hr, "Failed to send BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_MSP_PACKAGE message to per-machine process.");
 
+    pVariables->qwElevatedChangeCount = qwVariablesChangeCount;
+
     hr = ProcessResult(dwResult, pRestart);
 
 LExit:
@@ -1308,6 +1351,7 @@ extern "C" HRESULT ElevationUninstallMsiCompatiblePackage(
     HRESULT hr = S_OK;
     BYTE* pbData = NULL;
     SIZE_T cbData = 0;
+    DWORD64 qwVariablesChangeCount = 0;
     BURN_ELEVATION_MSI_MESSAGE_CONTEXT context = { };
     DWORD dwResult = 0;
 
@@ -1327,7 +1371,7 @@ extern "C" HRESULT ElevationUninstallMsiCompatiblePackage(
     hr = BuffWriteString(&pbData, &cbData, pExecuteAction->uninstallMsiCompatiblePackage.sczLogPath);
     ExitOnFailure(hr, "Failed to write package log to message buffer.");
 
-    hr = VariableSerialize(pVariables, FALSE, &pbData, &cbData);
+    hr = VariableSerializeChanges(pVariables, pVariables->qwElevatedChangeCount, &pbData, &cbData, &qwVariablesChangeCount);
     ExitOnFailure(hr, "Failed to write variables.");
 
 
@@ -1338,6 +1382,8 @@ extern "C" HRESULT ElevationUninstallMsiCompatiblePackage(
     hr = PipeSendMessage(hPipe, BURN_ELEVATION_MESSAGE_TYPE_UNINSTALL_MSI_COMPATIBLE_PACKAGE, pbData, cbData, ProcessMsiPackageMessages, &context, &dwResult);
     ExitOnFailure(hr, "Failed to send BURN_ELEVATION_MESSAGE_TYPE_UNINSTALL_MSI_COMPATIBLE_PACKAGE message to per-machine process.");
 
+    pVariables->qwElevatedChangeCount = qwVariablesChangeCount;
+
     hr = ProcessResult(dwResult, pRestart);
 
 LExit:
@@ -1532,6 +1578,7 @@ LExit:
 extern "C" HRESULT ElevationChildPumpMessages(
     __in DWORD dwLoggingTlsId,
     __in HANDLE hPipe,
+    __in CRITICAL_SECTION* pcsPipe,
     __in HANDLE hCachePipe,
     __in BURN_APPROVED_EXES* pApprovedExes,
     __in BURN_CACHE* pCache,
@@ -1566,6 +1613,7 @@ extern "C" HRESULT ElevationChildPumpMessages(
 
     context.dwLoggingTlsId = dwLoggingTlsId;
     context.hPipe = hPipe;
+    context.pcsPipe = pcsPipe;
     context.phLock = phLock;
     context.pfDisabledAutomaticUpdates = pfDisabledAutomaticUpdates;
     context.pfApplying = pfApplying;
@@ -2151,11 +2199,11 @@ static HRESULT ProcessElevatedChildMessage(
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_MSI_PACKAGE:
-        hrResult = OnExecuteMsiPackage(pContext->hPipe, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData);
+        hrResult = OnExecuteMsiPackage(pContext, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData);
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_MSP_PACKAGE:
-        hrResult = OnExecuteMspPackage(pContext->hPipe, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData);
+        hrResult = OnExecuteMspPackage(pContext, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData);
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_MSU_PACKAGE:
@@ -2179,7 +2227,7 @@ static HRESULT ProcessElevatedChildMessage(
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_UNINSTALL_MSI_COMPATIBLE_PACKAGE:
-        hrResult = OnUninstallMsiCompatiblePackage(pContext->hPipe, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData);
+        hrResult = OnUninstallMsiCompatiblePackage(pContext, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData);
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_CLEAN_COMPATIBLE_PACKAGE:
@@ -2785,6 +2833,9 @@ static HRESULT OnExecuteRelatedBundle(
     hr = BuffReadString(pbData, cbData, &iData, &sczEngineWorkingDirectory);
     ExitOnFailure(hr, "Failed to read the custom working directory.");
 
+    hr = ReadDetectSnapshot(pCache, pbData, cbData, &iData, &executeAction.relatedBundle.sczDetectSnapshot);
+    ExitOnFailure(hr, "Failed to read the detect snapshot.");
+
     hr = VariableDeserialize(pVariables, FALSE, pbData, cbData, &iData);
     ExitOnFailure(hr, "Failed to read variables.");
 
@@ -2886,6 +2937,9 @@ static HRESULT OnExecuteBundlePackage(
     hr = BuffReadString(pbData, cbData, &iData, &sczEngineWorkingDirectory);
     ExitOnFailure(hr, "Failed to read the custom working directory.");
 
+    hr = ReadDetectSnapshot(pCache, pbData, cbData, &iData, &executeAction.bundlePackage.sczDetectSnapshot);
+    ExitOnFailure(hr, "Failed to read the detect snapshot.");
+
     hr = VariableDeserialize(pVariables, FALSE, pbData, cbData, &iData);
     ExitOnFailure(hr, "Failed to read variables.");
 
@@ -2979,6 +3033,9 @@ static HRESULT OnExecuteExePackage(
     hr = BuffReadString(pbData, cbData, &iData, &sczEngineWorkingDirectory);
     ExitOnFailure(hr, "Failed to read the custom working directory.");
 
+    hr = ReadDetectSnapshot(pCache, pbData, cbData, &iData, &executeAction.exePackage.sczDetectSnapshot);
+    ExitOnFailure(hr, "Failed to read the detect snapshot.");
+
     hr = VariableDeserialize(pVariables, FALSE, pbData, cbData, &iData);
     ExitOnFailure(hr, "Failed to read variables.");
 
@@ -3029,7 +3086,7 @@ LExit:
 }
 
 static HRESULT OnExecuteMsiPackage(
-    __in HANDLE hPipe,
+    __in BURN_ELEVATION_CHILD_MESSAGE_CONTEXT* pContext,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -3112,7 +3169,7 @@ static HRESULT OnExecuteMsiPackage(
     }
 
     // Execute MSI package.
-    hr = MsiEngineExecutePackage(hwndParent, &executeAction, pCache, pVariables, fRollback, MsiExecuteMessageHandler, hPipe, &msiRestart);
+    hr = MsiEngineExecutePackage(hwndParent, &executeAction, pCache, pVariables, fRollback, MsiExecuteMessageHandler, pContext, TRUE, &msiRestart);
     ExitOnFailure(hr, "Failed to execute MSI package.");
 
 LExit:
@@ -3135,7 +3192,7 @@ LExit:
 }
 
 static HRESULT OnExecuteMspPackage(
-    __in HANDLE hPipe,
+    __in BURN_ELEVATION_CHILD_MESSAGE_CONTEXT* pContext,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -3216,7 +3273,7 @@ static HRESULT OnExecuteMspPackage(
     }
 
     // Execute MSP package.
-    hr = MspEngineExecutePackage(hwndParent, &executeAction, pCache, pVariables, fRollback, MsiExecuteMessageHandler, hPipe, &restart);
+    hr = MspEngineExecutePackage(hwndParent, &executeAction, pCache, pVariables, fRollback, MsiExecuteMessageHandler, pContext, TRUE, &restart);
     ExitOnFailure(hr, "Failed to execute MSP package.");
 
 LExit:
@@ -3305,7 +3362,7 @@ LExit:
 }
 
 static HRESULT OnUninstallMsiCompatiblePackage(
-    __in HANDLE hPipe,
+    __in BURN_ELEVATION_CHILD_MESSAGE_CONTEXT* pContext,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -3363,7 +3420,7 @@ static HRESULT OnUninstallMsiCompatiblePackage(
     }
 
     // Uninstall MSI compatible package.
-    hr = MsiEngineUninstallCompatiblePackage(hwndParent, &executeAction, pCache, pVariables, fRollback, MsiExecuteMessageHandler, hPipe, &msiRestart);
+    hr = MsiEngineUninstallCompatiblePackage(hwndParent, &executeAction, pCache, pVariables, fRollback, MsiExecuteMessageHandler, pContext, TRUE, &msiRestart);
     ExitOnFailure(hr, "Failed to execute MSI package.");
 
 LExit:
@@ -3661,12 +3718,18 @@ static int MsiExecuteMessageHandler(
 {
     HRESULT hr = S_OK;
     int nResult = IDOK;
-    HANDLE hPipe = (HANDLE)pvContext;
+    BURN_ELEVATION_CHILD_MESSAGE_CONTEXT* pContext = static_cast<BURN_ELEVATION_CHILD_MESSAGE_CONTEXT*>(pvContext);
     BYTE* pbData = NULL;
     SIZE_T cbData = 0;
     DWORD dwMessage = 0;
     BOOL fRestartManager = FALSE;
 
+    // Notifications arrive on the wiutil forwarder thread, which needs the pipe in thread local storage to log.
+    if (pContext->hPipe != ::TlsGetValue(pContext->dwLoggingTlsId) && !::TlsSetValue(pContext->dwLoggingTlsId, pContext->hPipe))
+    {
+        ExitWithLastError(hr, "Failed to set elevated pipe into thread local storage for logging.");
+    }
+
     // Always send any extra data via the struct first.
     hr = BuffWriteNumber(&pbData, &cbData, pMessage->cData);
     ExitOnFailure(hr, "Failed to write MSI data count to message buffer.");
@@ -3731,8 +3794,10 @@ static int MsiExecuteMessageHandler(
         ExitOnFailure(hr, "Invalid message type: %d", pMessage->type);
     }
 
-    // send message
-    hr = PipeSendMessage(hPipe, dwMessage, pbData, cbData, NULL, NULL, (DWORD*)&nResult);
+    // send message, without letting logging from the Windows Installer thread interleave with it
+    ::EnterCriticalSection(pContext->pcsPipe);
+    hr = PipeSendMessage(pContext->hPipe, dwMessage, pbData, cbData, NULL, NULL, (DWORD*)&nResult);
+    ::LeaveCriticalSection(pContext->pcsPipe);
     ExitOnFailure(hr, "Failed to send msi message to per-user process.");
 
 LExit:
@@ -4076,3 +4141,107 @@ LExit:
 
     return hr;
 }
+
+static HRESULT WriteDetectSnapshot(
+    __deref_inout_bcount(*pcbData) BYTE** ppbData,
+    __inout SIZE_T* pcbData,
+    __in_z_opt LPCWSTR wzDetectSnapshot
+    )
+{
+    HRESULT hr = S_OK;
+    BYTE* pbSnapshot = NULL;
+    SIZE_T cbSnapshot = 0;
+
+    // The elevated process must not read a file that non-elevated processes can write,
+    // so send the snapshot itself.
+    if (wzDetectSnapshot)
+    {
+        hr = FileRead(&pbSnapshot, &cbSnapshot, wzDetectSnapshot);
+        if (FAILED(hr))
+        {
+            LogStringLine(REPORT_WARNING, "Failed to read detect snapshot: %ls, hr: 0x%x", wzDetectSnapshot, hr);
+
+            ReleaseNullMem(pbSnapshot);
+            cbSnapshot = 0;
+        }
+    }
+
+    hr = BuffWriteNumber(ppbData, pcbData, 0 < cbSnapshot);
+    ExitOnFailure(hr, "Failed to write whether there is a detect snapshot.");
+
+    if (cbSnapshot)
+    {
+        hr = BuffWriteStream(ppbData, pcbData, pbSnapshot, cbSnapshot);
+        ExitOnFailure(hr, "Failed to write detect snapshot stream.");
+    }
+
+LExit:
+    ReleaseMem(pbSnapshot);
+
+    return hr;
+}
+
+static HRESULT ReadDetectSnapshot(
+    __in BURN_CACHE* pCache,
+    __in_bcount(cbData) BYTE* pbData,
+    __in SIZE_T cbData,
+    __inout SIZE_T* piData,
+    __deref_out_z_opt LPWSTR* psczDetectSnapshot
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwSnapshot = 0;
+    BYTE* pbSnapshot = NULL;
+    SIZE_T cbSnapshot = 0;
+    LPWSTR sczWorkingFolder = NULL;
+    LPWSTR sczDetectSnapshot = NULL;
+
+    hr = BuffReadNumber(pbData, cbData, piData, &dwSnapshot);
+    ExitOnFailure(hr, "Failed to read whether there is a detect snapshot.");
+
+    if (!dwSnapshot)
+    {
+        ExitFunction();
+    }
+
+    hr = BuffReadStream(pbData, cbData, piData, &pbSnapshot, &cbSnapshot);
+    ExitOnFailure(hr, "Failed to read detect snapshot stream.");
+
+    // Write the snapshot into our own working folder so the elevated child only ever reads a file
+    // created by an elevated process. The snapshot only saves the child a full detect, so failing
+    // to pass it along is not an error.
+    hr = CacheEnsureBaseWorkingFolder(pCache, &sczWorkingFolder);
+    if (SUCCEEDED(hr))
+    {
+        hr = PathConcatRelativeToFullyQualifiedBase(sczWorkingFolder, BURN_DETECT_SNAPSHOT_FILE_NAME, &sczDetectSnapshot);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        // Start from a new file so it is owned by this process rather than by whoever created it first.
+        hr = FileEnsureDelete(sczDetectSnapshot);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = FileWrite(sczDetectSnapshot, FILE_ATTRIBUTE_NORMAL, pbSnapshot, cbSnapshot, NULL);
+    }
+
+    if (FAILED(hr))
+    {
+        LogStringLine(REPORT_WARNING, "Failed to write detect snapshot for child bundle, hr: 0x%x", hr);
+
+        ReleaseNullStr(sczDetectSnapshot);
+        hr = S_OK;
+    }
+
+    *psczDetectSnapshot = sczDetectSnapshot;
+    sczDetectSnapshot = NULL;
+
+LExit:
+    ReleaseStr(sczDetectSnapshot);
+    ReleaseStr(sczWorkingFolder);
+    ReleaseMem(pbSnapshot);
+
+    return hr;
+}
@@ -168,6 +168,7 @@ HRESULT ElevationLaunchApprovedExe(
 HRESULT ElevationChildPumpMessages(
     __in DWORD dwLoggingTlsId,
     __in HANDLE hPipe,
+    __in CRITICAL_SECTION* pcsPipe,
     __in HANDLE hCachePipe,
     __in BURN_APPROVED_EXES* pApprovedExes,
     __in BURN_CACHE* pCache,
@@ -257,6 +257,8 @@ LExit:
         LoggingOpenFailed();
     }
 
+    TracingUninitialize();
+
     UserExperienceRemove(&engineState.userExperience);
 
     CacheRemoveBaseWorkingFolder(&engineState.cache);
@@ -355,8 +357,11 @@ static HRESULT InitializeEngineState(
     pEngineState->internalCommand.automaticUpdates = BURN_AU_PAUSE_ACTION_IFELEVATED;
     pEngineState->dwElevatedLoggingTlsId = TLS_OUT_OF_INDEXES;
     ::InitializeCriticalSection(&pEngineState->userExperience.csEngineActive);
+    ::InitializeCriticalSection(&pEngineState->userExperience.csParallelExecute);
+    ::InitializeCriticalSection(&pEngineState->csElevatedPipe);
     PipeConnectionInitialize(&pEngineState->companionConnection);
     PipeConnectionInitialize(&pEngineState->embeddedConnection);
+    DetectSnapshotInitialize(&pEngineState->detectSnapshot);
 
     // Retain whether bundle was initially run elevated.
     ProcElevated(::GetCurrentProcess(), &pEngineState->internalCommand.fInitiallyElevated);
@@ -365,6 +370,21 @@ static HRESULT InitializeEngineState(
     hr = CoreParseCommandLine(&pEngineState->internalCommand, &pEngineState->command, &pEngineState->companionConnection, &pEngineState->embeddedConnection, &hSectionFile, &hSourceEngineFile);
     ExitOnFailure(hr, "Fatal error while parsing command line.");
 
+    // The untrusted process only relaunches itself from the clean room, which is passed the trace file.
+    // It exits last, so its nearly empty trace would otherwise overwrite the clean room's.
+    if (BURN_MODE_UNTRUSTED != pEngineState->internalCommand.mode)
+    {
+        hr = TracingInitialize(pEngineState->internalCommand.sczTraceFile);
+        ExitOnFailure(hr, "Failed to initialize tracing.");
+
+        // The allocation counters are shared by every allocation so they are only paid for while tracing,
+        // in any build. Blocks allocated before this point are not counted.
+        if (pEngineState->internalCommand.sczTraceFile && *pEngineState->internalCommand.sczTraceFile)
+        {
+            MemStatisticsEnable(TRUE);
+        }
+    }
+
     hr = SectionInitialize(&pEngineState->section, hSectionFile, hSourceEngineFile);
     ExitOnFailure(hr, "Failed to initialize engine section.");
 
@@ -379,6 +399,8 @@ static void UninitializeEngineState(
     __in BURN_ENGINE_STATE* pEngineState
     )
 {
+    MEM_STATISTICS statistics = { };
+
     if (pEngineState->internalCommand.argv)
     {
         AppFreeCommandLineArgs(pEngineState->internalCommand.argv);
@@ -395,6 +417,8 @@ static void UninitializeEngineState(
     BurnExtensionUninitialize(&pEngineState->extensions);
 
     ::DeleteCriticalSection(&pEngineState->userExperience.csEngineActive);
+    ::DeleteCriticalSection(&pEngineState->userExperience.csParallelExecute);
+    ::DeleteCriticalSection(&pEngineState->csElevatedPipe);
     UserExperienceUninitialize(&pEngineState->userExperience);
 
     ApprovedExesUninitialize(&pEngineState->approvedExes);
@@ -407,6 +431,7 @@ static void UninitializeEngineState(
     PackagesUninitialize(&pEngineState->packages);
     SectionUninitialize(&pEngineState->section);
     ContainersUninitialize(&pEngineState->containers);
+    DetectSnapshotUninitialize(&pEngineState->detectSnapshot);
 
     ReleaseStr(pEngineState->command.wzBootstrapperApplicationDataPath);
     ReleaseStr(pEngineState->command.wzBootstrapperWorkingFolder);
@@ -417,6 +442,8 @@ static void UninitializeEngineState(
     ReleaseStr(pEngineState->internalCommand.sczAncestors);
     ReleaseStr(pEngineState->internalCommand.sczIgnoreDependencies);
     ReleaseStr(pEngineState->internalCommand.sczLogFile);
+    ReleaseStr(pEngineState->internalCommand.sczTraceFile);
+    ReleaseStr(pEngineState->internalCommand.sczDetectSnapshotFile);
     ReleaseStr(pEngineState->internalCommand.sczOriginalSource);
     ReleaseStr(pEngineState->internalCommand.sczSourceProcessPath);
     ReleaseStr(pEngineState->internalCommand.sczEngineWorkingDirectory);
@@ -431,6 +458,15 @@ static void UninitializeEngineState(
         ::TlsFree(pEngineState->dwElevatedLoggingTlsId);
     }
 
+    MemGetStatistics(&statistics);
+    if (statistics.cAllocations)
+    {
+        LogStringLine(REPORT_VERBOSE, "Made %llu allocations (%llu from the manifest arena) with %llu frees, peak %llu bytes.", statistics.cAllocations, statistics.cArenaAllocations, statistics.cFrees, statistics.cbPeak);
+    }
+
+    // Release every manifest-lifetime allocation at once now that nothing references them.
+    ReleaseMemArena(pEngineState->hManifestArena);
+
     // clear struct
     memset(pEngineState, 0, sizeof(BURN_ENGINE_STATE));
 }
@@ -540,6 +576,17 @@ static HRESULT RunNormal(
         ExitFunction1(hr = S_OK);
     }
 
+    // Best effort to let the BA start its own initialization while the engine finishes starting up.
+    // This waits for the log so anything the BA DLL does while loading can be diagnosed. Detect is
+    // requested by the created BA, so this overlaps the registration query and extension loading
+    // but cannot overlap detection itself.
+    hr = UserExperiencePrepare(&pEngineState->userExperience, &pEngineState->command);
+    if (FAILED(hr))
+    {
+        LogStringLine(REPORT_STANDARD, "Failed to prepare bootstrapper application, continuing. Error: 0x%x", hr);
+        hr = S_OK;
+    }
+
     // Create a top-level window to handle system messages.
     hr = UiCreateMessageWindow(hInstance, pEngineState);
     ExitOnFailure(hr, "Failed to create the message window.");
@@ -607,6 +654,10 @@ LExit:
 
     BurnExtensionUnload(&pEngineState->extensions);
 
+    // A BA that was prepared but never created must let go of the .ba folder before it is removed.
+    // Unloading waits for any startup work the BA began in its prepare entry point.
+    UserExperienceUnload(&pEngineState->userExperience, FALSE);
+
     // If the message window is still around, close it.
     UiCloseMessageWindow(pEngineState);
 
@@ -666,7 +717,7 @@ static HRESULT RunElevated(
     SrpInitialize(TRUE);
 
     // Pump messages from parent process.
-    hr = ElevationChildPumpMessages(pEngineState->dwElevatedLoggingTlsId, pEngineState->companionConnection.hPipe, pEngineState->companionConnection.hCachePipe, &pEngineState->approvedExes, &pEngineState->cache, &pEngineState->containers, &pEngineState->packages, &pEngineState->payloads, &pEngineState->variables, &pEngineState->registration, &pEngineState->userExperience, &hLock, &fDisabledAutomaticUpdates, &pEngineState->userExperience.dwExitCode, &pEngineState->fRestart, &pEngineState->plan.fApplying);
+    hr = ElevationChildPumpMessages(pEngineState->dwElevatedLoggingTlsId, pEngineState->companionConnection.hPipe, &pEngineState->csElevatedPipe, pEngineState->companionConnection.hCachePipe, &pEngineState->approvedExes, &pEngineState->cache, &pEngineState->containers, &pEngineState->packages, &pEngineState->payloads, &pEngineState->variables, &pEngineState->registration, &pEngineState->userExperience, &hLock, &fDisabledAutomaticUpdates, &pEngineState->userExperience.dwExitCode, &pEngineState->fRestart, &pEngineState->plan.fApplying);
     LogRedirect(NULL, NULL); // reset logging so the next failure gets written to "log buffer" for the failure log.
     ExitOnFailure(hr, "Failed to pump messages from parent process.");
 
@@ -881,29 +932,37 @@ static HRESULT DAPI RedirectLoggingOverPipe(
 
     HRESULT hr = S_OK;
     BURN_ENGINE_STATE* pEngineState = static_cast<BURN_ENGINE_STATE*>(pvContext);
+    BOOL fLocked = FALSE;
     BOOL fStartedLogging = FALSE;
     HANDLE hPipe = INVALID_HANDLE_VALUE;
     BYTE* pbData = NULL;
     SIZE_T cbData = 0;
     DWORD dwResult = 0;
 
-    // Prevent this function from being called recursively.
-    if (s_fCurrentlyLoggingToPipe)
+    // Make sure the current thread set the pipe in TLS.
+    hPipe = ::TlsGetValue(pEngineState->dwElevatedLoggingTlsId);
+    if (!hPipe || INVALID_HANDLE_VALUE == hPipe)
     {
+        hr = HRESULT_FROM_WIN32(ERROR_PIPE_NOT_CONNECTED);
         ExitFunction();
     }
 
-    s_fCurrentlyLoggingToPipe = TRUE;
-    fStartedLogging = TRUE;
+    // MSI messages are forwarded over the companion pipe from another thread, so wait for the pipe to be free.
+    if (hPipe == pEngineState->companionConnection.hPipe)
+    {
+        ::EnterCriticalSection(&pEngineState->csElevatedPipe);
+        fLocked = TRUE;
+    }
 
-    // Make sure the current thread set the pipe in TLS.
-    hPipe = ::TlsGetValue(pEngineState->dwElevatedLoggingTlsId);
-    if (!hPipe || INVALID_HANDLE_VALUE == hPipe)
+    // Prevent this function from being called recursively.
+    if (s_fCurrentlyLoggingToPipe)
     {
-        hr = HRESULT_FROM_WIN32(ERROR_PIPE_NOT_CONNECTED);
         ExitFunction();
     }
 
+    s_fCurrentlyLoggingToPipe = TRUE;
+    fStartedLogging = TRUE;
+
     // Do not log or use ExitOnFailure() macro here because they will be discarded
     // by the recursive block at the top of this function.
     hr = BuffWriteStringAnsi(&pbData, &cbData, szString);
@@ -925,6 +984,11 @@ LExit:
         s_fCurrentlyLoggingToPipe = FALSE;
     }
 
+    if (fLocked)
+    {
+        ::LeaveCriticalSection(&pEngineState->csElevatedPipe);
+    }
+
     return hr;
 }
 
@@ -612,6 +612,9 @@ extern "C" HRESULT ExeEngineExecutePackage(
             ExitOnFailure(hr, "Failed to append the custom working directory to the exepackage command line.");
         }
 
+        hr = CoreAppendDetectSnapshotToCommandLine(pExecuteAction->exePackage.sczDetectSnapshot, &sczBaseCommand);
+        ExitOnFailure(hr, "Failed to append %ls", BURN_COMMANDLINE_SWITCH_DETECT_SNAPSHOT);
+
         hr = CoreAppendFileHandleSelfToCommandLine(sczExecutablePath, &hExecutableFile, &sczBaseCommand, NULL);
         ExitOnFailure(hr, "Failed to append %ls", BURN_COMMANDLINE_SWITCH_FILEHANDLE_SELF);
     }
@@ -759,7 +762,7 @@ extern "C" HRESULT ExeEngineRunProcess(
         hr = (IDOK == nResult || IDNOACTION == nResult) ? S_OK : IDCANCEL == nResult ? HRESULT_FROM_WIN32(ERROR_INSTALL_USEREXIT) : HRESULT_FROM_WIN32(ERROR_INSTALL_FAILURE);
         ExitOnRootFailure(hr, "Bootstrapper application aborted during package process progress.");
 
-        hr = ProcWaitForCompletion(pi.hProcess, 500, pdwExitCode);
+        hr = CoreWaitForProcCompletion(pi.hProcess, 500, pdwExitCode);
         if (HRESULT_FROM_WIN32(WAIT_TIMEOUT) != hr)
         {
             ExitOnFailure(hr, "Failed to wait for executable to complete: %ls", wzExecutablePath);
@@ -73,6 +73,93 @@ HRESULT ExternalEngineGetVariableString(
     return hr;
 }
 
+HRESULT ExternalEngineGetVariables(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in DWORD cVariables,
+    __in_ecount_opt(cVariables) const LPCWSTR* rgwzVariables,
+    __out_ecount_opt(*pcchValues) LPWSTR wzValues,
+    __inout SIZE_T* pcchValues,
+    __out_ecount_opt(cVariables) HRESULT* rghrVariables
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR* rgsczValues = NULL;
+    SIZE_T cchTotal = 0;
+    size_t cchValue = 0;
+    LPWSTR wzValue = NULL;
+    size_t cchRemaining = 0;
+
+    if (!pcchValues || (cVariables && (!rgwzVariables || !rghrVariables)))
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    for (DWORD i = 0; i < cVariables; ++i)
+    {
+        if (!rgwzVariables[i] || !*rgwzVariables[i])
+        {
+            ExitFunction1(hr = E_INVALIDARG);
+        }
+    }
+
+    if (cVariables)
+    {
+        rgsczValues = static_cast<LPWSTR*>(MemAlloc(sizeof(LPWSTR) * cVariables, TRUE));
+        ExitOnNull(rgsczValues, hr, E_OUTOFMEMORY, "Failed to allocate variable values.");
+    }
+
+    hr = VariableGetStrings(&pEngineState->variables, cVariables, rgwzVariables, rgsczValues, rghrVariables);
+    ExitOnFailure(hr, "Failed to get variables.");
+
+    // Every value takes its length plus a null terminator in the caller's buffer.
+    for (DWORD i = 0; i < cVariables; ++i)
+    {
+        cchValue = 0;
+
+        if (rgsczValues[i])
+        {
+            hr = ::StringCchLengthW(rgsczValues[i], STRSAFE_MAX_LENGTH, &cchValue);
+            ExitOnFailure(hr, "Failed to get length of variable: %ls", rgwzVariables[i]);
+        }
+
+        cchTotal += cchValue + 1;
+    }
+
+    if (!wzValues || *pcchValues < cchTotal)
+    {
+        *pcchValues = cchTotal;
+        ExitFunction1(hr = E_MOREDATA);
+    }
+
+    wzValue = wzValues;
+    cchRemaining = cchTotal;
+
+    for (DWORD i = 0; i < cVariables; ++i)
+    {
+        hr = ::StringCchCopyExW(wzValue, cchRemaining, rgsczValues[i] ? rgsczValues[i] : L"", &wzValue, &cchRemaining, 0);
+        ExitOnFailure(hr, "Failed to copy value of variable: %ls", rgwzVariables[i]);
+
+        // step past the null terminator.
+        ++wzValue;
+        --cchRemaining;
+    }
+
+    *pcchValues = cchTotal;
+
+LExit:
+    if (rgsczValues)
+    {
+        for (DWORD i = 0; i < cVariables; ++i)
+        {
+            StrSecureZeroFreeString(rgsczValues[i]);
+        }
+
+        MemFree(rgsczValues);
+    }
+
+    return hr;
+}
+
 HRESULT ExternalEngineGetVariableVersion(
     __in BURN_ENGINE_STATE* pEngineState,
     __in_z LPCWSTR wzVariable,
@@ -526,6 +613,36 @@ LExit:
     return hr;
 }
 
+HRESULT ExternalEngineSetVariables(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in DWORD cVariables,
+    __in_ecount_opt(cVariables) const LPCWSTR* rgwzVariables,
+    __in_ecount_opt(cVariables) const LPCWSTR* rgwzValues,
+    __in const BOOL fFormatted
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (cVariables && (!rgwzVariables || !rgwzValues))
+    {
+        ExitOnRootFailure(hr = E_INVALIDARG, "SetVariables did not provide variable names or values.");
+    }
+
+    for (DWORD i = 0; i < cVariables; ++i)
+    {
+        if (!rgwzVariables[i] || !*rgwzVariables[i])
+        {
+            ExitOnRootFailure(hr = E_INVALIDARG, "SetVariables did not provide variable name at index: %u.", i);
+        }
+    }
+
+    hr = VariableSetStrings(&pEngineState->variables, cVariables, rgwzVariables, rgwzValues, fFormatted);
+    ExitOnFailure(hr, "Failed to set string variables.");
+
+LExit:
+    return hr;
+}
+
 HRESULT ExternalEngineSetVariableVersion(
     __in BURN_ENGINE_STATE* pEngineState,
     __in_z LPCWSTR wzVariable,
@@ -29,6 +29,15 @@ HRESULT ExternalEngineGetVariableString(
     __inout SIZE_T* pcchValue
     );
 
+HRESULT ExternalEngineGetVariables(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in DWORD cVariables,
+    __in_ecount_opt(cVariables) const LPCWSTR* rgwzVariables,
+    __out_ecount_opt(*pcchValues) LPWSTR wzValues,
+    __inout SIZE_T* pcchValues,
+    __out_ecount_opt(cVariables) HRESULT* rghrVariables
+    );
+
 HRESULT ExternalEngineGetVariableVersion(
     __in BURN_ENGINE_STATE* pEngineState,
     __in_z LPCWSTR wzVariable,
@@ -114,6 +123,14 @@ HRESULT ExternalEngineSetVariableString(
     __in const BOOL fFormatted
     );
 
+HRESULT ExternalEngineSetVariables(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in DWORD cVariables,
+    __in_ecount_opt(cVariables) const LPCWSTR* rgwzVariables,
+    __in_ecount_opt(cVariables) const LPCWSTR* rgwzValues,
+    __in const BOOL fFormatted
+    );
+
 HRESULT ExternalEngineSetVariableVersion(
     __in BURN_ENGINE_STATE* pEngineState,
     __in_z LPCWSTR wzVariable,
@@ -433,7 +433,8 @@ LExit:
 extern "C" HRESULT MsiEngineDetectPackage(
     __in BURN_PACKAGE* pPackage,
     __in BURN_REGISTRATION* pRegistration,
-    __in BURN_USER_EXPERIENCE* pUserExperience
+    __in BURN_USER_EXPERIENCE* pUserExperience,
+    __in_opt BURN_DETECT_SNAPSHOT* pSnapshot
     )
 {
     Trace(REPORT_STANDARD, "Detecting MSI package 0x%p", pPackage);
@@ -451,7 +452,7 @@ extern "C" HRESULT MsiEngineDetectPackage(
 
     // detect self by product code
     // TODO: what to do about MSIINSTALLCONTEXT_USERMANAGED?
-    hr = WiuGetProductInfoEx(pPackage->Msi.sczProductCode, NULL, pPackage->fPerMachine ? MSIINSTALLCONTEXT_MACHINE : MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
+    hr = DetectSnapshotGetProductInfo(pSnapshot, pPackage->Msi.sczProductCode, pPackage->fPerMachine ? MSIINSTALLCONTEXT_MACHINE : MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
     if (SUCCEEDED(hr))
     {
         hr = VerParseVersion(sczInstalledVersion, 0, FALSE, &pVersion);
@@ -511,7 +512,7 @@ extern "C" HRESULT MsiEngineDetectPackage(
         for (DWORD iProduct = 0; ; ++iProduct)
         {
             // get product
-            hr = WiuEnumRelatedProducts(pRelatedMsi->sczUpgradeCode, iProduct, wzProductCode);
+            hr = DetectSnapshotEnumRelatedProducts(pSnapshot, pRelatedMsi->sczUpgradeCode, iProduct, wzProductCode);
             if (E_NOMOREITEMS == hr)
             {
                 hr = S_OK;
@@ -526,7 +527,7 @@ extern "C" HRESULT MsiEngineDetectPackage(
             }
 
             // get product version
-            hr = WiuGetProductInfoEx(wzProductCode, NULL, MSIINSTALLCONTEXT_MACHINE, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
+            hr = DetectSnapshotGetProductInfo(pSnapshot, wzProductCode, MSIINSTALLCONTEXT_MACHINE, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
             if (HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT) != hr && HRESULT_FROM_WIN32(ERROR_UNKNOWN_PROPERTY) != hr)
             {
                 ExitOnFailure(hr, "Failed to get version for product in machine context: %ls", wzProductCode);
@@ -534,7 +535,7 @@ extern "C" HRESULT MsiEngineDetectPackage(
             }
             else
             {
-                hr = WiuGetProductInfoEx(wzProductCode, NULL, MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
+                hr = DetectSnapshotGetProductInfo(pSnapshot, wzProductCode, MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_VERSIONSTRING, &sczInstalledVersion);
                 if (HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT) != hr && HRESULT_FROM_WIN32(ERROR_UNKNOWN_PROPERTY) != hr)
                 {
                     ExitOnFailure(hr, "Failed to get version for product in user unmanaged context: %ls", wzProductCode);
@@ -583,7 +584,7 @@ extern "C" HRESULT MsiEngineDetectPackage(
             if (pRelatedMsi->cLanguages)
             {
                 // If there is a language to get, convert it into an LCID.
-                hr = WiuGetProductInfoEx(wzProductCode, NULL, fPerMachine ? MSIINSTALLCONTEXT_MACHINE : MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_LANGUAGE, &sczInstalledLanguage);
+                hr = DetectSnapshotGetProductInfo(pSnapshot, wzProductCode, fPerMachine ? MSIINSTALLCONTEXT_MACHINE : MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_LANGUAGE, &sczInstalledLanguage);
                 if (SUCCEEDED(hr))
                 {
                     hr = StrStringToUInt32(sczInstalledLanguage, 0, &uLcid);
@@ -663,7 +664,7 @@ extern "C" HRESULT MsiEngineDetectPackage(
             // Try to detect features state if the product is present on the machine.
             if (BOOTSTRAPPER_PACKAGE_STATE_PRESENT <= pPackage->currentState)
             {
-                hr = WiuQueryFeatureState(pPackage->Msi.sczProductCode, pFeature->sczId, &installState);
+                hr = DetectSnapshotQueryFeatureState(pSnapshot, pPackage->Msi.sczProductCode, pFeature->sczId, &installState);
                 ExitOnFailure(hr, "Failed to query feature state.");
 
                 if (INSTALLSTATE_UNKNOWN == installState) // in case of an upgrade a feature could be removed.
@@ -1174,6 +1175,7 @@ extern "C" HRESULT MsiEngineExecutePackage(
     __in BOOL fRollback,
     __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
     __in LPVOID pvContext,
+    __in BOOL fQueueNotifications,
     __out BOOTSTRAPPER_APPLY_RESTART* pRestart
     )
 {
@@ -1251,7 +1253,7 @@ extern "C" HRESULT MsiEngineExecutePackage(
     }
     else
     {
-        hr = WiuInitializeExternalUI(pfnMessageHandler, pExecuteAction->msiPackage.uiLevel, hwndParent, pvContext, fRollback, &context);
+        hr = WiuInitializeExternalUI(pfnMessageHandler, pExecuteAction->msiPackage.uiLevel, hwndParent, pvContext, fRollback, fQueueNotifications, &context);
         ExitOnFailure(hr, "Failed to initialize external UI handler.");
     }
 
@@ -1365,6 +1367,7 @@ extern "C" HRESULT MsiEngineUninstallCompatiblePackage(
     __in BOOL fRollback,
     __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
     __in LPVOID pvContext,
+    __in BOOL fQueueNotifications,
     __out BOOTSTRAPPER_APPLY_RESTART* pRestart
     )
 {
@@ -1386,7 +1389,7 @@ extern "C" HRESULT MsiEngineUninstallCompatiblePackage(
         dwLogMode |= INSTALLLOGMODE_EXTRADEBUG;
     }
 
-    hr = WiuInitializeExternalUI(pfnMessageHandler, INSTALLUILEVEL_NONE, hwndParent, pvContext, fRollback, &context);
+    hr = WiuInitializeExternalUI(pfnMessageHandler, INSTALLUILEVEL_NONE, hwndParent, pvContext, fRollback, fQueueNotifications, &context);
     ExitOnFailure(hr, "Failed to initialize external UI handler.");
 
     if (pExecuteAction->uninstallMsiCompatiblePackage.sczLogPath && *pExecuteAction->uninstallMsiCompatiblePackage.sczLogPath)
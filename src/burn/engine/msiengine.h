@@ -33,7 +33,8 @@ HRESULT MsiEngineDetectInitialize(
 HRESULT MsiEngineDetectPackage(
     __in BURN_PACKAGE* pPackage,
     __in BURN_REGISTRATION* pRegistration,
-    __in BURN_USER_EXPERIENCE* pUserExperience
+    __in BURN_USER_EXPERIENCE* pUserExperience,
+    __in_opt BURN_DETECT_SNAPSHOT* pSnapshot
     );
 HRESULT MsiEngineDetectCompatiblePackage(
     __in BURN_PACKAGE* pPackage
@@ -73,6 +74,7 @@ HRESULT MsiEngineExecutePackage(
     __in BOOL fRollback,
     __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
     __in LPVOID pvContext,
+    __in BOOL fQueueNotifications,
     __out BOOTSTRAPPER_APPLY_RESTART* pRestart
     );
 HRESULT MsiEngineUninstallCompatiblePackage(
@@ -83,6 +85,7 @@ HRESULT MsiEngineUninstallCompatiblePackage(
     __in BOOL fRollback,
     __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
     __in LPVOID pvContext,
+    __in BOOL fQueueNotifications,
     __out BOOTSTRAPPER_APPLY_RESTART* pRestart
     );
 HRESULT MsiEngineConcatBurnProperties(
@@ -580,6 +580,7 @@ extern "C" HRESULT MspEngineExecutePackage(
     __in BOOL fRollback,
     __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
     __in LPVOID pvContext,
+    __in BOOL fQueueNotifications,
     __out BOOTSTRAPPER_APPLY_RESTART* pRestart
     )
 {
@@ -644,7 +645,7 @@ extern "C" HRESULT MspEngineExecutePackage(
     }
     else
     {
-        hr = WiuInitializeExternalUI(pfnMessageHandler, pExecuteAction->mspTarget.uiLevel, hwndParent, pvContext, fRollback, &context);
+        hr = WiuInitializeExternalUI(pfnMessageHandler, pExecuteAction->mspTarget.uiLevel, hwndParent, pvContext, fRollback, fQueueNotifications, &context);
         ExitOnFailure(hr, "Failed to initialize external UI handler.");
     }
 
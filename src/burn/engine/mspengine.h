@@ -68,6 +68,7 @@ HRESULT MspEngineExecutePackage(
     __in BOOL fRollback,
     __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
     __in LPVOID pvContext,
+    __in BOOL fQueueNotifications,
     __out BOOTSTRAPPER_APPLY_RESTART* pRestart
     );
 void MspEngineUpdateInstallRegistrationState(
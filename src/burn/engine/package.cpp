@@ -166,6 +166,10 @@ extern "C" HRESULT PackagesParseFromXml(
         hr = XmlGetYesNoAttribute(pixnNode, L"Vital", &pPackage->fVital);
         ExitOnRequiredXmlQueryFailure(hr, "Failed to get @Vital.");
 
+        // @Parallel
+        hr = XmlGetYesNoAttribute(pixnNode, L"Parallel", &pPackage->fParallel);
+        ExitOnOptionalXmlQueryFailure(hr, fFoundXml, "Failed to get @Parallel.");
+
         // @LogPathVariable
         hr = XmlGetAttributeEx(pixnNode, L"LogPathVariable", &pPackage->sczLogPathVariable);
         ExitOnOptionalXmlQueryFailure(hr, fFoundXml, "Failed to get @LogPathVariable.");
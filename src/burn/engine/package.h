@@ -268,6 +268,7 @@ typedef struct _BURN_PACKAGE
     BOOL fPerMachine;
     BOOL fPermanent;
     BOOL fVital;
+    BOOL fParallel;
     BOOL fCanAffectRegistration;
 
     BOOTSTRAPPER_CACHE_TYPE authoredCacheType;
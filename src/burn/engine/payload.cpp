@@ -5,6 +5,9 @@
 
 // internal function declarations
 
+static DWORD WINAPI ExtractUXContainerThreadProc(
+    __in LPVOID lpThreadParameter
+    );
 
 // function definitions
 
@@ -269,63 +272,156 @@ extern "C" void PayloadsUninitialize(
 extern "C" HRESULT PayloadExtractUXContainer(
     __in BURN_PAYLOADS* pPayloads,
     __in BURN_CONTAINER_CONTEXT* pContainerContext,
-    __in_z LPCWSTR wzTargetDir
+    __in_z LPCWSTR wzTargetDir,
+    __in BURN_PAYLOAD_EXTRACTION* pExtraction
     )
 {
     HRESULT hr = S_OK;
-    LPWSTR sczStreamName = NULL;
     LPWSTR sczDirectory = NULL;
     BURN_PAYLOAD* pPayload = NULL;
+    LPCWSTR wzExtension = NULL;
 
-    // extract all payloads
-    for (;;)
+    pExtraction->pPayloads = pPayloads;
+    pExtraction->pContainerContext = pContainerContext;
+
+    if (pPayloads->cPayloads)
     {
-        // get next stream
-        hr = ContainerNextStream(pContainerContext, &sczStreamName);
-        if (E_NOMOREITEMS == hr)
-        {
-            hr = S_OK;
-            break;
-        }
-        ExitOnFailure(hr, "Failed to get next stream.");
+        pExtraction->rgTargets = (BURN_CONTAINER_STREAM_TARGET*)MemAlloc(sizeof(BURN_CONTAINER_STREAM_TARGET) * pPayloads->cPayloads, TRUE);
+        ExitOnNull(pExtraction->rgTargets, hr, E_OUTOFMEMORY, "Failed to allocate stream targets.");
+    }
 
-        // find payload by stream name
-        hr = PayloadFindEmbeddedBySourcePath(pPayloads->sdhPayloads, sczStreamName, &pPayload);
-        ExitOnFailure(hr, "Failed to find embedded payload: %ls", sczStreamName);
+    // prepare a target file for every payload
+    for (DWORD i = 0; i < pPayloads->cPayloads; ++i)
+    {
+        pPayload = &pPayloads->rgPayloads[i];
 
         // make file path
         hr = PathConcatRelativeToFullyQualifiedBase(wzTargetDir, pPayload->sczFilePath, &pPayload->sczLocalFilePath);
         ExitOnFailure(hr, "Failed to concat file paths.");
 
-        // extract file
         hr = PathGetDirectory(pPayload->sczLocalFilePath, &sczDirectory);
         ExitOnFailure(hr, "Failed to get directory portion of local file path");
 
         hr = DirEnsureExists(sczDirectory, NULL);
         ExitOnFailure(hr, "Failed to ensure directory exists");
 
-        hr = ContainerStreamToFile(pContainerContext, pPayload->sczLocalFilePath);
-        ExitOnFailure(hr, "Failed to extract file.");
+        // The BA DLL is always the first UX payload. It and the other DLLs it may depend on get priority
+        // so the BA can be loaded while the rest of the payloads are still being extracted.
+        wzExtension = PathExtension(pPayload->sczLocalFilePath);
 
-        // flag that the payload has been acquired
-        pPayload->state = BURN_PAYLOAD_STATE_ACQUIRED;
+        pExtraction->rgTargets[i].wzStreamName = pPayload->sczSourcePath;
+        pExtraction->rgTargets[i].wzTargetFile = pPayload->sczLocalFilePath;
+        pExtraction->rgTargets[i].fPriority = 0 == i || (wzExtension && CSTR_EQUAL == ::CompareStringW(LOCALE_NEUTRAL, NORM_IGNORECASE, wzExtension, -1, L".dll", -1));
     }
 
-    // locate any payloads that were not extracted
-    for (DWORD i = 0; i < pPayloads->cPayloads; ++i)
+    pExtraction->hPriorityWrittenEvent = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+    ExitOnNullWithLastError(pExtraction->hPriorityWrittenEvent, hr, "Failed to create priority payloads event.");
+
+    pExtraction->qwStartTicks = ::GetTickCount64();
+
+    // extract all payloads in one pass over the container
+    pExtraction->hThread = ::CreateThread(NULL, 0, ExtractUXContainerThreadProc, pExtraction, 0, NULL);
+    ExitOnNullWithLastError(pExtraction->hThread, hr, "Failed to create UX container extraction thread.");
+
+LExit:
+    ReleaseStr(sczDirectory);
+
+    return hr;
+}
+
+extern "C" HRESULT PayloadWaitForUXPriorityPayloads(
+    __in BURN_PAYLOAD_EXTRACTION* pExtraction
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE rghWait[2] = { };
+    DWORD dwSignaledIndex = 0;
+
+    if (pExtraction->fCompleted)
     {
-        pPayload = &pPayloads->rgPayloads[i];
+        ExitFunction1(hr = pExtraction->hrExtract);
+    }
+
+    ExitOnNull(pExtraction->hThread, hr, E_INVALIDSTATE, "UX container extraction was not started.");
+
+    rghWait[0] = pExtraction->hPriorityWrittenEvent;
+    rghWait[1] = pExtraction->hThread;
+
+    hr = AppWaitForMultipleObjects(countof(rghWait), rghWait, FALSE, INFINITE, &dwSignaledIndex);
+    ExitOnFailure(hr, "Failed to wait for priority BA payloads.");
+
+    // If extraction ended first it either failed or the priority payloads are on disk along with everything else.
+    if (1 == dwSignaledIndex)
+    {
+        hr = pExtraction->hrExtract;
+        ExitOnFailure(hr, "Failed to extract priority BA payloads.");
+    }
+
+    if (pExtraction->rgTargets)
+    {
+        LogStringLine(REPORT_VERBOSE, "BA DLL was on disk %llu ms after UX container extraction started.", pExtraction->rgTargets[0].qwWrittenTicks - pExtraction->qwStartTicks);
+    }
+
+LExit:
+    return hr;
+}
 
-        // if the payload has not been acquired
-        if (BURN_PAYLOAD_STATE_ACQUIRED > pPayload->state)
+extern "C" HRESULT PayloadCompleteUXExtraction(
+    __in BURN_PAYLOAD_EXTRACTION* pExtraction
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_PAYLOADS* pPayloads = pExtraction->pPayloads;
+    BURN_PAYLOAD* pPayload = NULL;
+
+    // Later calls return the result of the first.
+    if (pExtraction->fCompleted)
+    {
+        ExitFunction1(hr = pExtraction->hrExtract);
+    }
+
+    if (pExtraction->hThread)
+    {
+        hr = AppWaitForSingleObject(pExtraction->hThread, INFINITE);
+        ExitOnFailure(hr, "Failed to wait for UX container extraction.");
+
+        hr = pExtraction->hrExtract;
+        ExitOnFailure(hr, "Failed to extract files.");
+
+        LogStringLine(REPORT_VERBOSE, "Extracted %u BA payloads in %llu ms.", pPayloads->cPayloads, pExtraction->qwCompletedTicks - pExtraction->qwStartTicks);
+
+        // locate any payloads that were not extracted
+        for (DWORD i = 0; i < pPayloads->cPayloads; ++i)
         {
-            ExitWithRootFailure(hr, E_INVALIDDATA, "Payload was not found in container: %ls", pPayload->sczKey);
+            pPayload = &pPayloads->rgPayloads[i];
+
+            if (!pExtraction->rgTargets[i].fExtracted)
+            {
+                ExitWithRootFailure(hr, E_INVALIDDATA, "Payload was not found in container: %ls", pPayload->sczKey);
+            }
+
+            // flag that the payload has been acquired
+            pPayload->state = BURN_PAYLOAD_STATE_ACQUIRED;
         }
     }
 
 LExit:
-    ReleaseStr(sczStreamName);
-    ReleaseStr(sczDirectory);
+    // Keep the thread if waiting failed so the container is not closed out from under it.
+    if (!pExtraction->hThread || WAIT_OBJECT_0 == ::WaitForSingleObject(pExtraction->hThread, 0))
+    {
+        if (pExtraction->pContainerContext)
+        {
+            ContainerClose(pExtraction->pContainerContext);
+            ReleaseNullMem(pExtraction->pContainerContext);
+        }
+
+        ReleaseNullHandle(pExtraction->hThread);
+        ReleaseNullHandle(pExtraction->hPriorityWrittenEvent);
+        ReleaseNullMem(pExtraction->rgTargets);
+
+        pExtraction->hrExtract = hr;
+        pExtraction->fCompleted = TRUE;
+    }
 
     return hr;
 }
@@ -358,3 +454,15 @@ extern "C" HRESULT PayloadFindEmbeddedBySourcePath(
 
 
 // internal function definitions
+
+static DWORD WINAPI ExtractUXContainerThreadProc(
+    __in LPVOID lpThreadParameter
+    )
+{
+    BURN_PAYLOAD_EXTRACTION* pExtraction = (BURN_PAYLOAD_EXTRACTION*)lpThreadParameter;
+
+    pExtraction->hrExtract = ContainerStreamsToFiles(pExtraction->pContainerContext, pExtraction->rgTargets, pExtraction->pPayloads->cPayloads, pExtraction->hPriorityWrittenEvent);
+    pExtraction->qwCompletedTicks = ::GetTickCount64();
+
+    return (DWORD)pExtraction->hrExtract;
+}
@@ -85,6 +85,19 @@ typedef struct _BURN_PAYLOAD_GROUP
     DWORD64 qwTotalSize;
 } BURN_PAYLOAD_GROUP;
 
+typedef struct _BURN_PAYLOAD_EXTRACTION
+{
+    BURN_PAYLOADS* pPayloads;
+    BURN_CONTAINER_CONTEXT* pContainerContext;  // allocated with MemAlloc, owned from PayloadExtractUXContainer on.
+    BURN_CONTAINER_STREAM_TARGET* rgTargets;
+    HANDLE hThread;
+    HANDLE hPriorityWrittenEvent;               // set once the BA DLL and the DLLs it may depend on are on disk.
+    DWORD64 qwStartTicks;
+    DWORD64 qwCompletedTicks;
+    HRESULT hrExtract;
+    BOOL fCompleted;
+} BURN_PAYLOAD_EXTRACTION;
+
 // functions
 
 HRESULT PayloadsParseFromXml(
@@ -102,7 +115,14 @@ void PayloadsUninitialize(
 HRESULT PayloadExtractUXContainer(
     __in BURN_PAYLOADS* pPayloads,
     __in BURN_CONTAINER_CONTEXT* pContainerContext,
-    __in_z LPCWSTR wzTargetDir
+    __in_z LPCWSTR wzTargetDir,
+    __in BURN_PAYLOAD_EXTRACTION* pExtraction
+    );
+HRESULT PayloadWaitForUXPriorityPayloads(
+    __in BURN_PAYLOAD_EXTRACTION* pExtraction
+    );
+HRESULT PayloadCompleteUXExtraction(
+    __in BURN_PAYLOAD_EXTRACTION* pExtraction
     );
 HRESULT PayloadFindById(
     __in BURN_PAYLOADS* pPayloads,
@@ -85,6 +85,9 @@ extern "C" HRESULT PipeSendMessage(
 {
     HRESULT hr = S_OK;
     BURN_PIPE_RESULT result = { };
+    BURN_TRACE_SPAN traceSpan = { };
+
+    TracingSpanBegin(&traceSpan, L"PipeSendMessage", NULL, dwMessage);
 
     hr = WritePipeMessage(hPipe, dwMessage, pvData, cbData);
     ExitOnFailure(hr, "Failed to write send message to pipe.");
@@ -95,6 +98,8 @@ extern "C" HRESULT PipeSendMessage(
     *pdwResult = result.dwResult;
 
 LExit:
+    TracingSpanEnd(&traceSpan, hr);
+
     return hr;
 }
 
@@ -291,6 +291,7 @@ extern "C" void PlanUninitializeExecuteAction(
         ReleaseStr(pExecuteAction->relatedBundle.sczIgnoreDependencies);
         ReleaseStr(pExecuteAction->relatedBundle.sczAncestors);
         ReleaseStr(pExecuteAction->relatedBundle.sczEngineWorkingDirectory);
+        ReleaseStr(pExecuteAction->relatedBundle.sczDetectSnapshot);
         break;
 
     case BURN_EXECUTE_ACTION_TYPE_BUNDLE_PACKAGE:
@@ -298,11 +299,13 @@ extern "C" void PlanUninitializeExecuteAction(
         ReleaseStr(pExecuteAction->bundlePackage.sczIgnoreDependencies);
         ReleaseStr(pExecuteAction->bundlePackage.sczAncestors);
         ReleaseStr(pExecuteAction->bundlePackage.sczEngineWorkingDirectory);
+        ReleaseStr(pExecuteAction->bundlePackage.sczDetectSnapshot);
         break;
 
     case BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE:
         ReleaseStr(pExecuteAction->exePackage.sczAncestors);
         ReleaseStr(pExecuteAction->exePackage.sczEngineWorkingDirectory);
+        ReleaseStr(pExecuteAction->exePackage.sczDetectSnapshot);
         break;
 
     case BURN_EXECUTE_ACTION_TYPE_MSI_PACKAGE:
@@ -1737,6 +1740,96 @@ extern "C" HRESULT PlanFinalizeActions(
     return hr;
 }
 
+extern "C" void PlanParallelExecuteActions(
+    __in BURN_PLAN* pPlan
+    )
+{
+    BOOL fInsideMsiTransaction = FALSE;
+    DWORD iRunStart = 0;
+    DWORD cRunPackages = 0;
+
+    pPlan->cParallelGroups = 0;
+
+    // Find runs of actions inside a single rollback boundary and outside any MSI transaction that
+    // contain only package actions and their checkpoints, cache waits and dependency registration.
+    // A run becomes a parallel group when it has more than one package. A package that was not
+    // authored as parallel, every MSI package since Windows Installer runs one install at a time,
+    // and any other action ends the run.
+    for (DWORD i = 0; i <= pPlan->cExecuteActions; ++i)
+    {
+        BURN_EXECUTE_ACTION* pAction = i < pPlan->cExecuteActions ? pPlan->rgExecuteActions + i : NULL;
+        BURN_PACKAGE* pPackage = NULL;
+        BOOL fEndRun = !pAction;
+
+        if (pAction && !pAction->fDeleted)
+        {
+            switch (pAction->type)
+            {
+            case BURN_EXECUTE_ACTION_TYPE_CHECKPOINT: __fallthrough;
+            case BURN_EXECUTE_ACTION_TYPE_WAIT_CACHE_PACKAGE: __fallthrough;
+            case BURN_EXECUTE_ACTION_TYPE_PACKAGE_PROVIDER: __fallthrough;
+            case BURN_EXECUTE_ACTION_TYPE_PACKAGE_DEPENDENCY:
+                fEndRun = fInsideMsiTransaction;
+                break;
+
+            case BURN_EXECUTE_ACTION_TYPE_BUNDLE_PACKAGE:
+                pPackage = pAction->bundlePackage.pPackage;
+                fEndRun = fInsideMsiTransaction || !pPackage->fParallel;
+                break;
+
+            case BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE:
+                pPackage = pAction->exePackage.pPackage;
+                fEndRun = fInsideMsiTransaction || !pPackage->fParallel;
+                break;
+
+            case BURN_EXECUTE_ACTION_TYPE_MSU_PACKAGE:
+                pPackage = pAction->msuPackage.pPackage;
+                fEndRun = fInsideMsiTransaction || !pPackage->fParallel;
+                break;
+
+            case BURN_EXECUTE_ACTION_TYPE_BEGIN_MSI_TRANSACTION:
+                fInsideMsiTransaction = TRUE;
+                fEndRun = TRUE;
+                break;
+
+            case BURN_EXECUTE_ACTION_TYPE_COMMIT_MSI_TRANSACTION:
+                fInsideMsiTransaction = FALSE;
+                fEndRun = TRUE;
+                break;
+
+            default:
+                fEndRun = TRUE;
+                break;
+            }
+        }
+
+        if (pAction)
+        {
+            pAction->dwParallelGroup = 0;
+        }
+
+        if (fEndRun)
+        {
+            if (1 < cRunPackages)
+            {
+                ++pPlan->cParallelGroups;
+
+                for (DWORD j = iRunStart; j < i; ++j)
+                {
+                    pPlan->rgExecuteActions[j].dwParallelGroup = pPlan->cParallelGroups;
+                }
+            }
+
+            iRunStart = i + 1;
+            cRunPackages = 0;
+        }
+        else if (pPackage)
+        {
+            ++cRunPackages;
+        }
+    }
+}
+
 extern "C" HRESULT PlanCleanPackage(
     __in BURN_PLAN* pPlan,
     __in BURN_PACKAGE* pPackage
@@ -3024,6 +3117,10 @@ static void ExecuteActionLog(
     {
         LogStringLine(PlanDumpLevel, "      (deleted action)");
     }
+    else if (pAction->dwParallelGroup)
+    {
+        LogStringLine(PlanDumpLevel, "      (parallel group: %u)", pAction->dwParallelGroup);
+    }
 }
 
 static void RestoreRelatedBundleActionLog(
@@ -3113,6 +3210,7 @@ extern "C" void PlanDump(
 
     LogStringLine(PlanDumpLevel, "Plan execute package count: %u", pPlan->cExecutePackagesTotal);
     LogStringLine(PlanDumpLevel, "     overall progress ticks: %u", pPlan->cOverallProgressTicksTotal);
+    LogStringLine(PlanDumpLevel, "     parallel groups: %u", pPlan->cParallelGroups);
     for (DWORD i = 0; i < pPlan->cExecuteActions; ++i)
     {
         ExecuteActionLog(i, pPlan->rgExecuteActions + i, FALSE);
@@ -143,6 +143,7 @@ typedef struct _BURN_EXECUTE_ACTION
 {
     BURN_EXECUTE_ACTION_TYPE type;
     BOOL fDeleted; // used to skip an action after it was planned since deleting actions out of the plan is too hard.
+    DWORD dwParallelGroup; // non-zero when the action belongs to a run of actions whose packages may execute concurrently.
     union
     {
         BURN_EXECUTE_ACTION_CHECKPOINT checkpoint;
@@ -161,6 +162,7 @@ typedef struct _BURN_EXECUTE_ACTION
             LPWSTR sczIgnoreDependencies;
             LPWSTR sczAncestors;
             LPWSTR sczEngineWorkingDirectory;
+            LPWSTR sczDetectSnapshot;
         } relatedBundle;
         struct
         {
@@ -170,6 +172,7 @@ typedef struct _BURN_EXECUTE_ACTION
             LPWSTR sczIgnoreDependencies;
             LPWSTR sczAncestors;
             LPWSTR sczEngineWorkingDirectory;
+            LPWSTR sczDetectSnapshot;
         } bundlePackage;
         struct
         {
@@ -177,6 +180,7 @@ typedef struct _BURN_EXECUTE_ACTION
             BOOTSTRAPPER_ACTION_STATE action;
             LPWSTR sczAncestors;
             LPWSTR sczEngineWorkingDirectory;
+            LPWSTR sczDetectSnapshot;
         } exePackage;
         struct
         {
@@ -270,6 +274,7 @@ typedef struct _BURN_PLAN
 
     DWORD cExecutePackagesTotal;
     DWORD cOverallProgressTicksTotal;
+    DWORD cParallelGroups;
 
     BOOL fEnabledForwardCompatibleBundle;
     BURN_PACKAGE forwardCompatibleBundle;
@@ -432,6 +437,9 @@ HRESULT PlanRelatedBundlesComplete(
 HRESULT PlanFinalizeActions(
     __in BURN_PLAN* pPlan
     );
+void PlanParallelExecuteActions(
+    __in BURN_PLAN* pPlan
+    );
 HRESULT PlanCleanPackage(
     __in BURN_PLAN* pPlan,
     __in BURN_PACKAGE* pPackage
@@ -34,6 +34,7 @@
 #include <envutil.h>
 #include <fileutil.h>
 #include <guidutil.h>
+#include <jsonutil.h>
 #include <logutil.h>
 #include <memutil.h>
 #include <osutil.h>
@@ -84,6 +85,7 @@
 #include "detect.h"
 #include "plan.h"
 #include "logging.h"
+#include "tracing.h"
 #include "pipe.h"
 #include "cache.h"
 #include "dependency.h"
@@ -556,11 +556,8 @@ extern "C" HRESULT RegistrationDetectRelatedBundles(
 {
     HRESULT hr = S_OK;
 
-    hr = RelatedBundlesInitializeForScope(TRUE, pRegistration, &pRegistration->relatedBundles);
-    ExitOnFailure(hr, "Failed to initialize per-machine related bundles.");
-
-    hr = RelatedBundlesInitializeForScope(FALSE, pRegistration, &pRegistration->relatedBundles);
-    ExitOnFailure(hr, "Failed to initialize per-user related bundles.");
+    hr = RelatedBundlesInitialize(pRegistration, &pRegistration->relatedBundles);
+    ExitOnFailure(hr, "Failed to initialize related bundles.");
 
     RelatedBundlesSortDetect(&pRegistration->relatedBundles);
 
@@ -40,6 +40,39 @@ static HRESULT LoadRelatedBundleFromKey(
 
 // function definitions
 
+extern "C" HRESULT RelatedBundlesInitialize(
+    __in BURN_REGISTRATION* pRegistration,
+    __in BURN_RELATED_BUNDLES* pRelatedBundles
+    )
+{
+    HRESULT hr = S_OK;
+    const BUNDLE_INSTALL_CONTEXT rgInstallContexts[] = { BUNDLE_INSTALL_CONTEXT_MACHINE, BUNDLE_INSTALL_CONTEXT_USER };
+    BUNDLE_QUERY_CONTEXT queryContext = { };
+
+    queryContext.pRegistration = pRegistration;
+    queryContext.pRelatedBundles = pRelatedBundles;
+
+    // The registry is searched concurrently but related bundles are loaded here,
+    // per-machine first, in the same order as initializing each scope in turn.
+    hr = BundleQueryRelatedBundlesForContexts(
+        rgInstallContexts,
+        countof(rgInstallContexts),
+        const_cast<LPCWSTR*>(pRegistration->rgsczDetectCodes),
+        pRegistration->cDetectCodes,
+        const_cast<LPCWSTR*>(pRegistration->rgsczUpgradeCodes),
+        pRegistration->cUpgradeCodes,
+        const_cast<LPCWSTR*>(pRegistration->rgsczAddonCodes),
+        pRegistration->cAddonCodes,
+        const_cast<LPCWSTR*>(pRegistration->rgsczPatchCodes),
+        pRegistration->cPatchCodes,
+        QueryRelatedBundlesCallback,
+        &queryContext);
+    ExitOnFailure(hr, "Failed to initialize related bundles.");
+
+LExit:
+    return hr;
+}
+
 extern "C" HRESULT RelatedBundlesInitializeForScope(
     __in BOOL fPerMachine,
     __in BURN_REGISTRATION* pRegistration,
@@ -6,6 +6,10 @@
 extern "C" {
 #endif
 
+HRESULT RelatedBundlesInitialize(
+    __in BURN_REGISTRATION* pRegistration,
+    __in BURN_RELATED_BUNDLES* pRelatedBundles
+    );
 HRESULT RelatedBundlesInitializeForScope(
     __in BOOL fPerMachine,
     __in BURN_REGISTRATION* pRegistration,
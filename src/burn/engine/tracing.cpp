@@ -0,0 +1,370 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+
+// structs
+
+typedef struct _BURN_TRACE_EVENT
+{
+    LPCWSTR wzName;
+    LPWSTR sczId;
+    DWORD dwData;
+    DWORD dwThreadId;
+    LONGLONG llStart;
+    LONGLONG llEnd;
+    HRESULT hrResult;
+} BURN_TRACE_EVENT;
+
+typedef struct _BURN_TRACING
+{
+    CRITICAL_SECTION cs;
+    LPWSTR sczTraceFile;
+    LARGE_INTEGER liFrequency;
+    LARGE_INTEGER liBase;
+
+    BURN_TRACE_EVENT* rgEvents;
+    DWORD cEvents;
+    DWORD cDroppedEvents;
+} BURN_TRACING;
+
+
+// internal variables
+
+static volatile BOOL vfTracingEnabled = FALSE;
+static BURN_TRACING vTracing = { };
+
+
+// internal function declarations
+
+static HRESULT WriteTraceFile();
+static DWORD64 TicksToMicroseconds(
+    __in LONGLONG llTicks
+    );
+static void FreeEvents();
+
+
+// function definitions
+
+extern "C" HRESULT TracingInitialize(
+    __in_z_opt LPCWSTR wzTraceFile
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!wzTraceFile || !*wzTraceFile || vfTracingEnabled)
+    {
+        ExitFunction();
+    }
+
+    hr = StrAllocString(&vTracing.sczTraceFile, wzTraceFile, 0);
+    ExitOnFailure(hr, "Failed to copy trace file path.");
+
+    ::InitializeCriticalSection(&vTracing.cs);
+    ::QueryPerformanceFrequency(&vTracing.liFrequency);
+    ::QueryPerformanceCounter(&vTracing.liBase);
+
+    vfTracingEnabled = TRUE;
+
+    LogStringLine(REPORT_STANDARD, "Recording execution trace to: %ls", vTracing.sczTraceFile);
+
+LExit:
+    return hr;
+}
+
+extern "C" void TracingUninitialize()
+{
+    HRESULT hr = S_OK;
+
+    if (!vfTracingEnabled)
+    {
+        ExitFunction();
+    }
+
+    vfTracingEnabled = FALSE;
+
+    ::EnterCriticalSection(&vTracing.cs);
+
+    hr = WriteTraceFile();
+    if (FAILED(hr))
+    {
+        LogErrorString(hr, "Failed to write execution trace to: %ls", vTracing.sczTraceFile);
+    }
+    else
+    {
+        LogStringLine(REPORT_STANDARD, "Wrote %u trace events to: %ls", vTracing.cEvents, vTracing.sczTraceFile);
+    }
+
+    if (vTracing.cDroppedEvents)
+    {
+        LogStringLine(REPORT_WARNING, "Dropped %u trace events after reaching the limit of %u.", vTracing.cDroppedEvents, BURN_TRACE_MAX_EVENTS);
+    }
+
+    FreeEvents();
+    ReleaseNullStr(vTracing.sczTraceFile);
+
+    ::LeaveCriticalSection(&vTracing.cs);
+    ::DeleteCriticalSection(&vTracing.cs);
+
+LExit:
+    return;
+}
+
+extern "C" BOOL TracingIsEnabled()
+{
+    return vfTracingEnabled;
+}
+
+extern "C" void TracingSpanBegin(
+    __in BURN_TRACE_SPAN* pSpan,
+    __in_z LPCWSTR wzName,
+    __in_z_opt LPCWSTR wzId,
+    __in DWORD dwData
+    )
+{
+    LARGE_INTEGER liStart = { };
+
+    pSpan->fActive = FALSE;
+
+    if (!vfTracingEnabled)
+    {
+        return;
+    }
+
+    ::QueryPerformanceCounter(&liStart);
+
+    pSpan->wzName = wzName;
+    pSpan->wzId = wzId;
+    pSpan->dwData = dwData;
+    pSpan->llStart = liStart.QuadPart;
+    pSpan->fActive = TRUE;
+}
+
+extern "C" void TracingSpanEnd(
+    __in BURN_TRACE_SPAN* pSpan,
+    __in HRESULT hrResult
+    )
+{
+    HRESULT hr = S_OK;
+    LARGE_INTEGER liEnd = { };
+    BURN_TRACE_EVENT* pEvent = NULL;
+    BOOL fLocked = FALSE;
+
+    if (!pSpan->fActive || !vfTracingEnabled)
+    {
+        ExitFunction();
+    }
+
+    ::QueryPerformanceCounter(&liEnd);
+
+    ::EnterCriticalSection(&vTracing.cs);
+    fLocked = TRUE;
+
+    if (BURN_TRACE_MAX_EVENTS <= vTracing.cEvents)
+    {
+        ++vTracing.cDroppedEvents;
+        ExitFunction();
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&vTracing.rgEvents), vTracing.cEvents, 1, sizeof(BURN_TRACE_EVENT), 64);
+    ExitOnFailure(hr, "Failed to grow trace event array.");
+
+    pEvent = vTracing.rgEvents + vTracing.cEvents;
+
+    if (pSpan->wzId)
+    {
+        hr = StrAllocString(&pEvent->sczId, pSpan->wzId, 0);
+        ExitOnFailure(hr, "Failed to copy trace event id.");
+    }
+
+    pEvent->wzName = pSpan->wzName;
+    pEvent->dwData = pSpan->dwData;
+    pEvent->dwThreadId = ::GetCurrentThreadId();
+    pEvent->llStart = pSpan->llStart;
+    pEvent->llEnd = liEnd.QuadPart;
+    pEvent->hrResult = hrResult;
+
+    ++vTracing.cEvents;
+
+LExit:
+    if (fLocked)
+    {
+        ::LeaveCriticalSection(&vTracing.cs);
+    }
+
+    pSpan->fActive = FALSE;
+}
+
+
+// internal function definitions
+
+static HRESULT WriteTraceFile()
+{
+    HRESULT hr = S_OK;
+    JSON_WRITER writer = { };
+    BOOL fWriterInitialized = FALSE;
+    DWORD dwProcessId = ::GetCurrentProcessId();
+    LPWSTR sczResult = NULL;
+    LPWSTR sczDirectory = NULL;
+
+    hr = PathGetDirectory(vTracing.sczTraceFile, &sczDirectory);
+    ExitOnFailure(hr, "Failed to get trace file directory.");
+
+    if (sczDirectory && *sczDirectory)
+    {
+        hr = DirEnsureExists(sczDirectory, NULL);
+        ExitOnFailure(hr, "Failed to create trace file directory: %ls", sczDirectory);
+    }
+
+    // Stream the events to the file in chunks rather than building the whole document in memory.
+    hr = JsonInitializeWriterToFile(vTracing.sczTraceFile, &writer);
+    ExitOnFailure(hr, "Failed to create trace file: %ls", vTracing.sczTraceFile);
+
+    fWriterInitialized = TRUE;
+
+    hr = JsonWriteObjectStart(&writer);
+    ExitOnFailure(hr, "Failed to start trace object.");
+
+    hr = JsonWriteObjectKey(&writer, L"displayTimeUnit");
+    ExitOnFailure(hr, "Failed to write trace display unit key.");
+
+    hr = JsonWriteString(&writer, L"ms");
+    ExitOnFailure(hr, "Failed to write trace display unit.");
+
+    hr = JsonWriteObjectKey(&writer, L"traceEvents");
+    ExitOnFailure(hr, "Failed to write trace events key.");
+
+    hr = JsonWriteArrayStart(&writer);
+    ExitOnFailure(hr, "Failed to start trace events.");
+
+    for (DWORD i = 0; i < vTracing.cEvents; ++i)
+    {
+        BURN_TRACE_EVENT* pEvent = vTracing.rgEvents + i;
+        DWORD64 qwStart = TicksToMicroseconds(pEvent->llStart - vTracing.liBase.QuadPart);
+        DWORD64 qwDuration = TicksToMicroseconds(pEvent->llEnd - pEvent->llStart);
+
+        hr = StrAllocFormatted(&sczResult, L"0x%08x", pEvent->hrResult);
+        ExitOnFailure(hr, "Failed to format trace event result.");
+
+        hr = JsonWriteObjectStart(&writer);
+        ExitOnFailure(hr, "Failed to start trace event.");
+
+        hr = JsonWriteObjectKey(&writer, L"name");
+        ExitOnFailure(hr, "Failed to write trace event name key.");
+
+        hr = JsonWriteString(&writer, pEvent->wzName);
+        ExitOnFailure(hr, "Failed to write trace event name.");
+
+        hr = JsonWriteObjectKey(&writer, L"cat");
+        ExitOnFailure(hr, "Failed to write trace event category key.");
+
+        hr = JsonWriteString(&writer, L"burn");
+        ExitOnFailure(hr, "Failed to write trace event category.");
+
+        hr = JsonWriteObjectKey(&writer, L"ph");
+        ExitOnFailure(hr, "Failed to write trace event phase key.");
+
+        hr = JsonWriteString(&writer, L"X");
+        ExitOnFailure(hr, "Failed to write trace event phase.");
+
+        hr = JsonWriteObjectKey(&writer, L"ts");
+        ExitOnFailure(hr, "Failed to write trace event timestamp key.");
+
+        hr = JsonWriteNumber64(&writer, qwStart);
+        ExitOnFailure(hr, "Failed to write trace event timestamp.");
+
+        hr = JsonWriteObjectKey(&writer, L"dur");
+        ExitOnFailure(hr, "Failed to write trace event duration key.");
+
+        hr = JsonWriteNumber64(&writer, qwDuration);
+        ExitOnFailure(hr, "Failed to write trace event duration.");
+
+        hr = JsonWriteObjectKey(&writer, L"pid");
+        ExitOnFailure(hr, "Failed to write trace event process id key.");
+
+        hr = JsonWriteNumber(&writer, dwProcessId);
+        ExitOnFailure(hr, "Failed to write trace event process id.");
+
+        hr = JsonWriteObjectKey(&writer, L"tid");
+        ExitOnFailure(hr, "Failed to write trace event thread id key.");
+
+        hr = JsonWriteNumber(&writer, pEvent->dwThreadId);
+        ExitOnFailure(hr, "Failed to write trace event thread id.");
+
+        hr = JsonWriteObjectKey(&writer, L"args");
+        ExitOnFailure(hr, "Failed to write trace event args key.");
+
+        hr = JsonWriteObjectStart(&writer);
+        ExitOnFailure(hr, "Failed to start trace event args.");
+
+        if (pEvent->sczId)
+        {
+            hr = JsonWriteObjectKey(&writer, L"id");
+            ExitOnFailure(hr, "Failed to write trace event id key.");
+
+            hr = JsonWriteString(&writer, pEvent->sczId);
+            ExitOnFailure(hr, "Failed to write trace event id.");
+        }
+
+        hr = JsonWriteObjectKey(&writer, L"data");
+        ExitOnFailure(hr, "Failed to write trace event data key.");
+
+        hr = JsonWriteNumber(&writer, pEvent->dwData);
+        ExitOnFailure(hr, "Failed to write trace event data.");
+
+        hr = JsonWriteObjectKey(&writer, L"hr");
+        ExitOnFailure(hr, "Failed to write trace event result key.");
+
+        hr = JsonWriteString(&writer, sczResult);
+        ExitOnFailure(hr, "Failed to write trace event result.");
+
+        hr = JsonWriteObjectEnd(&writer);
+        ExitOnFailure(hr, "Failed to end trace event args.");
+
+        hr = JsonWriteObjectEnd(&writer);
+        ExitOnFailure(hr, "Failed to end trace event.");
+    }
+
+    hr = JsonWriteArrayEnd(&writer);
+    ExitOnFailure(hr, "Failed to end trace events.");
+
+    hr = JsonWriteObjectEnd(&writer);
+    ExitOnFailure(hr, "Failed to end trace object.");
+
+    hr = JsonFlushWriter(&writer);
+    ExitOnFailure(hr, "Failed to write trace file: %ls", vTracing.sczTraceFile);
+
+LExit:
+    ReleaseStr(sczDirectory);
+    ReleaseStr(sczResult);
+
+    if (fWriterInitialized)
+    {
+        JsonUninitializeWriter(&writer);
+    }
+
+    return hr;
+}
+
+static DWORD64 TicksToMicroseconds(
+    __in LONGLONG llTicks
+    )
+{
+    DWORD64 qwTicks = llTicks < 0 ? 0 : static_cast<DWORD64>(llTicks);
+    DWORD64 qwFrequency = static_cast<DWORD64>(vTracing.liFrequency.QuadPart);
+
+    // Split the conversion so long traces do not overflow the multiplication.
+    return (qwTicks / qwFrequency) * 1000000 + (qwTicks % qwFrequency) * 1000000 / qwFrequency;
+}
+
+static void FreeEvents()
+{
+    for (DWORD i = 0; i < vTracing.cEvents; ++i)
+    {
+        ReleaseStr(vTracing.rgEvents[i].sczId);
+    }
+
+    ReleaseNullMem(vTracing.rgEvents);
+    vTracing.cEvents = 0;
+    vTracing.cDroppedEvents = 0;
+}
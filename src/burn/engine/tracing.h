@@ -0,0 +1,60 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// constants
+
+const DWORD BURN_TRACE_MAX_EVENTS = 100000;
+
+// structs
+
+typedef struct _BURN_TRACE_SPAN
+{
+    BOOL fActive;
+    LPCWSTR wzName;
+    LPCWSTR wzId;
+    DWORD dwData;
+    LONGLONG llStart;
+} BURN_TRACE_SPAN;
+
+
+// functions
+
+/********************************************************************
+ TracingInitialize - starts recording spans when a trace file was
+                     requested on the command line. When wzTraceFile
+                     is NULL tracing stays disabled and every span call
+                     returns after a single flag check.
+
+*********************************************************************/
+HRESULT TracingInitialize(
+    __in_z_opt LPCWSTR wzTraceFile
+    );
+
+/********************************************************************
+ TracingUninitialize - writes the recorded spans as Chrome trace event
+                       JSON to the trace file and stops recording.
+
+*********************************************************************/
+void TracingUninitialize();
+
+BOOL TracingIsEnabled();
+
+void TracingSpanBegin(
+    __in BURN_TRACE_SPAN* pSpan,
+    __in_z LPCWSTR wzName,
+    __in_z_opt LPCWSTR wzId,
+    __in DWORD dwData
+    );
+void TracingSpanEnd(
+    __in BURN_TRACE_SPAN* pSpan,
+    __in HRESULT hrResult
+    );
+
+#if defined(__cplusplus)
+}
+#endif
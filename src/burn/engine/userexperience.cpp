@@ -31,6 +31,15 @@ static HRESULT SendBAMessageFromInactiveEngine(
     __inout LPVOID pvResults
     );
 
+static BOOL EnterParallelExecute(
+    __in BURN_USER_EXPERIENCE* pUserExperience
+    );
+
+static void LeaveParallelExecute(
+    __in BURN_USER_EXPERIENCE* pUserExperience,
+    __in BOOL fEntered
+    );
+
 
 // function definitions
 
@@ -45,6 +54,8 @@ extern "C" HRESULT UserExperienceParseFromXml(
 {
     HRESULT hr = S_OK;
     IXMLDOMNode* pixnUserExperienceNode = NULL;
+    BOOL fFoundXml = FALSE;
+    DWORD dwUpdatesPerSecond = 0;
 
     // select UX node
     hr = XmlSelectSingleNode(pixnBundle, L"UX", &pixnUserExperienceNode);
@@ -54,6 +65,19 @@ extern "C" HRESULT UserExperienceParseFromXml(
     }
     ExitOnFailure(hr, "Failed to select user experience node.");
 
+    // @ProgressUpdatesPerSecond
+    hr = XmlGetAttributeNumber(pixnUserExperienceNode, L"ProgressUpdatesPerSecond", &dwUpdatesPerSecond);
+    ExitOnOptionalXmlQueryFailure(hr, fFoundXml, "Failed to get @ProgressUpdatesPerSecond.");
+
+    if (fFoundXml && dwUpdatesPerSecond)
+    {
+        pUserExperience->dwProgressInterval = 1000 / min(dwUpdatesPerSecond, 1000);
+    }
+
+    // @ProgressPercentageStep
+    hr = XmlGetAttributeNumber(pixnUserExperienceNode, L"ProgressPercentageStep", &pUserExperience->dwProgressPercentageStep);
+    ExitOnOptionalXmlQueryFailure(hr, fFoundXml, "Failed to get @ProgressPercentageStep.");
+
     // parse payloads
     hr = PayloadsParseFromXml(&pUserExperience->payloads, NULL, NULL, pixnUserExperienceNode);
     ExitOnFailure(hr, "Failed to parse user experience payloads.");
@@ -79,6 +103,14 @@ extern "C" void UserExperienceUninitialize(
     __in BURN_USER_EXPERIENCE* pUserExperience
     )
 {
+    // A BA that was prepared but never created still gets to clean up its background work.
+    if (pUserExperience->hUXModule)
+    {
+        UserExperienceUnload(pUserExperience, FALSE);
+    }
+
+    PayloadCompleteUXExtraction(&pUserExperience->extraction);
+
     ReleaseStr(pUserExperience->sczTempDirectory);
     PayloadsUninitialize(&pUserExperience->payloads);
 
@@ -86,6 +118,57 @@ extern "C" void UserExperienceUninitialize(
     memset(pUserExperience, 0, sizeof(BURN_USER_EXPERIENCE));
 }
 
+/*******************************************************************
+ UserExperiencePrepare - loads the BA DLL as soon as it is extracted,
+                         while the rest of its payloads are still being
+                         extracted, and lets it start expensive startup
+                         work while the engine finishes initializing.
+
+*******************************************************************/
+extern "C" HRESULT UserExperiencePrepare(
+    __in BURN_USER_EXPERIENCE* pUserExperience,
+    __in BOOTSTRAPPER_COMMAND* pCommand
+    )
+{
+    HRESULT hr = S_OK;
+    BOOTSTRAPPER_PREPARE_ARGS args = { };
+    BOOTSTRAPPER_PREPARE_RESULTS results = { };
+    LPCWSTR wzPath = pUserExperience->payloads.rgPayloads[0].sczLocalFilePath;
+    DWORD64 qwLoadStartTicks = 0;
+
+    args.cbSize = sizeof(BOOTSTRAPPER_PREPARE_ARGS);
+    args.pCommand = pCommand;
+
+    results.cbSize = sizeof(BOOTSTRAPPER_PREPARE_RESULTS);
+
+    // The BA DLL and every other DLL payload are extracted first.
+    hr = PayloadWaitForUXPriorityPayloads(&pUserExperience->extraction);
+    ExitOnFailure(hr, "Failed to wait for BA DLL to be extracted.");
+
+    // Load BA DLL.
+    qwLoadStartTicks = ::GetTickCount64();
+
+    pUserExperience->hUXModule = ::LoadLibraryExW(wzPath, NULL, LOAD_WITH_ALTERED_SEARCH_PATH);
+    ExitOnNullWithLastError(pUserExperience->hUXModule, hr, "Failed to load BA DLL: %ls", wzPath);
+
+    LogStringLine(REPORT_VERBOSE, "Loaded BA DLL in %llu ms.", ::GetTickCount64() - qwLoadStartTicks);
+
+    // The BA may read any of its payloads once it is prepared.
+    hr = PayloadCompleteUXExtraction(&pUserExperience->extraction);
+    ExitOnFailure(hr, "Failed to extract bootstrapper application payloads.");
+
+    // Get BootstrapperApplicationPrepare entry-point and call it if it exists.
+    PFN_BOOTSTRAPPER_APPLICATION_PREPARE pfnPrepare = (PFN_BOOTSTRAPPER_APPLICATION_PREPARE)::GetProcAddress(pUserExperience->hUXModule, "BootstrapperApplicationPrepare");
+    if (pfnPrepare)
+    {
+        hr = pfnPrepare(&args, &results);
+        ExitOnFailure(hr, "Failed to prepare BA.");
+    }
+
+LExit:
+    return hr;
+}
+
 /*******************************************************************
  UserExperienceLoad - 
 
@@ -100,6 +183,13 @@ extern "C" HRESULT UserExperienceLoad(
     BOOTSTRAPPER_CREATE_ARGS args = { };
     BOOTSTRAPPER_CREATE_RESULTS results = { };
     LPCWSTR wzPath = pUserExperience->payloads.rgPayloads[0].sczLocalFilePath;
+    FILETIME ftCreation = { };
+    FILETIME ftExit = { };
+    FILETIME ftKernel = { };
+    FILETIME ftUser = { };
+    FILETIME ftNow = { };
+    ULARGE_INTEGER uliCreation = { };
+    ULARGE_INTEGER uliNow = { };
 
     args.cbSize = sizeof(BOOTSTRAPPER_CREATE_ARGS);
     args.pCommand = pCommand;
@@ -109,9 +199,15 @@ extern "C" HRESULT UserExperienceLoad(
 
     results.cbSize = sizeof(BOOTSTRAPPER_CREATE_RESULTS);
 
-    // Load BA DLL.
-    pUserExperience->hUXModule = ::LoadLibraryExW(wzPath, NULL, LOAD_WITH_ALTERED_SEARCH_PATH);
-    ExitOnNullWithLastError(pUserExperience->hUXModule, hr, "Failed to load BA DLL: %ls", wzPath);
+    hr = PayloadCompleteUXExtraction(&pUserExperience->extraction);
+    ExitOnFailure(hr, "Failed to extract bootstrapper application payloads.");
+
+    // Load BA DLL, unless UserExperiencePrepare already did.
+    if (!pUserExperience->hUXModule)
+    {
+        pUserExperience->hUXModule = ::LoadLibraryExW(wzPath, NULL, LOAD_WITH_ALTERED_SEARCH_PATH);
+        ExitOnNullWithLastError(pUserExperience->hUXModule, hr, "Failed to load BA DLL: %ls", wzPath);
+    }
 
     // Get BootstrapperApplicationCreate entry-point.
     PFN_BOOTSTRAPPER_APPLICATION_CREATE pfnCreate = (PFN_BOOTSTRAPPER_APPLICATION_CREATE)::GetProcAddress(pUserExperience->hUXModule, "BootstrapperApplicationCreate");
@@ -124,6 +220,19 @@ extern "C" HRESULT UserExperienceLoad(
     pUserExperience->pfnBAProc = results.pfnBootstrapperApplicationProc;
     pUserExperience->pvBAProcContext = results.pvBootstrapperApplicationProcContext;
 
+    // Time from process start to a created BA is the engine's share of time-to-first-window.
+    if (::GetProcessTimes(::GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser))
+    {
+        ::GetSystemTimeAsFileTime(&ftNow);
+
+        uliCreation.LowPart = ftCreation.dwLowDateTime;
+        uliCreation.HighPart = ftCreation.dwHighDateTime;
+        uliNow.LowPart = ftNow.dwLowDateTime;
+        uliNow.HighPart = ftNow.dwHighDateTime;
+
+        LogStringLine(REPORT_VERBOSE, "Created BA %llu ms after process start.", (uliNow.QuadPart - uliCreation.QuadPart) / 10000);
+    }
+
 LExit:
     return hr;
 }
@@ -198,6 +307,9 @@ extern "C" HRESULT UserExperienceRemove(
 {
     HRESULT hr = S_OK;
 
+    // Nothing may still be writing into the directory.
+    PayloadCompleteUXExtraction(&pUserExperience->extraction);
+
     // Remove temporary UX directory
     if (pUserExperience->sczTempDirectory)
     {
@@ -289,6 +401,63 @@ extern "C" void UserExperienceExecutePhaseComplete(
     }
 }
 
+// Decides whether a progress update is sent to the BA or coalesced into a later one.
+// The first update, the final update and a change of package or payload are always sent.
+// Otherwise an update must satisfy every configured throttle, but one is always sent after
+// BURN_PROGRESS_HEARTBEAT_INTERVAL so the BA keeps getting a chance to cancel.
+extern "C" BOOL UserExperienceShouldSendProgress(
+    __in BURN_USER_EXPERIENCE* pUserExperience,
+    __in BURN_USER_EXPERIENCE_PROGRESS_THROTTLE* pThrottle,
+    __in_z_opt LPCWSTR wzId,
+    __in_z_opt LPCWSTR wzSubId,
+    __in DWORD dwPercentage,
+    __in BOOL fFinal,
+    __in DWORD dwTick
+    )
+{
+    BOOL fSend = TRUE;
+    DWORD dwElapsed = 0;
+    DWORD dwPercentageDelta = 0;
+    BOOL fSerialized = FALSE;
+
+    if (!pUserExperience->dwProgressInterval && !pUserExperience->dwProgressPercentageStep)
+    {
+        ExitFunction();
+    }
+
+    fSerialized = EnterParallelExecute(pUserExperience);
+
+    if (pThrottle->fDelivered && !fFinal && wzId == pThrottle->wzLastId && wzSubId == pThrottle->wzLastSubId)
+    {
+        dwElapsed = dwTick - pThrottle->dwLastTick;
+        dwPercentageDelta = dwPercentage > pThrottle->dwLastPercentage ? dwPercentage - pThrottle->dwLastPercentage : pThrottle->dwLastPercentage - dwPercentage;
+
+        if (dwElapsed < BURN_PROGRESS_HEARTBEAT_INTERVAL)
+        {
+            fSend = (!pUserExperience->dwProgressInterval || dwElapsed >= pUserExperience->dwProgressInterval) &&
+                    (!pUserExperience->dwProgressPercentageStep || dwPercentageDelta >= pUserExperience->dwProgressPercentageStep);
+        }
+    }
+
+    if (fSend)
+    {
+        pThrottle->fDelivered = TRUE;
+        pThrottle->wzLastId = wzId;
+        pThrottle->wzLastSubId = wzSubId;
+        pThrottle->dwLastTick = dwTick;
+        pThrottle->dwLastPercentage = dwPercentage;
+    }
+    else
+    {
+        ++pThrottle->cSuppressed;
+    }
+
+LExit:
+    LeaveParallelExecute(pUserExperience, fSerialized);
+
+    return fSend;
+}
+
 EXTERN_C BAAPI UserExperienceOnApplyBegin(
     __in BURN_USER_EXPERIENCE* pUserExperience,
     __in DWORD dwPhaseCount
@@ -298,6 +467,10 @@ EXTERN_C BAAPI UserExperienceOnApplyBegin(
     BA_ONAPPLYBEGIN_ARGS args = { };
     BA_ONAPPLYBEGIN_RESULTS results = { };
 
+    memset(&pUserExperience->cacheAcquireProgress, 0, sizeof(pUserExperience->cacheAcquireProgress));
+    memset(&pUserExperience->executeProgress, 0, sizeof(pUserExperience->executeProgress));
+    memset(&pUserExperience->overallProgress, 0, sizeof(pUserExperience->overallProgress));
+
     args.cbSize = sizeof(args);
     args.dwPhaseCount = dwPhaseCount;
 
@@ -326,6 +499,11 @@ EXTERN_C BAAPI UserExperienceOnApplyComplete(
     BA_ONAPPLYCOMPLETE_ARGS args = { };
     BA_ONAPPLYCOMPLETE_RESULTS results = { };
 
+    if (pUserExperience->dwProgressInterval || pUserExperience->dwProgressPercentageStep)
+    {
+        LogStringLine(REPORT_VERBOSE, "Coalesced progress updates, cache acquire: %u, execute: %u, overall: %u", pUserExperience->cacheAcquireProgress.cSuppressed, pUserExperience->executeProgress.cSuppressed, pUserExperience->overallProgress.cSuppressed);
+    }
+
     args.cbSize = sizeof(args);
     args.hrStatus = hrStatus;
     args.restart = restart;
@@ -510,6 +688,12 @@ EXTERN_C BAAPI UserExperienceOnCacheAcquireProgress(
     HRESULT hr = S_OK;
     BA_ONCACHEACQUIREPROGRESS_ARGS args = { };
     BA_ONCACHEACQUIREPROGRESS_RESULTS results = { };
+    DWORD dwPercentage = dw64Total ? static_cast<DWORD>(min(dw64Progress, dw64Total) * 100 / dw64Total) : 0;
+
+    if (!UserExperienceShouldSendProgress(pUserExperience, &pUserExperience->cacheAcquireProgress, wzPackageOrContainerId, wzPayloadId, dwPercentage, dw64Progress >= dw64Total, ::GetTickCount()))
+    {
+        ExitFunction();
+    }
 
     args.cbSize = sizeof(args);
     args.wzPackageOrContainerId = wzPackageOrContainerId;
@@ -1819,6 +2003,11 @@ EXTERN_C BAAPI UserExperienceOnExecuteProgress(
     BA_ONEXECUTEPROGRESS_ARGS args = { };
     BA_ONEXECUTEPROGRESS_RESULTS results = { };
 
+    if (!UserExperienceShouldSendProgress(pUserExperience, &pUserExperience->executeProgress, wzPackageId, NULL, dwProgressPercentage, 100 <= dwProgressPercentage || 100 <= dwOverallPercentage, ::GetTickCount()))
+    {
+        ExitFunction();
+    }
+
     args.cbSize = sizeof(args);
     args.wzPackageId = wzPackageId;
     args.dwProgressPercentage = dwProgressPercentage;
@@ -2447,7 +2636,12 @@ EXTERN_C BAAPI UserExperienceOnProgress(
 
     results.cbSize = sizeof(results);
 
-    hr = SendBAMessage(pUserExperience, BOOTSTRAPPER_APPLICATION_MESSAGE_ONPROGRESS, &args, &results);
+    // A coalesced update still goes through the filter so failures on the other apply thread are noticed.
+    if (UserExperienceShouldSendProgress(pUserExperience, &pUserExperience->overallProgress, NULL, NULL, dwOverallPercentage, 100 <= dwOverallPercentage || (fRollback && 0 == dwOverallPercentage), ::GetTickCount()))
+    {
+        hr = SendBAMessage(pUserExperience, BOOTSTRAPPER_APPLICATION_MESSAGE_ONPROGRESS, &args, &results);
+    }
+
     hr = FilterExecuteResult(pUserExperience, hr, fRollback, results.fCancel, L"OnProgress");
 
     return hr;
@@ -2954,12 +3148,15 @@ static HRESULT SendBAMessage(
     )
 {
     HRESULT hr = S_OK;
+    BOOL fSerialized = FALSE;
 
     if (!pUserExperience->hUXModule)
     {
         ExitFunction();
     }
 
+    fSerialized = EnterParallelExecute(pUserExperience);
+
     hr = pUserExperience->pfnBAProc(message, pvArgs, pvResults, pUserExperience->pvBAProcContext);
     if (hr == E_NOTIMPL)
     {
@@ -2967,9 +3164,38 @@ static HRESULT SendBAMessage(
     }
 
 LExit:
+    LeaveParallelExecute(pUserExperience, fSerialized);
+
     return hr;
 }
 
+// Packages in a parallel group report to the BA from their own threads, so their messages take turns.
+// Returns whether the critical section was entered so a change of the flag in between stays balanced.
+static BOOL EnterParallelExecute(
+    __in BURN_USER_EXPERIENCE* pUserExperience
+    )
+{
+    BOOL fEntered = pUserExperience->fParallelExecute;
+
+    if (fEntered)
+    {
+        ::EnterCriticalSection(&pUserExperience->csParallelExecute);
+    }
+
+    return fEntered;
+}
+
+static void LeaveParallelExecute(
+    __in BURN_USER_EXPERIENCE* pUserExperience,
+    __in BOOL fEntered
+    )
+{
+    if (fEntered)
+    {
+        ::LeaveCriticalSection(&pUserExperience->csParallelExecute);
+    }
+}
+
 static HRESULT SendBAMessageFromInactiveEngine(
     __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BOOTSTRAPPER_APPLICATION_MESSAGE message,
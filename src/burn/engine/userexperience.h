@@ -11,13 +11,25 @@ extern "C" {
 // constants
 
 const DWORD BURN_MB_RETRYTRYAGAIN = 0x10;
+const DWORD BURN_PROGRESS_HEARTBEAT_INTERVAL = 1000;
 
 
 // structs
 
+typedef struct _BURN_USER_EXPERIENCE_PROGRESS_THROTTLE
+{
+    BOOL fDelivered;                    // Set once the first update for the current apply has been sent.
+    LPCWSTR wzLastId;                   // Ids are only compared by pointer; a new pointer always delivers.
+    LPCWSTR wzLastSubId;
+    DWORD dwLastTick;
+    DWORD dwLastPercentage;
+    DWORD cSuppressed;
+} BURN_USER_EXPERIENCE_PROGRESS_THROTTLE;
+
 typedef struct _BURN_USER_EXPERIENCE
 {
     BURN_PAYLOADS payloads;
+    BURN_PAYLOAD_EXTRACTION extraction;    // UX payloads keep extracting in the background after CoreInitialize.
 
     HMODULE hUXModule;
     PFN_BOOTSTRAPPER_APPLICATION_PROC pfnBAProc;
@@ -36,6 +48,10 @@ typedef struct _BURN_USER_EXPERIENCE
     HRESULT hrApplyError;               // Tracks is an error occurs during apply that requires the cache or
                                         // execute threads to bail.
 
+    CRITICAL_SECTION csParallelExecute; // While packages execute in parallel, every message to the BA and the
+    BOOL fParallelExecute;              // progress throttles are serialized through this critical section.
+                                        // The flag is only changed by the execute thread.
+
     HWND hwndApply;                     // The window handle provided at the beginning of Apply(). Only valid
                                         // during apply.
 
@@ -43,6 +59,18 @@ typedef struct _BURN_USER_EXPERIENCE
                                         // during Detect.
 
     DWORD dwExitCode;                   // Exit code returned by the user experience for the engine overall.
+
+    DWORD dwProgressInterval;           // Minimum milliseconds between progress updates, from the bundle's
+                                        // ProgressUpdatesPerSecond. Zero disables the time throttle.
+    DWORD dwProgressPercentageStep;     // Minimum percentage change between progress updates. Zero disables
+                                        // the percentage throttle.
+
+    BURN_USER_EXPERIENCE_PROGRESS_THROTTLE cacheAcquireProgress;    // Only used from the cache thread.
+    BURN_USER_EXPERIENCE_PROGRESS_THROTTLE executeProgress;         // Only used from the execute thread or inside csParallelExecute.
+                                                                    // MSI progress may arrive on the dutil MSI message forwarder
+                                                                    // thread, which only runs while the execute thread waits in
+                                                                    // Windows Installer, so the two never use it at the same time.
+    BURN_USER_EXPERIENCE_PROGRESS_THROTTLE overallProgress;         // Only used inside the apply critical section.
 } BURN_USER_EXPERIENCE;
 
 // functions
@@ -54,6 +82,10 @@ HRESULT UserExperienceParseFromXml(
 void UserExperienceUninitialize(
     __in BURN_USER_EXPERIENCE* pUserExperience
     );
+HRESULT UserExperiencePrepare(
+    __in BURN_USER_EXPERIENCE* pUserExperience,
+    __in BOOTSTRAPPER_COMMAND* pCommand
+    );
 HRESULT UserExperienceLoad(
     __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BOOTSTRAPPER_ENGINE_CONTEXT* pEngineContext,
@@ -100,6 +132,15 @@ void UserExperienceExecutePhaseComplete(
     __in BURN_USER_EXPERIENCE* pUserExperience,
     __in HRESULT hrResult
     );
+BOOL UserExperienceShouldSendProgress(
+    __in BURN_USER_EXPERIENCE* pUserExperience,
+    __in BURN_USER_EXPERIENCE_PROGRESS_THROTTLE* pThrottle,
+    __in_z_opt LPCWSTR wzId,
+    __in_z_opt LPCWSTR wzSubId,
+    __in DWORD dwPercentage,
+    __in BOOL fFinal,
+    __in DWORD dwTick
+    );
 BAAPI UserExperienceOnApplyBegin(
     __in BURN_USER_EXPERIENCE* pUserExperience,
     __in DWORD dwPhaseCount
@@ -14,10 +14,18 @@ typedef const struct _BUILT_IN_VARIABLE_DECLARATION
     BOOL fOverridable;
 } BUILT_IN_VARIABLE_DECLARATION;
 
+typedef struct _VARIABLE_READER
+{
+    BURN_VARIABLES* pVariables;
+    BURN_VARIABLES_SNAPSHOT* pSnapshot; // values are read from here when available.
+    BOOL fLocked; // csAccess is held, either because there was no snapshot or a built-in variable needed initialization.
+} VARIABLE_READER;
+
 
 // constants
 
 const DWORD GROW_VARIABLE_ARRAY = 3;
+const DWORD READS_BEFORE_VARIABLE_SNAPSHOT = 8;
 
 enum OS_INFO_VARIABLE
 {
@@ -50,7 +58,7 @@ enum SET_VARIABLE
 // internal function declarations
 
 static HRESULT FormatString(
-    __in BURN_VARIABLES* pVariables,
+    __in VARIABLE_READER* pReader,
     __in_z LPCWSTR wzIn,
     __out_z_opt LPWSTR* psczOut,
     __out_opt SIZE_T* pcchOut,
@@ -58,11 +66,16 @@ static HRESULT FormatString(
     __out BOOL* pfContainsHiddenVariable
     );
 static HRESULT GetFormatted(
-    __in BURN_VARIABLES* pVariables,
+    __in VARIABLE_READER* pReader,
     __in_z LPCWSTR wzVariable,
     __out_z LPWSTR* psczValue,
     __out BOOL* pfContainsHiddenVariable
     );
+static HRESULT IsHidden(
+    __in VARIABLE_READER* pReader,
+    __in_z LPCWSTR wzVariable,
+    __out BOOL* pfHidden
+    );
 static HRESULT AddBuiltInVariable(
     __in BURN_VARIABLES* pVariables,
     __in LPCWSTR wzVariable,
@@ -77,10 +90,39 @@ static HRESULT GetVariable(
     __out BURN_VARIABLE** ppVariable
     );
 static HRESULT FindVariableIndexByName(
-    __in BURN_VARIABLES* pVariables,
+    __in_ecount(cVariables) BURN_VARIABLE* rgVariables,
+    __in DWORD cVariables,
     __in_z LPCWSTR wzVariable,
     __out DWORD* piVariable
     );
+static void BeginRead(
+    __in BURN_VARIABLES* pVariables,
+    __out VARIABLE_READER* pReader
+    );
+static void EndRead(
+    __in VARIABLE_READER* pReader
+    );
+static HRESULT ReadVariable(
+    __in VARIABLE_READER* pReader,
+    __in_z LPCWSTR wzVariable,
+    __out BURN_VARIABLE** ppVariable
+    );
+static BURN_VARIABLES_SNAPSHOT* AcquireSnapshot(
+    __in BURN_VARIABLES* pVariables
+    );
+static HRESULT CreateSnapshot(
+    __in BURN_VARIABLES* pVariables,
+    __out BURN_VARIABLES_SNAPSHOT** ppSnapshot
+    );
+static void ReleaseSnapshot(
+    __in BURN_VARIABLES_SNAPSHOT* pSnapshot
+    );
+static void FreeSnapshot(
+    __in BURN_VARIABLES_SNAPSHOT* pSnapshot
+    );
+static void InvalidateSnapshot(
+    __in BURN_VARIABLES* pVariables
+    );
 static HRESULT InsertVariable(
     __in BURN_VARIABLES* pVariables,
     __in_z LPCWSTR wzVariable,
@@ -93,6 +135,11 @@ static HRESULT SetVariableValue(
     __in SET_VARIABLE setBuiltin,
     __in BOOL fLog
     );
+static HRESULT SerializeVariable(
+    __in BURN_VARIABLE* pVariable,
+    __inout BYTE** ppbBuffer,
+    __inout SIZE_T* piBuffer
+    );
 static HRESULT InitializeVariableVersionNT(
     __in DWORD_PTR dwpData,
     __inout BURN_VARIANT* pValue
@@ -203,6 +250,7 @@ extern "C" HRESULT VariableInitialize(
     HRESULT hr = S_OK;
 
     ::InitializeCriticalSection(&pVariables->csAccess);
+    ::InitializeSRWLock(&pVariables->srwSnapshot);
 
     const BUILT_IN_VARIABLE_DECLARATION vrgBuiltInVariables[] = {
         {L"AdminToolsFolder", InitializeVariableCsidlFolder, CSIDL_ADMINTOOLS},
@@ -438,7 +486,7 @@ extern "C" HRESULT VariablesParseFromXml(
         }
 
         // find existing variable
-        hr = FindVariableIndexByName(pVariables, sczId, &iVariable);
+        hr = FindVariableIndexByName(pVariables->rgVariables, pVariables->cVariables, sczId, &iVariable);
         ExitOnFailure(hr, "Failed to find variable value '%ls'.", sczId);
 
         // insert element if not found
@@ -452,6 +500,8 @@ extern "C" HRESULT VariablesParseFromXml(
             hr = E_INVALIDARG;
             ExitOnRootFailure(hr, "Attempt to set built-in variable value: %ls", sczId);
         }
+        InvalidateSnapshot(pVariables);
+
         pVariables->rgVariables[iVariable].fHidden = fHidden;
         pVariables->rgVariables[iVariable].fPersisted = fPersisted;
 
@@ -459,6 +509,8 @@ extern "C" HRESULT VariablesParseFromXml(
         hr = BVariantSetValue(&pVariables->rgVariables[iVariable].Value, &value);
         ExitOnFailure(hr, "Failed to set value of variable: %ls", sczId);
 
+        pVariables->rgVariables[iVariable].qwChangeCount = ++pVariables->qwChangeCount;
+
         // prepare next iteration
         ReleaseNullObject(pixnNode);
         BVariantUninitialize(&value);
@@ -482,6 +534,8 @@ extern "C" void VariablesUninitialize(
     __in BURN_VARIABLES* pVariables
     )
 {
+    InvalidateSnapshot(pVariables);
+
     ::DeleteCriticalSection(&pVariables->csAccess);
 
     if (pVariables->rgVariables)
@@ -547,10 +601,11 @@ extern "C" HRESULT VariableGetNumeric(
 {
     HRESULT hr = S_OK;
     BURN_VARIABLE* pVariable = NULL;
+    VARIABLE_READER reader = { };
 
-    ::EnterCriticalSection(&pVariables->csAccess);
+    BeginRead(pVariables, &reader);
 
-    hr = GetVariable(pVariables, wzVariable, &pVariable);
+    hr = ReadVariable(&reader, wzVariable, &pVariable);
     if (SUCCEEDED(hr) && BURN_VARIANT_TYPE_NONE == pVariable->Value.Type)
     {
         ExitFunction1(hr = E_NOTFOUND);
@@ -565,7 +620,7 @@ extern "C" HRESULT VariableGetNumeric(
     ExitOnFailure(hr, "Failed to get value as numeric for variable: %ls", wzVariable);
 
 LExit:
-    ::LeaveCriticalSection(&pVariables->csAccess);
+    EndRead(&reader);
 
     return hr;
 }
@@ -578,10 +633,11 @@ extern "C" HRESULT VariableGetString(
 {
     HRESULT hr = S_OK;
     BURN_VARIABLE* pVariable = NULL;
+    VARIABLE_READER reader = { };
 
-    ::EnterCriticalSection(&pVariables->csAccess);
+    BeginRead(pVariables, &reader);
 
-    hr = GetVariable(pVariables, wzVariable, &pVariable);
+    hr = ReadVariable(&reader, wzVariable, &pVariable);
     if (SUCCEEDED(hr) && BURN_VARIANT_TYPE_NONE == pVariable->Value.Type)
     {
         ExitFunction1(hr = E_NOTFOUND);
@@ -596,7 +652,46 @@ extern "C" HRESULT VariableGetString(
     ExitOnFailure(hr, "Failed to get value as string for variable: %ls", wzVariable);
 
 LExit:
-    ::LeaveCriticalSection(&pVariables->csAccess);
+    EndRead(&reader);
+
+    return hr;
+}
+
+extern "C" HRESULT VariableGetStrings(
+    __in BURN_VARIABLES* pVariables,
+    __in DWORD cVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+    __out_ecount(cVariables) LPWSTR* rgsczValues,
+    __out_ecount(cVariables) HRESULT* rghrValues
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_VARIABLE* pVariable = NULL;
+    VARIABLE_READER reader = { };
+
+    // Read once so the values are consistent with each other.
+    BeginRead(pVariables, &reader);
+
+    for (DWORD i = 0; i < cVariables; ++i)
+    {
+        hr = ReadVariable(&reader, rgwzVariables[i], &pVariable);
+        if (E_NOTFOUND == hr || (SUCCEEDED(hr) && BURN_VARIANT_TYPE_NONE == pVariable->Value.Type))
+        {
+            rghrValues[i] = E_NOTFOUND;
+            continue;
+        }
+        ExitOnFailure(hr, "Failed to get value of variable: %ls", rgwzVariables[i]);
+
+        hr = BVariantGetString(&pVariable->Value, rgsczValues + i);
+        ExitOnFailure(hr, "Failed to get value as string for variable: %ls", rgwzVariables[i]);
+
+        rghrValues[i] = S_OK;
+    }
+
+    hr = S_OK;
+
+LExit:
+    EndRead(&reader);
 
     return hr;
 }
@@ -609,10 +704,11 @@ extern "C" HRESULT VariableGetVersion(
 {
     HRESULT hr = S_OK;
     BURN_VARIABLE* pVariable = NULL;
+    VARIABLE_READER reader = { };
 
-    ::EnterCriticalSection(&pVariables->csAccess);
+    BeginRead(pVariables, &reader);
 
-    hr = GetVariable(pVariables, wzVariable, &pVariable);
+    hr = ReadVariable(&reader, wzVariable, &pVariable);
     if (SUCCEEDED(hr) && BURN_VARIANT_TYPE_NONE == pVariable->Value.Type)
     {
         ExitFunction1(hr = E_NOTFOUND);
@@ -627,7 +723,7 @@ extern "C" HRESULT VariableGetVersion(
     ExitOnFailure(hr, "Failed to get value as version for variable: %ls", wzVariable);
 
 LExit:
-    ::LeaveCriticalSection(&pVariables->csAccess);
+    EndRead(&reader);
 
     return hr;
 }
@@ -640,10 +736,11 @@ extern "C" HRESULT VariableGetVariant(
 {
     HRESULT hr = S_OK;
     BURN_VARIABLE* pVariable = NULL;
+    VARIABLE_READER reader = { };
 
-    ::EnterCriticalSection(&pVariables->csAccess);
+    BeginRead(pVariables, &reader);
 
-    hr = GetVariable(pVariables, wzVariable, &pVariable);
+    hr = ReadVariable(&reader, wzVariable, &pVariable);
     if (E_NOTFOUND == hr)
     {
         ExitFunction();
@@ -654,7 +751,7 @@ extern "C" HRESULT VariableGetVariant(
     ExitOnFailure(hr, "Failed to copy value of variable: %ls", wzVariable);
 
 LExit:
-    ::LeaveCriticalSection(&pVariables->csAccess);
+    EndRead(&reader);
 
     return hr;
 }
@@ -667,13 +764,18 @@ extern "C" HRESULT VariableGetFormatted(
     )
 {
     HRESULT hr = S_OK;
+    VARIABLE_READER reader = { };
 
     if (pfContainsHiddenVariable)
     {
         *pfContainsHiddenVariable = FALSE;
     }
 
-    hr = GetFormatted(pVariables, wzVariable, psczValue, pfContainsHiddenVariable);
+    BeginRead(pVariables, &reader);
+
+    hr = GetFormatted(&reader, wzVariable, psczValue, pfContainsHiddenVariable);
+
+    EndRead(&reader);
 
     return hr;
 }
@@ -709,6 +811,30 @@ extern "C" HRESULT VariableSetString(
     return SetVariableValue(pVariables, wzVariable, &variant, fOverwriteBuiltIn ? SET_VARIABLE_OVERRIDE_BUILTIN : SET_VARIABLE_NOT_BUILTIN, TRUE);
 }
 
+extern "C" HRESULT VariableSetStrings(
+    __in BURN_VARIABLES* pVariables,
+    __in DWORD cVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzValues,
+    __in BOOL fFormatted
+    )
+{
+    HRESULT hr = S_OK;
+
+    ::EnterCriticalSection(&pVariables->csAccess);
+
+    for (DWORD i = 0; i < cVariables; ++i)
+    {
+        hr = VariableSetString(pVariables, rgwzVariables[i], rgwzValues[i], FALSE, fFormatted);
+        ExitOnFailure(hr, "Failed to set value of variable: %ls", rgwzVariables[i]);
+    }
+
+LExit:
+    ::LeaveCriticalSection(&pVariables->csAccess);
+
+    return hr;
+}
+
 extern "C" HRESULT VariableSetVersion(
     __in BURN_VARIABLES* pVariables,
     __in_z LPCWSTR wzVariable,
@@ -740,7 +866,16 @@ extern "C" HRESULT VariableFormatString(
     __out_opt SIZE_T* pcchOut
     )
 {
-    return FormatString(pVariables, wzIn, psczOut, pcchOut, FALSE, NULL);
+    HRESULT hr = S_OK;
+    VARIABLE_READER reader = { };
+
+    BeginRead(pVariables, &reader);
+
+    hr = FormatString(&reader, wzIn, psczOut, pcchOut, FALSE, NULL);
+
+    EndRead(&reader);
+
+    return hr;
 }
 
 extern "C" HRESULT VariableFormatStringObfuscated(
@@ -750,7 +885,16 @@ extern "C" HRESULT VariableFormatStringObfuscated(
     __out_opt SIZE_T* pcchOut
     )
 {
-    return FormatString(pVariables, wzIn, psczOut, pcchOut, TRUE, NULL);
+    HRESULT hr = S_OK;
+    VARIABLE_READER reader = { };
+
+    BeginRead(pVariables, &reader);
+
+    hr = FormatString(&reader, wzIn, psczOut, pcchOut, TRUE, NULL);
+
+    EndRead(&reader);
+
+    return hr;
 }
 
 extern "C" HRESULT VariableEscapeString(
@@ -817,8 +961,6 @@ extern "C" HRESULT VariableSerialize(
 {
     HRESULT hr = S_OK;
     BOOL fIncluded = FALSE;
-    LONGLONG ll = 0;
-    LPWSTR scz = NULL;
 
     ::EnterCriticalSection(&pVariables->csAccess);
 
@@ -845,49 +987,65 @@ extern "C" HRESULT VariableSerialize(
             continue;
         }
 
-        // Write variable name.
-        hr = BuffWriteString(ppbBuffer, piBuffer, pVariable->sczName);
-        ExitOnFailure(hr, "Failed to write variable name.");
+        hr = SerializeVariable(pVariable, ppbBuffer, piBuffer);
+        ExitOnFailure(hr, "Failed to write variable: %ls", pVariable->sczName);
+    }
 
-        // Write variable value type.
-        hr = BuffWriteNumber(ppbBuffer, piBuffer, (DWORD)pVariable->Value.Type);
-        ExitOnFailure(hr, "Failed to write variable value type.");
+LExit:
+    ::LeaveCriticalSection(&pVariables->csAccess);
 
-        // Write variable value.
-        switch (pVariable->Value.Type)
-        {
-        case BURN_VARIANT_TYPE_NONE:
-            break;
-        case BURN_VARIANT_TYPE_NUMERIC:
-            hr = BVariantGetNumeric(&pVariable->Value, &ll);
-            ExitOnFailure(hr, "Failed to get numeric.");
+    return hr;
+}
 
-            hr = BuffWriteNumber64(ppbBuffer, piBuffer, static_cast<DWORD64>(ll));
-            ExitOnFailure(hr, "Failed to write variable value as number.");
+extern "C" HRESULT VariableSerializeChanges(
+    __in BURN_VARIABLES* pVariables,
+    __in DWORD64 qwSinceChangeCount,
+    __inout BYTE** ppbBuffer,
+    __inout SIZE_T* piBuffer,
+    __out DWORD64* pqwChangeCount
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cChanged = 0;
 
-            SecureZeroMemory(&ll, sizeof(ll));
-            break;
-        case BURN_VARIANT_TYPE_VERSION: __fallthrough;
-        case BURN_VARIANT_TYPE_FORMATTED: __fallthrough;
-        case BURN_VARIANT_TYPE_STRING:
-            hr = BVariantGetString(&pVariable->Value, &scz);
-            ExitOnFailure(hr, "Failed to get string.");
+    ::EnterCriticalSection(&pVariables->csAccess);
 
-            hr = BuffWriteString(ppbBuffer, piBuffer, scz);
-            ExitOnFailure(hr, "Failed to write variable value as string.");
+    for (DWORD i = 0; i < pVariables->cVariables; ++i)
+    {
+        BURN_VARIABLE* pVariable = &pVariables->rgVariables[i];
 
-            ReleaseNullStrSecure(scz);
-            break;
-        default:
-            hr = E_INVALIDARG;
-            ExitOnFailure(hr, "Unsupported variable type.");
+        if (BURN_VARIABLE_INTERNAL_TYPE_BUILTIN != pVariable->internalType && qwSinceChangeCount < pVariable->qwChangeCount)
+        {
+            ++cChanged;
         }
     }
 
+    // Write changed variable count. Unchanged variables are left out entirely so
+    // the buffer can be read by VariableDeserialize like any other.
+    hr = BuffWriteNumber(ppbBuffer, piBuffer, cChanged);
+    ExitOnFailure(hr, "Failed to write variable count.");
+
+    for (DWORD i = 0; i < pVariables->cVariables; ++i)
+    {
+        BURN_VARIABLE* pVariable = &pVariables->rgVariables[i];
+
+        if (BURN_VARIABLE_INTERNAL_TYPE_BUILTIN == pVariable->internalType || qwSinceChangeCount >= pVariable->qwChangeCount)
+        {
+            continue;
+        }
+
+        // Write included flag.
+        hr = BuffWriteNumber(ppbBuffer, piBuffer, (DWORD)TRUE);
+        ExitOnFailure(hr, "Failed to write included flag.");
+
+        hr = SerializeVariable(pVariable, ppbBuffer, piBuffer);
+        ExitOnFailure(hr, "Failed to write variable: %ls", pVariable->sczName);
+    }
+
+    *pqwChangeCount = pVariables->qwChangeCount;
+
 LExit:
     ::LeaveCriticalSection(&pVariables->csAccess);
-    SecureZeroMemory(&ll, sizeof(ll));
-    StrSecureZeroFreeString(scz);
 
     return hr;
 }
@@ -1089,24 +1247,13 @@ extern "C" HRESULT VariableIsHidden(
     )
 {
     HRESULT hr = S_OK;
-    BURN_VARIABLE* pVariable = NULL;
-
-    ::EnterCriticalSection(&pVariables->csAccess);
-
-    hr = GetVariable(pVariables, wzVariable, &pVariable);
-    if (E_NOTFOUND == hr)
-    {
-        // A missing variable does not need its data hidden.
-        *pfHidden = FALSE;
+    VARIABLE_READER reader = { };
 
-        ExitFunction1(hr = S_OK);
-    }
-    ExitOnFailure(hr, "Failed to get visibility of variable: %ls", wzVariable);
+    BeginRead(pVariables, &reader);
 
-    *pfHidden = pVariable->fHidden;
+    hr = IsHidden(&reader, wzVariable, pfHidden);
 
-LExit:
-    ::LeaveCriticalSection(&pVariables->csAccess);
+    EndRead(&reader);
 
     return hr;
 }
@@ -1115,7 +1262,7 @@ LExit:
 // internal function definitions
 
 static HRESULT FormatString(
-    __in BURN_VARIABLES* pVariables,
+    __in VARIABLE_READER* pReader,
     __in_z LPCWSTR wzIn,
     __out_z_opt LPWSTR* psczOut,
     __out_opt SIZE_T* pcchOut,
@@ -1138,8 +1285,6 @@ static HRESULT FormatString(
     BOOL fHidden = FALSE;
     MSIHANDLE hRecord = NULL;
 
-    ::EnterCriticalSection(&pVariables->csAccess);
-
     // allocate buffer for format string
     hr = ::StringCchLengthW(wzIn, STRSAFE_MAX_LENGTH, &cchIn);
     ExitOnFailure(hr, "Failed to length of format string.");
@@ -1212,7 +1357,7 @@ static HRESULT FormatString(
             }
             else
             {
-                hr = VariableIsHidden(pVariables, scz, &fHidden);
+                hr = IsHidden(pReader, scz, &fHidden);
                 ExitOnFailure(hr, "Failed to determine variable visibility: '%ls'.", scz);
 
                 if (pfContainsHiddenVariable)
@@ -1227,7 +1372,7 @@ static HRESULT FormatString(
                 else
                 {
                     // get formatted variable value
-                    hr = GetFormatted(pVariables, scz, &rgVariables[cVariables], pfContainsHiddenVariable);
+                    hr = GetFormatted(pReader, scz, &rgVariables[cVariables], pfContainsHiddenVariable);
                     if (E_NOTFOUND == hr) // variable not found
                     {
                         hr = StrAllocStringSecure(&rgVariables[cVariables], L"", 0);
@@ -1298,8 +1443,6 @@ static HRESULT FormatString(
     }
 
 LExit:
-    ::LeaveCriticalSection(&pVariables->csAccess);
-
     if (rgVariables)
     {
         for (DWORD i = 0; i < cVariables; ++i)
@@ -1338,7 +1481,7 @@ LExit:
 }
 
 static HRESULT GetFormatted(
-    __in BURN_VARIABLES* pVariables,
+    __in VARIABLE_READER* pReader,
     __in_z LPCWSTR wzVariable,
     __out_z LPWSTR* psczValue,
     __out BOOL* pfContainsHiddenVariable
@@ -1348,9 +1491,7 @@ static HRESULT GetFormatted(
     BURN_VARIABLE* pVariable = NULL;
     LPWSTR scz = NULL;
 
-    ::EnterCriticalSection(&pVariables->csAccess);
-
-    hr = GetVariable(pVariables, wzVariable, &pVariable);
+    hr = ReadVariable(pReader, wzVariable, &pVariable);
     if (SUCCEEDED(hr) && BURN_VARIANT_TYPE_NONE == pVariable->Value.Type)
     {
         ExitFunction1(hr = E_NOTFOUND);
@@ -1371,7 +1512,7 @@ static HRESULT GetFormatted(
         hr = BVariantGetString(&pVariable->Value, &scz);
         ExitOnFailure(hr, "Failed to get unformatted string.");
 
-        hr = FormatString(pVariables, scz, psczValue, NULL, FALSE, pfContainsHiddenVariable);
+        hr = FormatString(pReader, scz, psczValue, NULL, FALSE, pfContainsHiddenVariable);
         ExitOnFailure(hr, "Failed to format value '%ls' of variable: %ls", pVariable->fHidden ? L"*****" : pVariable->Value.sczValue, wzVariable);
     }
     else
@@ -1381,12 +1522,36 @@ static HRESULT GetFormatted(
     }
 
 LExit:
-    ::LeaveCriticalSection(&pVariables->csAccess);
     StrSecureZeroFreeString(scz);
 
     return hr;
 }
 
+static HRESULT IsHidden(
+    __in VARIABLE_READER* pReader,
+    __in_z LPCWSTR wzVariable,
+    __out BOOL* pfHidden
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_VARIABLE* pVariable = NULL;
+
+    hr = ReadVariable(pReader, wzVariable, &pVariable);
+    if (E_NOTFOUND == hr)
+    {
+        // A missing variable does not need its data hidden.
+        *pfHidden = FALSE;
+
+        ExitFunction1(hr = S_OK);
+    }
+    ExitOnFailure(hr, "Failed to get visibility of variable: %ls", wzVariable);
+
+    *pfHidden = pVariable->fHidden;
+
+LExit:
+    return hr;
+}
+
 static HRESULT AddBuiltInVariable(
     __in BURN_VARIABLES* pVariables,
     __in LPCWSTR wzVariable,
@@ -1400,7 +1565,7 @@ static HRESULT AddBuiltInVariable(
     DWORD iVariable = 0;
     BURN_VARIABLE* pVariable = NULL;
 
-    hr = FindVariableIndexByName(pVariables, wzVariable, &iVariable);
+    hr = FindVariableIndexByName(pVariables->rgVariables, pVariables->cVariables, wzVariable, &iVariable);
     ExitOnFailure(hr, "Failed to find variable value.");
 
     // insert element if not found
@@ -1431,7 +1596,7 @@ static HRESULT GetVariable(
     DWORD iVariable = 0;
     BURN_VARIABLE* pVariable = NULL;
 
-    hr = FindVariableIndexByName(pVariables, wzVariable, &iVariable);
+    hr = FindVariableIndexByName(pVariables->rgVariables, pVariables->cVariables, wzVariable, &iVariable);
     ExitOnFailure(hr, "Failed to find variable value '%ls'.", wzVariable);
 
     if (S_FALSE == hr)
@@ -1446,6 +1611,14 @@ static HRESULT GetVariable(
     {
         hr = pVariable->pfnInitialize(pVariable->dwpInitializeData, &pVariable->Value);
         ExitOnFailure(hr, "Failed to initialize built-in variable value '%ls'.", wzVariable);
+
+        pVariable->qwChangeCount = ++pVariables->qwChangeCount;
+
+        // The snapshot already matches a built-in variable that is still unset.
+        if (BURN_VARIANT_TYPE_NONE != pVariable->Value.Type)
+        {
+            InvalidateSnapshot(pVariables);
+        }
     }
 
     *ppVariable = pVariable;
@@ -1455,20 +1628,21 @@ LExit:
 }
 
 static HRESULT FindVariableIndexByName(
-    __in BURN_VARIABLES* pVariables,
+    __in_ecount(cVariables) BURN_VARIABLE* rgVariables,
+    __in DWORD cVariables,
     __in_z LPCWSTR wzVariable,
     __out DWORD* piVariable
     )
 {
     HRESULT hr = S_OK;
     DWORD iRangeFirst = 0;
-    DWORD cRangeLength = pVariables->cVariables;
+    DWORD cRangeLength = cVariables;
 
     while (cRangeLength)
     {
         // get variable in middle of range
         DWORD iPosition = cRangeLength / 2;
-        BURN_VARIABLE* pVariable = &pVariables->rgVariables[iRangeFirst + iPosition];
+        BURN_VARIABLE* pVariable = &rgVariables[iRangeFirst + iPosition];
 
         switch (::CompareStringW(LOCALE_INVARIANT, SORT_STRINGSORT, wzVariable, -1, pVariable->sczName, -1))
         {
@@ -1497,6 +1671,238 @@ LExit:
     return hr;
 }
 
+static void BeginRead(
+    __in BURN_VARIABLES* pVariables,
+    __out VARIABLE_READER* pReader
+    )
+{
+    pReader->pVariables = pVariables;
+    pReader->pSnapshot = AcquireSnapshot(pVariables);
+    pReader->fLocked = FALSE;
+
+    // Without a snapshot, read the live variables under the lock.
+    if (!pReader->pSnapshot)
+    {
+        ::EnterCriticalSection(&pVariables->csAccess);
+        pReader->fLocked = TRUE;
+    }
+}
+
+static void EndRead(
+    __in VARIABLE_READER* pReader
+    )
+{
+    if (pReader->fLocked)
+    {
+        ::LeaveCriticalSection(&pReader->pVariables->csAccess);
+        pReader->fLocked = FALSE;
+    }
+
+    if (pReader->pSnapshot)
+    {
+        ReleaseSnapshot(pReader->pSnapshot);
+        pReader->pSnapshot = NULL;
+    }
+}
+
+static HRESULT ReadVariable(
+    __in VARIABLE_READER* pReader,
+    __in_z LPCWSTR wzVariable,
+    __out BURN_VARIABLE** ppVariable
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD iVariable = 0;
+    BURN_VARIABLE* pVariable = NULL;
+
+    if (pReader->pSnapshot)
+    {
+        hr = FindVariableIndexByName(pReader->pSnapshot->rgVariables, pReader->pSnapshot->cVariables, wzVariable, &iVariable);
+        ExitOnFailure(hr, "Failed to find variable value '%ls' in snapshot.", wzVariable);
+
+        if (S_FALSE == hr)
+        {
+            ExitFunction1(hr = E_NOTFOUND);
+        }
+
+        pVariable = &pReader->pSnapshot->rgVariables[iVariable];
+
+        if (BURN_VARIANT_TYPE_NONE != pVariable->Value.Type || BURN_VARIABLE_INTERNAL_TYPE_NORMAL == pVariable->internalType)
+        {
+            *ppVariable = pVariable;
+            ExitFunction();
+        }
+
+        // Built-in variables are initialized on first use, which only the live variables can do.
+        if (!pReader->fLocked)
+        {
+            ::EnterCriticalSection(&pReader->pVariables->csAccess);
+            pReader->fLocked = TRUE;
+        }
+    }
+
+    hr = GetVariable(pReader->pVariables, wzVariable, ppVariable);
+
+LExit:
+    return hr;
+}
+
+static BURN_VARIABLES_SNAPSHOT* AcquireSnapshot(
+    __in BURN_VARIABLES* pVariables
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_VARIABLES_SNAPSHOT* pSnapshot = NULL;
+
+    ::AcquireSRWLockShared(&pVariables->srwSnapshot);
+
+    pSnapshot = pVariables->pSnapshot;
+    if (pSnapshot)
+    {
+        ::InterlockedIncrement(&pSnapshot->cReferences);
+    }
+
+    ::ReleaseSRWLockShared(&pVariables->srwSnapshot);
+
+    if (!pSnapshot)
+    {
+        ::EnterCriticalSection(&pVariables->csAccess);
+
+        // The pointer only changes under csAccess, so another reader may have published a snapshot while this one waited.
+        pSnapshot = pVariables->pSnapshot;
+        if (pSnapshot)
+        {
+            ::InterlockedIncrement(&pSnapshot->cReferences);
+        }
+        else if (READS_BEFORE_VARIABLE_SNAPSHOT <= ++pVariables->cReadsSinceChange)
+        {
+            // Copying every variable only pays off once reads outnumber changes, so busy writers stay on the locked path.
+            hr = CreateSnapshot(pVariables, &pSnapshot);
+            if (FAILED(hr))
+            {
+                TraceError(hr, "Failed to create variable snapshot, reading under the lock instead.");
+                pVariables->cReadsSinceChange = 0;
+            }
+            else
+            {
+                pSnapshot->cReferences = 2; // one for the published pointer and one for the caller.
+
+                ::AcquireSRWLockExclusive(&pVariables->srwSnapshot);
+                pVariables->pSnapshot = pSnapshot;
+                ::ReleaseSRWLockExclusive(&pVariables->srwSnapshot);
+            }
+        }
+
+        ::LeaveCriticalSection(&pVariables->csAccess);
+    }
+
+    return pSnapshot;
+}
+
+static HRESULT CreateSnapshot(
+    __in BURN_VARIABLES* pVariables,
+    __out BURN_VARIABLES_SNAPSHOT** ppSnapshot
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_VARIABLES_SNAPSHOT* pSnapshot = NULL;
+
+    pSnapshot = (BURN_VARIABLES_SNAPSHOT*)MemAlloc(sizeof(BURN_VARIABLES_SNAPSHOT), TRUE);
+    ExitOnNull(pSnapshot, hr, E_OUTOFMEMORY, "Failed to allocate variable snapshot.");
+
+    if (pVariables->cVariables)
+    {
+        pSnapshot->rgVariables = (BURN_VARIABLE*)MemAlloc(sizeof(BURN_VARIABLE) * pVariables->cVariables, TRUE);
+        ExitOnNull(pSnapshot->rgVariables, hr, E_OUTOFMEMORY, "Failed to allocate variable snapshot array.");
+    }
+
+    for (DWORD i = 0; i < pVariables->cVariables; ++i)
+    {
+        BURN_VARIABLE* pVariable = &pVariables->rgVariables[i];
+        BURN_VARIABLE* pCopy = &pSnapshot->rgVariables[i];
+
+        ++pSnapshot->cVariables;
+
+        hr = StrAllocString(&pCopy->sczName, pVariable->sczName, 0);
+        ExitOnFailure(hr, "Failed to copy variable name: %ls", pVariable->sczName);
+
+        // Hidden values are copied too, and the copies are securely freed with the snapshot.
+        hr = BVariantCopy(&pVariable->Value, &pCopy->Value);
+        ExitOnFailure(hr, "Failed to copy value of variable: %ls", pVariable->sczName);
+
+        pCopy->fHidden = pVariable->fHidden;
+        pCopy->fPersisted = pVariable->fPersisted;
+        pCopy->qwChangeCount = pVariable->qwChangeCount;
+        pCopy->internalType = pVariable->internalType;
+    }
+
+    *ppSnapshot = pSnapshot;
+    pSnapshot = NULL;
+
+LExit:
+    if (pSnapshot)
+    {
+        FreeSnapshot(pSnapshot);
+    }
+
+    return hr;
+}
+
+static void ReleaseSnapshot(
+    __in BURN_VARIABLES_SNAPSHOT* pSnapshot
+    )
+{
+    if (0 == ::InterlockedDecrement(&pSnapshot->cReferences))
+    {
+        FreeSnapshot(pSnapshot);
+    }
+}
+
+static void FreeSnapshot(
+    __in BURN_VARIABLES_SNAPSHOT* pSnapshot
+    )
+{
+    if (pSnapshot->rgVariables)
+    {
+        for (DWORD i = 0; i < pSnapshot->cVariables; ++i)
+        {
+            BURN_VARIABLE* pVariable = &pSnapshot->rgVariables[i];
+
+            ReleaseStr(pVariable->sczName);
+
+            if (BURN_VARIANT_TYPE_VERSION == pVariable->Value.Type)
+            {
+                ReleaseVerutilVersion(pVariable->Value.pValue);
+            }
+
+            BVariantUninitialize(&pVariable->Value);
+        }
+        MemFree(pSnapshot->rgVariables);
+    }
+
+    MemFree(pSnapshot);
+}
+
+static void InvalidateSnapshot(
+    __in BURN_VARIABLES* pVariables
+    )
+{
+    BURN_VARIABLES_SNAPSHOT* pSnapshot = NULL;
+
+    ::AcquireSRWLockExclusive(&pVariables->srwSnapshot);
+    pSnapshot = pVariables->pSnapshot;
+    pVariables->pSnapshot = NULL;
+    ::ReleaseSRWLockExclusive(&pVariables->srwSnapshot);
+
+    pVariables->cReadsSinceChange = 0;
+
+    // Readers still holding the old snapshot keep it alive until they finish.
+    if (pSnapshot)
+    {
+        ReleaseSnapshot(pSnapshot);
+    }
+}
+
 static HRESULT InsertVariable(
     __in BURN_VARIABLES* pVariables,
     __in_z LPCWSTR wzVariable,
@@ -1567,7 +1973,7 @@ static HRESULT SetVariableValue(
 
     ::EnterCriticalSection(&pVariables->csAccess);
 
-    hr = FindVariableIndexByName(pVariables, wzVariable, &iVariable);
+    hr = FindVariableIndexByName(pVariables->rgVariables, pVariables->cVariables, wzVariable, &iVariable);
     ExitOnFailure(hr, "Failed to find variable value '%ls'.", wzVariable);
 
     // Insert element if not found.
@@ -1656,10 +2062,15 @@ static HRESULT SetVariableValue(
         }
     }
 
+    // Readers holding the current snapshot keep their copy of the old value.
+    InvalidateSnapshot(pVariables);
+
     // Update variable value.
     hr = BVariantSetValue(&pVariables->rgVariables[iVariable].Value, pVariant);
     ExitOnFailure(hr, "Failed to set value of variable: %ls", wzVariable);
 
+    pVariables->rgVariables[iVariable].qwChangeCount = ++pVariables->qwChangeCount;
+
 LExit:
     ::LeaveCriticalSection(&pVariables->csAccess);
 
@@ -1671,6 +2082,61 @@ LExit:
     return hr;
 }
 
+static HRESULT SerializeVariable(
+    __in BURN_VARIABLE* pVariable,
+    __inout BYTE** ppbBuffer,
+    __inout SIZE_T* piBuffer
+    )
+{
+    HRESULT hr = S_OK;
+    LONGLONG ll = 0;
+    LPWSTR scz = NULL;
+
+    // Write variable name.
+    hr = BuffWriteString(ppbBuffer, piBuffer, pVariable->sczName);
+    ExitOnFailure(hr, "Failed to write variable name.");
+
+    // Write variable value type.
+    hr = BuffWriteNumber(ppbBuffer, piBuffer, (DWORD)pVariable->Value.Type);
+    ExitOnFailure(hr, "Failed to write variable value type.");
+
+    // Write variable value.
+    switch (pVariable->Value.Type)
+    {
+    case BURN_VARIANT_TYPE_NONE:
+        break;
+    case BURN_VARIANT_TYPE_NUMERIC:
+        hr = BVariantGetNumeric(&pVariable->Value, &ll);
+        ExitOnFailure(hr, "Failed to get numeric.");
+
+        hr = BuffWriteNumber64(ppbBuffer, piBuffer, static_cast<DWORD64>(ll));
+        ExitOnFailure(hr, "Failed to write variable value as number.");
+
+        SecureZeroMemory(&ll, sizeof(ll));
+        break;
+    case BURN_VARIANT_TYPE_VERSION: __fallthrough;
+    case BURN_VARIANT_TYPE_FORMATTED: __fallthrough;
+    case BURN_VARIANT_TYPE_STRING:
+        hr = BVariantGetString(&pVariable->Value, &scz);
+        ExitOnFailure(hr, "Failed to get string.");
+
+        hr = BuffWriteString(ppbBuffer, piBuffer, scz);
+        ExitOnFailure(hr, "Failed to write variable value as string.");
+
+        ReleaseNullStrSecure(scz);
+        break;
+    default:
+        hr = E_INVALIDARG;
+        ExitOnFailure(hr, "Unsupported variable type.");
+    }
+
+LExit:
+    SecureZeroMemory(&ll, sizeof(ll));
+    StrSecureZeroFreeString(scz);
+
+    return hr;
+}
+
 static HRESULT InitializeVariableVersionNT(
     __in DWORD_PTR dwpData,
     __inout BURN_VARIANT* pValue
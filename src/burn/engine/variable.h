@@ -47,6 +47,7 @@ typedef struct _BURN_VARIABLE
     BURN_VARIANT Value;
     BOOL fHidden;
     BOOL fPersisted;
+    DWORD64 qwChangeCount; // value of BURN_VARIABLES::qwChangeCount when this variable last changed.
 
     // used for late initialization of built-in variables
     BURN_VARIABLE_INTERNAL_TYPE internalType;
@@ -54,13 +55,27 @@ typedef struct _BURN_VARIABLE
     DWORD_PTR dwpInitializeData;
 } BURN_VARIABLE;
 
+// Immutable copy of the variables shared by concurrent readers; freed when the last reference is released.
+typedef struct _BURN_VARIABLES_SNAPSHOT
+{
+    LONG cReferences;
+    DWORD cVariables;
+    BURN_VARIABLE* rgVariables;
+} BURN_VARIABLES_SNAPSHOT;
+
 typedef struct _BURN_VARIABLES
 {
     CRITICAL_SECTION csAccess;
+    SRWLOCK srwSnapshot; // guards only the pSnapshot pointer, always acquired after csAccess.
+    BURN_VARIABLES_SNAPSHOT* pSnapshot; // published copy for readers, NULL after any change until rebuilt.
+    DWORD cReadsSinceChange; // locked reads since the last change, used to decide when to rebuild the snapshot.
     DWORD dwMaxVariables;
     DWORD cVariables;
     BURN_VARIABLE* rgVariables;
     BURN_VARIABLE_COMMAND_LINE_TYPE commandLineType;
+
+    DWORD64 qwChangeCount; // incremented each time any variable changes.
+    DWORD64 qwElevatedChangeCount; // change count last sent to the elevated process, zero until the first sync.
 } BURN_VARIABLES;
 
 
@@ -89,6 +104,13 @@ HRESULT VariableGetString(
     __in_z LPCWSTR wzVariable,
     __out_z LPWSTR* psczValue
     );
+HRESULT VariableGetStrings(
+    __in BURN_VARIABLES* pVariables,
+    __in DWORD cVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+    __out_ecount(cVariables) LPWSTR* rgsczValues,
+    __out_ecount(cVariables) HRESULT* rghrValues
+    );
 HRESULT VariableGetVersion(
     __in BURN_VARIABLES* pVariables,
     __in_z LPCWSTR wzVariable,
@@ -118,6 +140,13 @@ HRESULT VariableSetString(
     __in BOOL fOverwriteBuiltIn,
     __in BOOL fFormatted
     );
+HRESULT VariableSetStrings(
+    __in BURN_VARIABLES* pVariables,
+    __in DWORD cVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzVariables,
+    __in_ecount(cVariables) const LPCWSTR* rgwzValues,
+    __in BOOL fFormatted
+    );
 HRESULT VariableSetVersion(
     __in BURN_VARIABLES* pVariables,
     __in_z LPCWSTR wzVariable,
@@ -151,6 +180,13 @@ HRESULT VariableSerialize(
     __inout BYTE** ppbBuffer,
     __inout SIZE_T* piBuffer
     );
+HRESULT VariableSerializeChanges(
+    __in BURN_VARIABLES* pVariables,
+    __in DWORD64 qwSinceChangeCount,
+    __inout BYTE** ppbBuffer,
+    __inout SIZE_T* piBuffer,
+    __out DWORD64* pqwChangeCount
+    );
 HRESULT VariableDeserialize(
     __in BURN_VARIABLES* pVariables,
     __in BOOL fWasPersisted,
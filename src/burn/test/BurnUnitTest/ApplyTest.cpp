@@ -0,0 +1,389 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+typedef struct _APPLY_TEST_EVENT
+{
+    BOOTSTRAPPER_APPLICATION_MESSAGE message;
+    LPCWSTR wzPackageId;
+    BOOL fExecute;
+} APPLY_TEST_EVENT;
+
+const DWORD APPLY_TEST_OVERLAP_TIMEOUT = 5000;
+
+static HRESULT WINAPI ApplyTestBAProc(
+    __in BOOTSTRAPPER_APPLICATION_MESSAGE message,
+    __in const LPVOID pvArgs,
+    __inout LPVOID pvResults,
+    __in_opt LPVOID pvContext
+    );
+static BOOL STDAPICALLTYPE ApplyTest_CreateProcessW(
+    __in_opt LPCWSTR lpApplicationName,
+    __inout_opt LPWSTR lpCommandLine,
+    __in_opt LPSECURITY_ATTRIBUTES lpProcessAttributes,
+    __in_opt LPSECURITY_ATTRIBUTES lpThreadAttributes,
+    __in BOOL bInheritHandles,
+    __in DWORD dwCreationFlags,
+    __in_opt LPVOID lpEnvironment,
+    __in_opt LPCWSTR lpCurrentDirectory,
+    __in LPSTARTUPINFOW lpStartupInfo,
+    __out LPPROCESS_INFORMATION lpProcessInformation
+    );
+static DWORD CALLBACK ApplyTest_ProcessThreadProc(
+    __in LPVOID lpThreadParameter
+    );
+
+static APPLY_TEST_EVENT vrgEvents[32] = { };
+static DWORD vcEvents = 0;
+static LONG vcActiveCallbacks = 0;
+static BOOL vfOverlappingCallbacks = FALSE;
+static HANDLE vhProcessesOverlapped = NULL;
+static LONG vcRunningProcesses = 0;
+static BOOL vfOverlappingProcesses = FALSE;
+
+namespace Microsoft
+{
+namespace Tools
+{
+namespace WindowsInstallerXml
+{
+namespace Test
+{
+namespace Bootstrapper
+{
+    using namespace System;
+    using namespace Xunit;
+
+    public ref class ApplyTest : BurnUnitTest
+    {
+    public:
+        ApplyTest(BurnTestFixture^ fixture) : BurnUnitTest(fixture)
+        {
+        }
+
+        [Fact]
+        void ParallelGroupOverlapsPerUserExePackagesTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_ENGINE_STATE engineState = { };
+            BURN_APPLY_CONTEXT applyContext = { };
+            BURN_ROLLBACK_BOUNDARY rollbackBoundary = { };
+            BURN_PACKAGE rgPackages[2] = { };
+            BURN_PAYLOAD rgPayloads[2] = { };
+            BURN_PAYLOAD_GROUP_ITEM rgPayloadItems[2] = { };
+            BURN_EXECUTE_ACTION rgExecuteActions[5] = { };
+            BURN_EXECUTE_ACTION rgRollbackActions[5] = { };
+            BOOL fSuspend = FALSE;
+            BOOTSTRAPPER_APPLY_RESTART restart = BOOTSTRAPPER_APPLY_RESTART_NONE;
+            DWORD dwIndex = 0;
+
+            InitializeParallelPlan(&engineState, &rollbackBoundary, rgPackages, rgPayloads, rgPayloadItems, rgExecuteActions, rgRollbackActions, FALSE);
+            InitializeEngineStateForApply(&engineState, &applyContext);
+
+            try
+            {
+                hr = ApplyExecute(&engineState, &applyContext, &fSuspend, &restart);
+                NativeAssert::Succeeded(hr, "ApplyExecute failed.");
+
+                // Each package's process only exits early once the other one is running too.
+                Assert::Equal<BOOL>(TRUE, vfOverlappingProcesses);
+
+                Assert::Equal<BOOL>(FALSE, fSuspend);
+                Assert::Equal<BOOL>(FALSE, vfOverlappingCallbacks);
+                Assert::Equal<BOOL>(FALSE, engineState.userExperience.fParallelExecute);
+
+                // The BA still sees begin and complete callbacks in plan order.
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGEBEGIN, L"PackageA", TRUE);
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGEBEGIN, L"PackageB", TRUE);
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGECOMPLETE, L"PackageA", TRUE);
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGECOMPLETE, L"PackageB", TRUE);
+                Assert::Equal(dwIndex, vcEvents);
+            }
+            finally
+            {
+                UninitializeEngineStateForApply(&engineState, &applyContext);
+            }
+        }
+
+        [Fact]
+        void ParallelGroupFailureRollsBackWholeGroupTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_ENGINE_STATE engineState = { };
+            BURN_APPLY_CONTEXT applyContext = { };
+            BURN_ROLLBACK_BOUNDARY rollbackBoundary = { };
+            BURN_PACKAGE rgPackages[2] = { };
+            BURN_PAYLOAD rgPayloads[2] = { };
+            BURN_PAYLOAD_GROUP_ITEM rgPayloadItems[2] = { };
+            BURN_EXECUTE_ACTION rgExecuteActions[5] = { };
+            BURN_EXECUTE_ACTION rgRollbackActions[5] = { };
+            BOOL fSuspend = FALSE;
+            BOOTSTRAPPER_APPLY_RESTART restart = BOOTSTRAPPER_APPLY_RESTART_NONE;
+            DWORD dwIndex = 0;
+
+            // The vital first package fails after the second package started, so rollback
+            // starts from the group's last checkpoint and covers both packages.
+            InitializeParallelPlan(&engineState, &rollbackBoundary, rgPackages, rgPayloads, rgPayloadItems, rgExecuteActions, rgRollbackActions, TRUE);
+            InitializeEngineStateForApply(&engineState, &applyContext);
+
+            try
+            {
+                hr = ApplyExecute(&engineState, &applyContext, &fSuspend, &restart);
+                Assert::True(FAILED(hr), "ApplyExecute should have failed.");
+
+                Assert::Equal<BOOL>(TRUE, vfOverlappingProcesses);
+                Assert::Equal<BOOL>(FALSE, vfOverlappingCallbacks);
+                Assert::Equal<BOOL>(FALSE, engineState.userExperience.fParallelExecute);
+
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGEBEGIN, L"PackageA", TRUE);
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGEBEGIN, L"PackageB", TRUE);
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGECOMPLETE, L"PackageA", TRUE);
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGECOMPLETE, L"PackageB", TRUE);
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGEBEGIN, L"PackageB", FALSE);
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGECOMPLETE, L"PackageB", FALSE);
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGEBEGIN, L"PackageA", FALSE);
+                ValidateEvent(dwIndex++, BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGECOMPLETE, L"PackageA", FALSE);
+                Assert::Equal(dwIndex, vcEvents);
+            }
+            finally
+            {
+                UninitializeEngineStateForApply(&engineState, &applyContext);
+            }
+        }
+
+    private:
+        // Builds one parallel group of two per-user EXE packages separated by checkpoints:
+        //   execute:  checkpoint 1, PackageA, checkpoint 2, PackageB, checkpoint 3
+        //   rollback: PackageA, checkpoint 1, PackageB, checkpoint 2, checkpoint 3
+        // The packages' processes are faked by threads, and PackageA's install fails when fFail is set.
+        void InitializeParallelPlan(
+            __in BURN_ENGINE_STATE* pEngineState,
+            __in BURN_ROLLBACK_BOUNDARY* pRollbackBoundary,
+            __in BURN_PACKAGE* rgPackages,
+            __in BURN_PAYLOAD* rgPayloads,
+            __in BURN_PAYLOAD_GROUP_ITEM* rgPayloadItems,
+            __in BURN_EXECUTE_ACTION* rgExecuteActions,
+            __in BURN_EXECUTE_ACTION* rgRollbackActions,
+            __in BOOL fFail
+            )
+        {
+            pRollbackBoundary->fVital = TRUE;
+
+            for (DWORD i = 0; i < 2; ++i)
+            {
+                rgPayloads[i].sczFilePath = const_cast<LPWSTR>(L"C:\\ignored\\target.exe");
+                rgPayloadItems[i].pPayload = rgPayloads + i;
+
+                rgPackages[i].sczId = const_cast<LPWSTR>(0 == i ? L"PackageA" : L"PackageB");
+                rgPackages[i].type = BURN_PACKAGE_TYPE_EXE;
+                rgPackages[i].fVital = TRUE;
+                rgPackages[i].fParallel = TRUE;
+                rgPackages[i].payloads.rgItems = rgPayloadItems + i;
+                rgPackages[i].payloads.cItems = 1;
+                rgPackages[i].Exe.fPseudoPackage = TRUE;
+                rgPackages[i].Exe.sczInstallArguments = const_cast<LPWSTR>(fFail && 0 == i ? L"fail" : L"");
+            }
+
+            for (DWORD i = 0; i < 5; ++i)
+            {
+                BURN_EXECUTE_ACTION* pExecuteAction = rgExecuteActions + i;
+                BURN_EXECUTE_ACTION* pRollbackAction = rgRollbackActions + i;
+
+                if (0 == i % 2)
+                {
+                    pExecuteAction->type = BURN_EXECUTE_ACTION_TYPE_CHECKPOINT;
+                    pExecuteAction->checkpoint.dwId = i / 2 + 1;
+                    pExecuteAction->checkpoint.pActiveRollbackBoundary = pRollbackBoundary;
+                }
+                else
+                {
+                    pExecuteAction->type = BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE;
+                    pExecuteAction->exePackage.pPackage = rgPackages + i / 2;
+                    pExecuteAction->exePackage.action = BOOTSTRAPPER_ACTION_STATE_INSTALL;
+                }
+
+                if (4 == i || 1 == i % 2)
+                {
+                    pRollbackAction->type = BURN_EXECUTE_ACTION_TYPE_CHECKPOINT;
+                    pRollbackAction->checkpoint.dwId = 4 == i ? 3 : (i + 1) / 2;
+                    pRollbackAction->checkpoint.pActiveRollbackBoundary = pRollbackBoundary;
+                }
+                else
+                {
+                    pRollbackAction->type = BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE;
+                    pRollbackAction->exePackage.pPackage = rgPackages + i / 2;
+                    pRollbackAction->exePackage.action = BOOTSTRAPPER_ACTION_STATE_UNINSTALL;
+                }
+            }
+
+            pEngineState->plan.rgExecuteActions = rgExecuteActions;
+            pEngineState->plan.cExecuteActions = 5;
+            pEngineState->plan.rgRollbackActions = rgRollbackActions;
+            pEngineState->plan.cRollbackActions = 5;
+            pEngineState->plan.cExecutePackagesTotal = 2;
+            pEngineState->plan.cOverallProgressTicksTotal = 2;
+
+            PlanParallelExecuteActions(&pEngineState->plan);
+            Assert::Equal(1ul, pEngineState->plan.cParallelGroups);
+        }
+
+        // This doesn't initialize everything, just enough for ApplyExecute to run per-user packages.
+        void InitializeEngineStateForApply(BURN_ENGINE_STATE* pEngineState, BURN_APPLY_CONTEXT* pApplyContext)
+        {
+            HRESULT hr = S_OK;
+
+            memset(vrgEvents, 0, sizeof(vrgEvents));
+            vcEvents = 0;
+            vcActiveCallbacks = 0;
+            vfOverlappingCallbacks = FALSE;
+            vcRunningProcesses = 0;
+            vfOverlappingProcesses = FALSE;
+
+            vhProcessesOverlapped = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+            Assert::True(NULL != vhProcessesOverlapped);
+
+            CoreFunctionOverride(ApplyTest_CreateProcessW, ThrdWaitForCompletion);
+
+            ::InitializeCriticalSection(&pEngineState->userExperience.csEngineActive);
+            ::InitializeCriticalSection(&pEngineState->userExperience.csParallelExecute);
+            ::InitializeCriticalSection(&pApplyContext->csApply);
+            DetectSnapshotInitialize(&pEngineState->detectSnapshot);
+
+            hr = VariableInitialize(&pEngineState->variables);
+            NativeAssert::Succeeded(hr, "Failed to initialize variables.");
+
+            pEngineState->companionConnection.hPipe = NULL;
+            pEngineState->userExperience.hUXModule = reinterpret_cast<HMODULE>(1);
+            pEngineState->userExperience.pfnBAProc = ApplyTestBAProc;
+        }
+
+        void UninitializeEngineStateForApply(BURN_ENGINE_STATE* pEngineState, BURN_APPLY_CONTEXT* pApplyContext)
+        {
+            CoreFunctionOverride(::CreateProcessW, ProcWaitForCompletion);
+            ReleaseHandle(vhProcessesOverlapped);
+
+            VariablesUninitialize(&pEngineState->variables);
+            DetectSnapshotUninitialize(&pEngineState->detectSnapshot);
+            ::DeleteCriticalSection(&pApplyContext->csApply);
+            ::DeleteCriticalSection(&pEngineState->userExperience.csParallelExecute);
+            ::DeleteCriticalSection(&pEngineState->userExperience.csEngineActive);
+        }
+
+        void ValidateEvent(
+            __in DWORD dwIndex,
+            __in BOOTSTRAPPER_APPLICATION_MESSAGE message,
+            __in_z LPCWSTR wzPackageId,
+            __in BOOL fExecute
+            )
+        {
+            Assert::True(dwIndex < vcEvents, "Missing BA event.");
+
+            APPLY_TEST_EVENT* pEvent = vrgEvents + dwIndex;
+            Assert::Equal<DWORD>(message, pEvent->message);
+            NativeAssert::StringEqual(wzPackageId, pEvent->wzPackageId);
+            Assert::Equal<BOOL>(fExecute, pEvent->fExecute);
+        }
+    };
+}
+}
+}
+}
+}
+
+static HRESULT WINAPI ApplyTestBAProc(
+    __in BOOTSTRAPPER_APPLICATION_MESSAGE message,
+    __in const LPVOID pvArgs,
+    __inout LPVOID /*pvResults*/,
+    __in_opt LPVOID /*pvContext*/
+    )
+{
+    APPLY_TEST_EVENT* pEvent = NULL;
+    BOOL fRecord = FALSE;
+
+    // The engine serializes messages from a parallel group, so two callbacks must never overlap.
+    if (1 < ::InterlockedIncrement(&vcActiveCallbacks))
+    {
+        vfOverlappingCallbacks = TRUE;
+    }
+
+    switch (message)
+    {
+    case BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGEBEGIN:
+    case BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGECOMPLETE:
+        fRecord = vcEvents < countof(vrgEvents);
+        break;
+    }
+
+    if (fRecord)
+    {
+        pEvent = vrgEvents + vcEvents;
+        pEvent->message = message;
+
+        if (BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPACKAGEBEGIN == message)
+        {
+            BA_ONEXECUTEPACKAGEBEGIN_ARGS* pArgs = reinterpret_cast<BA_ONEXECUTEPACKAGEBEGIN_ARGS*>(pvArgs);
+            pEvent->wzPackageId = pArgs->wzPackageId;
+            pEvent->fExecute = pArgs->fExecute;
+        }
+        else
+        {
+            BA_ONEXECUTEPACKAGECOMPLETE_ARGS* pArgs = reinterpret_cast<BA_ONEXECUTEPACKAGECOMPLETE_ARGS*>(pvArgs);
+            pEvent->wzPackageId = pArgs->wzPackageId;
+            pEvent->fExecute = 0 < vcEvents && vrgEvents[vcEvents - 1].fExecute;
+        }
+
+        ++vcEvents;
+    }
+
+    // Give another thread the chance to overlap this callback if the engine let it.
+    ::Sleep(1);
+
+    ::InterlockedDecrement(&vcActiveCallbacks);
+
+    return S_OK;
+}
+
+static BOOL STDAPICALLTYPE ApplyTest_CreateProcessW(
+    __in_opt LPCWSTR /*lpApplicationName*/,
+    __inout_opt LPWSTR lpCommandLine,
+    __in_opt LPSECURITY_ATTRIBUTES /*lpProcessAttributes*/,
+    __in_opt LPSECURITY_ATTRIBUTES /*lpThreadAttributes*/,
+    __in BOOL /*bInheritHandles*/,
+    __in DWORD /*dwCreationFlags*/,
+    __in_opt LPVOID /*lpEnvironment*/,
+    __in_opt LPCWSTR /*lpCurrentDirectory*/,
+    __in LPSTARTUPINFOW /*lpStartupInfo*/,
+    __out LPPROCESS_INFORMATION lpProcessInformation
+    )
+{
+    DWORD dwExitCode = wcsstr(lpCommandLine, L" fail") ? ERROR_INSTALL_FAILURE : ERROR_SUCCESS;
+
+    // Pretend this thread is the package's process.
+    lpProcessInformation->hProcess = ::CreateThread(NULL, 0, ApplyTest_ProcessThreadProc, reinterpret_cast<LPVOID>(static_cast<DWORD_PTR>(dwExitCode)), 0, NULL);
+    lpProcessInformation->hThread = NULL;
+
+    return NULL != lpProcessInformation->hProcess;
+}
+
+static DWORD CALLBACK ApplyTest_ProcessThreadProc(
+    __in LPVOID lpThreadParameter
+    )
+{
+    DWORD dwExitCode = static_cast<DWORD>(reinterpret_cast<DWORD_PTR>(lpThreadParameter));
+
+    // The first process keeps running until another one starts, so it only exits early
+    // when the engine runs the packages at the same time.
+    if (1 < ::InterlockedIncrement(&vcRunningProcesses))
+    {
+        vfOverlappingProcesses = TRUE;
+        ::SetEvent(vhProcessesOverlapped);
+    }
+    else
+    {
+        ::WaitForSingleObject(vhProcessesOverlapped, APPLY_TEST_OVERLAP_TIMEOUT);
+    }
+
+    ::InterlockedDecrement(&vcRunningProcesses);
+
+    return dwExitCode;
+}
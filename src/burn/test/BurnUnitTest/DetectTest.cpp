@@ -0,0 +1,158 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+namespace Microsoft
+{
+namespace Tools
+{
+namespace WindowsInstallerXml
+{
+namespace Test
+{
+namespace Bootstrapper
+{
+    using namespace System;
+    using namespace System::IO;
+    using namespace Xunit;
+
+    public ref class DetectTest : BurnUnitTest
+    {
+    public:
+        DetectTest(BurnTestFixture^ fixture) : BurnUnitTest(fixture)
+        {
+        }
+
+        [Fact]
+        void DetectSnapshotRoundTripTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_DETECT_SNAPSHOT snapshot = { };
+            BURN_DETECT_SNAPSHOT loaded = { };
+            LPWSTR sczValue = NULL;
+            WCHAR wzProductCode[MAX_GUID_CHARS + 1] = { };
+            BOOL fElevated = FALSE;
+            String^ snapshotFile = Path::Combine(Path::GetTempPath(), Path::GetRandomFileName());
+
+            DetectSnapshotInitialize(&snapshot);
+            DetectSnapshotInitialize(&loaded);
+
+            try
+            {
+                snapshot.fRecording = TRUE;
+
+                hr = DetectSnapshotGetProductInfo(&snapshot, L"{7A2C3F4E-1B5D-4E6F-8A9B-0C1D2E3F4A5B}", MSIINSTALLCONTEXT_MACHINE, INSTALLPROPERTY_VERSIONSTRING, &sczValue);
+                NativeAssert::SpecificReturnCode(HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT), hr, "Expected unknown product.");
+
+                hr = DetectSnapshotEnumRelatedProducts(&snapshot, L"{0E1D2C3B-4A59-4867-9F8E-7D6C5B4A3F2E}", 0, wzProductCode);
+                NativeAssert::SpecificReturnCode(E_NOMOREITEMS, hr, "Expected no related products.");
+                Assert::Equal<DWORD>(2, snapshot.cEntries);
+
+                pin_ptr<const wchar_t> wzSnapshotFile = PtrToStringChars(snapshotFile);
+                hr = DetectSnapshotSave(&snapshot, wzSnapshotFile);
+                NativeAssert::Succeeded(hr, "Failed to save detect snapshot.");
+
+                // An elevated bundle only accepts a snapshot written by an elevated process.
+                hr = ProcElevated(::GetCurrentProcess(), &fElevated);
+                NativeAssert::Succeeded(hr, "Failed to check whether the test is elevated.");
+
+                hr = DetectSnapshotLoad(&loaded, wzSnapshotFile, TRUE);
+                if (fElevated)
+                {
+                    NativeAssert::Succeeded(hr, "Failed to load detect snapshot written elevated.");
+                }
+                else
+                {
+                    NativeAssert::SpecificReturnCode(E_ACCESSDENIED, hr, "Expected snapshot written without elevation to be rejected.");
+                    Assert::Equal<DWORD>(0, loaded.cEntries);
+                }
+
+                hr = DetectSnapshotLoad(&loaded, wzSnapshotFile, FALSE);
+                NativeAssert::Succeeded(hr, "Failed to load detect snapshot.");
+                Assert::Equal<DWORD>(2, loaded.cEntries);
+
+                // Answers come from the snapshot, so nothing new is recorded.
+                loaded.fRecording = TRUE;
+
+                hr = DetectSnapshotGetProductInfo(&loaded, L"{7a2c3f4e-1b5d-4e6f-8a9b-0c1d2e3f4a5b}", MSIINSTALLCONTEXT_MACHINE, INSTALLPROPERTY_VERSIONSTRING, &sczValue);
+                NativeAssert::SpecificReturnCode(HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT), hr, "Expected unknown product from snapshot.");
+
+                hr = DetectSnapshotEnumRelatedProducts(&loaded, L"{0E1D2C3B-4A59-4867-9F8E-7D6C5B4A3F2E}", 0, wzProductCode);
+                NativeAssert::SpecificReturnCode(E_NOMOREITEMS, hr, "Expected no related products from snapshot.");
+                Assert::Equal<DWORD>(2, loaded.cEntries);
+            }
+            finally
+            {
+                ReleaseStr(sczValue);
+                DetectSnapshotUninitialize(&loaded);
+                DetectSnapshotUninitialize(&snapshot);
+
+                if (File::Exists(snapshotFile))
+                {
+                    File::Delete(snapshotFile);
+                }
+            }
+        }
+
+        [Fact]
+        void DetectSnapshotOnlyPassedBeforeExecuteTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_DETECT_SNAPSHOT snapshot = { };
+            BURN_DETECT_SNAPSHOT loaded = { };
+            LPWSTR sczValue = NULL;
+            LPWSTR sczChildSnapshotFile = NULL;
+            String^ workingFolder = Path::Combine(Path::GetTempPath(), Path::GetRandomFileName());
+            String^ futureFile = Path::Combine(workingFolder, "future.snapshot");
+
+            DetectSnapshotInitialize(&snapshot);
+            DetectSnapshotInitialize(&loaded);
+
+            try
+            {
+                Directory::CreateDirectory(workingFolder);
+                pin_ptr<const wchar_t> wzWorkingFolder = PtrToStringChars(workingFolder);
+
+                snapshot.fRecording = TRUE;
+
+                hr = DetectSnapshotGetProductInfo(&snapshot, L"{7A2C3F4E-1B5D-4E6F-8A9B-0C1D2E3F4A5B}", MSIINSTALLCONTEXT_USERUNMANAGED, INSTALLPROPERTY_VERSIONSTRING, &sczValue);
+                NativeAssert::SpecificReturnCode(HRESULT_FROM_WIN32(ERROR_UNKNOWN_PRODUCT), hr, "Expected unknown product.");
+
+                snapshot.fRecording = FALSE;
+
+                hr = DetectSnapshotBeginExecute(&snapshot, wzWorkingFolder, &sczChildSnapshotFile);
+                NativeAssert::Succeeded(hr, "Failed to begin first execute.");
+                Assert::True(NULL != sczChildSnapshotFile);
+                Assert::True(File::Exists(gcnew String(sczChildSnapshotFile)));
+
+                hr = DetectSnapshotBeginExecute(&snapshot, wzWorkingFolder, &sczChildSnapshotFile);
+                NativeAssert::Succeeded(hr, "Failed to begin second execute.");
+                Assert::True(NULL == sczChildSnapshotFile);
+
+                // Snapshots from a newer engine are ignored.
+                File::WriteAllBytes(futureFile, gcnew array<Byte>{ 2, 0, 0, 0 });
+
+                pin_ptr<const wchar_t> wzFutureFile = PtrToStringChars(futureFile);
+                hr = DetectSnapshotLoad(&loaded, wzFutureFile, FALSE);
+                NativeAssert::SpecificReturnCode(E_INVALIDDATA, hr, "Expected unsupported snapshot version to be rejected.");
+                Assert::Equal<DWORD>(0, loaded.cEntries);
+            }
+            finally
+            {
+                ReleaseStr(sczChildSnapshotFile);
+                ReleaseStr(sczValue);
+                DetectSnapshotUninitialize(&loaded);
+                DetectSnapshotUninitialize(&snapshot);
+
+                if (Directory::Exists(workingFolder))
+                {
+                    Directory::Delete(workingFolder, true);
+                }
+            }
+        }
+    };
+}
+}
+}
+}
+}
@@ -730,6 +730,47 @@ namespace Bootstrapper
             ValidateNonPermanentPackageExpectedStates(&pEngineState->packages.rgPackages[2], L"PackageB", BURN_PACKAGE_REGISTRATION_STATE_PRESENT, BURN_PACKAGE_REGISTRATION_STATE_PRESENT);
         }
 
+        [Fact]
+        void MultipleBundlePackageParallelInstallTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_ENGINE_STATE engineState = { };
+            BURN_ENGINE_STATE* pEngineState = &engineState;
+            BURN_PLAN* pPlan = &engineState.plan;
+
+            InitializeEngineStateForCorePlan(wzMultipleBundlePackageManifestFileName, pEngineState);
+            DetectAttachedContainerAsAttached(pEngineState);
+            DetectPermanentPackagesAsPresentAndCached(pEngineState);
+
+            pEngineState->packages.rgPackages[1].fParallel = TRUE;
+            pEngineState->packages.rgPackages[2].fParallel = TRUE;
+
+            hr = CorePlan(pEngineState, BOOTSTRAPPER_ACTION_INSTALL);
+            NativeAssert::Succeeded(hr, "CorePlan failed");
+
+            Assert::Equal(1ul, pPlan->cParallelGroups);
+
+            // Everything between the rollback boundary start and end, including the checkpoints,
+            // cache waits and dependency registration of both packages, is one group.
+            BOOL fRollback = FALSE;
+            DWORD dwIndex = 0;
+            ValidateExecuteRollbackBoundaryStart(pPlan, fRollback, dwIndex, L"WixDefaultBoundary", TRUE, FALSE);
+            ValidateParallelGroup(pPlan, dwIndex++, 0);
+            for (; dwIndex < pPlan->cExecuteActions - 1; ++dwIndex)
+            {
+                ValidateParallelGroup(pPlan, dwIndex, 1);
+            }
+            ValidateExecuteRollbackBoundaryEnd(pPlan, fRollback, dwIndex);
+            ValidateParallelGroup(pPlan, dwIndex++, 0);
+            Assert::Equal(dwIndex, pPlan->cExecuteActions);
+
+            // Rollback always executes serially.
+            for (DWORD i = 0; i < pPlan->cRollbackActions; ++i)
+            {
+                Assert::Equal(0ul, pPlan->rgRollbackActions[i].dwParallelGroup);
+            }
+        }
+
         [Fact]
         void MultipleBundlePackageRepairTest()
         {
@@ -1028,6 +1069,104 @@ namespace Bootstrapper
             ValidateNonPermanentPackageExpectedStates(&pEngineState->packages.rgPackages[0], L"PackageA", BURN_PACKAGE_REGISTRATION_STATE_ABSENT, BURN_PACKAGE_REGISTRATION_STATE_ABSENT);
         }
 
+        [Fact]
+        void ParallelExecuteActionsEndAtSerialPackageTest()
+        {
+            BURN_PLAN plan = { };
+            BURN_PACKAGE rgPackages[7] = { };
+            BURN_EXECUTE_ACTION rgActions[13] = { };
+            DWORD dwIndex = 0;
+
+            rgPackages[0].fParallel = TRUE;
+            rgPackages[1].fParallel = TRUE;
+            rgPackages[2].fParallel = TRUE;
+            rgPackages[3].fParallel = TRUE;
+            rgPackages[4].fParallel = FALSE;
+            rgPackages[5].fParallel = TRUE;
+            rgPackages[6].fParallel = TRUE;
+
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_ROLLBACK_BOUNDARY_START, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_CHECKPOINT, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE, rgPackages + 0);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_CHECKPOINT, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_MSI_PACKAGE, rgPackages + 1);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE, rgPackages + 2);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_CHECKPOINT, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_MSU_PACKAGE, rgPackages + 3);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE, rgPackages + 4);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_BUNDLE_PACKAGE, rgPackages + 5);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE, rgPackages + 6);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_CHECKPOINT, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_ROLLBACK_BOUNDARY_END, NULL);
+            Assert::Equal<DWORD>(countof(rgActions), dwIndex);
+
+            plan.rgExecuteActions = rgActions;
+            plan.cExecuteActions = dwIndex;
+
+            PlanParallelExecuteActions(&plan);
+
+            Assert::Equal(2ul, plan.cParallelGroups);
+
+            dwIndex = 0;
+            ValidateParallelGroup(&plan, dwIndex++, 0);
+            ValidateParallelGroup(&plan, dwIndex++, 0); // a single package is not a group.
+            ValidateParallelGroup(&plan, dwIndex++, 0);
+            ValidateParallelGroup(&plan, dwIndex++, 0);
+            ValidateParallelGroup(&plan, dwIndex++, 0); // MSI packages end the run even when authored as parallel.
+            ValidateParallelGroup(&plan, dwIndex++, 1);
+            ValidateParallelGroup(&plan, dwIndex++, 1);
+            ValidateParallelGroup(&plan, dwIndex++, 1);
+            ValidateParallelGroup(&plan, dwIndex++, 0); // packages not authored as parallel end the run.
+            ValidateParallelGroup(&plan, dwIndex++, 2);
+            ValidateParallelGroup(&plan, dwIndex++, 2);
+            ValidateParallelGroup(&plan, dwIndex++, 2);
+            ValidateParallelGroup(&plan, dwIndex++, 0);
+            Assert::Equal(dwIndex, plan.cExecuteActions);
+        }
+
+        [Fact]
+        void ParallelExecuteActionsStayInsideRollbackBoundaryTest()
+        {
+            BURN_PLAN plan = { };
+            BURN_PACKAGE rgPackages[6] = { };
+            BURN_EXECUTE_ACTION rgActions[14] = { };
+            DWORD dwIndex = 0;
+
+            for (DWORD i = 0; i < countof(rgPackages); ++i)
+            {
+                rgPackages[i].fParallel = TRUE;
+            }
+
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_ROLLBACK_BOUNDARY_START, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE, rgPackages + 0);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_ROLLBACK_BOUNDARY_END, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_ROLLBACK_BOUNDARY_START, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE, rgPackages + 1);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_ROLLBACK_BOUNDARY_END, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_ROLLBACK_BOUNDARY_START, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_BEGIN_MSI_TRANSACTION, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_MSI_PACKAGE, rgPackages + 2);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_MSI_PACKAGE, rgPackages + 3);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_COMMIT_MSI_TRANSACTION, NULL);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE, rgPackages + 4);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE, rgPackages + 5);
+            InitializeParallelExecuteAction(rgActions + dwIndex++, BURN_EXECUTE_ACTION_TYPE_ROLLBACK_BOUNDARY_END, NULL);
+            Assert::Equal<DWORD>(countof(rgActions), dwIndex);
+
+            plan.rgExecuteActions = rgActions;
+            plan.cExecuteActions = dwIndex;
+
+            PlanParallelExecuteActions(&plan);
+
+            Assert::Equal(1ul, plan.cParallelGroups);
+
+            // Packages in different rollback boundaries or inside an MSI transaction never share a group.
+            for (dwIndex = 0; dwIndex < plan.cExecuteActions; ++dwIndex)
+            {
+                ValidateParallelGroup(&plan, dwIndex, 11 == dwIndex || 12 == dwIndex ? 1 : 0);
+            }
+        }
+
         [Fact]
         void RelatedBundlesAreSortedByPlanType()
         {
@@ -2866,6 +3005,27 @@ namespace Bootstrapper
             pEngineState->userExperience.pfnBAProc = PlanTestBAProc;
         }
 
+        void InitializeParallelExecuteAction(BURN_EXECUTE_ACTION* pAction, BURN_EXECUTE_ACTION_TYPE type, BURN_PACKAGE* pPackage)
+        {
+            pAction->type = type;
+
+            switch (type)
+            {
+            case BURN_EXECUTE_ACTION_TYPE_BUNDLE_PACKAGE:
+                pAction->bundlePackage.pPackage = pPackage;
+                break;
+            case BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE:
+                pAction->exePackage.pPackage = pPackage;
+                break;
+            case BURN_EXECUTE_ACTION_TYPE_MSI_PACKAGE:
+                pAction->msiPackage.pPackage = pPackage;
+                break;
+            case BURN_EXECUTE_ACTION_TYPE_MSU_PACKAGE:
+                pAction->msuPackage.pPackage = pPackage;
+                break;
+            }
+        }
+
         void PlanTestDetect(BURN_ENGINE_STATE* pEngineState)
         {
             DetectReset(&pEngineState->registration, &pEngineState->packages);
@@ -3551,6 +3711,17 @@ namespace Bootstrapper
             Assert::Equal<DWORD>(expectedInstallState, pPackage->expectedInstallRegistrationState);
         }
 
+        void ValidateParallelGroup(
+            __in BURN_PLAN* pPlan,
+            __in DWORD dwIndex,
+            __in DWORD dwParallelGroup
+            )
+        {
+            BURN_EXECUTE_ACTION* pAction = &pPlan->rgExecuteActions[dwIndex];
+            Assert::Equal<BOOL>(FALSE, pAction->fDeleted);
+            Assert::Equal(dwParallelGroup, pAction->dwParallelGroup);
+        }
+
         void ValidatePermanentPackageExpectedStates(
             __in BURN_PACKAGE* pPackage,
             __in_z LPCWSTR wzPackageId
@@ -132,6 +132,63 @@ namespace Bootstrapper
             }
         }
 
+        [Fact]
+        void RelatedBundleDetectAllScopesTest()
+        {
+            HRESULT hr = S_OK;
+            IXMLDOMElement* pixeBundle = NULL;
+            BURN_REGISTRATION registration = { };
+            BURN_RELATED_BUNDLES relatedBundles = { };
+            BURN_CACHE cache = { };
+            BURN_ENGINE_COMMAND internalCommand = { };
+
+            try
+            {
+                this->testRegistry->SetUp();
+                this->RegisterFakeBundles();
+
+                LPCWSTR wzDocument =
+                    L"<Bundle>"
+                    L"    <UX>"
+                    L"        <Payload Id='ux.dll' FilePath='ux.dll' Packaging='embedded' SourcePath='ux.dll' />"
+                    L"    </UX>"
+                    L"    <RelatedBundle Id='{89FDAE1F-8CC1-48B9-B930-3945E0D3E7F0}' Action='Upgrade' />"
+                    L"    <Registration Id='{D54F896D-1952-43E6-9C67-B5652240618C}' Tag='foo' ProviderKey='foo' Version='1.0.0.0' ExecutableName='setup.exe' PerMachine='yes'>"
+                    L"        <Arp Register='yes' Publisher='WiX Toolset' DisplayName='RegisterBasicTest' DisplayVersion='1.0.0.0' />"
+                    L"    </Registration>"
+                    L"</Bundle>";
+
+                // load XML document
+                LoadBundleXmlHelper(wzDocument, &pixeBundle);
+
+                hr = CacheInitialize(&cache, &internalCommand);
+                TestThrowOnFailure(hr, L"Failed initialize cache.");
+
+                hr = RegistrationParseFromXml(&registration, &cache, pixeBundle);
+                TestThrowOnFailure(hr, L"Failed to parse registration from XML.");
+
+                hr = RelatedBundlesInitialize(&registration, &relatedBundles);
+                TestThrowOnFailure(hr, L"Failed to initialize related bundles.");
+
+                // Per-machine bundles are loaded before per-user bundles even though the scopes are searched concurrently.
+                Assert::Equal(3lu, relatedBundles.cRelatedBundles);
+                NativeAssert::StringEqual(L"{AD75BE46-B5D7-4208-BC8B-918553C72D83}", relatedBundles.rgRelatedBundles[0].package.sczId);
+                Assert::True(relatedBundles.rgRelatedBundles[0].package.fPerMachine);
+                NativeAssert::StringEqual(L"{6DB5D48C-CD7D-40D2-BCBC-AF630E136761}", relatedBundles.rgRelatedBundles[1].package.sczId);
+                Assert::False(relatedBundles.rgRelatedBundles[1].package.fPerMachine);
+                NativeAssert::StringEqual(L"{3DB49D3D-1FB8-4147-A465-BBE8BFD0DAD0}", relatedBundles.rgRelatedBundles[2].package.sczId);
+                Assert::False(relatedBundles.rgRelatedBundles[2].package.fPerMachine);
+            }
+            finally
+            {
+                ReleaseObject(pixeBundle);
+                RelatedBundlesUninitialize(&relatedBundles);
+                RegistrationUninitialize(&registration);
+
+                this->testRegistry->TearDown();
+            }
+        }
+
         void RegisterFakeBundles()
         {
             this->RegisterFakeBundle(L"{D54F896D-1952-43E6-9C67-B5652240618C}", L"{89FDAE1F-8CC1-48B9-B930-3945E0D3E7F0}", NULL, L"1.0.0.0", TRUE);
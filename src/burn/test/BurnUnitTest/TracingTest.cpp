@@ -0,0 +1,135 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+namespace Microsoft
+{
+namespace Tools
+{
+namespace WindowsInstallerXml
+{
+namespace Test
+{
+namespace Bootstrapper
+{
+    using namespace System;
+    using namespace System::IO;
+    using namespace Xunit;
+
+    public ref class TracingTest : BurnUnitTest
+    {
+    public:
+        TracingTest(BurnTestFixture^ fixture) : BurnUnitTest(fixture)
+        {
+        }
+
+        [Fact]
+        void TracingDisabledRecordsNothingTest()
+        {
+            BURN_TRACE_SPAN span = { };
+
+            Assert::False(TracingIsEnabled());
+
+            TracingSpanBegin(&span, L"Disabled", L"Id", 0);
+            Assert::False(span.fActive);
+
+            TracingSpanEnd(&span, S_OK);
+            TracingUninitialize();
+        }
+
+        [Fact]
+        void TracingWritesChromeTraceEventsTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_TRACE_SPAN outerSpan = { };
+            BURN_TRACE_SPAN innerSpan = { };
+            String^ traceFile = Path::Combine(Path::GetTempPath(), Path::GetRandomFileName());
+
+            try
+            {
+                pin_ptr<const wchar_t> wzTraceFile = PtrToStringChars(traceFile);
+                hr = TracingInitialize(wzTraceFile);
+                NativeAssert::Succeeded(hr, "Failed to initialize tracing.");
+                Assert::True(TracingIsEnabled());
+
+                TracingSpanBegin(&outerSpan, L"CorePlan", NULL, 5);
+                TracingSpanBegin(&innerSpan, L"ExecuteExePackage", L"Exe\\Package", 1);
+                TracingSpanEnd(&innerSpan, E_FAIL);
+                TracingSpanEnd(&outerSpan, S_OK);
+
+                TracingUninitialize();
+                Assert::False(TracingIsEnabled());
+
+                String^ json = File::ReadAllText(traceFile);
+                Assert::StartsWith("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[{\"name\":\"ExecuteExePackage\",\"cat\":\"burn\",\"ph\":\"X\",", json);
+                Assert::Contains("\"args\":{\"id\":\"Exe\\\\Package\",\"data\":1,\"hr\":\"0x80004005\"}}", json);
+                Assert::Contains("{\"name\":\"CorePlan\",", json);
+                Assert::Contains("\"args\":{\"data\":5,\"hr\":\"0x00000000\"}}]}", json);
+            }
+            finally
+            {
+                TracingUninitialize();
+
+                if (File::Exists(traceFile))
+                {
+                    File::Delete(traceFile);
+                }
+            }
+        }
+
+        [Fact]
+        void TracingSwitchIsPassedToCleanRoomTest()
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczCommandLine = NULL;
+            BURN_ENGINE_COMMAND internalCommand = { };
+            BOOTSTRAPPER_COMMAND command = { };
+            BURN_PIPE_CONNECTION companionConnection = { };
+            BURN_PIPE_CONNECTION embeddedConnection = { };
+            HANDLE hSectionFile = INVALID_HANDLE_VALUE;
+            HANDLE hSourceEngineFile = INVALID_HANDLE_VALUE;
+
+            try
+            {
+                hr = StrAllocString(&sczCommandLine, L"/quiet", 0);
+                NativeAssert::Succeeded(hr, "Failed to allocate command line.");
+
+                // Without a trace file nothing is added.
+                hr = CoreAppendTraceToCommandLine(NULL, &sczCommandLine);
+                NativeAssert::Succeeded(hr, "Failed to append empty trace file.");
+                NativeAssert::StringEqual(L"/quiet", sczCommandLine);
+
+                hr = CoreAppendTraceToCommandLine(L"C:\\trace dir\\burn.json", &sczCommandLine);
+                NativeAssert::Succeeded(hr, "Failed to append trace file.");
+                NativeAssert::StringEqual(L"/quiet -burn.trace \"C:\\trace dir\\burn.json\"", sczCommandLine);
+
+                // The clean room process parses the same trace file back out.
+                hr = AppParseCommandLine(sczCommandLine, &internalCommand.argc, &internalCommand.argv);
+                NativeAssert::Succeeded(hr, "Failed to split command line.");
+
+                hr = CoreParseCommandLine(&internalCommand, &command, &companionConnection, &embeddedConnection, &hSectionFile, &hSourceEngineFile);
+                NativeAssert::Succeeded(hr, "Failed to parse command line.");
+
+                Assert::False(internalCommand.fInvalidCommandLine);
+                Assert::Equal<DWORD>(0, internalCommand.cUnknownArgs);
+                NativeAssert::StringEqual(L"C:\\trace dir\\burn.json", internalCommand.sczTraceFile);
+                Assert::Equal<DWORD>(BOOTSTRAPPER_DISPLAY_NONE, command.display);
+            }
+            finally
+            {
+                ReleaseStr(sczCommandLine);
+                ReleaseStr(internalCommand.sczTraceFile);
+                ReleaseMem(internalCommand.rgUnknownArgs);
+
+                if (internalCommand.argv)
+                {
+                    AppFreeCommandLineArgs(internalCommand.argv);
+                }
+            }
+        }
+    };
+}
+}
+}
+}
+}
@@ -0,0 +1,144 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+namespace Microsoft
+{
+namespace Tools
+{
+namespace WindowsInstallerXml
+{
+namespace Test
+{
+namespace Bootstrapper
+{
+    using namespace System;
+    using namespace Xunit;
+
+    public ref class UserExperienceTest : BurnUnitTest
+    {
+    public:
+        UserExperienceTest(BurnTestFixture^ fixture) : BurnUnitTest(fixture)
+        {
+        }
+
+        [Fact]
+        void UserExperienceProgressThrottleDisabledSendsEverythingTest()
+        {
+            BURN_USER_EXPERIENCE userExperience = { };
+            BURN_USER_EXPERIENCE_PROGRESS_THROTTLE throttle = { };
+            LPCWSTR wzPackageId = L"PackageA";
+
+            for (DWORD i = 0; i < 10; ++i)
+            {
+                Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, i, FALSE, 1000));
+            }
+
+            Assert::Equal<DWORD>(0, throttle.cSuppressed);
+        }
+
+        [Fact]
+        void UserExperienceProgressThrottleSuppressesWithinIntervalTest()
+        {
+            BURN_USER_EXPERIENCE userExperience = { };
+            BURN_USER_EXPERIENCE_PROGRESS_THROTTLE throttle = { };
+            LPCWSTR wzPackageId = L"PackageA";
+
+            userExperience.dwProgressInterval = 100;
+
+            // The first update is always sent.
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 1, FALSE, 1000));
+
+            // Updates inside the interval are coalesced.
+            Assert::False(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 2, FALSE, 1001));
+            Assert::False(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 3, FALSE, 1099));
+            Assert::Equal<DWORD>(2, throttle.cSuppressed);
+
+            // The interval is measured from the last update that was sent.
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 4, FALSE, 1100));
+            Assert::False(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 5, FALSE, 1150));
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 6, FALSE, 1200));
+            Assert::Equal<DWORD>(3, throttle.cSuppressed);
+        }
+
+        [Fact]
+        void UserExperienceProgressThrottleSendsHeartbeatTest()
+        {
+            BURN_USER_EXPERIENCE userExperience = { };
+            BURN_USER_EXPERIENCE_PROGRESS_THROTTLE throttle = { };
+            LPCWSTR wzPackageId = L"PackageA";
+
+            // Neither limit would let the same percentage through on its own.
+            userExperience.dwProgressInterval = 5000;
+            userExperience.dwProgressPercentageStep = 10;
+
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 50, FALSE, 1000));
+            Assert::False(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 50, FALSE, 1000 + BURN_PROGRESS_HEARTBEAT_INTERVAL - 1));
+
+            // After the heartbeat interval the BA gets an update so it can cancel.
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 50, FALSE, 1000 + BURN_PROGRESS_HEARTBEAT_INTERVAL));
+            Assert::False(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 50, FALSE, 1000 + BURN_PROGRESS_HEARTBEAT_INTERVAL + 1));
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 50, FALSE, 1000 + 2 * BURN_PROGRESS_HEARTBEAT_INTERVAL));
+
+            // The tick count wrapping around does not stall the heartbeat.
+            throttle.dwLastTick = 0xFFFFFF00;
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 50, FALSE, BURN_PROGRESS_HEARTBEAT_INTERVAL));
+        }
+
+        [Fact]
+        void UserExperienceProgressThrottleAlwaysSendsCompletionTest()
+        {
+            BURN_USER_EXPERIENCE userExperience = { };
+            BURN_USER_EXPERIENCE_PROGRESS_THROTTLE throttle = { };
+            LPCWSTR wzPackageId = L"PackageA";
+            DWORD dwPercentage = 0;
+
+            userExperience.dwProgressInterval = 500;
+            userExperience.dwProgressPercentageStep = 50;
+
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, 99, FALSE, 1000));
+
+            // Callers mark 100% as final, which is sent even right after another update.
+            dwPercentage = 100;
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, dwPercentage, 100 <= dwPercentage, 1001));
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &throttle, wzPackageId, NULL, dwPercentage, 100 <= dwPercentage, 1001));
+            Assert::Equal<DWORD>(0, throttle.cSuppressed);
+        }
+
+        [Fact]
+        void UserExperienceProgressThrottleKeepsStatePerIdTest()
+        {
+            BURN_USER_EXPERIENCE userExperience = { };
+            BURN_USER_EXPERIENCE_PROGRESS_THROTTLE cacheThrottle = { };
+            BURN_USER_EXPERIENCE_PROGRESS_THROTTLE executeThrottle = { };
+            LPCWSTR wzPackageA = L"PackageA";
+            LPCWSTR wzPackageB = L"PackageB";
+            LPCWSTR wzPayload1 = L"Payload1";
+            LPCWSTR wzPayload2 = L"Payload2";
+
+            userExperience.dwProgressInterval = 500;
+
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &cacheThrottle, wzPackageA, wzPayload1, 10, FALSE, 1000));
+            Assert::False(UserExperienceShouldSendProgress(&userExperience, &cacheThrottle, wzPackageA, wzPayload1, 20, FALSE, 1001));
+
+            // A different payload or package is always reported.
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &cacheThrottle, wzPackageA, wzPayload2, 0, FALSE, 1002));
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &cacheThrottle, wzPackageB, wzPayload2, 0, FALSE, 1003));
+            Assert::False(UserExperienceShouldSendProgress(&userExperience, &cacheThrottle, wzPackageB, wzPayload2, 5, FALSE, 1004));
+
+            // Another kind of progress keeps its own state.
+            Assert::True(UserExperienceShouldSendProgress(&userExperience, &executeThrottle, wzPackageB, NULL, 5, FALSE, 1005));
+            Assert::False(UserExperienceShouldSendProgress(&userExperience, &executeThrottle, wzPackageB, NULL, 6, FALSE, 1006));
+
+            Assert::Equal<DWORD>(2, cacheThrottle.cSuppressed);
+            Assert::Equal<DWORD>(1, executeThrottle.cSuppressed);
+            Assert::True(wzPackageB == cacheThrottle.wzLastId);
+            Assert::True(wzPayload2 == cacheThrottle.wzLastSubId);
+            Assert::Equal<DWORD>(1003, cacheThrottle.dwLastTick);
+        }
+    };
+}
+}
+}
+}
+}
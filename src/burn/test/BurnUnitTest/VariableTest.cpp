@@ -15,7 +15,9 @@ namespace Test
 namespace Bootstrapper
 {
     using namespace System;
+    using namespace System::Diagnostics;
     using namespace Xunit;
+    using namespace Xunit::Abstractions;
 
     public ref class VariableTest : BurnUnitTest
     {
@@ -448,6 +450,85 @@ namespace Bootstrapper
             }
         }
 
+        [Fact]
+        void VariablesSerializeChangesTest()
+        {
+            HRESULT hr = S_OK;
+            BYTE* pbBuffer = NULL;
+            SIZE_T cbBuffer = 0;
+            SIZE_T iBuffer = 0;
+            DWORD cVariables = 0;
+            DWORD64 qwChangeCount = 0;
+            BURN_VARIABLES variables1 = { };
+            BURN_VARIABLES variables2 = { };
+            try
+            {
+                hr = VariableInitialize(&variables1);
+                TestThrowOnFailure(hr, L"Failed to initialize variables.");
+
+                VariableSetStringHelper(&variables1, L"PROP1", L"VAL1", FALSE);
+                VariableSetNumericHelper(&variables1, L"PROP2", 2);
+                VariableSetVersionHelper(&variables1, L"PROP3", L"1.1.1.1");
+
+                // first sync includes all variables
+                hr = VariableSerializeChanges(&variables1, 0, &pbBuffer, &cbBuffer, &qwChangeCount);
+                TestThrowOnFailure(hr, L"Failed to serialize variables.");
+
+                hr = VariableInitialize(&variables2);
+                TestThrowOnFailure(hr, L"Failed to initialize variables.");
+
+                hr = VariableDeserialize(&variables2, FALSE, pbBuffer, cbBuffer, &iBuffer);
+                TestThrowOnFailure(hr, L"Failed to deserialize variables.");
+
+                Assert::Equal<String^>(gcnew String(L"VAL1"), VariableGetStringHelper(&variables2, L"PROP1"));
+                Assert::Equal(2ll, VariableGetNumericHelper(&variables2, L"PROP2"));
+                Assert::Equal<String^>(gcnew String(L"1.1.1.1"), VariableGetVersionHelper(&variables2, L"PROP3"));
+
+                // later syncs include only the changed variables
+                VariableSetStringHelper(&variables1, L"PROP1", L"VAL1.1", FALSE);
+
+                ReleaseNullBuffer(pbBuffer);
+                cbBuffer = 0;
+                iBuffer = 0;
+
+                hr = VariableSerializeChanges(&variables1, qwChangeCount, &pbBuffer, &cbBuffer, &qwChangeCount);
+                TestThrowOnFailure(hr, L"Failed to serialize changed variables.");
+
+                hr = BuffReadNumber(pbBuffer, cbBuffer, &iBuffer, &cVariables);
+                TestThrowOnFailure(hr, L"Failed to read variable count.");
+
+                Assert::Equal<DWORD>(1, cVariables);
+
+                iBuffer = 0;
+
+                hr = VariableDeserialize(&variables2, FALSE, pbBuffer, cbBuffer, &iBuffer);
+                TestThrowOnFailure(hr, L"Failed to deserialize changed variables.");
+
+                Assert::Equal<String^>(gcnew String(L"VAL1.1"), VariableGetStringHelper(&variables2, L"PROP1"));
+                Assert::Equal(2ll, VariableGetNumericHelper(&variables2, L"PROP2"));
+                Assert::Equal<String^>(gcnew String(L"1.1.1.1"), VariableGetVersionHelper(&variables2, L"PROP3"));
+
+                // nothing changed
+                ReleaseNullBuffer(pbBuffer);
+                cbBuffer = 0;
+                iBuffer = 0;
+
+                hr = VariableSerializeChanges(&variables1, qwChangeCount, &pbBuffer, &cbBuffer, &qwChangeCount);
+                TestThrowOnFailure(hr, L"Failed to serialize unchanged variables.");
+
+                hr = BuffReadNumber(pbBuffer, cbBuffer, &iBuffer, &cVariables);
+                TestThrowOnFailure(hr, L"Failed to read variable count.");
+
+                Assert::Equal<DWORD>(0, cVariables);
+            }
+            finally
+            {
+                ReleaseBuffer(pbBuffer);
+                VariablesUninitialize(&variables1);
+                VariablesUninitialize(&variables2);
+            }
+        }
+
         [Fact]
         void VariablesBuiltInTest()
         {
@@ -540,6 +621,356 @@ namespace Bootstrapper
                 VariablesUninitialize(&variables);
             }
         }
+
+        [Fact]
+        void VariablesSnapshotTest()
+        {
+            HRESULT hr = S_OK;
+            IXMLDOMElement* pixeBundle = NULL;
+            BURN_VARIABLES variables = { };
+            LPWSTR scz = NULL;
+            try
+            {
+                LPCWSTR wzDocument =
+                    L"<Bundle>"
+                    L"    <Variable Id='Secret' Type='string' Value='supersecret' Hidden='yes' Persisted='no' />"
+                    L"</Bundle>";
+
+                hr = VariableInitialize(&variables);
+                TestThrowOnFailure(hr, L"Failed to initialize variables.");
+
+                LoadBundleXmlHelper(wzDocument, &pixeBundle);
+
+                hr = VariablesParseFromXml(&variables, pixeBundle);
+                TestThrowOnFailure(hr, L"Failed to parse variables from XML.");
+
+                VariableSetStringHelper(&variables, L"PROP1", L"VAL1", FALSE);
+                VariableSetStringHelper(&variables, L"PROP2", L"[PROP1]", TRUE);
+
+                // Enough reads publish a snapshot.
+                for (DWORD i = 0; i < 20; ++i)
+                {
+                    Assert::Equal<String^>(gcnew String(L"VAL1 VAL1"), VariableFormatStringHelper(&variables, L"[PROP1] [PROP2]"));
+                }
+                Assert::True(NULL != variables.pSnapshot);
+
+                // Hidden variables and built-in variables still read correctly from the snapshot.
+                Assert::Equal<String^>(gcnew String(L"supersecret"), VariableGetStringHelper(&variables, L"Secret"));
+
+                hr = VariableFormatStringObfuscated(&variables, L"[Secret]", &scz, NULL);
+                TestThrowOnFailure(hr, L"Failed to format obfuscated string.");
+                NativeAssert::StringEqual(L"*****", scz);
+
+                Assert::True(EvaluateConditionHelper(&variables, L"VersionNT <> v0.0.0.0"));
+
+                // Changing a variable retires the snapshot, so the next read sees the new value.
+                VariableSetStringHelper(&variables, L"PROP1", L"VAL2", FALSE);
+                Assert::True(NULL == variables.pSnapshot);
+                Assert::Equal<String^>(gcnew String(L"VAL2 VAL2"), VariableFormatStringHelper(&variables, L"[PROP1] [PROP2]"));
+
+                for (DWORD i = 0; i < 20; ++i)
+                {
+                    Assert::Equal<String^>(gcnew String(L"VAL2"), VariableGetStringHelper(&variables, L"PROP1"));
+                }
+                Assert::True(NULL != variables.pSnapshot);
+            }
+            finally
+            {
+                ReleaseStr(scz);
+                ReleaseObject(pixeBundle);
+                VariablesUninitialize(&variables);
+            }
+        }
+    };
+
+    ref class VariableFormatReader
+    {
+    public:
+        VariableFormatReader(BURN_VARIABLES* pVariables, DWORD cReads)
+        {
+            this->pVariables = pVariables;
+            this->cReads = cReads;
+        }
+
+        void Run()
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczValue = NULL;
+
+            for (DWORD i = 0; i < this->cReads; ++i)
+            {
+                hr = VariableFormatString(this->pVariables, L"[A]-[B]", &sczValue, NULL);
+                if (FAILED(hr))
+                {
+                    this->hrFailure = hr;
+                    break;
+                }
+
+                // The writer always sets A and B together, so both halves must match.
+                LPCWSTR wzSeparator = wcschr(sczValue, L'-');
+                if (!wzSeparator || CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, 0, sczValue, static_cast<int>(wzSeparator - sczValue), wzSeparator + 1, -1))
+                {
+                    ++this->cMismatches;
+                }
+            }
+
+            ReleaseStr(sczValue);
+        }
+
+        BURN_VARIABLES* pVariables;
+        DWORD cReads;
+        HRESULT hrFailure;
+        DWORD cMismatches;
+    };
+
+    public ref class VariableBenchmark : BurnUnitTest
+    {
+    public:
+        VariableBenchmark(BurnTestFixture^ fixture, ITestOutputHelper^ output) : BurnUnitTest(fixture)
+        {
+            this->output = output;
+        }
+
+        [Fact]
+        void VariablesSerializeChangesBenchmark()
+        {
+            const DWORD cVariables = 5000;
+            const DWORD cChanged = 10;
+            HRESULT hr = S_OK;
+            BYTE* pbFull = NULL;
+            SIZE_T cbFull = 0;
+            BYTE* pbChanges = NULL;
+            SIZE_T cbChanges = 0;
+            DWORD64 qwChangeCount = 0;
+            LPWSTR sczName = NULL;
+            LPWSTR sczValue = NULL;
+            BURN_VARIABLES variables = { };
+            try
+            {
+                hr = VariableInitialize(&variables);
+                TestThrowOnFailure(hr, L"Failed to initialize variables.");
+
+                for (DWORD i = 0; i < cVariables; ++i)
+                {
+                    hr = StrAllocFormatted(&sczName, L"Variable%u", i);
+                    TestThrowOnFailure(hr, L"Failed to format variable name.");
+
+                    hr = StrAllocFormatted(&sczValue, L"Value of variable number %u", i);
+                    TestThrowOnFailure(hr, L"Failed to format variable value.");
+
+                    VariableSetStringHelper(&variables, sczName, sczValue, FALSE);
+                }
+
+                hr = VariableSerializeChanges(&variables, 0, &pbChanges, &cbChanges, &qwChangeCount);
+                TestThrowOnFailure(hr, L"Failed to serialize initial variables.");
+
+                for (DWORD i = 0; i < cChanged; ++i)
+                {
+                    hr = StrAllocFormatted(&sczName, L"Variable%u", i * (cVariables / cChanged));
+                    TestThrowOnFailure(hr, L"Failed to format variable name.");
+
+                    VariableSetStringHelper(&variables, sczName, L"Changed", FALSE);
+                }
+
+                ReleaseNullBuffer(pbChanges);
+                cbChanges = 0;
+
+                Stopwatch^ full = Stopwatch::StartNew();
+                hr = VariableSerialize(&variables, FALSE, &pbFull, &cbFull);
+                full->Stop();
+                TestThrowOnFailure(hr, L"Failed to serialize all variables.");
+
+                Stopwatch^ changes = Stopwatch::StartNew();
+                hr = VariableSerializeChanges(&variables, qwChangeCount, &pbChanges, &cbChanges, &qwChangeCount);
+                changes->Stop();
+                TestThrowOnFailure(hr, L"Failed to serialize changed variables.");
+
+                Assert::True(cbChanges < cbFull);
+
+                this->output->WriteLine("{0} variables, {1} changed: full sync {2} bytes in {3} ticks, delta sync {4} bytes in {5} ticks", cVariables, cChanged, cbFull, full->ElapsedTicks, cbChanges, changes->ElapsedTicks);
+            }
+            finally
+            {
+                ReleaseStr(sczName);
+                ReleaseStr(sczValue);
+                ReleaseBuffer(pbFull);
+                ReleaseBuffer(pbChanges);
+                VariablesUninitialize(&variables);
+            }
+        }
+
+        [Fact]
+        void ExternalEngineGetVariablesBenchmark()
+        {
+            const DWORD cVariables = 500;
+            HRESULT hr = S_OK;
+            BURN_ENGINE_STATE engineState = { };
+            LPWSTR* rgsczNames = NULL;
+            HRESULT* rghrVariables = NULL;
+            LPWSTR sczValue = NULL;
+            LPWSTR sczValues = NULL;
+            SIZE_T cch = 0;
+            try
+            {
+                hr = VariableInitialize(&engineState.variables);
+                TestThrowOnFailure(hr, L"Failed to initialize variables.");
+
+                rgsczNames = static_cast<LPWSTR*>(MemAlloc(sizeof(LPWSTR) * cVariables, TRUE));
+                rghrVariables = static_cast<HRESULT*>(MemAlloc(sizeof(HRESULT) * cVariables, TRUE));
+                Assert::True(rgsczNames && rghrVariables);
+
+                for (DWORD i = 0; i < cVariables; ++i)
+                {
+                    hr = StrAllocFormatted(rgsczNames + i, L"Variable%u", i);
+                    TestThrowOnFailure(hr, L"Failed to format variable name.");
+
+                    // Leave every tenth variable unset.
+                    if (i % 10)
+                    {
+                        hr = StrAllocFormatted(&sczValue, L"Value of variable number %u", i);
+                        TestThrowOnFailure(hr, L"Failed to format variable value.");
+
+                        VariableSetStringHelper(&engineState.variables, rgsczNames[i], sczValue, FALSE);
+                    }
+                }
+
+                // One variable at a time, sizing the buffer the way balutil does.
+                Stopwatch^ single = Stopwatch::StartNew();
+                for (DWORD i = 0; i < cVariables; ++i)
+                {
+                    cch = 0;
+                    hr = ExternalEngineGetVariableString(&engineState, rgsczNames[i], NULL, &cch);
+                    if (E_MOREDATA == hr)
+                    {
+                        hr = StrAlloc(&sczValue, cch);
+                        TestThrowOnFailure(hr, L"Failed to allocate value.");
+
+                        hr = ExternalEngineGetVariableString(&engineState, rgsczNames[i], sczValue, &cch);
+                    }
+                    Assert::Equal<HRESULT>(i % 10 ? S_OK : E_NOTFOUND, hr);
+                }
+                single->Stop();
+
+                // All variables in one call.
+                Stopwatch^ batch = Stopwatch::StartNew();
+                cch = 0;
+                hr = ExternalEngineGetVariables(&engineState, cVariables, rgsczNames, NULL, &cch, rghrVariables);
+                Assert::Equal<HRESULT>(E_MOREDATA, hr);
+
+                hr = StrAlloc(&sczValues, cch);
+                TestThrowOnFailure(hr, L"Failed to allocate values.");
+
+                hr = ExternalEngineGetVariables(&engineState, cVariables, rgsczNames, sczValues, &cch, rghrVariables);
+                batch->Stop();
+                TestThrowOnFailure(hr, L"Failed to get variables.");
+
+                LPCWSTR wzValue = sczValues;
+                for (DWORD i = 0; i < cVariables; ++i)
+                {
+                    if (i % 10)
+                    {
+                        Assert::Equal<HRESULT>(S_OK, rghrVariables[i]);
+                        Assert::Equal<String^>(String::Format("Value of variable number {0}", i), gcnew String(wzValue));
+                    }
+                    else
+                    {
+                        Assert::Equal<HRESULT>(E_NOTFOUND, rghrVariables[i]);
+                        Assert::Equal<String^>(String::Empty, gcnew String(wzValue));
+                    }
+
+                    wzValue += lstrlenW(wzValue) + 1;
+                }
+
+                this->output->WriteLine("{0} variables: one at a time in {1} ticks, batched in {2} ticks", cVariables, single->ElapsedTicks, batch->ElapsedTicks);
+            }
+            finally
+            {
+                if (rgsczNames)
+                {
+                    for (DWORD i = 0; i < cVariables; ++i)
+                    {
+                        ReleaseStr(rgsczNames[i]);
+                    }
+                }
+
+                ReleaseMem(rgsczNames);
+                ReleaseMem(rghrVariables);
+                ReleaseStr(sczValue);
+                ReleaseStr(sczValues);
+                VariablesUninitialize(&engineState.variables);
+            }
+        }
+
+        [Fact]
+        void VariablesConcurrentReadBenchmark()
+        {
+            const DWORD cReads = 20000;
+            HRESULT hr = S_OK;
+            BURN_VARIABLES variables = { };
+            LPWSTR sczValue = NULL;
+            LPCWSTR rgwzNames[] = { L"A", L"B" };
+            LPCWSTR rgwzValues[2] = { };
+            try
+            {
+                hr = VariableInitialize(&variables);
+                TestThrowOnFailure(hr, L"Failed to initialize variables.");
+
+                VariableSetStringHelper(&variables, L"A", L"0", FALSE);
+                VariableSetStringHelper(&variables, L"B", L"0", FALSE);
+
+                for each (DWORD cReaders in gcnew array<DWORD>{ 1, 4 })
+                {
+                    array<VariableFormatReader^>^ readers = gcnew array<VariableFormatReader^>(cReaders);
+                    array<Threading::Thread^>^ threads = gcnew array<Threading::Thread^>(cReaders);
+                    DWORD cWrites = 0;
+
+                    for (DWORD i = 0; i < cReaders; ++i)
+                    {
+                        readers[i] = gcnew VariableFormatReader(&variables, cReads);
+                        threads[i] = gcnew Threading::Thread(gcnew Threading::ThreadStart(readers[i], &VariableFormatReader::Run));
+                    }
+
+                    Stopwatch^ elapsed = Stopwatch::StartNew();
+                    for (DWORD i = 0; i < cReaders; ++i)
+                    {
+                        threads[i]->Start();
+                    }
+
+                    // This thread is the single writer until every reader finishes.
+                    for (DWORD i = 0; i < cReaders; ++i)
+                    {
+                        while (!threads[i]->Join(1))
+                        {
+                            hr = StrAllocFormatted(&sczValue, L"%u", ++cWrites);
+                            TestThrowOnFailure(hr, L"Failed to format value.");
+
+                            rgwzValues[0] = sczValue;
+                            rgwzValues[1] = sczValue;
+
+                            hr = VariableSetStrings(&variables, 2, rgwzNames, rgwzValues, FALSE);
+                            TestThrowOnFailure(hr, L"Failed to set variables.");
+                        }
+                    }
+                    elapsed->Stop();
+
+                    for (DWORD i = 0; i < cReaders; ++i)
+                    {
+                        NativeAssert::Succeeded(readers[i]->hrFailure, "Failed to format string.");
+                        Assert::Equal<DWORD>(0, readers[i]->cMismatches);
+                    }
+
+                    this->output->WriteLine("{0} readers, {1} reads each, {2} writes: {3} reads per second", cReaders, cReads, cWrites, (cReaders * cReads * 1000LL) / Math::Max(1LL, elapsed->ElapsedMilliseconds));
+                }
+            }
+            finally
+            {
+                ReleaseStr(sczValue);
+                VariablesUninitialize(&variables);
+            }
+        }
+
+    private:
+        ITestOutputHelper^ output;
     };
 }
 }
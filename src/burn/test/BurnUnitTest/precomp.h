@@ -57,9 +57,11 @@
 #include "pseudobundle.h"
 #include "registration.h"
 #include "relatedbundle.h"
+#include "detect.h"
 #include "plan.h"
 #include "pipe.h"
 #include "logging.h"
+#include "tracing.h"
 #include "cache.h"
 #include "dependency.h"
 #include "core.h"
@@ -72,7 +74,6 @@
 #include "embedded.h"
 #include "manifest.h"
 #include "splashscreen.h"
-#include "detect.h"
 #include "externalengine.h"
 
 #include "engine.version.h"
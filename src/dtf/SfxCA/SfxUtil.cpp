@@ -197,6 +197,7 @@ bool ExtractToTempDirectory(__in MSIHANDLE hSession, __in HMODULE hModule,
         }
 
         Log(hSession, L"Extracting custom action to temporary directory: %s\\", szTempDir);
+        DWORD dwStart = GetTickCount();
         int err = ExtractCabinet(szModule, szTempDir);
         if (err != 0)
         {
@@ -204,6 +205,7 @@ bool ExtractToTempDirectory(__in MSIHANDLE hSession, __in HMODULE hModule,
                 DeleteDirectory(szTempDir);
                 return false;
         }
+        Log(hSession, L"Extracted custom action files in %lu ms.", GetTickCount() - dwStart);
         return true;
 }
 
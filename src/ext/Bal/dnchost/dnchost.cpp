@@ -7,12 +7,16 @@ static DNCSTATE vstate = { };
 
 // internal function declarations
 
+static HRESULT Initialize(
+    __in DNCSTATE* pState,
+    __in const BOOTSTRAPPER_COMMAND* pCommand
+    );
 static HRESULT LoadModulePaths(
     __in DNCSTATE* pState
     );
 static HRESULT LoadDncConfiguration(
     __in DNCSTATE* pState,
-    __in const BOOTSTRAPPER_CREATE_ARGS* pArgs
+    __in const BOOTSTRAPPER_COMMAND* pCommand
     );
 static HRESULT LoadRuntime(
     __in DNCSTATE* pState
@@ -20,6 +24,12 @@ static HRESULT LoadRuntime(
 static HRESULT LoadManagedBootstrapperApplicationFactory(
     __in DNCSTATE* pState
     );
+static DWORD WINAPI PrewarmThreadProc(
+    __in LPVOID pvContext
+    );
+static HRESULT WaitForPrewarm(
+    __in DNCSTATE* pState
+    );
 static HRESULT CreatePrerequisiteBA(
     __in DNCSTATE* pState,
     __in IBootstrapperEngine* pEngine,
@@ -51,6 +61,34 @@ extern "C" BOOL WINAPI DllMain(
     return TRUE;
 }
 
+extern "C" HRESULT WINAPI BootstrapperApplicationPrepare(
+    __in const BOOTSTRAPPER_PREPARE_ARGS* pArgs,
+    __inout BOOTSTRAPPER_PREPARE_RESULTS* /*pResults*/
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = Initialize(&vstate, pArgs->pCommand);
+    ExitOnFailure(hr, "Failed to initialize dnchost.");
+
+    // Start the runtime now so hostfxr and CoreCLR load while the engine finishes initializing.
+    if (!vstate.prereqData.fAlwaysInstallPrereqs && !vstate.hPrewarmThread)
+    {
+        // There is no engine to log to until Create, so hostfxr errors are kept until then.
+        vstate.hostfxrState.fDeferErrors = TRUE;
+
+        vstate.hPrewarmThread = ::CreateThread(NULL, 0, PrewarmThreadProc, &vstate, 0, NULL);
+        if (!vstate.hPrewarmThread)
+        {
+            vstate.hostfxrState.fDeferErrors = FALSE;
+        }
+        ExitOnNullWithLastError(vstate.hPrewarmThread, hr, "Failed to create runtime pre-warm thread.");
+    }
+
+LExit:
+    return hr;
+}
+
 extern "C" HRESULT WINAPI BootstrapperApplicationCreate(
     __in const BOOTSTRAPPER_CREATE_ARGS* pArgs,
     __inout BOOTSTRAPPER_CREATE_RESULTS* pResults
@@ -59,22 +97,17 @@ extern "C" HRESULT WINAPI BootstrapperApplicationCreate(
     HRESULT hr = S_OK;
     IBootstrapperEngine* pEngine = NULL;
 
+    // The pre-warm thread logs through Bal, so it must be done before Bal is given the engine.
+    hr = WaitForPrewarm(&vstate);
+    ExitOnFailure(hr, "Failed to wait for the .NET Core runtime to load.");
+
     hr = BalInitializeFromCreateArgs(pArgs, &pEngine);
     ExitOnFailure(hr, "Failed to initialize Bal.");
 
-    if (!vstate.fInitialized)
-    {
-        hr = XmlInitialize();
-        BalExitOnFailure(hr, "Failed to initialize XML.");
-
-        hr = LoadModulePaths(&vstate);
-        BalExitOnFailure(hr, "Failed to get the host base path.");
+    DnchostLogDeferredErrors(&vstate.hostfxrState);
 
-        hr = LoadDncConfiguration(&vstate, pArgs);
-        BalExitOnFailure(hr, "Failed to get the dnc configuration.");
-
-        vstate.fInitialized = TRUE;
-    }
+    hr = Initialize(&vstate, pArgs->pCommand);
+    BalExitOnFailure(hr, "Failed to initialize dnchost.");
 
     if (vstate.prereqData.fAlwaysInstallPrereqs && !vstate.prereqData.fCompleted)
     {
@@ -88,7 +121,18 @@ extern "C" HRESULT WINAPI BootstrapperApplicationCreate(
 
     if (!vstate.fInitializedRuntime)
     {
-        hr = LoadRuntime(&vstate);
+        if (FAILED(vstate.hrPrewarm))
+        {
+            hr = vstate.hrPrewarm;
+            BalLogError(hr, "Failed to pre-warm the .NET Core runtime.");
+
+            // A reload after the prerequisites are installed tries again.
+            vstate.hrPrewarm = S_OK;
+        }
+        else
+        {
+            hr = LoadRuntime(&vstate);
+        }
 
         vstate.fInitializedRuntime = SUCCEEDED(hr);
     }
@@ -101,6 +145,7 @@ extern "C" HRESULT WINAPI BootstrapperApplicationCreate(
             BalExitOnFailure(hr, "Failed to create the .NET Core bootstrapper application factory.");
         }
 
+        BalLog(BOOTSTRAPPER_LOG_LEVEL_STANDARD, "dnchost startup: configuration %u ms, runtime %u ms, factory %u ms, waited %u ms for pre-warm.", vstate.dwConfigurationDuration, vstate.dwRuntimeDuration, vstate.dwFactoryDuration, vstate.dwPrewarmWaitDuration);
         BalLog(BOOTSTRAPPER_LOG_LEVEL_STANDARD, "Loading .NET Core %ls bootstrapper application.", DNCHOSTTYPE_FDD == vstate.type ? L"FDD" : L"SCD");
 
         hr = vstate.pAppFactory->Create(pArgs, pResults);
@@ -144,6 +189,10 @@ extern "C" void WINAPI BootstrapperApplicationDestroy(
 
     childResults.cbSize = sizeof(BOOTSTRAPPER_DESTROY_RESULTS);
 
+    // The module must not go away while the pre-warm thread is still running in it.
+    WaitForPrewarm(&vstate);
+    DnchostLogDeferredErrors(&vstate.hostfxrState);
+
     if (vstate.hMbapreqModule)
     {
         PFN_BOOTSTRAPPER_APPLICATION_DESTROY pfnDestroy = reinterpret_cast<PFN_BOOTSTRAPPER_APPLICATION_DESTROY>(::GetProcAddress(vstate.hMbapreqModule, "PrereqBootstrapperApplicationDestroy"));
@@ -162,6 +211,37 @@ extern "C" void WINAPI BootstrapperApplicationDestroy(
     pResults->fDisableUnloading = TRUE;
 }
 
+static HRESULT Initialize(
+    __in DNCSTATE* pState,
+    __in const BOOTSTRAPPER_COMMAND* pCommand
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwStart = 0;
+
+    if (pState->fInitialized)
+    {
+        ExitFunction();
+    }
+
+    dwStart = ::GetTickCount();
+
+    hr = XmlInitialize();
+    BalExitOnFailure(hr, "Failed to initialize XML.");
+
+    hr = LoadModulePaths(pState);
+    BalExitOnFailure(hr, "Failed to get the host base path.");
+
+    hr = LoadDncConfiguration(pState, pCommand);
+    BalExitOnFailure(hr, "Failed to get the dnc configuration.");
+
+    pState->dwConfigurationDuration = ::GetTickCount() - dwStart;
+    pState->fInitialized = TRUE;
+
+LExit:
+    return hr;
+}
+
 static HRESULT LoadModulePaths(
     __in DNCSTATE* pState
     )
@@ -180,7 +260,7 @@ LExit:
 
 static HRESULT LoadDncConfiguration(
     __in DNCSTATE* pState,
-    __in const BOOTSTRAPPER_CREATE_ARGS* pArgs
+    __in const BOOTSTRAPPER_COMMAND* pCommand
     )
 {
     HRESULT hr = S_OK;
@@ -190,8 +270,8 @@ static HRESULT LoadDncConfiguration(
     DWORD dwBool = 0;
     BOOL fXmlFound = FALSE;
 
-    hr = XmlLoadDocumentFromFile(pArgs->pCommand->wzBootstrapperApplicationDataPath, &pixdManifest);
-    BalExitOnFailure(hr, "Failed to load BalManifest '%ls'", pArgs->pCommand->wzBootstrapperApplicationDataPath);
+    hr = XmlLoadDocumentFromFile(pCommand->wzBootstrapperApplicationDataPath, &pixdManifest);
+    BalExitOnFailure(hr, "Failed to load BalManifest '%ls'", pCommand->wzBootstrapperApplicationDataPath);
 
     hr = XmlSelectSingleNode(pixdManifest, L"/BootstrapperApplicationData/WixBalBAFactoryAssembly", &pixnHost);
     BalExitOnRequiredXmlQueryFailure(hr, "Failed to get WixBalBAFactoryAssembly element.");
@@ -199,7 +279,7 @@ static HRESULT LoadDncConfiguration(
     hr = XmlGetAttributeEx(pixnHost, L"FilePath", &sczPayloadName);
     BalExitOnRequiredXmlQueryFailure(hr, "Failed to get WixBalBAFactoryAssembly/@FilePath.");
 
-    hr = PathConcatRelativeToBase(pArgs->pCommand->wzBootstrapperWorkingFolder, sczPayloadName, &pState->sczBaFactoryAssemblyPath);
+    hr = PathConcatRelativeToBase(pCommand->wzBootstrapperWorkingFolder, sczPayloadName, &pState->sczBaFactoryAssemblyPath);
     BalExitOnFailure(hr, "Failed to create BaFactoryAssemblyPath.");
 
     LPCWSTR wzFileName = PathFile(pState->sczBaFactoryAssemblyPath);
@@ -266,6 +346,7 @@ static HRESULT LoadRuntime(
     )
 {
     HRESULT hr = S_OK;
+    DWORD dwStart = ::GetTickCount();
 
     hr = DnchostLoadRuntime(
         &pState->hostfxrState,
@@ -274,6 +355,8 @@ static HRESULT LoadRuntime(
         pState->sczBaFactoryDepsJsonPath,
         pState->sczBaFactoryRuntimeConfigPath);
 
+    pState->dwRuntimeDuration = ::GetTickCount() - dwStart;
+
     return hr;
 }
 
@@ -282,6 +365,7 @@ static HRESULT LoadManagedBootstrapperApplicationFactory(
     )
 {
     HRESULT hr = S_OK;
+    DWORD dwStart = ::GetTickCount();
 
     hr = DnchostCreateFactory(
         &pState->hostfxrState,
@@ -289,6 +373,54 @@ static HRESULT LoadManagedBootstrapperApplicationFactory(
         pState->sczBaFactoryAssemblyPath,
         &pState->pAppFactory);
 
+    pState->dwFactoryDuration = ::GetTickCount() - dwStart;
+
+    return hr;
+}
+
+static DWORD WINAPI PrewarmThreadProc(
+    __in LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    DNCSTATE* pState = reinterpret_cast<DNCSTATE*>(pvContext);
+
+    hr = LoadRuntime(pState);
+    ExitOnFailure(hr, "Failed to pre-warm the .NET Core runtime.");
+
+    pState->fInitializedRuntime = TRUE;
+
+    hr = LoadManagedBootstrapperApplicationFactory(pState);
+    ExitOnFailure(hr, "Failed to pre-warm the .NET Core bootstrapper application factory.");
+
+LExit:
+    pState->hrPrewarm = hr;
+
+    return static_cast<DWORD>(hr);
+}
+
+static HRESULT WaitForPrewarm(
+    __in DNCSTATE* pState
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwStart = 0;
+
+    if (!pState->hPrewarmThread)
+    {
+        ExitFunction();
+    }
+
+    dwStart = ::GetTickCount();
+
+    hr = AppWaitForSingleObject(pState->hPrewarmThread, INFINITE);
+    ExitOnFailure(hr, "Failed to wait for runtime pre-warm thread.");
+
+    pState->dwPrewarmWaitDuration = ::GetTickCount() - dwStart;
+
+    ReleaseNullHandle(pState->hPrewarmThread);
+
+LExit:
     return hr;
 }
 
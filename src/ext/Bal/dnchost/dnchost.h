@@ -25,4 +25,14 @@ struct DNCSTATE
     IBootstrapperApplicationFactory* pAppFactory;
     HMODULE hMbapreqModule;
     PREQBA_DATA prereqData;
+
+    // Runtime pre-warming started by BootstrapperApplicationPrepare.
+    HANDLE hPrewarmThread;
+    HRESULT hrPrewarm;
+
+    // Startup stage timings in milliseconds, logged once the BA is created.
+    DWORD dwConfigurationDuration;
+    DWORD dwRuntimeDuration;
+    DWORD dwFactoryDuration;
+    DWORD dwPrewarmWaitDuration;
 };
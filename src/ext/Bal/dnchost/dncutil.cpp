@@ -13,6 +13,9 @@
 #define HostApiBufferTooSmall 0x80008098
 #define HostApiUnsupportedVersion 0x800080a2
 
+// State whose hostfxr errors DnchostErrorWriter may need to defer.
+static HOSTFXR_STATE* vpErrorWriterState = NULL;
+
 // internal function declarations
 
 static HRESULT GetHostfxrPath(
@@ -28,6 +31,11 @@ static HRESULT InitializeHostfxr(
     __in LPCWSTR wzDepsJsonPath,
     __in LPCWSTR wzRuntimeConfigPath
     );
+static HRESULT DeferError(
+    __in HOSTFXR_STATE* pState,
+    __in BOOTSTRAPPER_LOG_LEVEL level,
+    __in LPCWSTR wzMessage
+    );
 static HRESULT InitializeCoreClr(
     __in HOSTFXR_STATE* pState,
     __in LPCWSTR wzNativeHostPath
@@ -132,6 +140,24 @@ LExit:
     return hr;
 }
 
+void DnchostLogDeferredErrors(
+    __in HOSTFXR_STATE* pState
+    )
+{
+    for (DWORD i = 0; i < pState->cDeferredErrors; ++i)
+    {
+        HOSTFXR_DEFERRED_ERROR* pError = pState->rgDeferredErrors + i;
+
+        BalLog(pError->level, "error from hostfxr: %ls", pError->sczMessage);
+
+        ReleaseStr(pError->sczMessage);
+    }
+
+    ReleaseNullMem(pState->rgDeferredErrors);
+    pState->cDeferredErrors = 0;
+    pState->fDeferErrors = FALSE;
+}
+
 static HRESULT GetHostfxrPath(
     __in HOSTFXR_STATE* pState,
     __in LPCWSTR wzNativeHostPath
@@ -211,7 +237,39 @@ static void HOSTFXR_CALLTYPE DnchostErrorWriter(
         level = BOOTSTRAPPER_LOG_LEVEL_DEBUG;
     }
 
-    BalLog(level, "error from hostfxr: %ls", wzMessage);
+    // Before the BA is created there is no engine to log to, so keep the message for later.
+    if (vpErrorWriterState && vpErrorWriterState->fDeferErrors)
+    {
+        DeferError(vpErrorWriterState, level, wzMessage);
+    }
+    else
+    {
+        BalLog(level, "error from hostfxr: %ls", wzMessage);
+    }
+}
+
+static HRESULT DeferError(
+    __in HOSTFXR_STATE* pState,
+    __in BOOTSTRAPPER_LOG_LEVEL level,
+    __in LPCWSTR wzMessage
+    )
+{
+    HRESULT hr = S_OK;
+    HOSTFXR_DEFERRED_ERROR* pError = NULL;
+
+    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pState->rgDeferredErrors), pState->cDeferredErrors + 1, sizeof(HOSTFXR_DEFERRED_ERROR), 4);
+    ExitOnFailure(hr, "Failed to grow deferred hostfxr errors.");
+
+    pError = pState->rgDeferredErrors + pState->cDeferredErrors;
+    pError->level = level;
+
+    hr = StrAllocString(&pError->sczMessage, wzMessage, 0);
+    ExitOnFailure(hr, "Failed to copy deferred hostfxr error.");
+
+    ++pState->cDeferredErrors;
+
+LExit:
+    return hr;
 }
 
 static HRESULT InitializeHostfxr(
@@ -223,6 +281,8 @@ static HRESULT InitializeHostfxr(
 {
     HRESULT hr = S_OK;
 
+    // hostfxr keeps the error writer per thread, so it is set on the thread that loads the runtime.
+    vpErrorWriterState = pState;
     pState->pfnHostfxrSetErrorWriter(static_cast<hostfxr_error_writer_fn>(&DnchostErrorWriter));
 
     LPCWSTR argv[] = {
@@ -3,6 +3,12 @@
 
 typedef IBootstrapperApplicationFactory* (STDMETHODCALLTYPE* PFNCREATEBAFACTORY)();
 
+struct HOSTFXR_DEFERRED_ERROR
+{
+    BOOTSTRAPPER_LOG_LEVEL level;
+    LPWSTR sczMessage;
+};
+
 struct HOSTFXR_STATE
 {
     LPWSTR sczHostfxrPath;
@@ -17,6 +23,11 @@ struct HOSTFXR_STATE
     coreclr_create_delegate_ptr pfnCoreclrCreateDelegate;
     void* pClrHandle;
     UINT dwDomainId;
+
+    // While set, hostfxr errors are kept until the BA can log them.
+    BOOL fDeferErrors;
+    HOSTFXR_DEFERRED_ERROR* rgDeferredErrors;
+    DWORD cDeferredErrors;
 };
 
 HRESULT DnchostLoadRuntime(
@@ -33,3 +44,7 @@ HRESULT DnchostCreateFactory(
     __in LPCWSTR wzBaFactoryAssemblyPath,
     __out IBootstrapperApplicationFactory** ppAppFactory
     );
+
+void DnchostLogDeferredErrors(
+    __in HOSTFXR_STATE* pState
+    );
@@ -7,6 +7,7 @@
 #include <Shlwapi.h>
 
 #include <dutil.h>
+#include <apputil.h>
 #include <memutil.h>
 #include <pathutil.h>
 #include <strutil.h>
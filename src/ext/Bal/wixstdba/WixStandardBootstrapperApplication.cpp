@@ -158,6 +158,15 @@ static HRESULT DAPI SetVariableStringCallback(
     __in BOOL fFormatted,
     __in_opt LPVOID pvContext
     );
+static HRESULT DAPI EvaluateVariableBatchCallback(
+    __in DWORD cConditions,
+    __in_ecount(cConditions) LPCWSTR* rgwzConditions,
+    __out_ecount(cConditions) BOOL* rgfConditions,
+    __in DWORD cFormats,
+    __in_ecount(cFormats) LPCWSTR* rgwzFormats,
+    __out_ecount(cFormats) LPWSTR* rgsczFormatted,
+    __in_opt LPVOID pvContext
+    );
 static LPCSTR LoggingBoolToString(
     __in BOOL f
     );
@@ -2936,6 +2945,9 @@ private:
         hr = ThemeRegisterVariableCallbacks(m_pTheme, EvaluateVariableConditionCallback, FormatVariableStringCallback, GetVariableNumericCallback, SetVariableNumericCallback, GetVariableStringCallback, SetVariableStringCallback, NULL);
         BalExitOnFailure(hr, "Failed to register variable theme callbacks.");
 
+        hr = ThemeRegisterVariableBatchCallback(m_pTheme, EvaluateVariableBatchCallback);
+        BalExitOnFailure(hr, "Failed to register variable batch theme callback.");
+
         C_ASSERT(COUNT_WIXSTDBA_PAGE == countof(vrgwzPageNames));
         C_ASSERT(countof(m_rgdwPageIds) == countof(vrgwzPageNames));
 
@@ -3157,6 +3169,8 @@ private:
         hr = ThemeCreateParentWindow(m_pTheme, 0, wc.lpszClassName, m_pTheme->sczCaption, dwWindowStyle, x, y, HWND_DESKTOP, m_hModule, this, THEME_WINDOW_INITIAL_POSITION_CENTER_MONITOR_FROM_COORDINATES, &m_hWnd);
         ExitOnFailure(hr, "Failed to create window.");
 
+        LogTimeToFirstWindow();
+
         OnThemeLoaded();
 
         hr = S_OK;
@@ -3166,6 +3180,33 @@ private:
     }
 
 
+    //
+    // LogTimeToFirstWindow - logs how long after process start the main window was created.
+    //
+    void LogTimeToFirstWindow()
+    {
+        FILETIME ftCreation = { };
+        FILETIME ftExit = { };
+        FILETIME ftKernel = { };
+        FILETIME ftUser = { };
+        FILETIME ftNow = { };
+        ULARGE_INTEGER uliCreation = { };
+        ULARGE_INTEGER uliNow = { };
+
+        if (::GetProcessTimes(::GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser))
+        {
+            ::GetSystemTimeAsFileTime(&ftNow);
+
+            uliCreation.LowPart = ftCreation.dwLowDateTime;
+            uliCreation.HighPart = ftCreation.dwHighDateTime;
+            uliNow.LowPart = ftNow.dwLowDateTime;
+            uliNow.HighPart = ftNow.dwHighDateTime;
+
+            BalLog(BOOTSTRAPPER_LOG_LEVEL_VERBOSE, "Created main window %llu ms after process start.", (uliNow.QuadPart - uliCreation.QuadPart) / 10000);
+        }
+    }
+
+
     //
     // InitializeTaskbarButton - initializes taskbar button for progress.
     //
@@ -5085,6 +5126,35 @@ static HRESULT DAPI SetVariableStringCallback(
     return BalSetStringVariable(wzVariable, wzValue, fFormatted);
 }
 
+
+static HRESULT DAPI EvaluateVariableBatchCallback(
+    __in DWORD cConditions,
+    __in_ecount(cConditions) LPCWSTR* rgwzConditions,
+    __out_ecount(cConditions) BOOL* rgfConditions,
+    __in DWORD cFormats,
+    __in_ecount(cFormats) LPCWSTR* rgwzFormats,
+    __out_ecount(cFormats) LPWSTR* rgsczFormatted,
+    __in_opt LPVOID /*pvContext*/
+    )
+{
+    HRESULT hr = S_OK;
+
+    for (DWORD i = 0; i < cConditions; ++i)
+    {
+        hr = BalEvaluateCondition(rgwzConditions[i], rgfConditions + i);
+        BalExitOnFailure(hr, "Failed to evaluate condition: %ls", rgwzConditions[i]);
+    }
+
+    for (DWORD i = 0; i < cFormats; ++i)
+    {
+        hr = BalFormatString(rgwzFormats[i], rgsczFormatted + i);
+        BalExitOnFailure(hr, "Failed to format string: %ls", rgwzFormats[i]);
+    }
+
+LExit:
+    return hr;
+}
+
 static LPCSTR LoggingBoolToString(
     __in BOOL f
     )
@@ -261,9 +261,7 @@ static HRESULT CreateApplication(
         ExitOnFailure(hr, "Failed to set application name property");
 
         // save changes
-        hr = piAppColl->SaveChanges(&lChanges);
-        if (COMADMIN_E_OBJECTERRORS == hr)
-            CpiLogCatalogErrorInfo();
+        hr = CpiExecSaveChanges(piAppColl, &lChanges);
         ExitOnFailure(hr, "Failed to add application");
     }
 
@@ -272,9 +270,7 @@ static HRESULT CreateApplication(
     ExitOnFailure(hr, "Failed to write properties");
 
     // save changes
-    hr = piAppColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piAppColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
@@ -326,9 +322,7 @@ static HRESULT RemoveApplication(
     }
 
     // save changes
-    hr = piAppColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piAppColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
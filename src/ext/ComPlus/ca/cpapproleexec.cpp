@@ -431,9 +431,7 @@ static HRESULT CreateApplicationRole(
     ExitOnFailure(hr, "Failed to write properties");
 
     // save changes
-    hr = piRolesColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piRolesColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
@@ -485,9 +483,7 @@ static HRESULT RemoveApplicationRole(
     }
 
     // save changes
-    hr = piRolesColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piRolesColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
@@ -611,9 +607,7 @@ static HRESULT CreateUsersInApplicationRole(
     ExitOnFailure(hr, "Failed to set role name property");
 
     // save changes
-    hr = piUsrInRoleColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piUsrInRoleColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
@@ -699,9 +693,7 @@ static HRESULT RemoveUsersInApplicationRole(
     }
 
     // save changes
-    hr = piUsrInRoleColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piUsrInRoleColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
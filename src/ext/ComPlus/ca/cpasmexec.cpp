@@ -687,9 +687,7 @@ static HRESULT UnregisterAssembly(
         ExitOnFailure(hr, "Failed to get remove components");
 
         // save changes
-        hr = piColl->SaveChanges(&lChanges);
-        if (COMADMIN_E_OBJECTERRORS == hr)
-            CpiLogCatalogErrorInfo();
+        hr = CpiExecSaveChanges(piColl, &lChanges);
         ExitOnFailure(hr, "Failed to save changes");
     }
 
@@ -912,6 +910,9 @@ static HRESULT RegisterDotNetAssembly(
     dispparams.cNamedArgs = 0;
 
     hr = piRegHlp->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_METHOD, &dispparams, NULL, &excepInfo, NULL);
+
+    // the registration helper changes the catalog behind any collection snapshots
+    CpiExecInvalidateCollections();
     if (DISP_E_EXCEPTION == hr)
     {
         // log exception information
@@ -1032,6 +1033,9 @@ static HRESULT RegisterNativeAssembly(
         ExitOnFailure(hr, "Failed to install components");
     }
 
+    // applications and components collections were changed by the catalog
+    CpiExecInvalidateCollections();
+
     hr = S_OK;
 
 LExit:
@@ -1108,6 +1112,9 @@ static HRESULT UnregisterDotNetAssembly(
     dispparams.cNamedArgs = 0;
 
     hr = piRegHlp->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_METHOD, &dispparams, NULL, &excepInfo, NULL);
+
+    // the registration helper changes the catalog behind any collection snapshots
+    CpiExecInvalidateCollections();
     if (DISP_E_EXCEPTION == hr)
     {
         // log exception information
@@ -1346,9 +1353,7 @@ static HRESULT ConfigureComponents(
     }
 
     // save changes
-    hr = piCompColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piCompColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     hr = S_OK;
@@ -1419,9 +1424,7 @@ static HRESULT ConfigureInterfaces(
     }
 
     // save changes
-    hr = piIntfColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piIntfColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     hr = S_OK;
@@ -1489,9 +1492,7 @@ static HRESULT ConfigureMethods(
     }
 
     // save changes
-    hr = piMethColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piMethColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     hr = S_OK;
@@ -1560,9 +1561,7 @@ static HRESULT ConfigureRoleAssignments(
     }
 
     // save changes
-    hr = piRoleColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piRoleColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     hr = S_OK;
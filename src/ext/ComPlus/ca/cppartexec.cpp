@@ -424,9 +424,7 @@ static HRESULT CreatePartition(
     ExitOnFailure(hr, "Failed to write properties");
 
     // save changes
-    hr = piPartColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piPartColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
@@ -471,9 +469,7 @@ static HRESULT RemovePartition(
     }
 
     // save changes
-    hr = piPartColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piPartColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
@@ -588,9 +584,7 @@ static HRESULT CreatePartitionUser(
     ExitOnFailure(hr, "Failed to set default partition id property");
 
     // save changes
-    hr = piUserColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piUserColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
@@ -669,9 +663,7 @@ static HRESULT RemovePartitionUser(
     }
 
     // save changes
-    hr = piUserColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piUserColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
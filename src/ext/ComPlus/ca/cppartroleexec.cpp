@@ -288,9 +288,7 @@ static HRESULT CreateUserInPartitionRole(
     ExitOnFailure(hr, "Failed to set role name property");
 
     // save changes
-    hr = piUsrInRoleColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piUsrInRoleColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
@@ -376,9 +374,7 @@ static HRESULT RemoveUserInPartitionRole(
     }
 
     // save changes
-    hr = piUsrInRoleColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piUsrInRoleColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
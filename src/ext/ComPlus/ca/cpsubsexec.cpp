@@ -343,9 +343,7 @@ static HRESULT CreateSubscription(
     }
 
     // save changes
-    hr = piSubsColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piSubsColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
@@ -393,9 +391,7 @@ static HRESULT RemoveSubscription(
     ExitOnFailure(hr, "Failed to remove subscriptions");
 
     // save changes
-    hr = piSubsColl->SaveChanges(&lChanges);
-    if (COMADMIN_E_OBJECTERRORS == hr)
-        CpiLogCatalogErrorInfo();
+    hr = CpiExecSaveChanges(piSubsColl, &lChanges);
     ExitOnFailure(hr, "Failed to save changes");
 
     // log
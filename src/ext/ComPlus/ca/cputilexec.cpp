@@ -13,6 +13,26 @@ struct CPI_WELLKNOWN_SID
     DWORD dwSubAuthority[8];
 };
 
+struct CPI_COLLECTION_ITEM
+{
+    LPWSTR pwzKey;
+    LPWSTR pwzName;
+    long lIndex;
+};
+
+struct CPI_COLLECTION_SNAPSHOT
+{
+    ICatalogCollection* piColl;
+    LPWSTR pwzName; // collection name
+    LPWSTR pwzPath; // catalog path of cached parent collections, NULL for collections that are only indexed
+
+    long lCnt; // number of items when the index was built, -1 when not indexed
+    CPI_COLLECTION_ITEM* rgItems;
+    long cItems;
+    STRINGDICT_HANDLE shKeys;
+    STRINGDICT_HANDLE shNames;
+};
+
 
 // well known SIDs
 
@@ -60,11 +80,75 @@ static HRESULT ReadFileAll(
     PBYTE pbBuffer,
     DWORD dwBufferLength
     );
+static HRESULT GetPartitionRolesCollection(
+    LPCWSTR pwzPartID,
+    BOOL fSnapshot,
+    ICatalogCollection** ppiRolesColl
+    );
+static HRESULT GetApplicationsCollection(
+    LPCWSTR pwzPartID,
+    BOOL fSnapshot,
+    ICatalogCollection** ppiAppColl,
+    LPWSTR* ppwzPath
+    );
+static HRESULT GetApplicationChildCollection(
+    LPCWSTR pwzPartID,
+    LPCWSTR pwzAppID,
+    LPCWSTR pwzName,
+    BOOL fSnapshot,
+    ICatalogCollection** ppiColl
+    );
+static HRESULT GetCollection(
+    LPCWSTR pwzParentPath,
+    ICatalogCollection* piParentColl,
+    ICatalogObject* piParentObj,
+    LPCWSTR pwzParentKey,
+    LPCWSTR pwzName,
+    BOOL fSnapshot,
+    ICatalogCollection** ppiColl,
+    LPWSTR* ppwzPath
+    );
+static HRESULT GetCollectionSnapshot(
+    LPCWSTR pwzPath,
+    ICatalogCollection* piParentColl,
+    ICatalogObject* piParentObj,
+    LPCWSTR pwzName,
+    ICatalogCollection** ppiColl
+    );
+static HRESULT FindIndexedCollectionObject(
+    ICatalogCollection* piColl,
+    LPCWSTR pwzValue,
+    BOOL fName,
+    ICatalogObject** ppiObj
+    );
+static HRESULT EnsureSnapshotIndex(
+    CPI_COLLECTION_SNAPSHOT* pSnapshot
+    );
+static HRESULT FindSnapshot(
+    ICatalogCollection* piColl,
+    BOOL fCreate,
+    CPI_COLLECTION_SNAPSHOT** ppSnapshot
+    );
+static void InvalidateSnapshots(
+    LPCWSTR pwzName
+    );
+static BOOL PathHasSegment(
+    LPCWSTR pwzPath,
+    LPCWSTR pwzSegment
+    );
+static void ResetSnapshotIndex(
+    CPI_COLLECTION_SNAPSHOT* pSnapshot
+    );
+static void RemoveSnapshot(
+    DWORD iSnapshot
+    );
 
 
 // variables
 
 static ICOMAdminCatalog* gpiCatalog;
+static CPI_COLLECTION_SNAPSHOT** grgpSnapshots;
+static DWORD gcSnapshots;
 
 
 // function definitions
@@ -73,11 +157,14 @@ void CpiExecInitialize()
 {
     // collections
     gpiCatalog = NULL;
+    grgpSnapshots = NULL;
+    gcSnapshots = 0;
 }
 
 void CpiExecFinalize()
 {
     // collections
+    CpiExecInvalidateCollections();
     ReleaseObject(gpiCatalog);
 }
 
@@ -380,6 +467,45 @@ LExit:
     return hr;
 }
 
+HRESULT CpiExecSaveChanges(
+    ICatalogCollection* piColl,
+    long* plChanges
+    )
+{
+    HRESULT hr = S_OK;
+
+    VARIANT vtName;
+    ::VariantInit(&vtName);
+
+    // get collection name, used to find the snapshots that are invalidated by the save
+    hr = piColl->get_Name(&vtName);
+    if (SUCCEEDED(hr))
+        hr = ::VariantChangeType(&vtName, &vtName, 0, VT_BSTR);
+    if (FAILED(hr))
+        ::VariantClear(&vtName); // unknown collection, invalidate all snapshots
+
+    // save changes
+    hr = piColl->SaveChanges(plChanges);
+    if (COMADMIN_E_OBJECTERRORS == hr)
+        CpiLogCatalogErrorInfo();
+    ExitOnFailure(hr, "Failed to save changes");
+
+LExit:
+    // invalidate snapshots even if the save failed, the catalog may have been partially changed
+    InvalidateSnapshots(VT_BSTR == vtName.vt ? vtName.bstrVal : NULL);
+
+    ::VariantClear(&vtName);
+
+    return hr;
+}
+
+void CpiExecInvalidateCollections()
+{
+    InvalidateSnapshots(NULL);
+
+    ReleaseNullMem(grgpSnapshots);
+}
+
 HRESULT CpiAddCollectionObject(
     ICatalogCollection* piColl,
     ICatalogObject** ppiObj
@@ -388,10 +514,15 @@ HRESULT CpiAddCollectionObject(
     HRESULT hr = S_OK;
 
     IDispatch* piDisp = NULL;
+    CPI_COLLECTION_SNAPSHOT* pSnapshot = NULL;
 
     hr = piColl->Add(&piDisp);
     ExitOnFailure(hr, "Failed to add object to collection");
 
+    // item positions changed, the index is rebuilt on the next lookup
+    if (S_OK == FindSnapshot(piColl, FALSE, &pSnapshot))
+        ResetSnapshotIndex(pSnapshot);
+
     hr = piDisp->QueryInterface(IID_ICatalogObject, (void**)ppiObj);
     ExitOnFailure(hr, "Failed to get IID_ICatalogObject interface");
 
@@ -533,9 +664,7 @@ HRESULT CpiResetObjectProperty(
         ExitOnFailure(hr, "Failed to get property value");
 
         // save changes
-        hr = piColl->SaveChanges(&lChanges);
-        if (COMADMIN_E_OBJECTERRORS == hr)
-            CpiLogCatalogErrorInfo();
+        hr = CpiExecSaveChanges(piColl, &lChanges);
         ExitOnFailure(hr, "Failed to save changes");
     }
 
@@ -560,6 +689,7 @@ HRESULT CpiRemoveCollectionObject(
 
     IDispatch* piDisp = NULL;
     ICatalogObject* piObj = NULL;
+    CPI_COLLECTION_SNAPSHOT* pSnapshot = NULL;
 
     BOOL fMatch = FALSE;
 
@@ -621,6 +751,9 @@ HRESULT CpiRemoveCollectionObject(
 
             hr = piColl->Remove(i);
             ExitOnFailure(hr, "Failed to remove item from collection");
+
+            if (S_OK == FindSnapshot(piColl, FALSE, &pSnapshot))
+                ResetSnapshotIndex(pSnapshot);
             break;
         }
 
@@ -649,6 +782,7 @@ HRESULT CpiRemoveUserCollectionObject(
     HRESULT hr = S_OK;
 
     int i = 0;
+    CPI_COLLECTION_SNAPSHOT* pSnapshot = NULL;
 
     // find index
     hr = FindUserCollectionObjectIndex(piColl, pSid, &i);
@@ -661,6 +795,9 @@ HRESULT CpiRemoveUserCollectionObject(
     hr = piColl->Remove(i);
     ExitOnFailure(hr, "Failed to remove object from collection");
 
+    if (S_OK == FindSnapshot(piColl, FALSE, &pSnapshot))
+        ResetSnapshotIndex(pSnapshot);
+
     hr = S_OK;
 
 LExit:
@@ -675,58 +812,10 @@ HRESULT CpiFindCollectionObjectByStringKey(
 {
     HRESULT hr = S_OK;
 
-    IDispatch* piDisp = NULL;
-    ICatalogObject* piObj = NULL;
-
-    VARIANT vtVal;
-    ::VariantInit(&vtVal);
-
-    long lCnt;
-    hr = piColl->get_Count(&lCnt);
-    ExitOnFailure(hr, "Failed to get to number of items in collection");
-
-    for (long i = 0; i < lCnt; i++)
-    {
-        // get ICatalogObject interface
-        hr = piColl->get_Item(i, &piDisp);
-        ExitOnFailure(hr, "Failed to get object from collection");
-
-        hr = piDisp->QueryInterface(IID_ICatalogObject, (void**)&piObj);
-        ExitOnFailure(hr, "Failed to get IID_ICatalogObject interface");
-
-        // compare key
-        hr = piObj->get_Key(&vtVal);
-        ExitOnFailure(hr, "Failed to get key");
-
-        hr = ::VariantChangeType(&vtVal, &vtVal, 0, VT_BSTR);
-        ExitOnFailure(hr, "Failed to change variant type");
-
-        if (0 == lstrcmpiW(vtVal.bstrVal, pwzKey))
-        {
-            if (ppiObj)
-            {
-                *ppiObj = piObj;
-                piObj = NULL;
-            }
-            ExitFunction1(hr = S_OK);
-        }
-
-        // clean up
-        ReleaseNullObject(piDisp);
-        ReleaseNullObject(piObj);
-
-        ::VariantClear(&vtVal);
-    }
-
-    hr = S_FALSE;
+    hr = FindIndexedCollectionObject(piColl, pwzKey, FALSE, ppiObj);
+    ExitOnFailure(hr, "Failed to find collection object by key");
 
 LExit:
-    // clean up
-    ReleaseObject(piDisp);
-    ReleaseObject(piObj);
-
-    ::VariantClear(&vtVal);
-
     return hr;
 }
 
@@ -738,58 +827,16 @@ HRESULT CpiFindCollectionObjectByIntegerKey(
 {
     HRESULT hr = S_OK;
 
-    IDispatch* piDisp = NULL;
-    ICatalogObject* piObj = NULL;
-
-    VARIANT vtVal;
-    ::VariantInit(&vtVal);
-
-    long lCnt;
-    hr = piColl->get_Count(&lCnt);
-    ExitOnFailure(hr, "Failed to get to number of items in collection");
-
-    for (long i = 0; i < lCnt; i++)
-    {
-        // get ICatalogObject interface
-        hr = piColl->get_Item(i, &piDisp);
-        ExitOnFailure(hr, "Failed to get object from collection");
-
-        hr = piDisp->QueryInterface(IID_ICatalogObject, (void**)&piObj);
-        ExitOnFailure(hr, "Failed to get IID_ICatalogObject interface");
-
-        // compare key
-        hr = piObj->get_Key(&vtVal);
-        ExitOnFailure(hr, "Failed to get key");
-
-        hr = ::VariantChangeType(&vtVal, &vtVal, 0, VT_I4);
-        ExitOnFailure(hr, "Failed to change variant type");
-
-        if (vtVal.lVal == lKey)
-        {
-            if (ppiObj)
-            {
-                *ppiObj = piObj;
-                piObj = NULL;
-            }
-            ExitFunction1(hr = S_OK);
-        }
-
-        // clean up
-        ReleaseNullObject(piDisp);
-        ReleaseNullObject(piObj);
+    WCHAR wzKey[12];
 
-        ::VariantClear(&vtVal);
-    }
+    // integer keys are indexed by their string form
+    hr = ::StringCchPrintfW(wzKey, countof(wzKey), L"%d", lKey);
+    ExitOnFailure(hr, "Failed to format key");
 
-    hr = S_FALSE;
+    hr = FindIndexedCollectionObject(piColl, wzKey, FALSE, ppiObj);
+    ExitOnFailure(hr, "Failed to find collection object by key");
 
 LExit:
-    // clean up
-    ReleaseObject(piDisp);
-    ReleaseObject(piObj);
-
-    ::VariantClear(&vtVal);
-
     return hr;
 }
 
@@ -801,58 +848,10 @@ HRESULT CpiFindCollectionObjectByName(
 {
     HRESULT hr = S_OK;
 
-    IDispatch* piDisp = NULL;
-    ICatalogObject* piObj = NULL;
-
-    VARIANT vtVal;
-    ::VariantInit(&vtVal);
-
-    long lCnt;
-    hr = piColl->get_Count(&lCnt);
-    ExitOnFailure(hr, "Failed to get to number of items in collection");
-
-    for (long i = 0; i < lCnt; i++)
-    {
-        // get ICatalogObject interface
-        hr = piColl->get_Item(i, &piDisp);
-        ExitOnFailure(hr, "Failed to get object from collection");
-
-        hr = piDisp->QueryInterface(IID_ICatalogObject, (void**)&piObj);
-        ExitOnFailure(hr, "Failed to get IID_ICatalogObject interface");
-
-        // compare key
-        hr = piObj->get_Name(&vtVal);
-        ExitOnFailure(hr, "Failed to get key");
-
-        hr = ::VariantChangeType(&vtVal, &vtVal, 0, VT_BSTR);
-        ExitOnFailure(hr, "Failed to change variant type");
-
-        if (0 == lstrcmpW(vtVal.bstrVal, pwzName))
-        {
-            if (ppiObj)
-            {
-                *ppiObj = piObj;
-                piObj = NULL;
-            }
-            ExitFunction1(hr = S_OK);
-        }
-
-        // clean up
-        ReleaseNullObject(piDisp);
-        ReleaseNullObject(piObj);
-
-        ::VariantClear(&vtVal);
-    }
-
-    hr = S_FALSE;
+    hr = FindIndexedCollectionObject(piColl, pwzName, TRUE, ppiObj);
+    ExitOnFailure(hr, "Failed to find collection object by name");
 
 LExit:
-    // clean up
-    ReleaseObject(piDisp);
-    ReleaseObject(piObj);
-
-    ::VariantClear(&vtVal);
-
     return hr;
 }
 
@@ -917,34 +916,10 @@ HRESULT CpiGetPartitionRolesCollection(
 {
     HRESULT hr = S_OK;
 
-    ICatalogCollection* piPartColl = NULL;
-    ICatalogObject* piPartObj = NULL;
-
-    // get partitions collection
-    hr = CpiExecGetPartitionsCollection(&piPartColl);
-    ExitOnFailure(hr, "Failed to get partitions collection");
-
-    if (S_FALSE == hr)
-        ExitFunction(); // partitions collection not found, exit with hr = S_FALSE
-
-    // find object
-    hr = CpiFindCollectionObjectByStringKey(piPartColl, pwzPartID, &piPartObj);
-    ExitOnFailure(hr, "Failed to find collection object");
-
-    if (S_FALSE == hr)
-        ExitFunction(); // partition not found, exit with hr = S_FALSE
-
-    // get roles collection
-    hr = CpiExecGetCatalogCollection(piPartColl, piPartObj, L"RolesForPartition", ppiRolesColl);
-    ExitOnFailure(hr, "Failed to get catalog collection");
-
-    hr = S_OK;
+    hr = GetPartitionRolesCollection(pwzPartID, FALSE, ppiRolesColl);
+    ExitOnFailure(hr, "Failed to get partition roles collection");
 
 LExit:
-    // clean up
-    ReleaseObject(piPartColl);
-    ReleaseObject(piPartObj);
-
     return hr;
 }
 
@@ -960,7 +935,7 @@ HRESULT CpiGetUsersInPartitionRoleCollection(
     ICatalogObject* piRoleObj = NULL;
 
     // get roles collection
-    hr = CpiGetPartitionRolesCollection(pwzPartID, &piRoleColl);
+    hr = GetPartitionRolesCollection(pwzPartID, TRUE, &piRoleColl);
     ExitOnFailure(hr, "Failed to get roles collection");
 
     if (S_FALSE == hr)
@@ -1010,113 +985,27 @@ HRESULT CpiExecGetApplicationsCollection(
 {
     HRESULT hr = S_OK;
 
-    ICOMAdminCatalog* piCatalog = NULL;
-    ICOMAdminCatalog2* piCatalog2 = NULL;
-    BSTR bstrGlobPartID = NULL;
-
-    ICatalogCollection* piPartColl = NULL;
-    ICatalogObject* piPartObj = NULL;
+    hr = GetApplicationsCollection(pwzPartID, FALSE, ppiAppColl, NULL);
+    ExitOnFailure(hr, "Failed to get applications collection");
 
-    // get catalog
-    hr = CpiExecGetAdminCatalog(&piCatalog);
-    ExitOnFailure(hr, "Failed to get COM+ admin catalog");
+LExit:
+    return hr;
+}
 
-    // get ICOMAdminCatalog2 interface
-    hr = piCatalog->QueryInterface(IID_ICOMAdminCatalog2, (void**)&piCatalog2);
+HRESULT CpiGetRolesCollection(
+    LPCWSTR pwzPartID,
+    LPCWSTR pwzAppID,
+    ICatalogCollection** ppiRolesColl
+    )
+{
+    HRESULT hr = S_OK;
 
-    // COM+ 1.5 or later
-    if (E_NOINTERFACE != hr)
-    {
-        ExitOnFailure(hr, "Failed to get IID_ICOMAdminCatalog2 interface");
+    hr = GetApplicationChildCollection(pwzPartID, pwzAppID, L"Roles", FALSE, ppiRolesColl);
+    ExitOnFailure(hr, "Failed to get roles collection");
 
-        // partition id
-        if (!pwzPartID || !*pwzPartID)
-        {
-            // get global partition id
-            hr = piCatalog2->get_GlobalPartitionID(&bstrGlobPartID);
-            ExitOnFailure(hr, "Failed to get global partition id");
-        }
-
-        // get partitions collection
-        hr = CpiExecGetPartitionsCollection(&piPartColl);
-        ExitOnFailure(hr, "Failed to get partitions collection");
-
-        // find object
-        hr = CpiFindCollectionObjectByStringKey(piPartColl, bstrGlobPartID ? bstrGlobPartID : pwzPartID, &piPartObj);
-        ExitOnFailure(hr, "Failed to find collection object");
-
-        if (S_FALSE == hr)
-            ExitFunction(); // partition not found, exit with hr = S_FALSE
-
-        // get applications collection
-        hr = CpiExecGetCatalogCollection(piPartColl, piPartObj, L"Applications", ppiAppColl);
-        ExitOnFailure(hr, "Failed to get catalog collection for partition");
-    }
-
-    // COM+ pre 1.5
-    else
-    {
-        // this version of COM+ does not support partitions, make sure a partition was not specified
-        if (pwzPartID && *pwzPartID)
-            ExitOnFailure(hr = E_FAIL, "Partitions are not supported by this version of COM+");
-
-        // get applications collection
-        hr = CpiExecGetCatalogCollection(L"Applications", ppiAppColl);
-        ExitOnFailure(hr, "Failed to get catalog collection");
-    }
-
-    hr = S_OK;
-
-LExit:
-    // clean up
-    ReleaseObject(piCatalog);
-    ReleaseObject(piCatalog2);
-    ReleaseBSTR(bstrGlobPartID);
-
-    ReleaseObject(piPartColl);
-    ReleaseObject(piPartObj);
-
-    return hr;
-}
-
-HRESULT CpiGetRolesCollection(
-    LPCWSTR pwzPartID,
-    LPCWSTR pwzAppID,
-    ICatalogCollection** ppiRolesColl
-    )
-{
-    HRESULT hr = S_OK;
-
-    ICatalogCollection* piAppColl = NULL;
-    ICatalogObject* piAppObj = NULL;
-
-    // get applications collection
-    hr = CpiExecGetApplicationsCollection(pwzPartID, &piAppColl);
-    ExitOnFailure(hr, "Failed to get applications collection");
-
-    if (S_FALSE == hr)
-        ExitFunction(); // applications collection not found, exit with hr = S_FALSE
-
-    // find object
-    hr = CpiFindCollectionObjectByStringKey(piAppColl, pwzAppID, &piAppObj);
-    ExitOnFailure(hr, "Failed to find collection object");
-
-    if (S_FALSE == hr)
-        ExitFunction(); // application not found, exit with hr = S_FALSE
-
-    // get roles collection
-    hr = CpiExecGetCatalogCollection(piAppColl, piAppObj, L"Roles", ppiRolesColl);
-    ExitOnFailure(hr, "Failed to catalog collection");
-
-    hr = S_OK;
-
-LExit:
-    // clean up
-    ReleaseObject(piAppColl);
-    ReleaseObject(piAppObj);
-
-    return hr;
-}
+LExit:
+    return hr;
+}
 
 HRESULT CpiGetUsersInRoleCollection(
     LPCWSTR pwzPartID,
@@ -1131,7 +1020,7 @@ HRESULT CpiGetUsersInRoleCollection(
     ICatalogObject* piRoleObj = NULL;
 
     // get roles collection
-    hr = CpiGetRolesCollection(pwzPartID, pwzAppID, &piRoleColl);
+    hr = GetApplicationChildCollection(pwzPartID, pwzAppID, L"Roles", TRUE, &piRoleColl);
     ExitOnFailure(hr, "Failed to get roles collection");
 
     if (S_FALSE == hr)
@@ -1166,34 +1055,10 @@ HRESULT CpiGetComponentsCollection(
 {
     HRESULT hr = S_OK;
 
-    ICatalogCollection* piAppColl = NULL;
-    ICatalogObject* piAppObj = NULL;
-
-    // get applications collection
-    hr = CpiExecGetApplicationsCollection(pwzPartID, &piAppColl);
-    ExitOnFailure(hr, "Failed to get applications collection");
-
-    if (S_FALSE == hr)
-        ExitFunction(); // applications collection not found, exit with hr = S_FALSE
-
-    // find object
-    hr = CpiFindCollectionObjectByStringKey(piAppColl, pwzAppID, &piAppObj);
-    ExitOnFailure(hr, "Failed to find collection object");
-
-    if (S_FALSE == hr)
-        ExitFunction(); // application not found, exit with hr = S_FALSE
-
-    // get components collection
-    hr = CpiExecGetCatalogCollection(piAppColl, piAppObj, L"Components", ppiCompsColl);
-    ExitOnFailure(hr, "Failed to get catalog collection");
-
-    hr = S_OK;
+    hr = GetApplicationChildCollection(pwzPartID, pwzAppID, L"Components", FALSE, ppiCompsColl);
+    ExitOnFailure(hr, "Failed to get components collection");
 
 LExit:
-    // clean up
-    ReleaseObject(piAppColl);
-    ReleaseObject(piAppObj);
-
     return hr;
 }
 
@@ -1246,7 +1111,7 @@ HRESULT CpiGetSubscriptionsCollection(
     ICatalogObject* piCompObj = NULL;
 
     // get components collection
-    hr = CpiGetComponentsCollection(pwzPartID, pwzAppID, &piCompColl);
+    hr = GetApplicationChildCollection(pwzPartID, pwzAppID, L"Components", TRUE, &piCompColl);
     ExitOnFailure(hr, "Failed to get components collection");
 
     if (S_FALSE == hr)
@@ -1879,3 +1744,583 @@ static HRESULT ReadFileAll(
 LExit:
     return hr;
 }
+
+static HRESULT GetPartitionRolesCollection(
+    LPCWSTR pwzPartID,
+    BOOL fSnapshot,
+    ICatalogCollection** ppiRolesColl
+    )
+{
+    HRESULT hr = S_OK;
+
+    ICatalogCollection* piPartColl = NULL;
+    ICatalogObject* piPartObj = NULL;
+
+    // get partitions collection
+    hr = GetCollection(NULL, NULL, NULL, NULL, L"Partitions", TRUE, &piPartColl, NULL);
+    ExitOnFailure(hr, "Failed to get partitions collection");
+
+    // find object
+    hr = CpiFindCollectionObjectByStringKey(piPartColl, pwzPartID, &piPartObj);
+    ExitOnFailure(hr, "Failed to find collection object");
+
+    if (S_FALSE == hr)
+        ExitFunction(); // partition not found, exit with hr = S_FALSE
+
+    // get roles collection
+    hr = GetCollection(L"Partitions", piPartColl, piPartObj, pwzPartID, L"RolesForPartition", fSnapshot, ppiRolesColl, NULL);
+    ExitOnFailure(hr, "Failed to get catalog collection");
+
+    hr = S_OK;
+
+LExit:
+    // clean up
+    ReleaseObject(piPartColl);
+    ReleaseObject(piPartObj);
+
+    return hr;
+}
+
+static HRESULT GetApplicationsCollection(
+    LPCWSTR pwzPartID,
+    BOOL fSnapshot,
+    ICatalogCollection** ppiAppColl,
+    LPWSTR* ppwzPath
+    )
+{
+    HRESULT hr = S_OK;
+
+    ICOMAdminCatalog* piCatalog = NULL;
+    ICOMAdminCatalog2* piCatalog2 = NULL;
+    BSTR bstrGlobPartID = NULL;
+
+    ICatalogCollection* piPartColl = NULL;
+    ICatalogObject* piPartObj = NULL;
+
+    // get catalog
+    hr = CpiExecGetAdminCatalog(&piCatalog);
+    ExitOnFailure(hr, "Failed to get COM+ admin catalog");
+
+    // get ICOMAdminCatalog2 interface
+    hr = piCatalog->QueryInterface(IID_ICOMAdminCatalog2, (void**)&piCatalog2);
+
+    // COM+ 1.5 or later
+    if (E_NOINTERFACE != hr)
+    {
+        ExitOnFailure(hr, "Failed to get IID_ICOMAdminCatalog2 interface");
+
+        // partition id
+        if (!pwzPartID || !*pwzPartID)
+        {
+            // get global partition id
+            hr = piCatalog2->get_GlobalPartitionID(&bstrGlobPartID);
+            ExitOnFailure(hr, "Failed to get global partition id");
+
+            pwzPartID = bstrGlobPartID;
+        }
+
+        // get partitions collection
+        hr = GetCollection(NULL, NULL, NULL, NULL, L"Partitions", TRUE, &piPartColl, NULL);
+        ExitOnFailure(hr, "Failed to get partitions collection");
+
+        // find object
+        hr = CpiFindCollectionObjectByStringKey(piPartColl, pwzPartID, &piPartObj);
+        ExitOnFailure(hr, "Failed to find collection object");
+
+        if (S_FALSE == hr)
+            ExitFunction(); // partition not found, exit with hr = S_FALSE
+
+        // get applications collection
+        hr = GetCollection(L"Partitions", piPartColl, piPartObj, pwzPartID, L"Applications", fSnapshot, ppiAppColl, ppwzPath);
+        ExitOnFailure(hr, "Failed to get catalog collection for partition");
+    }
+
+    // COM+ pre 1.5
+    else
+    {
+        // this version of COM+ does not support partitions, make sure a partition was not specified
+        if (pwzPartID && *pwzPartID)
+            ExitOnFailure(hr = E_FAIL, "Partitions are not supported by this version of COM+");
+
+        // get applications collection
+        hr = GetCollection(NULL, NULL, NULL, NULL, L"Applications", fSnapshot, ppiAppColl, ppwzPath);
+        ExitOnFailure(hr, "Failed to get catalog collection");
+    }
+
+    hr = S_OK;
+
+LExit:
+    // clean up
+    ReleaseObject(piCatalog);
+    ReleaseObject(piCatalog2);
+    ReleaseBSTR(bstrGlobPartID);
+
+    ReleaseObject(piPartColl);
+    ReleaseObject(piPartObj);
+
+    return hr;
+}
+
+static HRESULT GetApplicationChildCollection(
+    LPCWSTR pwzPartID,
+    LPCWSTR pwzAppID,
+    LPCWSTR pwzName,
+    BOOL fSnapshot,
+    ICatalogCollection** ppiColl
+    )
+{
+    HRESULT hr = S_OK;
+
+    ICatalogCollection* piAppColl = NULL;
+    ICatalogObject* piAppObj = NULL;
+    LPWSTR pwzAppPath = NULL;
+
+    // get applications collection
+    hr = GetApplicationsCollection(pwzPartID, TRUE, &piAppColl, &pwzAppPath);
+    ExitOnFailure(hr, "Failed to get applications collection");
+
+    if (S_FALSE == hr)
+        ExitFunction(); // applications collection not found, exit with hr = S_FALSE
+
+    // find object
+    hr = CpiFindCollectionObjectByStringKey(piAppColl, pwzAppID, &piAppObj);
+    ExitOnFailure(hr, "Failed to find collection object");
+
+    if (S_FALSE == hr)
+        ExitFunction(); // application not found, exit with hr = S_FALSE
+
+    // get child collection
+    hr = GetCollection(pwzAppPath, piAppColl, piAppObj, pwzAppID, pwzName, fSnapshot, ppiColl, NULL);
+    ExitOnFailure(hr, "Failed to get catalog collection, name: %S", pwzName);
+
+    hr = S_OK;
+
+LExit:
+    // clean up
+    ReleaseObject(piAppColl);
+    ReleaseObject(piAppObj);
+    ReleaseStr(pwzAppPath);
+
+    return hr;
+}
+
+static HRESULT GetCollection(
+    LPCWSTR pwzParentPath,
+    ICatalogCollection* piParentColl,
+    ICatalogObject* piParentObj,
+    LPCWSTR pwzParentKey,
+    LPCWSTR pwzName,
+    BOOL fSnapshot,
+    ICatalogCollection** ppiColl,
+    LPWSTR* ppwzPath
+    )
+{
+    HRESULT hr = S_OK;
+
+    LPWSTR pwzPath = NULL;
+
+    // catalog path, i.e. Partitions\{partition id}\Applications\{application id}\Components
+    if (pwzParentPath)
+        hr = StrAllocFormatted(&pwzPath, L"%s\\%s\\%s", pwzParentPath, pwzParentKey, pwzName);
+    else
+        hr = StrAllocString(&pwzPath, pwzName, 0);
+    ExitOnFailure(hr, "Failed to format collection path");
+
+    if (fSnapshot)
+    {
+        // shared read-only snapshot, callers that modify the catalog always get a freshly populated collection
+        hr = GetCollectionSnapshot(pwzPath, piParentColl, piParentObj, pwzName, ppiColl);
+        ExitOnFailure(hr, "Failed to get collection snapshot, path: %S", pwzPath);
+    }
+    else if (piParentColl)
+    {
+        hr = CpiExecGetCatalogCollection(piParentColl, piParentObj, pwzName, ppiColl);
+        ExitOnFailure(hr, "Failed to get catalog collection");
+    }
+    else
+    {
+        hr = CpiExecGetCatalogCollection(pwzName, ppiColl);
+        ExitOnFailure(hr, "Failed to get catalog collection");
+    }
+
+    if (ppwzPath)
+    {
+        *ppwzPath = pwzPath;
+        pwzPath = NULL;
+    }
+
+    hr = S_OK;
+
+LExit:
+    // clean up
+    ReleaseStr(pwzPath);
+
+    return hr;
+}
+
+static HRESULT GetCollectionSnapshot(
+    LPCWSTR pwzPath,
+    ICatalogCollection* piParentColl,
+    ICatalogObject* piParentObj,
+    LPCWSTR pwzName,
+    ICatalogCollection** ppiColl
+    )
+{
+    HRESULT hr = S_OK;
+
+    ICatalogCollection* piColl = NULL;
+    CPI_COLLECTION_SNAPSHOT* pSnapshot = NULL;
+
+    // populated earlier and not invalidated since
+    for (DWORD i = 0; i < gcSnapshots; ++i)
+    {
+        if (grgpSnapshots[i]->pwzPath && 0 == lstrcmpiW(grgpSnapshots[i]->pwzPath, pwzPath))
+        {
+            grgpSnapshots[i]->piColl->AddRef();
+            *ppiColl = grgpSnapshots[i]->piColl;
+            ExitFunction1(hr = S_OK);
+        }
+    }
+
+    // populate collection
+    if (piParentColl)
+        hr = CpiExecGetCatalogCollection(piParentColl, piParentObj, pwzName, &piColl);
+    else
+        hr = CpiExecGetCatalogCollection(pwzName, &piColl);
+    ExitOnFailure(hr, "Failed to get catalog collection");
+
+    hr = FindSnapshot(piColl, TRUE, &pSnapshot);
+    ExitOnFailure(hr, "Failed to add collection snapshot");
+
+    hr = StrAllocString(&pSnapshot->pwzPath, pwzPath, 0);
+    ExitOnFailure(hr, "Failed to copy collection path");
+
+    *ppiColl = piColl;
+    piColl = NULL;
+
+    hr = S_OK;
+
+LExit:
+    // clean up
+    ReleaseObject(piColl);
+
+    return hr;
+}
+
+static HRESULT FindIndexedCollectionObject(
+    ICatalogCollection* piColl,
+    LPCWSTR pwzValue,
+    BOOL fName,
+    ICatalogObject** ppiObj
+    )
+{
+    HRESULT hr = S_OK;
+
+    CPI_COLLECTION_SNAPSHOT* pSnapshot = NULL;
+    CPI_COLLECTION_ITEM* pItem = NULL;
+    IDispatch* piDisp = NULL;
+    ICatalogObject* piObj = NULL;
+
+    VARIANT vtVal;
+    ::VariantInit(&vtVal);
+
+    if (!pwzValue)
+        pwzValue = L"";
+
+    hr = FindSnapshot(piColl, TRUE, &pSnapshot);
+    ExitOnFailure(hr, "Failed to get collection snapshot");
+
+    // a stale hit causes the index to be rebuilt once
+    for (int iAttempt = 0; iAttempt < 2; ++iAttempt)
+    {
+        hr = EnsureSnapshotIndex(pSnapshot);
+        ExitOnFailure(hr, "Failed to index collection");
+
+        hr = DictGetValue(fName ? pSnapshot->shNames : pSnapshot->shKeys, pwzValue, (void**)&pItem);
+        if (E_NOTFOUND == hr)
+            ExitFunction1(hr = S_FALSE);
+        ExitOnFailure(hr, "Failed to look up collection index");
+
+        // get ICatalogObject interface
+        hr = piColl->get_Item(pItem->lIndex, &piDisp);
+        ExitOnFailure(hr, "Failed to get object from collection");
+
+        hr = piDisp->QueryInterface(IID_ICatalogObject, (void**)&piObj);
+        ExitOnFailure(hr, "Failed to get IID_ICatalogObject interface");
+
+        // make sure the object still matches, keys compare case insensitive and names case sensitive
+        hr = fName ? piObj->get_Name(&vtVal) : piObj->get_Key(&vtVal);
+        ExitOnFailure(hr, "Failed to get key");
+
+        hr = ::VariantChangeType(&vtVal, &vtVal, 0, VT_BSTR);
+        ExitOnFailure(hr, "Failed to change variant type");
+
+        if (0 == (fName ? lstrcmpW(vtVal.bstrVal, pwzValue) : lstrcmpiW(vtVal.bstrVal, pwzValue)))
+        {
+            if (ppiObj)
+            {
+                *ppiObj = piObj;
+                piObj = NULL;
+            }
+            ExitFunction1(hr = S_OK);
+        }
+
+        ResetSnapshotIndex(pSnapshot);
+
+        // clean up
+        ReleaseNullObject(piDisp);
+        ReleaseNullObject(piObj);
+
+        ::VariantClear(&vtVal);
+    }
+
+    hr = S_FALSE;
+
+LExit:
+    // clean up
+    ReleaseObject(piDisp);
+    ReleaseObject(piObj);
+
+    ::VariantClear(&vtVal);
+
+    return hr;
+}
+
+static HRESULT EnsureSnapshotIndex(
+    CPI_COLLECTION_SNAPSHOT* pSnapshot
+    )
+{
+    HRESULT hr = S_OK;
+
+    IDispatch* piDisp = NULL;
+    ICatalogObject* piObj = NULL;
+    CPI_COLLECTION_ITEM* pItem = NULL;
+
+    VARIANT vtVal;
+    ::VariantInit(&vtVal);
+
+    long lCnt;
+    hr = pSnapshot->piColl->get_Count(&lCnt);
+    ExitOnFailure(hr, "Failed to get to number of items in collection");
+
+    if (lCnt == pSnapshot->lCnt)
+        ExitFunction1(hr = S_OK); // index is current
+
+    ResetSnapshotIndex(pSnapshot);
+
+    if (lCnt)
+    {
+        pSnapshot->rgItems = (CPI_COLLECTION_ITEM*)MemAlloc(sizeof(CPI_COLLECTION_ITEM) * lCnt, TRUE);
+        ExitOnNull(pSnapshot->rgItems, hr, E_OUTOFMEMORY, "Failed to allocate collection index");
+
+        pSnapshot->cItems = lCnt;
+    }
+
+    hr = DictCreateWithEmbeddedKey(&pSnapshot->shKeys, lCnt, NULL, offsetof(CPI_COLLECTION_ITEM, pwzKey), DICT_FLAG_CASEINSENSITIVE);
+    ExitOnFailure(hr, "Failed to create collection key index");
+
+    hr = DictCreateWithEmbeddedKey(&pSnapshot->shNames, lCnt, NULL, offsetof(CPI_COLLECTION_ITEM, pwzName), DICT_FLAG_NONE);
+    ExitOnFailure(hr, "Failed to create collection name index");
+
+    for (long i = 0; i < lCnt; i++)
+    {
+        pItem = &pSnapshot->rgItems[i];
+        pItem->lIndex = i;
+
+        // get ICatalogObject interface
+        hr = pSnapshot->piColl->get_Item(i, &piDisp);
+        ExitOnFailure(hr, "Failed to get object from collection");
+
+        hr = piDisp->QueryInterface(IID_ICatalogObject, (void**)&piObj);
+        ExitOnFailure(hr, "Failed to get IID_ICatalogObject interface");
+
+        // key, the first of any duplicates is found just like the sequential search did
+        hr = piObj->get_Key(&vtVal);
+        ExitOnFailure(hr, "Failed to get key");
+
+        hr = ::VariantChangeType(&vtVal, &vtVal, 0, VT_BSTR);
+        ExitOnFailure(hr, "Failed to change variant type");
+
+        hr = StrAllocString(&pItem->pwzKey, vtVal.bstrVal ? vtVal.bstrVal : L"", 0);
+        ExitOnFailure(hr, "Failed to copy key");
+
+        hr = DictAddValue(pSnapshot->shKeys, pItem);
+        ExitOnFailure(hr, "Failed to index key");
+
+        ::VariantClear(&vtVal);
+
+        // name
+        hr = piObj->get_Name(&vtVal);
+        ExitOnFailure(hr, "Failed to get name");
+
+        hr = ::VariantChangeType(&vtVal, &vtVal, 0, VT_BSTR);
+        ExitOnFailure(hr, "Failed to change variant type");
+
+        hr = StrAllocString(&pItem->pwzName, vtVal.bstrVal ? vtVal.bstrVal : L"", 0);
+        ExitOnFailure(hr, "Failed to copy name");
+
+        hr = DictAddValue(pSnapshot->shNames, pItem);
+        ExitOnFailure(hr, "Failed to index name");
+
+        // clean up
+        ReleaseNullObject(piDisp);
+        ReleaseNullObject(piObj);
+
+        ::VariantClear(&vtVal);
+    }
+
+    pSnapshot->lCnt = lCnt;
+
+    hr = S_OK;
+
+LExit:
+    if (FAILED(hr))
+        ResetSnapshotIndex(pSnapshot);
+
+    // clean up
+    ReleaseObject(piDisp);
+    ReleaseObject(piObj);
+
+    ::VariantClear(&vtVal);
+
+    return hr;
+}
+
+static HRESULT FindSnapshot(
+    ICatalogCollection* piColl,
+    BOOL fCreate,
+    CPI_COLLECTION_SNAPSHOT** ppSnapshot
+    )
+{
+    HRESULT hr = S_OK;
+
+    CPI_COLLECTION_SNAPSHOT* pSnapshot = NULL;
+
+    VARIANT vtName;
+    ::VariantInit(&vtName);
+
+    for (DWORD i = 0; i < gcSnapshots; ++i)
+    {
+        if (grgpSnapshots[i]->piColl == piColl)
+        {
+            *ppSnapshot = grgpSnapshots[i];
+            ExitFunction1(hr = S_OK);
+        }
+    }
+
+    if (!fCreate)
+        ExitFunction1(hr = S_FALSE);
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&grgpSnapshots), gcSnapshots, 1, sizeof(CPI_COLLECTION_SNAPSHOT*), 16);
+    ExitOnFailure(hr, "Failed to grow collection snapshot list");
+
+    pSnapshot = (CPI_COLLECTION_SNAPSHOT*)MemAlloc(sizeof(CPI_COLLECTION_SNAPSHOT), TRUE);
+    ExitOnNull(pSnapshot, hr, E_OUTOFMEMORY, "Failed to allocate collection snapshot");
+
+    // the snapshot holds a reference so the collection pointer can not be reused while indexed
+    pSnapshot->piColl = piColl;
+    pSnapshot->piColl->AddRef();
+    pSnapshot->lCnt = -1;
+
+    // collection name, used to invalidate snapshots when the collection is saved
+    hr = piColl->get_Name(&vtName);
+    if (SUCCEEDED(hr))
+        hr = ::VariantChangeType(&vtName, &vtName, 0, VT_BSTR);
+
+    hr = StrAllocString(&pSnapshot->pwzName, SUCCEEDED(hr) && vtName.bstrVal ? vtName.bstrVal : L"", 0);
+    ExitOnFailure(hr, "Failed to copy collection name");
+
+    grgpSnapshots[gcSnapshots] = pSnapshot;
+    ++gcSnapshots;
+
+    *ppSnapshot = pSnapshot;
+    pSnapshot = NULL;
+
+    hr = S_OK;
+
+LExit:
+    // clean up
+    if (pSnapshot)
+    {
+        ReleaseObject(pSnapshot->piColl);
+        MemFree(pSnapshot);
+    }
+
+    ::VariantClear(&vtName);
+
+    return hr;
+}
+
+static void InvalidateSnapshots(
+    LPCWSTR pwzName
+    )
+{
+    DWORD i = 0;
+
+    while (i < gcSnapshots)
+    {
+        CPI_COLLECTION_SNAPSHOT* pSnapshot = grgpSnapshots[i];
+
+        // drop the saved collections and every snapshot populated beneath them, NULL drops all
+        if (!pwzName || !*pwzName || 0 == lstrcmpiW(pSnapshot->pwzName, pwzName) || PathHasSegment(pSnapshot->pwzPath, pwzName))
+            RemoveSnapshot(i);
+        else
+            ++i;
+    }
+}
+
+static BOOL PathHasSegment(
+    LPCWSTR pwzPath,
+    LPCWSTR pwzSegment
+    )
+{
+    size_t cchSegment = lstrlenW(pwzSegment);
+
+    for (LPCWSTR pwz = pwzPath; pwz && *pwz; )
+    {
+        LPCWSTR pwzEnd = wcschr(pwz, L'\\');
+        size_t cch = pwzEnd ? (size_t)(pwzEnd - pwz) : lstrlenW(pwz);
+
+        if (cch == cchSegment && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, pwz, (int)cch, pwzSegment, (int)cchSegment))
+            return TRUE;
+
+        pwz = pwzEnd ? pwzEnd + 1 : NULL;
+    }
+
+    return FALSE;
+}
+
+static void ResetSnapshotIndex(
+    CPI_COLLECTION_SNAPSHOT* pSnapshot
+    )
+{
+    ReleaseNullDict(pSnapshot->shKeys);
+    ReleaseNullDict(pSnapshot->shNames);
+
+    for (long i = 0; i < pSnapshot->cItems; i++)
+    {
+        ReleaseStr(pSnapshot->rgItems[i].pwzKey);
+        ReleaseStr(pSnapshot->rgItems[i].pwzName);
+    }
+    ReleaseNullMem(pSnapshot->rgItems);
+
+    pSnapshot->cItems = 0;
+    pSnapshot->lCnt = -1;
+}
+
+static void RemoveSnapshot(
+    DWORD iSnapshot
+    )
+{
+    CPI_COLLECTION_SNAPSHOT* pSnapshot = grgpSnapshots[iSnapshot];
+
+    ResetSnapshotIndex(pSnapshot);
+    ReleaseObject(pSnapshot->piColl);
+    ReleaseStr(pSnapshot->pwzName);
+    ReleaseStr(pSnapshot->pwzPath);
+    MemFree(pSnapshot);
+
+    // order does not matter, move the last snapshot into the hole
+    --gcSnapshots;
+    grgpSnapshots[iSnapshot] = grgpSnapshots[gcSnapshots];
+}
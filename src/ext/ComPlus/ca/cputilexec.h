@@ -52,6 +52,11 @@ HRESULT CpiExecGetCatalogCollection(
     LPCWSTR pwzName,
     ICatalogCollection** ppiColl
     );
+HRESULT CpiExecSaveChanges(
+    ICatalogCollection* piColl,
+    long* plChanges
+    );
+void CpiExecInvalidateCollections();
 HRESULT CpiAddCollectionObject(
     ICatalogCollection* piColl,
     ICatalogObject** ppiObj
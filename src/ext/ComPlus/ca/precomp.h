@@ -11,6 +11,7 @@
 
 #include "wcautil.h"
 #include "memutil.h"
+#include "dictutil.h"
 #include "strutil.h"
 #include "wiutil.h"
 
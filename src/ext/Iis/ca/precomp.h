@@ -23,6 +23,7 @@
 
 #include "certutil.h"
 #include "cryputil.h"
+#include "dictutil.h"
 #include "fileutil.h"
 #include "iis7util.h"
 #include "memutil.h"
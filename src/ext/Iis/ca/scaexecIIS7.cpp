@@ -254,6 +254,79 @@ static void ConvSecToDHMS(
     size_t cchDest
     );
 
+// Sites and applications are looked up by key for nearly every action while
+// the config changes are applied. Instead of walking the whole collection for
+// each lookup, remember the position of every element in its collection and
+// only check the element at that position still has the key.
+struct SCA_IIS7_INDEX_ENTRY
+{
+    LPWSTR sczKey;
+    DWORD dwPosition;
+};
+
+struct SCA_IIS7_ELEMENT_INDEX
+{
+    STRINGDICT_HANDLE sdhEntries;
+    SCA_IIS7_INDEX_ENTRY* rgEntries;
+    DWORD cEntries;
+    DWORD cElements; // size of the collection when it was indexed.
+};
+
+struct SCA_IIS7_SITE_APPLICATIONS
+{
+    LPWSTR sczSiteName;
+    SCA_IIS7_ELEMENT_INDEX applications;
+};
+
+struct SCA_IIS7_TRANSACTION_INDEX
+{
+    SCA_IIS7_ELEMENT_INDEX sites;
+
+    STRINGDICT_HANDLE sdhSiteApplications;
+    SCA_IIS7_SITE_APPLICATIONS** rgpSiteApplications;
+    DWORD cSiteApplications;
+
+    DWORD cLookups;
+    DWORD cIndexHits;
+    DWORD cIndexBuilds;
+};
+
+static SCA_IIS7_TRANSACTION_INDEX vTransactionIndex = { };
+
+static HRESULT FindIndexedElement(
+    __in IAppHostElementCollection *pCollection,
+    __in SCA_IIS7_ELEMENT_INDEX* pIndex,
+    __in LPCWSTR pwzElementName,
+    __in LPCWSTR pwzAttributeName,
+    __in LPCWSTR pwzKey,
+    __out IAppHostElement **ppElement
+    );
+static HRESULT BuildElementIndex(
+    __in IAppHostElementCollection *pCollection,
+    __in DWORD cElements,
+    __in LPCWSTR pwzElementName,
+    __in LPCWSTR pwzAttributeName,
+    __in SCA_IIS7_ELEMENT_INDEX* pIndex
+    );
+static HRESULT AddElementIndexEntry(
+    __in SCA_IIS7_ELEMENT_INDEX* pIndex,
+    __in LPCWSTR pwzKey,
+    __in DWORD dwPosition
+    );
+static HRESULT NoteIndexedElementAdded(
+    __in SCA_IIS7_ELEMENT_INDEX* pIndex,
+    __in LPCWSTR pwzKey
+    );
+static void ReleaseElementIndex(
+    __in SCA_IIS7_ELEMENT_INDEX* pIndex
+    );
+static HRESULT GetSiteApplicationIndex(
+    __in_opt IAppHostElement *pSiteElement,
+    __in_opt LPCWSTR pwzSiteName,
+    __out SCA_IIS7_ELEMENT_INDEX** ppIndex
+    );
+static void ResetTransactionIndex();
+
 ////////////////////////////////////////////////////////////////////
 // ScopeBSTR: Local helper class to construct & free BSTR from LPWSTR
 //
@@ -488,6 +561,7 @@ HRESULT IIS7ConfigChanges(MSIHANDLE /*hInstall*/, __inout LPWSTR pwzData)
 
                 // Throw away the changes since IIS has no way to remove uncommited changes from an AdminManager.
                 ReleaseNullObject(pAdminMgr);
+                ResetTransactionIndex();
 
                 // Restore our CA data backup
                 pwz = pwzLast;
@@ -516,6 +590,12 @@ HRESULT IIS7ConfigChanges(MSIHANDLE /*hInstall*/, __inout LPWSTR pwzData)
         hr = S_OK;
     }
 LExit:
+    WcaLog(LOGMSG_VERBOSE, "IIS7 element index: %u lookups, %u answered from the index, %u collections indexed.", vTransactionIndex.cLookups, vTransactionIndex.cIndexHits, vTransactionIndex.cIndexBuilds);
+    ResetTransactionIndex();
+    vTransactionIndex.cLookups = 0;
+    vTransactionIndex.cIndexHits = 0;
+    vTransactionIndex.cIndexBuilds = 0;
+
     ReleaseObject(pAdminMgr);
     ReleaseStr(pwzBackup);
 
@@ -1820,6 +1900,7 @@ HRESULT IIS7Site(
     IAppHostElementCollection *pCollection = NULL;
     IAppHostElement *pSiteElem = NULL;
     IAppHostElement *pElement = NULL;
+    SCA_IIS7_ELEMENT_INDEX* pAppIndex = NULL;
 
     // Get site action
     hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iAction);
@@ -1847,6 +1928,13 @@ HRESULT IIS7Site(
             {
                 hr = DeleteCollectionElement(pCollection, IIS_CONFIG_SITE, IIS_CONFIG_NAME, pwzSiteName);
                 ExitOnFailure(hr, "Failed to delete website");
+
+                ReleaseElementIndex(&vTransactionIndex.sites);
+
+                hr = GetSiteApplicationIndex(NULL, pwzSiteName, &pAppIndex);
+                ExitOnFailure(hr, "Failed to get application index for deleted website");
+
+                ReleaseElementIndex(pAppIndex);
             }
             ExitFunction();
             break;
@@ -1859,6 +1947,9 @@ HRESULT IIS7Site(
                 hr = CreateSite(pCollection, pwzSiteName, &pSiteElem);
                 ExitOnFailure(hr, "Failed to create site");
 
+                hr = NoteIndexedElementAdded(&vTransactionIndex.sites, pwzSiteName);
+                ExitOnFailure(hr, "Failed to index new site");
+
             }
         }
     }
@@ -2998,7 +3089,7 @@ static HRESULT GetSiteElement(
     hr = pSites->get_Collection(&pCollection);
     ExitOnFailure(hr, "Failed get sites collection");
 
-    hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_SITE, IIS_CONFIG_NAME, swSiteName, ppSiteElement, NULL);
+    hr = FindIndexedElement(pCollection, &vTransactionIndex.sites, IIS_CONFIG_SITE, IIS_CONFIG_NAME, swSiteName, ppSiteElement);
     ExitOnFailure(hr, "Failed to find site %ls", swSiteName);
 
     *fFound = ppSiteElement != NULL && *ppSiteElement != NULL;
@@ -3017,13 +3108,17 @@ static HRESULT GetApplicationElement( IAppHostElement *pSiteElement,
 {
    HRESULT hr = S_OK;
    IAppHostElementCollection *pCollection = NULL;
+   SCA_IIS7_ELEMENT_INDEX* pAppIndex = NULL;
 
    *fFound = FALSE;
 
     hr = pSiteElement->get_Collection( &pCollection);
     ExitOnFailure(hr, "Failed get site app collection");
 
-    hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_APPLICATION, IIS_CONFIG_PATH, swAppPath, ppAppElement, NULL);
+    hr = GetSiteApplicationIndex(pSiteElement, NULL, &pAppIndex);
+    ExitOnFailure(hr, "Failed get site app index");
+
+    hr = FindIndexedElement(pCollection, pAppIndex, IIS_CONFIG_APPLICATION, IIS_CONFIG_PATH, swAppPath, ppAppElement);
     ExitOnFailure(hr, "Failed to find app %ls", swAppPath);
 
     *fFound = ppAppElement != NULL && *ppAppElement != NULL;
@@ -3042,6 +3137,7 @@ static HRESULT GetApplicationElementForVDir( IAppHostElement *pSiteElement,
 {
     HRESULT hr = S_OK;
     IAppHostElementCollection *pCollection = NULL;
+    SCA_IIS7_ELEMENT_INDEX* pAppIndex = NULL;
     LPWSTR pwzAppPath = NULL;
     *fFound = FALSE;
     *ppwzVDirSubPath = NULL;
@@ -3049,6 +3145,9 @@ static HRESULT GetApplicationElementForVDir( IAppHostElement *pSiteElement,
     hr = pSiteElement->get_Collection( &pCollection);
     ExitOnFailure(hr, "Failed get site app collection");
 
+    hr = GetSiteApplicationIndex(pSiteElement, NULL, &pAppIndex);
+    ExitOnFailure(hr, "Failed get site app index");
+
     // Start with full path
     int iLastPathIndex = lstrlenW(pwzVDirPath) - 1;
     hr = StrAllocString(&pwzAppPath, pwzVDirPath, 0);
@@ -3071,7 +3170,7 @@ static HRESULT GetApplicationElementForVDir( IAppHostElement *pSiteElement,
             LPCWSTR pwzAppSearchPath = 0 == iSubPathIndex ? L"/" : pwzAppPath;
 
             // Try to find an app with the specified path
-            hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_APPLICATION, IIS_CONFIG_PATH, pwzAppSearchPath, ppAppElement, NULL);
+            hr = FindIndexedElement(pCollection, pAppIndex, IIS_CONFIG_APPLICATION, IIS_CONFIG_PATH, pwzAppSearchPath, ppAppElement);
             ExitOnFailure(hr, "Failed to search for app %ls", pwzAppSearchPath);
             *fFound = ppAppElement != NULL && *ppAppElement != NULL;
 
@@ -3134,6 +3233,7 @@ static HRESULT CreateApplication(
     HRESULT hr = S_OK;
     IAppHostElement *pNewElement = NULL;
     IAppHostElementCollection *pCollection = NULL;
+    SCA_IIS7_ELEMENT_INDEX* pAppIndex = NULL;
 
     hr = pSiteElement->get_Collection(&pCollection);
     ExitOnFailure(hr, "Failed get application collection");
@@ -3147,6 +3247,12 @@ static HRESULT CreateApplication(
     hr = pCollection->AddElement(pNewElement);
     ExitOnFailure(hr, "Failed add application to collection");
 
+    hr = GetSiteApplicationIndex(pSiteElement, NULL, &pAppIndex);
+    ExitOnFailure(hr, "Failed get site app index");
+
+    hr = NoteIndexedElementAdded(pAppIndex, swAppPath);
+    ExitOnFailure(hr, "Failed to index new application");
+
     *pAppElement = pNewElement;
     pNewElement = NULL;
 
@@ -3164,6 +3270,7 @@ static HRESULT DeleteApplication(
 {
     HRESULT hr = S_OK;
     IAppHostElementCollection *pCollection = NULL;
+    SCA_IIS7_ELEMENT_INDEX* pAppIndex = NULL;
 
     hr = pSiteElement->get_Collection(&pCollection);
     ExitOnFailure(hr, "Failed get application collection");
@@ -3171,6 +3278,11 @@ static HRESULT DeleteApplication(
     hr = DeleteCollectionElement(pCollection, IIS_CONFIG_APPLICATION, IIS_CONFIG_PATH, swAppPath);
     ExitOnFailure(hr, "Failed to delete website");
 
+    hr = GetSiteApplicationIndex(pSiteElement, NULL, &pAppIndex);
+    ExitOnFailure(hr, "Failed get site app index");
+
+    ReleaseElementIndex(pAppIndex);
+
 LExit:
     ReleaseObject(pCollection);
 
@@ -4169,6 +4281,294 @@ LExit:
 
     return hr;
 }
+
+static HRESULT FindIndexedElement(
+    __in IAppHostElementCollection *pCollection,
+    __in SCA_IIS7_ELEMENT_INDEX* pIndex,
+    __in LPCWSTR pwzElementName,
+    __in LPCWSTR pwzAttributeName,
+    __in LPCWSTR pwzKey,
+    __out IAppHostElement **ppElement
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cElements = 0;
+    SCA_IIS7_INDEX_ENTRY* pEntry = NULL;
+    IAppHostElement *pElement = NULL;
+    IIS7_APPHOSTELEMENTCOMPARISON comparison = { };
+    VARIANT vtKey;
+    VARIANT vtIndex;
+
+    VariantInit(&vtKey);
+    VariantInit(&vtIndex);
+
+    *ppElement = NULL;
+    ++vTransactionIndex.cLookups;
+
+    vtKey.vt = VT_BSTR;
+    vtKey.bstrVal = ::SysAllocString(pwzKey);
+    ExitOnNull(vtKey.bstrVal, hr, E_OUTOFMEMORY, "Failed to allocate IAppHostElement key");
+
+    comparison.sczElementName = pwzElementName;
+    comparison.sczAttributeName = pwzAttributeName;
+    comparison.pvAttributeValue = &vtKey;
+
+    hr = pCollection->get_Count(&cElements);
+    ExitOnFailure(hr, "Failed get IAppHostElementCollection count");
+
+    vtIndex.vt = VT_UI4;
+
+    // Only trust the index while the collection is the size it was when indexed.
+    if (pIndex->sdhEntries && pIndex->cElements == cElements)
+    {
+        hr = DictGetValue(pIndex->sdhEntries, pwzKey, reinterpret_cast<void**>(&pEntry));
+        if (E_NOTFOUND == hr)
+        {
+            ++vTransactionIndex.cIndexHits;
+            ExitFunction1(hr = S_OK);
+        }
+        ExitOnFailure(hr, "Failed to find IAppHostElement %ls/@%ls=%ls in index", pwzElementName, pwzAttributeName, pwzKey);
+
+        vtIndex.ulVal = pEntry->dwPosition;
+        hr = pCollection->get_Item(vtIndex, &pElement);
+        if (SUCCEEDED(hr) && Iis7IsMatchingAppHostElement(pElement, &comparison))
+        {
+            ++vTransactionIndex.cIndexHits;
+
+            *ppElement = pElement;
+            pElement = NULL;
+            ExitFunction1(hr = S_OK);
+        }
+
+        ReleaseNullObject(pElement);
+    }
+
+    // The index is missing or stale, so index the whole collection again.
+    hr = BuildElementIndex(pCollection, cElements, pwzElementName, pwzAttributeName, pIndex);
+    ExitOnFailure(hr, "Failed to index IAppHostElement %ls/@%ls", pwzElementName, pwzAttributeName);
+
+    hr = DictGetValue(pIndex->sdhEntries, pwzKey, reinterpret_cast<void**>(&pEntry));
+    if (E_NOTFOUND == hr)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+    ExitOnFailure(hr, "Failed to find IAppHostElement %ls/@%ls=%ls in index", pwzElementName, pwzAttributeName, pwzKey);
+
+    vtIndex.ulVal = pEntry->dwPosition;
+    hr = pCollection->get_Item(vtIndex, ppElement);
+    ExitOnFailure(hr, "Failed get IAppHostElement %ls/@%ls=%ls", pwzElementName, pwzAttributeName, pwzKey);
+
+LExit:
+    ReleaseVariant(vtKey);
+    ReleaseVariant(vtIndex);
+    ReleaseObject(pElement);
+
+    return hr;
+}
+
+static HRESULT BuildElementIndex(
+    __in IAppHostElementCollection *pCollection,
+    __in DWORD cElements,
+    __in LPCWSTR pwzElementName,
+    __in LPCWSTR pwzAttributeName,
+    __in SCA_IIS7_ELEMENT_INDEX* pIndex
+    )
+{
+    HRESULT hr = S_OK;
+    IAppHostElement *pElement = NULL;
+    BSTR bstrElementName = NULL;
+    LPWSTR pwzKey = NULL;
+    VARIANT vtIndex;
+
+    VariantInit(&vtIndex);
+
+    ReleaseElementIndex(pIndex);
+    ++vTransactionIndex.cIndexBuilds;
+
+    hr = DictCreateWithEmbeddedKey(&pIndex->sdhEntries, cElements, reinterpret_cast<void**>(&pIndex->rgEntries), offsetof(SCA_IIS7_INDEX_ENTRY, sczKey), DICT_FLAG_CASEINSENSITIVE);
+    ExitOnFailure(hr, "Failed to create IAppHostElement index");
+
+    vtIndex.vt = VT_UI4;
+    for (DWORD i = 0; i < cElements; ++i)
+    {
+        vtIndex.ulVal = i;
+        hr = pCollection->get_Item(vtIndex, &pElement);
+        ExitOnFailure(hr, "Failed get IAppHostElement element");
+
+        hr = pElement->get_Name(&bstrElementName);
+        ExitOnFailure(hr, "Failed to get name of element");
+
+        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, pwzElementName, -1, bstrElementName, -1))
+        {
+            hr = Iis7GetPropertyString(pElement, pwzAttributeName, &pwzKey);
+            ExitOnFailure(hr, "Failed to get value of %ls attribute of %ls element", pwzAttributeName, pwzElementName);
+
+            hr = AddElementIndexEntry(pIndex, pwzKey, i);
+            ExitOnFailure(hr, "Failed to index IAppHostElement %ls/@%ls=%ls", pwzElementName, pwzAttributeName, pwzKey);
+        }
+
+        ReleaseNullBSTR(bstrElementName);
+        ReleaseNullObject(pElement);
+    }
+
+    pIndex->cElements = cElements;
+
+LExit:
+    if (FAILED(hr))
+    {
+        ReleaseElementIndex(pIndex);
+    }
+
+    ReleaseStr(pwzKey);
+    ReleaseBSTR(bstrElementName);
+    ReleaseObject(pElement);
+    ReleaseVariant(vtIndex);
+
+    return hr;
+}
+
+static HRESULT AddElementIndexEntry(
+    __in SCA_IIS7_ELEMENT_INDEX* pIndex,
+    __in LPCWSTR pwzKey,
+    __in DWORD dwPosition
+    )
+{
+    HRESULT hr = S_OK;
+    SCA_IIS7_INDEX_ENTRY* pEntry = NULL;
+
+    // The first element with a key wins, just like walking the collection.
+    hr = DictKeyExists(pIndex->sdhEntries, pwzKey);
+    if (E_NOTFOUND != hr)
+    {
+        ExitOnFailure(hr, "Failed to check index for %ls", pwzKey);
+        ExitFunction();
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pIndex->rgEntries), pIndex->cEntries, 1, sizeof(SCA_IIS7_INDEX_ENTRY), 16);
+    ExitOnFailure(hr, "Failed to grow IAppHostElement index");
+
+    pEntry = pIndex->rgEntries + pIndex->cEntries;
+    ++pIndex->cEntries;
+
+    hr = StrAllocString(&pEntry->sczKey, pwzKey, 0);
+    ExitOnFailure(hr, "Failed to copy index key");
+
+    pEntry->dwPosition = dwPosition;
+
+    hr = DictAddValue(pIndex->sdhEntries, pEntry);
+    ExitOnFailure(hr, "Failed to add %ls to index", pwzKey);
+
+LExit:
+    return hr;
+}
+
+static HRESULT NoteIndexedElementAdded(
+    __in SCA_IIS7_ELEMENT_INDEX* pIndex,
+    __in LPCWSTR pwzKey
+    )
+{
+    HRESULT hr = S_OK;
+
+    // New elements are added to the end of the collection. If that ever isn't
+    // the case the next lookup won't match at this position and reindexes.
+    if (pIndex->sdhEntries)
+    {
+        hr = AddElementIndexEntry(pIndex, pwzKey, pIndex->cElements);
+        ExitOnFailure(hr, "Failed to index new IAppHostElement %ls", pwzKey);
+
+        ++pIndex->cElements;
+    }
+
+LExit:
+    return hr;
+}
+
+static void ReleaseElementIndex(
+    __in SCA_IIS7_ELEMENT_INDEX* pIndex
+    )
+{
+    ReleaseNullDict(pIndex->sdhEntries);
+
+    for (DWORD i = 0; i < pIndex->cEntries; ++i)
+    {
+        ReleaseStr(pIndex->rgEntries[i].sczKey);
+    }
+
+    ReleaseNullMem(pIndex->rgEntries);
+    pIndex->cEntries = 0;
+    pIndex->cElements = 0;
+}
+
+static HRESULT GetSiteApplicationIndex(
+    __in_opt IAppHostElement *pSiteElement,
+    __in_opt LPCWSTR pwzSiteName,
+    __out SCA_IIS7_ELEMENT_INDEX** ppIndex
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR pwzName = NULL;
+    SCA_IIS7_SITE_APPLICATIONS* pSiteApplications = NULL;
+
+    if (!pwzSiteName)
+    {
+        hr = Iis7GetPropertyString(pSiteElement, IIS_CONFIG_NAME, &pwzName);
+        ExitOnFailure(hr, "Failed get site name");
+
+        pwzSiteName = pwzName;
+    }
+
+    if (!vTransactionIndex.sdhSiteApplications)
+    {
+        hr = DictCreateWithEmbeddedKey(&vTransactionIndex.sdhSiteApplications, 0, NULL, offsetof(SCA_IIS7_SITE_APPLICATIONS, sczSiteName), DICT_FLAG_CASEINSENSITIVE);
+        ExitOnFailure(hr, "Failed to create site application index");
+    }
+
+    hr = DictGetValue(vTransactionIndex.sdhSiteApplications, pwzSiteName, reinterpret_cast<void**>(&pSiteApplications));
+    if (E_NOTFOUND == hr)
+    {
+        hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&vTransactionIndex.rgpSiteApplications), vTransactionIndex.cSiteApplications, 1, sizeof(SCA_IIS7_SITE_APPLICATIONS*), 16);
+        ExitOnFailure(hr, "Failed to grow site application index");
+
+        pSiteApplications = static_cast<SCA_IIS7_SITE_APPLICATIONS*>(MemAlloc(sizeof(SCA_IIS7_SITE_APPLICATIONS), TRUE));
+        ExitOnNull(pSiteApplications, hr, E_OUTOFMEMORY, "Failed to allocate site application index");
+
+        vTransactionIndex.rgpSiteApplications[vTransactionIndex.cSiteApplications] = pSiteApplications;
+        ++vTransactionIndex.cSiteApplications;
+
+        hr = StrAllocString(&pSiteApplications->sczSiteName, pwzSiteName, 0);
+        ExitOnFailure(hr, "Failed to copy site name");
+
+        hr = DictAddValue(vTransactionIndex.sdhSiteApplications, pSiteApplications);
+    }
+    ExitOnFailure(hr, "Failed to find application index for site %ls", pwzSiteName);
+
+    *ppIndex = &pSiteApplications->applications;
+
+LExit:
+    ReleaseStr(pwzName);
+
+    return hr;
+}
+
+static void ResetTransactionIndex()
+{
+    ReleaseElementIndex(&vTransactionIndex.sites);
+
+    ReleaseNullDict(vTransactionIndex.sdhSiteApplications);
+
+    for (DWORD i = 0; i < vTransactionIndex.cSiteApplications; ++i)
+    {
+        SCA_IIS7_SITE_APPLICATIONS* pSiteApplications = vTransactionIndex.rgpSiteApplications[i];
+
+        ReleaseElementIndex(&pSiteApplications->applications);
+        ReleaseStr(pSiteApplications->sczSiteName);
+        MemFree(pSiteApplications);
+    }
+
+    ReleaseNullMem(vTransactionIndex.rgpSiteApplications);
+    vTransactionIndex.cSiteApplications = 0;
+}
+
 static void ConvSecToHMS( int Sec,  __out_ecount(cchDest) LPWSTR wcTime, size_t cchDest)
 {
     int ZH, ZM, ZS = 0;
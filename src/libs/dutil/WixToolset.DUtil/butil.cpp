@@ -33,6 +33,13 @@ enum INTERNAL_BUNDLE_STATUS
     INTERNAL_BUNDLE_STATUS_UNKNOWN_PROPERTY,
 };
 
+typedef struct _BUNDLE_QUERY_MATCH
+{
+    LPWSTR sczBundleId;
+    HKEY hkBundle;
+    BUNDLE_RELATION_TYPE relationType;
+} BUNDLE_QUERY_MATCH;
+
 typedef struct _BUNDLE_QUERY_CONTEXT
 {
     BUNDLE_INSTALL_CONTEXT installContext;
@@ -51,17 +58,40 @@ typedef struct _BUNDLE_QUERY_CONTEXT
 
     LPCWSTR* rgwzPatchCodes;
     DWORD cPatchCodes;
+
+    HRESULT hrQuery;
+    BUNDLE_QUERY_MATCH* rgMatches;
+    DWORD cMatches;
 } BUNDLE_QUERY_CONTEXT;
 
 // Forward declarations.
+static HRESULT QueryRelatedBundles(
+    __in_ecount(cInstallContexts) const BUNDLE_INSTALL_CONTEXT* rgInstallContexts,
+    __in DWORD cInstallContexts,
+    __in_z_opt LPCWSTR* rgwzDetectCodes,
+    __in DWORD cDetectCodes,
+    __in_z_opt LPCWSTR* rgwzUpgradeCodes,
+    __in DWORD cUpgradeCodes,
+    __in_z_opt LPCWSTR* rgwzAddonCodes,
+    __in DWORD cAddonCodes,
+    __in_z_opt LPCWSTR* rgwzPatchCodes,
+    __in DWORD cPatchCodes,
+    __in PFNBUNDLE_QUERY_RELATED_BUNDLE_CALLBACK pfnCallback,
+    __in_opt LPVOID pvContext
+    );
+static DWORD WINAPI QueryRelatedBundlesThreadProc(
+    __in LPVOID pvContext
+    );
 static HRESULT QueryRelatedBundlesForScopeAndBitness(
     __in BUNDLE_QUERY_CONTEXT* pQueryContext
     );
 static HRESULT QueryPotentialRelatedBundle(
     __in BUNDLE_QUERY_CONTEXT* pQueryContext,
     __in HKEY hkUninstallKey,
-    __in_z LPCWSTR wzRelatedBundleId,
-    __inout BUNDLE_QUERY_CALLBACK_RESULT* pResult
+    __in_z LPCWSTR wzRelatedBundleId
+    );
+static void ReleaseQueryMatches(
+    __in BUNDLE_QUERY_CONTEXT* pQueryContext
     );
 static HRESULT DetermineRelationType(
     __in BUNDLE_QUERY_CONTEXT* pQueryContext,
@@ -372,34 +402,183 @@ DAPI_(HRESULT) BundleQueryRelatedBundles(
     )
 {
     HRESULT hr = S_OK;
-    BUNDLE_QUERY_CONTEXT queryContext = { };
 
-    queryContext.installContext = installContext;
-    queryContext.rgwzDetectCodes = rgwzDetectCodes;
-    queryContext.cDetectCodes = cDetectCodes;
-    queryContext.rgwzUpgradeCodes = rgwzUpgradeCodes;
-    queryContext.cUpgradeCodes = cUpgradeCodes;
-    queryContext.rgwzAddonCodes = rgwzAddonCodes;
-    queryContext.cAddonCodes = cAddonCodes;
-    queryContext.rgwzPatchCodes = rgwzPatchCodes;
-    queryContext.cPatchCodes = cPatchCodes;
-    queryContext.pfnCallback = pfnCallback;
-    queryContext.pvContext = pvContext;
+    hr = QueryRelatedBundles(&installContext, 1, rgwzDetectCodes, cDetectCodes, rgwzUpgradeCodes, cUpgradeCodes, rgwzAddonCodes, cAddonCodes, rgwzPatchCodes, cPatchCodes, pfnCallback, pvContext);
+    ButilExitOnFailure(hr, "Failed to query related bundles.");
+
+LExit:
+    return hr;
+}
+
+DAPI_(HRESULT) BundleQueryRelatedBundlesForContexts(
+    __in_ecount(cInstallContexts) const BUNDLE_INSTALL_CONTEXT* rgInstallContexts,
+    __in DWORD cInstallContexts,
+    __in_z_opt LPCWSTR* rgwzDetectCodes,
+    __in DWORD cDetectCodes,
+    __in_z_opt LPCWSTR* rgwzUpgradeCodes,
+    __in DWORD cUpgradeCodes,
+    __in_z_opt LPCWSTR* rgwzAddonCodes,
+    __in DWORD cAddonCodes,
+    __in_z_opt LPCWSTR* rgwzPatchCodes,
+    __in DWORD cPatchCodes,
+    __in PFNBUNDLE_QUERY_RELATED_BUNDLE_CALLBACK pfnCallback,
+    __in_opt LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!rgInstallContexts || !cInstallContexts)
+    {
+        ButilExitWithRootFailure(hr, E_INVALIDARG, "At least one install context must be provided.");
+    }
+
+    hr = QueryRelatedBundles(rgInstallContexts, cInstallContexts, rgwzDetectCodes, cDetectCodes, rgwzUpgradeCodes, cUpgradeCodes, rgwzAddonCodes, cAddonCodes, rgwzPatchCodes, cPatchCodes, pfnCallback, pvContext);
+    ButilExitOnFailure(hr, "Failed to query related bundles for install contexts.");
+
+LExit:
+    return hr;
+}
+
+/********************************************************************
+QueryRelatedBundles - walks the 32-bit and 64-bit uninstall keys of each
+    install context, each on its own thread when there is more than one
+    install context, then passes the matches to the callback on the
+    calling thread. The callback order is the same as querying each
+    context and bitness one after the other.
+********************************************************************/
+static HRESULT QueryRelatedBundles(
+    __in_ecount(cInstallContexts) const BUNDLE_INSTALL_CONTEXT* rgInstallContexts,
+    __in DWORD cInstallContexts,
+    __in_z_opt LPCWSTR* rgwzDetectCodes,
+    __in DWORD cDetectCodes,
+    __in_z_opt LPCWSTR* rgwzUpgradeCodes,
+    __in DWORD cUpgradeCodes,
+    __in_z_opt LPCWSTR* rgwzAddonCodes,
+    __in DWORD cAddonCodes,
+    __in_z_opt LPCWSTR* rgwzPatchCodes,
+    __in DWORD cPatchCodes,
+    __in PFNBUNDLE_QUERY_RELATED_BUNDLE_CALLBACK pfnCallback,
+    __in_opt LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cQueryContexts = cInstallContexts * 2;
+    BUNDLE_QUERY_CONTEXT* rgQueryContexts = NULL;
+    HANDLE* rghThreads = NULL;
+    BUNDLE_QUERY_RELATED_BUNDLE_RESULT bundle = { };
+
+    rgQueryContexts = static_cast<BUNDLE_QUERY_CONTEXT*>(MemAlloc(sizeof(BUNDLE_QUERY_CONTEXT) * cQueryContexts, TRUE));
+    ButilExitOnNull(rgQueryContexts, hr, E_OUTOFMEMORY, "Failed to allocate related bundle query contexts.");
+
+    rghThreads = static_cast<HANDLE*>(MemAlloc(sizeof(HANDLE) * cQueryContexts, TRUE));
+    ButilExitOnNull(rghThreads, hr, E_OUTOFMEMORY, "Failed to allocate related bundle query threads.");
+
+    for (DWORD i = 0; i < cQueryContexts; ++i)
+    {
+        BUNDLE_QUERY_CONTEXT* pQueryContext = rgQueryContexts + i;
+
+        pQueryContext->installContext = rgInstallContexts[i / 2];
+        pQueryContext->regBitness = 0 == i % 2 ? REG_KEY_32BIT : REG_KEY_64BIT;
+        pQueryContext->rgwzDetectCodes = rgwzDetectCodes;
+        pQueryContext->cDetectCodes = cDetectCodes;
+        pQueryContext->rgwzUpgradeCodes = rgwzUpgradeCodes;
+        pQueryContext->cUpgradeCodes = cUpgradeCodes;
+        pQueryContext->rgwzAddonCodes = rgwzAddonCodes;
+        pQueryContext->cAddonCodes = cAddonCodes;
+        pQueryContext->rgwzPatchCodes = rgwzPatchCodes;
+        pQueryContext->cPatchCodes = cPatchCodes;
+        pQueryContext->pfnCallback = pfnCallback;
+        pQueryContext->pvContext = pvContext;
+
+        // A single install context is walked on the calling thread, two walks do not gain enough to pay for the threads.
+        if (1 < cInstallContexts)
+        {
+            rghThreads[i] = ::CreateThread(NULL, 0, QueryRelatedBundlesThreadProc, pQueryContext, 0, NULL);
+            if (!rghThreads[i])
+            {
+                TraceError(HRESULT_FROM_WIN32(::GetLastError()), "Failed to create related bundle query thread, querying on the current thread instead.");
+            }
+        }
 
-    queryContext.regBitness = REG_KEY_32BIT;
+        if (!rghThreads[i])
+        {
+            pQueryContext->hrQuery = QueryRelatedBundlesForScopeAndBitness(pQueryContext);
+        }
+    }
 
-    hr = QueryRelatedBundlesForScopeAndBitness(&queryContext);
-    ExitOnFailure(hr, "Failed to query 32-bit related bundles.");
+    for (DWORD i = 0; i < cQueryContexts; ++i)
+    {
+        if (rghThreads[i])
+        {
+            hr = AppWaitForSingleObject(rghThreads[i], INFINITE);
+            ButilExitOnFailure(hr, "Failed to wait for related bundle query thread.");
+        }
+    }
 
-    queryContext.regBitness = REG_KEY_64BIT;
+    for (DWORD i = 0; i < cQueryContexts; ++i)
+    {
+        BUNDLE_QUERY_CONTEXT* pQueryContext = rgQueryContexts + i;
 
-    hr = QueryRelatedBundlesForScopeAndBitness(&queryContext);
-    ExitOnFailure(hr, "Failed to query 64-bit related bundles.");
+        hr = pQueryContext->hrQuery;
+        ButilExitOnFailure(hr, "Failed to query %hs related bundles.", REG_KEY_64BIT == pQueryContext->regBitness ? "64-bit" : "32-bit");
+
+        for (DWORD j = 0; j < pQueryContext->cMatches; ++j)
+        {
+            BUNDLE_QUERY_MATCH* pMatch = pQueryContext->rgMatches + j;
+
+            bundle.installContext = pQueryContext->installContext;
+            bundle.regBitness = pQueryContext->regBitness;
+            bundle.wzBundleId = pMatch->sczBundleId;
+            bundle.relationType = pMatch->relationType;
+            bundle.hkBundle = pMatch->hkBundle;
+
+            if (BUNDLE_QUERY_CALLBACK_RESULT_CONTINUE != pfnCallback(&bundle, pvContext))
+            {
+                ExitFunction1(hr = HRESULT_FROM_WIN32(ERROR_REQUEST_ABORTED));
+            }
+        }
+    }
 
 LExit:
+    if (rghThreads)
+    {
+        for (DWORD i = 0; i < cQueryContexts; ++i)
+        {
+            if (rghThreads[i])
+            {
+                // Never free a context that a query thread may still be using.
+                ::WaitForSingleObject(rghThreads[i], INFINITE);
+                ::CloseHandle(rghThreads[i]);
+            }
+        }
+
+        MemFree(rghThreads);
+    }
+
+    if (rgQueryContexts)
+    {
+        for (DWORD i = 0; i < cQueryContexts; ++i)
+        {
+            ReleaseQueryMatches(rgQueryContexts + i);
+        }
+
+        MemFree(rgQueryContexts);
+    }
+
     return hr;
 }
 
+static DWORD WINAPI QueryRelatedBundlesThreadProc(
+    __in LPVOID pvContext
+    )
+{
+    BUNDLE_QUERY_CONTEXT* pQueryContext = static_cast<BUNDLE_QUERY_CONTEXT*>(pvContext);
+
+    pQueryContext->hrQuery = QueryRelatedBundlesForScopeAndBitness(pQueryContext);
+
+    return static_cast<DWORD>(pQueryContext->hrQuery);
+}
+
 static HRESULT QueryRelatedBundlesForScopeAndBitness(
     __in BUNDLE_QUERY_CONTEXT* pQueryContext
     )
@@ -408,7 +587,6 @@ static HRESULT QueryRelatedBundlesForScopeAndBitness(
     HKEY hkRoot = BUNDLE_INSTALL_CONTEXT_USER == pQueryContext->installContext ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE;
     HKEY hkUninstallKey = NULL;
     LPWSTR sczRelatedBundleId = NULL;
-    BUNDLE_QUERY_CALLBACK_RESULT result = BUNDLE_QUERY_CALLBACK_RESULT_CONTINUE;
 
     hr = RegOpenEx(hkRoot, BUNDLE_REGISTRATION_REGISTRY_UNINSTALL_KEY, KEY_READ, pQueryContext->regBitness, &hkUninstallKey);
     if (HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND) == hr || HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) == hr)
@@ -429,11 +607,7 @@ static HRESULT QueryRelatedBundlesForScopeAndBitness(
 
         // Ignore failures here since we'll often find products that aren't actually
         // related bundles (or even bundles at all).
-        HRESULT hrRelatedBundle = QueryPotentialRelatedBundle(pQueryContext, hkUninstallKey, sczRelatedBundleId, &result);
-        if (SUCCEEDED(hrRelatedBundle) && BUNDLE_QUERY_CALLBACK_RESULT_CONTINUE != result)
-        {
-            ExitFunction1(hr = HRESULT_FROM_WIN32(ERROR_REQUEST_ABORTED));
-        }
+        QueryPotentialRelatedBundle(pQueryContext, hkUninstallKey, sczRelatedBundleId);
     }
 
 LExit:
@@ -446,14 +620,13 @@ LExit:
 static HRESULT QueryPotentialRelatedBundle(
     __in BUNDLE_QUERY_CONTEXT* pQueryContext,
     __in HKEY hkUninstallKey,
-    __in_z LPCWSTR wzRelatedBundleId,
-    __inout BUNDLE_QUERY_CALLBACK_RESULT* pResult
+    __in_z LPCWSTR wzRelatedBundleId
     )
 {
     HRESULT hr = S_OK;
     HKEY hkBundleId = NULL;
     BUNDLE_RELATION_TYPE relationType = BUNDLE_RELATION_NONE;
-    BUNDLE_QUERY_RELATED_BUNDLE_RESULT bundle = { };
+    BUNDLE_QUERY_MATCH* pMatch = NULL;
 
     hr = RegOpenEx(hkUninstallKey, wzRelatedBundleId, KEY_READ, pQueryContext->regBitness, &hkBundleId);
     ExitOnFailure(hr, "Failed to open uninstall key for potential related bundle: %ls", wzRelatedBundleId);
@@ -464,13 +637,20 @@ static HRESULT QueryPotentialRelatedBundle(
         ExitFunction();
     }
 
-    bundle.installContext = pQueryContext->installContext;
-    bundle.regBitness = pQueryContext->regBitness;
-    bundle.wzBundleId = wzRelatedBundleId;
-    bundle.relationType = relationType;
-    bundle.hkBundle = hkBundleId;
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pQueryContext->rgMatches), pQueryContext->cMatches, 1, sizeof(BUNDLE_QUERY_MATCH), 5);
+    ExitOnFailure(hr, "Failed to ensure there is space for related bundle: %ls", wzRelatedBundleId);
+
+    pMatch = pQueryContext->rgMatches + pQueryContext->cMatches;
+
+    hr = StrAllocString(&pMatch->sczBundleId, wzRelatedBundleId, 0);
+    ExitOnFailure(hr, "Failed to copy related bundle id: %ls", wzRelatedBundleId);
+
+    // The match owns the key until the callback has been called.
+    pMatch->hkBundle = hkBundleId;
+    pMatch->relationType = relationType;
+    hkBundleId = NULL;
 
-    *pResult = pQueryContext->pfnCallback(&bundle, pQueryContext->pvContext);
+    ++pQueryContext->cMatches;
 
 LExit:
     ReleaseRegKey(hkBundleId);
@@ -478,6 +658,25 @@ LExit:
     return hr;
 }
 
+static void ReleaseQueryMatches(
+    __in BUNDLE_QUERY_CONTEXT* pQueryContext
+    )
+{
+    if (pQueryContext->rgMatches)
+    {
+        for (DWORD i = 0; i < pQueryContext->cMatches; ++i)
+        {
+            ReleaseStr(pQueryContext->rgMatches[i].sczBundleId);
+            ReleaseRegKey(pQueryContext->rgMatches[i].hkBundle);
+        }
+
+        MemFree(pQueryContext->rgMatches);
+    }
+
+    pQueryContext->rgMatches = NULL;
+    pQueryContext->cMatches = 0;
+}
+
 static HRESULT DetermineRelationType(
     __in BUNDLE_QUERY_CONTEXT* pQueryContext,
     __in HKEY hkBundleId,
@@ -204,6 +204,27 @@ HRESULT BundleQueryRelatedBundles(
     __in_opt LPVOID pvContext
     );
 
+/********************************************************************
+BundleQueryRelatedBundlesForContexts - Same as BundleQueryRelatedBundles for each of the given install contexts.
+                                       The registry for every context and bitness is searched concurrently but
+                                       the callback is always called on the calling thread, in context order
+                                       then 32-bit before 64-bit, same as calling BundleQueryRelatedBundles for each context.
+********************************************************************/
+HRESULT BundleQueryRelatedBundlesForContexts(
+    __in_ecount(cInstallContexts) const BUNDLE_INSTALL_CONTEXT* rgInstallContexts,
+    __in DWORD cInstallContexts,
+    __in_z_opt LPCWSTR* rgwzDetectCodes,
+    __in DWORD cDetectCodes,
+    __in_z_opt LPCWSTR* rgwzUpgradeCodes,
+    __in DWORD cUpgradeCodes,
+    __in_z_opt LPCWSTR* rgwzAddonCodes,
+    __in DWORD cAddonCodes,
+    __in_z_opt LPCWSTR* rgwzPatchCodes,
+    __in DWORD cPatchCodes,
+    __in PFNBUNDLE_QUERY_RELATED_BUNDLE_CALLBACK pfnCallback,
+    __in_opt LPVOID pvContext
+    );
+
 
 #ifdef __cplusplus
 }
@@ -52,7 +52,8 @@ HRESULT DAPI IniParse(
     __out_opt FILE_ENCODING *pfeEncodingFound
     );
 // Gets the full value array, this includes values that may have been deleted
-// (their value will be NULL)
+// (their value will be NULL). Values are in the order they were parsed or set,
+// IniWriteFile() groups values set later with the other values of their section.
 HRESULT DAPI IniGetValueList(
     __in_bcount(INI_HANDLE_BYTES) INI_HANDLE piHandle,
     __deref_out_ecount_opt(*pcValues) INI_VALUE** prgivValues,
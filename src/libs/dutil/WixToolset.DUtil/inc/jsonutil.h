@@ -19,16 +19,43 @@ typedef enum JSON_TOKEN
     JSON_TOKEN_VALUE,
 } JSON_TOKEN;
 
+typedef enum JSON_VALUE_TYPE
+{
+    JSON_VALUE_TYPE_NONE,
+    JSON_VALUE_TYPE_STRING,
+    JSON_VALUE_TYPE_NUMBER,
+    JSON_VALUE_TYPE_BOOL,
+    JSON_VALUE_TYPE_NULL,
+} JSON_VALUE_TYPE;
+
 typedef struct _JSON_VALUE
 {
+    JSON_VALUE_TYPE type;
+
+    // UTF-8 text of the value (or object key) in the reader's buffer. It is not null
+    // terminated and is only valid until the next read. Strings exclude the quotes and
+    // still contain their escape sequences when fEscaped is set.
+    LPCSTR pch;
+    SIZE_T cch;
+    BOOL fEscaped;
 } JSON_VALUE;
 
 typedef struct _JSON_READER
 {
     CRITICAL_SECTION cs;
-    LPWSTR sczJson;
 
-    LPWSTR pwz;
+    HANDLE hFile;
+    BYTE* pbBuffer;
+    SIZE_T cbBuffer;
+
+    const BYTE* pbData;
+    SIZE_T cbData;
+    SIZE_T iData;
+    BOOL fComplete;
+
+    BYTE* rgbContainers;
+    DWORD cContainers;
+
     JSON_TOKEN token;
 } JSON_READER;
 
@@ -36,6 +63,12 @@ typedef struct _JSON_WRITER
 {
     CRITICAL_SECTION cs;
     LPWSTR sczJson;
+    SIZE_T cchJson;
+
+    HANDLE hFile;
+    BYTE* pbBuffer;
+    SIZE_T cbBuffer;
+    SIZE_T cbBuffered;
 
     JSON_TOKEN* rgTokenStack;
     DWORD cTokens;
@@ -43,30 +76,120 @@ typedef struct _JSON_WRITER
 } JSON_WRITER;
 
 
+/********************************************************************
+ JsonInitialize - creates the C numeric locale used to parse JSON
+                  numbers. Calls are counted and each must be paired
+                  with JsonUninitialize, which frees the locale after
+                  the last call.
+
+********************************************************************/
+DAPI_(HRESULT) JsonInitialize();
+DAPI_(void) JsonUninitialize();
+
 DAPI_(HRESULT) JsonInitializeReader(
     __in_z LPCWSTR wzJson,
     __in JSON_READER* pReader
     );
 
+/********************************************************************
+ JsonInitializeReaderFromBuffer - reads UTF-8 JSON in place. The buffer
+                                  must outlive the reader.
+
+********************************************************************/
+DAPI_(HRESULT) JsonInitializeReaderFromBuffer(
+    __in_bcount(cbJson) const BYTE* pbJson,
+    __in SIZE_T cbJson,
+    __in JSON_READER* pReader
+    );
+
+/********************************************************************
+ JsonInitializeReaderFromFile - streams UTF-8 JSON from a file in
+                                chunks so the whole document never
+                                needs to be in memory.
+
+********************************************************************/
+DAPI_(HRESULT) JsonInitializeReaderFromFile(
+    __in_z LPCWSTR wzPath,
+    __in JSON_READER* pReader
+    );
+
 DAPI_(void) JsonUninitializeReader(
     __in JSON_READER* pReader
     );
 
+/********************************************************************
+ JsonReadNext - reads the next token. Object keys and values are
+                returned in pValue as views into the reader's buffer.
+                Returns E_NOMOREITEMS at the end of the document and
+                E_INVALIDDATA for malformed JSON.
+
+********************************************************************/
 DAPI_(HRESULT) JsonReadNext(
     __in JSON_READER* pReader,
     __out JSON_TOKEN* pToken,
     __out JSON_VALUE* pValue
     );
 
+/********************************************************************
+ JsonReadValue - reads the next token which must be a string, number,
+                 boolean or null value.
+
+********************************************************************/
 DAPI_(HRESULT) JsonReadValue(
     __in JSON_READER* pReader,
     __in JSON_VALUE* pValue
     );
 
+DAPI_(HRESULT) JsonValueGetString(
+    __in const JSON_VALUE* pValue,
+    __deref_out_z LPWSTR* psczValue
+    );
+
+DAPI_(HRESULT) JsonValueGetBool(
+    __in const JSON_VALUE* pValue,
+    __out BOOL* pfValue
+    );
+
+DAPI_(HRESULT) JsonValueGetNumber(
+    __in const JSON_VALUE* pValue,
+    __out DWORD* pdwValue
+    );
+
+DAPI_(HRESULT) JsonValueGetNumber64(
+    __in const JSON_VALUE* pValue,
+    __out DWORD64* pqwValue
+    );
+
+DAPI_(HRESULT) JsonValueGetInteger64(
+    __in const JSON_VALUE* pValue,
+    __out LONGLONG* pllValue
+    );
+
+DAPI_(HRESULT) JsonValueGetDouble(
+    __in const JSON_VALUE* pValue,
+    __out double* pdValue
+    );
+
 DAPI_(HRESULT) JsonInitializeWriter(
     __in JSON_WRITER* pWriter
     );
 
+/********************************************************************
+ JsonInitializeWriterToFile - writes UTF-8 JSON to a file through a
+                              fixed size buffer that is written out
+                              in chunks as it fills. Call
+                              JsonFlushWriter when done.
+
+********************************************************************/
+DAPI_(HRESULT) JsonInitializeWriterToFile(
+    __in_z LPCWSTR wzPath,
+    __in JSON_WRITER* pWriter
+    );
+
+DAPI_(HRESULT) JsonFlushWriter(
+    __in JSON_WRITER* pWriter
+    );
+
 DAPI_(void) JsonUninitializeWriter(
     __in JSON_WRITER* pWriter
     );
@@ -81,6 +204,11 @@ DAPI_(HRESULT) JsonWriteNumber(
     __in DWORD dwValue
     );
 
+DAPI_(HRESULT) JsonWriteNumber64(
+    __in JSON_WRITER* pWriter,
+    __in DWORD64 qwValue
+    );
+
 DAPI_(HRESULT) JsonWriteString(
     __in JSON_WRITER* pWriter,
     __in_z LPCWSTR wzValue
@@ -1,6 +1,7 @@
 #pragma once
 // Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
 
+#include "dictutil.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,6 +37,9 @@ struct WIX_LOCALIZATION
 
     DWORD cLocControls;
     LOC_CONTROL* rgLocControls;
+
+    STRINGDICT_HANDLE sdhLocStrings;
+    STRINGDICT_HANDLE sdhLocControls;
 };
 
 /********************************************************************
@@ -81,6 +85,9 @@ void DAPI LocFree(
 /********************************************************************
  LocLocalizeString - replace any #(loc.id) in a string with the
                     correct sub string
+
+ NOTE: The string is scanned once from left to right, so localized
+       text that itself contains #(loc.id) is not expanded again.
 *******************************************************************/
 HRESULT DAPI LocLocalizeString(
     __in const WIX_LOCALIZATION* pWixLoc,
@@ -8,6 +8,19 @@ extern "C" {
 
 #define ReleaseMem(p) if (p) { MemFree(p); }
 #define ReleaseNullMem(p) if (p) { MemFree(p); p = NULL; }
+#define ReleaseMemArena(h) if (h) { MemArenaDestroy(h); }
+#define ReleaseNullMemArena(h) if (h) { MemArenaDestroy(h); h = NULL; }
+
+typedef void* MEM_ARENA_HANDLE;
+
+typedef struct _MEM_STATISTICS
+{
+    DWORD64 cAllocations;
+    DWORD64 cArenaAllocations;
+    DWORD64 cFrees;
+    DWORD64 cbCurrent;
+    DWORD64 cbPeak;
+} MEM_STATISTICS;
 
 HRESULT DAPI MemInitialize();
 void DAPI MemUninitialize();
@@ -85,6 +98,53 @@ HRESULT DAPI MemSizeChecked(
     __out SIZE_T* pcb
     );
 
+/********************************************************************
+ MemArenaCreate - reserves (but does not commit) cbReserve bytes of
+                  address space for an arena. Pass 0 for the default
+                  of 1 MB. At most 16 arenas may exist at once.
+
+ NOTE: arena memory is released all at once by MemArenaDestroy. MemFree
+       of a block in a live arena succeeds and does nothing, so code that
+       frees its allocations piecemeal works unchanged.
+********************************************************************/
+HRESULT DAPI MemArenaCreate(
+    __in SIZE_T cbReserve,
+    __out MEM_ARENA_HANDLE* phArena
+    );
+void DAPI MemArenaDestroy(
+    __in MEM_ARENA_HANDLE hArena
+    );
+
+/********************************************************************
+ MemArenaBeginScope - routes MemAlloc on the calling thread to hArena
+                      until the matching MemArenaEndScope. A NULL arena
+                      routes back to the process heap. Returns the
+                      previous scope which must be passed to
+                      MemArenaEndScope.
+
+ NOTE: only allocations that do not outlive the arena may be made in a
+       scope. Reallocating an arena block outside a scope moves it to
+       the process heap.
+********************************************************************/
+MEM_ARENA_HANDLE DAPI MemArenaBeginScope(
+    __in_opt MEM_ARENA_HANDLE hArena
+    );
+void DAPI MemArenaEndScope(
+    __in_opt MEM_ARENA_HANDLE hPreviousArena
+    );
+
+/********************************************************************
+ MemStatisticsEnable - starts or stops counting allocations and live
+                       bytes. Enable before the first allocation to
+                       keep the byte counts exact.
+********************************************************************/
+void DAPI MemStatisticsEnable(
+    __in BOOL fEnable
+    );
+void DAPI MemGetStatistics(
+    __out MEM_STATISTICS* pStatistics
+    );
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,28 @@ typedef void (*PFN_MONDIRECTORY)(
     __in_opt LPVOID pvContext,
     __in_opt LPVOID pvDirectoryContext
     );
+// Per-file change record delivered by PFN_MONDIRECTORYCHANGES. dwAction is one of the FILE_ACTION_* values and
+// wzRelativePath is relative to the monitored directory.
+typedef struct _MON_DIRECTORY_CHANGE
+{
+    DWORD dwAction;
+    LPCWSTR wzRelativePath;
+} MON_DIRECTORY_CHANGE;
+
+// Only called when the monitor was created with MON_FLAG_DETAILED_DIRECTORY_NOTIFICATIONS. The records were collected during the
+// silence period and are only valid for the duration of the call. If fOverflow is TRUE some changes were not recorded (the kernel
+// buffer overflowed, the directory was recreated, or a wait was retried) and the client must rescan the directory like it would after
+// a PFN_MONDIRECTORY notification.
+typedef void (*PFN_MONDIRECTORYCHANGES)(
+    __in HRESULT hr,
+    __in_z LPCWSTR wzPath,
+    __in BOOL fRecursive,
+    __in_ecount(cChanges) const MON_DIRECTORY_CHANGE* rgChanges,
+    __in DWORD cChanges,
+    __in BOOL fOverflow,
+    __in_opt LPVOID pvContext,
+    __in_opt LPVOID pvDirectoryContext
+    );
 typedef void (*PFN_MONREGKEY)(
     __in HRESULT hr,
     __in HKEY hkRoot,
@@ -49,6 +71,16 @@ typedef void (*PFN_MONREGKEY)(
     __in_opt LPVOID pvRegKeyContext
     );
 
+typedef enum _MON_FLAGS
+{
+    MON_FLAG_NONE = 0x0,
+    // Directories are monitored with ReadDirectoryChangesW on a single I/O completion port thread instead of one waiter thread per
+    // 63 change notification handles. Registry keys are still monitored by waiter threads.
+    MON_FLAG_COMPLETION_PORT = 0x1,
+    // Deliver the per-file change records through PFN_MONDIRECTORYCHANGES instead of PFN_MONDIRECTORY. Implies MON_FLAG_COMPLETION_PORT.
+    MON_FLAG_DETAILED_DIRECTORY_NOTIFICATIONS = 0x2,
+} MON_FLAGS;
+
 // Silence period allows you to avoid lots of notifications when a lot of writes are going on in a directory
 // MonUtil will wait until the directory has been "silent" for at least dwSilencePeriodInMs milliseconds
 // The drawback to setting this to a value higher than zero is that even single write notifications
@@ -61,6 +93,16 @@ HRESULT DAPI MonCreate(
     __in_opt PFN_MONREGKEY vpfMonRegKey,
     __in_opt LPVOID pvContext
     );
+HRESULT DAPI MonCreateEx(
+    __out_bcount(MON_HANDLE_BYTES) MON_HANDLE *pHandle,
+    __in DWORD dwFlags,
+    __in PFN_MONGENERAL vpfMonGeneral,
+    __in_opt PFN_MONDRIVESTATUS vpfMonDriveStatus,
+    __in_opt PFN_MONDIRECTORY vpfMonDirectory,
+    __in_opt PFN_MONDIRECTORYCHANGES vpfMonDirectoryChanges,
+    __in_opt PFN_MONREGKEY vpfMonRegKey,
+    __in_opt LPVOID pvContext
+    );
 // Don't add multiple identical waits! Not only is it wasteful and will cause multiple fires for the exact same change, it will also
 // result in slightly odd behavior when you remove a duplicated wait (removing a wait may or may not remove multiple waits)
 // This is due to the way coordinator thread and waiter threads handle removing, and while it is possible to solve, doing so would complicate the code.
@@ -44,6 +44,15 @@ typedef HRESULT(CALLBACK *PFNTHM_SET_VARIABLE_STRING)(
     __in BOOL fFormatted,
     __in_opt LPVOID pvContext
     );
+typedef HRESULT(CALLBACK *PFNTHM_EVALUATE_VARIABLE_BATCH)(
+    __in DWORD cConditions,
+    __in_ecount(cConditions) LPCWSTR* rgwzConditions,
+    __out_ecount(cConditions) BOOL* rgfConditions,
+    __in DWORD cFormats,
+    __in_ecount(cFormats) LPCWSTR* rgwzFormats,
+    __out_ecount(cFormats) LPWSTR* rgsczFormatted,
+    __in_opt LPVOID pvContext
+    );
 
 typedef enum THEME_ACTION_TYPE
 {
@@ -144,11 +153,57 @@ struct THEME_IMAGE_REFERENCE
     int nWidth;
 };
 
-struct THEME_IMAGE_INSTANCE
+struct THEME_SCALED_IMAGE
 {
+    UINT nDpi;
+    int nSourceX;
+    int nSourceY;
+    int nSourceWidth;
+    int nSourceHeight;
+    int nWidth;
+    int nHeight;
+    DWORD dwPageId;
+    BOOL fTransparency;
+    DWORD dwCreated;    // THEME::dwScaledImageUse when this was scaled.
+    DWORD dwLastUsed;   // THEME::dwScaledImageUse when this was last drawn.
+    BOOL fStale;        // only used while evicting.
+
     Gdiplus::Bitmap* pBitmap;
 };
 
+struct THEME_IMAGE_INSTANCE
+{
+    Gdiplus::Bitmap* pBitmap; // decoded on first draw and released when the page that drew it is hidden.
+    UINT nWidth;
+    UINT nHeight;
+    DWORD dwPageId;
+
+    DWORD cScaledImages; // one per source rectangle, DPI and destination size this instance was drawn at.
+    THEME_SCALED_IMAGE* rgScaledImages;
+
+    HMODULE hModule;
+    WORD wResourceId;
+    LPWSTR sczFile;
+};
+
+struct THEME_VARIABLE_BATCH_VALUE
+{
+    LPWSTR sczKey;
+    BOOL fEvaluated;
+    HRESULT hr;
+    BOOL fCondition;
+    LPWSTR sczFormatted;
+};
+
+struct THEME_VARIABLE_BATCH
+{
+    DWORD cConditions;
+    THEME_VARIABLE_BATCH_VALUE* rgConditions;
+
+    DWORD cFormats;
+    THEME_VARIABLE_BATCH_VALUE* rgFormats;
+};
+
 struct THEME_IMAGE
 {
     LPWSTR sczId;
@@ -404,6 +459,10 @@ typedef struct _THEME
     DWORD dwCurrentPageId;
     HWND hwndTooltip;
 
+    DWORD dwScaledImageUse; // incremented whenever a scaled image is created or drawn.
+
+    THEME_VARIABLE_BATCH* pVariableBatch; // only set while a page is being shown.
+
     UINT nDpi;
 
     // callback functions
@@ -413,6 +472,7 @@ typedef struct _THEME
     PFNTHM_SET_VARIABLE_NUMERIC pfnSetNumericVariable;
     PFNTHM_GET_VARIABLE_STRING pfnGetStringVariable;
     PFNTHM_SET_VARIABLE_STRING pfnSetStringVariable;
+    PFNTHM_EVALUATE_VARIABLE_BATCH pfnEvaluateVariableBatch;
 
     LPVOID pvVariableContext;
 } THEME;
@@ -534,6 +594,20 @@ HRESULT DAPI ThemeRegisterVariableCallbacks(
     __in_opt LPVOID pvContext
     );
 
+/********************************************************************
+ThemeRegisterVariableBatchCallback - registers a callback that evaluates
+                                     all of the conditions and format
+                                     strings of a page in one call when
+                                     the page is shown. The context is
+                                     the one passed to
+                                     ThemeRegisterVariableCallbacks.
+
+*******************************************************************/
+HRESULT DAPI ThemeRegisterVariableBatchCallback(
+    __in THEME* pTheme,
+    __in_opt PFNTHM_EVALUATE_VARIABLE_BATCH pfnEvaluateVariableBatch
+    );
+
 /********************************************************************
  ThemeInitializeWindowClass - sets defaults for the window class
                               from the given theme.
@@ -7,6 +7,9 @@ extern "C" {
 #endif
 
 #define ReleaseVerutilVersion(p) if (p) { VerFreeVersion(p); p = NULL; }
+#define ReleaseVerutilVersionCache(h) if (h) { VerCacheDestroy(h); h = NULL; }
+
+typedef void* VERUTIL_VERSION_CACHE_HANDLE;
 
 typedef struct _VERUTIL_VERSION_RELEASE_LABEL
 {
@@ -34,6 +37,59 @@ typedef struct _VERUTIL_VERSION
     BOOL fHasRevision;
 } VERUTIL_VERSION;
 
+// Packed form of a version without release labels, ordered so that
+// comparing qwHigh then qwLow orders the versions.
+typedef struct _VERUTIL_PACKED_VERSION
+{
+    DWORD64 qwHigh; // major << 32 | minor
+    DWORD64 qwLow;  // patch << 32 | revision
+} VERUTIL_PACKED_VERSION;
+
+/*******************************************************************
+ VerCacheCreate - creates a cache that parses each distinct version
+                  string only once.
+
+*******************************************************************/
+HRESULT DAPI VerCacheCreate(
+    __in DWORD dwExpectedVersions,
+    __out VERUTIL_VERSION_CACHE_HANDLE* phCache
+    );
+
+/*******************************************************************
+ VerCacheDestroy - frees the cache and every version it returned.
+
+*******************************************************************/
+void DAPI VerCacheDestroy(
+    __in VERUTIL_VERSION_CACHE_HANDLE hCache
+    );
+
+/*******************************************************************
+ VerCacheGetVersion - returns the parsed version for the string, parsing
+                      it on first use. The returned version is shared
+                      by every caller and owned by the cache, so it is
+                      read-only and must not be freed.
+
+*******************************************************************/
+HRESULT DAPI VerCacheGetVersion(
+    __in VERUTIL_VERSION_CACHE_HANDLE hCache,
+    __in_z LPCWSTR wzVersion,
+    __in BOOL fStrict,
+    __out const VERUTIL_VERSION** ppVersion
+    );
+
+/*******************************************************************
+ VerCacheCompareStringVersions - same as VerCompareStringVersions but
+                                 uses the cache for both strings.
+
+*******************************************************************/
+HRESULT DAPI VerCacheCompareStringVersions(
+    __in VERUTIL_VERSION_CACHE_HANDLE hCache,
+    __in_z LPCWSTR wzVersion1,
+    __in_z LPCWSTR wzVersion2,
+    __in BOOL fStrict,
+    __out int* pnResult
+    );
+
 /*******************************************************************
  VerCompareParsedVersions - compares the Verutil versions.
 
@@ -65,6 +121,15 @@ HRESULT DAPI VerCopyVersion(
     __out VERUTIL_VERSION** ppVersion
     );
 
+/********************************************************************
+ VerComparePackedVersions - compares two packed versions.
+
+*******************************************************************/
+int DAPI VerComparePackedVersions(
+    __in const VERUTIL_PACKED_VERSION* pVersion1,
+    __in const VERUTIL_PACKED_VERSION* pVersion2
+    );
+
 /********************************************************************
  VerFreeVersion - frees any memory associated with a Verutil version.
 
@@ -84,6 +149,17 @@ HRESULT DAPI VerParseVersion(
     __out VERUTIL_VERSION** ppVersion
     );
 
+/*******************************************************************
+ VerPackVersion - packs the Verutil version for fast comparison.
+                  Returns S_FALSE when the version has release labels
+                  or is invalid and so cannot be packed.
+
+*******************************************************************/
+HRESULT DAPI VerPackVersion(
+    __in const VERUTIL_VERSION* pVersion,
+    __out VERUTIL_PACKED_VERSION* pPackedVersion
+    );
+
 /*******************************************************************
  VerParseVersion - parses the QWORD into a Verutil version.
 
@@ -97,6 +97,7 @@ typedef struct _WIU_MSI_EXECUTE_CONTEXT
     BOOL fRollback;
     PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler;
     LPVOID pvContext;
+    struct _WIU_MSI_MESSAGE_QUEUE* pMessageQueue; // forwards messages that do not need an answer off the Windows Installer thread.
     WIU_MSI_PROGRESS rgMsiProgress[64];
     DWORD dwCurrentProgressIndex;
 
@@ -350,6 +351,7 @@ HRESULT DAPI WiuInitializeExternalUI(
     __in_opt HWND hwndParent,
     __in LPVOID pvContext,
     __in BOOL fRollback,
+    __in BOOL fQueueNotifications,
     __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
     );
 void DAPI WiuUninitializeExternalUI(
@@ -18,6 +18,44 @@
 #define IniExitOnGdipFailure(g, x, s, ...) ExitOnGdipFailureSource(DUTIL_SOURCE_INIUTIL, g, x, s, __VA_ARGS__)
 
 const LPCWSTR wzSectionSeparator = L"\\";
+const DWORD INI_NONE = DWORD_MAX;
+const SIZE_T INI_ARENA_BLOCK_CCH = 32 * 1024;
+const DWORD INI_WRITE_BUFFER_CCH = 16 * 1024;
+
+// Names and values that can't point into the parsed file are carved out of these blocks, which are only freed by IniUninitialize()
+struct INI_ARENA_BLOCK
+{
+    INI_ARENA_BLOCK *pNext;
+    SIZE_T cchUsed;
+    SIZE_T cchSize;
+    WCHAR rgwz[1];
+};
+
+struct INI_SECTION
+{
+    LPCWSTR wzPrefix; // includes the section separator, NULL for values outside of any section
+    DWORD cchPrefix;
+
+    DWORD dwTail; // last value of the first run of values in this section, new values are linked in after it
+    BOOL fRunClosed;
+};
+
+// Parallel to rgivValues, which is only ever appended to so the value index stays valid
+struct INI_VALUE_LINK
+{
+    DWORD dwNext; // next value in the order they are written out
+    DWORD dwSection;
+};
+
+struct INI_WRITER
+{
+    HANDLE hFile;
+    FILE_ENCODING feEncoding;
+
+    LPWSTR rgwcBuffer;
+    DWORD cchBuffer;
+    LPSTR rgbUtf8;
+};
 
 struct INI_STRUCT
 {
@@ -36,8 +74,22 @@ struct INI_STRUCT
 
     INI_VALUE *rgivValues;
     DWORD cValues;
+    STRINGDICT_HANDLE shValues; // fully qualified value name to rgivValues
+
+    INI_VALUE_LINK *rgLinks;
+    DWORD dwFirstValue;
+    DWORD dwLastValue;
 
-    LPWSTR *rgsczLines;
+    INI_SECTION *rgSections;
+    DWORD cSections;
+    STRINGDICT_HANDLE shSections;
+    DWORD dwRootSection;
+    DWORD dwLastSection;
+
+    LPWSTR sczContents; // the whole file, split into lines in place. Parsed names and values point into it where possible.
+    INI_ARENA_BLOCK *pArena;
+
+    LPWSTR *rgwzLines; // points into sczContents
     DWORD cLines;
 
     FILE_ENCODING feEncoding;
@@ -50,8 +102,51 @@ static HRESULT GetSectionPrefixFromName(
     __in_z LPCWSTR wzName,
     __deref_inout_z LPWSTR* psczOutput
     );
-static void UninitializeIniValue(
-    INI_VALUE *pivValue
+static HRESULT EnsureIndex(
+    __in INI_STRUCT *pi,
+    __in DWORD dwNumExpectedItems
+    );
+static HRESULT ArenaAllocString(
+    __in INI_STRUCT *pi,
+    __in_ecount(cchFirst) LPCWSTR wzFirst,
+    __in SIZE_T cchFirst,
+    __in_ecount_opt(cchSecond) LPCWSTR wzSecond,
+    __in SIZE_T cchSecond,
+    __out LPCWSTR *pwzResult
+    );
+static LPWSTR TrimWhitespaceInPlace(
+    __in LPWSTR wzStart,
+    __in LPWSTR wzEnd,
+    __in BOOL fTrimLeading
+    );
+static HRESULT GetSectionIndex(
+    __in INI_STRUCT *pi,
+    __in_z LPCWSTR wzName,
+    __out DWORD *pdwSection
+    );
+static HRESULT AddValue(
+    __in INI_STRUCT *pi,
+    __in_z LPCWSTR wzName,
+    __in_z LPCWSTR wzValue,
+    __in DWORD dwLineNumber,
+    __out DWORD *pdwIndex
+    );
+static HRESULT WriterOpen(
+    __in INI_WRITER *pWriter,
+    __in_z LPCWSTR wzPath,
+    __in FILE_ENCODING feEncoding
+    );
+static HRESULT WriterAppend(
+    __in INI_WRITER *pWriter,
+    __in_ecount_opt(cch) LPCWSTR wz,
+    __in SIZE_T cch
+    );
+static HRESULT WriterFlush(
+    __in INI_WRITER *pWriter,
+    __in BOOL fFinal
+    );
+static void WriterClose(
+    __in INI_WRITER *pWriter
     );
 
 extern "C" HRESULT DAPI IniInitialize(
@@ -59,10 +154,18 @@ extern "C" HRESULT DAPI IniInitialize(
     )
 {
     HRESULT hr = S_OK;
+    INI_STRUCT *pi = NULL;
 
     // Allocate the handle
-    *piHandle = static_cast<INI_HANDLE>(MemAlloc(sizeof(INI_STRUCT), TRUE));
-    IniExitOnNull(*piHandle, hr, E_OUTOFMEMORY, "Failed to allocate ini object");
+    pi = static_cast<INI_STRUCT *>(MemAlloc(sizeof(INI_STRUCT), TRUE));
+    IniExitOnNull(pi, hr, E_OUTOFMEMORY, "Failed to allocate ini object");
+
+    pi->dwFirstValue = INI_NONE;
+    pi->dwLastValue = INI_NONE;
+    pi->dwRootSection = INI_NONE;
+    pi->dwLastSection = INI_NONE;
+
+    *piHandle = pi;
 
 LExit:
     return hr;
@@ -73,6 +176,7 @@ extern "C" void DAPI IniUninitialize(
     )
 {
     INI_STRUCT *pi = static_cast<INI_STRUCT *>(piHandle);
+    INI_ARENA_BLOCK *pBlock = NULL;
 
     ReleaseStr(pi->sczPath);
     ReleaseStr(pi->sczOpenTagPrefix);
@@ -87,13 +191,23 @@ extern "C" void DAPI IniUninitialize(
 
     ReleaseStr(pi->sczCommentLinePrefix);
 
-    for (DWORD i = 0; i < pi->cValues; ++i)
-    {
-        UninitializeIniValue(pi->rgivValues + i);
-    }
+    // Names and values live in the contents or the arena, so they all go at once
+    ReleaseDict(pi->shValues);
     ReleaseMem(pi->rgivValues);
+    ReleaseMem(pi->rgLinks);
+
+    ReleaseDict(pi->shSections);
+    ReleaseMem(pi->rgSections);
+
+    ReleaseMem(pi->rgwzLines);
+    ReleaseStr(pi->sczContents);
 
-    ReleaseStrArray(pi->rgsczLines, pi->cLines);
+    while (pi->pArena)
+    {
+        pBlock = pi->pArena;
+        pi->pArena = pBlock->pNext;
+        MemFree(pBlock);
+    }
 
     ReleaseMem(pi);
 }
@@ -219,13 +333,16 @@ extern "C" HRESULT DAPI IniParse(
 {
     HRESULT hr = S_OK;
     DWORD dwValuePrefixLength = 0;
+    DWORD dwValueSeparatorLength = 0;
     DWORD dwValueSeparatorExceptionLength = 0;
-    LPWSTR sczContents = NULL;
-    LPWSTR sczCurrentSection = NULL;
-    LPWSTR sczName = NULL;
-    LPWSTR sczNameTrimmed = NULL;
-    LPWSTR sczValue = NULL;
-    LPWSTR sczValueTrimmed = NULL;
+    DWORD dwOpenTagPrefixLength = 0;
+    DWORD dwIndex = 0;
+    LPCWSTR wzCurrentSection = NULL;
+    SIZE_T cchCurrentSection = 0;
+    LPCWSTR wzName = NULL;
+    LPWSTR wzNameEnd = NULL;
+    LPWSTR wzValue = NULL;
+    LPWSTR wzLine = NULL;
     LPWSTR wzOpenTagPrefix = NULL;
     LPWSTR wzOpenTagPostfix = NULL;
     LPWSTR wzValuePrefix = NULL;
@@ -234,6 +351,8 @@ extern "C" HRESULT DAPI IniParse(
     LPWSTR wzCommentLinePrefix = NULL;
     LPWSTR wzValueBegin = NULL;
     LPCWSTR wzTemp = NULL;
+    LPWSTR wz = NULL;
+    SIZE_T cchLine = 0;
 
     INI_STRUCT *pi = static_cast<INI_STRUCT *>(piHandle);
 
@@ -243,7 +362,7 @@ extern "C" HRESULT DAPI IniParse(
     hr = StrAllocString(&pi->sczPath, wzPath, 0);
     IniExitOnFailure(hr, "Failed to copy path to ini struct: %ls", wzPath);
 
-    hr = FileToString(pi->sczPath, &sczContents, &pi->feEncoding);
+    hr = FileToString(pi->sczPath, &pi->sczContents, &pi->feEncoding);
     IniExitOnFailure(hr, "Failed to convert file to string: %ls", pi->sczPath);
 
     if (pfeEncodingFound)
@@ -251,28 +370,65 @@ extern "C" HRESULT DAPI IniParse(
         *pfeEncodingFound = pi->feEncoding;
     }
 
-    if (!sczContents || !*sczContents)
+    if (!pi->sczContents || !*pi->sczContents)
     {
         // Empty string, nothing to parse
         ExitFunction1(hr = S_OK);
     }
 
     dwValuePrefixLength = lstrlenW(pi->sczValuePrefix);
-    hr = StrSplitAllocArray(&pi->rgsczLines, reinterpret_cast<UINT *>(&pi->cLines), sczContents, L"\n");
-    IniExitOnFailure(hr, "Failed to split INI file into lines");
+    dwValueSeparatorLength = lstrlenW(pi->sczValueSeparator);
+    dwOpenTagPrefixLength = lstrlenW(pi->sczOpenTagPrefix);
+
+    // Split the contents into lines in place, skipping empty lines
+    for (wz = pi->sczContents; *wz; ++wz)
+    {
+        if (L'\n' != *wz && (wz == pi->sczContents || L'\n' == *(wz - 1)))
+        {
+            ++pi->cLines;
+        }
+    }
+
+    pi->rgwzLines = static_cast<LPWSTR *>(MemAlloc(sizeof(LPWSTR) * pi->cLines, TRUE));
+    IniExitOnNull(pi->rgwzLines, hr, E_OUTOFMEMORY, "Failed to allocate INI line array");
+
+    dwIndex = 0;
+    for (wz = pi->sczContents; *wz; ++wz)
+    {
+        if (L'\n' == *wz)
+        {
+            *wz = L'\0';
+        }
+        else if (wz == pi->sczContents || L'\0' == *(wz - 1))
+        {
+            pi->rgwzLines[dwIndex++] = wz;
+        }
+    }
+
+    hr = EnsureIndex(pi, pi->cLines);
+    IniExitOnFailure(hr, "Failed to create INI value index");
+
+    // Every line is at most one value, so size the value arrays once
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<void **>(&pi->rgivValues), pi->cValues, pi->cLines, sizeof(INI_VALUE), 100);
+    IniExitOnFailure(hr, "Failed to allocate value array");
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<void **>(&pi->rgLinks), pi->cValues, pi->cLines, sizeof(INI_VALUE_LINK), 100);
+    IniExitOnFailure(hr, "Failed to allocate value order array");
 
     for (DWORD i = 0; i < pi->cLines; ++i)
     {
-        if (!*pi->rgsczLines[i] || '\r' == *pi->rgsczLines[i])
+        wzLine = pi->rgwzLines[i];
+
+        if (!*wzLine || '\r' == *wzLine)
         {
             continue;
         }
 
         if (pi->sczCommentLinePrefix)
         {
-            wzCommentLinePrefix = wcsstr(pi->rgsczLines[i], pi->sczCommentLinePrefix);
+            wzCommentLinePrefix = wcsstr(wzLine, pi->sczCommentLinePrefix);
 
-            if (wzCommentLinePrefix && wzCommentLinePrefix <= pi->rgsczLines[i] + 1)
+            if (wzCommentLinePrefix && wzCommentLinePrefix <= wzLine + 1)
             {
                 continue;
             }
@@ -280,12 +436,12 @@ extern "C" HRESULT DAPI IniParse(
 
         if (pi->sczOpenTagPrefix)
         {
-            wzOpenTagPrefix = wcsstr(pi->rgsczLines[i], pi->sczOpenTagPrefix);
+            wzOpenTagPrefix = wcsstr(wzLine, pi->sczOpenTagPrefix);
             if (wzOpenTagPrefix)
             {
                 // If there is an open tag prefix but there is anything but whitespace before it, then it's NOT an open tag prefix
                 // This is important, for example, to support values with names like "Array[0]=blah" in INI format
-                for (wzTemp = pi->rgsczLines[i]; wzTemp < wzOpenTagPrefix; ++wzTemp)
+                for (wzTemp = wzLine; wzTemp < wzOpenTagPrefix; ++wzTemp)
                 {
                     if (*wzTemp != L' ' && *wzTemp != L'\t')
                     {
@@ -298,12 +454,12 @@ extern "C" HRESULT DAPI IniParse(
 
         if (pi->sczOpenTagPostfix)
         {
-            wzOpenTagPostfix = wcsstr(pi->rgsczLines[i], pi->sczOpenTagPostfix);
+            wzOpenTagPostfix = wcsstr(wzLine, pi->sczOpenTagPostfix);
         }
 
         if (pi->sczValuePrefix)
         {
-            wzValuePrefix = wcsstr(pi->rgsczLines[i], pi->sczValuePrefix);
+            wzValuePrefix = wcsstr(wzLine, pi->sczValuePrefix);
             if (wzValuePrefix != NULL)
             {
                 wzValueNameStart = wzValuePrefix + dwValuePrefixLength;
@@ -311,7 +467,7 @@ extern "C" HRESULT DAPI IniParse(
         }
         else
         {
-            wzValueNameStart = pi->rgsczLines[i];
+            wzValueNameStart = wzLine;
         }
 
         if (pi->sczValueSeparator && NULL != wzValueNameStart && *wzValueNameStart != L'\0')
@@ -319,7 +475,7 @@ extern "C" HRESULT DAPI IniParse(
             dwValueSeparatorExceptionLength = 0;
             for (DWORD j = 0; j < pi->cValueSeparatorExceptions; ++j)
             {
-                if (pi->rgsczLines[i] == wcsstr(pi->rgsczLines[i], pi->rgsczValueSeparatorExceptions[j]))
+                if (wzLine == wcsstr(wzLine, pi->rgsczValueSeparatorExceptions[j]))
                 {
                     dwValueSeparatorExceptionLength = lstrlenW(pi->rgsczValueSeparatorExceptions[j]);
                     break;
@@ -330,83 +486,71 @@ extern "C" HRESULT DAPI IniParse(
         }
 
         // Don't keep the endline
-        if (pi->rgsczLines[i][lstrlenW(pi->rgsczLines[i])-1] == L'\r')
+        cchLine = lstrlenW(wzLine);
+        if (wzLine[cchLine - 1] == L'\r')
         {
-            pi->rgsczLines[i][lstrlenW(pi->rgsczLines[i])-1] = L'\0';
+            wzLine[--cchLine] = L'\0';
         }
 
         if (fSections && wzOpenTagPrefix && wzOpenTagPostfix && wzOpenTagPrefix < wzOpenTagPostfix && (NULL == wzCommentLinePrefix || wzOpenTagPrefix < wzCommentLinePrefix))
         {
-            // There is an section starting here, let's keep track of it and move on
-            hr = StrAllocString(&sczCurrentSection, wzOpenTagPrefix + lstrlenW(pi->sczOpenTagPrefix), wzOpenTagPostfix - (wzOpenTagPrefix + lstrlenW(pi->sczOpenTagPrefix)));
-            IniExitOnFailure(hr, "Failed to record section name for line: %ls of INI file: %ls", pi->rgsczLines[i], pi->sczPath);
+            // There is an section starting here, let's keep track of it and move on. Leading whitespace is never part of a name.
+            wzTemp = wzOpenTagPrefix + dwOpenTagPrefixLength;
+            while (L' ' == *wzTemp || L'\t' == *wzTemp)
+            {
+                ++wzTemp;
+            }
+            cchCurrentSection = wzTemp < wzOpenTagPostfix ? wzOpenTagPostfix - wzTemp : 0;
+
+            hr = ArenaAllocString(pi, wzTemp, cchCurrentSection, wzSectionSeparator, 1, &wzCurrentSection);
+            IniExitOnFailure(hr, "Failed to record section name for line: %ls of INI file: %ls", wzLine, pi->sczPath);
+            ++cchCurrentSection;
 
             // Sections will be calculated dynamically after any set operations, so don't include this in the list of lines to remember for output
-            ReleaseNullStr(pi->rgsczLines[i]);
+            pi->rgwzLines[i] = NULL;
         }
         else if (wzValueSeparator && (NULL == wzCommentLinePrefix || wzValueSeparator < wzCommentLinePrefix)
             && (!fValuePrefix || wzValuePrefix))
         {
             if (fValuePrefix)
             {
-                wzValueBegin = wzValuePrefix + lstrlenW(pi->sczValuePrefix);
+                wzValueBegin = wzValuePrefix + dwValuePrefixLength;
             }
             else
             {
-                wzValueBegin = pi->rgsczLines[i];
+                wzValueBegin = wzLine;
             }
 
-            hr = MemEnsureArraySize(reinterpret_cast<void **>(&pi->rgivValues), pi->cValues + 1, sizeof(INI_VALUE), 100);
-            IniExitOnFailure(hr, "Failed to increase array size for value array");
+            // The line is forgotten, so trim the value and name right where they are. The value comes first
+            // because trimming the name terminates it at or before the separator.
+            wzValue = TrimWhitespaceInPlace(wzValueSeparator + dwValueSeparatorLength, wzLine + cchLine, TRUE);
 
-            if (sczCurrentSection)
+            if (wzCurrentSection)
             {
-                hr = StrAllocString(&sczName, sczCurrentSection, 0);
-                IniExitOnFailure(hr, "Failed to copy current section name");
+                wzNameEnd = TrimWhitespaceInPlace(wzValueBegin, wzValueSeparator, FALSE);
+                wzNameEnd += lstrlenW(wzNameEnd);
 
-                hr = StrAllocConcat(&sczName, wzSectionSeparator, 0);
-                IniExitOnFailure(hr, "Failed to copy current section name");
+                hr = ArenaAllocString(pi, wzCurrentSection, cchCurrentSection, wzValueBegin, wzNameEnd - wzValueBegin, &wzName);
+                IniExitOnFailure(hr, "Failed to copy name");
+            }
+            else
+            {
+                wzName = TrimWhitespaceInPlace(wzValueBegin, wzValueSeparator, TRUE);
             }
 
-            hr = StrAllocConcat(&sczName, wzValueBegin, wzValueSeparator - wzValueBegin);
-            IniExitOnFailure(hr, "Failed to copy name");
-
-            hr = StrAllocString(&sczValue, wzValueSeparator + lstrlenW(pi->sczValueSeparator), 0);
-            IniExitOnFailure(hr, "Failed to copy value");
-
-            hr = StrTrimWhitespace(&sczNameTrimmed, sczName);
-            IniExitOnFailure(hr, "Failed to trim whitespace from name");
-
-            hr = StrTrimWhitespace(&sczValueTrimmed, sczValue);
-            IniExitOnFailure(hr, "Failed to trim whitespace from value");
-
-            pi->rgivValues[pi->cValues].wzName = const_cast<LPCWSTR>(sczNameTrimmed);
-            sczNameTrimmed = NULL;
-            pi->rgivValues[pi->cValues].wzValue = const_cast<LPCWSTR>(sczValueTrimmed);
-            sczValueTrimmed = NULL;
-            pi->rgivValues[pi->cValues].dwLineNumber = i + 1;
-
-            ++pi->cValues;
+            hr = AddValue(pi, wzName, wzValue, i + 1, &dwIndex);
+            IniExitOnFailure(hr, "Failed to add value: %ls", wzName);
 
             // Values will be calculated dynamically after any set operations, so don't include this in the list of lines to remember for output
-            ReleaseNullStr(pi->rgsczLines[i]);
+            pi->rgwzLines[i] = NULL;
         }
         else
         {
             // Must be a comment, so ignore it and keep it in the list to output
         }
-
-        ReleaseNullStr(sczName);
     }
 
 LExit:
-    ReleaseStr(sczCurrentSection);
-    ReleaseStr(sczContents);
-    ReleaseStr(sczName);
-    ReleaseStr(sczNameTrimmed);
-    ReleaseStr(sczValue);
-    ReleaseStr(sczValueTrimmed);
-
     return hr;
 }
 
@@ -437,20 +581,15 @@ extern "C" HRESULT DAPI IniGetValue(
     INI_STRUCT *pi = static_cast<INI_STRUCT *>(piHandle);
     INI_VALUE *pValue = NULL;
 
-    for (DWORD i = 0; i < pi->cValues; ++i)
+    if (pi->shValues)
     {
-        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, pi->rgivValues[i].wzName, -1, wzValueName, -1))
-        {
-            pValue = pi->rgivValues + i;
-            break;
-        }
+        hr = DictGetValue(pi->shValues, wzValueName, reinterpret_cast<void **>(&pValue));
     }
-
-    if (NULL == pValue)
+    else
     {
         hr = E_NOTFOUND;
-        IniExitOnFailure(hr, "Failed to check for INI value: %ls", wzValueName);
     }
+    IniExitOnFailure(hr, "Failed to check for INI value: %ls", wzValueName);
 
     if (NULL == pValue->wzValue)
     {
@@ -471,22 +610,23 @@ extern "C" HRESULT DAPI IniSetValue(
     )
 {
     HRESULT hr = S_OK;
-    LPWSTR sczSectionPrefix = NULL; // includes section name and backslash
-    LPWSTR sczName = NULL;
-    LPWSTR sczValue = NULL;
-    DWORD dwInsertIndex = DWORD_MAX;
+    LPCWSTR wzName = NULL;
+    LPCWSTR wzNewValue = NULL;
+    SIZE_T cchValue = 0;
+    DWORD dwIndex = INI_NONE;
 
     INI_STRUCT *pi = static_cast<INI_STRUCT *>(piHandle);
     INI_VALUE *pValue = NULL;
 
-    for (DWORD i = 0; i < pi->cValues; ++i)
+    hr = EnsureIndex(pi, 0);
+    IniExitOnFailure(hr, "Failed to create INI value index");
+
+    hr = DictGetValue(pi->shValues, wzValueName, reinterpret_cast<void **>(&pValue));
+    if (E_NOTFOUND == hr)
     {
-        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, pi->rgivValues[i].wzName, -1, wzValueName, -1))
-        {
-            pValue = pi->rgivValues + i;
-            break;
-        }
+        hr = S_OK;
     }
+    IniExitOnFailure(hr, "Failed to check for INI value: %ls", wzValueName);
 
     // We're killing the value
     if (NULL == wzValue)
@@ -494,93 +634,47 @@ extern "C" HRESULT DAPI IniSetValue(
         if (pValue && pValue->wzValue)
         {
             pi->fModified = TRUE;
-            sczValue = const_cast<LPWSTR>(pValue->wzValue);
             pValue->wzValue = NULL;
-            ReleaseNullStr(sczValue);
         }
 
         ExitFunction();
     }
-    else
+    else if (pValue)
     {
-        if (pValue)
+        if (NULL == pValue->wzValue || CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, 0, pValue->wzValue, -1, wzValue, -1))
         {
-            if (CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, 0, pValue->wzValue, -1, wzValue, -1))
-            {
-                pi->fModified = TRUE;
-                hr = StrAllocString(const_cast<LPWSTR *>(&pValue->wzValue), wzValue, 0);
-                IniExitOnFailure(hr, "Failed to update value INI value named: %ls", wzValueName);
-            }
-
-            ExitFunction1(hr = S_OK);
-        }
-        else
-        {
-            if (wzValueName)
-            {
-                hr = GetSectionPrefixFromName(wzValueName, &sczSectionPrefix);
-                IniExitOnFailure(hr, "Failed to get section prefix from value name: %ls", wzValueName);
-            }
+            pi->fModified = TRUE;
+            cchValue = lstrlenW(wzValue);
 
-            // If we have a section prefix, figure out the index to insert it (at the end of the section it belongs in)
-            if (sczSectionPrefix)
+            // Overwrite the old value when the new one fits, nothing else points at it
+            if (pValue->wzValue && static_cast<SIZE_T>(lstrlenW(pValue->wzValue)) >= cchValue)
             {
-                for (DWORD i = 0; i < pi->cValues; ++i)
-                {
-                    if (0 == wcsncmp(pi->rgivValues[i].wzName, sczSectionPrefix, lstrlenW(sczSectionPrefix)))
-                    {
-                        dwInsertIndex = i;
-                    }
-                    else if (DWORD_MAX != dwInsertIndex)
-                    {
-                        break;
-                    }
-                }
+                memcpy_s(const_cast<LPWSTR>(pValue->wzValue), (cchValue + 1) * sizeof(WCHAR), wzValue, (cchValue + 1) * sizeof(WCHAR));
             }
             else
             {
-                for (DWORD i = 0; i < pi->cValues; ++i)
-                {
-                    if (NULL == wcsstr(pi->rgivValues[i].wzName, wzSectionSeparator))
-                    {
-                        dwInsertIndex = i;
-                    }
-                    else if (DWORD_MAX != dwInsertIndex)
-                    {
-                        break;
-                    }
-                }
-            }
+                hr = ArenaAllocString(pi, wzValue, cchValue, NULL, 0, &wzNewValue);
+                IniExitOnFailure(hr, "Failed to update value INI value named: %ls", wzValueName);
 
-            // Otherwise, just add it to the end
-            if (DWORD_MAX == dwInsertIndex)
-            {
-                dwInsertIndex = pi->cValues;
+                pValue->wzValue = wzNewValue;
             }
+        }
+    }
+    else
+    {
+        hr = ArenaAllocString(pi, wzValueName, lstrlenW(wzValueName), NULL, 0, &wzName);
+        IniExitOnFailure(hr, "Failed to copy name");
 
-            pi->fModified = TRUE;
-            hr = MemInsertIntoArray(reinterpret_cast<void **>(&pi->rgivValues), dwInsertIndex, 1, pi->cValues + 1, sizeof(INI_VALUE), 100);
-            IniExitOnFailure(hr, "Failed to insert value into array");
-
-            hr = StrAllocString(&sczName, wzValueName, 0);
-            IniExitOnFailure(hr, "Failed to copy name");
-
-            hr = StrAllocString(&sczValue, wzValue, 0);
-            IniExitOnFailure(hr, "Failed to copy value");
-
-            pi->rgivValues[dwInsertIndex].wzName = const_cast<LPCWSTR>(sczName);
-            sczName = NULL;
-            pi->rgivValues[dwInsertIndex].wzValue = const_cast<LPCWSTR>(sczValue);
-            sczValue = NULL;
+        hr = ArenaAllocString(pi, wzValue, lstrlenW(wzValue), NULL, 0, &wzNewValue);
+        IniExitOnFailure(hr, "Failed to copy value");
 
-            ++pi->cValues;
-        }
+        // New values go after the other values of the section they belong in
+        pi->fModified = TRUE;
+        hr = AddValue(pi, wzName, wzNewValue, 0, &dwIndex);
+        IniExitOnFailure(hr, "Failed to add value: %ls", wzValueName);
     }
 
 LExit:
-    ReleaseStr(sczName);
-    ReleaseStr(sczValue);
-
     return hr;
 }
 
@@ -591,15 +685,16 @@ extern "C" HRESULT DAPI IniWriteFile(
     )
 {
     HRESULT hr = S_OK;
-    LPWSTR sczCurrentSectionPrefix = NULL;
-    LPWSTR sczNewSectionPrefix = NULL;
-    LPWSTR sczContents = NULL;
-    LPCWSTR wzName = NULL;
+    INI_WRITER writer = { };
+    INI_SECTION *pSection = NULL;
+    DWORD dwCurrentSection = INI_NONE;
     DWORD dwLineArrayIndex = 1;
     FILE_ENCODING feEncoding;
 
     INI_STRUCT *pi = static_cast<INI_STRUCT *>(piHandle);
 
+    writer.hFile = INVALID_HANDLE_VALUE;
+
     if (FILE_ENCODING_UNSPECIFIED == feOverrideEncoding)
     {
         feEncoding = pi->feEncoding;
@@ -623,27 +718,31 @@ extern "C" HRESULT DAPI IniWriteFile(
         ExitFunction1(hr = E_NOTFOUND);
     }
 
+    // If no path was specified, use the path to the file we parsed
+    if (NULL == wzPath)
+    {
+        wzPath = pi->sczPath;
+    }
+
     BOOL fSections = (pi->sczOpenTagPrefix) && (pi->sczOpenTagPostfix);
 
-    hr = StrAllocString(&sczContents, L"", 0);
-    IniExitOnFailure(hr, "Failed to begin contents string as empty string");
+    // Everything that is written lives in memory, so the output can be streamed even over the file that was parsed
+    hr = WriterOpen(&writer, wzPath, feEncoding);
+    IniExitOnFailure(hr, "Failed to open INI file for writing: %ls", wzPath);
 
     // Insert any beginning lines we didn't understand like comments
-    if (0 < pi->cLines)
+    while (dwLineArrayIndex < pi->cLines && pi->rgwzLines[dwLineArrayIndex])
     {
-        while (pi->rgsczLines[dwLineArrayIndex])
-        {
-            hr = StrAllocConcat(&sczContents, pi->rgsczLines[dwLineArrayIndex], 0);
-            IniExitOnFailure(hr, "Failed to add previous line to ini output buffer in-memory");
+        hr = WriterAppend(&writer, pi->rgwzLines[dwLineArrayIndex], 0);
+        IniExitOnFailure(hr, "Failed to add previous line to ini output");
 
-            hr = StrAllocConcat(&sczContents, L"\r\n", 2);
-            IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
+        hr = WriterAppend(&writer, L"\r\n", 2);
+        IniExitOnFailure(hr, "Failed to add endline to ini output");
 
-            ++dwLineArrayIndex;
-        }
+        ++dwLineArrayIndex;
     }
 
-    for (DWORD i = 0; i < pi->cValues; ++i)
+    for (DWORD i = pi->dwFirstValue; INI_NONE != i; i = pi->rgLinks[i].dwNext)
     {
         // Skip if this value was killed off
         if (NULL == pi->rgivValues[i].wzValue)
@@ -652,100 +751,73 @@ extern "C" HRESULT DAPI IniWriteFile(
         }
 
         // Now generate any lines for the current value like value line and maybe also a new section line before it
+        pSection = pi->rgSections + pi->rgLinks[i].dwSection;
 
-        // First see if we need to write a section line
-        hr = GetSectionPrefixFromName(pi->rgivValues[i].wzName, &sczNewSectionPrefix);
-        IniExitOnFailure(hr, "Failed to get section prefix from name: %ls", pi->rgivValues[i].wzName);
-
-        // If the new section prefix is different, write a section out for it
-        if (fSections && sczNewSectionPrefix && (NULL == sczCurrentSectionPrefix || CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, 0, sczNewSectionPrefix, -1, sczCurrentSectionPrefix, -1)))
+        // If the section is different, write a section out for it
+        if (fSections && pSection->wzPrefix && dwCurrentSection != pi->rgLinks[i].dwSection)
         {
-            hr = StrAllocConcat(&sczContents, pi->sczOpenTagPrefix, 0);
-            IniExitOnFailure(hr, "Failed to concat open tag prefix to string");
-
-            // Exclude section separator (i.e. backslash) from new section prefix
-            hr = StrAllocConcat(&sczContents, sczNewSectionPrefix, lstrlenW(sczNewSectionPrefix)-lstrlenW(wzSectionSeparator));
-            IniExitOnFailure(hr, "Failed to concat section name to string");
-
-            hr = StrAllocConcat(&sczContents, pi->sczOpenTagPostfix, 0);
-            IniExitOnFailure(hr, "Failed to concat open tag postfix to string");
-
-            hr = StrAllocConcat(&sczContents, L"\r\n", 2);
-            IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
-            
-            ReleaseNullStr(sczCurrentSectionPrefix);
-            sczCurrentSectionPrefix = sczNewSectionPrefix;
-            sczNewSectionPrefix = NULL;
+            hr = WriterAppend(&writer, pi->sczOpenTagPrefix, 0);
+            IniExitOnFailure(hr, "Failed to write open tag prefix");
+
+            // Exclude section separator (i.e. backslash) from section prefix
+            hr = WriterAppend(&writer, pSection->wzPrefix, pSection->cchPrefix - lstrlenW(wzSectionSeparator));
+            IniExitOnFailure(hr, "Failed to write section name");
+
+            hr = WriterAppend(&writer, pi->sczOpenTagPostfix, 0);
+            IniExitOnFailure(hr, "Failed to write open tag postfix");
+
+            hr = WriterAppend(&writer, L"\r\n", 2);
+            IniExitOnFailure(hr, "Failed to add endline to ini output");
+
+            dwCurrentSection = pi->rgLinks[i].dwSection;
         }
 
         // Inserting lines we read before the current value if appropriate
-        while (pi->rgivValues[i].dwLineNumber > dwLineArrayIndex)
+        while (pi->rgivValues[i].dwLineNumber > dwLineArrayIndex && dwLineArrayIndex < pi->cLines)
         {
             // Skip any lines were purposely forgot
-            if (NULL == pi->rgsczLines[dwLineArrayIndex])
+            if (NULL == pi->rgwzLines[dwLineArrayIndex])
             {
                 ++dwLineArrayIndex;
                 continue;
             }
 
-            hr = StrAllocConcat(&sczContents, pi->rgsczLines[dwLineArrayIndex++], 0);
-            IniExitOnFailure(hr, "Failed to add previous line to ini output buffer in-memory");
+            hr = WriterAppend(&writer, pi->rgwzLines[dwLineArrayIndex++], 0);
+            IniExitOnFailure(hr, "Failed to add previous line to ini output");
 
-            hr = StrAllocConcat(&sczContents, L"\r\n", 2);
-            IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
+            hr = WriterAppend(&writer, L"\r\n", 2);
+            IniExitOnFailure(hr, "Failed to add endline to ini output");
         }
 
-        wzName = pi->rgivValues[i].wzName;
-        if (fSections)
-        {
-            wzName += lstrlenW(sczCurrentSectionPrefix);
-        }
-
-        // OK, now just write the name/value pair, if it isn't deleted
+        // OK, now just write the name/value pair
         if (pi->sczValuePrefix)
         {
-            hr = StrAllocConcat(&sczContents, pi->sczValuePrefix, 0);
-            IniExitOnFailure(hr, "Failed to concat value prefix to ini output buffer");
+            hr = WriterAppend(&writer, pi->sczValuePrefix, 0);
+            IniExitOnFailure(hr, "Failed to write value prefix");
         }
 
-        hr = StrAllocConcat(&sczContents, wzName, 0);
-        IniExitOnFailure(hr, "Failed to concat value name to ini output buffer");
+        hr = WriterAppend(&writer, pi->rgivValues[i].wzName + (fSections ? pSection->cchPrefix : 0), 0);
+        IniExitOnFailure(hr, "Failed to write value name");
 
-        hr = StrAllocConcat(&sczContents, pi->sczValueSeparator, 0);
-        IniExitOnFailure(hr, "Failed to concat value separator to ini output buffer");
+        hr = WriterAppend(&writer, pi->sczValueSeparator, 0);
+        IniExitOnFailure(hr, "Failed to write value separator");
 
-        hr = StrAllocConcat(&sczContents, pi->rgivValues[i].wzValue, 0);
-        IniExitOnFailure(hr, "Failed to concat value to ini output buffer");
-
-        hr = StrAllocConcat(&sczContents, L"\r\n", 2);
-        IniExitOnFailure(hr, "Failed to add endline to ini output buffer in-memory");
-    }
+        hr = WriterAppend(&writer, pi->rgivValues[i].wzValue, 0);
+        IniExitOnFailure(hr, "Failed to write value");
 
-    // If no path was specified, use the path to the file we parsed
-    if (NULL == wzPath)
-    {
-        wzPath = pi->sczPath;
+        hr = WriterAppend(&writer, L"\r\n", 2);
+        IniExitOnFailure(hr, "Failed to add endline to ini output");
     }
 
-    hr = FileFromString(wzPath, 0, sczContents, feEncoding);
+    hr = WriterFlush(&writer, TRUE);
     IniExitOnFailure(hr, "Failed to write INI contents out to file: %ls", wzPath);
 
 LExit:
-    ReleaseStr(sczContents);
-    ReleaseStr(sczCurrentSectionPrefix);
-    ReleaseStr(sczNewSectionPrefix);
+    WriterClose(&writer);
 
     return hr;
 }
 
-static void UninitializeIniValue(
-    INI_VALUE *pivValue
-    )
-{
-    ReleaseStr(const_cast<LPWSTR>(pivValue->wzName));
-    ReleaseStr(const_cast<LPWSTR>(pivValue->wzValue));
-}
-
 static HRESULT GetSectionPrefixFromName(
     __in_z LPCWSTR wzName,
     __deref_inout_z LPWSTR* psczOutput
@@ -766,3 +838,384 @@ static HRESULT GetSectionPrefixFromName(
 LExit:
     return hr;
 }
+
+static HRESULT EnsureIndex(
+    __in INI_STRUCT *pi,
+    __in DWORD dwNumExpectedItems
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!pi->shValues)
+    {
+        hr = DictCreateWithEmbeddedKey(&pi->shValues, dwNumExpectedItems, reinterpret_cast<void **>(&pi->rgivValues), offsetof(INI_VALUE, wzName), DICT_FLAG_NONE);
+        IniExitOnFailure(hr, "Failed to create INI value dictionary");
+    }
+
+    if (!pi->shSections)
+    {
+        hr = DictCreateWithEmbeddedKey(&pi->shSections, 0, reinterpret_cast<void **>(&pi->rgSections), offsetof(INI_SECTION, wzPrefix), DICT_FLAG_NONE);
+        IniExitOnFailure(hr, "Failed to create INI section dictionary");
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT ArenaAllocString(
+    __in INI_STRUCT *pi,
+    __in_ecount(cchFirst) LPCWSTR wzFirst,
+    __in SIZE_T cchFirst,
+    __in_ecount_opt(cchSecond) LPCWSTR wzSecond,
+    __in SIZE_T cchSecond,
+    __out LPCWSTR *pwzResult
+    )
+{
+    HRESULT hr = S_OK;
+    INI_ARENA_BLOCK *pBlock = pi->pArena;
+    SIZE_T cchNeeded = cchFirst + cchSecond + 1;
+    SIZE_T cchSize = 0;
+    LPWSTR wz = NULL;
+
+    if (!pBlock || pBlock->cchSize - pBlock->cchUsed < cchNeeded)
+    {
+        cchSize = max(INI_ARENA_BLOCK_CCH, cchNeeded);
+
+        pBlock = static_cast<INI_ARENA_BLOCK *>(MemAlloc(offsetof(INI_ARENA_BLOCK, rgwz) + cchSize * sizeof(WCHAR), FALSE));
+        IniExitOnNull(pBlock, hr, E_OUTOFMEMORY, "Failed to allocate INI string block");
+
+        // Whatever is left in the previous block is abandoned
+        pBlock->pNext = pi->pArena;
+        pBlock->cchUsed = 0;
+        pBlock->cchSize = cchSize;
+        pi->pArena = pBlock;
+    }
+
+    wz = pBlock->rgwz + pBlock->cchUsed;
+    pBlock->cchUsed += cchNeeded;
+
+    memcpy_s(wz, cchNeeded * sizeof(WCHAR), wzFirst, cchFirst * sizeof(WCHAR));
+    if (cchSecond)
+    {
+        memcpy_s(wz + cchFirst, (cchNeeded - cchFirst) * sizeof(WCHAR), wzSecond, cchSecond * sizeof(WCHAR));
+    }
+    wz[cchFirst + cchSecond] = L'\0';
+
+    *pwzResult = wz;
+
+LExit:
+    return hr;
+}
+
+static LPWSTR TrimWhitespaceInPlace(
+    __in LPWSTR wzStart,
+    __in LPWSTR wzEnd,
+    __in BOOL fTrimLeading
+    )
+{
+    if (fTrimLeading)
+    {
+        while (wzStart < wzEnd && (L' ' == *wzStart || L'\t' == *wzStart))
+        {
+            ++wzStart;
+        }
+    }
+
+    while (wzEnd > wzStart && (L' ' == *(wzEnd - 1) || L'\t' == *(wzEnd - 1)))
+    {
+        --wzEnd;
+    }
+
+    *wzEnd = L'\0';
+
+    return wzStart;
+}
+
+static HRESULT GetSectionIndex(
+    __in INI_STRUCT *pi,
+    __in_z LPCWSTR wzName,
+    __out DWORD *pdwSection
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczPrefix = NULL;
+    INI_SECTION *pSection = NULL;
+    DWORD cchPrefix = 0;
+    LPCWSTR wzPrefix = NULL;
+
+    hr = GetSectionPrefixFromName(wzName, &sczPrefix);
+    IniExitOnFailure(hr, "Failed to get section prefix from name: %ls", wzName);
+
+    if (!sczPrefix)
+    {
+        if (INI_NONE == pi->dwRootSection)
+        {
+            hr = MemEnsureArraySizeForNewItems(reinterpret_cast<void **>(&pi->rgSections), pi->cSections, 1, sizeof(INI_SECTION), 10);
+            IniExitOnFailure(hr, "Failed to grow INI section array");
+
+            pSection = pi->rgSections + pi->cSections;
+            pSection->wzPrefix = NULL;
+            pSection->cchPrefix = 0;
+            pSection->dwTail = INI_NONE;
+            pSection->fRunClosed = FALSE;
+
+            pi->dwRootSection = pi->cSections;
+            ++pi->cSections;
+        }
+
+        *pdwSection = pi->dwRootSection;
+        ExitFunction();
+    }
+
+    hr = DictGetValue(pi->shSections, sczPrefix, reinterpret_cast<void **>(&pSection));
+    if (E_NOTFOUND == hr)
+    {
+        cchPrefix = lstrlenW(sczPrefix);
+
+        hr = ArenaAllocString(pi, sczPrefix, cchPrefix, NULL, 0, &wzPrefix);
+        IniExitOnFailure(hr, "Failed to copy section prefix");
+
+        hr = MemEnsureArraySizeForNewItems(reinterpret_cast<void **>(&pi->rgSections), pi->cSections, 1, sizeof(INI_SECTION), 10);
+        IniExitOnFailure(hr, "Failed to grow INI section array");
+
+        pSection = pi->rgSections + pi->cSections;
+        pSection->wzPrefix = wzPrefix;
+        pSection->cchPrefix = cchPrefix;
+        pSection->dwTail = INI_NONE;
+        pSection->fRunClosed = FALSE;
+        ++pi->cSections;
+
+        hr = DictAddValue(pi->shSections, pSection);
+        IniExitOnFailure(hr, "Failed to index section: %ls", sczPrefix);
+    }
+    IniExitOnFailure(hr, "Failed to check for INI section: %ls", sczPrefix);
+
+    *pdwSection = static_cast<DWORD>(pSection - pi->rgSections);
+
+LExit:
+    ReleaseStr(sczPrefix);
+
+    return hr;
+}
+
+static HRESULT AddValue(
+    __in INI_STRUCT *pi,
+    __in_z LPCWSTR wzName,
+    __in_z LPCWSTR wzValue,
+    __in DWORD dwLineNumber,
+    __out DWORD *pdwIndex
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwIndex = pi->cValues;
+    DWORD dwSection = INI_NONE;
+    INI_SECTION *pSection = NULL;
+    INI_VALUE_LINK *pLink = NULL;
+
+    // Consecutive values are almost always in the same section
+    if (INI_NONE != pi->dwLastSection && pi->rgSections[pi->dwLastSection].wzPrefix && 0 == wcsncmp(wzName, pi->rgSections[pi->dwLastSection].wzPrefix, pi->rgSections[pi->dwLastSection].cchPrefix)
+        && (wcsstr(wzName, wzSectionSeparator) == wzName + pi->rgSections[pi->dwLastSection].cchPrefix - 1))
+    {
+        dwSection = pi->dwLastSection;
+    }
+    else
+    {
+        hr = GetSectionIndex(pi, wzName, &dwSection);
+        IniExitOnFailure(hr, "Failed to get section of value: %ls", wzName);
+
+        pi->dwLastSection = dwSection;
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<void **>(&pi->rgivValues), pi->cValues, 1, sizeof(INI_VALUE), 100);
+    IniExitOnFailure(hr, "Failed to increase array size for value array");
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<void **>(&pi->rgLinks), pi->cValues, 1, sizeof(INI_VALUE_LINK), 100);
+    IniExitOnFailure(hr, "Failed to increase array size for value order");
+
+    pi->rgivValues[dwIndex].wzName = wzName;
+    pi->rgivValues[dwIndex].wzValue = wzValue;
+    pi->rgivValues[dwIndex].dwLineNumber = dwLineNumber;
+    ++pi->cValues;
+
+    hr = DictAddValue(pi->shValues, pi->rgivValues + dwIndex);
+    IniExitOnFailure(hr, "Failed to index value: %ls", wzName);
+
+    pSection = pi->rgSections + dwSection;
+    pLink = pi->rgLinks + dwIndex;
+    pLink->dwSection = dwSection;
+    pLink->dwNext = INI_NONE;
+
+    if (dwLineNumber && INI_NONE != pi->dwLastValue && pi->rgLinks[pi->dwLastValue].dwSection != dwSection)
+    {
+        // Parsing moved on to another section, so later values of the previous one don't extend its first run
+        pi->rgSections[pi->rgLinks[pi->dwLastValue].dwSection].fRunClosed = TRUE;
+    }
+
+    if (dwLineNumber || INI_NONE == pSection->dwTail)
+    {
+        // Parsed values keep the order of the file
+        if (INI_NONE == pi->dwLastValue)
+        {
+            pi->dwFirstValue = dwIndex;
+        }
+        else
+        {
+            pi->rgLinks[pi->dwLastValue].dwNext = dwIndex;
+        }
+        pi->dwLastValue = dwIndex;
+    }
+    else
+    {
+        // New values go right after the first run of values in their section
+        pLink->dwNext = pi->rgLinks[pSection->dwTail].dwNext;
+        pi->rgLinks[pSection->dwTail].dwNext = dwIndex;
+
+        if (pi->dwLastValue == pSection->dwTail)
+        {
+            pi->dwLastValue = dwIndex;
+        }
+    }
+
+    if (!pSection->fRunClosed)
+    {
+        pSection->dwTail = dwIndex;
+    }
+
+    *pdwIndex = dwIndex;
+
+LExit:
+    return hr;
+}
+
+static HRESULT WriterOpen(
+    __in INI_WRITER *pWriter,
+    __in_z LPCWSTR wzPath,
+    __in FILE_ENCODING feEncoding
+    )
+{
+    HRESULT hr = S_OK;
+    const BYTE rgbUtf8Bom[] = { 0xEF, 0xBB, 0xBF };
+    const BYTE rgbUtf16Bom[] = { 0xFF, 0xFE };
+
+    pWriter->feEncoding = feEncoding;
+
+    pWriter->rgwcBuffer = static_cast<LPWSTR>(MemAlloc(INI_WRITE_BUFFER_CCH * sizeof(WCHAR), FALSE));
+    IniExitOnNull(pWriter->rgwcBuffer, hr, E_OUTOFMEMORY, "Failed to allocate INI write buffer");
+
+    if (FILE_ENCODING_UTF8 == feEncoding || FILE_ENCODING_UTF8_WITH_BOM == feEncoding)
+    {
+        // A UTF-16 code unit never takes more than three UTF-8 bytes
+        pWriter->rgbUtf8 = static_cast<LPSTR>(MemAlloc(INI_WRITE_BUFFER_CCH * 3, FALSE));
+        IniExitOnNull(pWriter->rgbUtf8, hr, E_OUTOFMEMORY, "Failed to allocate INI UTF-8 write buffer");
+    }
+
+    pWriter->hFile = ::CreateFileW(wzPath, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, NULL);
+    IniExitOnInvalidHandleWithLastError(pWriter->hFile, hr, "Failed to open file: %ls", wzPath);
+
+    if (FILE_ENCODING_UTF8_WITH_BOM == feEncoding)
+    {
+        hr = FileWriteHandle(pWriter->hFile, rgbUtf8Bom, sizeof(rgbUtf8Bom));
+        IniExitOnFailure(hr, "Failed to write UTF-8 byte order mark");
+    }
+    else if (FILE_ENCODING_UTF16_WITH_BOM == feEncoding)
+    {
+        hr = FileWriteHandle(pWriter->hFile, rgbUtf16Bom, sizeof(rgbUtf16Bom));
+        IniExitOnFailure(hr, "Failed to write UTF-16 byte order mark");
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT WriterAppend(
+    __in INI_WRITER *pWriter,
+    __in_ecount_opt(cch) LPCWSTR wz,
+    __in SIZE_T cch
+    )
+{
+    HRESULT hr = S_OK;
+    SIZE_T cchCopy = 0;
+
+    if (!wz)
+    {
+        ExitFunction();
+    }
+
+    if (!cch)
+    {
+        cch = lstrlenW(wz);
+    }
+
+    while (cch)
+    {
+        if (INI_WRITE_BUFFER_CCH == pWriter->cchBuffer)
+        {
+            hr = WriterFlush(pWriter, FALSE);
+            IniExitOnFailure(hr, "Failed to flush INI write buffer");
+        }
+
+        cchCopy = min(cch, INI_WRITE_BUFFER_CCH - pWriter->cchBuffer);
+        memcpy_s(pWriter->rgwcBuffer + pWriter->cchBuffer, (INI_WRITE_BUFFER_CCH - pWriter->cchBuffer) * sizeof(WCHAR), wz, cchCopy * sizeof(WCHAR));
+
+        pWriter->cchBuffer += static_cast<DWORD>(cchCopy);
+        wz += cchCopy;
+        cch -= cchCopy;
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT WriterFlush(
+    __in INI_WRITER *pWriter,
+    __in BOOL fFinal
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cchFlush = pWriter->cchBuffer;
+    int cbUtf8 = 0;
+
+    if (FILE_ENCODING_UTF8 == pWriter->feEncoding || FILE_ENCODING_UTF8_WITH_BOM == pWriter->feEncoding)
+    {
+        // Keep a high surrogate for the next flush so the pair is converted together
+        if (!fFinal && cchFlush && IS_HIGH_SURROGATE(pWriter->rgwcBuffer[cchFlush - 1]))
+        {
+            --cchFlush;
+        }
+
+        if (cchFlush)
+        {
+            cbUtf8 = ::WideCharToMultiByte(CP_UTF8, 0, pWriter->rgwcBuffer, cchFlush, pWriter->rgbUtf8, INI_WRITE_BUFFER_CCH * 3, NULL, NULL);
+            if (!cbUtf8)
+            {
+                IniExitWithLastError(hr, "Failed to convert INI contents to UTF-8");
+            }
+
+            hr = FileWriteHandle(pWriter->hFile, reinterpret_cast<LPCBYTE>(pWriter->rgbUtf8), cbUtf8);
+            IniExitOnFailure(hr, "Failed to write INI contents");
+        }
+    }
+    else if (cchFlush)
+    {
+        hr = FileWriteHandle(pWriter->hFile, reinterpret_cast<LPCBYTE>(pWriter->rgwcBuffer), cchFlush * sizeof(WCHAR));
+        IniExitOnFailure(hr, "Failed to write INI contents");
+    }
+
+    if (cchFlush < pWriter->cchBuffer)
+    {
+        pWriter->rgwcBuffer[0] = pWriter->rgwcBuffer[cchFlush];
+    }
+    pWriter->cchBuffer -= cchFlush;
+
+LExit:
+    return hr;
+}
+
+static void WriterClose(
+    __in INI_WRITER *pWriter
+    )
+{
+    ReleaseFile(pWriter->hFile);
+    ReleaseMem(pWriter->rgwcBuffer);
+    ReleaseMem(pWriter->rgbUtf8);
+}
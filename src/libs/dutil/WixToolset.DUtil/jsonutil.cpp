@@ -9,6 +9,7 @@
 #define JsonExitWithLastError(x, s, ...) ExitWithLastErrorSource(DUTIL_SOURCE_JSONUTIL, x, s, __VA_ARGS__)
 #define JsonExitOnFailure(x, s, ...) ExitOnFailureSource(DUTIL_SOURCE_JSONUTIL, x, s, __VA_ARGS__)
 #define JsonExitOnRootFailure(x, s, ...) ExitOnRootFailureSource(DUTIL_SOURCE_JSONUTIL, x, s, __VA_ARGS__)
+#define JsonExitWithRootFailure(x, e, s, ...) ExitWithRootFailureSource(DUTIL_SOURCE_JSONUTIL, x, e, s, __VA_ARGS__)
 #define JsonExitOnFailureDebugTrace(x, s, ...) ExitOnFailureDebugTraceSource(DUTIL_SOURCE_JSONUTIL, x, s, __VA_ARGS__)
 #define JsonExitOnNull(p, x, e, s, ...) ExitOnNullSource(DUTIL_SOURCE_JSONUTIL, p, x, e, s, __VA_ARGS__)
 #define JsonExitOnNullWithLastError(p, x, s, ...) ExitOnNullWithLastErrorSource(DUTIL_SOURCE_JSONUTIL, p, x, s, __VA_ARGS__)
@@ -18,8 +19,69 @@
 #define JsonExitOnGdipFailure(g, x, s, ...) ExitOnGdipFailureSource(DUTIL_SOURCE_JSONUTIL, g, x, s, __VA_ARGS__)
 
 const DWORD JSON_STACK_INCREMENT = 5;
+const SIZE_T JSON_READ_BUFFER_SIZE = 64 * 1024;
+const SIZE_T JSON_WRITE_BUFFER_SIZE = 64 * 1024;
+const SIZE_T JSON_MIN_STRING_SIZE = 256;
+
+static volatile LONG vcJsonInitialized = 0;
+static _locale_t vpNumericLocale = NULL;
 
 // Prototypes
+static HRESULT FillBuffer(
+    __in JSON_READER* pReader
+    );
+static HRESULT EnsureBytes(
+    __in JSON_READER* pReader,
+    __in SIZE_T cbRequired
+    );
+static HRESULT SkipWhitespace(
+    __in JSON_READER* pReader
+    );
+static const BYTE* ScanWhitespace(
+    __in const BYTE* pb,
+    __in const BYTE* pbEnd
+    );
+static const BYTE* ScanString(
+    __in const BYTE* pb,
+    __in const BYTE* pbEnd
+    );
+static HRESULT ReadToken(
+    __in JSON_READER* pReader,
+    __out JSON_TOKEN* pToken,
+    __out JSON_VALUE* pValue
+    );
+static HRESULT ReadString(
+    __in JSON_READER* pReader,
+    __out JSON_VALUE* pValue
+    );
+static HRESULT ReadLiteral(
+    __in JSON_READER* pReader,
+    __out JSON_VALUE* pValue
+    );
+static HRESULT ReadNumber(
+    __in JSON_READER* pReader,
+    __out JSON_VALUE* pValue
+    );
+static HRESULT PushContainer(
+    __in JSON_READER* pReader,
+    __in BYTE bContainer
+    );
+static BOOL IsValidNumber(
+    __in_ecount(cch) LPCSTR pch,
+    __in SIZE_T cch
+    );
+static HRESULT ParseUnsigned(
+    __in const JSON_VALUE* pValue,
+    __out BOOL* pfNegative,
+    __out DWORD64* pqwValue
+    );
+static HRESULT WriterAppend(
+    __in JSON_WRITER* pWriter,
+    __in_z LPCWSTR wz
+    );
+static HRESULT WriterWriteBuffer(
+    __in JSON_WRITER* pWriter
+    );
 static HRESULT DoStart(
     __in JSON_WRITER* pWriter,
     __in JSON_TOKEN tokenStart,
@@ -48,22 +110,134 @@ static HRESULT SerializeJsonString(
 
 
 
+DAPI_(HRESULT) JsonInitialize()
+{
+    HRESULT hr = S_OK;
+    _locale_t locale = NULL;
+
+    LONG cInitialized = ::InterlockedIncrement(&vcJsonInitialized);
+    if (1 == cInitialized)
+    {
+        // JSON numbers always use '.' so they are parsed in the C locale regardless of the thread locale.
+        locale = ::_create_locale(LC_NUMERIC, "C");
+        if (!locale)
+        {
+            ::InterlockedDecrement(&vcJsonInitialized);
+            JsonExitWithRootFailure(hr, E_OUTOFMEMORY, "Failed to create numeric locale.");
+        }
+
+        vpNumericLocale = locale;
+    }
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(void) JsonUninitialize()
+{
+    AssertSz(vcJsonInitialized, "JsonUninitialize called when not initialized");
+
+    LONG cInitialized = ::InterlockedDecrement(&vcJsonInitialized);
+    if (0 == cInitialized)
+    {
+        _locale_t locale = vpNumericLocale;
+        vpNumericLocale = NULL;
+
+        if (locale)
+        {
+            ::_free_locale(locale);
+        }
+    }
+}
+
+
 DAPI_(HRESULT) JsonInitializeReader(
     __in_z LPCWSTR wzJson,
     __in JSON_READER* pReader
     )
 {
     HRESULT hr = S_OK;
+    LPSTR sczJson = NULL;
+
+    memset(pReader, 0, sizeof(JSON_READER));
+    ::InitializeCriticalSection(&pReader->cs);
+    pReader->hFile = INVALID_HANDLE_VALUE;
+
+    hr = StrAnsiAllocString(&sczJson, wzJson, 0, CP_UTF8);
+    JsonExitOnFailure(hr, "Failed to convert json string to UTF-8.");
+
+    pReader->pbBuffer = reinterpret_cast<BYTE*>(sczJson);
+    pReader->cbBuffer = lstrlenA(sczJson);
+    sczJson = NULL;
+
+    pReader->pbData = pReader->pbBuffer;
+    pReader->cbData = pReader->cbBuffer;
+    pReader->fComplete = TRUE;
+
+LExit:
+    ReleaseStr(sczJson);
+    return hr;
+}
+
+
+DAPI_(HRESULT) JsonInitializeReaderFromBuffer(
+    __in_bcount(cbJson) const BYTE* pbJson,
+    __in SIZE_T cbJson,
+    __in JSON_READER* pReader
+    )
+{
+    memset(pReader, 0, sizeof(JSON_READER));
+    ::InitializeCriticalSection(&pReader->cs);
+    pReader->hFile = INVALID_HANDLE_VALUE;
+
+    pReader->pbData = pbJson;
+    pReader->cbData = cbJson;
+    pReader->fComplete = TRUE;
+
+    // Skip the UTF-8 byte order mark.
+    if (3 <= cbJson && 0xEF == pbJson[0] && 0xBB == pbJson[1] && 0xBF == pbJson[2])
+    {
+        pReader->iData = 3;
+    }
+
+    return S_OK;
+}
+
+
+DAPI_(HRESULT) JsonInitializeReaderFromFile(
+    __in_z LPCWSTR wzPath,
+    __in JSON_READER* pReader
+    )
+{
+    HRESULT hr = S_OK;
 
     memset(pReader, 0, sizeof(JSON_READER));
     ::InitializeCriticalSection(&pReader->cs);
 
-    hr = StrAllocString(&pReader->sczJson, wzJson, 0);
-    JsonExitOnFailure(hr, "Failed to allocate json string.");
+    pReader->hFile = ::CreateFileW(wzPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    JsonExitOnInvalidHandleWithLastError(pReader->hFile, hr, "Failed to open json file: %ls", wzPath);
 
-    pReader->pwz = pReader->sczJson;
+    pReader->pbBuffer = static_cast<BYTE*>(MemAlloc(JSON_READ_BUFFER_SIZE, FALSE));
+    JsonExitOnNull(pReader->pbBuffer, hr, E_OUTOFMEMORY, "Failed to allocate json read buffer.");
+
+    pReader->cbBuffer = JSON_READ_BUFFER_SIZE;
+    pReader->pbData = pReader->pbBuffer;
+
+    hr = FillBuffer(pReader);
+    JsonExitOnFailure(hr, "Failed to read json file: %ls", wzPath);
+
+    if (3 <= pReader->cbData && 0xEF == pReader->pbData[0] && 0xBB == pReader->pbData[1] && 0xBF == pReader->pbData[2])
+    {
+        pReader->iData = 3;
+    }
 
 LExit:
+    if (FAILED(hr))
+    {
+        JsonUninitializeReader(pReader);
+    }
+
     return hr;
 }
 
@@ -72,127 +246,320 @@ DAPI_(void) JsonUninitializeReader(
     __in JSON_READER* pReader
     )
 {
-    ReleaseStr(pReader->sczJson);
+    ReleaseFileHandle(pReader->hFile);
+    ReleaseMem(pReader->pbBuffer);
+    ReleaseMem(pReader->rgbContainers);
 
     ::DeleteCriticalSection(&pReader->cs);
     memset(pReader, 0, sizeof(JSON_READER));
 }
 
 
-static HRESULT NextToken(
+DAPI_(HRESULT) JsonReadNext(
     __in JSON_READER* pReader,
-    __out JSON_TOKEN* pToken
+    __out JSON_TOKEN* pToken,
+    __out JSON_VALUE* pValue
     )
 {
     HRESULT hr = S_OK;
 
-    // Skip whitespace.
-    while (L' ' == *pReader->pwz ||
-        L'\t' == *pReader->pwz ||
-        L'\r' == *pReader->pwz ||
-        L'\n' == *pReader->pwz ||
-        L',' == *pReader->pwz)
+    ::EnterCriticalSection(&pReader->cs);
+
+    memset(pValue, 0, sizeof(JSON_VALUE));
+    *pToken = JSON_TOKEN_NONE;
+
+    hr = ReadToken(pReader, pToken, pValue);
+    if (E_NOMOREITEMS == hr)
     {
-        ++pReader->pwz;
+        ExitFunction();
     }
+    JsonExitOnFailure(hr, "Failed to read next token.");
+
+    pReader->token = *pToken;
+
+LExit:
+    ::LeaveCriticalSection(&pReader->cs);
+    return hr;
+}
+
+
+DAPI_(HRESULT) JsonReadValue(
+    __in JSON_READER* pReader,
+    __in JSON_VALUE* pValue
+    )
+{
+    HRESULT hr = S_OK;
+    JSON_TOKEN token = JSON_TOKEN_NONE;
 
-    switch (*pReader->pwz)
+    hr = JsonReadNext(pReader, &token, pValue);
+    if (E_NOMOREITEMS == hr)
     {
-    case L'{':
-        *pToken = JSON_TOKEN_OBJECT_START;
-        break;
+        ExitFunction();
+    }
+    JsonExitOnFailure(hr, "Failed to read value.");
 
-    case L':': // begin object value
-        *pToken = JSON_TOKEN_OBJECT_VALUE;
-        break;
+    if (JSON_TOKEN_VALUE != token)
+    {
+        JsonExitWithRootFailure(hr, E_INVALIDDATA, "Expected a JSON value but found token: %d", token);
+    }
 
-    case L'}': // end object
-        *pToken = JSON_TOKEN_OBJECT_END;
-        break;
+LExit:
+    return hr;
+}
 
-    case L'[': // begin array
-        *pToken = JSON_TOKEN_ARRAY_START;
-        break;
 
-    case L']': // end array
-        *pToken = JSON_TOKEN_ARRAY_END;
-        break;
+DAPI_(HRESULT) JsonValueGetString(
+    __in const JSON_VALUE* pValue,
+    __deref_out_z LPWSTR* psczValue
+    )
+{
+    HRESULT hr = S_OK;
+    LPCSTR pch = pValue->pch;
+    LPCSTR pchEnd = pValue->pch + pValue->cch;
+    LPWSTR pwz = NULL;
+    int cchWide = 0;
 
-    case L'"': // string
-        *pToken = JSON_TOKEN_OBJECT_START == *pToken ? JSON_TOKEN_VALUE : JSON_TOKEN_OBJECT_KEY;
-        break;
+    if (JSON_VALUE_TYPE_STRING != pValue->type)
+    {
+        JsonExitWithRootFailure(hr, E_INVALIDDATA, "JSON value is not a string.");
+    }
+    else if (INT_MAX <= pValue->cch)
+    {
+        JsonExitWithRootFailure(hr, E_INVALIDDATA, "JSON string is too long.");
+    }
 
-    case L't': // true
-    case L'f': // false
-    case L'n': // null
-    case L'-': // number
-    case L'0':
-    case L'1':
-    case L'2':
-    case L'3':
-    case L'4':
-    case L'5':
-    case L'6':
-    case L'7':
-    case L'8':
-    case L'9':
-        *pToken = JSON_TOKEN_VALUE;
-        break;
+    // UTF-8 never decodes to more UTF-16 code units than it has bytes, and escapes only get shorter.
+    hr = StrAlloc(psczValue, pValue->cch + 1);
+    JsonExitOnFailure(hr, "Failed to allocate JSON string.");
 
-    case L'\0':
-        hr = E_NOMOREITEMS;
-        break;
+    pwz = *psczValue;
 
-    default:
-        hr = E_INVALIDSTATE;
+    while (pch < pchEnd)
+    {
+        LPCSTR pchRun = pch;
+
+        while (pch < pchEnd && '\\' != *pch)
+        {
+            ++pch;
+        }
+
+        if (pch > pchRun)
+        {
+            cchWide = ::MultiByteToWideChar(CP_UTF8, 0, pchRun, static_cast<int>(pch - pchRun), pwz, static_cast<int>(pValue->cch + 1 - (pwz - *psczValue)));
+            JsonExitOnNullWithLastError(cchWide, hr, "Failed to convert JSON string from UTF-8.");
+
+            pwz += cchWide;
+        }
+
+        if (pch < pchEnd)
+        {
+            WCHAR wch = 0;
+
+            ++pch;
+            if (pch == pchEnd)
+            {
+                JsonExitWithRootFailure(hr, E_INVALIDDATA, "JSON string ends with an incomplete escape.");
+            }
+
+            switch (*pch)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                wch = *pch;
+                break;
+
+            case 'b':
+                wch = L'\b';
+                break;
+
+            case 'f':
+                wch = L'\f';
+                break;
+
+            case 'n':
+                wch = L'\n';
+                break;
+
+            case 'r':
+                wch = L'\r';
+                break;
+
+            case 't':
+                wch = L'\t';
+                break;
+
+            case 'u':
+                // Unicode escapes are UTF-16 code units so surrogate pairs need no special handling.
+                if (4 >= pchEnd - pch)
+                {
+                    JsonExitWithRootFailure(hr, E_INVALIDDATA, "JSON string has an incomplete unicode escape.");
+                }
+
+                for (DWORD i = 0; i < 4; ++i)
+                {
+                    CHAR ch = *(++pch);
+
+                    wch <<= 4;
+                    if ('0' <= ch && '9' >= ch)
+                    {
+                        wch |= ch - '0';
+                    }
+                    else if ('a' <= ch && 'f' >= ch)
+                    {
+                        wch |= ch - 'a' + 10;
+                    }
+                    else if ('A' <= ch && 'F' >= ch)
+                    {
+                        wch |= ch - 'A' + 10;
+                    }
+                    else
+                    {
+                        JsonExitWithRootFailure(hr, E_INVALIDDATA, "JSON string has an invalid unicode escape.");
+                    }
+                }
+                break;
+
+            default:
+                JsonExitWithRootFailure(hr, E_INVALIDDATA, "JSON string has an invalid escape: %hc", *pch);
+            }
+
+            *pwz = wch;
+            ++pwz;
+            ++pch;
+        }
     }
 
+    *pwz = L'\0';
+
+LExit:
     return hr;
 }
 
 
-DAPI_(HRESULT) JsonReadNext(
-    __in JSON_READER* pReader,
-    __out JSON_TOKEN* pToken,
-    __out JSON_VALUE* pValue
+DAPI_(HRESULT) JsonValueGetBool(
+    __in const JSON_VALUE* pValue,
+    __out BOOL* pfValue
     )
 {
     HRESULT hr = S_OK;
-    //WCHAR wz;
-    //JSON_TOKEN token = JSON_TOKEN_NONE;
 
-    ::EnterCriticalSection(&pReader->cs);
+    if (JSON_VALUE_TYPE_BOOL != pValue->type)
+    {
+        JsonExitWithRootFailure(hr, E_INVALIDDATA, "JSON value is not a boolean.");
+    }
 
-    hr = NextToken(pReader, pToken);
-    if (E_NOMOREITEMS == hr)
+    *pfValue = 't' == *pValue->pch;
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(HRESULT) JsonValueGetNumber(
+    __in const JSON_VALUE* pValue,
+    __out DWORD* pdwValue
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD64 qwValue = 0;
+
+    hr = JsonValueGetNumber64(pValue, &qwValue);
+    JsonExitOnFailure(hr, "Failed to get JSON number.");
+
+    hr = ::ULongLongToDWord(qwValue, pdwValue);
+    JsonExitOnRootFailure(hr, "JSON number does not fit in 32 bits.");
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(HRESULT) JsonValueGetNumber64(
+    __in const JSON_VALUE* pValue,
+    __out DWORD64* pqwValue
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fNegative = FALSE;
+
+    hr = ParseUnsigned(pValue, &fNegative, pqwValue);
+    JsonExitOnFailure(hr, "Failed to parse JSON number.");
+
+    if (fNegative && *pqwValue)
     {
-        ExitFunction();
+        JsonExitWithRootFailure(hr, HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), "JSON number is negative.");
     }
-    JsonExitOnFailure(hr, "Failed to get next token.");
 
-    if (JSON_TOKEN_VALUE == *pToken)
+LExit:
+    return hr;
+}
+
+
+DAPI_(HRESULT) JsonValueGetInteger64(
+    __in const JSON_VALUE* pValue,
+    __out LONGLONG* pllValue
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fNegative = FALSE;
+    DWORD64 qwValue = 0;
+
+    hr = ParseUnsigned(pValue, &fNegative, &qwValue);
+    JsonExitOnFailure(hr, "Failed to parse JSON number.");
+
+    if (fNegative)
     {
-        hr = JsonReadValue(pReader, pValue);
+        if (qwValue > static_cast<DWORD64>(LLONG_MAX) + 1)
+        {
+            JsonExitWithRootFailure(hr, HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), "JSON number is too small.");
+        }
+
+        *pllValue = static_cast<LONGLONG>(0 - qwValue);
     }
     else
     {
-        ++pReader->pwz;
+        hr = ::ULongLongToLongLong(qwValue, pllValue);
+        JsonExitOnRootFailure(hr, "JSON number is too large.");
     }
 
 LExit:
-    ::LeaveCriticalSection(&pReader->cs);
     return hr;
 }
 
 
-DAPI_(HRESULT) JsonReadValue(
-    __in JSON_READER* /*pReader*/,
-    __in JSON_VALUE* /*pValue*/
+DAPI_(HRESULT) JsonValueGetDouble(
+    __in const JSON_VALUE* pValue,
+    __out double* pdValue
     )
 {
     HRESULT hr = S_OK;
+    CHAR szNumber[64] = { };
+    LPSTR sczNumber = NULL;
+    LPSTR pszNumber = szNumber;
+    if (JSON_VALUE_TYPE_NUMBER != pValue->type)
+    {
+        JsonExitWithRootFailure(hr, E_INVALIDDATA, "JSON value is not a number.");
+    }
+
+    // The view is not null terminated so copy it, to the stack when it fits.
+    if (countof(szNumber) <= pValue->cch)
+    {
+        hr = StrAnsiAlloc(&sczNumber, pValue->cch + 1);
+        JsonExitOnFailure(hr, "Failed to allocate JSON number.");
+
+        pszNumber = sczNumber;
+    }
+
+    memcpy(pszNumber, pValue->pch, pValue->cch);
+    pszNumber[pValue->cch] = '\0';
 
-//LExit:
+    JsonExitOnNull(vpNumericLocale, hr, E_UNEXPECTED, "JsonInitialize() must be called before parsing JSON numbers.");
+
+    *pdValue = ::_strtod_l(pszNumber, NULL, vpNumericLocale);
+
+LExit:
+    ReleaseStr(sczNumber);
     return hr;
 }
 
@@ -203,15 +570,66 @@ DAPI_(HRESULT) JsonInitializeWriter(
 {
     memset(pWriter, 0, sizeof(JSON_WRITER));
     ::InitializeCriticalSection(&pWriter->cs);
+    pWriter->hFile = INVALID_HANDLE_VALUE;
 
     return S_OK;
 }
 
 
+DAPI_(HRESULT) JsonInitializeWriterToFile(
+    __in_z LPCWSTR wzPath,
+    __in JSON_WRITER* pWriter
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = JsonInitializeWriter(pWriter);
+    JsonExitOnFailure(hr, "Failed to initialize JSON writer.");
+
+    pWriter->hFile = ::CreateFileW(wzPath, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    JsonExitOnInvalidHandleWithLastError(pWriter->hFile, hr, "Failed to create json file: %ls", wzPath);
+
+    pWriter->pbBuffer = static_cast<BYTE*>(MemAlloc(JSON_WRITE_BUFFER_SIZE, FALSE));
+    JsonExitOnNull(pWriter->pbBuffer, hr, E_OUTOFMEMORY, "Failed to allocate JSON write buffer.");
+
+    pWriter->cbBuffer = JSON_WRITE_BUFFER_SIZE;
+
+LExit:
+    if (FAILED(hr))
+    {
+        JsonUninitializeWriter(pWriter);
+    }
+
+    return hr;
+}
+
+
+DAPI_(HRESULT) JsonFlushWriter(
+    __in JSON_WRITER* pWriter
+    )
+{
+    HRESULT hr = S_OK;
+
+    ::EnterCriticalSection(&pWriter->cs);
+
+    if (INVALID_HANDLE_VALUE != pWriter->hFile)
+    {
+        hr = WriterWriteBuffer(pWriter);
+        JsonExitOnFailure(hr, "Failed to flush JSON writer.");
+    }
+
+LExit:
+    ::LeaveCriticalSection(&pWriter->cs);
+    return hr;
+}
+
+
 DAPI_(void) JsonUninitializeWriter(
     __in JSON_WRITER* pWriter
     )
 {
+    ReleaseFileHandle(pWriter->hFile);
+    ReleaseMem(pWriter->pbBuffer);
     ReleaseMem(pWriter->rgTokenStack);
     ReleaseStr(pWriter->sczJson);
 
@@ -260,6 +678,26 @@ LExit:
 }
 
 
+DAPI_(HRESULT) JsonWriteNumber64(
+    __in JSON_WRITER* pWriter,
+    __in DWORD64 qwValue
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczValue = NULL;
+
+    hr = StrAllocFormatted(&sczValue, L"%I64u", qwValue);
+    JsonExitOnFailure(hr, "Failed to convert 64-bit number to string.");
+
+    hr = DoValue(pWriter, sczValue);
+    JsonExitOnFailure(hr, "Failed to add 64-bit number to JSON.");
+
+LExit:
+    ReleaseStr(sczValue);
+    return hr;
+}
+
+
 DAPI_(HRESULT) JsonWriteString(
     __in JSON_WRITER* pWriter,
     __in_z LPCWSTR wzValue
@@ -386,7 +824,11 @@ static HRESULT DoStart(
         token = JSON_TOKEN_ARRAY_VALUE;
         break;
 
-    case JSON_TOKEN_ARRAY_VALUE:
+    case JSON_TOKEN_OBJECT_KEY: // object key changes to object value.
+        token = JSON_TOKEN_OBJECT_VALUE;
+        break;
+
+    case JSON_TOKEN_ARRAY_VALUE:
     case JSON_TOKEN_ARRAY_END:
     case JSON_TOKEN_OBJECT_END:
         fNeedComma = TRUE;
@@ -400,11 +842,11 @@ static HRESULT DoStart(
 
     if (fNeedComma)
     {
-        hr = StrAllocConcat(&pWriter->sczJson, L",", 0);
+        hr = WriterAppend(pWriter, L",");
         JsonExitOnFailure(hr, "Failed to add comma for start array or object to JSON.");
     }
 
-    hr = StrAllocConcat(&pWriter->sczJson, wzStartString, 0);
+    hr = WriterAppend(pWriter, wzStartString);
     JsonExitOnFailure(hr, "Failed to start JSON array or object.");
 
     pWriter->rgTokenStack[pWriter->cTokens - 1] = token;
@@ -446,7 +888,7 @@ static HRESULT DoEnd(
         }
     }
 
-    hr = StrAllocConcat(&pWriter->sczJson, wzEndString, 0);
+    hr = WriterAppend(pWriter, wzEndString);
     JsonExitOnFailure(hr, "Failed to end JSON array or object.");
 
     --pWriter->cTokens;
@@ -491,11 +933,11 @@ static HRESULT DoKey(
 
     if (fNeedComma)
     {
-        hr = StrAllocConcat(&pWriter->sczJson, L",", 0);
+        hr = WriterAppend(pWriter, L",");
         JsonExitOnFailure(hr, "Failed to add comma for key to JSON.");
     }
 
-    hr = StrAllocConcat(&pWriter->sczJson, wzKey, 0);
+    hr = WriterAppend(pWriter, wzKey);
     JsonExitOnFailure(hr, "Failed to add key to JSON.");
 
     pWriter->rgTokenStack[pWriter->cTokens - 1] = token;
@@ -547,18 +989,18 @@ static HRESULT DoValue(
 
     if (fNeedComma)
     {
-        hr = StrAllocConcat(&pWriter->sczJson, L",", 0);
+        hr = WriterAppend(pWriter, L",");
         JsonExitOnFailure(hr, "Failed to add comma for value to JSON.");
     }
 
     if (wzValue)
     {
-        hr = StrAllocConcat(&pWriter->sczJson, wzValue, 0);
+        hr = WriterAppend(pWriter, wzValue);
         JsonExitOnFailure(hr, "Failed to add value to JSON.");
     }
     else
     {
-        hr = StrAllocConcat(&pWriter->sczJson, L"null", 0);
+        hr = WriterAppend(pWriter, L"null");
         JsonExitOnFailure(hr, "Failed to add null value to JSON.");
     }
 
@@ -685,3 +1127,679 @@ static HRESULT SerializeJsonString(
 LExit:
     return hr;
 }
+
+
+static HRESULT FillBuffer(
+    __in JSON_READER* pReader
+    )
+{
+    HRESULT hr = S_OK;
+    BYTE* pbNew = NULL;
+    DWORD cbRead = 0;
+
+    // Everything before the current token has been consumed so slide the rest to the front.
+    if (pReader->iData)
+    {
+        memmove(pReader->pbBuffer, pReader->pbBuffer + pReader->iData, pReader->cbData - pReader->iData);
+        pReader->cbData -= pReader->iData;
+        pReader->iData = 0;
+    }
+
+    // A single token larger than the buffer grows it.
+    if (pReader->cbData == pReader->cbBuffer)
+    {
+        pbNew = static_cast<BYTE*>(MemReAlloc(pReader->pbBuffer, pReader->cbBuffer * 2, FALSE));
+        JsonExitOnNull(pbNew, hr, E_OUTOFMEMORY, "Failed to grow json read buffer.");
+
+        pReader->pbBuffer = pbNew;
+        pReader->pbData = pbNew;
+        pReader->cbBuffer *= 2;
+    }
+
+    if (!::ReadFile(pReader->hFile, pReader->pbBuffer + pReader->cbData, static_cast<DWORD>(min(pReader->cbBuffer - pReader->cbData, DWORD_MAX)), &cbRead, NULL))
+    {
+        JsonExitWithLastError(hr, "Failed to read json file.");
+    }
+
+    pReader->cbData += cbRead;
+    pReader->fComplete = 0 == cbRead;
+
+LExit:
+    return hr;
+}
+
+static HRESULT EnsureBytes(
+    __in JSON_READER* pReader,
+    __in SIZE_T cbRequired
+    )
+{
+    HRESULT hr = S_OK;
+
+    while (pReader->cbData - pReader->iData < cbRequired)
+    {
+        if (pReader->fComplete)
+        {
+            JsonExitWithRootFailure(hr, E_INVALIDDATA, "Unexpected end of JSON.");
+        }
+
+        hr = FillBuffer(pReader);
+        JsonExitOnFailure(hr, "Failed to read more JSON.");
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT SkipWhitespace(
+    __in JSON_READER* pReader
+    )
+{
+    HRESULT hr = S_OK;
+
+    for (;;)
+    {
+        const BYTE* pb = ScanWhitespace(pReader->pbData + pReader->iData, pReader->pbData + pReader->cbData);
+
+        pReader->iData = pb - pReader->pbData;
+        if (pReader->iData < pReader->cbData || pReader->fComplete)
+        {
+            break;
+        }
+
+        hr = FillBuffer(pReader);
+        JsonExitOnFailure(hr, "Failed to read more JSON.");
+    }
+
+LExit:
+    return hr;
+}
+
+static const BYTE* ScanWhitespace(
+    __in const BYTE* pb,
+    __in const BYTE* pbEnd
+    )
+{
+    // Most tokens are separated by at most one character so check that before using the vector scan.
+    if (pb < pbEnd && ' ' != *pb && '\t' != *pb && '\n' != *pb && '\r' != *pb)
+    {
+        return pb;
+    }
+
+#if defined(_M_IX86) || defined(_M_X64)
+    const __m128i vSpace = _mm_set1_epi8(' ');
+    const __m128i vTab = _mm_set1_epi8('\t');
+    const __m128i vLineFeed = _mm_set1_epi8('\n');
+    const __m128i vCarriageReturn = _mm_set1_epi8('\r');
+
+    while (16 <= pbEnd - pb)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb));
+        __m128i vWhitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, vSpace), _mm_cmpeq_epi8(v, vTab)), _mm_or_si128(_mm_cmpeq_epi8(v, vLineFeed), _mm_cmpeq_epi8(v, vCarriageReturn)));
+        DWORD dwMask = static_cast<DWORD>(_mm_movemask_epi8(vWhitespace)) ^ 0xFFFF;
+
+        if (dwMask)
+        {
+            DWORD dwIndex = 0;
+
+            _BitScanForward(&dwIndex, dwMask);
+            return pb + dwIndex;
+        }
+
+        pb += 16;
+    }
+#endif
+
+    while (pb < pbEnd && (' ' == *pb || '\t' == *pb || '\n' == *pb || '\r' == *pb))
+    {
+        ++pb;
+    }
+
+    return pb;
+}
+
+static const BYTE* ScanString(
+    __in const BYTE* pb,
+    __in const BYTE* pbEnd
+    )
+{
+#if defined(_M_IX86) || defined(_M_X64)
+    const __m128i vQuote = _mm_set1_epi8('"');
+    const __m128i vBackslash = _mm_set1_epi8('\\');
+    const __m128i vControl = _mm_set1_epi8(0x1F);
+
+    // Find the closing quote, an escape or a control character 16 bytes at a time. max(v, 0x1F) == 0x1F
+    // detects control characters with unsigned comparison so UTF-8 lead and trail bytes pass through.
+    while (16 <= pbEnd - pb)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb));
+        __m128i vSpecial = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, vQuote), _mm_cmpeq_epi8(v, vBackslash)), _mm_cmpeq_epi8(_mm_max_epu8(v, vControl), vControl));
+        DWORD dwMask = static_cast<DWORD>(_mm_movemask_epi8(vSpecial));
+
+        if (dwMask)
+        {
+            DWORD dwIndex = 0;
+
+            _BitScanForward(&dwIndex, dwMask);
+            return pb + dwIndex;
+        }
+
+        pb += 16;
+    }
+#endif
+
+    while (pb < pbEnd && '"' != *pb && '\\' != *pb && 0x1F < *pb)
+    {
+        ++pb;
+    }
+
+    return pb;
+}
+
+static HRESULT ReadToken(
+    __in JSON_READER* pReader,
+    __out JSON_TOKEN* pToken,
+    __out JSON_VALUE* pValue
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fValueComplete = JSON_TOKEN_VALUE == pReader->token || JSON_TOKEN_OBJECT_END == pReader->token || JSON_TOKEN_ARRAY_END == pReader->token;
+    BOOL fComma = FALSE;
+    BYTE bContainer = 0;
+    BYTE b = 0;
+
+    hr = SkipWhitespace(pReader);
+    JsonExitOnFailure(hr, "Failed to skip whitespace.");
+
+    if (pReader->iData == pReader->cbData)
+    {
+        if (fValueComplete && !pReader->cContainers)
+        {
+            ExitFunction1(hr = E_NOMOREITEMS);
+        }
+
+        JsonExitWithRootFailure(hr, E_INVALIDDATA, "Unexpected end of JSON.");
+    }
+
+    b = pReader->pbData[pReader->iData];
+
+    // Separators are consumed before the token that follows them so the views returned for the
+    // previous token stay valid until this read.
+    if (JSON_TOKEN_OBJECT_KEY == pReader->token)
+    {
+        if (':' != b)
+        {
+            JsonExitWithRootFailure(hr, E_INVALIDDATA, "Expected ':' after object key at offset: %Iu", pReader->iData);
+        }
+
+        ++pReader->iData;
+
+        hr = SkipWhitespace(pReader);
+        JsonExitOnFailure(hr, "Failed to skip whitespace.");
+
+        hr = EnsureBytes(pReader, 1);
+        JsonExitOnFailure(hr, "Failed to read object value.");
+
+        b = pReader->pbData[pReader->iData];
+    }
+    else if (fValueComplete)
+    {
+        if (!pReader->cContainers)
+        {
+            JsonExitWithRootFailure(hr, E_INVALIDDATA, "Unexpected data after JSON value at offset: %Iu", pReader->iData);
+        }
+
+        if (',' == b)
+        {
+            fComma = TRUE;
+            ++pReader->iData;
+
+            hr = SkipWhitespace(pReader);
+            JsonExitOnFailure(hr, "Failed to skip whitespace.");
+
+            hr = EnsureBytes(pReader, 1);
+            JsonExitOnFailure(hr, "Failed to read value after ','.");
+
+            b = pReader->pbData[pReader->iData];
+        }
+    }
+
+    bContainer = pReader->cContainers ? pReader->rgbContainers[pReader->cContainers - 1] : 0;
+
+    if (']' == b || '}' == b)
+    {
+        if (fComma || JSON_TOKEN_OBJECT_KEY == pReader->token || bContainer != (']' == b ? '[' : '{'))
+        {
+            JsonExitWithRootFailure(hr, E_INVALIDDATA, "Unexpected '%hc' at offset: %Iu", b, pReader->iData);
+        }
+
+        --pReader->cContainers;
+        ++pReader->iData;
+        *pToken = ']' == b ? JSON_TOKEN_ARRAY_END : JSON_TOKEN_OBJECT_END;
+    }
+    else if (fValueComplete && !fComma)
+    {
+        JsonExitWithRootFailure(hr, E_INVALIDDATA, "Expected ',' at offset: %Iu", pReader->iData);
+    }
+    else if ('{' == bContainer && JSON_TOKEN_OBJECT_KEY != pReader->token)
+    {
+        if ('"' != b)
+        {
+            JsonExitWithRootFailure(hr, E_INVALIDDATA, "Expected object key at offset: %Iu", pReader->iData);
+        }
+
+        hr = ReadString(pReader, pValue);
+        JsonExitOnFailure(hr, "Failed to read object key.");
+
+        *pToken = JSON_TOKEN_OBJECT_KEY;
+    }
+    else
+    {
+        switch (b)
+        {
+        case '{':
+        case '[':
+            hr = PushContainer(pReader, b);
+            JsonExitOnFailure(hr, "Failed to start JSON container.");
+
+            ++pReader->iData;
+            *pToken = '{' == b ? JSON_TOKEN_OBJECT_START : JSON_TOKEN_ARRAY_START;
+            break;
+
+        case '"':
+            hr = ReadString(pReader, pValue);
+            JsonExitOnFailure(hr, "Failed to read string value.");
+
+            *pToken = JSON_TOKEN_VALUE;
+            break;
+
+        case 't':
+        case 'f':
+        case 'n':
+            hr = ReadLiteral(pReader, pValue);
+            JsonExitOnFailure(hr, "Failed to read literal value.");
+
+            *pToken = JSON_TOKEN_VALUE;
+            break;
+
+        case '-':
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+        case '8':
+        case '9':
+            hr = ReadNumber(pReader, pValue);
+            JsonExitOnFailure(hr, "Failed to read number value.");
+
+            *pToken = JSON_TOKEN_VALUE;
+            break;
+
+        default:
+            JsonExitWithRootFailure(hr, E_INVALIDDATA, "Unexpected '%hc' at offset: %Iu", b, pReader->iData);
+        }
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT ReadString(
+    __in JSON_READER* pReader,
+    __out JSON_VALUE* pValue
+    )
+{
+    HRESULT hr = S_OK;
+    SIZE_T cbScanned = 1; // skip the opening quote
+    BOOL fEscaped = FALSE;
+
+    // Offsets are relative to the opening quote because filling the buffer may move it.
+    for (;;)
+    {
+        const BYTE* pbStart = pReader->pbData + pReader->iData;
+        const BYTE* pbEnd = pReader->pbData + pReader->cbData;
+        const BYTE* pb = ScanString(pbStart + cbScanned, pbEnd);
+
+        cbScanned = pb - pbStart;
+
+        if (pb == pbEnd)
+        {
+            if (pReader->fComplete)
+            {
+                JsonExitWithRootFailure(hr, E_INVALIDDATA, "Unterminated JSON string at offset: %Iu", pReader->iData);
+            }
+
+            hr = FillBuffer(pReader);
+            JsonExitOnFailure(hr, "Failed to read more JSON.");
+        }
+        else if ('"' == *pb)
+        {
+            break;
+        }
+        else if ('\\' == *pb)
+        {
+            // Skip the escaped character here and validate escapes when the string is decoded.
+            fEscaped = TRUE;
+
+            hr = EnsureBytes(pReader, cbScanned + 2);
+            JsonExitOnFailure(hr, "Failed to read JSON escape.");
+
+            cbScanned += 2;
+        }
+        else
+        {
+            JsonExitWithRootFailure(hr, E_INVALIDDATA, "Invalid control character in JSON string at offset: %Iu", pReader->iData + cbScanned);
+        }
+    }
+
+    pValue->type = JSON_VALUE_TYPE_STRING;
+    pValue->pch = reinterpret_cast<LPCSTR>(pReader->pbData + pReader->iData + 1);
+    pValue->cch = cbScanned - 1;
+    pValue->fEscaped = fEscaped;
+
+    pReader->iData += cbScanned + 1;
+
+LExit:
+    return hr;
+}
+
+static HRESULT ReadLiteral(
+    __in JSON_READER* pReader,
+    __out JSON_VALUE* pValue
+    )
+{
+    HRESULT hr = S_OK;
+    LPCSTR szLiteral = NULL;
+    SIZE_T cchLiteral = 0;
+
+    switch (pReader->pbData[pReader->iData])
+    {
+    case 't':
+        szLiteral = "true";
+        pValue->type = JSON_VALUE_TYPE_BOOL;
+        break;
+
+    case 'f':
+        szLiteral = "false";
+        pValue->type = JSON_VALUE_TYPE_BOOL;
+        break;
+
+    default:
+        szLiteral = "null";
+        pValue->type = JSON_VALUE_TYPE_NULL;
+        break;
+    }
+
+    cchLiteral = lstrlenA(szLiteral);
+
+    hr = EnsureBytes(pReader, cchLiteral);
+    JsonExitOnFailure(hr, "Failed to read JSON literal.");
+
+    if (0 != memcmp(pReader->pbData + pReader->iData, szLiteral, cchLiteral))
+    {
+        JsonExitWithRootFailure(hr, E_INVALIDDATA, "Invalid JSON literal at offset: %Iu", pReader->iData);
+    }
+
+    pValue->pch = reinterpret_cast<LPCSTR>(pReader->pbData + pReader->iData);
+    pValue->cch = cchLiteral;
+
+    pReader->iData += cchLiteral;
+
+LExit:
+    return hr;
+}
+
+static HRESULT ReadNumber(
+    __in JSON_READER* pReader,
+    __out JSON_VALUE* pValue
+    )
+{
+    HRESULT hr = S_OK;
+    SIZE_T cbScanned = 0;
+
+    for (;;)
+    {
+        const BYTE* pb = pReader->pbData + pReader->iData + cbScanned;
+        const BYTE* pbEnd = pReader->pbData + pReader->cbData;
+
+        while (pb < pbEnd && (('0' <= *pb && '9' >= *pb) || '-' == *pb || '+' == *pb || '.' == *pb || 'e' == *pb || 'E' == *pb))
+        {
+            ++pb;
+        }
+
+        cbScanned = pb - (pReader->pbData + pReader->iData);
+
+        if (pb < pbEnd || pReader->fComplete)
+        {
+            break;
+        }
+
+        hr = FillBuffer(pReader);
+        JsonExitOnFailure(hr, "Failed to read more JSON.");
+    }
+
+    if (!IsValidNumber(reinterpret_cast<LPCSTR>(pReader->pbData + pReader->iData), cbScanned))
+    {
+        JsonExitWithRootFailure(hr, E_INVALIDDATA, "Invalid JSON number at offset: %Iu", pReader->iData);
+    }
+
+    pValue->type = JSON_VALUE_TYPE_NUMBER;
+    pValue->pch = reinterpret_cast<LPCSTR>(pReader->pbData + pReader->iData);
+    pValue->cch = cbScanned;
+
+    pReader->iData += cbScanned;
+
+LExit:
+    return hr;
+}
+
+static HRESULT PushContainer(
+    __in JSON_READER* pReader,
+    __in BYTE bContainer
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pReader->rgbContainers), pReader->cContainers, 1, sizeof(BYTE), JSON_STACK_INCREMENT * 4);
+    JsonExitOnFailure(hr, "Failed to grow JSON container stack.");
+
+    pReader->rgbContainers[pReader->cContainers] = bContainer;
+    ++pReader->cContainers;
+
+LExit:
+    return hr;
+}
+
+static BOOL IsValidNumber(
+    __in_ecount(cch) LPCSTR pch,
+    __in SIZE_T cch
+    )
+{
+    LPCSTR pchEnd = pch + cch;
+
+    // -? (0 | [1-9][0-9]*) (.[0-9]+)? ([eE][+-]?[0-9]+)?
+    if (pch < pchEnd && '-' == *pch)
+    {
+        ++pch;
+    }
+
+    if (pch == pchEnd || '0' > *pch || '9' < *pch)
+    {
+        return FALSE;
+    }
+    else if ('0' == *pch)
+    {
+        ++pch;
+    }
+    else
+    {
+        while (pch < pchEnd && '0' <= *pch && '9' >= *pch)
+        {
+            ++pch;
+        }
+    }
+
+    if (pch < pchEnd && '.' == *pch)
+    {
+        LPCSTR pchFraction = ++pch;
+
+        while (pch < pchEnd && '0' <= *pch && '9' >= *pch)
+        {
+            ++pch;
+        }
+
+        if (pch == pchFraction)
+        {
+            return FALSE;
+        }
+    }
+
+    if (pch < pchEnd && ('e' == *pch || 'E' == *pch))
+    {
+        ++pch;
+
+        if (pch < pchEnd && ('+' == *pch || '-' == *pch))
+        {
+            ++pch;
+        }
+
+        LPCSTR pchExponent = pch;
+
+        while (pch < pchEnd && '0' <= *pch && '9' >= *pch)
+        {
+            ++pch;
+        }
+
+        if (pch == pchExponent)
+        {
+            return FALSE;
+        }
+    }
+
+    return pch == pchEnd;
+}
+
+static HRESULT ParseUnsigned(
+    __in const JSON_VALUE* pValue,
+    __out BOOL* pfNegative,
+    __out DWORD64* pqwValue
+    )
+{
+    HRESULT hr = S_OK;
+    LPCSTR pch = pValue->pch;
+    LPCSTR pchEnd = pValue->pch + pValue->cch;
+    DWORD64 qwValue = 0;
+
+    if (JSON_VALUE_TYPE_NUMBER != pValue->type)
+    {
+        JsonExitWithRootFailure(hr, E_INVALIDDATA, "JSON value is not a number.");
+    }
+
+    *pfNegative = '-' == *pch;
+    if (*pfNegative)
+    {
+        ++pch;
+    }
+
+    for (; pch < pchEnd; ++pch)
+    {
+        if ('0' > *pch || '9' < *pch)
+        {
+            JsonExitWithRootFailure(hr, E_INVALIDDATA, "JSON number is not an integer.");
+        }
+
+        hr = ::ULongLongMult(qwValue, 10, &qwValue);
+        JsonExitOnRootFailure(hr, "JSON number is too large.");
+
+        hr = ::ULongLongAdd(qwValue, *pch - '0', &qwValue);
+        JsonExitOnRootFailure(hr, "JSON number is too large.");
+    }
+
+    *pqwValue = qwValue;
+
+LExit:
+    return hr;
+}
+
+static HRESULT WriterAppend(
+    __in JSON_WRITER* pWriter,
+    __in_z LPCWSTR wz
+    )
+{
+    HRESULT hr = S_OK;
+    SIZE_T cch = lstrlenW(wz);
+
+    if (INVALID_HANDLE_VALUE == pWriter->hFile)
+    {
+        SIZE_T cbCurrent = 0;
+        SIZE_T cchRequired = pWriter->cchJson + cch + 1;
+
+        if (pWriter->sczJson)
+        {
+            hr = MemSizeChecked(pWriter->sczJson, &cbCurrent);
+            JsonExitOnFailure(hr, "Failed to get JSON string size.");
+        }
+
+        // Grow geometrically so building a large document is not quadratic.
+        if (cbCurrent / sizeof(WCHAR) < cchRequired)
+        {
+            SIZE_T cchAlloc = max(max(cchRequired, cbCurrent / sizeof(WCHAR) * 2), JSON_MIN_STRING_SIZE);
+
+            hr = StrAlloc(&pWriter->sczJson, cchAlloc);
+            JsonExitOnFailure(hr, "Failed to grow JSON string.");
+        }
+
+        memcpy(pWriter->sczJson + pWriter->cchJson, wz, cch * sizeof(WCHAR));
+        pWriter->cchJson += cch;
+        pWriter->sczJson[pWriter->cchJson] = L'\0';
+    }
+    else
+    {
+        while (cch)
+        {
+            // A UTF-16 code unit never needs more than three UTF-8 bytes. Never split a surrogate pair.
+            SIZE_T cchChunk = min(cch, pWriter->cbBuffer / 3);
+            if (cchChunk < cch && IS_HIGH_SURROGATE(wz[cchChunk - 1]))
+            {
+                --cchChunk;
+            }
+
+            if (pWriter->cbBuffer - pWriter->cbBuffered < cchChunk * 3)
+            {
+                hr = WriterWriteBuffer(pWriter);
+                JsonExitOnFailure(hr, "Failed to write JSON chunk.");
+            }
+
+            int cb = ::WideCharToMultiByte(CP_UTF8, 0, wz, static_cast<int>(cchChunk), reinterpret_cast<LPSTR>(pWriter->pbBuffer + pWriter->cbBuffered), static_cast<int>(pWriter->cbBuffer - pWriter->cbBuffered), NULL, NULL);
+            JsonExitOnNullWithLastError(cb, hr, "Failed to convert JSON to UTF-8.");
+
+            pWriter->cbBuffered += cb;
+            wz += cchChunk;
+            cch -= cchChunk;
+        }
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT WriterWriteBuffer(
+    __in JSON_WRITER* pWriter
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (pWriter->cbBuffered)
+    {
+        hr = FileWriteHandle(pWriter->hFile, pWriter->pbBuffer, pWriter->cbBuffered);
+        JsonExitOnFailure(hr, "Failed to write JSON to file.");
+
+        pWriter->cbBuffered = 0;
+    }
+
+LExit:
+    return hr;
+}
@@ -40,6 +40,16 @@ static HRESULT ParseWxlControl(
     __in DWORD dwIdx,
     __in WIX_LOCALIZATION* pWixLoc
     );
+static HRESULT IndexLocStrings(
+    __in WIX_LOCALIZATION* pWixLoc
+    );
+static HRESULT IndexLocString(
+    __in WIX_LOCALIZATION* pWixLoc,
+    __in LOC_STRING* pLocString
+    );
+static HRESULT IndexLocControls(
+    __in WIX_LOCALIZATION* pWixLoc
+    );
 
 // from Winnls.h
 #ifndef MUI_LANGUAGE_ID
@@ -278,6 +288,8 @@ extern "C" void DAPI LocFree(
             ReleaseStr(pWixLoc->rgLocControls[idx].wzText);
         }
 
+        ReleaseDict(pWixLoc->sdhLocStrings);
+        ReleaseDict(pWixLoc->sdhLocControls);
         ReleaseMem(pWixLoc->rgLocStrings);
         ReleaseMem(pWixLoc->rgLocControls);
         ReleaseMem(pWixLoc);
@@ -291,14 +303,70 @@ extern "C" HRESULT DAPI LocLocalizeString(
 {
     Assert(ppsczInput && pWixLoc);
     HRESULT hr = S_OK;
+    LPCWSTR wzScan = *ppsczInput;
+    LPCWSTR wzToken = NULL;
+    LPCWSTR wzTokenEnd = NULL;
+    LPWSTR sczOutput = NULL;
+    LPWSTR sczId = NULL;
+    LOC_STRING* pLocString = NULL;
 
-    for (DWORD i = 0; i < pWixLoc->cLocStrings; ++i)
+    // Most strings have nothing to localize so don't touch them.
+    wzToken = wzScan ? wcsstr(wzScan, L"#(loc.") : NULL;
+    if (!wzToken)
     {
-        hr = StrReplaceStringAll(ppsczInput, pWixLoc->rgLocStrings[i].wzId, pWixLoc->rgLocStrings[i].wzText);
-        LocExitOnFailure(hr, "Localizing string failed.");
+        ExitFunction();
+    }
+
+    hr = StrAlloc(&sczOutput, lstrlenW(wzScan) + 1);
+    LocExitOnFailure(hr, "Failed to allocate localized string.");
+
+    while (wzToken)
+    {
+        wzTokenEnd = wcschr(wzToken, L')');
+        if (!wzTokenEnd)
+        {
+            break;
+        }
+
+        ++wzTokenEnd;
+
+        hr = StrAllocString(&sczId, wzToken, wzTokenEnd - wzToken);
+        LocExitOnFailure(hr, "Failed to copy localization string id.");
+
+        hr = LocGetString(pWixLoc, sczId, &pLocString);
+        if (E_NOTFOUND == hr)
+        {
+            // Unknown ids are left as is, keep scanning after the start of the token.
+            wzTokenEnd = wzToken + 1;
+            pLocString = NULL;
+            hr = S_OK;
+        }
+        LocExitOnFailure(hr, "Failed to find localization string.");
+
+        hr = StrAllocConcat(&sczOutput, wzScan, (pLocString ? wzToken : wzTokenEnd) - wzScan);
+        LocExitOnFailure(hr, "Failed to copy unlocalized text.");
+
+        if (pLocString)
+        {
+            hr = StrAllocConcat(&sczOutput, pLocString->wzText, 0);
+            LocExitOnFailure(hr, "Failed to copy localized text.");
+        }
+
+        wzScan = wzTokenEnd;
+        wzToken = wcsstr(wzScan, L"#(loc.");
     }
 
+    hr = StrAllocConcat(&sczOutput, wzScan, 0);
+    LocExitOnFailure(hr, "Failed to copy remaining unlocalized text.");
+
+    ReleaseStr(*ppsczInput);
+    *ppsczInput = sczOutput;
+    sczOutput = NULL;
+
 LExit:
+    ReleaseStr(sczId);
+    ReleaseStr(sczOutput);
+
     return hr;
 }
 
@@ -311,6 +379,12 @@ extern "C" HRESULT DAPI LocGetControl(
     HRESULT hr = S_OK;
     LOC_CONTROL* pLocControl = NULL;
 
+    if (pWixLoc->sdhLocControls)
+    {
+        hr = DictGetValue(pWixLoc->sdhLocControls, wzId, reinterpret_cast<void**>(ppLocControl));
+        ExitFunction();
+    }
+
     for (DWORD i = 0; i < pWixLoc->cLocControls; ++i)
     {
         pLocControl = &pWixLoc->rgLocControls[i];
@@ -337,6 +411,11 @@ extern "C" HRESULT DAPI LocGetString(
     HRESULT hr = E_NOTFOUND;
     LOC_STRING* pLocString = NULL;
 
+    if (pWixLoc->sdhLocStrings)
+    {
+        return DictGetValue(pWixLoc->sdhLocStrings, wzId, reinterpret_cast<void**>(ppLocString));
+    }
+
     for (DWORD i = 0; i < pWixLoc->cLocStrings; ++i)
     {
         pLocString = pWixLoc->rgLocStrings + i;
@@ -375,6 +454,17 @@ extern "C" HRESULT DAPI LocAddString(
 
     pLocString->bOverridable = bOverridable;
 
+    if (pWixLoc->sdhLocStrings)
+    {
+        hr = IndexLocString(pWixLoc, pLocString);
+        LocExitOnFailure(hr, "Failed to index localization string.");
+    }
+    else
+    {
+        hr = IndexLocStrings(pWixLoc);
+        LocExitOnFailure(hr, "Failed to index localization strings.");
+    }
+
 LExit:
     return hr;
 }
@@ -413,10 +503,22 @@ static HRESULT ParseWxl(
     hr = ParseWxlControls(pWxlElement, pWixLoc);
     LocExitOnFailure(hr, "Parsing localization controls failed.");
 
+    hr = IndexLocStrings(pWixLoc);
+    LocExitOnFailure(hr, "Failed to index localization strings.");
+
+    hr = IndexLocControls(pWixLoc);
+    LocExitOnFailure(hr, "Failed to index localized controls.");
+
     *ppWixLoc = pWixLoc;
     pWixLoc = NULL;
 
 LExit:
+    if (pWixLoc)
+    {
+        ReleaseDict(pWixLoc->sdhLocStrings);
+        ReleaseDict(pWixLoc->sdhLocControls);
+    }
+
     ReleaseObject(pWxlElement);
     ReleaseMem(pWixLoc);
 
@@ -626,3 +728,69 @@ LExit:
 
     return hr;
 }
+
+static HRESULT IndexLocStrings(
+    __in WIX_LOCALIZATION* pWixLoc
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = DictCreateWithEmbeddedKey(&pWixLoc->sdhLocStrings, pWixLoc->cLocStrings, reinterpret_cast<void**>(&pWixLoc->rgLocStrings), offsetof(LOC_STRING, wzId), DICT_FLAG_NONE);
+    LocExitOnFailure(hr, "Failed to create the localization string dictionary.");
+
+    for (DWORD i = 0; i < pWixLoc->cLocStrings; ++i)
+    {
+        hr = IndexLocString(pWixLoc, pWixLoc->rgLocStrings + i);
+        LocExitOnFailure(hr, "Failed to index localization string.");
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT IndexLocString(
+    __in WIX_LOCALIZATION* pWixLoc,
+    __in LOC_STRING* pLocString
+    )
+{
+    HRESULT hr = S_OK;
+
+    // The first string with an id wins, just like the original linear search.
+    hr = DictKeyExists(pWixLoc->sdhLocStrings, pLocString->wzId);
+    if (E_NOTFOUND == hr)
+    {
+        hr = DictAddValue(pWixLoc->sdhLocStrings, pLocString);
+        LocExitOnFailure(hr, "Failed to add localization string to dictionary: %ls", pLocString->wzId);
+    }
+    LocExitOnFailure(hr, "Failed to check for localization string in dictionary: %ls", pLocString->wzId);
+
+LExit:
+    return hr;
+}
+
+static HRESULT IndexLocControls(
+    __in WIX_LOCALIZATION* pWixLoc
+    )
+{
+    HRESULT hr = S_OK;
+    LOC_CONTROL* pLocControl = NULL;
+
+    hr = DictCreateWithEmbeddedKey(&pWixLoc->sdhLocControls, pWixLoc->cLocControls, reinterpret_cast<void**>(&pWixLoc->rgLocControls), offsetof(LOC_CONTROL, wzControl), DICT_FLAG_NONE);
+    LocExitOnFailure(hr, "Failed to create the localized control dictionary.");
+
+    for (DWORD i = 0; i < pWixLoc->cLocControls; ++i)
+    {
+        pLocControl = pWixLoc->rgLocControls + i;
+
+        hr = DictKeyExists(pWixLoc->sdhLocControls, pLocControl->wzControl);
+        if (E_NOTFOUND == hr)
+        {
+            hr = DictAddValue(pWixLoc->sdhLocControls, pLocControl);
+            LocExitOnFailure(hr, "Failed to add localized control to dictionary: %ls", pLocControl->wzControl);
+        }
+        LocExitOnFailure(hr, "Failed to check for localized control in dictionary: %ls", pLocControl->wzControl);
+    }
+
+LExit:
+    return hr;
+}
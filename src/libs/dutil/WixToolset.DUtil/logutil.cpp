@@ -811,7 +811,10 @@ extern "C" HRESULT LogStringWorkRaw(
     // If the log hasn't been initialized yet, store it in a buffer
     if (INVALID_HANDLE_VALUE == LogUtil_hLog)
     {
+        // The pre-init buffer can outlive any arena the caller is allocating from.
+        MEM_ARENA_HANDLE hPreviousArena = MemArenaBeginScope(NULL);
         hr = StrAnsiAllocConcat(&LogUtil_sczPreInitBuffer, szLogData, 0);
+        MemArenaEndScope(hPreviousArena);
         LoguExitOnFailure(hr, "Failed to concatenate string to pre-init buffer");
 
         ExitFunction1(hr = S_OK);
@@ -19,10 +19,100 @@
 #define MemExitOnGdipFailure(g, x, s, ...) ExitOnGdipFailureSource(DUTIL_SOURCE_MEMUTIL, g, x, s, __VA_ARGS__)
 
 
+// constants
+
+const SIZE_T MEM_ARENA_HEADER_SIZE = MEMORY_ALLOCATION_ALIGNMENT;
+const SIZE_T MEM_ARENA_COMMIT_SIZE = 64 * 1024;
+const SIZE_T MEM_ARENA_DEFAULT_RESERVE_SIZE = 1024 * 1024;
+const DWORD MEM_ARENA_MAX_COUNT = 16;
+
+
+// structs
+
+typedef struct _MEM_ARENA
+{
+    CRITICAL_SECTION cs;
+
+    BYTE* pbBase;
+    BYTE* pbNext;
+    BYTE* pbCommitted;
+    BYTE* pbEnd;
+    BYTE* pbLast;
+
+    DWORD64 cbRecorded;
+} MEM_ARENA;
+
+// Published address range of a live arena. The version is odd while the slot is being
+// claimed or cleared so readers can check the range without taking a lock.
+typedef struct _MEM_ARENA_SLOT
+{
+    volatile LONG lVersion;
+    BYTE* volatile pbBase;
+    BYTE* volatile pbEnd;
+    MEM_ARENA* volatile pArena;
+} MEM_ARENA_SLOT;
+
+
+// internal variables
+
 #if DEBUG
 static BOOL vfMemInitialized = FALSE;
 #endif
 
+static MEM_ARENA_SLOT vrgArenaSlots[MEM_ARENA_MAX_COUNT] = { };
+static volatile LONG vcArenas = 0;
+static BYTE* volatile vpbArenaMin = NULL; // lowest address any arena ever reserved.
+static BYTE* volatile vpbArenaMax = NULL; // end of the highest reservation any arena ever made.
+thread_local static MEM_ARENA* vtpScopeArena = NULL;
+
+static volatile LONG vfStatistics = FALSE;
+static volatile LONG64 vcAllocations = 0;
+static volatile LONG64 vcArenaAllocations = 0;
+static volatile LONG64 vcFrees = 0;
+static volatile LONG64 vcbCurrent = 0;
+static volatile LONG64 vcbPeak = 0;
+
+
+// internal function declarations
+
+static MEM_ARENA* ArenaFromPointer(
+    __in_opt LPCVOID pv
+    );
+static LPVOID ArenaAlloc(
+    __in MEM_ARENA* pArena,
+    __in SIZE_T cbSize
+    );
+static LPVOID ArenaReAlloc(
+    __in MEM_ARENA* pArena,
+    __in LPVOID pv,
+    __in SIZE_T cbSize,
+    __in BOOL fZero
+    );
+static BOOL ArenaPublish(
+    __in MEM_ARENA* pArena
+    );
+static void ArenaUnpublish(
+    __in MEM_ARENA* pArena
+    );
+static void ArenaWidenRange(
+    __in BYTE* pbBase,
+    __in BYTE* pbEnd
+    );
+static BOOL ArenaCommit(
+    __in MEM_ARENA* pArena,
+    __in BYTE* pbRequiredEnd
+    );
+static SIZE_T ArenaBlockSize(
+    __in LPCVOID pv
+    );
+static void RecordAllocation(
+    __in SIZE_T cbSize,
+    __in BOOL fArena
+    );
+static void RecordBytes(
+    __in LONG64 cbDelta
+    );
+
 extern "C" HRESULT DAPI MemInitialize()
 {
 #if DEBUG
@@ -45,7 +135,29 @@ extern "C" LPVOID DAPI MemAlloc(
 {
 //    AssertSz(vfMemInitialized, "MemInitialize() not called, this would normally crash");
     AssertSz(0 < cbSize, "MemAlloc() called with invalid size");
-    return ::HeapAlloc(::GetProcessHeap(), fZero ? HEAP_ZERO_MEMORY : 0, cbSize);
+
+    LPVOID pv = NULL;
+    MEM_ARENA* pArena = vtpScopeArena;
+
+    // Arena memory is freshly committed and never reused so it is always zeroed.
+    // When the arena's reservation is exhausted fall back to the process heap.
+    if (pArena)
+    {
+        pv = ArenaAlloc(pArena, cbSize);
+    }
+
+    if (!pv)
+    {
+        pArena = NULL;
+        pv = ::HeapAlloc(::GetProcessHeap(), fZero ? HEAP_ZERO_MEMORY : 0, cbSize);
+    }
+
+    if (pv && vfStatistics)
+    {
+        RecordAllocation(cbSize, NULL != pArena);
+    }
+
+    return pv;
 }
 
 
@@ -57,7 +169,29 @@ extern "C" LPVOID DAPI MemReAlloc(
 {
 //    AssertSz(vfMemInitialized, "MemInitialize() not called, this would normally crash");
     AssertSz(0 < cbSize, "MemReAlloc() called with invalid size");
-    return ::HeapReAlloc(::GetProcessHeap(), fZero ? HEAP_ZERO_MEMORY : 0, pv, cbSize);
+
+    LPVOID pvNew = NULL;
+    SIZE_T cbCurrent = 0;
+    MEM_ARENA* pArena = ArenaFromPointer(pv);
+
+    if (pArena)
+    {
+        return ArenaReAlloc(pArena, pv, cbSize, fZero);
+    }
+
+    if (vfStatistics)
+    {
+        cbCurrent = ::HeapSize(::GetProcessHeap(), 0, pv);
+    }
+
+    pvNew = ::HeapReAlloc(::GetProcessHeap(), fZero ? HEAP_ZERO_MEMORY : 0, pv, cbSize);
+
+    if (pvNew && vfStatistics && -1 != cbCurrent)
+    {
+        RecordBytes(static_cast<LONG64>(cbSize) - static_cast<LONG64>(cbCurrent));
+    }
+
+    return pvNew;
 }
 
 
@@ -77,8 +211,13 @@ extern "C" HRESULT DAPI MemReAllocSecure(
     LPVOID pvNew = NULL;
     SIZE_T cb = 0;
 
-    dwFlags |= fZero ? HEAP_ZERO_MEMORY : 0;
-    pvNew = ::HeapReAlloc(::GetProcessHeap(), dwFlags, pv, cbSize);
+    // Arena blocks cannot be reallocated in place by the heap, so always copy them.
+    if (!ArenaFromPointer(pv))
+    {
+        dwFlags |= fZero ? HEAP_ZERO_MEMORY : 0;
+        pvNew = ::HeapReAlloc(::GetProcessHeap(), dwFlags, pv, cbSize);
+    }
+
     if (!pvNew)
     {
         pvNew = MemAlloc(cbSize, fZero);
@@ -351,7 +490,31 @@ extern "C" HRESULT DAPI MemFree(
     )
 {
 //    AssertSz(vfMemInitialized, "MemInitialize() not called, this would normally crash");
-    return ::HeapFree(::GetProcessHeap(), 0, pv) ? S_OK : HRESULT_FROM_WIN32(::GetLastError());
+    SIZE_T cbCurrent = 0;
+
+    // Arena blocks are released with their arena.
+    if (ArenaFromPointer(pv))
+    {
+        return S_OK;
+    }
+
+    if (vfStatistics)
+    {
+        cbCurrent = ::HeapSize(::GetProcessHeap(), 0, pv);
+    }
+
+    if (!::HeapFree(::GetProcessHeap(), 0, pv))
+    {
+        return HRESULT_FROM_WIN32(::GetLastError());
+    }
+
+    if (vfStatistics && -1 != cbCurrent)
+    {
+        ::InterlockedIncrement64(&vcFrees);
+        RecordBytes(-static_cast<LONG64>(cbCurrent));
+    }
+
+    return S_OK;
 }
 
 
@@ -360,6 +523,11 @@ extern "C" SIZE_T DAPI MemSize(
     )
 {
 //    AssertSz(vfMemInitialized, "MemInitialize() not called, this would normally crash");
+    if (ArenaFromPointer(pv))
+    {
+        return ArenaBlockSize(pv);
+    }
+
     return ::HeapSize(::GetProcessHeap(), 0, pv);
 }
 
@@ -382,3 +550,408 @@ extern "C" HRESULT DAPI MemSizeChecked(
 LExit:
     return hr;
 }
+
+
+extern "C" HRESULT DAPI MemArenaCreate(
+    __in SIZE_T cbReserve,
+    __out MEM_ARENA_HANDLE* phArena
+    )
+{
+    HRESULT hr = S_OK;
+    MEM_ARENA* pArena = NULL;
+
+    if (!cbReserve)
+    {
+        cbReserve = MEM_ARENA_DEFAULT_RESERVE_SIZE;
+    }
+
+    // The arena bookkeeping always comes from the process heap so it is never carved out of another arena.
+    pArena = static_cast<MEM_ARENA*>(::HeapAlloc(::GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(MEM_ARENA)));
+    MemExitOnNull(pArena, hr, E_OUTOFMEMORY, "Failed to allocate arena.");
+
+    ::InitializeCriticalSection(&pArena->cs);
+
+    pArena->pbBase = static_cast<BYTE*>(::VirtualAlloc(NULL, cbReserve, MEM_RESERVE, PAGE_NOACCESS));
+    MemExitOnNullWithLastError(pArena->pbBase, hr, "Failed to reserve %Iu bytes for arena.", cbReserve);
+
+    pArena->pbNext = pArena->pbBase;
+    pArena->pbCommitted = pArena->pbBase;
+    pArena->pbEnd = pArena->pbBase + cbReserve;
+
+    if (!ArenaPublish(pArena))
+    {
+        ::VirtualFree(pArena->pbBase, 0, MEM_RELEASE);
+        MemExitWithRootFailure(hr, E_OUTOFMEMORY, "Failed to create arena, all %u arenas are in use.", MEM_ARENA_MAX_COUNT);
+    }
+
+    *phArena = pArena;
+    pArena = NULL;
+
+LExit:
+    if (pArena)
+    {
+        ::DeleteCriticalSection(&pArena->cs);
+        ::HeapFree(::GetProcessHeap(), 0, pArena);
+    }
+
+    return hr;
+}
+
+
+extern "C" void DAPI MemArenaDestroy(
+    __in MEM_ARENA_HANDLE hArena
+    )
+{
+    MEM_ARENA* pArena = static_cast<MEM_ARENA*>(hArena);
+
+    ArenaUnpublish(pArena);
+
+    if (vtpScopeArena == pArena)
+    {
+        vtpScopeArena = NULL;
+    }
+
+    if (pArena->cbRecorded)
+    {
+        RecordBytes(-static_cast<LONG64>(pArena->cbRecorded));
+    }
+
+    ::VirtualFree(pArena->pbBase, 0, MEM_RELEASE);
+    ::DeleteCriticalSection(&pArena->cs);
+    ::HeapFree(::GetProcessHeap(), 0, pArena);
+}
+
+
+extern "C" MEM_ARENA_HANDLE DAPI MemArenaBeginScope(
+    __in_opt MEM_ARENA_HANDLE hArena
+    )
+{
+    MEM_ARENA_HANDLE hPreviousArena = vtpScopeArena;
+
+    vtpScopeArena = static_cast<MEM_ARENA*>(hArena);
+
+    return hPreviousArena;
+}
+
+
+extern "C" void DAPI MemArenaEndScope(
+    __in_opt MEM_ARENA_HANDLE hPreviousArena
+    )
+{
+    vtpScopeArena = static_cast<MEM_ARENA*>(hPreviousArena);
+}
+
+
+extern "C" void DAPI MemStatisticsEnable(
+    __in BOOL fEnable
+    )
+{
+    ::InterlockedExchange(&vfStatistics, fEnable ? TRUE : FALSE);
+}
+
+
+extern "C" void DAPI MemGetStatistics(
+    __out MEM_STATISTICS* pStatistics
+    )
+{
+    pStatistics->cAllocations = static_cast<DWORD64>(vcAllocations);
+    pStatistics->cArenaAllocations = static_cast<DWORD64>(vcArenaAllocations);
+    pStatistics->cFrees = static_cast<DWORD64>(vcFrees);
+    pStatistics->cbCurrent = vcbCurrent > 0 ? static_cast<DWORD64>(vcbCurrent) : 0;
+    pStatistics->cbPeak = static_cast<DWORD64>(vcbPeak);
+}
+
+
+// internal helper functions
+
+static MEM_ARENA* ArenaFromPointer(
+    __in_opt LPCVOID pv
+    )
+{
+    // Most pointers come from the process heap, so rule them out with one range check before looking at the slots.
+    if (!pv || !ReadNoFence(&vcArenas) || pv < ReadPointerAcquire(reinterpret_cast<PVOID const volatile*>(&vpbArenaMin)) || pv >= ReadPointerAcquire(reinterpret_cast<PVOID const volatile*>(&vpbArenaMax)))
+    {
+        return NULL;
+    }
+
+    // Lock-free: a slot that changes while it is read belongs to an arena that is being created
+    // or destroyed, and no live block can be inside either, so such a slot is simply skipped.
+    // The acquire loads keep the fields from being read outside the two reads of the version.
+    for (DWORD i = 0; i < MEM_ARENA_MAX_COUNT; ++i)
+    {
+        MEM_ARENA_SLOT* pSlot = vrgArenaSlots + i;
+        LONG lVersion = ReadAcquire(&pSlot->lVersion);
+
+        if (lVersion & 1)
+        {
+            continue;
+        }
+
+        BYTE* pbBase = static_cast<BYTE*>(ReadPointerAcquire(reinterpret_cast<PVOID const volatile*>(&pSlot->pbBase)));
+        BYTE* pbEnd = static_cast<BYTE*>(ReadPointerAcquire(reinterpret_cast<PVOID const volatile*>(&pSlot->pbEnd)));
+        MEM_ARENA* pArena = static_cast<MEM_ARENA*>(ReadPointerAcquire(reinterpret_cast<PVOID const volatile*>(&pSlot->pArena)));
+
+        if (pArena && pbBase <= pv && pv < pbEnd && lVersion == ReadAcquire(&pSlot->lVersion))
+        {
+            return pArena;
+        }
+    }
+
+    return NULL;
+}
+
+static BOOL ArenaPublish(
+    __in MEM_ARENA* pArena
+    )
+{
+    for (DWORD i = 0; i < MEM_ARENA_MAX_COUNT; ++i)
+    {
+        MEM_ARENA_SLOT* pSlot = vrgArenaSlots + i;
+        LONG lVersion = pSlot->lVersion;
+
+        // Claim a free slot by making its version odd, fill it in, then make the version even again.
+        if (!(lVersion & 1) && !pSlot->pArena && lVersion == ::InterlockedCompareExchange(&pSlot->lVersion, lVersion + 1, lVersion))
+        {
+            pSlot->pbBase = pArena->pbBase;
+            pSlot->pbEnd = pArena->pbEnd;
+            pSlot->pArena = pArena;
+
+            ArenaWidenRange(pArena->pbBase, pArena->pbEnd);
+
+            ::InterlockedIncrement(&pSlot->lVersion);
+            ::InterlockedIncrement(&vcArenas);
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void ArenaUnpublish(
+    __in MEM_ARENA* pArena
+    )
+{
+    for (DWORD i = 0; i < MEM_ARENA_MAX_COUNT; ++i)
+    {
+        MEM_ARENA_SLOT* pSlot = vrgArenaSlots + i;
+
+        // Only the owner of an arena clears its slot so no compare-exchange is needed here.
+        if (pArena == pSlot->pArena)
+        {
+            ::InterlockedIncrement(&pSlot->lVersion);
+
+            pSlot->pArena = NULL;
+            pSlot->pbEnd = NULL;
+            pSlot->pbBase = NULL;
+
+            ::InterlockedIncrement(&pSlot->lVersion);
+            ::InterlockedDecrement(&vcArenas);
+            break;
+        }
+    }
+}
+
+static void ArenaWidenRange(
+    __in BYTE* pbBase,
+    __in BYTE* pbEnd
+    )
+{
+    // The range only ever grows. Shrinking it when an arena is destroyed would race with another
+    // arena being published, and a stale range only costs the slot scan for pointers inside it.
+    BYTE* pbMin = static_cast<BYTE*>(ReadPointerAcquire(reinterpret_cast<PVOID const volatile*>(&vpbArenaMin)));
+    while (!pbMin || pbBase < pbMin)
+    {
+        BYTE* pbPrevious = static_cast<BYTE*>(::InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(&vpbArenaMin), pbBase, pbMin));
+        if (pbPrevious == pbMin)
+        {
+            break;
+        }
+
+        pbMin = pbPrevious;
+    }
+
+    BYTE* pbMax = static_cast<BYTE*>(ReadPointerAcquire(reinterpret_cast<PVOID const volatile*>(&vpbArenaMax)));
+    while (pbEnd > pbMax)
+    {
+        BYTE* pbPrevious = static_cast<BYTE*>(::InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(&vpbArenaMax), pbEnd, pbMax));
+        if (pbPrevious == pbMax)
+        {
+            break;
+        }
+
+        pbMax = pbPrevious;
+    }
+}
+
+static LPVOID ArenaAlloc(
+    __in MEM_ARENA* pArena,
+    __in SIZE_T cbSize
+    )
+{
+    LPVOID pv = NULL;
+    SIZE_T cbBlock = 0;
+
+    if (cbSize > static_cast<SIZE_T>(pArena->pbEnd - pArena->pbBase))
+    {
+        return NULL;
+    }
+
+    cbBlock = MEM_ARENA_HEADER_SIZE + ((cbSize + MEMORY_ALLOCATION_ALIGNMENT - 1) & ~static_cast<SIZE_T>(MEMORY_ALLOCATION_ALIGNMENT - 1));
+
+    ::EnterCriticalSection(&pArena->cs);
+
+    if (cbBlock <= static_cast<SIZE_T>(pArena->pbEnd - pArena->pbNext) && ArenaCommit(pArena, pArena->pbNext + cbBlock))
+    {
+        *reinterpret_cast<SIZE_T*>(pArena->pbNext) = cbSize;
+
+        pv = pArena->pbNext + MEM_ARENA_HEADER_SIZE;
+        pArena->pbLast = pArena->pbNext;
+        pArena->pbNext += cbBlock;
+
+        if (vfStatistics)
+        {
+            pArena->cbRecorded += cbSize;
+        }
+    }
+
+    ::LeaveCriticalSection(&pArena->cs);
+
+    return pv;
+}
+
+static LPVOID ArenaReAlloc(
+    __in MEM_ARENA* pArena,
+    __in LPVOID pv,
+    __in SIZE_T cbSize,
+    __in BOOL fZero
+    )
+{
+    BYTE* pbHeader = static_cast<BYTE*>(pv) - MEM_ARENA_HEADER_SIZE;
+    SIZE_T cbCurrent = *reinterpret_cast<SIZE_T*>(pbHeader);
+    BYTE* pbRequiredEnd = NULL;
+    LPVOID pvNew = NULL;
+
+    // The most recent block can grow or shrink in place, which keeps repeated concatenation cheap.
+    // The arena never moves pbNext backwards so bytes past the old size may be stale and are zeroed here.
+    ::EnterCriticalSection(&pArena->cs);
+
+    if (pbHeader == pArena->pbLast && cbSize <= static_cast<SIZE_T>(pArena->pbEnd - static_cast<BYTE*>(pv)))
+    {
+        pbRequiredEnd = static_cast<BYTE*>(pv) + ((cbSize + MEMORY_ALLOCATION_ALIGNMENT - 1) & ~static_cast<SIZE_T>(MEMORY_ALLOCATION_ALIGNMENT - 1));
+
+        if (pbRequiredEnd <= pArena->pbEnd && ArenaCommit(pArena, pbRequiredEnd))
+        {
+            if (pbRequiredEnd > pArena->pbNext)
+            {
+                pArena->pbNext = pbRequiredEnd;
+            }
+
+            if (fZero && cbSize > cbCurrent)
+            {
+                memset(static_cast<BYTE*>(pv) + cbCurrent, 0, cbSize - cbCurrent);
+            }
+
+            if (vfStatistics && cbSize > cbCurrent)
+            {
+                pArena->cbRecorded += cbSize - cbCurrent;
+                RecordBytes(static_cast<LONG64>(cbSize - cbCurrent));
+            }
+
+            *reinterpret_cast<SIZE_T*>(pbHeader) = cbSize;
+            pvNew = pv;
+        }
+    }
+
+    ::LeaveCriticalSection(&pArena->cs);
+
+    if (!pvNew)
+    {
+        if (cbSize <= cbCurrent)
+        {
+            *reinterpret_cast<SIZE_T*>(pbHeader) = cbSize;
+            pvNew = pv;
+        }
+        else
+        {
+            // Outside an arena scope this moves the block to the process heap.
+            pvNew = MemAlloc(cbSize, fZero);
+            if (pvNew)
+            {
+                memcpy_s(pvNew, cbSize, pv, cbCurrent);
+            }
+        }
+    }
+
+    return pvNew;
+}
+
+static BOOL ArenaCommit(
+    __in MEM_ARENA* pArena,
+    __in BYTE* pbRequiredEnd
+    )
+{
+    SIZE_T cbCommit = 0;
+
+    if (pbRequiredEnd <= pArena->pbCommitted)
+    {
+        return TRUE;
+    }
+
+    cbCommit = static_cast<SIZE_T>(pbRequiredEnd - pArena->pbCommitted);
+    cbCommit = (cbCommit + MEM_ARENA_COMMIT_SIZE - 1) & ~(MEM_ARENA_COMMIT_SIZE - 1);
+    if (cbCommit > static_cast<SIZE_T>(pArena->pbEnd - pArena->pbCommitted))
+    {
+        cbCommit = static_cast<SIZE_T>(pArena->pbEnd - pArena->pbCommitted);
+    }
+
+    if (!::VirtualAlloc(pArena->pbCommitted, cbCommit, MEM_COMMIT, PAGE_READWRITE))
+    {
+        return FALSE;
+    }
+
+    pArena->pbCommitted += cbCommit;
+
+    return TRUE;
+}
+
+static SIZE_T ArenaBlockSize(
+    __in LPCVOID pv
+    )
+{
+    return *reinterpret_cast<const SIZE_T*>(static_cast<const BYTE*>(pv) - MEM_ARENA_HEADER_SIZE);
+}
+
+static void RecordAllocation(
+    __in SIZE_T cbSize,
+    __in BOOL fArena
+    )
+{
+    ::InterlockedIncrement64(&vcAllocations);
+
+    if (fArena)
+    {
+        ::InterlockedIncrement64(&vcArenaAllocations);
+    }
+
+    RecordBytes(static_cast<LONG64>(cbSize));
+}
+
+static void RecordBytes(
+    __in LONG64 cbDelta
+    )
+{
+    LONG64 cbCurrent = ::InterlockedExchangeAdd64(&vcbCurrent, cbDelta) + cbDelta;
+    LONG64 cbPeak = vcbPeak;
+
+    while (cbCurrent > cbPeak)
+    {
+        LONG64 cbPrevious = ::InterlockedCompareExchange64(&vcbPeak, cbCurrent, cbPeak);
+        if (cbPrevious == cbPeak)
+        {
+            break;
+        }
+
+        cbPeak = cbPrevious;
+    }
+}
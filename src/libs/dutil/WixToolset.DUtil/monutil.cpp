@@ -26,6 +26,10 @@ const int MON_THREAD_INIT_RETRY_PERIOD_IN_MS = 10;
 const int MON_THREAD_NETWORK_FAIL_RETRY_IN_MS = 1000*60; // if we know we failed to connect, retry every minute
 const int MON_THREAD_NETWORK_SUCCESSFUL_RETRY_IN_MS = 1000*60*20; // if we're just checking for remote servers dieing, check much less frequently
 const int MON_THREAD_WAIT_REMOVE_DEVICE = 5000;
+const int MON_PORT_BUFFER_BYTES = 16 * 1024; // per watched directory, so this stays small enough for thousands of directories
+const int MON_PORT_MAX_PENDING_CHANGES = 4096; // records beyond this are dropped and reported as an overflow
+const int MON_PORT_STOP_DRAIN_IN_MS = 5000;
+const DWORD MON_DIRECTORY_NOTIFY_FILTER = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SECURITY;
 const LPCWSTR MONUTIL_WINDOW_CLASS = L"MonUtilClass";
 
 enum MON_MESSAGE
@@ -48,6 +52,13 @@ enum MON_MESSAGE
     MON_MESSAGE_STOP
 };
 
+// Completion keys used on the completion port
+enum MON_PORT_KEY
+{
+    MON_PORT_KEY_MESSAGE = 1, // lpOverlapped is a MON_PORT_MESSAGE
+    MON_PORT_KEY_READ, // lpOverlapped is a MON_PORT_READ
+};
+
 enum MON_TYPE
 {
     MON_NONE = 0,
@@ -208,6 +219,63 @@ struct MON_STRUCT
     // Waiter thread array
     MON_WAITER_INFO *rgWaiterThreads;
     DWORD cWaiterThreads;
+
+    DWORD dwFlags;
+    PFN_MONDIRECTORYCHANGES vpfMonDirectoryChanges;
+
+    // Completion port and the thread that monitors all directories when MON_FLAG_COMPLETION_PORT is set
+    HANDLE hPort;
+    HANDLE hPortThread;
+};
+
+// Messages the coordinator thread and public functions post to the completion port thread, using the same values and parameters as
+// the messages posted to waiter threads
+struct MON_PORT_MESSAGE
+{
+    UINT uMsg;
+    WPARAM wParam;
+    LPARAM lParam;
+};
+
+struct MON_PORT_REQUEST;
+
+// One outstanding ReadDirectoryChangesW() on an open directory handle. Each re-initiated wait gets a new read, because the
+// OVERLAPPED of a closed handle can't be reused until its aborted completion is dequeued.
+struct MON_PORT_READ
+{
+    OVERLAPPED overlapped; // must be first
+    MON_PORT_REQUEST *pRequest; // NULL once the request stopped using this read, it is freed when its completion arrives
+    HANDLE hDirectory;
+    BOOL fPending;
+    BYTE rgbBuffer[MON_PORT_BUFFER_BYTES];
+};
+
+struct MON_PORT_REQUEST
+{
+    MON_REQUEST request;
+    MON_PORT_READ *pRead;
+
+    DWORD dwLastChangeTick;
+
+    // Changes collected during the silence period, only when detailed notifications were requested
+    MON_DIRECTORY_CHANGE *rgChanges;
+    DWORD cChanges;
+    BOOL fOverflow;
+};
+
+// State owned by the completion port thread
+struct MON_PORT_CONTEXT
+{
+    MON_STRUCT *pm;
+
+    MON_PORT_REQUEST **rgpRequests;
+    DWORD cRequests;
+
+    // Number of pending notifications
+    DWORD cRequestsPending;
+
+    // Reads that were issued and whose completion has not been dequeued yet
+    DWORD cReadsOutstanding;
 };
 
 const int MON_HANDLE_BYTES = sizeof(MON_STRUCT);
@@ -280,6 +348,68 @@ static HRESULT UpdateWaitStatus(
     __in DWORD dwRequestIndex,
     __out_opt DWORD *pdwNewRequestIndex
     );
+static HRESULT PostPortMessage(
+    __in HANDLE hPort,
+    __in UINT uMsg,
+    __in WPARAM wParam,
+    __in LPARAM lParam
+    );
+static DWORD WINAPI PortThread(
+    __in_bcount(sizeof(MON_STRUCT)) LPVOID pvContext
+    );
+static HRESULT PortHandleMessage(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_MESSAGE *pMessage,
+    __out BOOL *pfStop
+    );
+static HRESULT PortHandleRead(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_READ *pRead,
+    __in DWORD er,
+    __in DWORD cbRead
+    );
+// Opens the directory (or its closest existing parent) and issues the first read, closing any previous read of the request
+static HRESULT PortInitiateWait(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest
+    );
+static HRESULT PortIssueRead(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest
+    );
+static void PortCloseRead(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest
+    );
+static void PortRecordChanges(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest,
+    __in DWORD cbRead
+    );
+static void PortChangeDetected(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest
+    );
+static HRESULT PortUpdateWaitStatus(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest,
+    __in HRESULT hrNewStatus
+    );
+static void PortNotify(
+    __in HRESULT hr,
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest
+    );
+static DWORD PortFirePendingNotifications(
+    __in MON_PORT_CONTEXT *pContext
+    );
+static void PortRemoveRequest(
+    __in MON_PORT_CONTEXT *pContext,
+    __in DWORD dwRequestIndex
+    );
+static void PortReleaseChanges(
+    __in MON_PORT_REQUEST *pPortRequest
+    );
 
 extern "C" HRESULT DAPI MonCreate(
     __out_bcount(MON_HANDLE_BYTES) MON_HANDLE *pHandle,
@@ -289,24 +419,56 @@ extern "C" HRESULT DAPI MonCreate(
     __in_opt PFN_MONREGKEY vpfMonRegKey,
     __in_opt LPVOID pvContext
     )
+{
+    return MonCreateEx(pHandle, MON_FLAG_NONE, vpfMonGeneral, vpfMonDriveStatus, vpfMonDirectory, NULL, vpfMonRegKey, pvContext);
+}
+
+extern "C" HRESULT DAPI MonCreateEx(
+    __out_bcount(MON_HANDLE_BYTES) MON_HANDLE *pHandle,
+    __in DWORD dwFlags,
+    __in PFN_MONGENERAL vpfMonGeneral,
+    __in_opt PFN_MONDRIVESTATUS vpfMonDriveStatus,
+    __in_opt PFN_MONDIRECTORY vpfMonDirectory,
+    __in_opt PFN_MONDIRECTORYCHANGES vpfMonDirectoryChanges,
+    __in_opt PFN_MONREGKEY vpfMonRegKey,
+    __in_opt LPVOID pvContext
+    )
 {
     HRESULT hr = S_OK;
     DWORD dwRetries = MON_THREAD_INIT_RETRIES;
 
     MonExitOnNull(pHandle, hr, E_INVALIDARG, "Pointer to handle not specified while creating monitor");
 
+    if (dwFlags & MON_FLAG_DETAILED_DIRECTORY_NOTIFICATIONS)
+    {
+        MonExitOnNull(vpfMonDirectoryChanges, hr, E_INVALIDARG, "Directory changes callback not specified while requesting detailed directory notifications");
+
+        dwFlags |= MON_FLAG_COMPLETION_PORT;
+    }
+
     // Allocate the struct
     *pHandle = static_cast<MON_HANDLE>(MemAlloc(sizeof(MON_STRUCT), TRUE));
     MonExitOnNull(*pHandle, hr, E_OUTOFMEMORY, "Failed to allocate monitor object");
 
     MON_STRUCT *pm = static_cast<MON_STRUCT *>(*pHandle);
 
+    pm->dwFlags = dwFlags;
     pm->vpfMonGeneral = vpfMonGeneral;
     pm->vpfMonDriveStatus = vpfMonDriveStatus;
     pm->vpfMonDirectory = vpfMonDirectory;
+    pm->vpfMonDirectoryChanges = vpfMonDirectoryChanges;
     pm->vpfMonRegKey = vpfMonRegKey;
     pm->pvContext = pvContext;
 
+    if (dwFlags & MON_FLAG_COMPLETION_PORT)
+    {
+        pm->hPort = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+        MonExitOnNullWithLastError(pm->hPort, hr, "Failed to create completion port for directory monitoring.");
+
+        pm->hPortThread = ::CreateThread(NULL, 0, PortThread, pm, 0, NULL);
+        MonExitOnNullWithLastError(pm->hPortThread, hr, "Failed to create completion port thread.");
+    }
+
     pm->hCoordinatorThread = ::CreateThread(NULL, 0, CoordinatorThread, pm, 0, &pm->dwCoordinatorThreadId);
     if (!pm->hCoordinatorThread)
     {
@@ -387,7 +549,14 @@ extern "C" HRESULT DAPI MonAddDirectory(
     hr = PathGetHierarchyArray(sczDirectory, &pMessage->request.rgsczPathHierarchy, reinterpret_cast<LPUINT>(&pMessage->request.cPathHierarchy));
     MonExitOnFailure(hr, "Failed to get hierarchy array for path %ls", sczDirectory);
 
-    if (0 < pMessage->request.cPathHierarchy)
+    if (0 < pMessage->request.cPathHierarchy && pm->hPort)
+    {
+        // The completion port thread opens the directory itself
+        hr = PostPortMessage(pm->hPort, MON_MESSAGE_ADD, reinterpret_cast<WPARAM>(pMessage), 0);
+        MonExitOnFailure(hr, "Failed to send message to completion port thread to add directory wait for path %ls", sczDirectory);
+        pMessage = NULL;
+    }
+    else if (0 < pMessage->request.cPathHierarchy)
     {
         pMessage->request.hrStatus = InitiateWait(&pMessage->request, &pMessage->handle);
         if (!::PostThreadMessageW(pm->dwCoordinatorThreadId, MON_MESSAGE_ADD, reinterpret_cast<WPARAM>(pMessage), 0))
@@ -488,7 +657,12 @@ extern "C" HRESULT DAPI MonRemoveDirectory(
     hr = StrAllocString(&pMessage->directory.sczDirectory, sczDirectory, 0);
     MonExitOnFailure(hr, "Failed to allocate copy of directory string");
 
-    if (!::PostThreadMessageW(pm->dwCoordinatorThreadId, MON_MESSAGE_REMOVE, reinterpret_cast<WPARAM>(pMessage), 0))
+    if (pm->hPort)
+    {
+        hr = PostPortMessage(pm->hPort, MON_MESSAGE_REMOVE, reinterpret_cast<WPARAM>(pMessage), 0);
+        MonExitOnFailure(hr, "Failed to send message to completion port thread to remove directory wait for path %ls", sczDirectory);
+    }
+    else if (!::PostThreadMessageW(pm->dwCoordinatorThreadId, MON_MESSAGE_REMOVE, reinterpret_cast<WPARAM>(pMessage), 0))
     {
         MonExitWithLastError(hr, "Failed to send message to worker thread to add directory wait for path %ls", sczDirectory);
     }
@@ -568,6 +742,22 @@ extern "C" void DAPI MonDestroy(
         ::CloseHandle(pm->hCoordinatorThread);
     }
 
+    // The coordinator thread forwards messages to the completion port thread, so stop it only after the coordinator is gone
+    if (pm->hPortThread)
+    {
+        hr = PostPortMessage(pm->hPort, MON_MESSAGE_STOP, 0, 0);
+        if (SUCCEEDED(hr))
+        {
+            ::WaitForSingleObject(pm->hPortThread, INFINITE);
+        }
+        else
+        {
+            TraceError(hr, "Failed to send message to completion port thread to halt");
+        }
+        ::CloseHandle(pm->hPortThread);
+    }
+    ReleaseHandle(pm->hPort);
+
 LExit:
     return;
 }
@@ -843,6 +1033,12 @@ static DWORD WINAPI CoordinatorThread(
                         MonExitWithLastError(hr, "Failed to set event to notify waiter thread of incoming network status update message");
                     }
                 }
+
+                if (pm->hPort)
+                {
+                    hr = PostPortMessage(pm->hPort, MON_MESSAGE_NETWORK_STATUS_UPDATE, 0, 0);
+                    MonExitOnFailure(hr, "Failed to send message to completion port thread to notify of network status update");
+                }
                 break;
 
             case WM_TIMER:
@@ -861,6 +1057,12 @@ static DWORD WINAPI CoordinatorThread(
                         MonExitWithLastError(hr, "Failed to set event to notify waiter thread of incoming network status update message");
                     }
                 }
+
+                if (pm->hPort)
+                {
+                    hr = PostPortMessage(pm->hPort, msg.wParam == uTimerFailedNetworkRetry ? MON_MESSAGE_NETWORK_RETRY_FAILED_NETWORK_WAITS : MON_MESSAGE_NETWORK_RETRY_SUCCESSFUL_NETWORK_WAITS, 0, 0);
+                    MonExitOnFailure(hr, "Failed to send message to completion port thread to notify of network status update");
+                }
                 break;
 
             case MON_MESSAGE_DRIVE_STATUS_UPDATE:
@@ -885,6 +1087,12 @@ static DWORD WINAPI CoordinatorThread(
                         MonExitWithLastError(hr, "Failed to set event to notify waiter thread of incoming drive status update message");
                     }
                 }
+
+                if (pm->hPort)
+                {
+                    hr = PostPortMessage(pm->hPort, MON_MESSAGE_DRIVE_STATUS_UPDATE, msg.wParam, msg.lParam);
+                    MonExitOnFailure(hr, "Failed to send message to completion port thread to notify of drive status update");
+                }
                 break;
 
             case MON_MESSAGE_STOP:
@@ -1820,6 +2028,12 @@ static LRESULT CALLBACK MonWndProc(
                     }
                 }
 
+                if (pm->hPort)
+                {
+                    hr = PostPortMessage(pm->hPort, MON_MESSAGE_DRIVE_QUERY_REMOVE, reinterpret_cast<WPARAM>(&pm->internalWait), static_cast<LPARAM>(pm->internalWait.dwSendIteration));
+                    MonExitOnFailure(hr, "Failed to send message to completion port thread to notify of drive query remove");
+                }
+
                 hr = AppWaitForSingleObject(pm->internalWait.hWait, MON_THREAD_WAIT_REMOVE_DEVICE);
                 MonExitOnWaitObjectFailure(hr, fTimedOut, "WaitForSingleObject failed with non-timeout reason while waiting for response from waiter thread");
 
@@ -2004,3 +2218,722 @@ static HRESULT UpdateWaitStatus(
 LExit:
     return hr;
 }
+
+static HRESULT PostPortMessage(
+    __in HANDLE hPort,
+    __in UINT uMsg,
+    __in WPARAM wParam,
+    __in LPARAM lParam
+    )
+{
+    HRESULT hr = S_OK;
+    MON_PORT_MESSAGE *pMessage = NULL;
+
+    pMessage = reinterpret_cast<MON_PORT_MESSAGE *>(MemAlloc(sizeof(MON_PORT_MESSAGE), TRUE));
+    MonExitOnNull(pMessage, hr, E_OUTOFMEMORY, "Failed to allocate completion port message");
+
+    pMessage->uMsg = uMsg;
+    pMessage->wParam = wParam;
+    pMessage->lParam = lParam;
+
+    if (!::PostQueuedCompletionStatus(hPort, 0, MON_PORT_KEY_MESSAGE, reinterpret_cast<LPOVERLAPPED>(pMessage)))
+    {
+        MonExitWithLastError(hr, "Failed to post message %u to completion port", uMsg);
+    }
+    pMessage = NULL;
+
+LExit:
+    ReleaseMem(pMessage);
+
+    return hr;
+}
+
+static DWORD WINAPI PortThread(
+    __in_bcount(sizeof(MON_STRUCT)) LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    MON_PORT_CONTEXT context = { };
+    MON_PORT_MESSAGE *pMessage = NULL;
+    MON_PORT_READ *pRead = NULL;
+    LPOVERLAPPED pOverlapped = NULL;
+    ULONG_PTR uKey = 0;
+    DWORD cbTransferred = 0;
+    DWORD dwWait = INFINITE;
+    DWORD dwStopTick = 0;
+    BOOL fStop = FALSE;
+
+    context.pm = reinterpret_cast<MON_STRUCT *>(pvContext);
+
+    while (!fStop)
+    {
+        pOverlapped = NULL;
+        er = ERROR_SUCCESS;
+
+        if (!::GetQueuedCompletionStatus(context.pm->hPort, &cbTransferred, &uKey, &pOverlapped, dwWait))
+        {
+            er = ::GetLastError();
+
+            // A timeout means a silence period may have elapsed, a failed read still dequeues its overlapped
+            if (!pOverlapped && WAIT_TIMEOUT != er)
+            {
+                MonExitOnWin32Error(er, hr, "Failed to dequeue completion from completion port");
+            }
+        }
+
+        if (pOverlapped && MON_PORT_KEY_MESSAGE == uKey)
+        {
+            pMessage = reinterpret_cast<MON_PORT_MESSAGE *>(pOverlapped);
+
+            hr = PortHandleMessage(&context, pMessage, &fStop);
+            ReleaseNullMem(pMessage);
+            MonExitOnFailure(hr, "Failed to handle completion port message");
+        }
+        else if (pOverlapped && MON_PORT_KEY_READ == uKey)
+        {
+            hr = PortHandleRead(&context, reinterpret_cast<MON_PORT_READ *>(pOverlapped), er, cbTransferred);
+            MonExitOnFailure(hr, "Failed to handle directory changes");
+        }
+
+        // Fire the notifications whose silence period elapsed, and wake up in time for the next one
+        dwWait = PortFirePendingNotifications(&context);
+    }
+
+    // Don't bother firing pending notifications. We were told to stop monitoring, so client doesn't care.
+
+LExit:
+    for (DWORD i = 0; i < context.cRequests; ++i)
+    {
+        PortCloseRead(&context, context.rgpRequests[i]);
+        PortReleaseChanges(context.rgpRequests[i]);
+        MonRequestDestroy(&context.rgpRequests[i]->request);
+        ReleaseMem(context.rgpRequests[i]);
+    }
+    ReleaseMem(context.rgpRequests);
+
+    // Closing the directory handles aborted the outstanding reads, and their buffers can't be freed until the completions are dequeued
+    dwStopTick = ::GetTickCount();
+    while (0 < context.cReadsOutstanding && MON_PORT_STOP_DRAIN_IN_MS > ::GetTickCount() - dwStopTick)
+    {
+        pOverlapped = NULL;
+        ::GetQueuedCompletionStatus(context.pm->hPort, &cbTransferred, &uKey, &pOverlapped, MON_PORT_STOP_DRAIN_IN_MS);
+        if (!pOverlapped)
+        {
+            break;
+        }
+        else if (MON_PORT_KEY_READ == uKey)
+        {
+            pRead = reinterpret_cast<MON_PORT_READ *>(pOverlapped);
+            Assert(!pRead->pRequest);
+
+            --context.cReadsOutstanding;
+            ReleaseMem(pRead);
+        }
+        else
+        {
+            pMessage = reinterpret_cast<MON_PORT_MESSAGE *>(pOverlapped);
+            if (MON_MESSAGE_ADD == pMessage->uMsg)
+            {
+                MonAddMessageDestroy(reinterpret_cast<MON_ADD_MESSAGE *>(pMessage->wParam));
+            }
+            else if (MON_MESSAGE_REMOVE == pMessage->uMsg)
+            {
+                MonRemoveMessageDestroy(reinterpret_cast<MON_REMOVE_MESSAGE *>(pMessage->wParam));
+            }
+            ReleaseNullMem(pMessage);
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        // If completion port thread fails, notify general callback of an error
+        Assert(context.pm->vpfMonGeneral);
+        context.pm->vpfMonGeneral(hr, context.pm->pvContext);
+    }
+
+    return hr;
+}
+
+static HRESULT PortHandleMessage(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_MESSAGE *pMessage,
+    __out BOOL *pfStop
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrTemp = S_OK;
+    MON_ADD_MESSAGE *pAddMessage = NULL;
+    MON_REMOVE_MESSAGE *pRemoveMessage = NULL;
+    MON_PORT_REQUEST *pPortRequest = NULL;
+    MON_REQUEST *pRequest = NULL;
+    MON_INTERNAL_TEMPORARY_WAIT *pInternalWait = NULL;
+    BOOL fRetry = FALSE;
+
+    *pfStop = FALSE;
+
+    switch (pMessage->uMsg)
+    {
+    case MON_MESSAGE_ADD:
+        pAddMessage = reinterpret_cast<MON_ADD_MESSAGE *>(pMessage->wParam);
+
+        hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID *>(&pContext->rgpRequests), pContext->cRequests, 1, sizeof(MON_PORT_REQUEST *), MON_ARRAY_GROWTH);
+        MonExitOnFailure(hr, "Failed to grow completion port request array");
+
+        pPortRequest = reinterpret_cast<MON_PORT_REQUEST *>(MemAlloc(sizeof(MON_PORT_REQUEST), TRUE));
+        MonExitOnNull(pPortRequest, hr, E_OUTOFMEMORY, "Failed to allocate completion port request");
+
+        // The request now owns the strings of the message
+        pPortRequest->request = pAddMessage->request;
+        ReleaseNullMem(pAddMessage);
+
+        pContext->rgpRequests[pContext->cRequests] = pPortRequest;
+        ++pContext->cRequests;
+
+        // Failures here get recorded in the request's status and are retried like any other failing wait
+        pPortRequest->request.hrStatus = PortInitiateWait(pContext, pPortRequest);
+        pPortRequest = NULL;
+        break;
+
+    case MON_MESSAGE_REMOVE:
+        pRemoveMessage = reinterpret_cast<MON_REMOVE_MESSAGE *>(pMessage->wParam);
+
+        for (DWORD i = 0; i < pContext->cRequests; ++i)
+        {
+            pRequest = &pContext->rgpRequests[i]->request;
+            if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, pRequest->rgsczPathHierarchy[pRequest->cPathHierarchy - 1], -1, pRemoveMessage->directory.sczDirectory, -1) && pRequest->fRecursive == pRemoveMessage->fRecursive)
+            {
+                PortRemoveRequest(pContext, i);
+                break;
+            }
+        }
+        break;
+
+    case MON_MESSAGE_NETWORK_STATUS_UPDATE:
+    case MON_MESSAGE_NETWORK_RETRY_FAILED_NETWORK_WAITS:
+    case MON_MESSAGE_NETWORK_RETRY_SUCCESSFUL_NETWORK_WAITS:
+    case MON_MESSAGE_DRIVE_STATUS_UPDATE:
+        for (DWORD i = 0; i < pContext->cRequests; ++i)
+        {
+            pPortRequest = pContext->rgpRequests[i];
+            pRequest = &pPortRequest->request;
+
+            switch (pMessage->uMsg)
+            {
+            case MON_MESSAGE_NETWORK_STATUS_UPDATE:
+                fRetry = pRequest->fNetwork;
+                break;
+            case MON_MESSAGE_NETWORK_RETRY_FAILED_NETWORK_WAITS:
+                fRetry = pRequest->fNetwork && FAILED(pRequest->hrStatus);
+                break;
+            case MON_MESSAGE_NETWORK_RETRY_SUCCESSFUL_NETWORK_WAITS:
+                fRetry = pRequest->fNetwork && SUCCEEDED(pRequest->hrStatus);
+                break;
+            default:
+                fRetry = pRequest->sczOriginalPathRequest[0] == static_cast<WCHAR>(pMessage->wParam);
+                break;
+            }
+
+            if (fRetry)
+            {
+                if (MON_MESSAGE_DRIVE_STATUS_UPDATE == pMessage->uMsg && !static_cast<BOOL>(pMessage->lParam))
+                {
+                    // If the message says the drive is disconnected, don't even try to wait, just mark it as gone
+                    PortCloseRead(pContext, pPortRequest);
+                    hrTemp = E_PATHNOTFOUND;
+                }
+                else
+                {
+                    // Failures here get recorded in the request's status
+                    hrTemp = PortInitiateWait(pContext, pPortRequest);
+                }
+
+                hr = PortUpdateWaitStatus(pContext, pPortRequest, hrTemp);
+                MonExitOnFailure(hr, "Failed to update wait status");
+            }
+        }
+        pPortRequest = NULL;
+        break;
+
+    case MON_MESSAGE_DRIVE_QUERY_REMOVE:
+        pInternalWait = reinterpret_cast<MON_INTERNAL_TEMPORARY_WAIT *>(pMessage->wParam);
+        // Only do any work if message is not yet out of date
+        if (pInternalWait->dwSendIteration == static_cast<DWORD>(pMessage->lParam))
+        {
+            for (DWORD i = 0; i < pContext->cRequests; ++i)
+            {
+                pPortRequest = pContext->rgpRequests[i];
+                if (pPortRequest->pRead && pPortRequest->pRead->hDirectory == reinterpret_cast<HANDLE>(pInternalWait->pvContext))
+                {
+                    // Release handles ASAP so the remove request will succeed
+                    PortCloseRead(pContext, pPortRequest);
+
+                    // Reply to unblock our reply to the remove request
+                    pInternalWait->dwReceiveIteration = static_cast<DWORD>(pMessage->lParam);
+                    if (!::SetEvent(pInternalWait->hWait))
+                    {
+                        TraceError(HRESULT_FROM_WIN32(::GetLastError()), "Failed to set event to notify coordinator thread that removable device handle was released, this could be due to wndproc no longer waiting for completion port thread's response");
+                    }
+
+                    // Drive is disconnecting, don't even try to wait, just mark it as gone
+                    hr = PortUpdateWaitStatus(pContext, pPortRequest, E_PATHNOTFOUND);
+                    MonExitOnFailure(hr, "Failed to update wait status");
+                    break;
+                }
+            }
+            pPortRequest = NULL;
+        }
+        break;
+
+    case MON_MESSAGE_STOP:
+        // Stop requested, so abort the whole thread
+        Trace(REPORT_DEBUG, "Completion port thread was told to stop");
+        *pfStop = TRUE;
+        break;
+
+    default:
+        Assert(false);
+        break;
+    }
+
+LExit:
+    MonAddMessageDestroy(pAddMessage);
+    MonRemoveMessageDestroy(pRemoveMessage);
+
+    return hr;
+}
+
+static HRESULT PortHandleRead(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_READ *pRead,
+    __in DWORD er,
+    __in DWORD cbRead
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrTemp = S_OK;
+    MON_PORT_REQUEST *pPortRequest = pRead->pRequest;
+    MON_REQUEST *pRequest = NULL;
+    BOOL fNotify = FALSE;
+
+    Assert(0 < pContext->cReadsOutstanding);
+    --pContext->cReadsOutstanding;
+    pRead->fPending = FALSE;
+
+    if (!pPortRequest)
+    {
+        // The wait was re-initiated or removed since this read was issued, this is just its aborted completion
+        ReleaseMem(pRead);
+        ExitFunction();
+    }
+
+    pRequest = &pPortRequest->request;
+
+    // Only notify if it's the actual target, and not just some parent waiting for the target child to exist
+    fNotify = (pRequest->dwPathHierarchyIndex == pRequest->cPathHierarchy - 1);
+
+    if (fNotify && (ERROR_SUCCESS == er || ERROR_NOTIFY_ENUM_DIR == er))
+    {
+        // A successful read with no data means the kernel buffer overflowed and the records were lost
+        if (ERROR_SUCCESS == er && 0 < cbRead)
+        {
+            PortRecordChanges(pContext, pPortRequest, cbRead);
+        }
+        else
+        {
+            pPortRequest->fOverflow = TRUE;
+        }
+
+        // Re-issue the read before we notify callback, to ensure we don't miss a single update
+        hrTemp = PortIssueRead(pContext, pPortRequest);
+        if (FAILED(hrTemp))
+        {
+            hrTemp = PortInitiateWait(pContext, pPortRequest);
+        }
+    }
+    else
+    {
+        // The directory went away or a parent changed, find the closest directory that exists now
+        hrTemp = PortInitiateWait(pContext, pPortRequest);
+    }
+
+    hr = PortUpdateWaitStatus(pContext, pPortRequest, hrTemp);
+    MonExitOnFailure(hr, "Failed to update wait status");
+
+    // If there were no errors and we were already waiting on the right target, or if we weren't yet but are able to now, it's a successful notify
+    if (SUCCEEDED(pRequest->hrStatus) && (fNotify || (pRequest->dwPathHierarchyIndex == pRequest->cPathHierarchy - 1)))
+    {
+        if (!fNotify || ERROR_SUCCESS != er)
+        {
+            // The directory was (re)created or lost its handle, so the records can't be trusted to be complete
+            pPortRequest->fOverflow = TRUE;
+        }
+
+        PortChangeDetected(pContext, pPortRequest);
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT PortInitiateWait(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest
+    )
+{
+    HRESULT hr = S_OK;
+    MON_REQUEST *pRequest = &pPortRequest->request;
+    MON_PORT_READ *pRead = NULL;
+    HANDLE hDirectory = INVALID_HANDLE_VALUE;
+    DEV_BROADCAST_HANDLE dev = { };
+    DWORD dwIndex = 0;
+    DWORD dwAttributes = 0;
+    BOOL fRedo = FALSE;
+
+    do
+    {
+        fRedo = FALSE;
+        hr = E_PATHNOTFOUND;
+
+        PortCloseRead(pContext, pPortRequest);
+
+        for (DWORD i = 0; i < pRequest->cPathHierarchy; ++i)
+        {
+            dwIndex = pRequest->cPathHierarchy - i - 1;
+
+            hDirectory = ::CreateFileW(pRequest->rgsczPathHierarchy[dwIndex], FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+            if (INVALID_HANDLE_VALUE == hDirectory)
+            {
+                hr = HRESULT_FROM_WIN32(::GetLastError());
+                if (E_FILENOTFOUND == hr || E_PATHNOTFOUND == hr || E_ACCESSDENIED == hr)
+                {
+                    continue;
+                }
+                MonExitOnFailure(hr, "Failed to open directory %ls", pRequest->rgsczPathHierarchy[dwIndex]);
+            }
+
+            hr = S_OK;
+            break;
+        }
+        MonExitOnFailure(hr, "Didn't get a successful wait after looping through all available options %ls", pRequest->rgsczPathHierarchy[pRequest->cPathHierarchy - 1]);
+
+        pRequest->dwPathHierarchyIndex = dwIndex;
+
+        pRead = reinterpret_cast<MON_PORT_READ *>(MemAlloc(sizeof(MON_PORT_READ), TRUE));
+        MonExitOnNull(pRead, hr, E_OUTOFMEMORY, "Failed to allocate directory read buffer");
+
+        pRead->pRequest = pPortRequest;
+        pRead->hDirectory = hDirectory;
+        hDirectory = INVALID_HANDLE_VALUE;
+        pPortRequest->pRead = pRead;
+        pRead = NULL;
+
+        if (!::CreateIoCompletionPort(pPortRequest->pRead->hDirectory, pContext->pm->hPort, MON_PORT_KEY_READ, 0))
+        {
+            MonExitWithLastError(hr, "Failed to associate directory with completion port %ls", pRequest->rgsczPathHierarchy[dwIndex]);
+        }
+
+        hr = PortIssueRead(pContext, pPortRequest);
+        MonExitOnFailure(hr, "Failed to wait on path %ls", pRequest->rgsczPathHierarchy[dwIndex]);
+
+        // If we're monitoring a parent instead of the real path because the real path didn't exist, double-check the child hasn't been created since.
+        // If it has, restart the whole loop
+        if (dwIndex < pRequest->cPathHierarchy - 1)
+        {
+            dwAttributes = ::GetFileAttributesW(pRequest->rgsczPathHierarchy[dwIndex + 1]);
+            fRedo = INVALID_FILE_ATTRIBUTES != dwAttributes && (FILE_ATTRIBUTE_DIRECTORY & dwAttributes);
+        }
+    } while (fRedo);
+
+    dev.dbch_size = sizeof(dev);
+    dev.dbch_devicetype = DBT_DEVTYP_HANDLE;
+    dev.dbch_handle = pPortRequest->pRead->hDirectory;
+    // Ignore failure on this - some drives by design don't support it (like network paths), and the worst that can happen is a
+    // removable device will be left in use so user cannot gracefully remove
+    pRequest->hNotify = RegisterDeviceNotification(pRequest->hwnd, &dev, DEVICE_NOTIFY_WINDOW_HANDLE);
+
+LExit:
+    if (FAILED(hr))
+    {
+        PortCloseRead(pContext, pPortRequest);
+    }
+
+    ReleaseFileHandle(hDirectory);
+    ReleaseMem(pRead);
+
+    return hr;
+}
+
+static HRESULT PortIssueRead(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest
+    )
+{
+    HRESULT hr = S_OK;
+    MON_REQUEST *pRequest = &pPortRequest->request;
+    MON_PORT_READ *pRead = pPortRequest->pRead;
+    DWORD dwIndex = pRequest->dwPathHierarchyIndex;
+    // Parents only matter when the next directory down the hierarchy gets created
+    DWORD dwFilter = (pRequest->cPathHierarchy - 1 == dwIndex) ? MON_DIRECTORY_NOTIFY_FILTER : FILE_NOTIFY_CHANGE_DIR_NAME;
+
+    ZeroMemory(&pRead->overlapped, sizeof(pRead->overlapped));
+
+    if (!::ReadDirectoryChangesW(pRead->hDirectory, pRead->rgbBuffer, sizeof(pRead->rgbBuffer), GetRecursiveFlag(pRequest, dwIndex), dwFilter, NULL, &pRead->overlapped, NULL))
+    {
+        MonExitWithLastError(hr, "Failed to read changes of directory %ls", pRequest->rgsczPathHierarchy[dwIndex]);
+    }
+
+    pRead->fPending = TRUE;
+    ++pContext->cReadsOutstanding;
+
+LExit:
+    return hr;
+}
+
+static void PortCloseRead(
+    __in MON_PORT_CONTEXT * /*pContext*/,
+    __in MON_PORT_REQUEST *pPortRequest
+    )
+{
+    MON_PORT_READ *pRead = pPortRequest->pRead;
+
+    if (pPortRequest->request.hNotify)
+    {
+        UnregisterDeviceNotification(pPortRequest->request.hNotify);
+        pPortRequest->request.hNotify = NULL;
+    }
+
+    if (pRead)
+    {
+        pPortRequest->pRead = NULL;
+        pRead->pRequest = NULL;
+
+        // Closing the handle aborts the pending read, whose completion frees the buffer
+        ReleaseFileHandle(pRead->hDirectory);
+
+        if (!pRead->fPending)
+        {
+            ReleaseMem(pRead);
+        }
+    }
+}
+
+static void PortRecordChanges(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest,
+    __in DWORD cbRead
+    )
+{
+    HRESULT hr = S_OK;
+    FILE_NOTIFY_INFORMATION *pInfo = reinterpret_cast<FILE_NOTIFY_INFORMATION *>(pPortRequest->pRead->rgbBuffer);
+    LPWSTR sczRelativePath = NULL;
+
+    // Clients without detailed notifications rescan anyway
+    if (!(pContext->pm->dwFlags & MON_FLAG_DETAILED_DIRECTORY_NOTIFICATIONS) || pPortRequest->fOverflow)
+    {
+        ExitFunction();
+    }
+
+    Assert(cbRead <= sizeof(pPortRequest->pRead->rgbBuffer));
+
+    for (;;)
+    {
+        if (MON_PORT_MAX_PENDING_CHANGES <= pPortRequest->cChanges)
+        {
+            ExitFunction1(hr = HRESULT_FROM_WIN32(ERROR_NOTIFY_ENUM_DIR));
+        }
+
+        hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID *>(&pPortRequest->rgChanges), pPortRequest->cChanges, 1, sizeof(MON_DIRECTORY_CHANGE), MON_ARRAY_GROWTH);
+        MonExitOnFailure(hr, "Failed to grow directory change array");
+
+        hr = StrAllocString(&sczRelativePath, pInfo->FileName, pInfo->FileNameLength / sizeof(WCHAR));
+        MonExitOnFailure(hr, "Failed to copy changed file name");
+
+        pPortRequest->rgChanges[pPortRequest->cChanges].dwAction = pInfo->Action;
+        pPortRequest->rgChanges[pPortRequest->cChanges].wzRelativePath = sczRelativePath;
+        sczRelativePath = NULL;
+        ++pPortRequest->cChanges;
+
+        if (!pInfo->NextEntryOffset)
+        {
+            break;
+        }
+
+        pInfo = reinterpret_cast<FILE_NOTIFY_INFORMATION *>(reinterpret_cast<BYTE *>(pInfo) + pInfo->NextEntryOffset);
+    }
+
+LExit:
+    if (FAILED(hr))
+    {
+        // Records that couldn't be kept are reported as an overflow so the client rescans
+        pPortRequest->fOverflow = TRUE;
+    }
+
+    ReleaseStr(sczRelativePath);
+}
+
+static void PortChangeDetected(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest
+    )
+{
+    Trace(REPORT_DEBUG, "Changes detected, waiting for silence period %ls", pPortRequest->request.sczOriginalPathRequest);
+
+    if (0 < pPortRequest->request.dwMaxSilencePeriodInMs)
+    {
+        // Every change restarts the silence period
+        pPortRequest->dwLastChangeTick = ::GetTickCount();
+
+        if (!pPortRequest->request.fPendingFire)
+        {
+            pPortRequest->request.fPendingFire = TRUE;
+            ++pContext->cRequestsPending;
+        }
+    }
+    else
+    {
+        // If no silence period, notify immediately
+        PortNotify(S_OK, pContext, pPortRequest);
+    }
+}
+
+static HRESULT PortUpdateWaitStatus(
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest,
+    __in HRESULT hrNewStatus
+    )
+{
+    HRESULT hr = S_OK;
+    MON_REQUEST *pRequest = &pPortRequest->request;
+
+    if (SUCCEEDED(pRequest->hrStatus) || SUCCEEDED(hrNewStatus))
+    {
+        // If it's a network wait, notify as long as it's new status is successful because we *may* have lost some changes
+        // before the wait was re-initiated. Otherwise, only notify if there was an interesting status change
+        if (SUCCEEDED(pRequest->hrStatus) != SUCCEEDED(hrNewStatus) || (pRequest->fNetwork && SUCCEEDED(hrNewStatus)))
+        {
+            pPortRequest->fOverflow = TRUE;
+            PortNotify(hrNewStatus, pContext, pPortRequest);
+        }
+
+        if (pRequest->fNetwork && SUCCEEDED(pRequest->hrStatus) && FAILED(hrNewStatus))
+        {
+            // Notify coordinator thread that a network wait is failing, so it retries periodically
+            if (!::PostThreadMessageW(pContext->pm->dwCoordinatorThreadId, MON_MESSAGE_NETWORK_WAIT_FAILED, 0, 0))
+            {
+                MonExitWithLastError(hr, "Failed to send message to coordinator thread to notify a network wait started to fail");
+            }
+        }
+        else if (pRequest->fNetwork && FAILED(pRequest->hrStatus) && SUCCEEDED(hrNewStatus))
+        {
+            if (!::PostThreadMessageW(pContext->pm->dwCoordinatorThreadId, MON_MESSAGE_NETWORK_WAIT_SUCCEEDED, 0, 0))
+            {
+                MonExitWithLastError(hr, "Failed to send message to coordinator thread to notify a network wait is succeeding again");
+            }
+        }
+    }
+
+    pRequest->hrStatus = hrNewStatus;
+
+LExit:
+    return hr;
+}
+
+static void PortNotify(
+    __in HRESULT hr,
+    __in MON_PORT_CONTEXT *pContext,
+    __in MON_PORT_REQUEST *pPortRequest
+    )
+{
+    MON_STRUCT *pm = pContext->pm;
+    MON_REQUEST *pRequest = &pPortRequest->request;
+
+    if (pRequest->fPendingFire)
+    {
+        --pContext->cRequestsPending;
+    }
+
+    pRequest->fPendingFire = FALSE;
+
+    if (pm->dwFlags & MON_FLAG_DETAILED_DIRECTORY_NOTIFICATIONS)
+    {
+        Assert(pm->vpfMonDirectoryChanges);
+        pm->vpfMonDirectoryChanges(hr, pRequest->sczOriginalPathRequest, pRequest->fRecursive, pPortRequest->rgChanges, pPortRequest->cChanges, pPortRequest->fOverflow, pm->pvContext, pRequest->pvContext);
+    }
+    else
+    {
+        Assert(pm->vpfMonDirectory);
+        pm->vpfMonDirectory(hr, pRequest->sczOriginalPathRequest, pRequest->fRecursive, pm->pvContext, pRequest->pvContext);
+    }
+
+    PortReleaseChanges(pPortRequest);
+}
+
+static DWORD PortFirePendingNotifications(
+    __in MON_PORT_CONTEXT *pContext
+    )
+{
+    DWORD dwWait = INFINITE;
+    DWORD dwNow = ::GetTickCount();
+    DWORD dwElapsed = 0;
+    MON_PORT_REQUEST *pPortRequest = NULL;
+
+    for (DWORD i = 0; i < pContext->cRequests && 0 < pContext->cRequestsPending; ++i)
+    {
+        pPortRequest = pContext->rgpRequests[i];
+        if (pPortRequest->request.fPendingFire)
+        {
+            dwElapsed = dwNow - pPortRequest->dwLastChangeTick;
+
+            // silence period has elapsed without further notifications, so finally fire a notify!
+            if (dwElapsed >= pPortRequest->request.dwMaxSilencePeriodInMs)
+            {
+                Trace(REPORT_DEBUG, "Silence period surpassed, notifying %u ms late", dwElapsed - pPortRequest->request.dwMaxSilencePeriodInMs);
+                PortNotify(S_OK, pContext, pPortRequest);
+            }
+            else if (dwWait > pPortRequest->request.dwMaxSilencePeriodInMs - dwElapsed)
+            {
+                // wake the thread back up when it's time to fire the next pending notification
+                dwWait = pPortRequest->request.dwMaxSilencePeriodInMs - dwElapsed;
+            }
+        }
+    }
+
+    return dwWait;
+}
+
+static void PortRemoveRequest(
+    __in MON_PORT_CONTEXT *pContext,
+    __in DWORD dwRequestIndex
+    )
+{
+    MON_PORT_REQUEST *pPortRequest = pContext->rgpRequests[dwRequestIndex];
+
+    PortCloseRead(pContext, pPortRequest);
+
+    if (pPortRequest->request.fPendingFire)
+    {
+        --pContext->cRequestsPending;
+    }
+
+    PortReleaseChanges(pPortRequest);
+    MonRequestDestroy(&pPortRequest->request);
+    ReleaseMem(pPortRequest);
+
+    MemRemoveFromArray(reinterpret_cast<void *>(pContext->rgpRequests), dwRequestIndex, 1, pContext->cRequests, sizeof(MON_PORT_REQUEST *), TRUE);
+    --pContext->cRequests;
+}
+
+static void PortReleaseChanges(
+    __in MON_PORT_REQUEST *pPortRequest
+    )
+{
+    for (DWORD i = 0; i < pPortRequest->cChanges; ++i)
+    {
+        ReleaseStr(const_cast<LPWSTR>(pPortRequest->rgChanges[i].wzRelativePath));
+    }
+    ReleaseNullMem(pPortRequest->rgChanges);
+
+    pPortRequest->cChanges = 0;
+    pPortRequest->fOverflow = FALSE;
+}
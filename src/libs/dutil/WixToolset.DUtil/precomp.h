@@ -40,6 +40,11 @@
 #include <commctrl.h>
 #include <dbt.h>
 #include <ShellScalingApi.h>
+#include <locale.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 #include "dutilsources.h"
 #include "dutil.h"
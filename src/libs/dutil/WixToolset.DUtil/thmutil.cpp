@@ -44,6 +44,8 @@ const DWORD THEME_INVALID_ID = 0xFFFFFFFF;
 const COLORREF THEME_INVISIBLE_COLORREF = 0xFFFFFFFF;
 const DWORD GROW_FONT_INSTANCES = 3;
 const DWORD GROW_IMAGE_INSTANCES = 5;
+const DWORD GROW_SCALED_IMAGES = 5;
+const DWORD GROW_VARIABLE_BATCH_VALUES = 16;
 
 static Gdiplus::GdiplusStartupInput vgsi;
 static Gdiplus::GdiplusStartupOutput vgso = { };
@@ -103,7 +105,7 @@ static HRESULT ParseTheme(
     );
 static HRESULT AddStandaloneImage(
     __in THEME* pTheme,
-    __in Gdiplus::Bitmap** ppBitmap,
+    __in THEME_IMAGE_INSTANCE* pSource,
     __out DWORD* pdwIndex
     );
 static HRESULT GetAttributeImageFileOrResource(
@@ -112,6 +114,19 @@ static HRESULT GetAttributeImageFileOrResource(
     __in IXMLDOMNode* pElement,
     __out Gdiplus::Bitmap** ppBitmap
     );
+static HRESULT GetAttributeImageSource(
+    __in_opt HMODULE hModule,
+    __in_z_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pElement,
+    __in THEME_IMAGE_INSTANCE* pInstance
+    );
+static HRESULT LoadImageInstance(
+    __in THEME_IMAGE_INSTANCE* pInstance,
+    __in DWORD dwPageId
+    );
+static void UnloadImageInstance(
+    __in THEME_IMAGE_INSTANCE* pInstance
+    );
 static HRESULT ParseOwnerDrawImage(
     __in_opt HMODULE hModule,
     __in_z_opt LPCWSTR wzRelativePath,
@@ -318,6 +333,53 @@ static HRESULT ShowControls(
     __in THEME_SHOW_PAGE_REASON reason,
     __in DWORD dwPageId
     );
+static HRESULT ShowPageControls(
+    __in THEME* pTheme,
+    __in int nCmdShow,
+    __in BOOL fSaveEditboxes,
+    __in THEME_SHOW_PAGE_REASON reason,
+    __in DWORD dwPageId
+    );
+static HRESULT SaveEditboxes(
+    __in THEME* pTheme,
+    __in_opt const THEME_CONTROL* pParentControl,
+    __in BOOL fHide,
+    __in DWORD dwPageId
+    );
+static HRESULT GatherVariableBatch(
+    __in THEME* pTheme,
+    __in_opt const THEME_CONTROL* pParentControl,
+    __in BOOL fHide,
+    __in DWORD dwPageId,
+    __in THEME_VARIABLE_BATCH* pBatch
+    );
+static HRESULT AddVariableBatchValue(
+    __inout DWORD* pcValues,
+    __inout THEME_VARIABLE_BATCH_VALUE** prgValues,
+    __in_z_opt LPCWSTR wzKey
+    );
+static THEME_VARIABLE_BATCH_VALUE* FindVariableBatchValue(
+    __in DWORD cValues,
+    __in_ecount(cValues) THEME_VARIABLE_BATCH_VALUE* rgValues,
+    __in_z LPCWSTR wzKey
+    );
+static void EvaluateVariableBatch(
+    __in THEME* pTheme,
+    __in THEME_VARIABLE_BATCH* pBatch
+    );
+static void FreeVariableBatch(
+    __in THEME_VARIABLE_BATCH* pBatch
+    );
+static HRESULT EvaluateVariableCondition(
+    __in THEME* pTheme,
+    __in_z LPCWSTR wzCondition,
+    __out BOOL* pf
+    );
+static HRESULT FormatVariableString(
+    __in THEME* pTheme,
+    __in_z LPCWSTR wzFormat,
+    __inout LPWSTR* psczOut
+    );
 static HRESULT DrawButton(
     __in THEME* pTheme,
     __in DRAWITEMSTRUCT* pdis,
@@ -343,20 +405,39 @@ static HRESULT DrawImage(
 static void GetImageInstance(
     __in THEME* pTheme,
     __in const THEME_IMAGE_REFERENCE* pReference,
-    __out const THEME_IMAGE_INSTANCE** ppInstance
+    __out THEME_IMAGE_INSTANCE** ppInstance
     );
 static HRESULT DrawImageReference(
     __in THEME* pTheme,
     __in const THEME_IMAGE_REFERENCE* pReference,
+    __in DWORD dwPageId,
     __in HDC hdc,
     __in int destX,
     __in int destY,
     __in int destWidth,
     __in int destHeight
     );
-static HRESULT DrawGdipBitmap(
+static HRESULT GetScaledImage(
+    __in THEME* pTheme,
+    __in THEME_IMAGE_INSTANCE* pInstance,
+    __in DWORD dwPageId,
+    __in int srcX,
+    __in int srcY,
+    __in int srcWidth,
+    __in int srcHeight,
+    __in int destWidth,
+    __in int destHeight,
+    __out THEME_SCALED_IMAGE** ppScaledImage
+    );
+static HRESULT DrawScaledImage(
+    __in const THEME_SCALED_IMAGE* pScaledImage,
     __in HDC hdc,
     __in int destX,
+    __in int destY
+    );
+static HRESULT DrawGdipBitmap(
+    __in Gdiplus::Graphics* pGraphics,
+    __in int destX,
     __in int destY,
     __in int destWidth,
     __in int destHeight,
@@ -400,6 +481,22 @@ static void FreeImage(
 static void FreeImageInstance(
     __in THEME_IMAGE_INSTANCE* pImageInstance
     );
+static void FreeScaledImage(
+    __in THEME_SCALED_IMAGE* pScaledImage
+    );
+static void EvictPageImages(
+    __in THEME* pTheme,
+    __in DWORD dwPageId
+    );
+static void EvictStaleScaledImages(
+    __in THEME* pTheme
+    );
+static void EvictScaledImages(
+    __in THEME* pTheme,
+    __in THEME_IMAGE_INSTANCE* pImageInstance,
+    __in BOOL fEvictPage,
+    __in DWORD dwPageId
+    );
 static void FreePage(
     __in THEME_PAGE* pPage
     );
@@ -829,6 +926,20 @@ LExit:
     return hr;
 }
 
+DAPI_(HRESULT) ThemeRegisterVariableBatchCallback(
+    __in THEME* pTheme,
+    __in_opt PFNTHM_EVALUATE_VARIABLE_BATCH pfnEvaluateVariableBatch
+    )
+{
+    HRESULT hr = S_OK;
+    ThmExitOnNull(pTheme, hr, S_FALSE, "Theme must be loaded first.");
+
+    pTheme->pfnEvaluateVariableBatch = pfnEvaluateVariableBatch;
+
+LExit:
+    return hr;
+}
+
 
 DAPI_(void) ThemeInitializeWindowClass(
     __in THEME* pTheme,
@@ -1253,9 +1364,15 @@ DAPI_(HRESULT) ThemeShowPageEx(
         }
     }
 
-    hr = ShowControls(pTheme, NULL, nCmdShow, fSaveEditboxes, reason, dwPage);
+    hr = ShowPageControls(pTheme, nCmdShow, fSaveEditboxes, reason, dwPage);
     ThmExitOnFailure(hr, "Failed to show page controls.");
 
+    // Images drawn only by the hidden page are decoded again the next time it is shown.
+    if (fHide && dwPage)
+    {
+        EvictPageImages(pTheme, dwPage);
+    }
+
 LExit:
     return hr;
 }
@@ -1394,7 +1511,7 @@ DAPI_(HRESULT) ThemeDrawBackground(
 
     if (pps->fErase && THEME_IMAGE_REFERENCE_TYPE_NONE != pTheme->windowImageRef.type)
     {
-        hr = DrawImageReference(pTheme, &pTheme->windowImageRef, pps->hdc, 0, 0, pTheme->nWidth, pTheme->nHeight);
+        hr = DrawImageReference(pTheme, &pTheme->windowImageRef, 0, pps->hdc, 0, 0, pTheme->nWidth, pTheme->nHeight);
     }
 
     return hr;
@@ -1805,7 +1922,7 @@ static HRESULT ParseTheme(
     HRESULT hr = S_OK;
     THEME* pTheme = NULL;
     IXMLDOMElement *pThemeElement = NULL;
-    Gdiplus::Bitmap* pBitmap = NULL;
+    THEME_IMAGE_INSTANCE instance = { };
     BOOL fXmlFound = FALSE;
 
     hr = pixd->get_documentElement(&pThemeElement);
@@ -1818,12 +1935,12 @@ static HRESULT ParseTheme(
     pTheme->wNextControlId = THEME_FIRST_AUTO_ASSIGN_CONTROL_ID;
 
     // Parse the optional background resource image.
-    hr = GetAttributeImageFileOrResource(hModule, wzRelativePath, pThemeElement, &pBitmap);
+    hr = GetAttributeImageSource(hModule, wzRelativePath, pThemeElement, &instance);
     ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed while parsing theme image.");
 
     if (fXmlFound)
     {
-        hr = AddStandaloneImage(pTheme, &pBitmap, &pTheme->dwSourceImageInstanceIndex);
+        hr = AddStandaloneImage(pTheme, &instance, &pTheme->dwSourceImageInstanceIndex);
         ThmExitOnFailure(hr, "Failed to store theme image.");
     }
     else
@@ -1852,11 +1969,7 @@ static HRESULT ParseTheme(
 
 LExit:
     ReleaseObject(pThemeElement);
-
-    if (pBitmap)
-    {
-        delete pBitmap;
-    }
+    FreeImageInstance(&instance);
 
     if (pTheme)
     {
@@ -1868,7 +1981,7 @@ LExit:
 
 static HRESULT AddStandaloneImage(
     __in THEME* pTheme,
-    __in Gdiplus::Bitmap** ppBitmap,
+    __in THEME_IMAGE_INSTANCE* pSource,
     __out DWORD* pdwIndex
     )
 {
@@ -1883,8 +1996,11 @@ static HRESULT AddStandaloneImage(
 
     pInstance = pTheme->rgStandaloneImages + *pdwIndex;
 
-    pInstance->pBitmap = *ppBitmap;
-    *ppBitmap = NULL;
+    // Take ownership of the source, the bitmap is decoded again on first draw.
+    *pInstance = *pSource;
+    memset(pSource, 0, sizeof(THEME_IMAGE_INSTANCE));
+
+    UnloadImageInstance(pInstance);
 
 LExit:
     return hr;
@@ -1896,22 +2012,42 @@ static HRESULT GetAttributeImageFileOrResource(
     __in IXMLDOMNode* pElement,
     __out Gdiplus::Bitmap** ppBitmap
     )
+{
+    HRESULT hr = S_OK;
+    THEME_IMAGE_INSTANCE instance = { };
+    *ppBitmap = NULL;
+
+    hr = GetAttributeImageSource(hModule, wzRelativePath, pElement, &instance);
+    if (SUCCEEDED(hr))
+    {
+        *ppBitmap = instance.pBitmap;
+        instance.pBitmap = NULL;
+    }
+
+    FreeImageInstance(&instance);
+
+    return hr;
+}
+
+static HRESULT GetAttributeImageSource(
+    __in_opt HMODULE hModule,
+    __in_z_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pElement,
+    __in THEME_IMAGE_INSTANCE* pInstance
+    )
 {
     HRESULT hr = S_OK;
     BSTR bstr = NULL;
-    LPWSTR sczImageFile = NULL;
     WORD wResourceId = 0;
     BOOL fFound = FALSE;
-    Gdiplus::Bitmap* pBitmap = NULL;
-    *ppBitmap = NULL;
 
     hr = XmlGetAttributeUInt16(pElement, L"ImageResource", &wResourceId);
     ThmExitOnOptionalXmlQueryFailure(hr, fFound, "Failed to get image resource attribute.");
 
     if (fFound)
     {
-        hr = GdipBitmapFromResource(hModule, MAKEINTRESOURCE(wResourceId), &pBitmap);
-        ThmExitOnFailure(hr, "Failed to load image from resource: %hu", wResourceId);
+        pInstance->hModule = hModule;
+        pInstance->wResourceId = wResourceId;
     }
 
     hr = XmlGetAttribute(pElement, L"ImageFile", &bstr);
@@ -1919,7 +2055,7 @@ static HRESULT GetAttributeImageFileOrResource(
 
     if (fFound)
     {
-        if (pBitmap)
+        if (pInstance->wResourceId)
         {
             ThmExitWithRootFailure(hr, E_INVALIDDATA, "ImageFile attribute can't be specified with ImageResource attribute.");
         }
@@ -1927,41 +2063,81 @@ static HRESULT GetAttributeImageFileOrResource(
         // Parse the optional background image from a given file.
         if (wzRelativePath)
         {
-            hr = PathConcat(wzRelativePath, bstr, &sczImageFile);
+            hr = PathConcat(wzRelativePath, bstr, &pInstance->sczFile);
             ThmExitOnFailure(hr, "Failed to combine image file path.");
         }
         else
         {
-            hr = PathRelativeToModule(&sczImageFile, bstr, hModule);
+            hr = PathRelativeToModule(&pInstance->sczFile, bstr, hModule);
             ThmExitOnFailure(hr, "Failed to get image filename.");
         }
-
-        hr = GdipBitmapFromFile(sczImageFile, &pBitmap);
-        ThmExitOnFailure(hr, "Failed to load image from file: %ls", sczImageFile);
     }
 
-    if (pBitmap)
+    if (!pInstance->wResourceId && !pInstance->sczFile)
     {
-        *ppBitmap = pBitmap;
-        pBitmap = NULL;
+        ExitFunction1(hr = E_NOTFOUND);
     }
-    else
+
+    // Opening the image validates it and provides its dimensions for layout and scaling.
+    // GDI+ defers decoding the pixels until the bitmap is first drawn.
+    hr = LoadImageInstance(pInstance, 0);
+    ThmExitOnFailure(hr, "Failed to load image.");
+
+    pInstance->nWidth = pInstance->pBitmap->GetWidth();
+    pInstance->nHeight = pInstance->pBitmap->GetHeight();
+
+LExit:
+    ReleaseBSTR(bstr);
+
+    return hr;
+}
+
+static HRESULT LoadImageInstance(
+    __in THEME_IMAGE_INSTANCE* pInstance,
+    __in DWORD dwPageId
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (pInstance->pBitmap)
     {
-        hr = E_NOTFOUND;
+        // Images shared with the always visible page 0 are never evicted.
+        if (pInstance->dwPageId)
+        {
+            pInstance->dwPageId = dwPageId;
+        }
+
+        ExitFunction();
     }
 
-LExit:
-    if (pBitmap)
+    if (pInstance->sczFile)
     {
-        delete pBitmap;
+        hr = GdipBitmapFromFile(pInstance->sczFile, &pInstance->pBitmap);
+        ThmExitOnFailure(hr, "Failed to load image from file: %ls", pInstance->sczFile);
+    }
+    else
+    {
+        hr = GdipBitmapFromResource(pInstance->hModule, MAKEINTRESOURCE(pInstance->wResourceId), &pInstance->pBitmap);
+        ThmExitOnFailure(hr, "Failed to load image from resource: %hu", pInstance->wResourceId);
     }
 
-    ReleaseStr(sczImageFile);
-    ReleaseBSTR(bstr);
+    pInstance->dwPageId = dwPageId;
 
+LExit:
     return hr;
 }
 
+static void UnloadImageInstance(
+    __in THEME_IMAGE_INSTANCE* pInstance
+    )
+{
+    if (pInstance->pBitmap)
+    {
+        delete pInstance->pBitmap;
+        pInstance->pBitmap = NULL;
+    }
+}
+
 
 static HRESULT ParseOwnerDrawImage(
     __in_opt HMODULE hModule,
@@ -1977,7 +2153,7 @@ static HRESULT ParseOwnerDrawImage(
     DWORD dwValue = 0;
     BOOL fXmlFound = FALSE;
     BOOL fFoundImage = FALSE;
-    Gdiplus::Bitmap* pBitmap = NULL;
+    THEME_IMAGE_INSTANCE instance = { };
 
     hr = GetAttributeImageId(pTheme, pElement, L"ImageId", &dwValue);
     ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to parse ImageId attribute.");
@@ -1995,7 +2171,7 @@ static HRESULT ParseOwnerDrawImage(
     }
 
     // Parse the optional background resource image.
-    hr = GetAttributeImageFileOrResource(hModule, wzRelativePath, pElement, &pBitmap);
+    hr = GetAttributeImageSource(hModule, wzRelativePath, pElement, &instance);
     ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed while parsing control image.");
 
     if (fXmlFound)
@@ -2005,7 +2181,7 @@ static HRESULT ParseOwnerDrawImage(
             ThmExitWithRootFailure(hr, E_INVALIDDATA, "Unexpected image attribute with ImageId attribute.");
         }
 
-        hr = AddStandaloneImage(pTheme, &pBitmap, &pImageRef->dwImageInstanceIndex);
+        hr = AddStandaloneImage(pTheme, &instance, &pImageRef->dwImageInstanceIndex);
         ThmExitOnFailure(hr, "Failed to store owner draw image.");
 
         pImageRef->type = THEME_IMAGE_REFERENCE_TYPE_COMPLETE;
@@ -2036,10 +2212,7 @@ static HRESULT ParseOwnerDrawImage(
     }
 
 LExit:
-    if (pBitmap)
-    {
-        delete pBitmap;
-    }
+    FreeImageInstance(&instance);
 
     return hr;
 }
@@ -2379,8 +2552,8 @@ static HRESULT ParseSourceXY(
     int nY = 0;
     DWORD dwImageInstanceIndex = pTheme->dwSourceImageInstanceIndex;
     THEME_IMAGE_INSTANCE* pInstance = THEME_INVALID_ID != dwImageInstanceIndex ? pTheme->rgStandaloneImages + dwImageInstanceIndex : NULL;
-    int nSourceWidth = pInstance ? pInstance->pBitmap->GetWidth() : 0;
-    int nSourceHeight = pInstance ? pInstance->pBitmap->GetHeight() : 0;
+    int nSourceWidth = pInstance ? pInstance->nWidth : 0;
+    int nSourceHeight = pInstance ? pInstance->nHeight : 0;
 
     hr = GetAttributeCoordinateOrDimension(pixn, L"SourceX", &nX);
     ThmExitOnOptionalXmlQueryFailure(hr, fXFound, "Failed to get SourceX attribute.");
@@ -2837,7 +3010,7 @@ static HRESULT ParseImages(
     IXMLDOMNode* pixn = NULL;
     LPWSTR sczImageId = NULL;
     DWORD dwImageIndex = 0;
-    Gdiplus::Bitmap* pDefaultBitmap = NULL;
+    THEME_IMAGE_INSTANCE defaultInstance = { };
     IXMLDOMNodeList* pixnlAlternates = NULL;
     IXMLDOMNode* pixnAlternate = NULL;
     DWORD dwInstances = 0;
@@ -2879,7 +3052,7 @@ static HRESULT ParseImages(
         pImage->dwIndex = dwImageIndex;
         ++dwImageIndex;
 
-        hr = GetAttributeImageFileOrResource(hModule, wzRelativePath, pixn, &pDefaultBitmap);
+        hr = GetAttributeImageSource(hModule, wzRelativePath, pixn, &defaultInstance);
         ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to parse Image: %ls", pImage->sczId);
 
         if (!fXmlFound)
@@ -2902,26 +3075,31 @@ static HRESULT ParseImages(
         pImage->rgImageInstances = static_cast<THEME_IMAGE_INSTANCE*>(MemAlloc(sizeof(THEME_IMAGE_INSTANCE) * dwInstances, TRUE));
         ThmExitOnNull(pImage->rgImageInstances, hr, E_OUTOFMEMORY, "Failed to allocate image instances.");
 
+        // Only the source and dimensions are kept, the bitmaps are decoded on first draw.
         pInstance = pImage->rgImageInstances;
-        pInstance->pBitmap = pDefaultBitmap;
-        pDefaultBitmap = NULL;
+        *pInstance = defaultInstance;
+        memset(&defaultInstance, 0, sizeof(defaultInstance));
+        UnloadImageInstance(pInstance);
         pImage->cImageInstances += 1;
 
         while (S_OK == (hr = XmlNextElement(pixnlAlternates, &pixnAlternate, NULL)))
         {
             pInstance = pImage->rgImageInstances + pImage->cImageInstances;
 
-            hr = GetAttributeImageFileOrResource(hModule, wzRelativePath, pixnAlternate, &pInstance->pBitmap);
-            ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to parse Image: '%ls', alternate resolution: %u", pImage->sczId, pImage->cImageInstances);
+            // Count the instance before parsing it so a partially parsed source is freed with the image.
+            pImage->cImageInstances += 1;
+
+            hr = GetAttributeImageSource(hModule, wzRelativePath, pixnAlternate, pInstance);
+            ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to parse Image: '%ls', alternate resolution: %u", pImage->sczId, pImage->cImageInstances - 1);
 
             if (!fXmlFound)
             {
-                ThmExitWithRootFailure(hr, E_INVALIDDATA, "Image: '%ls', alternate resolution: %u, didn't specify an image.", pImage->sczId, pImage->cImageInstances);
+                ThmExitWithRootFailure(hr, E_INVALIDDATA, "Image: '%ls', alternate resolution: %u, didn't specify an image.", pImage->sczId, pImage->cImageInstances - 1);
             }
 
-            ReleaseNullObject(pixnAlternate);
+            UnloadImageInstance(pInstance);
 
-            pImage->cImageInstances += 1;
+            ReleaseNullObject(pixnAlternate);
         }
 
         ReleaseNullObject(pixnlAlternates);
@@ -2935,10 +3113,7 @@ static HRESULT ParseImages(
     }
 
 LExit:
-    if (pDefaultBitmap)
-    {
-        delete pDefaultBitmap;
-    }
+    FreeImageInstance(&defaultInstance);
 
     ReleaseObject(pixnAlternate);
     ReleaseObject(pixnlAlternates);
@@ -4402,7 +4577,7 @@ static HRESULT DrawButton(
         pImageRef = pControl->Button.rgImageRef;
     }
 
-    hr = DrawImageReference(pTheme, pImageRef, pdis->hDC, 0, 0, nWidth, nHeight);
+    hr = DrawImageReference(pTheme, pImageRef, pControl->wPageId, pdis->hDC, 0, 0, nWidth, nHeight);
 
     DrawControlText(pTheme, pdis, pControl, TRUE, fDrawFocusRect);
 
@@ -4482,7 +4657,7 @@ static HRESULT DrawImage(
     int nHeight = pdis->rcItem.bottom - pdis->rcItem.top;
     int nWidth = pdis->rcItem.right - pdis->rcItem.left;
 
-    hr = DrawImageReference(pTheme, &pControl->Image.imageRef, pdis->hDC, 0, 0, nWidth, nHeight);
+    hr = DrawImageReference(pTheme, &pControl->Image.imageRef, pControl->wPageId, pdis->hDC, 0, 0, nWidth, nHeight);
 
     return hr;
 }
@@ -4490,7 +4665,7 @@ static HRESULT DrawImage(
 static void GetImageInstance(
     __in THEME* pTheme,
     __in const THEME_IMAGE_REFERENCE* pReference,
-    __out const THEME_IMAGE_INSTANCE** ppInstance
+    __out THEME_IMAGE_INSTANCE** ppInstance
     )
 {
     switch (pReference->type)
@@ -4516,6 +4691,7 @@ static void GetImageInstance(
 static HRESULT DrawImageReference(
     __in THEME* pTheme,
     __in const THEME_IMAGE_REFERENCE* pReference,
+    __in DWORD dwPageId,
     __in HDC hdc,
     __in int destX,
     __in int destY,
@@ -4524,7 +4700,8 @@ static HRESULT DrawImageReference(
     )
 {
     HRESULT hr = S_OK;
-    const THEME_IMAGE_INSTANCE* pImageInstance = NULL;
+    THEME_IMAGE_INSTANCE* pImageInstance = NULL;
+    THEME_SCALED_IMAGE* pScaledImage = NULL;
     int nX = 0;
     int nY = 0;
     int nWidth = 0;
@@ -4544,22 +4721,148 @@ static HRESULT DrawImageReference(
     case THEME_IMAGE_REFERENCE_TYPE_COMPLETE:
         nX = 0;
         nY = 0;
-        nWidth = pImageInstance->pBitmap->GetWidth();
-        nHeight = pImageInstance->pBitmap->GetHeight();
+        nWidth = pImageInstance->nWidth;
+        nHeight = pImageInstance->nHeight;
         break;
     default:
         ExitFunction1(hr = E_INVALIDARG); // This should be unreachable because GetImageInstance should have returned null.
     }
 
-    hr = DrawGdipBitmap(hdc, destX, destY, destWidth, destHeight, pImageInstance->pBitmap, nX, nY, nWidth, nHeight);
+    if (0 >= destWidth || 0 >= destHeight)
+    {
+        ExitFunction1(hr = S_FALSE);
+    }
+
+    hr = GetScaledImage(pTheme, pImageInstance, dwPageId, nX, nY, nWidth, nHeight, destWidth, destHeight, &pScaledImage);
+    ThmExitOnFailure(hr, "Failed to get scaled image.");
+
+    hr = DrawScaledImage(pScaledImage, hdc, destX, destY);
 
 LExit:
     return hr;
 }
 
-static HRESULT DrawGdipBitmap(
+static HRESULT GetScaledImage(
+    __in THEME* pTheme,
+    __in THEME_IMAGE_INSTANCE* pInstance,
+    __in DWORD dwPageId,
+    __in int srcX,
+    __in int srcY,
+    __in int srcWidth,
+    __in int srcHeight,
+    __in int destWidth,
+    __in int destHeight,
+    __out THEME_SCALED_IMAGE** ppScaledImage
+    )
+{
+    HRESULT hr = S_OK;
+    THEME_SCALED_IMAGE* pScaledImage = NULL;
+    Gdiplus::Bitmap* pBitmap = NULL;
+    Gdiplus::Status gs = Gdiplus::Status::Ok;
+
+    for (DWORD i = 0; i < pInstance->cScaledImages; ++i)
+    {
+        THEME_SCALED_IMAGE* pCandidate = pInstance->rgScaledImages + i;
+
+        if (pCandidate->nSourceX == srcX && pCandidate->nSourceY == srcY && pCandidate->nSourceWidth == srcWidth && pCandidate->nSourceHeight == srcHeight &&
+            pCandidate->nDpi == pTheme->nDpi && pCandidate->nWidth == destWidth && pCandidate->nHeight == destHeight)
+        {
+            // Scaled images shared with the always visible page 0 are never evicted with a page.
+            if (pCandidate->dwPageId)
+            {
+                pCandidate->dwPageId = dwPageId;
+            }
+
+            pCandidate->dwLastUsed = ++pTheme->dwScaledImageUse;
+
+            *ppScaledImage = pCandidate;
+            ExitFunction();
+        }
+    }
+
+    hr = LoadImageInstance(pInstance, dwPageId);
+    ThmExitOnFailure(hr, "Failed to load image for scaling.");
+
+    pBitmap = new Gdiplus::Bitmap(destWidth, destHeight, PixelFormat32bppPARGB);
+    ThmExitOnNull(pBitmap, hr, E_OUTOFMEMORY, "Failed to allocate scaled bitmap.");
+
+    gs = pBitmap->GetLastStatus();
+    ThmExitOnGdipFailure(gs, hr, "Failed to create scaled bitmap.");
+
+    {
+        Gdiplus::Graphics graphics(pBitmap);
+
+        hr = DrawGdipBitmap(&graphics, 0, 0, destWidth, destHeight, pInstance->pBitmap, srcX, srcY, srcWidth, srcHeight);
+        ThmExitOnFailure(hr, "Failed to scale image.");
+    }
+
+    // Other sizes stay cached until an eviction finds they are stale, so controls drawing the
+    // same image at different sizes do not keep rescaling it.
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pInstance->rgScaledImages), pInstance->cScaledImages, 1, sizeof(THEME_SCALED_IMAGE), GROW_SCALED_IMAGES);
+    ThmExitOnFailure(hr, "Failed to allocate memory for scaled images.");
+
+    pScaledImage = pInstance->rgScaledImages + pInstance->cScaledImages;
+    ++pInstance->cScaledImages;
+
+    pScaledImage->nDpi = pTheme->nDpi;
+    pScaledImage->nSourceX = srcX;
+    pScaledImage->nSourceY = srcY;
+    pScaledImage->nSourceWidth = srcWidth;
+    pScaledImage->nSourceHeight = srcHeight;
+    pScaledImage->nWidth = destWidth;
+    pScaledImage->nHeight = destHeight;
+    pScaledImage->dwPageId = dwPageId;
+    pScaledImage->fTransparency = (pInstance->pBitmap->GetFlags() & Gdiplus::ImageFlagsHasAlpha) == Gdiplus::ImageFlagsHasAlpha;
+    pScaledImage->dwCreated = ++pTheme->dwScaledImageUse;
+    pScaledImage->dwLastUsed = pScaledImage->dwCreated;
+    pScaledImage->pBitmap = pBitmap;
+    pBitmap = NULL;
+
+    *ppScaledImage = pScaledImage;
+
+LExit:
+    if (pBitmap)
+    {
+        delete pBitmap;
+    }
+
+    return hr;
+}
+
+static HRESULT DrawScaledImage(
+    __in const THEME_SCALED_IMAGE* pScaledImage,
     __in HDC hdc,
     __in int destX,
+    __in int destY
+    )
+{
+    Gdiplus::Rect destRect(destX, destY, pScaledImage->nWidth, pScaledImage->nHeight);
+    Gdiplus::Graphics graphics(hdc);
+    Gdiplus::Status gs = Gdiplus::Status::Ok;
+
+    // The bitmap was already scaled to the destination size so this is a straight copy.
+    graphics.SetInterpolationMode(Gdiplus::InterpolationMode::InterpolationModeNearestNeighbor);
+    graphics.SetPixelOffsetMode(Gdiplus::PixelOffsetMode::PixelOffsetModeHalf);
+
+    if (pScaledImage->fTransparency)
+    {
+        graphics.SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceOver);
+        graphics.SetCompositingQuality(Gdiplus::CompositingQuality::CompositingQualityHighQuality);
+    }
+    else
+    {
+        graphics.SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceCopy);
+        graphics.SetCompositingQuality(Gdiplus::CompositingQuality::CompositingQualityHighSpeed);
+    }
+
+    gs = graphics.DrawImage(pScaledImage->pBitmap, destRect, 0, 0, pScaledImage->nWidth, pScaledImage->nHeight, Gdiplus::Unit::UnitPixel);
+
+    return GdipHresultFromStatus(gs);
+}
+
+static HRESULT DrawGdipBitmap(
+    __in Gdiplus::Graphics* pGraphics,
+    __in int destX,
     __in int destY,
     __in int destWidth,
     __in int destHeight,
@@ -4575,7 +4878,6 @@ static HRESULT DrawGdipBitmap(
     BOOL fTransparency = (pBitmap->GetFlags() & Gdiplus::ImageFlagsHasAlpha) == Gdiplus::ImageFlagsHasAlpha;
     Gdiplus::ImageAttributes attrs;
     Gdiplus::Rect destRect(destX, destY, destWidth, destHeight);
-    Gdiplus::Graphics graphics(hdc);
     Gdiplus::Status gs = Gdiplus::Status::Ok;
 
     // This fixes GDI+ behavior where it badly handles the edges of an image when scaling.
@@ -4585,25 +4887,25 @@ static HRESULT DrawGdipBitmap(
     // graphics.SmoothingMode is not set because it has no impact on DrawImage.
 
     // This is the best interpolation mode, and the only one that is decent at downscaling.
-    graphics.SetInterpolationMode(Gdiplus::InterpolationMode::InterpolationModeHighQualityBicubic);
+    pGraphics->SetInterpolationMode(Gdiplus::InterpolationMode::InterpolationModeHighQualityBicubic);
 
     // There's a significant quality improvement when scaling to use the HighQuality pixel offset mode with no measurable difference in performance.
-    graphics.SetPixelOffsetMode(Gdiplus::PixelOffsetMode::PixelOffsetModeHighQuality);
+    pGraphics->SetPixelOffsetMode(Gdiplus::PixelOffsetMode::PixelOffsetModeHighQuality);
 
     // If there's transparency, make sure that the blending is done with high quality.
     // If not, try to skip blending.
     if (fTransparency)
     {
-        graphics.SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceOver);
-        graphics.SetCompositingQuality(Gdiplus::CompositingQuality::CompositingQualityHighQuality);
+        pGraphics->SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceOver);
+        pGraphics->SetCompositingQuality(Gdiplus::CompositingQuality::CompositingQualityHighQuality);
     }
     else
     {
-        graphics.SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceCopy);
-        graphics.SetCompositingQuality(Gdiplus::CompositingQuality::CompositingQualityHighSpeed);
+        pGraphics->SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceCopy);
+        pGraphics->SetCompositingQuality(Gdiplus::CompositingQuality::CompositingQualityHighSpeed);
     }
 
-    gs = graphics.DrawImage(pBitmap, destRect, srcX, srcY, srcWidth, srcHeight, Gdiplus::Unit::UnitPixel, &attrs);
+    gs = pGraphics->DrawImage(pBitmap, destRect, srcX, srcY, srcWidth, srcHeight, Gdiplus::Unit::UnitPixel, &attrs);
 
     return GdipHresultFromStatus(gs);
 }
@@ -4620,7 +4922,7 @@ static HRESULT DrawProgressBar(
     WORD wProgressColorIndex = HIWORD(pControl->dwData);
     WORD wProgressPercentage = LOWORD(pControl->dwData);
     const THEME_IMAGE_REFERENCE* pImageRef = pControl->ProgressBar.rgImageRef + wProgressColorIndex;
-    const THEME_IMAGE_INSTANCE* pInstance = NULL;
+    THEME_IMAGE_INSTANCE* pInstance = NULL;
     int nHeight = pdis->rcItem.bottom - pdis->rcItem.top;
     int nSourceHeight = 0;
     int nSourceX = 0;
@@ -4644,7 +4946,7 @@ static HRESULT DrawProgressBar(
         nSourceY = pImageRef->nY;
         break;
     case THEME_IMAGE_REFERENCE_TYPE_COMPLETE:
-        nSourceHeight = pInstance->pBitmap->GetHeight();
+        nSourceHeight = pInstance->nHeight;
         nSourceX = 0;
         nSourceY = 0;
         break;
@@ -4652,6 +4954,10 @@ static HRESULT DrawProgressBar(
         ExitFunction1(hr = E_INVALIDARG); // This should be unreachable because GetImageInstance should have returned null.
     }
 
+    // The progress bar stretches single pixel columns to a width that changes constantly, so it draws from the decoded image rather than the scaled image cache.
+    hr = LoadImageInstance(pInstance, pControl->wPageId);
+    ThmExitOnFailure(hr, "Failed to load progress bar image.");
+
     // Draw the left side of the progress bar.
     hr = DrawProgressBarImage(pTheme, pInstance, nSourceX, nSourceY, 1, nSourceHeight, pdis->hDC, 0, 0, nSideWidth, nHeight);
 
@@ -4699,7 +5005,9 @@ static HRESULT DrawProgressBarImage(
     hr = GdipHresultFromStatus(gs);
     if (SUCCEEDED(hr))
     {
-        hr = DrawGdipBitmap(hdc, destX, destY, destWidth, destHeight, &isolated, 0, 0, isolated.GetWidth(), isolated.GetHeight());
+        Gdiplus::Graphics graphicsDest(hdc);
+
+        hr = DrawGdipBitmap(&graphicsDest, destX, destY, destWidth, destHeight, &isolated, 0, 0, isolated.GetWidth(), isolated.GetHeight());
     }
 
     return hr;
@@ -4953,29 +5261,4957 @@ static void FreeImageInstance(
     {
         delete pImageInstance->pBitmap;
     }
-}
 
+    for (DWORD i = 0; i < pImageInstance->cScaledImages; ++i)
+    {
+        FreeScaledImage(pImageInstance->rgScaledImages + i);
+    }
 
-static void CALLBACK OnBillboardTimer(
-    __in THEME* /*pTheme*/,
-    __in HWND hwnd,
-    __in UINT_PTR idEvent
+    ReleaseMem(pImageInstance->rgScaledImages);
+    ReleaseStr(pImageInstance->sczFile);
+}
+
+static void FreeScaledImage(
+    __in THEME_SCALED_IMAGE* pScaledImage
     )
 {
-    THEME_CONTROL* pControl = reinterpret_cast<THEME_CONTROL*>(idEvent);
+    if (pScaledImage->pBitmap)
+    {
+        delete pScaledImage->pBitmap;
+    }
 
-    if (pControl)
+    memset(pScaledImage, 0, sizeof(THEME_SCALED_IMAGE));
+}
+
+static void EvictPageImages(
+    __in THEME* pTheme,
+    __in DWORD dwPageId
+    )
+{
+    for (DWORD i = 0; i < pTheme->cImages; ++i)
     {
-        AssertSz(THEME_CONTROL_TYPE_BILLBOARD == pControl->type, "Only billboard controls should get billboard timer messages.");
+        THEME_IMAGE* pImage = pTheme->rgImages + i;
 
-        if (pControl->dwData < pControl->cControls)
+        for (DWORD j = 0; j < pImage->cImageInstances; ++j)
         {
-            ThemeShowChild(pControl, pControl->dwData);
+            EvictScaledImages(pTheme, pImage->rgImageInstances + j, TRUE, dwPageId);
+
+            if (pImage->rgImageInstances[j].dwPageId == dwPageId)
+            {
+                UnloadImageInstance(pImage->rgImageInstances + j);
+            }
         }
-        else if (pControl->fBillboardLoops)
+    }
+
+    for (DWORD i = 0; i < pTheme->cStandaloneImages; ++i)
+    {
+        EvictScaledImages(pTheme, pTheme->rgStandaloneImages + i, TRUE, dwPageId);
+
+        if (pTheme->rgStandaloneImages[i].dwPageId == dwPageId)
         {
-            pControl->dwData = 0;
-            ThemeShowChild(pControl, pControl->dwData);
+            UnloadImageInstance(pTheme->rgStandaloneImages + i);
+        }
+    }
+}
+
+static void EvictStaleScaledImages(
+    __in THEME* pTheme
+    )
+{
+    for (DWORD i = 0; i < pTheme->cImages; ++i)
+    {
+        THEME_IMAGE* pImage = pTheme->rgImages + i;
+
+        for (DWORD j = 0; j < pImage->cImageInstances; ++j)
+        {
+            EvictScaledImages(pTheme, pImage->rgImageInstances + j, FALSE, 0);
+        }
+    }
+
+    for (DWORD i = 0; i < pTheme->cStandaloneImages; ++i)
+    {
+        EvictScaledImages(pTheme, pTheme->rgStandaloneImages + i, FALSE, 0);
+    }
+}
+
+static void EvictScaledImages(
+    __in THEME* pTheme,
+    __in THEME_IMAGE_INSTANCE* pImageInstance,
+    __in BOOL fEvictPage,
+    __in DWORD dwPageId
+    )
+{
+    DWORD cKept = 0;
+
+    for (DWORD i = 0; i < pImageInstance->cScaledImages; ++i)
+    {
+        THEME_SCALED_IMAGE* pScaledImage = pImageInstance->rgScaledImages + i;
+
+        pScaledImage->fStale = (fEvictPage && pScaledImage->dwPageId == dwPageId) || pScaledImage->nDpi != pTheme->nDpi;
+
+        // A size that was not drawn again after the same part of the image was scaled to another
+        // size belongs to a control that has since been resized.
+        for (DWORD j = 0; !pScaledImage->fStale && j < pImageInstance->cScaledImages; ++j)
+        {
+            const THEME_SCALED_IMAGE* pOther = pImageInstance->rgScaledImages + j;
+
+            pScaledImage->fStale = pOther->nSourceX == pScaledImage->nSourceX && pOther->nSourceY == pScaledImage->nSourceY &&
+                                   pOther->nSourceWidth == pScaledImage->nSourceWidth && pOther->nSourceHeight == pScaledImage->nSourceHeight &&
+                                   pOther->dwCreated > pScaledImage->dwLastUsed;
+        }
+    }
+
+    for (DWORD i = 0; i < pImageInstance->cScaledImages; ++i)
+    {
+        THEME_SCALED_IMAGE* pScaledImage = pImageInstance->rgScaledImages + i;
+
+        if (pScaledImage->fStale)
+        {
+            FreeScaledImage(pScaledImage);
+        }
+        else
+        {
+            pImageInstance->rgScaledImages[cKept] = *pScaledImage;
+            ++cKept;
+        }
+    }
+
+    pImageInstance->cScaledImages = cKept;
+}
+
+
+static void CALLBACK OnBillboardTimer(
+    __in THEME* pTheme,
+    __in HWND hwnd,
+    __in UINT_PTR idEvent
+    );
+static void OnBrowseDirectory(
+    __in THEME* pTheme,
+    __in const THEME_ACTION* pAction
+    );
+static BOOL OnButtonClicked(
+    __in THEME* pTheme,
+    __in const THEME_CONTROL* pControl
+    );
+static BOOL OnDpiChanged(
+    __in THEME* pTheme,
+    __in WPARAM wParam,
+    __in LPARAM lParam
+    );
+static BOOL OnHypertextClicked(
+    __in THEME* pTheme,
+    __in const THEME_CONTROL* pThemeControl,
+    __in PNMLINK pnmlink
+    );
+static void OnNcCreate(
+    __in THEME* pTheme,
+    __in HWND hWnd,
+    __in LPARAM lParam
+    );
+static BOOL OnNotifyEnLink(
+    __in THEME* pTheme,
+    __in const THEME_CONTROL* pThemeControl,
+    __in ENLINK* link
+    );
+static BOOL OnNotifyEnMsgFilter(
+    __in THEME* pTheme,
+    __in const THEME_CONTROL* pThemeControl,
+    __in MSGFILTER* msgFilter
+    );
+static BOOL OnPanelCreate(
+    __in THEME_CONTROL* pControl,
+    __in HWND hWnd
+    );
+static BOOL OnWmCommand(
+    __in THEME* pTheme,
+    __in WPARAM wParam,
+    __in const THEME_CONTROL* pThemeControl,
+    __inout LRESULT* plResult
+    );
+static BOOL OnWmNotify(
+    __in THEME* pTheme,
+    __in LPNMHDR lParam,
+    __in const THEME_CONTROL* pThemeControl,
+    __inout LRESULT* plResult
+    );
+static const THEME_CONTROL* FindControlFromId(
+    __in const THEME* pTheme,
+    __in WORD wId,
+    __in_opt const THEME_CONTROL* pParentControl = NULL
+    );
+static const THEME_CONTROL* FindControlFromHWnd(
+    __in const THEME* pTheme,
+    __in HWND hWnd,
+    __in_opt const THEME_CONTROL* pParentControl = NULL
+    );
+static void GetControlDimensions(
+    __in const THEME_CONTROL* pControl,
+    __in const RECT* prcParent,
+    __out int* piWidth,
+    __out int* piHeight,
+    __out int* piX,
+    __out int* piY
+    );
+// Using iWidth as total width of listview, base width of columns, and "Expands" flag on columns
+// calculates final width of each column (storing result in each column's nWidth value)
+static HRESULT SizeListViewColumns(
+    __inout THEME_CONTROL* pControl
+    );
+static LRESULT CALLBACK ControlGroupDefWindowProc(
+    __in_opt THEME* pTheme,
+    __in HWND hWnd,
+    __in UINT uMsg,
+    __in WPARAM wParam,
+    __in LPARAM lParam,
+    __in BOOL fDialog
+    );
+static LRESULT CALLBACK PanelWndProc(
+    __in HWND hWnd,
+    __in UINT uMsg,
+    __in WPARAM wParam,
+    __in LPARAM lParam
+    );
+static LRESULT CALLBACK StaticOwnerDrawWndProc(
+    __in HWND hWnd,
+    __in UINT uMsg,
+    __in WPARAM wParam,
+    __in LPARAM lParam
+    );
+static HRESULT LocalizeControls(
+    __in DWORD cControls,
+    __in THEME_CONTROL* rgControls,
+    __in const WIX_LOCALIZATION *pWixLoc
+    );
+static HRESULT LocalizeControl(
+    __in THEME_CONTROL* pControl,
+    __in const WIX_LOCALIZATION *pWixLoc
+    );
+static HRESULT LoadControlsString(
+    __in DWORD cControls,
+    __in THEME_CONTROL* rgControls,
+    __in HMODULE hResModule
+    );
+static HRESULT LoadControlString(
+    __in THEME_CONTROL* pControl,
+    __in HMODULE hResModule
+    );
+static void ResizeControls(
+    __in THEME* pTheme,
+    __in DWORD cControls,
+    __in THEME_CONTROL* rgControls,
+    __in const RECT* prcParent
+    );
+static void ResizeControl(
+    __in THEME* pTheme,
+    __in THEME_CONTROL* pControl,
+    __in const RECT* prcParent
+    );
+static void ScaleThemeFromWindow(
+    __in THEME* pTheme,
+    __in UINT nDpi,
+    __in int x,
+    __in int y
+    );
+static void ScaleTheme(
+    __in THEME* pTheme,
+    __in UINT nDpi,
+    __in int x,
+    __in int y,
+    __in DWORD dwStyle,
+    __in BOOL fMenu,
+    __in DWORD dwExStyle
+    );
+static void AdjustThemeWindowRect(
+    __in THEME* pTheme,
+    __in DWORD dwStyle,
+    __in BOOL fMenu,
+    __in DWORD dwExStyle
+    );
+static void ScaleControls(
+    __in THEME* pTheme,
+    __in DWORD cControls,
+    __in THEME_CONTROL* rgControls,
+    __in UINT nDpi
+    );
+static void ScaleControl(
+    __in THEME* pTheme,
+    __in THEME_CONTROL* pControl,
+    __in UINT nDpi
+    );
+static void GetControls(
+    __in THEME* pTheme,
+    __in_opt THEME_CONTROL* pParentControl,
+    __out DWORD** ppcControls,
+    __out THEME_CONTROL*** pprgControls
+    );
+static void GetControls(
+    __in const THEME* pTheme,
+    __in_opt const THEME_CONTROL* pParentControl,
+    __out DWORD& cControls,
+    __out THEME_CONTROL*& rgControls
+    );
+static void ScaleImageReference(
+    __in THEME* pTheme,
+    __in THEME_IMAGE_REFERENCE* pImageRef,
+    __in int nDestWidth,
+    __in int nDestHeight
+    );
+static void UnloadControls(
+    __in DWORD cControls,
+    __in THEME_CONTROL* rgControls
+    );
+
+
+// Public functions.
+
+DAPI_(HRESULT) ThemeInitialize(
+    __in_opt HMODULE hModule
+    )
+{
+    HRESULT hr = S_OK;
+    INITCOMMONCONTROLSEX icex = { };
+
+    DpiuInitialize();
+
+    hr = XmlInitialize();
+    ThmExitOnFailure(hr, "Failed to initialize XML.");
+
+    hr = StrAllocFormatted(&vsczHyperlinkClass, L"ThemeHyperLink_%p", hModule);
+    ThmExitOnFailure(hr, "Failed to initialize hyperlink class name.");
+
+    hr = StrAllocFormatted(&vsczPanelClass, L"ThemePanel_%p", hModule);
+    ThmExitOnFailure(hr, "Failed to initialize panel class name.");
+
+    hr = StrAllocFormatted(&vsczStaticOwnerDrawClass, L"ThemeStaticOwnerDraw_%p", hModule);
+    ThmExitOnFailure(hr, "Failed to initialize static owner draw class name.");
+
+    hr = RegisterWindowClasses(hModule);
+    ThmExitOnFailure(hr, "Failed to register theme window classes.");
+
+    // Initialize GDI+ and common controls.
+    vgsi.SuppressBackgroundThread = TRUE;
+
+    hr = GdipInitialize(&vgsi, &vgdiToken, &vgso);
+    ThmExitOnFailure(hr, "Failed to initialize GDI+.");
+
+    icex.dwSize = sizeof(INITCOMMONCONTROLSEX);
+    icex.dwICC = ICC_STANDARD_CLASSES | ICC_PROGRESS_CLASS | ICC_LISTVIEW_CLASSES | ICC_TREEVIEW_CLASSES | ICC_TAB_CLASSES | ICC_LINK_CLASS;
+    ::InitCommonControlsEx(&icex);
+
+    (*vgso.NotificationHook)(&vgdiHookToken);
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(void) ThemeUninitialize()
+{
+    if (vhModuleMsftEdit)
+    {
+        ::FreeLibrary(vhModuleMsftEdit);
+        vhModuleMsftEdit = NULL;
+    }
+
+    if (vhModuleRichEd)
+    {
+        ::FreeLibrary(vhModuleRichEd);
+        vhModuleRichEd = NULL;
+    }
+
+    if (vhHyperlinkRegisteredModule)
+    {
+        ::UnregisterClassW(vsczHyperlinkClass, vhHyperlinkRegisteredModule);
+        vhHyperlinkRegisteredModule = NULL;
+    }
+
+    ReleaseStr(vsczHyperlinkClass);
+
+    if (vhPanelRegisteredModule)
+    {
+        ::UnregisterClassW(vsczPanelClass, vhPanelRegisteredModule);
+        vhPanelRegisteredModule = NULL;
+    }
+
+    ReleaseStr(vsczPanelClass);
+
+    if (vhStaticOwnerDrawRegisteredModule)
+    {
+        ::UnregisterClassW(vsczStaticOwnerDrawClass, vhStaticOwnerDrawRegisteredModule);
+        vhStaticOwnerDrawRegisteredModule = NULL;
+        vpfnStaticOwnerDrawBaseWndProc = NULL;
+    }
+
+    ReleaseStr(vsczStaticOwnerDrawClass);
+
+    if (vgdiToken)
+    {
+        GdipUninitialize(vgdiToken);
+        vgdiToken = 0;
+    }
+
+    XmlUninitialize();
+    DpiuUninitialize();
+}
+
+
+DAPI_(HRESULT) ThemeLoadFromFile(
+    __in_z LPCWSTR wzThemeFile,
+    __out THEME** ppTheme
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMDocument* pixd = NULL;
+    LPWSTR sczRelativePath = NULL;
+
+    hr = XmlLoadDocumentFromFile(wzThemeFile, &pixd);
+    ThmExitOnFailure(hr, "Failed to load theme resource as XML document.");
+
+    hr = PathGetDirectory(wzThemeFile, &sczRelativePath);
+    ThmExitOnFailure(hr, "Failed to get relative path from theme file.");
+
+    hr = ParseTheme(NULL, sczRelativePath, pixd, ppTheme);
+    ThmExitOnFailure(hr, "Failed to parse theme.");
+
+LExit:
+    ReleaseStr(sczRelativePath);
+    ReleaseObject(pixd);
+
+    return hr;
+}
+
+
+DAPI_(HRESULT) ThemeLoadFromResource(
+    __in_opt HMODULE hModule,
+    __in_z LPCSTR szResource,
+    __out THEME** ppTheme
+    )
+{
+    HRESULT hr = S_OK;
+    LPVOID pvResource = NULL;
+    DWORD cbResource = 0;
+    LPWSTR sczXml = NULL;
+    IXMLDOMDocument* pixd = NULL;
+
+    hr = ResReadData(hModule, szResource, &pvResource, &cbResource);
+    ThmExitOnFailure(hr, "Failed to read theme from resource.");
+
+    hr = StrAllocStringAnsi(&sczXml, reinterpret_cast<LPCSTR>(pvResource), cbResource, CP_UTF8);
+    ThmExitOnFailure(hr, "Failed to convert XML document data from UTF-8 to unicode string.");
+
+    hr = XmlLoadDocument(sczXml, &pixd);
+    ThmExitOnFailure(hr, "Failed to load theme resource as XML document.");
+
+    hr = ParseTheme(hModule, NULL, pixd, ppTheme);
+    ThmExitOnFailure(hr, "Failed to parse theme.");
+
+LExit:
+    ReleaseObject(pixd);
+    ReleaseStr(sczXml);
+
+    return hr;
+}
+
+
+DAPI_(void) ThemeFree(
+    __in THEME* pTheme
+    )
+{
+    if (pTheme)
+    {
+        for (DWORD i = 0; i < pTheme->cFonts; ++i)
+        {
+            FreeFont(pTheme->rgFonts + i);
+        }
+
+        for (DWORD i = 0; i < pTheme->cImages; ++i)
+        {
+            FreeImage(pTheme->rgImages + i);
+        }
+
+        for (DWORD i = 0; i < pTheme->cStandaloneImages; ++i)
+        {
+            FreeImageInstance(pTheme->rgStandaloneImages + i);
+        }
+
+        for (DWORD i = 0; i < pTheme->cPages; ++i)
+        {
+            FreePage(pTheme->rgPages + i);
+        }
+
+        for (DWORD i = 0; i < pTheme->cImageLists; ++i)
+        {
+            FreeImageList(pTheme->rgImageLists + i);
+        }
+
+        for (DWORD i = 0; i < pTheme->cControls; ++i)
+        {
+            FreeControl(pTheme->rgControls + i);
+        }
+
+        ReleaseMem(pTheme->rgControls);
+        ReleaseMem(pTheme->rgPages);
+        ReleaseMem(pTheme->rgStandaloneImages);
+        ReleaseMem(pTheme->rgImages);
+        ReleaseMem(pTheme->rgFonts);
+
+        ReleaseStr(pTheme->sczCaption);
+        ReleaseDict(pTheme->sdhFontDictionary);
+        ReleaseDict(pTheme->sdhImageDictionary);
+        ReleaseMem(pTheme);
+    }
+}
+
+DAPI_(HRESULT) ThemeRegisterVariableCallbacks(
+    __in THEME* pTheme,
+    __in_opt PFNTHM_EVALUATE_VARIABLE_CONDITION pfnEvaluateCondition,
+    __in_opt PFNTHM_FORMAT_VARIABLE_STRING pfnFormatString,
+    __in_opt PFNTHM_GET_VARIABLE_NUMERIC pfnGetNumericVariable,
+    __in_opt PFNTHM_SET_VARIABLE_NUMERIC pfnSetNumericVariable,
+    __in_opt PFNTHM_GET_VARIABLE_STRING pfnGetStringVariable,
+    __in_opt PFNTHM_SET_VARIABLE_STRING pfnSetStringVariable,
+    __in_opt LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    ThmExitOnNull(pTheme, hr, S_FALSE, "Theme must be loaded first.");
+
+    pTheme->pfnEvaluateCondition = pfnEvaluateCondition;
+    pTheme->pfnFormatString = pfnFormatString;
+    pTheme->pfnGetNumericVariable = pfnGetNumericVariable;
+    pTheme->pfnSetNumericVariable = pfnSetNumericVariable;
+    pTheme->pfnGetStringVariable = pfnGetStringVariable;
+    pTheme->pfnSetStringVariable = pfnSetStringVariable;
+    pTheme->pvVariableContext = pvContext;
+
+LExit:
+    return hr;
+}
+
+DAPI_(HRESULT) ThemeRegisterVariableBatchCallback(
+    __in THEME* pTheme,
+    __in_opt PFNTHM_EVALUATE_VARIABLE_BATCH pfnEvaluateVariableBatch
+    )
+{
+    HRESULT hr = S_OK;
+    ThmExitOnNull(pTheme, hr, S_FALSE, "Theme must be loaded first.");
+
+    pTheme->pfnEvaluateVariableBatch = pfnEvaluateVariableBatch;
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(void) ThemeInitializeWindowClass(
+    __in THEME* pTheme,
+    __in WNDCLASSW* pWndClass,
+    __in WNDPROC pfnWndProc,
+    __in HINSTANCE hInstance,
+    __in LPCWSTR wzClassName
+    )
+{
+    pWndClass->style = CS_HREDRAW | CS_VREDRAW;
+    pWndClass->cbWndExtra = DLGWINDOWEXTRA;
+    pWndClass->hCursor = ::LoadCursorW(NULL, (LPCWSTR)IDC_ARROW);
+
+    pWndClass->lpfnWndProc = pfnWndProc;
+    pWndClass->hInstance = hInstance;
+    pWndClass->lpszClassName = wzClassName;
+
+    pWndClass->hIcon = reinterpret_cast<HICON>(pTheme->hIcon);
+    pWndClass->hbrBackground = pTheme->rgFonts[pTheme->dwFontId].hBackground;
+}
+
+
+DAPI_(HRESULT) ThemeCreateParentWindow(
+    __in THEME* pTheme,
+    __in DWORD dwExStyle,
+    __in LPCWSTR szClassName,
+    __in LPCWSTR szWindowName,
+    __in DWORD dwStyle,
+    __in int x,
+    __in int y,
+    __in_opt HWND hwndParent,
+    __in_opt HINSTANCE hInstance,
+    __in_opt LPVOID lpParam,
+    __in THEME_WINDOW_INITIAL_POSITION initialPosition,
+    __out_opt HWND* phWnd
+    )
+{
+    HRESULT hr = S_OK;
+    DPIU_MONITOR_CONTEXT* pMonitorContext = NULL;
+    POINT pt = { };
+    RECT* pMonitorRect = NULL;
+    HMENU hMenu = NULL;
+    HWND hWnd = NULL;
+    BOOL fScaledTheme = FALSE;
+
+    if (pTheme->hwndParent)
+    {
+        ThmExitOnFailure(hr = E_INVALIDSTATE, "ThemeCreateParentWindow called after the theme was loaded.");
+    }
+
+    if (THEME_WINDOW_INITIAL_POSITION_CENTER_MONITOR_FROM_COORDINATES == initialPosition)
+    {
+        pt.x = x;
+        pt.y = y;
+        hr = DpiuGetMonitorContextFromPoint(&pt, &pMonitorContext);
+        if (SUCCEEDED(hr))
+        {
+            pMonitorRect = &pMonitorContext->mi.rcWork;
+            if (pMonitorContext->nDpi != pTheme->nDpi)
+            {
+                ScaleTheme(pTheme, pMonitorContext->nDpi, pMonitorRect->left, pMonitorRect->top, dwStyle, NULL != hMenu, dwExStyle);
+                fScaledTheme = TRUE;
+            }
+
+            x = pMonitorRect->left + (pMonitorRect->right - pMonitorRect->left - pTheme->nWindowWidth) / 2;
+            y = pMonitorRect->top + (pMonitorRect->bottom - pMonitorRect->top - pTheme->nWindowHeight) / 2;
+        }
+        else
+        {
+            hr = S_OK;
+            x = CW_USEDEFAULT;
+            y = CW_USEDEFAULT;
+        }
+    }
+
+    // Make sure the client area matches the specified width and height.
+    if (!fScaledTheme)
+    {
+        AdjustThemeWindowRect(pTheme, dwStyle, NULL != hMenu, dwExStyle);
+    }
+
+    hWnd = ::CreateWindowExW(dwExStyle, szClassName, szWindowName, dwStyle, x, y, pTheme->nWindowWidth, pTheme->nWindowHeight, hwndParent, hMenu, hInstance, lpParam);
+    ThmExitOnNullWithLastError(hWnd, hr, "Failed to create theme parent window.");
+    ThmExitOnNull(pTheme->hwndParent, hr, E_INVALIDSTATE, "Theme parent window is not set, make sure ThemeDefWindowProc is called for WM_NCCREATE.");
+    AssertSz(hWnd == pTheme->hwndParent, "Theme parent window does not equal newly created window.");
+
+    if (phWnd)
+    {
+        *phWnd = hWnd;
+    }
+
+LExit:
+    ReleaseMem(pMonitorContext);
+
+    return hr;
+}
+
+DAPI_(HRESULT) ThemeLocalize(
+    __in THEME *pTheme,
+    __in const WIX_LOCALIZATION *pWixLoc
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczCaption = NULL;
+
+    hr = LocLocalizeString(pWixLoc, &pTheme->sczCaption);
+    ThmExitOnFailure(hr, "Failed to localize theme caption.");
+
+    if (pTheme->pfnFormatString)
+    {
+        hr = pTheme->pfnFormatString(pTheme->sczCaption, &sczCaption, pTheme->pvVariableContext);
+        if (SUCCEEDED(hr))
+        {
+            hr = ThemeUpdateCaption(pTheme, sczCaption);
+        }
+    }
+
+    hr = LocalizeControls(pTheme->cControls, pTheme->rgControls, pWixLoc);
+
+LExit:
+    ReleaseStr(sczCaption);
+    
+    return hr;
+}
+
+/********************************************************************
+ ThemeLoadStrings - Loads string resources.
+ Must be called after loading a theme and before calling
+ ThemeLoadControls.
+*******************************************************************/
+DAPI_(HRESULT) ThemeLoadStrings(
+    __in THEME* pTheme,
+    __in HMODULE hResModule
+    )
+{
+    HRESULT hr = S_OK;
+    ThmExitOnNull(pTheme, hr, S_FALSE, "Theme must be loaded first.");
+
+    if (UINT_MAX != pTheme->uStringId)
+    {
+        hr = ResReadString(hResModule, pTheme->uStringId, &pTheme->sczCaption);
+        ThmExitOnFailure(hr, "Failed to load theme caption.");
+    }
+
+    hr = LoadControlsString(pTheme->cControls, pTheme->rgControls, hResModule);
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(HRESULT) ThemeLoadRichEditFromFile(
+    __in const THEME_CONTROL* pThemeControl,
+    __in_z LPCWSTR wzFileName,
+    __in HMODULE hModule
+    )
+{
+    HRESULT hr = E_INVALIDARG;
+
+    if (pThemeControl)
+    {
+        AssertSz(THEME_CONTROL_TYPE_RICHEDIT == pThemeControl->type, "ThemeLoadRichEditFromFile called for non-RichEdit control.");
+
+        hr = WnduLoadRichEditFromFile(pThemeControl->hWnd, wzFileName, hModule);
+    }
+
+    return hr;
+}
+
+
+DAPI_(HRESULT) ThemeLoadRichEditFromResource(
+    __in const THEME_CONTROL* pThemeControl,
+    __in_z LPCSTR szResourceName,
+    __in HMODULE hModule
+    )
+{
+    HRESULT hr = E_INVALIDARG;
+
+    if (pThemeControl)
+    {
+        AssertSz(THEME_CONTROL_TYPE_RICHEDIT == pThemeControl->type, "ThemeLoadRichEditFromResource called for non-RichEdit control.");
+
+        hr = WnduLoadRichEditFromResource(pThemeControl->hWnd, szResourceName, hModule);
+    }
+
+    return hr;
+}
+
+
+DAPI_(BOOL) ThemeHandleKeyboardMessage(
+    __in_opt THEME* pTheme,
+    __in HWND /*hWnd*/,
+    __in MSG* pMsg
+    )
+{
+    return pTheme ? ::IsDialogMessageW(pTheme->hwndParent, pMsg) : FALSE;
+}
+
+
+extern "C" LRESULT CALLBACK ThemeDefWindowProc(
+    __in_opt THEME* pTheme,
+    __in HWND hWnd,
+    __in UINT uMsg,
+    __in WPARAM wParam,
+    __in LPARAM lParam
+    )
+{
+    RECT rcParent = { };
+    RECT *pRect = NULL;
+
+    if (pTheme)
+    {
+        switch (uMsg)
+        {
+        case WM_NCCREATE:
+            if (pTheme->hwndParent)
+            {
+                AssertSz(FALSE, "WM_NCCREATE called multiple times");
+            }
+            else
+            {
+                OnNcCreate(pTheme, hWnd, lParam);
+            }
+            break;
+
+        case WM_CREATE:
+            if (FAILED(LoadThemeControls(pTheme)))
+            {
+                return -1;
+            }
+            break;
+
+        case WM_DESTROY:
+            UnloadThemeControls(pTheme);
+            break;
+
+        case WM_NCHITTEST:
+            if (pTheme->dwStyle & WS_POPUP)
+            {
+                return HTCAPTION; // allow pop-up windows to be moved by grabbing any non-control.
+            }
+            break;
+
+        case WM_DPICHANGED:
+            if (OnDpiChanged(pTheme, wParam, lParam))
+            {
+                return 0;
+            }
+            break;
+
+        case WM_SIZING:
+            if (pTheme->fAutoResize)
+            {
+                pRect = reinterpret_cast<RECT *>(lParam);
+                if (pRect->right - pRect->left < pTheme->nMinimumWidth)
+                {
+                    if (wParam == WMSZ_BOTTOMLEFT || wParam == WMSZ_LEFT || wParam == WMSZ_TOPLEFT)
+                    {
+                        pRect->left = pRect->right - pTheme->nMinimumWidth;
+                    }
+                    else
+                    {
+                        pRect->right = pRect->left + pTheme->nMinimumWidth;
+                    }
+                }
+                if (pRect->bottom - pRect->top < pTheme->nMinimumHeight)
+                {
+                    if (wParam == WMSZ_BOTTOM || wParam == WMSZ_BOTTOMLEFT || wParam == WMSZ_BOTTOMRIGHT)
+                    {
+                        pRect->bottom = pRect->top + pTheme->nMinimumHeight;
+                    }
+                    else
+                    {
+                        pRect->top = pRect->bottom - pTheme->nMinimumHeight;
+                    }
+                }
+
+                return TRUE;
+            }
+            break;
+
+        case WM_SIZE:
+            if (pTheme->fAutoResize || pTheme->fForceResize)
+            {
+                pTheme->fForceResize = FALSE;
+                ::GetClientRect(pTheme->hwndParent, &rcParent);
+                ScaleImageReference(pTheme, &pTheme->windowImageRef, rcParent.right - rcParent.left, rcParent.bottom - rcParent.top);
+                ResizeControls(pTheme, pTheme->cControls, pTheme->rgControls, &rcParent);
+                return 0;
+            }
+            break;
+        }
+    }
+
+    return ControlGroupDefWindowProc(pTheme, hWnd, uMsg, wParam, lParam, TRUE);
+}
+
+
+DAPI_(void) ThemeGetPageIds(
+    __in const THEME* pTheme,
+    __in_ecount(cGetPages) LPCWSTR* rgwzFindNames,
+    __inout_ecount(cGetPages) DWORD* rgdwPageIds,
+    __in DWORD cGetPages
+    )
+{
+    for (DWORD i = 0; i < cGetPages; ++i)
+    {
+        LPCWSTR wzFindName = rgwzFindNames[i];
+        for (DWORD j = 0; j < pTheme->cPages; ++j)
+        {
+            LPCWSTR wzPageName = pTheme->rgPages[j].sczName;
+            if (wzPageName && CSTR_EQUAL == ::CompareStringW(LOCALE_NEUTRAL, 0, wzPageName, -1, wzFindName, -1))
+            {
+                rgdwPageIds[i] = j + 1; // add one to make the page ids 1-based (so zero is invalid).
+                break;
+            }
+        }
+    }
+}
+
+
+DAPI_(THEME_PAGE*) ThemeGetPage(
+    __in const THEME* pTheme,
+    __in DWORD dwPage
+    )
+{
+    DWORD iPage = dwPage - 1;
+    THEME_PAGE* pPage = NULL;
+
+    if (iPage < pTheme->cPages)
+    {
+        pPage = pTheme->rgPages + iPage;
+    }
+
+    return pPage;
+}
+
+
+DAPI_(HRESULT) ThemeShowPage(
+    __in THEME* pTheme,
+    __in DWORD dwPage,
+    __in int nCmdShow
+    )
+{
+    return ThemeShowPageEx(pTheme, dwPage, nCmdShow, THEME_SHOW_PAGE_REASON_DEFAULT);
+}
+
+
+DAPI_(HRESULT) ThemeShowPageEx(
+    __in THEME* pTheme,
+    __in DWORD dwPage,
+    __in int nCmdShow,
+    __in THEME_SHOW_PAGE_REASON reason
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fHide = SW_HIDE == nCmdShow;
+    BOOL fSaveEditboxes = FALSE;
+    THEME_SAVEDVARIABLE* pSavedVariable = NULL;
+    THEME_PAGE* pPage = ThemeGetPage(pTheme, dwPage);
+    SIZE_T cb = 0;
+
+    if (pPage)
+    {
+        if (fHide)
+        {
+            switch (reason)
+            {
+            case THEME_SHOW_PAGE_REASON_DEFAULT:
+                // Set the variables in the loop below.
+                fSaveEditboxes = TRUE;
+                break;
+            case THEME_SHOW_PAGE_REASON_CANCEL:
+                if (pPage->cSavedVariables && pTheme->pfnSetStringVariable)
+                {
+                    // Best effort to cancel any changes to the variables.
+                    for (DWORD v = 0; v < pPage->cSavedVariables; ++v)
+                    {
+                        pSavedVariable = pPage->rgSavedVariables + v;
+                        if (pSavedVariable->wzName)
+                        {
+                            pTheme->pfnSetStringVariable(pSavedVariable->wzName, pSavedVariable->sczValue, FALSE, pTheme->pvVariableContext);
+                        }
+                    }
+                }
+                break;
+            }
+
+            if (THEME_SHOW_PAGE_REASON_REFRESH != reason)
+            {
+                pPage->cSavedVariables = 0;
+                if (pPage->rgSavedVariables && SUCCEEDED(MemSizeChecked(pPage->rgSavedVariables, &cb)))
+                {
+                    SecureZeroMemory(pPage->rgSavedVariables, cb);
+                }
+            }
+
+            pTheme->dwCurrentPageId = 0;
+        }
+        else
+        {
+            if (THEME_SHOW_PAGE_REASON_REFRESH == reason)
+            {
+                fSaveEditboxes = TRUE;
+            }
+            else
+            {
+                hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pPage->rgSavedVariables), pPage->cControlIndices, sizeof(THEME_SAVEDVARIABLE), pPage->cControlIndices);
+                ThmExitOnFailure(hr, "Failed to allocate memory for saved variables.");
+
+                if (SUCCEEDED(MemSizeChecked(pPage->rgSavedVariables, &cb)))
+                {
+                    SecureZeroMemory(pPage->rgSavedVariables, cb);
+                }
+
+                pPage->cSavedVariables = pPage->cControlIndices;
+
+                // Save the variables in the loop below.
+            }
+
+            pTheme->dwCurrentPageId = dwPage;
+        }
+    }
+
+    hr = ShowPageControls(pTheme, nCmdShow, fSaveEditboxes, reason, dwPage);
+    ThmExitOnFailure(hr, "Failed to show page controls.");
+
+    // Images drawn only by the hidden page are decoded again the next time it is shown.
+    if (fHide && dwPage)
+    {
+        EvictPageImages(pTheme, dwPage);
+    }
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(BOOL) ThemeControlExistsByHWnd(
+    __in const THEME* pTheme,
+    __in HWND hWnd,
+    __out_opt const THEME_CONTROL** ppThemeControl
+    )
+{
+    const THEME_CONTROL* pControl = FindControlFromHWnd(pTheme, hWnd);
+
+    if (ppThemeControl)
+    {
+        *ppThemeControl = pControl;
+    }
+
+    return NULL != pControl;
+}
+
+
+DAPI_(BOOL) ThemeControlExistsById(
+    __in const THEME* pTheme,
+    __in WORD wId,
+    __out_opt const THEME_CONTROL** ppThemeControl
+    )
+{
+    const THEME_CONTROL* pControl = FindControlFromId(pTheme, wId);
+
+    if (ppThemeControl)
+    {
+        *ppThemeControl = pControl;
+    }
+
+    return NULL != pControl;
+}
+
+
+DAPI_(void) ThemeControlEnable(
+    __in const THEME_CONTROL* pThemeControl,
+    __in BOOL fEnable
+    )
+{
+    if (pThemeControl)
+    {
+        THEME_CONTROL* pControl = const_cast<THEME_CONTROL*>(pThemeControl);
+        pControl->dwInternalStyle = fEnable ? (pControl->dwInternalStyle & ~INTERNAL_CONTROL_STYLE_DISABLED) : (pControl->dwInternalStyle | INTERNAL_CONTROL_STYLE_DISABLED);
+        ::EnableWindow(pControl->hWnd, fEnable);
+
+        if (pControl->dwInternalStyle & INTERNAL_CONTROL_STYLE_HIDE_WHEN_DISABLED)
+        {
+            ::ShowWindow(pControl->hWnd, fEnable ? SW_SHOW : SW_HIDE);
+        }
+    }
+}
+
+
+DAPI_(BOOL) ThemeControlEnabled(
+    __in const THEME_CONTROL* pThemeControl
+    )
+{
+    BOOL fEnabled = FALSE;
+
+    if (pThemeControl)
+    {
+        fEnabled = !(pThemeControl->dwInternalStyle & INTERNAL_CONTROL_STYLE_DISABLED);
+    }
+
+    return fEnabled;
+}
+
+
+DAPI_(void) ThemeControlElevates(
+    __in const THEME_CONTROL* pThemeControl,
+    __in BOOL fElevates
+    )
+{
+    if (pThemeControl)
+    {
+        ::SendMessageW(pThemeControl->hWnd, BCM_SETSHIELD, 0, fElevates);
+    }
+}
+
+
+DAPI_(void) ThemeShowControl(
+    __in const THEME_CONTROL* pThemeControl,
+    __in int nCmdShow
+    )
+{
+    if (pThemeControl)
+    {
+        THEME_CONTROL* pControl = const_cast<THEME_CONTROL*>(pThemeControl);
+        ::ShowWindow(pControl->hWnd, nCmdShow);
+
+        // Save the control's visible state.
+        pControl->dwInternalStyle = (SW_HIDE == nCmdShow) ? (pControl->dwInternalStyle | INTERNAL_CONTROL_STYLE_HIDDEN) : (pControl->dwInternalStyle & ~INTERNAL_CONTROL_STYLE_HIDDEN);
+    }
+}
+
+
+DAPI_(void) ThemeShowControlEx(
+    __in const THEME_CONTROL* pThemeControl,
+    __in int nCmdShow
+    )
+{
+    if (pThemeControl)
+    {
+        THEME_CONTROL* pControl = const_cast<THEME_CONTROL*>(pThemeControl);
+        ShowControl(pControl, nCmdShow, THEME_CONTROL_TYPE_EDITBOX == pControl->type, THEME_SHOW_PAGE_REASON_REFRESH, 0, NULL);
+    }
+}
+
+
+DAPI_(BOOL) ThemeControlVisible(
+    __in const THEME_CONTROL* pThemeControl
+    )
+{
+    BOOL fVisible = FALSE;
+
+    if (pThemeControl)
+    {
+        fVisible = ::IsWindowVisible(pThemeControl->hWnd);
+    }
+
+    return fVisible;
+}
+
+
+DAPI_(HRESULT) ThemeDrawBackground(
+    __in THEME* pTheme,
+    __in PAINTSTRUCT* pps
+    )
+{
+    HRESULT hr = S_FALSE;
+
+    if (pps->fErase && THEME_IMAGE_REFERENCE_TYPE_NONE != pTheme->windowImageRef.type)
+    {
+        hr = DrawImageReference(pTheme, &pTheme->windowImageRef, 0, pps->hdc, 0, 0, pTheme->nWidth, pTheme->nHeight);
+    }
+
+    return hr;
+}
+
+
+DAPI_(HRESULT) ThemeDrawControl(
+    __in THEME* pTheme,
+    __in DRAWITEMSTRUCT* pdis
+    )
+{
+    HRESULT hr = S_OK;
+    const THEME_CONTROL* pControl = NULL;
+    BOOL fExists = ThemeControlExistsByHWnd(pTheme, pdis->hwndItem, &pControl);
+
+    AssertSz(fExists, "Expected control window from owner draw window.");
+    if (!fExists)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    AssertSz(pControl->hWnd == pdis->hwndItem, "Expected control window to match owner draw window.");
+    AssertSz(pControl->nWidth < 1 || pControl->nWidth == pdis->rcItem.right - pdis->rcItem.left, "Expected control window width to match owner draw window width.");
+    AssertSz(pControl->nHeight < 1 || pControl->nHeight == pdis->rcItem.bottom - pdis->rcItem.top, "Expected control window height to match owner draw window height.");
+
+    switch (pControl->type)
+    {
+    case THEME_CONTROL_TYPE_BUTTON:
+        hr = DrawButton(pTheme, pdis, pControl);
+        ThmExitOnFailure(hr, "Failed to draw button.");
+        break;
+
+    case THEME_CONTROL_TYPE_HYPERLINK:
+        hr = DrawHyperlink(pTheme, pdis, pControl);
+        ThmExitOnFailure(hr, "Failed to draw hyperlink.");
+        break;
+
+    case THEME_CONTROL_TYPE_IMAGE:
+        hr = DrawImage(pTheme, pdis, pControl);
+        ThmExitOnFailure(hr, "Failed to draw image.");
+        break;
+
+    case THEME_CONTROL_TYPE_PROGRESSBAR:
+        hr = DrawProgressBar(pTheme, pdis, pControl);
+        ThmExitOnFailure(hr, "Failed to draw progress bar.");
+        break;
+
+    default:
+        hr = E_UNEXPECTED;
+        ThmExitOnRootFailure(hr, "Did not specify an owner draw control to draw.");
+    }
+
+LExit:
+    return hr;
+}
+
+
+static BOOL ThemeHoverControl(
+    __in THEME* pTheme,
+    __in HWND hwndParent,
+    __in HWND hwndControl
+    )
+{
+    BOOL fHovered = FALSE;
+    if (hwndControl != pTheme->hwndHover)
+    {
+        if (pTheme->hwndHover && pTheme->hwndHover != hwndParent)
+        {
+            DrawHoverControl(pTheme, FALSE);
+        }
+
+        pTheme->hwndHover = hwndControl;
+
+        if (pTheme->hwndHover && pTheme->hwndHover != hwndParent)
+        {
+            fHovered = DrawHoverControl(pTheme, TRUE);
+        }
+    }
+
+    return fHovered;
+}
+
+
+DAPI_(BOOL) ThemeIsControlChecked(
+    __in const THEME_CONTROL* pThemeControl
+    )
+{
+    BOOL fChecked = FALSE;
+
+    if (pThemeControl)
+    {
+        fChecked = BST_CHECKED == ::SendMessageW(pThemeControl->hWnd, BM_GETCHECK, 0, 0);
+    }
+
+    return fChecked;
+}
+
+
+static BOOL ThemeSetControlColor(
+    __in THEME* pTheme,
+    __in HDC hdc,
+    __in HWND hWnd,
+    __out HBRUSH* phBackgroundBrush
+    )
+{
+    THEME_FONT* pFont = NULL;
+    BOOL fHasBackground = FALSE;
+    const THEME_CONTROL* pControl = NULL;
+
+    *phBackgroundBrush = NULL;
+
+    if (hWnd == pTheme->hwndParent)
+    {
+        pFont = (THEME_INVALID_ID == pTheme->dwFontId) ? NULL : pTheme->rgFonts + pTheme->dwFontId;
+    }
+    else if (ThemeControlExistsByHWnd(pTheme, hWnd, &pControl))
+    {
+        pFont = THEME_INVALID_ID == pControl->dwFontId ? NULL : pTheme->rgFonts + pControl->dwFontId;
+    }
+
+    if (pFont)
+    {
+        if (pFont->hForeground)
+        {
+            ::SetTextColor(hdc, pFont->crForeground);
+        }
+
+        if (pFont->hBackground)
+        {
+            ::SetBkColor(hdc, pFont->crBackground);
+
+            *phBackgroundBrush = pFont->hBackground;
+            fHasBackground = TRUE;
+        }
+        else
+        {
+            ::SetBkMode(hdc, TRANSPARENT);
+            *phBackgroundBrush = static_cast<HBRUSH>(::GetStockObject(NULL_BRUSH));
+            fHasBackground = TRUE;
+        }
+    }
+
+    return fHasBackground;
+}
+
+
+DAPI_(HRESULT) ThemeSetProgressControl(
+    __in const THEME_CONTROL* pThemeControl,
+    __in DWORD dwProgressPercentage
+    )
+{
+    HRESULT hr = E_INVALIDARG;
+
+    if (pThemeControl && THEME_CONTROL_TYPE_PROGRESSBAR == pThemeControl->type)
+    {
+        THEME_CONTROL* pControl = const_cast<THEME_CONTROL*>(pThemeControl);
+
+        DWORD dwCurrentProgress = LOWORD(pControl->dwData);
+
+        if (dwCurrentProgress != dwProgressPercentage)
+        {
+            DWORD dwColor = HIWORD(pControl->dwData);
+            pControl->dwData = MAKEDWORD(dwProgressPercentage, dwColor);
+
+            if (pControl->dwInternalStyle & INTERNAL_CONTROL_STYLE_OWNER_DRAW)
+            {
+                if (!::InvalidateRect(pControl->hWnd, NULL, FALSE))
+                {
+                    ThmExitWithLastError(hr, "Failed to invalidate progress bar window.");
+                }
+            }
+            else
+            {
+                ::SendMessageW(pControl->hWnd, PBM_SETPOS, dwProgressPercentage, 0);
+            }
+
+            hr = S_OK;
+        }
+        else
+        {
+            hr = S_FALSE;
+        }
+    }
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(HRESULT) ThemeSetProgressControlColor(
+    __in const THEME_CONTROL* pThemeControl,
+    __in DWORD dwColorIndex
+    )
+{
+    HRESULT hr = E_INVALIDARG;
+
+    // Only set color on owner draw progress bars.
+    if (pThemeControl && THEME_CONTROL_TYPE_PROGRESSBAR == pThemeControl->type && (pThemeControl->dwInternalStyle & INTERNAL_CONTROL_STYLE_OWNER_DRAW))
+    {
+        THEME_CONTROL* pControl = const_cast<THEME_CONTROL*>(pThemeControl);
+
+        if (pControl->ProgressBar.cImageRef <= dwColorIndex)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDARG, "Invalid progress bar color index: %u", dwColorIndex);
+        }
+
+        if (HIWORD(pControl->dwData) != dwColorIndex)
+        {
+            DWORD dwCurrentProgress =  LOWORD(pControl->dwData);
+            pControl->dwData = MAKEDWORD(dwCurrentProgress, dwColorIndex);
+
+            if (!::InvalidateRect(pControl->hWnd, NULL, FALSE))
+            {
+                ThmExitWithLastError(hr, "Failed to invalidate progress bar window.");
+            }
+
+            hr = S_OK;
+        }
+        else
+        {
+            hr = S_FALSE;
+        }
+    }
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(HRESULT) ThemeSetTextControl(
+    __in const THEME_CONTROL* pThemeControl,
+    __in_z_opt LPCWSTR wzText
+    )
+{
+    return ThemeSetTextControlEx(pThemeControl, FALSE, wzText);
+}
+
+
+DAPI_(HRESULT) ThemeSetTextControlEx(
+    __in const THEME_CONTROL* pThemeControl,
+    __in BOOL fUpdate,
+    __in_z_opt LPCWSTR wzText
+    )
+{
+    HRESULT hr = E_INVALIDARG;
+
+    if (pThemeControl)
+    {
+        if (fUpdate)
+        {
+            ::ShowWindow(pThemeControl->hWnd, SW_HIDE);
+        }
+
+        if (!::SetWindowTextW(pThemeControl->hWnd, wzText))
+        {
+            ThmExitWithLastError(hr, "Failed to set control text.");
+        }
+
+        if (fUpdate)
+        {
+            ::ShowWindow(pThemeControl->hWnd, SW_SHOW);
+        }
+
+        hr = S_OK;
+    }
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(HRESULT) ThemeGetTextControl(
+    __in const THEME_CONTROL* pThemeControl,
+    __inout_z LPWSTR* psczText
+    )
+{
+    HRESULT hr = E_INVALIDARG;
+
+    if (pThemeControl)
+    {
+        hr = WnduGetControlText(pThemeControl->hWnd, psczText);
+    }
+
+    return hr;
+}
+
+
+DAPI_(HRESULT) ThemeUpdateCaption(
+    __in THEME* pTheme,
+    __in_z LPCWSTR wzCaption
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = StrAllocString(&pTheme->sczCaption, wzCaption, 0);
+    ThmExitOnFailure(hr, "Failed to update theme caption.");
+
+LExit:
+    return hr;
+}
+
+
+DAPI_(void) ThemeSetFocus(
+    __in const THEME_CONTROL* pThemeControl
+    )
+{
+    if (pThemeControl)
+    {
+        HWND hwndFocus = pThemeControl->hWnd;
+        if (hwndFocus && !ThemeControlEnabled(pThemeControl))
+        {
+            hwndFocus = ::GetNextDlgTabItem(pThemeControl->pTheme->hwndParent, hwndFocus, FALSE);
+        }
+
+        if (hwndFocus)
+        {
+            ::SendMessage(pThemeControl->pTheme->hwndParent, WM_NEXTDLGCTL, (WPARAM)hwndFocus, TRUE);
+        }
+    }
+}
+
+
+DAPI_(void) ThemeShowChild(
+    __in THEME_CONTROL* pParentControl,
+    __in DWORD dwIndex
+    )
+{
+    // show one child, hide the rest
+    for (DWORD i = 0; i < pParentControl->cControls; ++i)
+    {
+        THEME_CONTROL* pControl = pParentControl->rgControls + i;
+        ShowControl(pControl, dwIndex == i ? SW_SHOW : SW_HIDE, FALSE, THEME_SHOW_PAGE_REASON_DEFAULT, 0, NULL);
+    }
+}
+
+
+// Internal functions.
+
+static HRESULT RegisterWindowClasses(
+    __in_opt HMODULE hModule
+    )
+{
+    HRESULT hr = S_OK;
+    WNDCLASSW wcHyperlink = { };
+    WNDCLASSW wcPanel = { };
+    WNDCLASSW wcStaticOwnerDraw = { };
+    WNDPROC pfnStaticOwnerDrawBaseWndProc = NULL;
+
+    vhCursorHand = ::LoadCursorA(NULL, IDC_HAND);
+
+    // Base the theme hyperlink class on a button but give it the "hand" icon.
+    if (!::GetClassInfoW(NULL, WC_BUTTONW, &wcHyperlink))
+    {
+        ThmExitWithLastError(hr, "Failed to get button window class.");
+    }
+
+    wcHyperlink.lpszClassName = vsczHyperlinkClass;
+#pragma prefast(push)
+#pragma prefast(disable:25068)
+    wcHyperlink.hCursor = vhCursorHand;
+#pragma prefast(pop)
+
+    if (!::RegisterClassW(&wcHyperlink))
+    {
+        ThmExitWithLastError(hr, "Failed to register hyperlink window class.");
+    }
+    vhHyperlinkRegisteredModule = hModule;
+
+    // Panel is its own do-nothing class.
+    wcPanel.lpfnWndProc = PanelWndProc;
+    wcPanel.hInstance = hModule;
+    wcPanel.hCursor = ::LoadCursorW(NULL, (LPCWSTR) IDC_ARROW);
+    wcPanel.lpszClassName = vsczPanelClass;
+    if (!::RegisterClassW(&wcPanel))
+    {
+        ThmExitWithLastError(hr, "Failed to register panel window class.");
+    }
+    vhPanelRegisteredModule = hModule;
+
+    if (!::GetClassInfoW(NULL, WC_STATICW, &wcStaticOwnerDraw))
+    {
+        ThmExitWithLastError(hr, "Failed to get static window class.");
+    }
+
+    pfnStaticOwnerDrawBaseWndProc = wcStaticOwnerDraw.lpfnWndProc;
+    wcStaticOwnerDraw.lpfnWndProc = StaticOwnerDrawWndProc;
+    wcStaticOwnerDraw.hInstance = hModule;
+    wcStaticOwnerDraw.lpszClassName = vsczStaticOwnerDrawClass;
+    if (!::RegisterClassW(&wcStaticOwnerDraw))
+    {
+        ThmExitWithLastError(hr, "Failed to register OwnerDraw window class.");
+    }
+    vhStaticOwnerDrawRegisteredModule = hModule;
+    vpfnStaticOwnerDrawBaseWndProc = pfnStaticOwnerDrawBaseWndProc;
+
+
+LExit:
+    return hr;
+}
+
+static HRESULT ParseTheme(
+    __in_opt HMODULE hModule,
+    __in_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMDocument* pixd,
+    __out THEME** ppTheme
+    )
+{
+    HRESULT hr = S_OK;
+    THEME* pTheme = NULL;
+    IXMLDOMElement *pThemeElement = NULL;
+    THEME_IMAGE_INSTANCE instance = { };
+    BOOL fXmlFound = FALSE;
+
+    hr = pixd->get_documentElement(&pThemeElement);
+    ThmExitOnFailure(hr, "Failed to get theme element.");
+
+    pTheme = static_cast<THEME*>(MemAlloc(sizeof(THEME), TRUE));
+    ThmExitOnNull(pTheme, hr, E_OUTOFMEMORY, "Failed to allocate memory for theme.");
+
+    pTheme->nDpi = USER_DEFAULT_SCREEN_DPI;
+    pTheme->wNextControlId = THEME_FIRST_AUTO_ASSIGN_CONTROL_ID;
+
+    // Parse the optional background resource image.
+    hr = GetAttributeImageSource(hModule, wzRelativePath, pThemeElement, &instance);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed while parsing theme image.");
+
+    if (fXmlFound)
+    {
+        hr = AddStandaloneImage(pTheme, &instance, &pTheme->dwSourceImageInstanceIndex);
+        ThmExitOnFailure(hr, "Failed to store theme image.");
+    }
+    else
+    {
+        pTheme->dwSourceImageInstanceIndex = THEME_INVALID_ID;
+    }
+
+    // Parse the fonts.
+    hr = ParseFonts(pThemeElement, pTheme);
+    ThmExitOnFailure(hr, "Failed to parse theme fonts.");
+
+    // Parse the images.
+    hr = ParseImages(hModule, wzRelativePath, pThemeElement, pTheme);
+    ThmExitOnFailure(hr, "Failed to parse theme images.");
+
+    // Parse any image lists.
+    hr = ParseImageLists(hModule, wzRelativePath, pThemeElement, pTheme);
+    ThmExitOnFailure(hr, "Failed to parse image lists.");
+
+    // Parse the window element.
+    hr = ParseWindow(hModule, wzRelativePath, pThemeElement, pTheme);
+    ThmExitOnFailure(hr, "Failed to parse theme window element.");
+
+    *ppTheme = pTheme;
+    pTheme = NULL;
+
+LExit:
+    ReleaseObject(pThemeElement);
+    FreeImageInstance(&instance);
+
+    if (pTheme)
+    {
+        ThemeFree(pTheme);
+    }
+
+    return hr;
+}
+
+static HRESULT AddStandaloneImage(
+    __in THEME* pTheme,
+    __in THEME_IMAGE_INSTANCE* pSource,
+    __out DWORD* pdwIndex
+    )
+{
+    HRESULT hr = S_OK;
+    THEME_IMAGE_INSTANCE* pInstance = NULL;
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pTheme->rgStandaloneImages), pTheme->cStandaloneImages, 1, sizeof(THEME_IMAGE_INSTANCE), GROW_IMAGE_INSTANCES);
+    ThmExitOnFailure(hr, "Failed to allocate memory for image instances.");
+
+    *pdwIndex = pTheme->cStandaloneImages;
+    ++pTheme->cStandaloneImages;
+
+    pInstance = pTheme->rgStandaloneImages + *pdwIndex;
+
+    // Take ownership of the source, the bitmap is decoded again on first draw.
+    *pInstance = *pSource;
+    memset(pSource, 0, sizeof(THEME_IMAGE_INSTANCE));
+
+    UnloadImageInstance(pInstance);
+
+LExit:
+    return hr;
+}
+
+static HRESULT GetAttributeImageFileOrResource(
+    __in_opt HMODULE hModule,
+    __in_z_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pElement,
+    __out Gdiplus::Bitmap** ppBitmap
+    )
+{
+    HRESULT hr = S_OK;
+    THEME_IMAGE_INSTANCE instance = { };
+    *ppBitmap = NULL;
+
+    hr = GetAttributeImageSource(hModule, wzRelativePath, pElement, &instance);
+    if (SUCCEEDED(hr))
+    {
+        *ppBitmap = instance.pBitmap;
+        instance.pBitmap = NULL;
+    }
+
+    FreeImageInstance(&instance);
+
+    return hr;
+}
+
+static HRESULT GetAttributeImageSource(
+    __in_opt HMODULE hModule,
+    __in_z_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pElement,
+    __in THEME_IMAGE_INSTANCE* pInstance
+    )
+{
+    HRESULT hr = S_OK;
+    BSTR bstr = NULL;
+    WORD wResourceId = 0;
+    BOOL fFound = FALSE;
+
+    hr = XmlGetAttributeUInt16(pElement, L"ImageResource", &wResourceId);
+    ThmExitOnOptionalXmlQueryFailure(hr, fFound, "Failed to get image resource attribute.");
+
+    if (fFound)
+    {
+        pInstance->hModule = hModule;
+        pInstance->wResourceId = wResourceId;
+    }
+
+    hr = XmlGetAttribute(pElement, L"ImageFile", &bstr);
+    ThmExitOnOptionalXmlQueryFailure(hr, fFound, "Failed to get image file attribute.");
+
+    if (fFound)
+    {
+        if (pInstance->wResourceId)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "ImageFile attribute can't be specified with ImageResource attribute.");
+        }
+
+        // Parse the optional background image from a given file.
+        if (wzRelativePath)
+        {
+            hr = PathConcat(wzRelativePath, bstr, &pInstance->sczFile);
+            ThmExitOnFailure(hr, "Failed to combine image file path.");
+        }
+        else
+        {
+            hr = PathRelativeToModule(&pInstance->sczFile, bstr, hModule);
+            ThmExitOnFailure(hr, "Failed to get image filename.");
+        }
+    }
+
+    if (!pInstance->wResourceId && !pInstance->sczFile)
+    {
+        ExitFunction1(hr = E_NOTFOUND);
+    }
+
+    // Opening the image validates it and provides its dimensions for layout and scaling.
+    // GDI+ defers decoding the pixels until the bitmap is first drawn.
+    hr = LoadImageInstance(pInstance, 0);
+    ThmExitOnFailure(hr, "Failed to load image.");
+
+    pInstance->nWidth = pInstance->pBitmap->GetWidth();
+    pInstance->nHeight = pInstance->pBitmap->GetHeight();
+
+LExit:
+    ReleaseBSTR(bstr);
+
+    return hr;
+}
+
+static HRESULT LoadImageInstance(
+    __in THEME_IMAGE_INSTANCE* pInstance,
+    __in DWORD dwPageId
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (pInstance->pBitmap)
+    {
+        // Images shared with the always visible page 0 are never evicted.
+        if (pInstance->dwPageId)
+        {
+            pInstance->dwPageId = dwPageId;
+        }
+
+        ExitFunction();
+    }
+
+    if (pInstance->sczFile)
+    {
+        hr = GdipBitmapFromFile(pInstance->sczFile, &pInstance->pBitmap);
+        ThmExitOnFailure(hr, "Failed to load image from file: %ls", pInstance->sczFile);
+    }
+    else
+    {
+        hr = GdipBitmapFromResource(pInstance->hModule, MAKEINTRESOURCE(pInstance->wResourceId), &pInstance->pBitmap);
+        ThmExitOnFailure(hr, "Failed to load image from resource: %hu", pInstance->wResourceId);
+    }
+
+    pInstance->dwPageId = dwPageId;
+
+LExit:
+    return hr;
+}
+
+static void UnloadImageInstance(
+    __in THEME_IMAGE_INSTANCE* pInstance
+    )
+{
+    if (pInstance->pBitmap)
+    {
+        delete pInstance->pBitmap;
+        pInstance->pBitmap = NULL;
+    }
+}
+
+
+static HRESULT ParseOwnerDrawImage(
+    __in_opt HMODULE hModule,
+    __in_z_opt LPCWSTR wzRelativePath,
+    __in THEME* pTheme,
+    __in IXMLDOMNode* pElement,
+    __in_z LPCWSTR wzElementName,
+    __in THEME_CONTROL* pControl,
+    __in THEME_IMAGE_REFERENCE* pImageRef
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwValue = 0;
+    BOOL fXmlFound = FALSE;
+    BOOL fFoundImage = FALSE;
+    THEME_IMAGE_INSTANCE instance = { };
+
+    hr = GetAttributeImageId(pTheme, pElement, L"ImageId", &dwValue);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to parse ImageId attribute.");
+
+    if (fXmlFound)
+    {
+        pImageRef->type = THEME_IMAGE_REFERENCE_TYPE_COMPLETE;
+        pImageRef->dwImageIndex = dwValue;
+        pImageRef->dwImageInstanceIndex = 0;
+        fFoundImage = TRUE;
+    }
+    else
+    {
+        pImageRef->dwImageIndex = THEME_INVALID_ID;
+    }
+
+    // Parse the optional background resource image.
+    hr = GetAttributeImageSource(hModule, wzRelativePath, pElement, &instance);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed while parsing control image.");
+
+    if (fXmlFound)
+    {
+        if (fFoundImage)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Unexpected image attribute with ImageId attribute.");
+        }
+
+        hr = AddStandaloneImage(pTheme, &instance, &pImageRef->dwImageInstanceIndex);
+        ThmExitOnFailure(hr, "Failed to store owner draw image.");
+
+        pImageRef->type = THEME_IMAGE_REFERENCE_TYPE_COMPLETE;
+
+        fFoundImage = TRUE;
+    }
+
+    hr = ParseSourceXY(pElement, pTheme, pControl->nWidth, pControl->nHeight, pImageRef);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get control SourceX and SourceY attributes.");
+
+    if (fXmlFound)
+    {
+        if (fFoundImage)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Unexpected SourceX attribute with image attribute.");
+        }
+        else if (1 > pControl->nWidth || 1 > pControl->nHeight)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Control Width and Height must be positive when using SourceX and SourceY.");
+        }
+
+        fFoundImage = TRUE;
+    }
+
+    if (!fFoundImage)
+    {
+        ThmExitWithRootFailure(hr, E_INVALIDDATA, "%ls didn't specify an image.", wzElementName);
+    }
+
+LExit:
+    FreeImageInstance(&instance);
+
+    return hr;
+}
+
+
+static HRESULT ParseButtonImages(
+    __in_opt HMODULE hModule,
+    __in_z_opt LPCWSTR wzRelativePath,
+    __in THEME* pTheme,
+    __in IXMLDOMNode* pElement,
+    __in THEME_CONTROL* pControl
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD i = 0;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixnChild = NULL;
+    BSTR bstrType = NULL;
+    THEME_IMAGE_REFERENCE* pImageRef = NULL;
+    THEME_IMAGE_REFERENCE* pDefaultImageRef = NULL;
+    THEME_IMAGE_REFERENCE* pFocusImageRef = NULL;
+    THEME_IMAGE_REFERENCE* pHoverImageRef = NULL;
+    THEME_IMAGE_REFERENCE* pSelectedImageRef = NULL;
+
+    hr = XmlSelectNodes(pElement, L"ButtonImage|ButtonFocusImage|ButtonHoverImage|ButtonSelectedImage", &pixnl);
+    ThmExitOnFailure(hr, "Failed to select child ButtonImage nodes.");
+
+    i = 0;
+    while (S_OK == (hr = XmlNextElement(pixnl, &pixnChild, &bstrType)))
+    {
+        if (!bstrType)
+        {
+            hr = E_UNEXPECTED;
+            ThmExitOnFailure(hr, "Null element encountered!");
+        }
+
+        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"ButtonFocusImage", -1))
+        {
+            if (pFocusImageRef)
+            {
+                ThmExitWithRootFailure(hr, E_INVALIDDATA, "Duplicate ButtonFocusImage element.");
+            }
+
+            pImageRef = pFocusImageRef = pControl->Button.rgImageRef + 3;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"ButtonHoverImage", -1))
+        {
+            if (pHoverImageRef)
+            {
+                ThmExitWithRootFailure(hr, E_INVALIDDATA, "Duplicate ButtonHoverImage element.");
+            }
+
+            pImageRef = pHoverImageRef = pControl->Button.rgImageRef + 1;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"ButtonSelectedImage", -1))
+        {
+            if (pSelectedImageRef)
+            {
+                ThmExitWithRootFailure(hr, E_INVALIDDATA, "Duplicate ButtonSelectedImage element.");
+            }
+
+            pImageRef = pSelectedImageRef = pControl->Button.rgImageRef + 2;
+        }
+        else
+        {
+            if (pDefaultImageRef)
+            {
+                ThmExitWithRootFailure(hr, E_INVALIDDATA, "Duplicate ButtonImage element.");
+            }
+
+            pImageRef = pDefaultImageRef = pControl->Button.rgImageRef;
+        }
+
+        hr = ParseOwnerDrawImage(hModule, wzRelativePath, pTheme, pixnChild, bstrType, pControl, pImageRef);
+        ThmExitOnFailure(hr, "Failed when parsing %ls", bstrType);
+
+        ReleaseBSTR(bstrType);
+        ReleaseNullObject(pixnChild);
+        ++i;
+    }
+
+    if (!pDefaultImageRef && (pFocusImageRef || pHoverImageRef || pSelectedImageRef) ||
+        pDefaultImageRef && (!pHoverImageRef || !pSelectedImageRef))
+    {
+        ThmExitWithRootFailure(hr, E_INVALIDDATA, "Graphic buttons require ButtonImage, ButtonHoverImage, and ButtonSelectedImage.");
+    }
+
+LExit:
+    ReleaseObject(pixnl);
+    ReleaseObject(pixnChild);
+    ReleaseBSTR(bstrType);
+
+    return hr;
+}
+
+
+static HRESULT ParseCommandLinkImage(
+    __in_opt HMODULE hModule,
+    __in_z_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pElement,
+    __in THEME_CONTROL* pControl
+    )
+{
+    HRESULT hr = S_OK;
+    BSTR bstr = NULL;
+    BOOL fImageFound = FALSE;
+    BOOL fXmlFound = FALSE;
+    LPWSTR sczIconFile = NULL;
+    WORD wResourceId = 0;
+    Gdiplus::Bitmap* pBitmap = NULL;
+
+    hr = GetAttributeImageFileOrResource(hModule, wzRelativePath, pElement, &pBitmap);
+    ThmExitOnOptionalXmlQueryFailure(hr, fImageFound, "Failed to parse image attributes for CommandLink.");
+
+    if (pBitmap)
+    {
+        hr = GdipBitmapToGdiBitmap(pBitmap, &pControl->CommandLink.hImage);
+        ThmExitOnFailure(hr, "Failed to convert bitmap for CommandLink.");
+    }
+
+    hr = XmlGetAttributeUInt16(pElement, L"IconResource", &wResourceId);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get icon resource attribute.");
+
+    if (fXmlFound)
+    {
+        if (fImageFound)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Unexpected IconResource attribute with image attribute.");
+        }
+
+        pControl->CommandLink.hIcon = reinterpret_cast<HICON>(::LoadImageW(hModule, MAKEINTRESOURCEW(wResourceId), IMAGE_ICON, 0, 0, LR_DEFAULTSIZE));
+        ThmExitOnNullWithLastError(pControl->CommandLink.hIcon, hr, "Failed to load icon.");
+    }
+
+    hr = XmlGetAttribute(pElement, L"IconFile", &bstr);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get icon file attribute.");
+
+    if (fXmlFound)
+    {
+        if (fImageFound)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Unexpected IconFile attribute with image attribute.");
+        }
+        else if (pControl->CommandLink.hIcon)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "IconFile attribute can't be specified with IconResource attribute.");
+        }
+
+        if (wzRelativePath)
+        {
+            hr = PathConcat(wzRelativePath, bstr, &sczIconFile);
+            ThmExitOnFailure(hr, "Failed to combine image file path.");
+        }
+        else
+        {
+            hr = PathRelativeToModule(&sczIconFile, bstr, hModule);
+            ThmExitOnFailure(hr, "Failed to get image filename.");
+        }
+
+        pControl->CommandLink.hIcon = reinterpret_cast<HICON>(::LoadImageW(NULL, sczIconFile, IMAGE_ICON, 0, 0, LR_DEFAULTSIZE | LR_LOADFROMFILE));
+        ThmExitOnNullWithLastError(pControl->CommandLink.hIcon, hr, "Failed to load icon: %ls.", sczIconFile);
+    }
+
+    ThmExitOnUnexpectedAttribute(hr, pElement, L"CommandLink", L"SourceX");
+    ThmExitOnUnexpectedAttribute(hr, pElement, L"CommandLink", L"SourceY");
+
+LExit:
+    if (pBitmap)
+    {
+        delete pBitmap;
+    }
+
+    ReleaseStr(sczIconFile);
+    ReleaseBSTR(bstr);
+
+    return hr;
+}
+
+
+static HRESULT ParseProgressBarImages(
+    __in_opt HMODULE hModule,
+    __in_z_opt LPCWSTR wzRelativePath,
+    __in THEME* pTheme,
+    __in IXMLDOMNode* pElement,
+    __in THEME_CONTROL* pControl
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD i = 0;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixnChild = NULL;
+
+    hr = XmlSelectNodes(pElement, L"ProgressbarImage", &pixnl);
+    ThmExitOnFailure(hr, "Failed to select child ProgressbarImage nodes.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&pControl->ProgressBar.cImageRef));
+    ThmExitOnFailure(hr, "Failed to count the number of ProgressbarImage nodes.");
+
+    if (!pControl->ProgressBar.cImageRef)
+    {
+        ExitFunction();
+    }
+
+    MemAllocArray(reinterpret_cast<LPVOID*>(&pControl->ProgressBar.rgImageRef), sizeof(THEME_IMAGE_REFERENCE), pControl->ProgressBar.cImageRef);
+    ThmExitOnNull(pControl->ProgressBar.rgImageRef, hr, E_OUTOFMEMORY, "Failed to allocate progress bar images.");
+
+    i = 0;
+    while (S_OK == (hr = XmlNextElement(pixnl, &pixnChild, NULL)))
+    {
+        THEME_IMAGE_REFERENCE* pImageRef = pControl->ProgressBar.rgImageRef + i;
+
+        hr = ParseOwnerDrawImage(hModule, wzRelativePath, pTheme, pixnChild, L"ProgressbarImage", pControl, pImageRef);
+        ThmExitOnFailure(hr, "Failed when parsing ProgressbarImage image: %u.", i);
+
+        ReleaseNullObject(pixnChild);
+        ++i;
+    }
+
+LExit:
+    ReleaseObject(pixnl);
+    ReleaseObject(pixnChild);
+
+    return hr;
+}
+
+
+static HRESULT GetAttributeCoordinateOrDimension(
+    __in IXMLDOMNode* pixn,
+    __in LPCWSTR wzAttribute,
+    __inout int* pnValue
+    )
+{
+    HRESULT hr = S_OK;
+    int nValue = 0;
+    BOOL fXmlFound = FALSE;
+
+    hr = XmlGetAttributeInt32(pixn, wzAttribute, &nValue);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get coordinate or dimension attribute.");
+
+    if (!fXmlFound)
+    {
+        ExitFunction1(hr = E_NOTFOUND);
+    }
+    else if (abs(nValue) > SHORT_MAX)
+    {
+        ThmExitWithRootFailure(hr, E_INVALIDDATA, "Invalid coordinate or dimension attribute value: %i", nValue);
+    }
+
+    *pnValue = nValue;
+
+LExit:
+    return hr;
+}
+
+static HRESULT GetAttributeFontId(
+    __in THEME* pTheme,
+    __in IXMLDOMNode* pixn,
+    __in LPCWSTR wzAttribute,
+    __inout DWORD* pdwValue
+    )
+{
+    HRESULT hr = S_OK;
+    BSTR bstrId = NULL;
+    THEME_FONT* pFont = NULL;
+    BOOL fXmlFound = FALSE;
+
+    hr = XmlGetAttribute(pixn, wzAttribute, &bstrId);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get font id attribute.");
+
+    if (!fXmlFound)
+    {
+        ExitFunction1(hr = E_NOTFOUND);
+    }
+
+    hr = DictGetValue(pTheme->sdhFontDictionary, bstrId, reinterpret_cast<void**>(&pFont));
+    if (E_NOTFOUND == hr)
+    {
+        ThmExitWithRootFailure(hr, E_INVALIDDATA, "Unknown font id: %ls", bstrId);
+    }
+    ThmExitOnFailure(hr, "Failed to find font with id: %ls", bstrId);
+
+    *pdwValue = pFont->dwIndex;
+
+LExit:
+    ReleaseBSTR(bstrId);
+
+    return hr;
+}
+
+static HRESULT GetAttributeImageId(
+    __in THEME* pTheme,
+    __in IXMLDOMNode* pixn,
+    __in LPCWSTR wzAttribute,
+    __inout DWORD* pdwValue
+    )
+{
+    HRESULT hr = S_OK;
+    BSTR bstrId = NULL;
+    THEME_IMAGE* pImage = NULL;
+    BOOL fXmlFound = FALSE;
+
+    hr = XmlGetAttribute(pixn, wzAttribute, &bstrId);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get image id attribute.");
+
+    if (!fXmlFound)
+    {
+        ExitFunction1(hr = E_NOTFOUND);
+    }
+
+    hr = DictGetValue(pTheme->sdhImageDictionary, bstrId, reinterpret_cast<void**>(&pImage));
+    if (E_NOTFOUND == hr)
+    {
+        ThmExitWithRootFailure(hr, E_INVALIDDATA, "Unknown image id: %ls", bstrId);
+    }
+    ThmExitOnFailure(hr, "Failed to find image with id: %ls", bstrId);
+
+    *pdwValue = pImage->dwIndex;
+
+LExit:
+    ReleaseBSTR(bstrId);
+
+    return hr;
+}
+
+static HRESULT ParseSourceXY(
+    __in IXMLDOMNode* pixn,
+    __in THEME* pTheme,
+    __in int nWidth,
+    __in int nHeight,
+    __inout THEME_IMAGE_REFERENCE* pReference
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fXFound = FALSE;
+    BOOL fYFound = FALSE;
+    int nX = 0;
+    int nY = 0;
+    DWORD dwImageInstanceIndex = pTheme->dwSourceImageInstanceIndex;
+    THEME_IMAGE_INSTANCE* pInstance = THEME_INVALID_ID != dwImageInstanceIndex ? pTheme->rgStandaloneImages + dwImageInstanceIndex : NULL;
+    int nSourceWidth = pInstance ? pInstance->nWidth : 0;
+    int nSourceHeight = pInstance ? pInstance->nHeight : 0;
+
+    hr = GetAttributeCoordinateOrDimension(pixn, L"SourceX", &nX);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXFound, "Failed to get SourceX attribute.");
+
+    if (!fXFound)
+    {
+        nX = -1;
+    }
+    else
+    {
+        if (!pInstance)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "SourceX cannot be specified without an image specified on Theme.");
+        }
+        else if (0 > nX)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "SourceX must be non-negative.");
+        }
+        else if (nSourceWidth <= nX)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "SourceX (%i) must be less than the image width: %i.", nX, nSourceWidth);
+        }
+        else if (nSourceWidth <= (nX + nWidth))
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "SourceX (%i) with width %i must be less than the image width: %i.", nX, nWidth, nSourceWidth);
+        }
+    }
+
+    hr = GetAttributeCoordinateOrDimension(pixn, L"SourceY", &nY);
+    ThmExitOnOptionalXmlQueryFailure(hr, fYFound, "Failed to get SourceY attribute.");
+
+    if (!fYFound)
+    {
+        if (fXFound)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "SourceY must be specified with SourceX.");
+        }
+
+        ExitFunction1(hr = E_NOTFOUND);
+    }
+    else
+    {
+        if (!pInstance)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "SourceY cannot be specified without an image specified on Theme.");
+        }
+        else if (!fXFound)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "SourceY must be specified with SourceX.");
+        }
+        else if (0 > nY)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "SourceY must be non-negative.");
+        }
+        else if (nSourceHeight <= nY)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "SourceY (%i) must be less than the image height: %i.", nY, nSourceHeight);
+        }
+        else if (nSourceHeight <= (nY + nHeight))
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "SourceY (%i) with height %i must be less than the image height: %i.", nY, nHeight, nSourceHeight);
+        }
+    }
+
+    pReference->type = THEME_IMAGE_REFERENCE_TYPE_PARTIAL;
+    pReference->dwImageIndex = THEME_INVALID_ID;
+    pReference->dwImageInstanceIndex = dwImageInstanceIndex;
+    pReference->nX = nX;
+    pReference->nY = nY;
+    pReference->nWidth = nWidth;
+    pReference->nHeight = nHeight;
+
+LExit:
+    return hr;
+}
+
+static HRESULT ParseWindow(
+    __in_opt HMODULE hModule,
+    __in_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMElement* pElement,
+    __in THEME* pTheme
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMNode* pixn = NULL;
+    BOOL fXmlFound = FALSE;
+    int nValue = 0;
+    BSTR bstr = NULL;
+    LPWSTR sczIconFile = NULL;
+
+    hr = XmlSelectSingleNode(pElement, L"Window", &pixn);
+    ThmExitOnRequiredXmlQueryFailure(hr, "Failed to find window element.");
+
+    hr = XmlGetYesNoAttribute(pixn, L"AutoResize", &pTheme->fAutoResize);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get window AutoResize attribute.");
+
+    hr = GetAttributeCoordinateOrDimension(pixn, L"Width", &nValue);
+    ThmExitOnRequiredXmlQueryFailure(hr, "Failed to get window Width attribute.");
+
+    if (1 > nValue)
+    {
+        ThmExitWithRootFailure(hr, E_INVALIDDATA, "Window/@Width must be positive: %i", nValue);
+    }
+
+    pTheme->nWidth = pTheme->nDefaultDpiWidth = pTheme->nWindowWidth = nValue;
+
+    hr = GetAttributeCoordinateOrDimension(pixn, L"Height", &nValue);
+    ThmExitOnRequiredXmlQueryFailure(hr, "Failed to get window Height attribute.");
+
+    if (1 > nValue)
+    {
+        ThmExitWithRootFailure(hr, E_INVALIDDATA, "Window/@Height must be positive: %i", nValue);
+    }
+
+    pTheme->nHeight = pTheme->nDefaultDpiHeight = pTheme->nWindowHeight = nValue;
+
+    hr = GetAttributeCoordinateOrDimension(pixn, L"MinimumWidth", &nValue);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get window MinimumWidth attribute.");
+
+    if (fXmlFound)
+    {
+        if (!pTheme->fAutoResize)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Window/@MinimumWidth can't be specified unless AutoResize is enabled.");
+        }
+        else if (1 > nValue || pTheme->nWidth < nValue)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Window/@MinimumWidth must be positive and not greater than Window/@Width: %i", nValue);
+        }
+
+        pTheme->nMinimumWidth = pTheme->nDefaultDpiMinimumWidth = nValue;
+    }
+
+    hr = GetAttributeCoordinateOrDimension(pixn, L"MinimumHeight", &nValue);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get window MinimumHeight attribute.");
+
+    if (fXmlFound)
+    {
+        if (!pTheme->fAutoResize)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Window/@MinimumHeight can't be specified unless AutoResize is enabled.");
+        }
+        else if (1 > nValue || pTheme->nHeight < nValue)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Window/@MinimumHeight must be positive and not greater than Window/@Height: %i", nValue);
+        }
+
+        pTheme->nMinimumHeight = pTheme->nDefaultDpiMinimumHeight = nValue;
+    }
+
+    hr = GetAttributeFontId(pTheme, pixn, L"FontId", &pTheme->dwFontId);
+    ThmExitOnRequiredXmlQueryFailure(hr, "Failed to get window FontId attribute.");
+
+    // Get the optional window icon from a resource.
+    hr = XmlGetAttribute(pixn, L"IconResource", &bstr);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get window IconResource attribute.");
+
+    if (fXmlFound)
+    {
+        pTheme->hIcon = ::LoadIconW(hModule, bstr);
+        ThmExitOnNullWithLastError(pTheme->hIcon, hr, "Failed to load window icon from IconResource.");
+
+        ReleaseNullBSTR(bstr);
+    }
+
+    // Get the optional window icon from a file.
+    hr = XmlGetAttribute(pixn, L"IconFile", &bstr);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get window IconFile attribute.");
+
+    if (fXmlFound)
+    {
+        if (pTheme->hIcon)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Window/@IconFile can't be specified with IconResource.");
+        }
+
+        if (wzRelativePath)
+        {
+            hr = PathConcat(wzRelativePath, bstr, &sczIconFile);
+            ThmExitOnFailure(hr, "Failed to combine icon file path.");
+        }
+        else
+        {
+            hr = PathRelativeToModule(&sczIconFile, bstr, hModule);
+            ThmExitOnFailure(hr, "Failed to get icon filename.");
+        }
+
+        pTheme->hIcon = ::LoadImageW(NULL, sczIconFile, IMAGE_ICON, 0, 0, LR_DEFAULTSIZE | LR_LOADFROMFILE);
+        ThmExitOnNullWithLastError(pTheme->hIcon, hr, "Failed to load window icon from IconFile: %ls.", bstr);
+
+        ReleaseNullBSTR(bstr);
+    }
+
+    hr = ParseSourceXY(pixn, pTheme, pTheme->nDefaultDpiWidth, pTheme->nDefaultDpiHeight, &pTheme->windowImageRef);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get window SourceX and SourceY attributes.");
+
+    // Parse the optional window style.
+    hr = XmlGetAttributeNumberBase(pixn, L"HexStyle", 16, &pTheme->dwStyle);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get theme window style (Window@HexStyle) attribute.");
+
+    if (!fXmlFound)
+    {
+        pTheme->dwStyle = WS_VISIBLE | WS_MINIMIZEBOX | WS_SYSMENU | WS_CAPTION;
+        pTheme->dwStyle |= (THEME_IMAGE_REFERENCE_TYPE_NONE != pTheme->windowImageRef.type) ? WS_POPUP : WS_OVERLAPPED;
+    }
+
+    hr = XmlGetAttributeUInt32(pixn, L"StringId", reinterpret_cast<DWORD*>(&pTheme->uStringId));
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get window StringId attribute.");
+
+    if (!fXmlFound)
+    {
+        pTheme->uStringId = UINT_MAX;
+    }
+    else if (UINT_MAX == pTheme->uStringId)
+    {
+        ThmExitWithRootFailure(hr, E_INVALIDDATA, "Invalid StringId: %u", pTheme->uStringId);
+    }
+
+    hr = XmlGetAttributeEx(pixn, L"Caption", &pTheme->sczCaption);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get window Caption attribute.");
+
+    if (fXmlFound && UINT_MAX != pTheme->uStringId || !fXmlFound && UINT_MAX == pTheme->uStringId)
+    {
+        ThmExitWithRootFailure(hr, E_INVALIDDATA, "Window elements must contain either the Caption or StringId attribute.");
+    }
+
+    // Parse the pages.
+    hr = ParsePages(hModule, wzRelativePath, pixn, pTheme);
+    ThmExitOnFailure(hr, "Failed to parse theme pages.");
+
+    // Parse the non-paged controls.
+    hr = ParseControls(hModule, wzRelativePath, pixn, pTheme, NULL, NULL);
+    ThmExitOnFailure(hr, "Failed to parse theme controls.");
+
+LExit:
+    ReleaseStr(sczIconFile);
+    ReleaseBSTR(bstr);
+    ReleaseObject(pixn);
+
+    return hr;
+}
+
+
+static HRESULT ParseFonts(
+    __in IXMLDOMElement* pElement,
+    __in THEME* pTheme
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixn = NULL;
+    LPWSTR sczFontId = NULL;
+    BSTR bstrName = NULL;
+    DWORD dwId = 0;
+    BOOL fXmlFound = FALSE;
+    COLORREF crForeground = THEME_INVISIBLE_COLORREF;
+    COLORREF crBackground = THEME_INVISIBLE_COLORREF;
+    DWORD dwSystemForegroundColor = FALSE;
+    DWORD dwSystemBackgroundColor = FALSE;
+
+    hr = XmlSelectNodes(pElement, L"Font", &pixnl);
+    ThmExitOnFailure(hr, "Failed to find font elements.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&pTheme->cFonts));
+    ThmExitOnFailure(hr, "Failed to count the number of theme fonts.");
+
+    if (!pTheme->cFonts)
+    {
+        ThmExitOnRootFailure(hr = E_INVALIDDATA, "No font elements found.");
+    }
+
+    pTheme->rgFonts = static_cast<THEME_FONT*>(MemAlloc(sizeof(THEME_FONT) * pTheme->cFonts, TRUE));
+    ThmExitOnNull(pTheme->rgFonts, hr, E_OUTOFMEMORY, "Failed to allocate theme fonts.");
+
+    hr = DictCreateWithEmbeddedKey(&pTheme->sdhFontDictionary, pTheme->cFonts, reinterpret_cast<void**>(&pTheme->rgFonts), offsetof(THEME_FONT, sczId), DICT_FLAG_NONE);
+    ThmExitOnFailure(hr, "Failed to create font dictionary.");
+
+    while (S_OK == (hr = XmlNextElement(pixnl, &pixn, NULL)))
+    {
+        hr = XmlGetAttributeEx(pixn, L"Id", &sczFontId);
+        ThmExitOnRequiredXmlQueryFailure(hr, "Failed to find font id.");
+
+        hr = DictKeyExists(pTheme->sdhFontDictionary, sczFontId);
+        if (E_NOTFOUND != hr)
+        {
+            ThmExitOnFailure(hr, "Failed to check for duplicate font id.");
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Theme font id duplicated: %ls", sczFontId);
+        }
+
+        THEME_FONT* pFont = pTheme->rgFonts + dwId;
+        pFont->sczId = sczFontId;
+        sczFontId = NULL;
+        pFont->dwIndex = dwId;
+        ++dwId;
+
+        pFont->lfQuality = CLEARTYPE_QUALITY;
+
+        hr = XmlGetText(pixn, &bstrName);
+        ThmExitOnRequiredXmlQueryFailure(hr, "Failed to get font name.");
+
+        hr = StrAllocString(&pFont->sczFaceName, bstrName, 0);
+        ThmExitOnFailure(hr, "Failed to copy font name.");
+
+        hr = XmlGetAttributeInt32(pixn, L"Height", reinterpret_cast<int*>(&pFont->lfHeight));
+        ThmExitOnRequiredXmlQueryFailure(hr, "Failed to find font height attribute.");
+
+        hr = XmlGetAttributeInt32(pixn, L"Weight", reinterpret_cast<int*>(&pFont->lfWeight));
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to find font weight attribute.");
+
+        if (!fXmlFound)
+        {
+            pFont->lfWeight = FW_DONTCARE;
+        }
+
+        hr = XmlGetYesNoAttribute(pixn, L"Underline", reinterpret_cast<BOOL*>(&pFont->lfUnderline));
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to find font underline attribute.");
+
+        if (!fXmlFound)
+        {
+            pFont->lfUnderline = FALSE;
+        }
+
+        hr = GetFontColor(pixn, L"Foreground", &crForeground, &dwSystemForegroundColor);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to find font foreground color.");
+
+        hr = GetFontColor(pixn, L"Background", &crBackground, &dwSystemBackgroundColor);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to find font background color.");
+
+        pFont->crForeground = crForeground;
+        if (THEME_INVISIBLE_COLORREF != pFont->crForeground)
+        {
+            pFont->hForeground = dwSystemForegroundColor ? ::GetSysColorBrush(dwSystemForegroundColor) : ::CreateSolidBrush(pFont->crForeground);
+            ThmExitOnNull(pFont->hForeground, hr, E_OUTOFMEMORY, "Failed to create text foreground brush.");
+        }
+
+        pFont->crBackground = crBackground;
+        if (THEME_INVISIBLE_COLORREF != pFont->crBackground)
+        {
+            pFont->hBackground = dwSystemBackgroundColor ? ::GetSysColorBrush(dwSystemBackgroundColor) : ::CreateSolidBrush(pFont->crBackground);
+            ThmExitOnNull(pFont->hBackground, hr, E_OUTOFMEMORY, "Failed to create text background brush.");
+        }
+
+        hr = DictAddValue(pTheme->sdhFontDictionary, pFont);
+        ThmExitOnFailure(hr, "Failed to add font to dictionary.");
+
+        ReleaseNullBSTR(bstrName);
+        ReleaseNullObject(pixn);
+    }
+    ThmExitOnFailure(hr, "Failed to enumerate all fonts.");
+
+    if (S_FALSE == hr)
+    {
+        hr = S_OK;
+    }
+
+LExit:
+    ReleaseBSTR(bstrName);
+    ReleaseStr(sczFontId);
+    ReleaseObject(pixn);
+    ReleaseObject(pixnl);
+
+    return hr;
+}
+
+
+static HRESULT GetFontColor(
+    __in IXMLDOMNode* pixn,
+    __in_z LPCWSTR wzAttributeName,
+    __out COLORREF* pColorRef,
+    __out DWORD* pdwSystemColor
+    )
+{
+    HRESULT hr = S_OK;
+    BSTR bstr = NULL;
+    BOOL fXmlFound = FALSE;
+
+    *pdwSystemColor = 0;
+
+    hr = XmlGetAttribute(pixn, wzAttributeName, &bstr);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to find font %ls color.", wzAttributeName);
+
+    if (!fXmlFound)
+    {
+        *pColorRef = THEME_INVISIBLE_COLORREF;
+        ExitFunction1(hr = E_NOTFOUND);
+    }
+
+    if (pdwSystemColor)
+    {
+        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstr, -1, L"btnface", -1))
+        {
+            *pdwSystemColor = COLOR_BTNFACE;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstr, -1, L"btntext", -1))
+        {
+            *pdwSystemColor = COLOR_BTNTEXT;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstr, -1, L"graytext", -1))
+        {
+            *pdwSystemColor = COLOR_GRAYTEXT;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstr, -1, L"highlight", -1))
+        {
+            *pdwSystemColor = COLOR_HIGHLIGHT;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstr, -1, L"highlighttext", -1))
+        {
+            *pdwSystemColor = COLOR_HIGHLIGHTTEXT;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstr, -1, L"hotlight", -1))
+        {
+            *pdwSystemColor = COLOR_HOTLIGHT;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstr, -1, L"window", -1))
+        {
+            *pdwSystemColor = COLOR_WINDOW;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstr, -1, L"windowtext", -1))
+        {
+            *pdwSystemColor = COLOR_WINDOWTEXT;
+        }
+        else
+        {
+            *pColorRef = ::wcstoul(bstr, NULL, 16);
+
+            if (THEME_INVISIBLE_COLORREF == *pColorRef)
+            {
+                ThmExitWithRootFailure(hr, E_INVALIDDATA, "Invalid %ls value: %ls.", wzAttributeName, bstr);
+            }
+        }
+
+        if (*pdwSystemColor)
+        {
+            *pColorRef = ::GetSysColor(*pdwSystemColor);
+        }
+    }
+
+LExit:
+    ReleaseBSTR(bstr);
+
+    return hr;
+}
+
+
+static HRESULT ParseImages(
+    __in_opt HMODULE hModule,
+    __in_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMElement* pElement,
+    __in THEME* pTheme
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixn = NULL;
+    LPWSTR sczImageId = NULL;
+    DWORD dwImageIndex = 0;
+    THEME_IMAGE_INSTANCE defaultInstance = { };
+    IXMLDOMNodeList* pixnlAlternates = NULL;
+    IXMLDOMNode* pixnAlternate = NULL;
+    DWORD dwInstances = 0;
+    THEME_IMAGE_INSTANCE* pInstance = NULL;
+    BOOL fXmlFound = FALSE;
+
+    hr = XmlSelectNodes(pElement, L"Image", &pixnl);
+    ThmExitOnFailure(hr, "Failed to find font elements.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&pTheme->cImages));
+    ThmExitOnFailure(hr, "Failed to count the number of theme images.");
+
+    if (!pTheme->cImages)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+
+    pTheme->rgImages = static_cast<THEME_IMAGE*>(MemAlloc(sizeof(THEME_IMAGE) * pTheme->cImages, TRUE));
+    ThmExitOnNull(pTheme->rgImages, hr, E_OUTOFMEMORY, "Failed to allocate theme images.");
+
+    hr = DictCreateWithEmbeddedKey(&pTheme->sdhImageDictionary, pTheme->cImages, reinterpret_cast<void**>(&pTheme->rgImages), offsetof(THEME_IMAGE, sczId), DICT_FLAG_NONE);
+    ThmExitOnFailure(hr, "Failed to create image dictionary.");
+
+    while (S_OK == (hr = XmlNextElement(pixnl, &pixn, NULL)))
+    {
+        hr = XmlGetAttributeEx(pixn, L"Id", &sczImageId);
+        ThmExitOnRequiredXmlQueryFailure(hr, "Failed to find image id.");
+
+        hr = DictKeyExists(pTheme->sdhImageDictionary, sczImageId);
+        if (E_NOTFOUND != hr)
+        {
+            ThmExitOnFailure(hr, "Failed to check for duplicate image id.");
+            ThmExitOnRootFailure(hr = E_INVALIDDATA, "Theme image id duplicated: %ls", sczImageId);
+        }
+
+        THEME_IMAGE* pImage = pTheme->rgImages + dwImageIndex;
+        pImage->sczId = sczImageId;
+        sczImageId = NULL;
+        pImage->dwIndex = dwImageIndex;
+        ++dwImageIndex;
+
+        hr = GetAttributeImageSource(hModule, wzRelativePath, pixn, &defaultInstance);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to parse Image: %ls", pImage->sczId);
+
+        if (!fXmlFound)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "Image didn't specify an image: %ls.", pImage->sczId);
+        }
+
+        hr = DictAddValue(pTheme->sdhImageDictionary, pImage);
+        ThmExitOnFailure(hr, "Failed to add image to dictionary.");
+
+        // Parse alternates, if any.
+        hr = XmlSelectNodes(pixn, L"AlternateResolution", &pixnlAlternates);
+        ThmExitOnFailure(hr, "Failed to select child AlternateResolution nodes.");
+
+        hr = pixnlAlternates->get_length(reinterpret_cast<long*>(&dwInstances));
+        ThmExitOnFailure(hr, "Failed to count the number of alternates.");
+
+        dwInstances += 1;
+
+        pImage->rgImageInstances = static_cast<THEME_IMAGE_INSTANCE*>(MemAlloc(sizeof(THEME_IMAGE_INSTANCE) * dwInstances, TRUE));
+        ThmExitOnNull(pImage->rgImageInstances, hr, E_OUTOFMEMORY, "Failed to allocate image instances.");
+
+        // Only the source and dimensions are kept, the bitmaps are decoded on first draw.
+        pInstance = pImage->rgImageInstances;
+        *pInstance = defaultInstance;
+        memset(&defaultInstance, 0, sizeof(defaultInstance));
+        UnloadImageInstance(pInstance);
+        pImage->cImageInstances += 1;
+
+        while (S_OK == (hr = XmlNextElement(pixnlAlternates, &pixnAlternate, NULL)))
+        {
+            pInstance = pImage->rgImageInstances + pImage->cImageInstances;
+
+            // Count the instance before parsing it so a partially parsed source is freed with the image.
+            pImage->cImageInstances += 1;
+
+            hr = GetAttributeImageSource(hModule, wzRelativePath, pixnAlternate, pInstance);
+            ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to parse Image: '%ls', alternate resolution: %u", pImage->sczId, pImage->cImageInstances - 1);
+
+            if (!fXmlFound)
+            {
+                ThmExitWithRootFailure(hr, E_INVALIDDATA, "Image: '%ls', alternate resolution: %u, didn't specify an image.", pImage->sczId, pImage->cImageInstances - 1);
+            }
+
+            UnloadImageInstance(pInstance);
+
+            ReleaseNullObject(pixnAlternate);
+        }
+
+        ReleaseNullObject(pixnlAlternates);
+        ReleaseNullObject(pixn);
+    }
+    ThmExitOnFailure(hr, "Failed to enumerate all images.");
+
+    if (S_FALSE == hr)
+    {
+        hr = S_OK;
+    }
+
+LExit:
+    FreeImageInstance(&defaultInstance);
+
+    ReleaseObject(pixnAlternate);
+    ReleaseObject(pixnlAlternates);
+    ReleaseStr(sczImageId);
+    ReleaseObject(pixn);
+    ReleaseObject(pixnl);
+
+    return hr;
+}
+
+static HRESULT ParsePages(
+    __in_opt HMODULE hModule,
+    __in_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pElement,
+    __in THEME* pTheme
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixn = NULL;
+    BSTR bstrType = NULL;
+    THEME_PAGE* pPage = NULL;
+    DWORD iPage = 0;
+    BOOL fXmlFound = FALSE;
+
+    hr = XmlSelectNodes(pElement, L"Page", &pixnl);
+    ThmExitOnFailure(hr, "Failed to find page elements.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&pTheme->cPages));
+    ThmExitOnFailure(hr, "Failed to count the number of theme pages.");
+
+    if (!pTheme->cPages)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+
+    pTheme->rgPages = static_cast<THEME_PAGE*>(MemAlloc(sizeof(THEME_PAGE) * pTheme->cPages, TRUE));
+    ThmExitOnNull(pTheme->rgPages, hr, E_OUTOFMEMORY, "Failed to allocate theme pages.");
+
+    while (S_OK == (hr = XmlNextElement(pixnl, &pixn, &bstrType)))
+    {
+        pPage = pTheme->rgPages + iPage;
+
+        pPage->wId = static_cast<WORD>(iPage + 1);
+
+        hr = XmlGetAttributeEx(pixn, L"Name", &pPage->sczName);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying page Name.");
+
+        hr = ParseControls(hModule, wzRelativePath, pixn, pTheme, NULL, pPage);
+        ThmExitOnFailure(hr, "Failed to parse page controls.");
+
+        ++iPage;
+
+        ReleaseNullBSTR(bstrType);
+        ReleaseNullObject(pixn);
+    }
+    ThmExitOnFailure(hr, "Failed to enumerate all pages.");
+
+    if (S_FALSE == hr)
+    {
+        hr = S_OK;
+    }
+
+LExit:
+    ReleaseBSTR(bstrType);
+    ReleaseObject(pixn);
+    ReleaseObject(pixnl);
+
+    return hr;
+}
+
+
+static HRESULT ParseImageLists(
+    __in_opt HMODULE hModule,
+    __in_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pElement,
+    __in THEME* pTheme
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMNodeList* pixnlImageLists = NULL;
+    IXMLDOMNode* pixnImageList = NULL;
+    IXMLDOMNodeList* pixnlImages = NULL;
+    IXMLDOMNode* pixnImage = NULL;
+    DWORD dwImageListIndex = 0;
+    DWORD dwImageCount = 0;
+    THEME_IMAGELIST* pThemeImageList = NULL;
+    BOOL fXmlFound = FALSE;
+    Gdiplus::Bitmap* pBitmap = NULL;
+    HBITMAP hImage = NULL;
+    DWORD i = 0;
+    int iRetVal = 0;
+
+    hr = XmlSelectNodes(pElement, L"ImageList", &pixnlImageLists);
+    ThmExitOnFailure(hr, "Failed to find ImageList elements.");
+
+    hr = pixnlImageLists->get_length(reinterpret_cast<long*>(&pTheme->cImageLists));
+    ThmExitOnFailure(hr, "Failed to count the number of image lists.");
+
+    if (!pTheme->cImageLists)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+
+    pTheme->rgImageLists = static_cast<THEME_IMAGELIST*>(MemAlloc(sizeof(THEME_IMAGELIST) * pTheme->cImageLists, TRUE));
+    ThmExitOnNull(pTheme->rgImageLists, hr, E_OUTOFMEMORY, "Failed to allocate theme image lists.");
+
+    while (S_OK == (hr = XmlNextElement(pixnlImageLists, &pixnImageList, NULL)))
+    {
+        pThemeImageList = pTheme->rgImageLists + dwImageListIndex;
+        ++dwImageListIndex;
+        i = 0;
+
+        hr = XmlGetAttributeEx(pixnImageList, L"Name", &pThemeImageList->sczName);
+        ThmExitOnRequiredXmlQueryFailure(hr, "Failed to find ImageList/@Name attribute.");
+
+        hr = XmlSelectNodes(pixnImageList, L"ImageListItem", &pixnlImages);
+        ThmExitOnFailure(hr, "Failed to select child ImageListItem nodes.");
+
+        hr = pixnlImages->get_length(reinterpret_cast<long*>(&dwImageCount));
+        ThmExitOnFailure(hr, "Failed to count the number of images in list.");
+
+        if (!dwImageCount)
+        {
+            ThmExitOnRootFailure(hr = E_INVALIDDATA, "ImageList '%ls' has no images.", pThemeImageList->sczName);
+        }
+
+        while (S_OK == (hr = XmlNextElement(pixnlImages, &pixnImage, NULL)))
+        {
+            if (pBitmap)
+            {
+                delete pBitmap;
+                pBitmap = NULL;
+            }
+            if (hImage)
+            {
+                ::DeleteObject(hImage);
+                hImage = NULL;
+            }
+
+            hr = GetAttributeImageFileOrResource(hModule, wzRelativePath, pixnImage, &pBitmap);
+            ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to parse image list: '%ls', item: %u", pThemeImageList->sczName, i);
+
+            if (!fXmlFound)
+            {
+                ThmExitWithRootFailure(hr, E_INVALIDDATA, "Image list: '%ls', item %u didn't specify an image.", pThemeImageList->sczName, i);
+            }
+
+            if (0 == i)
+            {
+                pThemeImageList->hImageList = ImageList_Create(pBitmap->GetWidth(), pBitmap->GetHeight(), ILC_COLOR24, dwImageCount, 0);
+                ThmExitOnNullWithLastError(pThemeImageList->hImageList, hr, "Failed to create image list.");
+            }
+
+            hr = GdipBitmapToGdiBitmap(pBitmap, &hImage);
+            ThmExitOnFailure(hr, "Failed to convert bitmap for CommandLink.");
+
+            iRetVal = ImageList_Add(pThemeImageList->hImageList, hImage, NULL);
+            if (-1 == iRetVal)
+            {
+                ThmExitWithLastError(hr, "Failed to add image %u to image list.", i);
+            }
+
+            ++i;
+            ReleaseNullObject(pixnImage);
+        }
+
+        ReleaseNullObject(pixnlImages);
+        ReleaseNullObject(pixnImageList);
+    }
+
+LExit:
+    if (hImage)
+    {
+        ::DeleteObject(hImage);
+    }
+    if (pBitmap)
+    {
+        delete pBitmap;
+    }
+    ReleaseObject(pixnlImageLists);
+    ReleaseObject(pixnImageList);
+    ReleaseObject(pixnlImages);
+    ReleaseObject(pixnImage);
+
+    return hr;
+}
+
+static void GetControls(
+    __in THEME* pTheme,
+    __in_opt THEME_CONTROL* pParentControl,
+    __out DWORD** ppcControls,
+    __out THEME_CONTROL*** pprgControls
+    )
+{
+    if (pParentControl)
+    {
+        *ppcControls = &pParentControl->cControls;
+        *pprgControls = &pParentControl->rgControls;
+    }
+    else
+    {
+        *ppcControls = &pTheme->cControls;
+        *pprgControls = &pTheme->rgControls;
+    }
+}
+
+static void GetControls(
+    __in const THEME* pTheme,
+    __in_opt const THEME_CONTROL* pParentControl,
+    __out DWORD& cControls,
+    __out THEME_CONTROL*& rgControls
+    )
+{
+    if (pParentControl)
+    {
+        cControls = pParentControl->cControls;
+        rgControls = pParentControl->rgControls;
+    }
+    else
+    {
+        cControls = pTheme->cControls;
+        rgControls = pTheme->rgControls;
+    }
+}
+
+static HRESULT ParseControls(
+    __in_opt HMODULE hModule,
+    __in_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pElement,
+    __in THEME* pTheme,
+    __in_opt THEME_CONTROL* pParentControl,
+    __in_opt THEME_PAGE* pPage
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixn = NULL;
+    BSTR bstrType = NULL;
+    DWORD cNewControls = 0;
+    DWORD iControl = 0;
+    DWORD* pcControls = NULL;
+    THEME_CONTROL** prgControls = NULL;
+
+    GetControls(pTheme, pParentControl, &pcControls, &prgControls);
+
+    hr = ParseRadioButtons(hModule, wzRelativePath, pElement, pTheme, pParentControl, pPage);
+    ThmExitOnFailure(hr, "Failed to parse radio buttons.");
+
+    hr = XmlSelectNodes(pElement, L"Billboard|Button|Checkbox|Combobox|CommandLink|Editbox|Hyperlink|Hypertext|ImageControl|Label|ListView|Panel|Progressbar|Richedit|Static|Tabs|TreeView", &pixnl);
+    ThmExitOnFailure(hr, "Failed to find control elements.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&cNewControls));
+    ThmExitOnFailure(hr, "Failed to count the number of theme controls.");
+
+    if (!cNewControls)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(prgControls), *pcControls, cNewControls, sizeof(THEME_CONTROL), 0);
+    ThmExitOnFailure(hr, "Failed to reallocate theme controls.");
+
+    cNewControls += *pcControls;
+
+    if (pPage)
+    {
+        pPage->cControlIndices += cNewControls;
+    }
+
+    iControl = *pcControls;
+    *pcControls = cNewControls;
+
+    while (S_OK == (hr = XmlNextElement(pixnl, &pixn, &bstrType)))
+    {
+        THEME_CONTROL_TYPE type = THEME_CONTROL_TYPE_UNKNOWN;
+
+        if (!bstrType)
+        {
+            hr = E_UNEXPECTED;
+            ThmExitOnFailure(hr, "Null element encountered!");
+        }
+
+        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Billboard", -1))
+        {
+            type = THEME_CONTROL_TYPE_BILLBOARD;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Button", -1))
+        {
+            type = THEME_CONTROL_TYPE_BUTTON;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Checkbox", -1))
+        {
+            type = THEME_CONTROL_TYPE_CHECKBOX;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Combobox", -1))
+        {
+            type = THEME_CONTROL_TYPE_COMBOBOX;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"CommandLink", -1))
+        {
+            type = THEME_CONTROL_TYPE_COMMANDLINK;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Editbox", -1))
+        {
+            type = THEME_CONTROL_TYPE_EDITBOX;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Hyperlink", -1))
+        {
+            type = THEME_CONTROL_TYPE_HYPERLINK;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Hypertext", -1))
+        {
+            type = THEME_CONTROL_TYPE_HYPERTEXT;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"ImageControl", -1))
+        {
+            type = THEME_CONTROL_TYPE_IMAGE;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Label", -1))
+        {
+            type = THEME_CONTROL_TYPE_LABEL;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"ListView", -1))
+        {
+            type = THEME_CONTROL_TYPE_LISTVIEW;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Panel", -1))
+        {
+            type = THEME_CONTROL_TYPE_PANEL;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Progressbar", -1))
+        {
+            type = THEME_CONTROL_TYPE_PROGRESSBAR;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Richedit", -1))
+        {
+            type = THEME_CONTROL_TYPE_RICHEDIT;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Static", -1))
+        {
+            type = THEME_CONTROL_TYPE_STATIC;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"Tabs", -1))
+        {
+            type = THEME_CONTROL_TYPE_TAB;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"TreeView", -1))
+        {
+            type = THEME_CONTROL_TYPE_TREEVIEW;
+        }
+
+        if (THEME_CONTROL_TYPE_UNKNOWN != type)
+        {
+            THEME_CONTROL* pControl = *prgControls + iControl;
+            pControl->type = type;
+
+            hr = ParseControl(hModule, wzRelativePath, pixn, bstrType, pTheme, pControl, pPage);
+            ThmExitOnFailure(hr, "Failed to parse control.");
+
+            if (pPage)
+            {
+                pControl->wPageId = pPage->wId;
+            }
+
+            ++iControl;
+        }
+
+        ReleaseNullBSTR(bstrType);
+        ReleaseNullObject(pixn);
+    }
+    ThmExitOnFailure(hr, "Failed to enumerate all controls.");
+
+    if (S_FALSE == hr)
+    {
+        hr = S_OK;
+    }
+
+    AssertSz(iControl == cNewControls, "The number of parsed controls didn't match the number of expected controls.");
+
+LExit:
+    ReleaseBSTR(bstrType);
+    ReleaseObject(pixn);
+    ReleaseObject(pixnl);
+
+    return hr;
+}
+
+
+static HRESULT ParseControl(
+    __in_opt HMODULE hModule,
+    __in_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pixn,
+    __in_z LPCWSTR wzElementName,
+    __in THEME* pTheme,
+    __in THEME_CONTROL* pControl,
+    __in_opt THEME_PAGE* pPage
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fXmlFound = FALSE;
+    DWORD dwValue = 0;
+    int nValue = 0;
+    BOOL fValue = FALSE;
+    BSTR bstrText = NULL;
+    BOOL fAnyTextChildren = FALSE;
+    BOOL fAnyNoteChildren = FALSE;
+
+    InitializeThemeControl(pTheme, pControl);
+
+    hr = XmlGetAttributeEx(pixn, L"Name", &pControl->sczName);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control Name attribute.");
+
+    hr = XmlGetAttributeEx(pixn, L"EnableCondition", &pControl->sczEnableCondition);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control EnableCondition attribute.");
+
+    hr = XmlGetAttributeEx(pixn, L"VisibleCondition", &pControl->sczVisibleCondition);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control VisibleCondition attribute.");
+
+    hr = GetAttributeCoordinateOrDimension(pixn, L"X", &nValue);
+    ThmExitOnRequiredXmlQueryFailure(hr, "Failed to find control X attribute.");
+
+    pControl->nX = pControl->nDefaultDpiX = nValue;
+
+    hr = GetAttributeCoordinateOrDimension(pixn, L"Y", &nValue);
+    ThmExitOnRequiredXmlQueryFailure(hr, "Failed to find control Y attribute.");
+
+    pControl->nY = pControl->nDefaultDpiY = nValue;
+
+    hr = GetAttributeCoordinateOrDimension(pixn, L"Height", &nValue);
+    ThmExitOnRequiredXmlQueryFailure(hr, "Failed to find control Height attribute.");
+
+    pControl->nHeight = pControl->nDefaultDpiHeight = nValue;
+
+    hr = GetAttributeCoordinateOrDimension(pixn, L"Width", &nValue);
+    ThmExitOnRequiredXmlQueryFailure(hr, "Failed to find control Width attribute.");
+
+    pControl->nWidth = pControl->nDefaultDpiWidth = nValue;
+
+    switch (pControl->type)
+    {
+    case THEME_CONTROL_TYPE_COMMANDLINK:
+        hr = ParseCommandLinkImage(hModule, wzRelativePath, pixn, pControl);
+        ThmExitOnFailure(hr, "Failed while parsing CommandLink image.");
+        break;
+    case THEME_CONTROL_TYPE_BUTTON:
+        hr = ParseButtonImages(hModule, wzRelativePath, pTheme, pixn, pControl);
+        ThmExitOnFailure(hr, "Failed while parsing Button images.");
+        break;
+    case THEME_CONTROL_TYPE_IMAGE:
+        hr = ParseOwnerDrawImage(hModule, wzRelativePath, pTheme, pixn, wzElementName, pControl, &pControl->Image.imageRef);
+        ThmExitOnFailure(hr, "Failed while parsing ImageControl image.");
+        break;
+    case THEME_CONTROL_TYPE_PROGRESSBAR:
+        hr = ParseProgressBarImages(hModule, wzRelativePath, pTheme, pixn, pControl);
+        ThmExitOnFailure(hr, "Failed while parsing Progressbar images.");
+        break;
+    default:
+        ThmExitOnUnexpectedAttribute(hr, pixn, wzElementName, L"ImageId");
+        ThmExitOnUnexpectedAttribute(hr, pixn, wzElementName, L"ImageFile");
+        ThmExitOnUnexpectedAttribute(hr, pixn, wzElementName, L"ImageResource");
+        ThmExitOnUnexpectedAttribute(hr, pixn, wzElementName, L"SourceX");
+        ThmExitOnUnexpectedAttribute(hr, pixn, wzElementName, L"SourceY");
+        break;
+    }
+
+
+    hr = GetAttributeFontId(pTheme, pixn, L"FontId", &pControl->dwFontId);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control FontId attribute.");
+
+    // Parse the optional window style.
+    hr = XmlGetAttributeNumberBase(pixn, L"HexStyle", 16, &pControl->dwStyle);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control HexStyle attribute.");
+
+    // Parse the tabstop bit "shortcut nomenclature", this could have been set with the style above.
+    hr = XmlGetYesNoAttribute(pixn, L"TabStop", &fValue);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control TabStop attribute.");
+
+    if (fXmlFound && fValue)
+    {
+        pControl->dwStyle |= WS_TABSTOP;
+    }
+
+    hr = XmlGetYesNoAttribute(pixn, L"Visible", &fValue);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control Visible attribute.");
+
+    if (fXmlFound && fValue)
+    {
+        pControl->dwStyle |= WS_VISIBLE;
+    }
+
+    hr = XmlGetYesNoAttribute(pixn, L"HideWhenDisabled", &fValue);
+    ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control HideWhenDisabled attribute.");
+
+    if (fXmlFound && fValue)
+    {
+        pControl->dwInternalStyle |= INTERNAL_CONTROL_STYLE_HIDE_WHEN_DISABLED;
+    }
+
+    hr = ParseActions(pixn, pControl);
+    ThmExitOnFailure(hr, "Failed to parse action nodes of the control.");
+
+    hr = ParseText(pixn, pControl, &fAnyTextChildren);
+    ThmExitOnFailure(hr, "Failed to parse text nodes of the control.");
+
+    hr = ParseTooltips(pixn, pControl, &fAnyTextChildren);
+    ThmExitOnFailure(hr, "Failed to parse control Tooltip.");
+
+    if (THEME_CONTROL_TYPE_COMMANDLINK == pControl->type)
+    {
+        hr = ParseNotes(pixn, pControl, &fAnyNoteChildren);
+        ThmExitOnFailure(hr, "Failed to parse note text nodes of the control.");
+    }
+
+    if (!fAnyTextChildren && !fAnyNoteChildren)
+    {
+        hr = XmlGetAttributeUInt32(pixn, L"StringId", &dwValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control StringId attribute.");
+
+        if (fXmlFound)
+        {
+            pControl->uStringId = dwValue;
+        }
+        else
+        {
+            // Billboards and panels have child elements and we don't want to pick up child element text in the parents.
+            if (THEME_CONTROL_TYPE_BILLBOARD != pControl->type && THEME_CONTROL_TYPE_PANEL != pControl->type)
+            {
+                hr = XmlGetText(pixn, &bstrText);
+                ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get control inner text.");
+
+                if (fXmlFound)
+                {
+                    hr = StrAllocString(&pControl->sczText, bstrText, 0);
+                    ThmExitOnFailure(hr, "Failed to copy control text.");
+
+                    ReleaseNullBSTR(bstrText);
+                }
+            }
+        }
+    }
+
+    if (THEME_CONTROL_TYPE_BILLBOARD == pControl->type)
+    {
+        hr = XmlGetYesNoAttribute(pixn, L"Loop", &pControl->fBillboardLoops);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying Billboard/@Loop attribute.");
+
+        hr = XmlGetAttributeUInt16(pixn, L"Interval", &pControl->wBillboardInterval);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying Billboard/@Interval attribute.");
+
+        if (!pControl->wBillboardInterval)
+        {
+            pControl->wBillboardInterval = 5000;
+        }
+
+        hr = ParseBillboardPanels(hModule, wzRelativePath, pixn, pTheme, pControl, pPage);
+        ThmExitOnFailure(hr, "Failed to parse billboard children.");
+    }
+    else if (THEME_CONTROL_TYPE_EDITBOX == pControl->type)
+    {
+        hr = XmlGetYesNoAttribute(pixn, L"FileSystemAutoComplete", &fValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying Editbox/@FileSystemAutoComplete attribute.");
+
+        if (fXmlFound && fValue)
+        {
+            pControl->dwInternalStyle |= INTERNAL_CONTROL_STYLE_FILESYSTEM_AUTOCOMPLETE;
+        }
+    }
+    else if (THEME_CONTROL_TYPE_HYPERLINK == pControl->type || THEME_CONTROL_TYPE_BUTTON == pControl->type)
+    {
+        hr = GetAttributeFontId(pTheme, pixn, L"HoverFontId", &pControl->dwFontHoverId);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control HoverFontId attribute.");
+
+        hr = GetAttributeFontId(pTheme, pixn, L"SelectedFontId", &pControl->dwFontSelectedId);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying control SelectedFontId attribute.");
+    }
+    else if (THEME_CONTROL_TYPE_LABEL == pControl->type)
+    {
+        hr = XmlGetYesNoAttribute(pixn, L"Center", &fValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying Label/@Center attribute.");
+
+        if (fXmlFound && fValue)
+        {
+            pControl->dwStyle |= SS_CENTER;
+        }
+
+        hr = XmlGetYesNoAttribute(pixn, L"DisablePrefix", &fValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying Label/@DisablePrefix attribute.");
+
+        if (fXmlFound && fValue)
+        {
+            pControl->dwStyle |= SS_NOPREFIX;
+        }
+    }
+    else if (THEME_CONTROL_TYPE_LISTVIEW == pControl->type)
+    {
+        // Parse the optional extended window style.
+        hr = XmlGetAttributeNumberBase(pixn, L"HexExtendedStyle", 16, &pControl->dwExtendedStyle);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying ListView/@HexExtendedStyle attribute.");
+
+        hr = XmlGetAttribute(pixn, L"ImageList", &bstrText);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying ListView/@ImageList attribute.");
+
+        if (fXmlFound)
+        {
+            hr = FindImageList(pTheme, bstrText, &pControl->ListView.rghImageList[0]);
+            ThmExitOnFailure(hr, "Failed to find image list %ls while setting ImageList for ListView.", bstrText);
+        }
+
+        hr = XmlGetAttribute(pixn, L"ImageListSmall", &bstrText);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying ListView/@ImageListSmall attribute.");
+
+        if (fXmlFound)
+        {
+            hr = FindImageList(pTheme, bstrText, &pControl->ListView.rghImageList[1]);
+            ThmExitOnFailure(hr, "Failed to find image list %ls while setting ImageListSmall for ListView.", bstrText);
+        }
+
+        hr = XmlGetAttribute(pixn, L"ImageListState", &bstrText);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying ListView/@ImageListState attribute.");
+
+        if (fXmlFound)
+        {
+            hr = FindImageList(pTheme, bstrText, &pControl->ListView.rghImageList[2]);
+            ThmExitOnFailure(hr, "Failed to find image list %ls while setting ImageListState for ListView.", bstrText);
+        }
+
+        hr = XmlGetAttribute(pixn, L"ImageListGroupHeader", &bstrText);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying ListView/@ImageListGroupHeader attribute.");
+
+        if (fXmlFound)
+        {
+            hr = FindImageList(pTheme, bstrText, &pControl->ListView.rghImageList[3]);
+            ThmExitOnFailure(hr, "Failed to find image list %ls while setting ImageListGroupHeader for ListView.", bstrText);
+        }
+
+        hr = ParseColumns(pixn, pControl);
+        ThmExitOnFailure(hr, "Failed to parse columns.");
+    }
+    else if (THEME_CONTROL_TYPE_PANEL == pControl->type)
+    {
+        hr = ParseControls(hModule, wzRelativePath, pixn, pTheme, pControl, pPage);
+        ThmExitOnFailure(hr, "Failed to parse panel children.");
+    }
+    else if (THEME_CONTROL_TYPE_RADIOBUTTON == pControl->type)
+    {
+        hr = XmlGetAttributeEx(pixn, L"Value", &pControl->sczValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying RadioButton/@Value attribute.");
+    }
+    else if (THEME_CONTROL_TYPE_TAB == pControl->type)
+    {
+        hr = ParseTabs(pixn, pControl);
+        ThmExitOnFailure(hr, "Failed to parse tabs");
+    }
+    else if (THEME_CONTROL_TYPE_TREEVIEW == pControl->type)
+    {
+        pControl->dwStyle |= TVS_DISABLEDRAGDROP;
+
+        hr = XmlGetYesNoAttribute(pixn, L"EnableDragDrop", &fValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying TreeView/@EnableDragDrop attribute.");
+
+        if (fXmlFound && fValue)
+        {
+            pControl->dwStyle &= ~TVS_DISABLEDRAGDROP;
+        }
+
+        hr = XmlGetYesNoAttribute(pixn, L"FullRowSelect", &fValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying TreeView/@FullRowSelect attribute.");
+
+        if (fXmlFound && fValue)
+        {
+            pControl->dwStyle |= TVS_FULLROWSELECT;
+        }
+
+        hr = XmlGetYesNoAttribute(pixn, L"HasButtons", &fValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying TreeView/@HasButtons attribute.");
+
+        if (fXmlFound && fValue)
+        {
+            pControl->dwStyle |= TVS_HASBUTTONS;
+        }
+
+        hr = XmlGetYesNoAttribute(pixn, L"AlwaysShowSelect", &fValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying TreeView/@AlwaysShowSelect attribute.");
+
+        if (fXmlFound && fValue)
+        {
+            pControl->dwStyle |= TVS_SHOWSELALWAYS;
+        }
+
+        hr = XmlGetYesNoAttribute(pixn, L"LinesAtRoot", &fValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying TreeView/@LinesAtRoot attribute.");
+
+        if (fXmlFound && fValue)
+        {
+            pControl->dwStyle |= TVS_LINESATROOT;
+        }
+
+        hr = XmlGetYesNoAttribute(pixn, L"HasLines", &fValue);
+        ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed when querying TreeView/@HasLines attribute.");
+
+        if (fXmlFound && fValue)
+        {
+            pControl->dwStyle |= TVS_HASLINES;
+        }
+    }
+
+LExit:
+    ReleaseBSTR(bstrText);
+
+    return hr;
+}
+
+static void InitializeThemeControl(
+    THEME* pTheme,
+    THEME_CONTROL* pControl
+    )
+{
+    pControl->dwFontHoverId = THEME_INVALID_ID;
+    pControl->dwFontId = THEME_INVALID_ID;
+    pControl->dwFontSelectedId = THEME_INVALID_ID;
+    pControl->uStringId = UINT_MAX;
+    pControl->pTheme = pTheme;
+}
+
+
+static HRESULT ParseActions(
+    __in IXMLDOMNode* pixn,
+    __in THEME_CONTROL* pControl
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD i = 0;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixnChild = NULL;
+    BSTR bstrType = NULL;
+
+    hr = XmlSelectNodes(pixn, L"BrowseDirectoryAction|ChangePageAction|CloseWindowAction", &pixnl);
+    ThmExitOnFailure(hr, "Failed to select child action nodes.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&pControl->cActions));
+    ThmExitOnFailure(hr, "Failed to count the number of action nodes.");
+
+    if (0 < pControl->cActions)
+    {
+        MemAllocArray(reinterpret_cast<LPVOID*>(&pControl->rgActions), sizeof(THEME_ACTION), pControl->cActions);
+        ThmExitOnNull(pControl->rgActions, hr, E_OUTOFMEMORY, "Failed to allocate THEME_ACTION structs.");
+
+        i = 0;
+        while (S_OK == (hr = XmlNextElement(pixnl, &pixnChild, &bstrType)))
+        {
+            if (!bstrType)
+            {
+                hr = E_UNEXPECTED;
+                ThmExitOnFailure(hr, "Null element encountered!");
+            }
+
+            THEME_ACTION* pAction = pControl->rgActions + i;
+
+            if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"BrowseDirectoryAction", -1))
+            {
+                pAction->type = THEME_ACTION_TYPE_BROWSE_DIRECTORY;
+
+                hr = XmlGetAttributeEx(pixnChild, L"VariableName", &pAction->BrowseDirectory.sczVariableName);
+                ThmExitOnFailure(hr, "Failed when querying BrowseDirectoryAction/@VariableName attribute.");
+            }
+            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"ChangePageAction", -1))
+            {
+                pAction->type = THEME_ACTION_TYPE_CHANGE_PAGE;
+
+                hr = XmlGetAttributeEx(pixnChild, L"Page", &pAction->ChangePage.sczPageName);
+                ThmExitOnFailure(hr, "Failed when querying ChangePageAction/@Page attribute.");
+
+                hr = XmlGetYesNoAttribute(pixnChild, L"Cancel", &pAction->ChangePage.fCancel);
+                if (E_NOTFOUND != hr)
+                {
+                    ThmExitOnFailure(hr, "Failed when querying ChangePageAction/@Cancel attribute.");
+                }
+            }
+            else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, bstrType, -1, L"CloseWindowAction", -1))
+            {
+                pAction->type = THEME_ACTION_TYPE_CLOSE_WINDOW;
+            }
+            else
+            {
+                hr = E_UNEXPECTED;
+                ThmExitOnFailure(hr, "Unexpected element encountered: %ls", bstrType);
+            }
+
+            hr = XmlGetAttributeEx(pixnChild, L"Condition", &pAction->sczCondition);
+            if (E_NOTFOUND != hr)
+            {
+                ThmExitOnFailure(hr, "Failed when querying %ls/@Condition attribute.", bstrType);
+            }
+
+            if (!pAction->sczCondition)
+            {
+                if (pControl->pDefaultAction)
+                {
+                    hr = E_INVALIDDATA;
+                    ThmExitOnFailure(hr, "Control '%ls' has multiple actions without a condition.", pControl->sczName);
+                }
+
+                pControl->pDefaultAction = pAction;
+            }
+
+            ++i;
+            ReleaseNullBSTR(bstrType);
+            ReleaseObject(pixnChild);
+        }
+    }
+
+LExit:
+    ReleaseObject(pixnl);
+    ReleaseObject(pixnChild);
+    ReleaseBSTR(bstrType);
+
+    return hr;
+}
+
+
+static HRESULT ParseBillboardPanels(
+    __in_opt HMODULE hModule,
+    __in_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pElement,
+    __in THEME* pTheme,
+    __in THEME_CONTROL* pParentControl,
+    __in_opt THEME_PAGE* pPage
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixnChild = NULL;
+    DWORD dwValue = 0;
+    THEME_CONTROL* pControl = NULL;
+
+    hr = XmlSelectNodes(pElement, L"BillboardPanel", &pixnl);
+    ThmExitOnFailure(hr, "Failed to select child billboard panel nodes.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&dwValue));
+    ThmExitOnFailure(hr, "Failed to count the number of billboard panel nodes.");
+
+    if (!dwValue)
+    {
+        ThmExitWithRootFailure(hr, E_INVALIDDATA, "Billboard must have at least one BillboardPanel.");
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pParentControl->rgControls), pParentControl->cControls, dwValue, sizeof(THEME_CONTROL), 0);
+    ThmExitOnFailure(hr, "Failed to ensure theme control array size for BillboardPanels.");
+
+    while (S_OK == (hr = XmlNextElement(pixnl, &pixnChild, NULL)))
+    {
+        pControl = pParentControl->rgControls + pParentControl->cControls;
+        pParentControl->cControls += 1;
+        pControl->type = THEME_CONTROL_TYPE_PANEL;
+        InitializeThemeControl(pTheme, pControl);
+
+        if (pPage)
+        {
+            pControl->wPageId = pPage->wId;
+        }
+
+        hr = ParseControls(hModule, wzRelativePath, pixnChild, pTheme, pControl, pPage);
+        ThmExitOnFailure(hr, "Failed to parse control.");
+
+        ReleaseNullObject(pixnChild);
+    }
+
+LExit:
+    ReleaseObject(pixnl);
+    ReleaseObject(pixnChild);
+
+    return hr;
+}
+
+
+static HRESULT ParseColumns(
+    __in IXMLDOMNode* pixn,
+    __in THEME_CONTROL* pControl
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD i = 0;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixnChild = NULL;
+    BSTR bstrText = NULL;
+    int nValue = 0;
+    BOOL fXmlFound = FALSE;
+
+    hr = XmlSelectNodes(pixn, L"Column", &pixnl);
+    ThmExitOnFailure(hr, "Failed to select child column nodes.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&pControl->ListView.cColumns));
+    ThmExitOnFailure(hr, "Failed to count the number of control columns.");
+
+    if (0 < pControl->ListView.cColumns)
+    {
+        hr = MemAllocArray(reinterpret_cast<LPVOID*>(&pControl->ListView.ptcColumns), sizeof(THEME_COLUMN), pControl->ListView.cColumns);
+        ThmExitOnFailure(hr, "Failed to allocate column structs.");
+
+        i = 0;
+        while (S_OK == (hr = XmlNextElement(pixnl, &pixnChild, NULL)))
+        {
+            THEME_COLUMN* pColumn = pControl->ListView.ptcColumns + i;
+
+            hr = XmlGetText(pixnChild, &bstrText);
+            ThmExitOnFailure(hr, "Failed to get inner text of column element.");
+
+            hr = GetAttributeCoordinateOrDimension(pixnChild, L"Width", &nValue);
+            ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get column width attribute.");
+
+            if (!fXmlFound)
+            {
+                nValue = 100;
+            }
+
+            pColumn->nBaseWidth = pColumn->nDefaultDpiBaseWidth = nValue;
+
+            hr = XmlGetYesNoAttribute(pixnChild, L"Expands", &pColumn->fExpands);
+            ThmExitOnOptionalXmlQueryFailure(hr, fXmlFound, "Failed to get expands attribute.");
+
+            hr = StrAllocString(&pColumn->pszName, bstrText, 0);
+            ThmExitOnFailure(hr, "Failed to copy column name.");
+
+            ++i;
+            ReleaseNullBSTR(bstrText);
+            ReleaseNullObject(pixnChild);
+        }
+    }
+
+LExit:
+    ReleaseObject(pixnl);
+    ReleaseObject(pixnChild);
+    ReleaseBSTR(bstrText);
+
+    return hr;
+}
+
+
+static HRESULT ParseRadioButtons(
+    __in_opt HMODULE hModule,
+    __in_opt LPCWSTR wzRelativePath,
+    __in IXMLDOMNode* pixn,
+    __in THEME* pTheme,
+    __in_opt THEME_CONTROL* pParentControl,
+    __in THEME_PAGE* pPage
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cRadioButtons = 0;
+    IXMLDOMNodeList* pixnlRadioButtons = NULL;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixnRadioButtons = NULL;
+    IXMLDOMNode* pixnChild = NULL;
+    LPWSTR sczName = NULL;
+    THEME_CONTROL* pControl = NULL;
+    BOOL fFirst = FALSE;
+    DWORD* pcControls = NULL;
+    THEME_CONTROL** prgControls = NULL;
+
+    GetControls(pTheme, pParentControl, &pcControls, &prgControls);
+
+    hr = XmlSelectNodes(pixn, L"RadioButtons", &pixnlRadioButtons);
+    ThmExitOnFailure(hr, "Failed to select RadioButtons nodes.");
+
+    while (S_OK == (hr = XmlNextElement(pixnlRadioButtons, &pixnRadioButtons, NULL)))
+    {
+        hr = XmlGetAttributeEx(pixnRadioButtons, L"Name", &sczName);
+        if (E_NOTFOUND == hr)
+        {
+            hr = S_OK;
+        }
+        ThmExitOnFailure(hr, "Failed when querying RadioButtons Name.");
+
+        hr = XmlSelectNodes(pixnRadioButtons, L"RadioButton", &pixnl);
+        ThmExitOnFailure(hr, "Failed to select RadioButton nodes.");
+
+        hr = pixnl->get_length(reinterpret_cast<long*>(&cRadioButtons));
+        ThmExitOnFailure(hr, "Failed to count the number of RadioButton nodes.");
+
+        if (!cRadioButtons)
+        {
+            ThmExitWithRootFailure(hr, E_INVALIDDATA, "RadioButtons must have at least one RadioButton.");
+        }
+
+        if (pPage)
+        {
+            pPage->cControlIndices += cRadioButtons;
+        }
+
+        hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(prgControls), *pcControls, cRadioButtons, sizeof(THEME_CONTROL), 0);
+        ThmExitOnFailure(hr, "Failed to ensure theme control array size for RadioButtons.");
+
+        fFirst = TRUE;
+
+        while (S_OK == (hr = XmlNextElement(pixnl, &pixnChild, NULL)))
+        {
+            pControl = *prgControls + *pcControls;
+            pControl->type = THEME_CONTROL_TYPE_RADIOBUTTON;
+            *pcControls += 1;
+
+            hr = ParseControl(hModule, wzRelativePath, pixnChild, L"RadioButton", pTheme, pControl, pPage);
+            ThmExitOnFailure(hr, "Failed to parse control.");
+
+            if (fFirst)
+            {
+                pControl->dwStyle |= WS_GROUP;
+                fFirst = FALSE;
+            }
+
+            hr = StrAllocString(&pControl->sczVariable, sczName, 0);
+            ThmExitOnFailure(hr, "Failed to copy radio button variable.");
+
+            if (pPage)
+            {
+                pControl->wPageId = pPage->wId;
+            }
+
+            ReleaseNullObject(pixnChild);
+        }
+
+        if (!fFirst)
+        {
+            pControl->fLastRadioButton = TRUE;
+        }
+
+        ReleaseObject(pixnl);
+        ReleaseObject(pixnRadioButtons);
+    }
+
+LExit:
+    ReleaseStr(sczName);
+    ReleaseObject(pixnl);
+    ReleaseObject(pixnChild);
+    ReleaseObject(pixnlRadioButtons);
+    ReleaseObject(pixnRadioButtons);
+
+    return hr;
+}
+
+
+static HRESULT ParseTabs(
+    __in IXMLDOMNode* pixn,
+    __in THEME_CONTROL* pControl
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD i = 0;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixnChild = NULL;
+    BSTR bstrText = NULL;
+
+    hr = XmlSelectNodes(pixn, L"Tab", &pixnl);
+    ThmExitOnFailure(hr, "Failed to select child tab nodes.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&pControl->cTabs));
+    ThmExitOnFailure(hr, "Failed to count the number of tabs.");
+
+    if (0 < pControl->cTabs)
+    {
+        hr = MemAllocArray(reinterpret_cast<LPVOID*>(&pControl->pttTabs), sizeof(THEME_TAB), pControl->cTabs);
+        ThmExitOnFailure(hr, "Failed to allocate tab structs.");
+
+        i = 0;
+        while (S_OK == (hr = XmlNextElement(pixnl, &pixnChild, NULL)))
+        {
+            hr = XmlGetText(pixnChild, &bstrText);
+            ThmExitOnFailure(hr, "Failed to get inner text of tab element.");
+
+            hr = StrAllocString(&(pControl->pttTabs[i].pszName), bstrText, 0);
+            ThmExitOnFailure(hr, "Failed to copy tab name.");
+
+            ++i;
+            ReleaseNullBSTR(bstrText);
+        }
+    }
+
+LExit:
+    ReleaseObject(pixnl);
+    ReleaseObject(pixnChild);
+    ReleaseBSTR(bstrText);
+
+    return hr;
+}
+
+
+static HRESULT ParseText(
+    __in IXMLDOMNode* pixn,
+    __in THEME_CONTROL* pControl,
+    __inout BOOL* pfAnyChildren
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD i = 0;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixnChild = NULL;
+    BSTR bstrText = NULL;
+
+    hr = XmlSelectNodes(pixn, L"Text", &pixnl);
+    ThmExitOnFailure(hr, "Failed to select child Text nodes.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&pControl->cConditionalText));
+    ThmExitOnFailure(hr, "Failed to count the number of Text nodes.");
+
+    *pfAnyChildren |= 0 < pControl->cConditionalText;
+
+    if (0 < pControl->cConditionalText)
+    {
+        MemAllocArray(reinterpret_cast<LPVOID*>(&pControl->rgConditionalText), sizeof(THEME_CONDITIONAL_TEXT), pControl->cConditionalText);
+        ThmExitOnNull(pControl->rgConditionalText, hr, E_OUTOFMEMORY, "Failed to allocate THEME_CONDITIONAL_TEXT structs.");
+
+        i = 0;
+        while (S_OK == (hr = XmlNextElement(pixnl, &pixnChild, NULL)))
+        {
+            THEME_CONDITIONAL_TEXT* pConditionalText = pControl->rgConditionalText + i;
+
+            hr = XmlGetAttributeEx(pixnChild, L"Condition", &pConditionalText->sczCondition);
+            if (E_NOTFOUND == hr)
+            {
+                hr = S_OK;
+            }
+            ThmExitOnFailure(hr, "Failed when querying Text/@Condition attribute.");
+
+            hr = XmlGetText(pixnChild, &bstrText);
+            ThmExitOnFailure(hr, "Failed to get inner text of Text element.");
+
+            if (S_OK == hr)
+            {
+                if (pConditionalText->sczCondition)
+                {
+                    hr = StrAllocString(&pConditionalText->sczText, bstrText, 0);
+                    ThmExitOnFailure(hr, "Failed to copy text to conditional text.");
+
+                    ++i;
+                }
+                else
+                {
+                    if (pControl->sczText)
+                    {
+                        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                        ThmExitOnFailure(hr, "Unconditional text for the '%ls' control is specified multiple times.", pControl->sczName);
+                    }
+
+                    hr = StrAllocString(&pControl->sczText, bstrText, 0);
+                    ThmExitOnFailure(hr, "Failed to copy text to control.");
+
+                    // Unconditional text entries aren't stored in the conditional text list.
+                    --pControl->cConditionalText;
+                }
+            }
+
+            ReleaseNullBSTR(bstrText);
+        }
+    }
+
+LExit:
+    ReleaseObject(pixnl);
+    ReleaseObject(pixnChild);
+    ReleaseBSTR(bstrText);
+
+    return hr;
+}
+
+
+static HRESULT ParseTooltips(
+    __in IXMLDOMNode* pixn,
+    __in THEME_CONTROL* pControl,
+    __inout BOOL* pfAnyChildren
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMNode* pixnChild = NULL;
+    BSTR bstrText = NULL;
+
+    hr = XmlSelectSingleNode(pixn, L"Tooltip", &pixnChild);
+    ThmExitOnFailure(hr, "Failed to select child Tooltip node.");
+
+    if (S_OK == hr)
+    {
+        *pfAnyChildren |= TRUE;
+
+        hr = XmlGetText(pixnChild, &bstrText);
+        ThmExitOnFailure(hr, "Failed to get inner text of Tooltip element.");
+
+        if (S_OK == hr)
+        {
+            hr = StrAllocString(&pControl->sczTooltip, bstrText, 0);
+            ThmExitOnFailure(hr, "Failed to copy tooltip text to control.");
+        }
+    }
+
+LExit:
+    ReleaseObject(pixnChild);
+    ReleaseBSTR(bstrText);
+
+    return hr;
+}
+
+
+static HRESULT ParseUnexpectedAttribute(
+    __in IXMLDOMNode* pixn,
+    __in_z LPCWSTR wzElementName,
+    __in_z LPCWSTR wzAttribute
+    )
+{
+    HRESULT hr = S_OK;
+    BSTR bstr = NULL;
+
+    hr = XmlGetAttribute(pixn, wzAttribute, &bstr);
+    ThmExitOnFailure(hr, "Failed to get attribute %ls/@%ls", wzElementName, wzAttribute);
+
+    if (S_OK == hr)
+    {
+        ThmExitOnRootFailure(hr = E_INVALIDDATA, "Element '%ls' has unexpected attribute '%ls', value: %ls.", wzElementName, wzAttribute, bstr);
+    }
+
+    hr = S_OK;
+
+LExit:
+    ReleaseBSTR(bstr);
+
+    return hr;
+}
+
+
+static HRESULT ParseNotes(
+    __in IXMLDOMNode* pixn,
+    __in THEME_CONTROL* pControl,
+    __out BOOL* pfAnyChildren
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD i = 0;
+    IXMLDOMNodeList* pixnl = NULL;
+    IXMLDOMNode* pixnChild = NULL;
+    BSTR bstrText = NULL;
+
+    hr = XmlSelectNodes(pixn, L"Note", &pixnl);
+    ThmExitOnFailure(hr, "Failed to select child Note nodes.");
+
+    hr = pixnl->get_length(reinterpret_cast<long*>(&pControl->CommandLink.cConditionalNotes));
+    ThmExitOnFailure(hr, "Failed to count the number of Note nodes.");
+
+    if (pfAnyChildren)
+    {
+        *pfAnyChildren = 0 < pControl->CommandLink.cConditionalNotes;
+    }
+
+    if (0 < pControl->CommandLink.cConditionalNotes)
+    {
+        MemAllocArray(reinterpret_cast<LPVOID*>(&pControl->CommandLink.rgConditionalNotes), sizeof(THEME_CONDITIONAL_TEXT), pControl->CommandLink.cConditionalNotes);
+        ThmExitOnNull(pControl->CommandLink.rgConditionalNotes, hr, E_OUTOFMEMORY, "Failed to allocate note THEME_CONDITIONAL_TEXT structs.");
+
+        i = 0;
+        while (S_OK == (hr = XmlNextElement(pixnl, &pixnChild, NULL)))
+        {
+            THEME_CONDITIONAL_TEXT* pConditionalNote = pControl->CommandLink.rgConditionalNotes + i;
+
+            hr = XmlGetAttributeEx(pixnChild, L"Condition", &pConditionalNote->sczCondition);
+            if (E_NOTFOUND == hr)
+            {
+                hr = S_OK;
+            }
+            ThmExitOnFailure(hr, "Failed when querying Note/@Condition attribute.");
+
+            hr = XmlGetText(pixnChild, &bstrText);
+            ThmExitOnFailure(hr, "Failed to get inner text of Note element.");
+
+            if (S_OK == hr)
+            {
+                if (pConditionalNote->sczCondition)
+                {
+                    hr = StrAllocString(&pConditionalNote->sczText, bstrText, 0);
+                    ThmExitOnFailure(hr, "Failed to copy text to conditional note text.");
+
+                    ++i;
+                }
+                else
+                {
+                    if (pControl->sczNote)
+                    {
+                        hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+                        ThmExitOnFailure(hr, "Unconditional note text for the '%ls' control is specified multiple times.", pControl->sczName);
+                    }
+
+                    hr = StrAllocString(&pControl->sczNote, bstrText, 0);
+                    ThmExitOnFailure(hr, "Failed to copy text to command link control.");
+
+                    // Unconditional note entries aren't stored in the conditional notes list.
+                    --pControl->CommandLink.cConditionalNotes;
+                }
+            }
+
+            ReleaseNullBSTR(bstrText);
+        }
+    }
+
+LExit:
+    ReleaseObject(pixnl);
+    ReleaseObject(pixnChild);
+    ReleaseBSTR(bstrText);
+
+    return hr;
+}
+
+
+static HRESULT StartBillboard(
+    __in THEME* pTheme,
+    __in THEME_CONTROL* pControl
+    )
+{
+    HRESULT hr = E_NOTFOUND;
+    UINT_PTR idEvent = reinterpret_cast<UINT_PTR>(pControl);
+
+    if (THEME_CONTROL_TYPE_BILLBOARD == pControl->type)
+    {
+        // kick off
+        pControl->dwData = 0;
+        OnBillboardTimer(pTheme, pTheme->hwndParent, idEvent);
+
+        if (!::SetTimer(pTheme->hwndParent, idEvent, pControl->wBillboardInterval, NULL))
+        {
+            ThmExitWithLastError(hr, "Failed to start billboard.");
+        }
+
+        hr = S_OK;
+    }
+
+LExit:
+    return hr;
+}
+
+
+static HRESULT StopBillboard(
+    __in THEME* pTheme,
+    __in THEME_CONTROL* pControl
+    )
+{
+    HRESULT hr = E_NOTFOUND;
+    UINT_PTR idEvent = reinterpret_cast<UINT_PTR>(pControl);
+
+    if (THEME_CONTROL_TYPE_BILLBOARD == pControl->type)
+    {
+        ThemeControlEnable(pControl, FALSE);
+
+        if (::KillTimer(pTheme->hwndParent, idEvent))
+        {
+            hr = S_OK;
+        }
+    }
+
+    return hr;
+}
+
+static HRESULT EnsureFontInstance(
+    __in THEME* pTheme,
+    __in THEME_FONT* pFont,
+    __out THEME_FONT_INSTANCE** ppFontInstance
+    )
+{
+    HRESULT hr = S_OK;
+    THEME_FONT_INSTANCE* pFontInstance = NULL;
+    LOGFONTW lf = { };
+
+    for (DWORD i = 0; i < pFont->cFontInstances; ++i)
+    {
+        pFontInstance = pFont->rgFontInstances + i;
+        if (pTheme->nDpi == pFontInstance->nDpi)
+        {
+            *ppFontInstance = pFontInstance;
+            ExitFunction();
+        }
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pFont->rgFontInstances), pFont->cFontInstances, 1, sizeof(THEME_FONT_INSTANCE), GROW_FONT_INSTANCES);
+    ThmExitOnFailure(hr, "Failed to allocate memory for font instances.");
+
+    pFontInstance = pFont->rgFontInstances + pFont->cFontInstances;
+    pFontInstance->nDpi = pTheme->nDpi;
+
+    lf.lfHeight = DpiuScaleValue(pFont->lfHeight, pFontInstance->nDpi);
+    lf.lfWeight = pFont->lfWeight;
+    lf.lfUnderline = pFont->lfUnderline;
+    lf.lfQuality = pFont->lfQuality;
+
+    hr = ::StringCchCopyW(lf.lfFaceName, countof(lf.lfFaceName), pFont->sczFaceName);
+    ThmExitOnFailure(hr, "Failed to copy font name to create font.");
+
+    pFontInstance->hFont = ::CreateFontIndirectW(&lf);
+    ThmExitOnNull(pFontInstance->hFont, hr, E_OUTOFMEMORY, "Failed to create DPI specific font.");
+
+    ++pFont->cFontInstances;
+    *ppFontInstance = pFontInstance;
+
+LExit:
+    return hr;
+}
+
+
+static HRESULT FindImageList(
+    __in THEME* pTheme,
+    __in_z LPCWSTR wzImageListName,
+    __out HIMAGELIST *phImageList
+    )
+{
+    HRESULT hr = S_OK;
+
+    for (DWORD i = 0; i < pTheme->cImageLists; ++i)
+    {
+        if (CSTR_EQUAL == ::CompareStringW(LOCALE_NEUTRAL, 0, pTheme->rgImageLists[i].sczName, -1, wzImageListName, -1))
+        {
+            *phImageList = pTheme->rgImageLists[i].hImageList;
+            ExitFunction1(hr = S_OK);
+        }
+    }
+
+    hr = E_NOTFOUND;
+
+LExit:
+    return hr;
+}
+
+
+static HRESULT DrawButton(
+    __in THEME* pTheme,
+    __in DRAWITEMSTRUCT* pdis,
+    __in const THEME_CONTROL* pControl
+    )
+{
+    HRESULT hr = S_OK;
+    const THEME_IMAGE_REFERENCE* pImageRef = NULL;
+    BOOL fDrawFocusRect = FALSE;
+    int nHeight = pdis->rcItem.bottom - pdis->rcItem.top;
+    int nWidth = pdis->rcItem.right - pdis->rcItem.left;
+
+    // "clicked" gets priority
+    if (ODS_SELECTED & pdis->itemState)
+    {
+        pImageRef = pControl->Button.rgImageRef + 2;
+    }
+    // then hover
+    else if (pControl->dwData & THEME_CONTROL_DATA_HOVER)
+    {
+        pImageRef = pControl->Button.rgImageRef + 1;
+    }
+    // then focused
+    else if ((WS_TABSTOP & ::GetWindowLongPtrW(pdis->hwndItem, GWL_STYLE)) && (ODS_FOCUS & pdis->itemState))
+    {
+        if (THEME_IMAGE_REFERENCE_TYPE_NONE != pControl->Button.rgImageRef[3].type)
+        {
+            pImageRef = pControl->Button.rgImageRef + 3;
+        }
+        else
+        {
+            fDrawFocusRect = TRUE;
+            pImageRef = pControl->Button.rgImageRef;
+        }
+    }
+    else
+    {
+        pImageRef = pControl->Button.rgImageRef;
+    }
+
+    hr = DrawImageReference(pTheme, pImageRef, pControl->wPageId, pdis->hDC, 0, 0, nWidth, nHeight);
+
+    DrawControlText(pTheme, pdis, pControl, TRUE, fDrawFocusRect);
+
+    return hr;
+}
+
+
+static HRESULT DrawHyperlink(
+    __in THEME* pTheme,
+    __in DRAWITEMSTRUCT* pdis,
+    __in const THEME_CONTROL* pControl
+    )
+{
+    DrawControlText(pTheme, pdis, pControl, FALSE, TRUE);
+    return S_OK;
+}
+
+
+static void DrawControlText(
+    __in THEME* pTheme,
+    __in DRAWITEMSTRUCT* pdis,
+    __in const THEME_CONTROL* pControl,
+    __in BOOL fCentered,
+    __in BOOL fDrawFocusRect
+    )
+{
+    HRESULT hr = S_OK;
+    WCHAR wzText[256] = { };
+    THEME_FONT* pFont = NULL;
+    THEME_FONT_INSTANCE* pFontInstance = NULL;
+    HFONT hfPrev = NULL;
+    DWORD cchText = ::GetWindowTextW(pdis->hwndItem, wzText, countof(wzText));
+
+    if (cchText)
+    {
+        if (ODS_SELECTED & pdis->itemState)
+        {
+            pFont = pTheme->rgFonts + (THEME_INVALID_ID != pControl->dwFontSelectedId ? pControl->dwFontSelectedId : pControl->dwFontId);
+        }
+        else if (pControl->dwData & THEME_CONTROL_DATA_HOVER)
+        {
+            pFont = pTheme->rgFonts + (THEME_INVALID_ID != pControl->dwFontHoverId ? pControl->dwFontHoverId : pControl->dwFontId);
+        }
+        else
+        {
+            pFont = pTheme->rgFonts + pControl->dwFontId;
+        }
+
+        hr = EnsureFontInstance(pTheme, pFont, &pFontInstance);
+        if (SUCCEEDED(hr))
+        {
+            hfPrev = SelectFont(pdis->hDC, pFontInstance->hFont);
+        }
+
+        ::DrawTextExW(pdis->hDC, wzText, cchText, &pdis->rcItem, DT_SINGLELINE | (fCentered ? (DT_CENTER | DT_VCENTER) : 0), NULL);
+
+        if (hfPrev)
+        {
+            SelectFont(pdis->hDC, hfPrev);
+        }
+    }
+
+    if (fDrawFocusRect && (WS_TABSTOP & ::GetWindowLongPtrW(pdis->hwndItem, GWL_STYLE)) && (ODS_FOCUS & pdis->itemState))
+    {
+        ::DrawFocusRect(pdis->hDC, &pdis->rcItem);
+    }
+}
+
+
+static HRESULT DrawImage(
+    __in THEME* pTheme,
+    __in DRAWITEMSTRUCT* pdis,
+    __in const THEME_CONTROL* pControl
+    )
+{
+    HRESULT hr = S_OK;
+    int nHeight = pdis->rcItem.bottom - pdis->rcItem.top;
+    int nWidth = pdis->rcItem.right - pdis->rcItem.left;
+
+    hr = DrawImageReference(pTheme, &pControl->Image.imageRef, pControl->wPageId, pdis->hDC, 0, 0, nWidth, nHeight);
+
+    return hr;
+}
+
+static void GetImageInstance(
+    __in THEME* pTheme,
+    __in const THEME_IMAGE_REFERENCE* pReference,
+    __out THEME_IMAGE_INSTANCE** ppInstance
+    )
+{
+    switch (pReference->type)
+    {
+    case THEME_IMAGE_REFERENCE_TYPE_PARTIAL:
+    case THEME_IMAGE_REFERENCE_TYPE_COMPLETE:
+        if (THEME_INVALID_ID == pReference->dwImageIndex)
+        {
+            *ppInstance = pTheme->rgStandaloneImages + pReference->dwImageInstanceIndex;
+        }
+        else
+        {
+            THEME_IMAGE* pImage = pTheme->rgImages + pReference->dwImageIndex;
+            *ppInstance = pImage->rgImageInstances + pReference->dwImageInstanceIndex;
+        }
+        break;
+    default:
+        *ppInstance = NULL;
+        break;
+    }
+}
+
+static HRESULT DrawImageReference(
+    __in THEME* pTheme,
+    __in const THEME_IMAGE_REFERENCE* pReference,
+    __in DWORD dwPageId,
+    __in HDC hdc,
+    __in int destX,
+    __in int destY,
+    __in int destWidth,
+    __in int destHeight
+    )
+{
+    HRESULT hr = S_OK;
+    THEME_IMAGE_INSTANCE* pImageInstance = NULL;
+    THEME_SCALED_IMAGE* pScaledImage = NULL;
+    int nX = 0;
+    int nY = 0;
+    int nWidth = 0;
+    int nHeight = 0;
+
+    GetImageInstance(pTheme, pReference, &pImageInstance);
+    ExitOnNull(pImageInstance, hr, E_INVALIDARG, "Invalid image reference for drawing.");
+
+    switch (pReference->type)
+    {
+    case THEME_IMAGE_REFERENCE_TYPE_PARTIAL:
+        nX = pReference->nX;
+        nY = pReference->nY;
+        nWidth = pReference->nWidth;
+        nHeight = pReference->nHeight;
+        break;
+    case THEME_IMAGE_REFERENCE_TYPE_COMPLETE:
+        nX = 0;
+        nY = 0;
+        nWidth = pImageInstance->nWidth;
+        nHeight = pImageInstance->nHeight;
+        break;
+    default:
+        ExitFunction1(hr = E_INVALIDARG); // This should be unreachable because GetImageInstance should have returned null.
+    }
+
+    if (0 >= destWidth || 0 >= destHeight)
+    {
+        ExitFunction1(hr = S_FALSE);
+    }
+
+    hr = GetScaledImage(pTheme, pImageInstance, dwPageId, nX, nY, nWidth, nHeight, destWidth, destHeight, &pScaledImage);
+    ThmExitOnFailure(hr, "Failed to get scaled image.");
+
+    hr = DrawScaledImage(pScaledImage, hdc, destX, destY);
+
+LExit:
+    return hr;
+}
+
+static HRESULT GetScaledImage(
+    __in THEME* pTheme,
+    __in THEME_IMAGE_INSTANCE* pInstance,
+    __in DWORD dwPageId,
+    __in int srcX,
+    __in int srcY,
+    __in int srcWidth,
+    __in int srcHeight,
+    __in int destWidth,
+    __in int destHeight,
+    __out THEME_SCALED_IMAGE** ppScaledImage
+    )
+{
+    HRESULT hr = S_OK;
+    THEME_SCALED_IMAGE* pScaledImage = NULL;
+    Gdiplus::Bitmap* pBitmap = NULL;
+    Gdiplus::Status gs = Gdiplus::Status::Ok;
+
+    for (DWORD i = 0; i < pInstance->cScaledImages; ++i)
+    {
+        THEME_SCALED_IMAGE* pCandidate = pInstance->rgScaledImages + i;
+
+        if (pCandidate->nSourceX == srcX && pCandidate->nSourceY == srcY && pCandidate->nSourceWidth == srcWidth && pCandidate->nSourceHeight == srcHeight &&
+            pCandidate->nDpi == pTheme->nDpi && pCandidate->nWidth == destWidth && pCandidate->nHeight == destHeight)
+        {
+            // Scaled images shared with the always visible page 0 are never evicted with a page.
+            if (pCandidate->dwPageId)
+            {
+                pCandidate->dwPageId = dwPageId;
+            }
+
+            pCandidate->dwLastUsed = ++pTheme->dwScaledImageUse;
+
+            *ppScaledImage = pCandidate;
+            ExitFunction();
+        }
+    }
+
+    hr = LoadImageInstance(pInstance, dwPageId);
+    ThmExitOnFailure(hr, "Failed to load image for scaling.");
+
+    pBitmap = new Gdiplus::Bitmap(destWidth, destHeight, PixelFormat32bppPARGB);
+    ThmExitOnNull(pBitmap, hr, E_OUTOFMEMORY, "Failed to allocate scaled bitmap.");
+
+    gs = pBitmap->GetLastStatus();
+    ThmExitOnGdipFailure(gs, hr, "Failed to create scaled bitmap.");
+
+    {
+        Gdiplus::Graphics graphics(pBitmap);
+
+        hr = DrawGdipBitmap(&graphics, 0, 0, destWidth, destHeight, pInstance->pBitmap, srcX, srcY, srcWidth, srcHeight);
+        ThmExitOnFailure(hr, "Failed to scale image.");
+    }
+
+    // Other sizes stay cached until an eviction finds they are stale, so controls drawing the
+    // same image at different sizes do not keep rescaling it.
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pInstance->rgScaledImages), pInstance->cScaledImages, 1, sizeof(THEME_SCALED_IMAGE), GROW_SCALED_IMAGES);
+    ThmExitOnFailure(hr, "Failed to allocate memory for scaled images.");
+
+    pScaledImage = pInstance->rgScaledImages + pInstance->cScaledImages;
+    ++pInstance->cScaledImages;
+
+    pScaledImage->nDpi = pTheme->nDpi;
+    pScaledImage->nSourceX = srcX;
+    pScaledImage->nSourceY = srcY;
+    pScaledImage->nSourceWidth = srcWidth;
+    pScaledImage->nSourceHeight = srcHeight;
+    pScaledImage->nWidth = destWidth;
+    pScaledImage->nHeight = destHeight;
+    pScaledImage->dwPageId = dwPageId;
+    pScaledImage->fTransparency = (pInstance->pBitmap->GetFlags() & Gdiplus::ImageFlagsHasAlpha) == Gdiplus::ImageFlagsHasAlpha;
+    pScaledImage->dwCreated = ++pTheme->dwScaledImageUse;
+    pScaledImage->dwLastUsed = pScaledImage->dwCreated;
+    pScaledImage->pBitmap = pBitmap;
+    pBitmap = NULL;
+
+    *ppScaledImage = pScaledImage;
+
+LExit:
+    if (pBitmap)
+    {
+        delete pBitmap;
+    }
+
+    return hr;
+}
+
+static HRESULT DrawScaledImage(
+    __in const THEME_SCALED_IMAGE* pScaledImage,
+    __in HDC hdc,
+    __in int destX,
+    __in int destY
+    )
+{
+    Gdiplus::Rect destRect(destX, destY, pScaledImage->nWidth, pScaledImage->nHeight);
+    Gdiplus::Graphics graphics(hdc);
+    Gdiplus::Status gs = Gdiplus::Status::Ok;
+
+    // The bitmap was already scaled to the destination size so this is a straight copy.
+    graphics.SetInterpolationMode(Gdiplus::InterpolationMode::InterpolationModeNearestNeighbor);
+    graphics.SetPixelOffsetMode(Gdiplus::PixelOffsetMode::PixelOffsetModeHalf);
+
+    if (pScaledImage->fTransparency)
+    {
+        graphics.SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceOver);
+        graphics.SetCompositingQuality(Gdiplus::CompositingQuality::CompositingQualityHighQuality);
+    }
+    else
+    {
+        graphics.SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceCopy);
+        graphics.SetCompositingQuality(Gdiplus::CompositingQuality::CompositingQualityHighSpeed);
+    }
+
+    gs = graphics.DrawImage(pScaledImage->pBitmap, destRect, 0, 0, pScaledImage->nWidth, pScaledImage->nHeight, Gdiplus::Unit::UnitPixel);
+
+    return GdipHresultFromStatus(gs);
+}
+
+static HRESULT DrawGdipBitmap(
+    __in Gdiplus::Graphics* pGraphics,
+    __in int destX,
+    __in int destY,
+    __in int destWidth,
+    __in int destHeight,
+    __in Gdiplus::Bitmap* pBitmap,
+    __in int srcX,
+    __in int srcY,
+    __in int srcWidth,
+    __in int srcHeight
+    )
+{
+    // Note that this only indicates that GDI+ supports transparency from the source image type.
+    // Bitmaps with alpha information will return FALSE, while fully opaque PNGs will return TRUE.
+    BOOL fTransparency = (pBitmap->GetFlags() & Gdiplus::ImageFlagsHasAlpha) == Gdiplus::ImageFlagsHasAlpha;
+    Gdiplus::ImageAttributes attrs;
+    Gdiplus::Rect destRect(destX, destY, destWidth, destHeight);
+    Gdiplus::Status gs = Gdiplus::Status::Ok;
+
+    // This fixes GDI+ behavior where it badly handles the edges of an image when scaling.
+    // This is easily seen when using an image Progressbar that's 4x1 - the progress bar fades to transparent in both directions.
+    attrs.SetWrapMode(Gdiplus::WrapMode::WrapModeTileFlipXY);
+
+    // graphics.SmoothingMode is not set because it has no impact on DrawImage.
+
+    // This is the best interpolation mode, and the only one that is decent at downscaling.
+    pGraphics->SetInterpolationMode(Gdiplus::InterpolationMode::InterpolationModeHighQualityBicubic);
+
+    // There's a significant quality improvement when scaling to use the HighQuality pixel offset mode with no measurable difference in performance.
+    pGraphics->SetPixelOffsetMode(Gdiplus::PixelOffsetMode::PixelOffsetModeHighQuality);
+
+    // If there's transparency, make sure that the blending is done with high quality.
+    // If not, try to skip blending.
+    if (fTransparency)
+    {
+        pGraphics->SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceOver);
+        pGraphics->SetCompositingQuality(Gdiplus::CompositingQuality::CompositingQualityHighQuality);
+    }
+    else
+    {
+        pGraphics->SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceCopy);
+        pGraphics->SetCompositingQuality(Gdiplus::CompositingQuality::CompositingQualityHighSpeed);
+    }
+
+    gs = pGraphics->DrawImage(pBitmap, destRect, srcX, srcY, srcWidth, srcHeight, Gdiplus::Unit::UnitPixel, &attrs);
+
+    return GdipHresultFromStatus(gs);
+}
+
+
+static HRESULT DrawProgressBar(
+    __in THEME* pTheme,
+    __in DRAWITEMSTRUCT* pdis,
+    __in const THEME_CONTROL* pControl
+    )
+{
+    const int nSideWidth = 1;
+    HRESULT hr = S_OK;
+    WORD wProgressColorIndex = HIWORD(pControl->dwData);
+    WORD wProgressPercentage = LOWORD(pControl->dwData);
+    const THEME_IMAGE_REFERENCE* pImageRef = pControl->ProgressBar.rgImageRef + wProgressColorIndex;
+    THEME_IMAGE_INSTANCE* pInstance = NULL;
+    int nHeight = pdis->rcItem.bottom - pdis->rcItem.top;
+    int nSourceHeight = 0;
+    int nSourceX = 0;
+    int nSourceY = 0;
+    int nFillableWidth = pdis->rcItem.right - 2 * nSideWidth;
+    int nCenter = nFillableWidth > 0 ? nFillableWidth * wProgressPercentage / 100 : 0;
+
+    if (0 > nFillableWidth)
+    {
+        ExitFunction1(hr = S_FALSE);
+    }
+
+    GetImageInstance(pTheme, pImageRef, &pInstance);
+    ExitOnNull(pInstance, hr, E_INVALIDARG, "Invalid image reference for drawing.");
+
+    switch (pImageRef->type)
+    {
+    case THEME_IMAGE_REFERENCE_TYPE_PARTIAL:
+        nSourceHeight = pImageRef->nHeight;
+        nSourceX = pImageRef->nX;
+        nSourceY = pImageRef->nY;
+        break;
+    case THEME_IMAGE_REFERENCE_TYPE_COMPLETE:
+        nSourceHeight = pInstance->nHeight;
+        nSourceX = 0;
+        nSourceY = 0;
+        break;
+    default:
+        ExitFunction1(hr = E_INVALIDARG); // This should be unreachable because GetImageInstance should have returned null.
+    }
+
+    // The progress bar stretches single pixel columns to a width that changes constantly, so it draws from the decoded image rather than the scaled image cache.
+    hr = LoadImageInstance(pInstance, pControl->wPageId);
+    ThmExitOnFailure(hr, "Failed to load progress bar image.");
+
+    // Draw the left side of the progress bar.
+    hr = DrawProgressBarImage(pTheme, pInstance, nSourceX, nSourceY, 1, nSourceHeight, pdis->hDC, 0, 0, nSideWidth, nHeight);
+
+    // Draw the filled side of the progress bar, if there is any.
+    if (0 < nCenter)
+    {
+        hr = DrawProgressBarImage(pTheme, pInstance, nSourceX + 1, nSourceY, 1, nSourceHeight, pdis->hDC, nSideWidth, 0, nCenter, nHeight);
+    }
+
+    // Draw the unfilled side of the progress bar, if there is any.
+    if (nCenter < nFillableWidth)
+    {
+        hr = DrawProgressBarImage(pTheme, pInstance, nSourceX + 2, nSourceY, 1, nSourceHeight, pdis->hDC, nSideWidth + nCenter, 0, pdis->rcItem.right - nCenter - nSideWidth, nHeight);
+    }
+
+    // Draw the right side of the progress bar.
+    hr = DrawProgressBarImage(pTheme, pInstance, nSourceX + 3, nSourceY, 1, nSourceHeight, pdis->hDC, pdis->rcItem.right - nSideWidth, 0, nSideWidth, nHeight);
+
+LExit:
+    return hr;
+}
+
+static HRESULT DrawProgressBarImage(
+    __in THEME* /*pTheme*/,
+    __in const THEME_IMAGE_INSTANCE* pImageInstance,
+    __in int srcX,
+    __in int srcY,
+    __in int srcWidth,
+    __in int srcHeight,
+    __in HDC hdc,
+    __in int destX,
+    __in int destY,
+    __in int destWidth,
+    __in int destHeight
+    )
+{
+    HRESULT hr = S_OK;
+    Gdiplus::Rect dest(0, 0, srcWidth, srcHeight);
+    Gdiplus::Bitmap isolated(dest.Width, dest.Height);
+    Gdiplus::Graphics graphics(&isolated);
+    graphics.SetCompositingMode(Gdiplus::CompositingMode::CompositingModeSourceCopy);
+
+    // Isolate the source rectangle into a temporary bitmap because otherwise GDI+ would use pixels outside of that rectangle when stretching.
+    Gdiplus::Status gs = graphics.DrawImage(pImageInstance->pBitmap, dest, srcX, srcY, srcWidth, srcHeight, Gdiplus::Unit::UnitPixel);
+    hr = GdipHresultFromStatus(gs);
+    if (SUCCEEDED(hr))
+    {
+        Gdiplus::Graphics graphicsDest(hdc);
+
+        hr = DrawGdipBitmap(&graphicsDest, destX, destY, destWidth, destHeight, &isolated, 0, 0, isolated.GetWidth(), isolated.GetHeight());
+    }
+
+    return hr;
+}
+
+
+static BOOL DrawHoverControl(
+    __in THEME* pTheme,
+    __in BOOL fHover
+    )
+{
+    BOOL fChangedHover = FALSE;
+    THEME_CONTROL* pControl = const_cast<THEME_CONTROL*>(FindControlFromHWnd(pTheme, pTheme->hwndHover));
+
+    // Only hyperlinks and owner-drawn buttons have hover states.
+    if (pControl && (THEME_CONTROL_TYPE_HYPERLINK == pControl->type ||
+        (THEME_CONTROL_TYPE_BUTTON == pControl->type && (pControl->dwInternalStyle & INTERNAL_CONTROL_STYLE_OWNER_DRAW))))
+    {
+        if (fHover)
+        {
+            pControl->dwData |= THEME_CONTROL_DATA_HOVER;
+        }
+        else
+        {
+            pControl->dwData &= ~THEME_CONTROL_DATA_HOVER;
+        }
+
+        ::InvalidateRect(pControl->hWnd, NULL, FALSE);
+        fChangedHover = TRUE;
+    }
+
+    return fChangedHover;
+}
+
+
+static void FreePage(
+    __in THEME_PAGE* pPage
+    )
+{
+    if (pPage)
+    {
+        ReleaseStr(pPage->sczName);
+
+        if (pPage->cSavedVariables)
+        {
+            for (DWORD i = 0; i < pPage->cSavedVariables; ++i)
+            {
+                ReleaseStr(pPage->rgSavedVariables[i].sczValue);
+            }
+        }
+
+        ReleaseMem(pPage->rgSavedVariables);
+    }
+}
+
+
+static void FreeImageList(
+    __in THEME_IMAGELIST* pImageList
+    )
+{
+    if (pImageList)
+    {
+        ReleaseStr(pImageList->sczName);
+        ImageList_Destroy(pImageList->hImageList);
+    }
+}
+
+static void FreeControl(
+    __in THEME_CONTROL* pControl
+    )
+{
+    if (pControl)
+    {
+        if (::IsWindow(pControl->hWnd))
+        {
+            ::CloseWindow(pControl->hWnd);
+            pControl->hWnd = NULL;
+        }
+
+        ReleaseStr(pControl->sczName);
+        ReleaseStr(pControl->sczText);
+        ReleaseStr(pControl->sczTooltip);
+        ReleaseStr(pControl->sczNote);
+        ReleaseStr(pControl->sczEnableCondition);
+        ReleaseStr(pControl->sczVisibleCondition);
+        ReleaseStr(pControl->sczValue);
+        ReleaseStr(pControl->sczVariable);
+
+        switch (pControl->type)
+        {
+        case THEME_CONTROL_TYPE_COMMANDLINK:
+            if (pControl->CommandLink.hImage)
+            {
+                ::DeleteBitmap(pControl->CommandLink.hImage);
+            }
+
+            if (pControl->CommandLink.hIcon)
+            {
+                ::DestroyIcon(pControl->CommandLink.hIcon);
+            }
+
+            for (DWORD i = 0; i < pControl->CommandLink.cConditionalNotes; ++i)
+            {
+                FreeConditionalText(pControl->CommandLink.rgConditionalNotes + i);
+            }
+
+            ReleaseMem(pControl->CommandLink.rgConditionalNotes);
+            break;
+        case THEME_CONTROL_TYPE_LISTVIEW:
+            for (DWORD i = 0; i < pControl->ListView.cColumns; ++i)
+            {
+                FreeColumn(pControl->ListView.ptcColumns + i);
+            }
+
+            ReleaseMem(pControl->ListView.ptcColumns);
+            break;
+        }
+
+        for (DWORD i = 0; i < pControl->cControls; ++i)
+        {
+            FreeControl(pControl->rgControls + i);
+        }
+
+        for (DWORD i = 0; i < pControl->cActions; ++i)
+        {
+            FreeAction(&(pControl->rgActions[i]));
+        }
+
+        for (DWORD i = 0; i < pControl->cConditionalText; ++i)
+        {
+            FreeConditionalText(&(pControl->rgConditionalText[i]));
+        }
+
+        for (DWORD i = 0; i < pControl->cTabs; ++i)
+        {
+            FreeTab(&(pControl->pttTabs[i]));
+        }
+
+        ReleaseMem(pControl->rgActions)
+        ReleaseMem(pControl->rgConditionalText);
+        ReleaseMem(pControl->pttTabs);
+    }
+}
+
+
+static void FreeAction(
+    __in THEME_ACTION* pAction
+    )
+{
+    switch (pAction->type)
+    {
+    case THEME_ACTION_TYPE_BROWSE_DIRECTORY:
+        ReleaseStr(pAction->BrowseDirectory.sczVariableName);
+        break;
+    case THEME_ACTION_TYPE_CHANGE_PAGE:
+        ReleaseStr(pAction->ChangePage.sczPageName);
+        break;
+    }
+
+    ReleaseStr(pAction->sczCondition);
+}
+
+
+static void FreeColumn(
+    __in THEME_COLUMN* pColumn
+    )
+{
+    ReleaseStr(pColumn->pszName);
+}
+
+
+static void FreeConditionalText(
+    __in THEME_CONDITIONAL_TEXT* pConditionalText
+    )
+{
+    ReleaseStr(pConditionalText->sczCondition);
+    ReleaseStr(pConditionalText->sczText);
+}
+
+
+static void FreeTab(
+    __in THEME_TAB* pTab
+    )
+{
+    ReleaseStr(pTab->pszName);
+}
+
+
+static void FreeFontInstance(
+    __in THEME_FONT_INSTANCE* pFontInstance
+    )
+{
+    if (pFontInstance->hFont)
+    {
+        ::DeleteObject(pFontInstance->hFont);
+        pFontInstance->hFont = NULL;
+    }
+}
+
+
+static void FreeFont(
+    __in THEME_FONT* pFont
+    )
+{
+    if (pFont)
+    {
+        if (pFont->hBackground)
+        {
+            ::DeleteObject(pFont->hBackground);
+            pFont->hBackground = NULL;
+        }
+
+        if (pFont->hForeground)
+        {
+            ::DeleteObject(pFont->hForeground);
+            pFont->hForeground = NULL;
+        }
+
+        for (DWORD i = 0; i < pFont->cFontInstances; ++i)
+        {
+            FreeFontInstance(&(pFont->rgFontInstances[i]));
+        }
+
+        ReleaseMem(pFont->rgFontInstances);
+        ReleaseStr(pFont->sczFaceName);
+        ReleaseStr(pFont->sczId);
+    }
+}
+
+
+static void FreeImage(
+    __in THEME_IMAGE* pImage
+    )
+{
+    if (pImage)
+    {
+        for (DWORD i = 0; i < pImage->cImageInstances; ++i)
+        {
+            FreeImageInstance(pImage->rgImageInstances + i);
+        }
+
+        ReleaseStr(pImage->sczId);
+    }
+}
+
+static void FreeImageInstance(
+    __in THEME_IMAGE_INSTANCE* pImageInstance
+    )
+{
+    if (pImageInstance->pBitmap)
+    {
+        delete pImageInstance->pBitmap;
+    }
+
+    for (DWORD i = 0; i < pImageInstance->cScaledImages; ++i)
+    {
+        FreeScaledImage(pImageInstance->rgScaledImages + i);
+    }
+
+    ReleaseMem(pImageInstance->rgScaledImages);
+    ReleaseStr(pImageInstance->sczFile);
+}
+
+static void FreeScaledImage(
+    __in THEME_SCALED_IMAGE* pScaledImage
+    )
+{
+    if (pScaledImage->pBitmap)
+    {
+        delete pScaledImage->pBitmap;
+    }
+
+    memset(pScaledImage, 0, sizeof(THEME_SCALED_IMAGE));
+}
+
+static void EvictPageImages(
+    __in THEME* pTheme,
+    __in DWORD dwPageId
+    )
+{
+    DWORD cKept = 0;
+
+    for (DWORD i = 0; i < pTheme->cScaledImages; ++i)
+    {
+        THEME_SCALED_IMAGE* pScaledImage = pTheme->rgScaledImages + i;
+
+        if (pScaledImage->dwPageId == dwPageId)
+        {
+            FreeScaledImage(pScaledImage);
+        }
+        else
+        {
+            pTheme->rgScaledImages[cKept] = *pScaledImage;
+            ++cKept;
+        }
+    }
+
+    pTheme->cScaledImages = cKept;
+
+    for (DWORD i = 0; i < pTheme->cImages; ++i)
+    {
+        THEME_IMAGE* pImage = pTheme->rgImages + i;
+
+        for (DWORD j = 0; j < pImage->cImageInstances; ++j)
+        {
+            if (pImage->rgImageInstances[j].dwPageId == dwPageId)
+            {
+                UnloadImageInstance(pImage->rgImageInstances + j);
+            }
+        }
+    }
+
+    for (DWORD i = 0; i < pTheme->cStandaloneImages; ++i)
+    {
+        if (pTheme->rgStandaloneImages[i].dwPageId == dwPageId)
+        {
+            UnloadImageInstance(pTheme->rgStandaloneImages + i);
+        }
+    }
+}
+
+
+static void CALLBACK OnBillboardTimer(
+    __in THEME* /*pTheme*/,
+    __in HWND hwnd,
+    __in UINT_PTR idEvent
+    )
+{
+    THEME_CONTROL* pControl = reinterpret_cast<THEME_CONTROL*>(idEvent);
+
+    if (pControl)
+    {
+        AssertSz(THEME_CONTROL_TYPE_BILLBOARD == pControl->type, "Only billboard controls should get billboard timer messages.");
+
+        if (pControl->dwData < pControl->cControls)
+        {
+            ThemeShowChild(pControl, pControl->dwData);
+        }
+        else if (pControl->fBillboardLoops)
+        {
+            pControl->dwData = 0;
+            ThemeShowChild(pControl, pControl->dwData);
         }
         else // no more looping
         {
@@ -5599,14 +10835,14 @@ static HRESULT ShowControl(
             // If the control has a VisibleCondition, check if it's true.
             if (pControl->sczVisibleCondition)
             {
-                hr = pTheme->pfnEvaluateCondition(pControl->sczVisibleCondition, &fVisible, pTheme->pvVariableContext);
+                hr = EvaluateVariableCondition(pTheme, pControl->sczVisibleCondition, &fVisible);
                 ThmExitOnFailure(hr, "Failed to evaluate VisibleCondition: %ls", pControl->sczVisibleCondition);
             }
 
             // If the control has an EnableCondition, check if it's true.
             if (pControl->sczEnableCondition)
             {
-                hr = pTheme->pfnEvaluateCondition(pControl->sczEnableCondition, &fEnabled, pTheme->pvVariableContext);
+                hr = EvaluateVariableCondition(pTheme, pControl->sczEnableCondition, &fEnabled);
                 ThmExitOnFailure(hr, "Failed to evaluate EnableCondition: %ls", pControl->sczEnableCondition);
             }
         }
@@ -5629,7 +10865,7 @@ static HRESULT ShowControl(
                     {
                         BOOL fCondition = FALSE;
 
-                        hr = pTheme->pfnEvaluateCondition(pConditionalText->sczCondition, &fCondition, pTheme->pvVariableContext);
+                        hr = EvaluateVariableCondition(pTheme, pConditionalText->sczCondition, &fCondition);
                         ThmExitOnFailure(hr, "Failed to evaluate condition: %ls", pConditionalText->sczCondition);
 
                         if (fCondition)
@@ -5650,7 +10886,7 @@ static HRESULT ShowControl(
                         {
                             BOOL fCondition = FALSE;
 
-                            hr = pTheme->pfnEvaluateCondition(pConditionalNote->sczCondition, &fCondition, pTheme->pvVariableContext);
+                            hr = EvaluateVariableCondition(pTheme, pConditionalNote->sczCondition, &fCondition);
                             ThmExitOnFailure(hr, "Failed to evaluate note condition: %ls", pConditionalNote->sczCondition);
 
                             if (fCondition)
@@ -5665,7 +10901,7 @@ static HRESULT ShowControl(
 
             if (wzText && *wzText)
             {
-                hr = pTheme->pfnFormatString(wzText, &sczText, pTheme->pvVariableContext);
+                hr = FormatVariableString(pTheme, wzText, &sczText);
                 ThmExitOnFailure(hr, "Failed to format string: %ls", wzText);
             }
             else
@@ -5677,7 +10913,7 @@ static HRESULT ShowControl(
 
             if (wzNote && *wzNote)
             {
-                hr = pTheme->pfnFormatString(wzNote, &sczText, pTheme->pvVariableContext);
+                hr = FormatVariableString(pTheme, wzNote, &sczText);
                 ThmExitOnFailure(hr, "Failed to format note: %ls", wzNote);
             }
             else
@@ -5727,7 +10963,7 @@ static HRESULT ShowControl(
                 hr = StrAllocFormatted(&sczFormatString, L"[%ls]", pControl->sczName);
                 ThmExitOnFailure(hr, "Failed to create format string: '%ls'", pControl->sczName);
 
-                hr = pTheme->pfnFormatString(sczFormatString, &sczText, pTheme->pvVariableContext);
+                hr = FormatVariableString(pTheme, sczFormatString, &sczText);
                 ThmExitOnFailure(hr, "Failed to format string: '%ls'", sczFormatString);
 
                 if (THEME_SHOW_PAGE_REASON_REFRESH != reason && pPage && pControl->wPageId)
@@ -5865,6 +11101,406 @@ LExit:
 }
 
 
+static HRESULT ShowPageControls(
+    __in THEME* pTheme,
+    __in int nCmdShow,
+    __in BOOL fSaveEditboxes,
+    __in THEME_SHOW_PAGE_REASON reason,
+    __in DWORD dwPageId
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fHide = SW_HIDE == nCmdShow;
+    BOOL fRedrawDisabled = FALSE;
+    THEME_VARIABLE_BATCH batch = { };
+
+    // Save the editboxes first so the batch below formats text with the values the user just entered.
+    if (fSaveEditboxes)
+    {
+        hr = SaveEditboxes(pTheme, NULL, fHide, dwPageId);
+        ThmExitOnFailure(hr, "Failed to save editboxes.");
+    }
+
+    hr = GatherVariableBatch(pTheme, NULL, fHide, dwPageId, &batch);
+    ThmExitOnFailure(hr, "Failed to gather page conditions and format strings.");
+
+    EvaluateVariableBatch(pTheme, &batch);
+
+    // Apply all of the results and then repaint once instead of once per control.
+    // WM_SETREDRAW marks the window visible so it is only used when the window is already visible.
+    if (pTheme->hwndParent && ::IsWindowVisible(pTheme->hwndParent))
+    {
+        ::SendMessageW(pTheme->hwndParent, WM_SETREDRAW, FALSE, 0);
+        fRedrawDisabled = TRUE;
+    }
+
+    pTheme->pVariableBatch = &batch;
+
+    hr = ShowControls(pTheme, NULL, nCmdShow, FALSE, reason, dwPageId);
+    ThmExitOnFailure(hr, "Failed to show controls.");
+
+LExit:
+    pTheme->pVariableBatch = NULL;
+
+    if (fRedrawDisabled)
+    {
+        ::SendMessageW(pTheme->hwndParent, WM_SETREDRAW, TRUE, 0);
+        ::RedrawWindow(pTheme->hwndParent, NULL, NULL, RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
+    }
+
+    FreeVariableBatch(&batch);
+
+    return hr;
+}
+
+static HRESULT SaveEditboxes(
+    __in THEME* pTheme,
+    __in_opt const THEME_CONTROL* pParentControl,
+    __in BOOL fHide,
+    __in DWORD dwPageId
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cControls = 0;
+    THEME_CONTROL* rgControls = NULL;
+    LPWSTR sczText = NULL;
+
+    if (!pTheme->pfnSetStringVariable)
+    {
+        ExitFunction();
+    }
+
+    GetControls(pTheme, pParentControl, cControls, rgControls);
+
+    for (DWORD i = 0; i < cControls; ++i)
+    {
+        THEME_CONTROL* pControl = rgControls + i;
+
+        if (pControl->wPageId && pControl->wPageId != dwPageId)
+        {
+            continue;
+        }
+
+        if (!pControl->fDisableAutomaticFunctionality && THEME_CONTROL_TYPE_EDITBOX == pControl->type && pControl->sczName && *pControl->sczName)
+        {
+            hr = ThemeGetTextControl(pControl, &sczText);
+            ThmExitOnFailure(hr, "Failed to get the text for control: %ls", pControl->sczName);
+
+            hr = pTheme->pfnSetStringVariable(pControl->sczName, sczText, FALSE, pTheme->pvVariableContext);
+            ThmExitOnFailure(hr, "Failed to set the variable '%ls' to '%ls'", pControl->sczName, sczText);
+        }
+
+        // Hidden page controls don't show their children so don't visit them either.
+        if (pControl->cControls && !(fHide && pControl->wPageId))
+        {
+            hr = SaveEditboxes(pTheme, pControl, fHide, dwPageId);
+            ThmExitOnFailure(hr, "Failed to save child editboxes of control: %ls", pControl->sczName);
+        }
+    }
+
+LExit:
+    ReleaseStr(sczText);
+
+    return hr;
+}
+
+static HRESULT GatherVariableBatch(
+    __in THEME* pTheme,
+    __in_opt const THEME_CONTROL* pParentControl,
+    __in BOOL fHide,
+    __in DWORD dwPageId,
+    __in THEME_VARIABLE_BATCH* pBatch
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cControls = 0;
+    THEME_CONTROL* rgControls = NULL;
+    LPWSTR sczFormatString = NULL;
+
+    GetControls(pTheme, pParentControl, cControls, rgControls);
+
+    // This visits the same controls and strings as ShowControl, which looks up the results by string.
+    for (DWORD i = 0; i < cControls; ++i)
+    {
+        THEME_CONTROL* pControl = rgControls + i;
+
+        if ((pControl->wPageId && pControl->wPageId != dwPageId) || (fHide && pControl->wPageId))
+        {
+            continue;
+        }
+
+        if (!pControl->fDisableAutomaticFunctionality)
+        {
+            if (pTheme->pfnEvaluateCondition)
+            {
+                hr = AddVariableBatchValue(&pBatch->cConditions, &pBatch->rgConditions, pControl->sczVisibleCondition);
+                ThmExitOnFailure(hr, "Failed to add VisibleCondition to batch.");
+
+                hr = AddVariableBatchValue(&pBatch->cConditions, &pBatch->rgConditions, pControl->sczEnableCondition);
+                ThmExitOnFailure(hr, "Failed to add EnableCondition to batch.");
+            }
+
+            if (pTheme->pfnFormatString && ((pControl->sczText && *pControl->sczText) || pControl->cConditionalText) && THEME_CONTROL_TYPE_EDITBOX != pControl->type)
+            {
+                hr = AddVariableBatchValue(&pBatch->cFormats, &pBatch->rgFormats, pControl->sczText);
+                ThmExitOnFailure(hr, "Failed to add text to batch.");
+
+                hr = AddVariableBatchValue(&pBatch->cFormats, &pBatch->rgFormats, pControl->sczNote);
+                ThmExitOnFailure(hr, "Failed to add note to batch.");
+
+                // Every alternative is formatted because the conditions that pick one are evaluated in the same batch.
+                if (pTheme->pfnEvaluateCondition)
+                {
+                    for (DWORD j = 0; j < pControl->cConditionalText; ++j)
+                    {
+                        THEME_CONDITIONAL_TEXT* pConditionalText = pControl->rgConditionalText + j;
+
+                        hr = AddVariableBatchValue(&pBatch->cConditions, &pBatch->rgConditions, pConditionalText->sczCondition);
+                        ThmExitOnFailure(hr, "Failed to add text condition to batch.");
+
+                        hr = AddVariableBatchValue(&pBatch->cFormats, &pBatch->rgFormats, pConditionalText->sczText);
+                        ThmExitOnFailure(hr, "Failed to add conditional text to batch.");
+                    }
+
+                    if (THEME_CONTROL_TYPE_COMMANDLINK == pControl->type)
+                    {
+                        for (DWORD j = 0; j < pControl->CommandLink.cConditionalNotes; ++j)
+                        {
+                            THEME_CONDITIONAL_TEXT* pConditionalNote = pControl->CommandLink.rgConditionalNotes + j;
+
+                            hr = AddVariableBatchValue(&pBatch->cConditions, &pBatch->rgConditions, pConditionalNote->sczCondition);
+                            ThmExitOnFailure(hr, "Failed to add note condition to batch.");
+
+                            hr = AddVariableBatchValue(&pBatch->cFormats, &pBatch->rgFormats, pConditionalNote->sczText);
+                            ThmExitOnFailure(hr, "Failed to add conditional note to batch.");
+                        }
+                    }
+                }
+            }
+
+            if (pTheme->pfnFormatString && THEME_CONTROL_TYPE_EDITBOX == pControl->type && pControl->sczName && *pControl->sczName)
+            {
+                hr = StrAllocFormatted(&sczFormatString, L"[%ls]", pControl->sczName);
+                ThmExitOnFailure(hr, "Failed to create format string: '%ls'", pControl->sczName);
+
+                hr = AddVariableBatchValue(&pBatch->cFormats, &pBatch->rgFormats, sczFormatString);
+                ThmExitOnFailure(hr, "Failed to add editbox value to batch.");
+            }
+        }
+
+        if (pControl->cControls)
+        {
+            hr = GatherVariableBatch(pTheme, pControl, fHide, dwPageId, pBatch);
+            ThmExitOnFailure(hr, "Failed to gather child controls of control: %ls", pControl->sczName);
+        }
+    }
+
+LExit:
+    ReleaseStr(sczFormatString);
+
+    return hr;
+}
+
+static HRESULT AddVariableBatchValue(
+    __inout DWORD* pcValues,
+    __inout THEME_VARIABLE_BATCH_VALUE** prgValues,
+    __in_z_opt LPCWSTR wzKey
+    )
+{
+    HRESULT hr = S_OK;
+    THEME_VARIABLE_BATCH_VALUE* pValue = NULL;
+
+    if (!wzKey || !*wzKey || FindVariableBatchValue(*pcValues, *prgValues, wzKey))
+    {
+        ExitFunction();
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(prgValues), *pcValues, 1, sizeof(THEME_VARIABLE_BATCH_VALUE), GROW_VARIABLE_BATCH_VALUES);
+    ThmExitOnFailure(hr, "Failed to allocate memory for batch values.");
+
+    pValue = *prgValues + *pcValues;
+
+    hr = StrAllocString(&pValue->sczKey, wzKey, 0);
+    ThmExitOnFailure(hr, "Failed to copy batch key.");
+
+    ++*pcValues;
+
+LExit:
+    return hr;
+}
+
+static THEME_VARIABLE_BATCH_VALUE* FindVariableBatchValue(
+    __in DWORD cValues,
+    __in_ecount(cValues) THEME_VARIABLE_BATCH_VALUE* rgValues,
+    __in_z LPCWSTR wzKey
+    )
+{
+    for (DWORD i = 0; i < cValues; ++i)
+    {
+        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, rgValues[i].sczKey, -1, wzKey, -1))
+        {
+            return rgValues + i;
+        }
+    }
+
+    return NULL;
+}
+
+static void EvaluateVariableBatch(
+    __in THEME* pTheme,
+    __in THEME_VARIABLE_BATCH* pBatch
+    )
+{
+    HRESULT hr = S_OK;
+    LPCWSTR* rgwzConditions = NULL;
+    BOOL* rgfConditions = NULL;
+    LPCWSTR* rgwzFormats = NULL;
+    LPWSTR* rgsczFormatted = NULL;
+
+    // Without a batch callback each distinct string is still evaluated only once, on first use.
+    if (!pTheme->pfnEvaluateVariableBatch || (!pBatch->cConditions && !pBatch->cFormats))
+    {
+        ExitFunction();
+    }
+
+    if (pBatch->cConditions)
+    {
+        rgwzConditions = static_cast<LPCWSTR*>(MemAlloc(sizeof(LPCWSTR) * pBatch->cConditions, TRUE));
+        ThmExitOnNull(rgwzConditions, hr, E_OUTOFMEMORY, "Failed to allocate batch conditions.");
+
+        rgfConditions = static_cast<BOOL*>(MemAlloc(sizeof(BOOL) * pBatch->cConditions, TRUE));
+        ThmExitOnNull(rgfConditions, hr, E_OUTOFMEMORY, "Failed to allocate batch condition results.");
+
+        for (DWORD i = 0; i < pBatch->cConditions; ++i)
+        {
+            rgwzConditions[i] = pBatch->rgConditions[i].sczKey;
+        }
+    }
+
+    if (pBatch->cFormats)
+    {
+        rgwzFormats = static_cast<LPCWSTR*>(MemAlloc(sizeof(LPCWSTR) * pBatch->cFormats, TRUE));
+        ThmExitOnNull(rgwzFormats, hr, E_OUTOFMEMORY, "Failed to allocate batch format strings.");
+
+        rgsczFormatted = static_cast<LPWSTR*>(MemAlloc(sizeof(LPWSTR) * pBatch->cFormats, TRUE));
+        ThmExitOnNull(rgsczFormatted, hr, E_OUTOFMEMORY, "Failed to allocate batch formatted strings.");
+
+        for (DWORD i = 0; i < pBatch->cFormats; ++i)
+        {
+            rgwzFormats[i] = pBatch->rgFormats[i].sczKey;
+        }
+    }
+
+    // If the batch fails, ShowControl falls back to evaluating each string on its own so the failure is reported for the control that hit it.
+    hr = pTheme->pfnEvaluateVariableBatch(pBatch->cConditions, rgwzConditions, rgfConditions, pBatch->cFormats, rgwzFormats, rgsczFormatted, pTheme->pvVariableContext);
+    ThmExitOnFailure(hr, "Failed to evaluate page conditions and format strings.");
+
+    for (DWORD i = 0; i < pBatch->cConditions; ++i)
+    {
+        pBatch->rgConditions[i].fEvaluated = TRUE;
+        pBatch->rgConditions[i].fCondition = rgfConditions[i];
+    }
+
+    for (DWORD i = 0; i < pBatch->cFormats; ++i)
+    {
+        pBatch->rgFormats[i].fEvaluated = TRUE;
+        pBatch->rgFormats[i].sczFormatted = rgsczFormatted[i];
+        rgsczFormatted[i] = NULL;
+    }
+
+LExit:
+    if (rgsczFormatted)
+    {
+        for (DWORD i = 0; i < pBatch->cFormats; ++i)
+        {
+            ReleaseStr(rgsczFormatted[i]);
+        }
+    }
+
+    ReleaseMem(rgsczFormatted);
+    ReleaseMem(rgwzFormats);
+    ReleaseMem(rgfConditions);
+    ReleaseMem(rgwzConditions);
+}
+
+static void FreeVariableBatch(
+    __in THEME_VARIABLE_BATCH* pBatch
+    )
+{
+    for (DWORD i = 0; i < pBatch->cConditions; ++i)
+    {
+        ReleaseStr(pBatch->rgConditions[i].sczKey);
+    }
+
+    for (DWORD i = 0; i < pBatch->cFormats; ++i)
+    {
+        ReleaseStr(pBatch->rgFormats[i].sczKey);
+        ReleaseStr(pBatch->rgFormats[i].sczFormatted);
+    }
+
+    ReleaseMem(pBatch->rgConditions);
+    ReleaseMem(pBatch->rgFormats);
+}
+
+static HRESULT EvaluateVariableCondition(
+    __in THEME* pTheme,
+    __in_z LPCWSTR wzCondition,
+    __out BOOL* pf
+    )
+{
+    HRESULT hr = S_OK;
+    THEME_VARIABLE_BATCH_VALUE* pValue = pTheme->pVariableBatch ? FindVariableBatchValue(pTheme->pVariableBatch->cConditions, pTheme->pVariableBatch->rgConditions, wzCondition) : NULL;
+
+    if (!pValue)
+    {
+        hr = pTheme->pfnEvaluateCondition(wzCondition, pf, pTheme->pvVariableContext);
+    }
+    else
+    {
+        if (!pValue->fEvaluated)
+        {
+            pValue->hr = pTheme->pfnEvaluateCondition(wzCondition, &pValue->fCondition, pTheme->pvVariableContext);
+            pValue->fEvaluated = TRUE;
+        }
+
+        hr = pValue->hr;
+        *pf = pValue->fCondition;
+    }
+
+    return hr;
+}
+
+static HRESULT FormatVariableString(
+    __in THEME* pTheme,
+    __in_z LPCWSTR wzFormat,
+    __inout LPWSTR* psczOut
+    )
+{
+    HRESULT hr = S_OK;
+    THEME_VARIABLE_BATCH_VALUE* pValue = pTheme->pVariableBatch ? FindVariableBatchValue(pTheme->pVariableBatch->cFormats, pTheme->pVariableBatch->rgFormats, wzFormat) : NULL;
+
+    if (!pValue)
+    {
+        ExitFunction1(hr = pTheme->pfnFormatString(wzFormat, psczOut, pTheme->pvVariableContext));
+    }
+
+    if (!pValue->fEvaluated)
+    {
+        pValue->hr = pTheme->pfnFormatString(wzFormat, &pValue->sczFormatted, pTheme->pvVariableContext);
+        pValue->fEvaluated = TRUE;
+    }
+
+    hr = pValue->hr;
+    ThmExitOnFailure(hr, "Failed to format string: %ls", wzFormat);
+
+    hr = StrAllocString(psczOut, pValue->sczFormatted ? pValue->sczFormatted : L"", 0);
+    ThmExitOnFailure(hr, "Failed to copy formatted string.");
+
+LExit:
+    return hr;
+}
+
+
 static LRESULT CALLBACK ControlGroupDefWindowProc(
     __in_opt THEME* pTheme,
     __in HWND hWnd,
@@ -6754,6 +12390,9 @@ static void ScaleTheme(
 {
     pTheme->nDpi = nDpi;
 
+    // Nothing scaled for another DPI will be drawn again.
+    EvictStaleScaledImages(pTheme);
+
     pTheme->nHeight = DpiuScaleValue(pTheme->nDefaultDpiHeight, pTheme->nDpi);
     pTheme->nWidth = DpiuScaleValue(pTheme->nDefaultDpiWidth, pTheme->nDpi);
     pTheme->nMinimumHeight = DpiuScaleValue(pTheme->nDefaultDpiMinimumHeight, pTheme->nDpi);
@@ -6868,14 +12507,14 @@ static void ScaleImageReference(
         {
             pInstance = pImage->rgImageInstances + i;
 
-            if (nDestWidth == (int)pInstance->pBitmap->GetWidth() && nDestHeight == (int)pInstance->pBitmap->GetHeight())
+            if (nDestWidth == (int)pInstance->nWidth && nDestHeight == (int)pInstance->nHeight)
             {
                 dwIndex = i;
                 break;
             }
-            else if (nDestWidth <= (int)pInstance->pBitmap->GetWidth() && nDestHeight <= (int)pInstance->pBitmap->GetHeight())
+            else if (nDestWidth <= (int)pInstance->nWidth && nDestHeight <= (int)pInstance->nHeight)
             {
-                qwPixels = (DWORD64)pInstance->pBitmap->GetWidth() * pInstance->pBitmap->GetHeight();
+                qwPixels = (DWORD64)pInstance->nWidth * pInstance->nHeight;
                 if (!pDownscaleInstance || qwPixels < qwBestMatchPixels)
                 {
                     qwBestMatchPixels = qwPixels;
@@ -6885,7 +12524,7 @@ static void ScaleImageReference(
             }
             else if (!pDownscaleInstance)
             {
-                qwPixels = (DWORD64)pInstance->pBitmap->GetWidth() * pInstance->pBitmap->GetHeight();
+                qwPixels = (DWORD64)pInstance->nWidth * pInstance->nHeight;
                 if (!pUpscaleInstance || qwPixels > qwBestMatchPixels)
                 {
                     qwBestMatchPixels = qwPixels;
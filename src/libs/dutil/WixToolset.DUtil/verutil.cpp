@@ -17,8 +17,39 @@
 
 // constants
 const DWORD GROW_RELEASE_LABELS = 3;
+const DWORD GROW_CACHE_ENTRIES = 32;
+
+// structs
+typedef struct _VERUTIL_VERSION_CACHE_ENTRY
+{
+    LPWSTR sczKey;
+    VERUTIL_VERSION* pVersion;
+    BOOL fPacked;
+    VERUTIL_PACKED_VERSION packed;
+} VERUTIL_VERSION_CACHE_ENTRY;
+
+typedef struct _VERUTIL_VERSION_CACHE
+{
+    CRITICAL_SECTION cs;
+    STRINGDICT_HANDLE sdEntries;
+
+    VERUTIL_VERSION_CACHE_ENTRY** rgpEntries;
+    DWORD cEntries;
+} VERUTIL_VERSION_CACHE;
 
 // Forward declarations.
+static HRESULT GetCacheEntry(
+    __in VERUTIL_VERSION_CACHE* pCache,
+    __in_z LPCWSTR wzVersion,
+    __out VERUTIL_VERSION_CACHE_ENTRY** ppEntry
+    );
+static void FreeCacheEntry(
+    __in VERUTIL_VERSION_CACHE_ENTRY* pEntry
+    );
+static int CompareDword64(
+    __in const DWORD64& qw1,
+    __in const DWORD64& qw2
+    );
 static int CompareDword(
     __in const DWORD& dw1,
     __in const DWORD& dw2
@@ -39,6 +70,135 @@ static HRESULT CompareVersionSubstring(
     );
 
 
+DAPI_(HRESULT) VerCacheCreate(
+    __in DWORD dwExpectedVersions,
+    __out VERUTIL_VERSION_CACHE_HANDLE* phCache
+    )
+{
+    HRESULT hr = S_OK;
+    VERUTIL_VERSION_CACHE* pCache = NULL;
+
+    pCache = reinterpret_cast<VERUTIL_VERSION_CACHE*>(MemAlloc(sizeof(VERUTIL_VERSION_CACHE), TRUE));
+    VerExitOnNull(pCache, hr, E_OUTOFMEMORY, "Failed to allocate memory for Verutil version cache.");
+
+    ::InitializeCriticalSection(&pCache->cs);
+
+    // The entries are allocated individually so the dictionary can hold direct pointers to them.
+    hr = DictCreateWithEmbeddedKey(&pCache->sdEntries, dwExpectedVersions, NULL, offsetof(VERUTIL_VERSION_CACHE_ENTRY, sczKey), DICT_FLAG_NONE);
+    VerExitOnFailure(hr, "Failed to create Verutil version cache dictionary.");
+
+    *phCache = pCache;
+    pCache = NULL;
+
+LExit:
+    if (pCache)
+    {
+        VerCacheDestroy(pCache);
+    }
+
+    return hr;
+}
+
+DAPI_(void) VerCacheDestroy(
+    __in VERUTIL_VERSION_CACHE_HANDLE hCache
+    )
+{
+    VERUTIL_VERSION_CACHE* pCache = reinterpret_cast<VERUTIL_VERSION_CACHE*>(hCache);
+
+    if (pCache)
+    {
+        ReleaseDict(pCache->sdEntries);
+
+        for (DWORD i = 0; i < pCache->cEntries; ++i)
+        {
+            FreeCacheEntry(pCache->rgpEntries[i]);
+        }
+
+        ReleaseMem(pCache->rgpEntries);
+
+        ::DeleteCriticalSection(&pCache->cs);
+
+        MemFree(pCache);
+    }
+}
+
+DAPI_(HRESULT) VerCacheGetVersion(
+    __in VERUTIL_VERSION_CACHE_HANDLE hCache,
+    __in_z LPCWSTR wzVersion,
+    __in BOOL fStrict,
+    __out const VERUTIL_VERSION** ppVersion
+    )
+{
+    HRESULT hr = S_OK;
+    VERUTIL_VERSION_CACHE_ENTRY* pEntry = NULL;
+
+    if (!hCache || !wzVersion || !ppVersion)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    hr = GetCacheEntry(reinterpret_cast<VERUTIL_VERSION_CACHE*>(hCache), wzVersion, &pEntry);
+    VerExitOnFailure(hr, "Failed to get cached Verutil version '%ls'.", wzVersion);
+
+    // The cache always parses leniently, a strict parse fails exactly when the lenient parse is invalid.
+    if (fStrict && pEntry->pVersion->fInvalid)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    *ppVersion = pEntry->pVersion;
+
+LExit:
+    return hr;
+}
+
+DAPI_(HRESULT) VerCacheCompareStringVersions(
+    __in VERUTIL_VERSION_CACHE_HANDLE hCache,
+    __in_z LPCWSTR wzVersion1,
+    __in_z LPCWSTR wzVersion2,
+    __in BOOL fStrict,
+    __out int* pnResult
+    )
+{
+    HRESULT hr = S_OK;
+    VERUTIL_VERSION_CACHE* pCache = reinterpret_cast<VERUTIL_VERSION_CACHE*>(hCache);
+    VERUTIL_VERSION_CACHE_ENTRY* pEntry1 = NULL;
+    VERUTIL_VERSION_CACHE_ENTRY* pEntry2 = NULL;
+    int nResult = 0;
+
+    if (!pCache || !wzVersion1 || !wzVersion2)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    hr = GetCacheEntry(pCache, wzVersion1, &pEntry1);
+    VerExitOnFailure(hr, "Failed to get cached Verutil version '%ls'", wzVersion1);
+
+    hr = GetCacheEntry(pCache, wzVersion2, &pEntry2);
+    VerExitOnFailure(hr, "Failed to get cached Verutil version '%ls'", wzVersion2);
+
+    if (fStrict && (pEntry1->pVersion->fInvalid || pEntry2->pVersion->fInvalid))
+    {
+        hr = E_INVALIDARG;
+        VerExitOnFailure(hr, "Failed to parse Verutil version '%ls'", pEntry1->pVersion->fInvalid ? wzVersion1 : wzVersion2);
+    }
+
+    if (pEntry1->fPacked && pEntry2->fPacked)
+    {
+        nResult = VerComparePackedVersions(&pEntry1->packed, &pEntry2->packed);
+    }
+    else
+    {
+        hr = VerCompareParsedVersions(pEntry1->pVersion, pEntry2->pVersion, &nResult);
+        VerExitOnFailure(hr, "Failed to compare parsed Verutil versions '%ls' and '%ls'.", wzVersion1, wzVersion2);
+    }
+
+LExit:
+    *pnResult = nResult;
+
+    return hr;
+}
+
 DAPI_(HRESULT) VerCompareParsedVersions(
     __in_opt VERUTIL_VERSION* pVersion1,
     __in_opt VERUTIL_VERSION* pVersion2,
@@ -235,6 +395,21 @@ LExit:
     return hr;
 }
 
+DAPI_(int) VerComparePackedVersions(
+    __in const VERUTIL_PACKED_VERSION* pVersion1,
+    __in const VERUTIL_PACKED_VERSION* pVersion2
+    )
+{
+    int nResult = CompareDword64(pVersion1->qwHigh, pVersion2->qwHigh);
+
+    if (0 == nResult)
+    {
+        nResult = CompareDword64(pVersion1->qwLow, pVersion2->qwLow);
+    }
+
+    return nResult;
+}
+
 DAPI_(void) VerFreeVersion(
     __in VERUTIL_VERSION* pVersion
     )
@@ -247,6 +422,34 @@ DAPI_(void) VerFreeVersion(
     }
 }
 
+DAPI_(HRESULT) VerPackVersion(
+    __in const VERUTIL_VERSION* pVersion,
+    __out VERUTIL_PACKED_VERSION* pPackedVersion
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!pVersion || !pPackedVersion)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    // Release labels and invalid versions need the full comparison.
+    if (pVersion->cReleaseLabels || pVersion->fInvalid)
+    {
+        pPackedVersion->qwHigh = 0;
+        pPackedVersion->qwLow = 0;
+
+        ExitFunction1(hr = S_FALSE);
+    }
+
+    pPackedVersion->qwHigh = static_cast<DWORD64>(pVersion->dwMajor) << 32 | pVersion->dwMinor;
+    pPackedVersion->qwLow = static_cast<DWORD64>(pVersion->dwPatch) << 32 | pVersion->dwRevision;
+
+LExit:
+    return hr;
+}
+
 DAPI_(HRESULT) VerParseVersion(
     __in_z LPCWSTR wzVersion,
     __in SIZE_T cchVersion,
@@ -577,6 +780,92 @@ LExit:
 }
 
 
+static HRESULT GetCacheEntry(
+    __in VERUTIL_VERSION_CACHE* pCache,
+    __in_z LPCWSTR wzVersion,
+    __out VERUTIL_VERSION_CACHE_ENTRY** ppEntry
+    )
+{
+    HRESULT hr = S_OK;
+    VERUTIL_VERSION_CACHE_ENTRY* pEntry = NULL;
+    VERUTIL_VERSION_CACHE_ENTRY* pNewEntry = NULL;
+
+    ::EnterCriticalSection(&pCache->cs);
+
+    hr = DictGetValue(pCache->sdEntries, wzVersion, reinterpret_cast<void**>(&pEntry));
+    if (E_NOTFOUND != hr)
+    {
+        VerExitOnFailure(hr, "Failed to find Verutil version '%ls' in cache.", wzVersion);
+        ExitFunction();
+    }
+
+    pNewEntry = reinterpret_cast<VERUTIL_VERSION_CACHE_ENTRY*>(MemAlloc(sizeof(VERUTIL_VERSION_CACHE_ENTRY), TRUE));
+    VerExitOnNull(pNewEntry, hr, E_OUTOFMEMORY, "Failed to allocate memory for Verutil version cache entry.");
+
+    hr = StrAllocString(&pNewEntry->sczKey, wzVersion, 0);
+    VerExitOnFailure(hr, "Failed to copy Verutil version cache key '%ls'.", wzVersion);
+
+    hr = VerParseVersion(wzVersion, 0, FALSE, &pNewEntry->pVersion);
+    VerExitOnFailure(hr, "Failed to parse Verutil version '%ls'.", wzVersion);
+
+    hr = VerPackVersion(pNewEntry->pVersion, &pNewEntry->packed);
+    VerExitOnFailure(hr, "Failed to pack Verutil version '%ls'.", wzVersion);
+
+    pNewEntry->fPacked = S_OK == hr;
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pCache->rgpEntries), pCache->cEntries, 1, sizeof(VERUTIL_VERSION_CACHE_ENTRY*), GROW_CACHE_ENTRIES);
+    VerExitOnFailure(hr, "Failed to grow Verutil version cache.");
+
+    hr = DictAddValue(pCache->sdEntries, pNewEntry);
+    VerExitOnFailure(hr, "Failed to add Verutil version '%ls' to cache.", wzVersion);
+
+    pCache->rgpEntries[pCache->cEntries] = pNewEntry;
+    ++pCache->cEntries;
+
+    pEntry = pNewEntry;
+    pNewEntry = NULL;
+
+LExit:
+    ::LeaveCriticalSection(&pCache->cs);
+
+    if (pNewEntry)
+    {
+        FreeCacheEntry(pNewEntry);
+    }
+
+    *ppEntry = pEntry;
+
+    return hr;
+}
+
+static void FreeCacheEntry(
+    __in VERUTIL_VERSION_CACHE_ENTRY* pEntry
+    )
+{
+    ReleaseStr(pEntry->sczKey);
+    ReleaseVerutilVersion(pEntry->pVersion);
+    MemFree(pEntry);
+}
+
+static int CompareDword64(
+    __in const DWORD64& qw1,
+    __in const DWORD64& qw2
+    )
+{
+    int nResult = 0;
+
+    if (qw1 > qw2)
+    {
+        nResult = 1;
+    }
+    else if (qw1 < qw2)
+    {
+        nResult = -1;
+    }
+
+    return nResult;
+}
+
 static int CompareDword(
     __in const DWORD& dw1,
     __in const DWORD& dw2
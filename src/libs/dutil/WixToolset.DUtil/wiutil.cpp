@@ -23,10 +23,40 @@
 
 const DWORD WIU_MSI_PROGRESS_INVALID = 0xFFFFFFFF;
 const DWORD WIU_GOOD_ENOUGH_PROPERTY_LENGTH = 64;
+const DWORD WIU_MSI_MESSAGE_QUEUE_LIMIT = 256;
 
 
 // structs
 
+typedef struct _WIU_MSI_QUEUED_MESSAGE
+{
+    WIU_MSI_EXECUTE_MESSAGE message;
+    LPWSTR sczMessage;
+    LPWSTR* rgsczData;
+
+    struct _WIU_MSI_QUEUED_MESSAGE* pNext;
+} WIU_MSI_QUEUED_MESSAGE;
+
+typedef struct _WIU_MSI_MESSAGE_QUEUE
+{
+    CRITICAL_SECTION csQueue;
+    HANDLE hForwarderThread;
+    HANDLE hMessagesQueued;
+    HANDLE hIdle; // signaled when nothing is queued or being forwarded.
+    HANDLE hSpaceAvailable; // signaled when fewer than WIU_MSI_MESSAGE_QUEUE_LIMIT messages are queued.
+    BOOL fStop;
+
+    WIU_MSI_QUEUED_MESSAGE* pHead;
+    WIU_MSI_QUEUED_MESSAGE* pTail;
+    DWORD cQueued;
+
+    // The first cancel returned by the handler for a queued message, handed back to Windows Installer on its next callback.
+    INT nPendingResult;
+
+    PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler;
+    LPVOID pvContext;
+} WIU_MSI_MESSAGE_QUEUE;
+
 
 static PFN_MSIENABLELOGW vpfnMsiEnableLogW = ::MsiEnableLogW;
 static PFN_MSIGETPRODUCTINFOW vpfnMsiGetProductInfoW = ::MsiGetProductInfoW;
@@ -137,6 +167,35 @@ void UninitializeMessageData(
     __in LPWSTR* rgsczData,
     __in DWORD cData
     );
+static HRESULT CreateMessageQueue(
+    __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
+    __in_opt LPVOID pvContext,
+    __out WIU_MSI_MESSAGE_QUEUE** ppQueue
+    );
+static void DestroyMessageQueue(
+    __in WIU_MSI_MESSAGE_QUEUE* pQueue
+    );
+static INT SendExecuteMessage(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext,
+    __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
+    __in BOOL fNeedsResult,
+    __deref_opt_inout_ecount_opt(pMessage->cData) LPWSTR** prgsczData
+    );
+static HRESULT QueueExecuteMessage(
+    __in WIU_MSI_MESSAGE_QUEUE* pQueue,
+    __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
+    __deref_opt_inout_ecount_opt(pMessage->cData) LPWSTR** prgsczData
+    );
+static BOOL ReplacesQueuedMessage(
+    __in const WIU_MSI_EXECUTE_MESSAGE* pQueuedMessage,
+    __in const WIU_MSI_EXECUTE_MESSAGE* pMessage
+    );
+static DWORD WINAPI MessageForwarderThread(
+    __in LPVOID pvContext
+    );
+static void FreeQueuedMessage(
+    __in WIU_MSI_QUEUED_MESSAGE* pQueued
+    );
 
 
 /********************************************************************
@@ -801,6 +860,7 @@ extern "C" HRESULT DAPI WiuInitializeExternalUI(
     __in_opt HWND hwndParent,
     __in LPVOID pvContext,
     __in BOOL fRollback,
+    __in BOOL fQueueNotifications,
     __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
     )
 {
@@ -826,6 +886,17 @@ extern "C" HRESULT DAPI WiuInitializeExternalUI(
     pExecuteContext->pfnMessageHandler = pfnMessageHandler;
     pExecuteContext->pvContext = pvContext;
 
+    // Chatty packages send thousands of action data and progress messages, so those are forwarded to the
+    // handler from a background thread instead of blocking Windows Installer on each one. The queue is
+    // bounded, so a handler that cannot keep up still slows Windows Installer down. A queued handler must not
+    // depend on state of the Windows Installer thread (such as its thread local storage); callers with
+    // such a handler leave this off and get every message on that thread.
+    if (fQueueNotifications)
+    {
+        hr = CreateMessageQueue(pfnMessageHandler, pvContext, &pExecuteContext->pMessageQueue);
+        WiuExitOnFailure(hr, "Failed to create MSI message queue.");
+    }
+
     // If the external UI record is available (MSI version >= 3.1) use it but fall back to the standard external
     // UI handler if necesary.
     if (vpfnMsiSetExternalUIRecord)
@@ -849,6 +920,13 @@ extern "C" void DAPI WiuUninitializeExternalUI(
     __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
     )
 {
+    // Deliver everything still queued before the caller moves on.
+    if (pExecuteContext->pMessageQueue)
+    {
+        DestroyMessageQueue(pExecuteContext->pMessageQueue);
+        pExecuteContext->pMessageQueue = NULL;
+    }
+
     if (INSTALLUILEVEL_NOCHANGE != pExecuteContext->previousInstallUILevel)
     {
         pExecuteContext->previousInstallUILevel = vpfnMsiSetInternalUI(pExecuteContext->previousInstallUILevel, &pExecuteContext->hwndPreviousParentWindow);
@@ -1398,6 +1476,7 @@ static INT SendMsiMessage(
     WIU_MSI_EXECUTE_MESSAGE message = { };
     LPWSTR* rgsczData = NULL;
     DWORD cData = 0;
+    BOOL fNeedsResult = TRUE;
 
     InitializeMessageData(hRecord, &rgsczData, &cData);
 
@@ -1407,7 +1486,10 @@ static INT SendMsiMessage(
     message.rgwzData = (LPCWSTR*)rgsczData;
     message.msiMessage.mt = mt;
     message.msiMessage.wzMessage = wzMessage;
-    nResult = pContext->pfnMessageHandler(&message, pContext->pvContext);
+
+    // Action and informational messages with only an OK button are notifications, anything else may need an answer.
+    fNeedsResult = (INSTALLMESSAGE_ACTIONSTART != mt && INSTALLMESSAGE_ACTIONDATA != mt && INSTALLMESSAGE_INFO != mt) || MB_OK != (uiFlags & MB_TYPEMASK);
+    nResult = SendExecuteMessage(pContext, &message, fNeedsResult, &rgsczData);
 
     UninitializeMessageData(rgsczData, cData);
     return nResult;
@@ -1452,7 +1534,7 @@ static INT SendErrorMessage(
     message.rgwzData = (LPCWSTR*)rgsczData;
     message.error.dwErrorCode = dwErrorCode;
     message.error.wzMessage = wzMessage;
-    nResult = pContext->pfnMessageHandler(&message, pContext->pvContext);
+    nResult = SendExecuteMessage(pContext, &message, TRUE, NULL);
 
     UninitializeMessageData(rgsczData, cData);
     return nResult;
@@ -1478,7 +1560,7 @@ static INT SendFilesInUseMessage(
     message.rgwzData = (LPCWSTR*)rgsczData;
     message.msiFilesInUse.cFiles = message.cData;       // point the files in use information to the message record information.
     message.msiFilesInUse.rgwzFiles = message.rgwzData;
-    nResult = pContext->pfnMessageHandler(&message, pContext->pvContext);
+    nResult = SendExecuteMessage(pContext, &message, TRUE, NULL);
 
     UninitializeMessageData(rgsczData, cData);
     return nResult;
@@ -1531,7 +1613,7 @@ static INT SendProgressUpdate(
     message.type = WIU_MSI_EXECUTE_MESSAGE_PROGRESS;
     message.dwUIHint = MB_OKCANCEL;
     message.progress.dwPercentage = dwPercentage;
-    nResult = pContext->pfnMessageHandler(&message, pContext->pvContext);
+    nResult = SendExecuteMessage(pContext, &message, FALSE, NULL);
 
     return nResult;
 }
@@ -1629,3 +1711,297 @@ void UninitializeMessageData(
         MemFree(rgsczData);
     }
 }
+
+static HRESULT CreateMessageQueue(
+    __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
+    __in_opt LPVOID pvContext,
+    __out WIU_MSI_MESSAGE_QUEUE** ppQueue
+    )
+{
+    HRESULT hr = S_OK;
+    WIU_MSI_MESSAGE_QUEUE* pQueue = NULL;
+
+    pQueue = static_cast<WIU_MSI_MESSAGE_QUEUE*>(MemAlloc(sizeof(WIU_MSI_MESSAGE_QUEUE), TRUE));
+    WiuExitOnNull(pQueue, hr, E_OUTOFMEMORY, "Failed to allocate MSI message queue.");
+
+    ::InitializeCriticalSection(&pQueue->csQueue);
+    pQueue->nPendingResult = IDNOACTION;
+    pQueue->pfnMessageHandler = pfnMessageHandler;
+    pQueue->pvContext = pvContext;
+
+    pQueue->hMessagesQueued = ::CreateEventW(NULL, FALSE, FALSE, NULL);
+    WiuExitOnNullWithLastError(pQueue->hMessagesQueued, hr, "Failed to create MSI message queued event.");
+
+    pQueue->hIdle = ::CreateEventW(NULL, TRUE, TRUE, NULL);
+    WiuExitOnNullWithLastError(pQueue->hIdle, hr, "Failed to create MSI message queue idle event.");
+
+    pQueue->hSpaceAvailable = ::CreateEventW(NULL, TRUE, TRUE, NULL);
+    WiuExitOnNullWithLastError(pQueue->hSpaceAvailable, hr, "Failed to create MSI message queue space available event.");
+
+    pQueue->hForwarderThread = ::CreateThread(NULL, 0, MessageForwarderThread, pQueue, 0, NULL);
+    WiuExitOnNullWithLastError(pQueue->hForwarderThread, hr, "Failed to create MSI message forwarder thread.");
+
+    *ppQueue = pQueue;
+    pQueue = NULL;
+
+LExit:
+    if (pQueue)
+    {
+        DestroyMessageQueue(pQueue);
+    }
+
+    return hr;
+}
+
+static void DestroyMessageQueue(
+    __in WIU_MSI_MESSAGE_QUEUE* pQueue
+    )
+{
+    WIU_MSI_QUEUED_MESSAGE* pQueued = NULL;
+
+    if (pQueue->hForwarderThread)
+    {
+        // The forwarder delivers whatever is still queued before it exits.
+        ::EnterCriticalSection(&pQueue->csQueue);
+        pQueue->fStop = TRUE;
+        ::SetEvent(pQueue->hMessagesQueued);
+        ::LeaveCriticalSection(&pQueue->csQueue);
+
+        ::WaitForSingleObject(pQueue->hForwarderThread, INFINITE);
+        ReleaseHandle(pQueue->hForwarderThread);
+    }
+
+    while (pQueue->pHead)
+    {
+        pQueued = pQueue->pHead;
+        pQueue->pHead = pQueued->pNext;
+
+        FreeQueuedMessage(pQueued);
+    }
+
+    ReleaseHandle(pQueue->hSpaceAvailable);
+    ReleaseHandle(pQueue->hIdle);
+    ReleaseHandle(pQueue->hMessagesQueued);
+    ::DeleteCriticalSection(&pQueue->csQueue);
+
+    MemFree(pQueue);
+}
+
+static INT SendExecuteMessage(
+    __in WIU_MSI_EXECUTE_CONTEXT* pContext,
+    __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
+    __in BOOL fNeedsResult,
+    __deref_opt_inout_ecount_opt(pMessage->cData) LPWSTR** prgsczData
+    )
+{
+    HRESULT hr = S_OK;
+    INT nResult = IDNOACTION;
+    WIU_MSI_MESSAGE_QUEUE* pQueue = pContext->pMessageQueue;
+
+    if (pQueue && !fNeedsResult)
+    {
+        hr = QueueExecuteMessage(pQueue, pMessage, prgsczData);
+        if (SUCCEEDED(hr))
+        {
+            // Hand back a cancel from an earlier queued message, otherwise Windows Installer carries on.
+            ::EnterCriticalSection(&pQueue->csQueue);
+            nResult = pQueue->nPendingResult;
+            pQueue->nPendingResult = IDNOACTION;
+            ::LeaveCriticalSection(&pQueue->csQueue);
+
+            ExitFunction();
+        }
+    }
+
+    // Keep the handler single threaded and the messages in order by letting the forwarder finish first.
+    if (pQueue)
+    {
+        ::WaitForSingleObject(pQueue->hIdle, INFINITE);
+
+        // A cancel from a queued message wins over asking the user anything else.
+        ::EnterCriticalSection(&pQueue->csQueue);
+        nResult = pQueue->nPendingResult;
+        pQueue->nPendingResult = IDNOACTION;
+        ::LeaveCriticalSection(&pQueue->csQueue);
+
+        if (IDNOACTION != nResult)
+        {
+            ExitFunction();
+        }
+    }
+
+    nResult = pContext->pfnMessageHandler(pMessage, pContext->pvContext);
+
+LExit:
+    return nResult;
+}
+
+static HRESULT QueueExecuteMessage(
+    __in WIU_MSI_MESSAGE_QUEUE* pQueue,
+    __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
+    __deref_opt_inout_ecount_opt(pMessage->cData) LPWSTR** prgsczData
+    )
+{
+    HRESULT hr = S_OK;
+    WIU_MSI_QUEUED_MESSAGE* pQueued = NULL;
+    WIU_MSI_QUEUED_MESSAGE replaced = { };
+
+    pQueued = static_cast<WIU_MSI_QUEUED_MESSAGE*>(MemAlloc(sizeof(WIU_MSI_QUEUED_MESSAGE), TRUE));
+    WiuExitOnNull(pQueued, hr, E_OUTOFMEMORY, "Failed to allocate queued MSI message.");
+
+    pQueued->message = *pMessage;
+
+    if (WIU_MSI_EXECUTE_MESSAGE_MSI_MESSAGE == pMessage->type && pMessage->msiMessage.wzMessage)
+    {
+        hr = StrAllocString(&pQueued->sczMessage, pMessage->msiMessage.wzMessage, 0);
+        WiuExitOnFailure(hr, "Failed to copy queued MSI message.");
+
+        pQueued->message.msiMessage.wzMessage = pQueued->sczMessage;
+    }
+
+    // The record data was allocated for this message so the queue takes it over rather than copying it.
+    if (prgsczData)
+    {
+        pQueued->rgsczData = *prgsczData;
+        pQueued->message.rgwzData = (LPCWSTR*)pQueued->rgsczData;
+        *prgsczData = NULL;
+    }
+
+    ::EnterCriticalSection(&pQueue->csQueue);
+
+    if (pQueue->pTail && ReplacesQueuedMessage(&pQueue->pTail->message, pMessage))
+    {
+        // Overwrite the stale message in place and free what it held once the lock is released.
+        replaced = *pQueue->pTail;
+        *pQueue->pTail = *pQueued;
+        *pQueued = replaced;
+    }
+    else
+    {
+        // Hold Windows Installer back while the handler is behind rather than letting the queue grow without limit.
+        while (WIU_MSI_MESSAGE_QUEUE_LIMIT <= pQueue->cQueued)
+        {
+            ::ResetEvent(pQueue->hSpaceAvailable);
+            ::LeaveCriticalSection(&pQueue->csQueue);
+
+            ::WaitForSingleObject(pQueue->hSpaceAvailable, INFINITE);
+
+            ::EnterCriticalSection(&pQueue->csQueue);
+        }
+
+        if (pQueue->pTail)
+        {
+            pQueue->pTail->pNext = pQueued;
+        }
+        else
+        {
+            pQueue->pHead = pQueued;
+        }
+
+        pQueue->pTail = pQueued;
+        ++pQueue->cQueued;
+        pQueued = NULL;
+
+        ::ResetEvent(pQueue->hIdle);
+        ::SetEvent(pQueue->hMessagesQueued);
+    }
+
+    ::LeaveCriticalSection(&pQueue->csQueue);
+
+LExit:
+    if (pQueued)
+    {
+        FreeQueuedMessage(pQueued);
+    }
+
+    return hr;
+}
+
+static DWORD WINAPI MessageForwarderThread(
+    __in LPVOID pvContext
+    )
+{
+    WIU_MSI_MESSAGE_QUEUE* pQueue = static_cast<WIU_MSI_MESSAGE_QUEUE*>(pvContext);
+    WIU_MSI_QUEUED_MESSAGE* pBatch = NULL;
+    WIU_MSI_QUEUED_MESSAGE* pQueued = NULL;
+    BOOL fStop = FALSE;
+    INT nResult = IDNOACTION;
+
+    while (!fStop)
+    {
+        ::WaitForSingleObject(pQueue->hMessagesQueued, INFINITE);
+
+        // Take everything queued so far in one go so the Windows Installer thread is only held up by the lock for a moment.
+        ::EnterCriticalSection(&pQueue->csQueue);
+        pBatch = pQueue->pHead;
+        pQueue->pHead = NULL;
+        pQueue->pTail = NULL;
+        pQueue->cQueued = 0;
+        fStop = pQueue->fStop;
+        ::SetEvent(pQueue->hSpaceAvailable);
+        ::LeaveCriticalSection(&pQueue->csQueue);
+
+        // The Windows Installer thread waits on hIdle before calling the handler itself and
+        // DestroyMessageQueue() joins this thread, so handler calls never overlap and anything
+        // the handler throttles or caches stays effectively single threaded.
+        while (pBatch)
+        {
+            pQueued = pBatch;
+            pBatch = pQueued->pNext;
+
+            nResult = pQueue->pfnMessageHandler(&pQueued->message, pQueue->pvContext);
+            if (IDCANCEL == nResult || IDABORT == nResult)
+            {
+                ::EnterCriticalSection(&pQueue->csQueue);
+                if (IDNOACTION == pQueue->nPendingResult)
+                {
+                    pQueue->nPendingResult = nResult;
+                }
+                ::LeaveCriticalSection(&pQueue->csQueue);
+            }
+
+            FreeQueuedMessage(pQueued);
+        }
+
+        ::EnterCriticalSection(&pQueue->csQueue);
+        if (!pQueue->pHead)
+        {
+            ::SetEvent(pQueue->hIdle);
+        }
+        ::LeaveCriticalSection(&pQueue->csQueue);
+    }
+
+    return 0;
+}
+
+static BOOL ReplacesQueuedMessage(
+    __in const WIU_MSI_EXECUTE_MESSAGE* pQueuedMessage,
+    __in const WIU_MSI_EXECUTE_MESSAGE* pMessage
+    )
+{
+    BOOL fReplaces = FALSE;
+
+    // Only the last of a run of progress updates, or of action data for the current action, is worth reporting.
+    if (pQueuedMessage->type == pMessage->type)
+    {
+        if (WIU_MSI_EXECUTE_MESSAGE_PROGRESS == pMessage->type)
+        {
+            fReplaces = TRUE;
+        }
+        else if (WIU_MSI_EXECUTE_MESSAGE_MSI_MESSAGE == pMessage->type)
+        {
+            fReplaces = INSTALLMESSAGE_ACTIONDATA == pQueuedMessage->msiMessage.mt && INSTALLMESSAGE_ACTIONDATA == pMessage->msiMessage.mt;
+        }
+    }
+
+    return fReplaces;
+}
+
+static void FreeQueuedMessage(
+    __in WIU_MSI_QUEUED_MESSAGE* pQueued
+    )
+{
+    ReleaseStr(pQueued->sczMessage);
+    UninitializeMessageData(pQueued->rgsczData, pQueued->message.cData);
+    MemFree(pQueued);
+}
@@ -3,7 +3,11 @@
 #include "precomp.h"
 
 using namespace System;
+using namespace System::Diagnostics;
+using namespace System::IO;
+using namespace System::Text;
 using namespace Xunit;
+using namespace Xunit::Abstractions;
 using namespace WixBuildTools::TestSupport;
 
 typedef HRESULT (__clrcall *IniFormatParameters)(
@@ -342,4 +346,159 @@ namespace DutilTests
             }
         }
     };
+
+    public ref class IniUtilBenchmark
+    {
+    public:
+        IniUtilBenchmark(ITestOutputHelper^ output)
+        {
+            this->output = output;
+        }
+
+        [Fact]
+        void IniParseAndLookupBenchmark()
+        {
+            const DWORD cSections = 200;
+            const DWORD cValuesPerSection = 250;
+            const DWORD cLinearLookups = 500;
+            HRESULT hr = S_OK;
+            INI_HANDLE iniHandle = NULL;
+            INI_VALUE *rgValues = NULL;
+            DWORD cValues = 0;
+            LPWSTR sczName = NULL;
+            LPWSTR sczValue = NULL;
+            LPWSTR sczExpected = NULL;
+            String^ iniFile = Path::Combine(Path::GetTempPath(), Path::GetRandomFileName());
+            StringBuilder^ ini = gcnew StringBuilder();
+            Stopwatch^ parse = gcnew Stopwatch();
+            Stopwatch^ linear = gcnew Stopwatch();
+            Stopwatch^ indexed = gcnew Stopwatch();
+            Stopwatch^ set = gcnew Stopwatch();
+            Stopwatch^ write = gcnew Stopwatch();
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                for (DWORD i = 0; i < cSections; ++i)
+                {
+                    ini->AppendFormat("[Section{0}]\r\n; Comment for section {0}\r\n", i);
+                    for (DWORD j = 0; j < cValuesPerSection; ++j)
+                    {
+                        ini->AppendFormat("Value{0} = Some value {1}.{0}\r\n", j, i);
+                    }
+                }
+
+                File::WriteAllText(iniFile, ini->ToString());
+
+                hr = IniInitialize(&iniHandle);
+                NativeAssert::Succeeded(hr, "Failed to initialize INI object");
+
+                hr = IniSetOpenTag(iniHandle, L"[", L"]");
+                NativeAssert::Succeeded(hr, "Failed to set open tag settings on ini handle");
+
+                hr = IniSetValueStyle(iniHandle, NULL, L"=");
+                NativeAssert::Succeeded(hr, "Failed to set value separator setting on ini handle");
+
+                hr = IniSetCommentStyle(iniHandle, L";");
+                NativeAssert::Succeeded(hr, "Failed to set comment style setting on ini handle");
+
+                pin_ptr<const wchar_t> wzIniFile = PtrToStringChars(iniFile);
+                parse->Start();
+                hr = IniParse(iniHandle, wzIniFile, NULL);
+                parse->Stop();
+                NativeAssert::Succeeded(hr, "Failed to parse INI file");
+
+                hr = IniGetValueList(iniHandle, &rgValues, &cValues);
+                NativeAssert::Succeeded(hr, "Failed to get list of values in INI");
+                NativeAssert::Equal<DWORD>(cSections * cValuesPerSection, cValues);
+
+                for (DWORD i = 0; i < cSections * cValuesPerSection; ++i)
+                {
+                    hr = StrAllocFormatted(&sczName, L"Section%u\\Value%u", (i * 7) % cSections, (i * 13) % cValuesPerSection);
+                    NativeAssert::Succeeded(hr, "Failed to format name");
+
+                    hr = StrAllocFormatted(&sczExpected, L"Some value %u.%u", (i * 7) % cSections, (i * 13) % cValuesPerSection);
+                    NativeAssert::Succeeded(hr, "Failed to format value");
+
+                    // The previous implementation compared every name in turn.
+                    if (i < cLinearLookups)
+                    {
+                        linear->Start();
+                        for (DWORD j = 0; j < cValues; ++j)
+                        {
+                            if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, rgValues[j].wzName, -1, sczName, -1))
+                            {
+                                break;
+                            }
+                        }
+                        linear->Stop();
+                    }
+
+                    indexed->Start();
+                    hr = IniGetValue(iniHandle, sczName, &sczValue);
+                    indexed->Stop();
+                    NativeAssert::Succeeded(hr, "Failed to get ini value: {0}", sczName);
+                    NativeAssert::StringEqual(sczExpected, sczValue);
+
+                    set->Start();
+                    hr = IniSetValue(iniHandle, sczName, L"Updated value");
+                    set->Stop();
+                    NativeAssert::Succeeded(hr, "Failed to set ini value: {0}", sczName);
+                }
+
+                hr = IniSetValue(iniHandle, L"Section0\\Added", L"Added value");
+                NativeAssert::Succeeded(hr, "Failed to add ini value");
+
+                write->Start();
+                hr = IniWriteFile(iniHandle, NULL, FILE_ENCODING_UNSPECIFIED);
+                write->Stop();
+                NativeAssert::Succeeded(hr, "Failed to write ini file back out to disk");
+
+                ReleaseNullIni(iniHandle);
+
+                hr = IniInitialize(&iniHandle);
+                NativeAssert::Succeeded(hr, "Failed to initialize INI object");
+
+                hr = IniSetOpenTag(iniHandle, L"[", L"]");
+                NativeAssert::Succeeded(hr, "Failed to set open tag settings on ini handle");
+
+                hr = IniSetValueStyle(iniHandle, NULL, L"=");
+                NativeAssert::Succeeded(hr, "Failed to set value separator setting on ini handle");
+
+                hr = IniSetCommentStyle(iniHandle, L";");
+                NativeAssert::Succeeded(hr, "Failed to set comment style setting on ini handle");
+
+                hr = IniParse(iniHandle, wzIniFile, NULL);
+                NativeAssert::Succeeded(hr, "Failed to parse INI file");
+
+                hr = IniGetValueList(iniHandle, &rgValues, &cValues);
+                NativeAssert::Succeeded(hr, "Failed to get list of values in INI");
+                NativeAssert::Equal<DWORD>(cSections * cValuesPerSection + 1, cValues);
+
+                hr = IniGetValue(iniHandle, L"Section0\\Added", &sczValue);
+                NativeAssert::Succeeded(hr, "Failed to get added ini value");
+                NativeAssert::StringEqual(L"Added value", sczValue);
+
+                this->output->WriteLine("{0} values: parse {1} ms, {2} linear lookups {3} ms, {0} indexed lookups {4} ms, {0} updates {5} ms, write {6} ms",
+                    cValues - 1, parse->ElapsedMilliseconds, cLinearLookups, linear->ElapsedMilliseconds, indexed->ElapsedMilliseconds, set->ElapsedMilliseconds, write->ElapsedMilliseconds);
+            }
+            finally
+            {
+                ReleaseStr(sczName);
+                ReleaseStr(sczValue);
+                ReleaseStr(sczExpected);
+                ReleaseIni(iniHandle);
+                DutilUninitialize();
+
+                if (File::Exists(iniFile))
+                {
+                    File::Delete(iniFile);
+                }
+            }
+        }
+
+    private:
+        ITestOutputHelper^ output;
+    };
 }
@@ -0,0 +1,465 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace System::Diagnostics;
+using namespace System::IO;
+using namespace System::Text;
+using namespace Xunit;
+using namespace Xunit::Abstractions;
+using namespace WixBuildTools::TestSupport;
+
+namespace DutilTests
+{
+    public ref class JsonUtil
+    {
+    public:
+        [Fact]
+        void JsonUtilReadTokensTest()
+        {
+            HRESULT hr = S_OK;
+            JSON_READER reader = { };
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+            JSON_VALUE value = { };
+            LPWSTR sczValue = NULL;
+            LONGLONG llValue = 0;
+            DWORD64 qwValue = 0;
+            double dValue = 0;
+            BOOL fValue = FALSE;
+            BOOL fJsonInitialized = FALSE;
+            const char szJson[] = "\xEF\xBB\xBF { \"name\" : \"plain\", \"escaped\":\"a\\\"b\\\\c\\u00e9\\ud83d\\ude00\\n\", \"list\":[-12, 18446744073709551615, 1.5e2, true, null, {}], \"utf8\":\"\xC3\xA9\" }\r\n";
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = JsonInitialize();
+                NativeAssert::Succeeded(hr, "Failed to initialize JSON.");
+                fJsonInitialized = TRUE;
+
+                hr = JsonInitializeReaderFromBuffer(reinterpret_cast<const BYTE*>(szJson), sizeof(szJson) - 1, &reader);
+                NativeAssert::Succeeded(hr, "Failed to initialize reader.");
+
+                ReadToken(&reader, JSON_TOKEN_OBJECT_START, &value);
+
+                ReadToken(&reader, JSON_TOKEN_OBJECT_KEY, &value);
+                Assert::Equal<SIZE_T>(4, value.cch);
+                Assert::True(0 == memcmp("name", value.pch, 4));
+
+                // Unescaped strings are views into the buffer.
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                Assert::Equal<int>(JSON_VALUE_TYPE_STRING, value.type);
+                Assert::False(value.fEscaped);
+                Assert::True(value.pch > szJson && value.pch < szJson + sizeof(szJson));
+                Assert::True(0 == memcmp("plain", value.pch, 5));
+
+                ReadToken(&reader, JSON_TOKEN_OBJECT_KEY, &value);
+
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                Assert::True(value.fEscaped);
+
+                hr = JsonValueGetString(&value, &sczValue);
+                NativeAssert::Succeeded(hr, "Failed to decode escaped string.");
+                NativeAssert::StringEqual(L"a\"b\\c\x00e9\xd83d\xde00\n", sczValue);
+
+                ReadToken(&reader, JSON_TOKEN_OBJECT_KEY, &value);
+                ReadToken(&reader, JSON_TOKEN_ARRAY_START, &value);
+
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                hr = JsonValueGetInteger64(&value, &llValue);
+                NativeAssert::Succeeded(hr, "Failed to get negative integer.");
+                Assert::Equal<LONGLONG>(-12, llValue);
+
+                hr = JsonValueGetNumber64(&value, &qwValue);
+                NativeAssert::SpecificReturnCode(HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW), hr, "Expected negative number to not fit an unsigned value.");
+
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                hr = JsonValueGetNumber64(&value, &qwValue);
+                NativeAssert::Succeeded(hr, "Failed to get largest unsigned integer.");
+                Assert::Equal<DWORD64>(18446744073709551615ui64, qwValue);
+
+                hr = JsonValueGetInteger64(&value, &llValue);
+                Assert::True(FAILED(hr));
+
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                hr = JsonValueGetInteger64(&value, &llValue);
+                NativeAssert::SpecificReturnCode(E_INVALIDDATA, hr, "Expected fraction to not be an integer.");
+
+                hr = JsonValueGetDouble(&value, &dValue);
+                NativeAssert::Succeeded(hr, "Failed to get double.");
+                Assert::Equal(150.0, dValue);
+
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                hr = JsonValueGetBool(&value, &fValue);
+                NativeAssert::Succeeded(hr, "Failed to get boolean.");
+                Assert::True(fValue);
+
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                Assert::Equal<int>(JSON_VALUE_TYPE_NULL, value.type);
+
+                ReadToken(&reader, JSON_TOKEN_OBJECT_START, &value);
+                ReadToken(&reader, JSON_TOKEN_OBJECT_END, &value);
+                ReadToken(&reader, JSON_TOKEN_ARRAY_END, &value);
+
+                ReadToken(&reader, JSON_TOKEN_OBJECT_KEY, &value);
+                ReadToken(&reader, JSON_TOKEN_VALUE, &value);
+                hr = JsonValueGetString(&value, &sczValue);
+                NativeAssert::Succeeded(hr, "Failed to decode UTF-8 string.");
+                NativeAssert::StringEqual(L"\x00e9", sczValue);
+
+                ReadToken(&reader, JSON_TOKEN_OBJECT_END, &value);
+
+                hr = JsonReadNext(&reader, &token, &value);
+                NativeAssert::SpecificReturnCode(E_NOMOREITEMS, hr, "Expected end of JSON.");
+            }
+            finally
+            {
+                ReleaseStr(sczValue);
+                JsonUninitializeReader(&reader);
+                if (fJsonInitialized)
+                {
+                    JsonUninitialize();
+                }
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void JsonUtilReadInvalidTest()
+        {
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                ExpectInvalid(L"[1,]");
+                ExpectInvalid(L"{\"a\" 1}");
+                ExpectInvalid(L"{\"a\":1,}");
+                ExpectInvalid(L"[1 2]");
+                ExpectInvalid(L"[01]");
+                ExpectInvalid(L"[1.]");
+                ExpectInvalid(L"[tru]");
+                ExpectInvalid(L"[\"open");
+                ExpectInvalid(L"{\"a\":[}");
+                ExpectInvalid(L"1 2");
+            }
+            finally
+            {
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void JsonUtilStreamFileTest()
+        {
+            HRESULT hr = S_OK;
+            JSON_WRITER writer = { };
+            JSON_READER reader = { };
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+            JSON_VALUE value = { };
+            LPWSTR sczLong = NULL;
+            LPWSTR sczValue = NULL;
+            DWORD dwValue = 0;
+            DWORD cValues = 0;
+            BOOL fWriterInitialized = FALSE;
+            BOOL fReaderInitialized = FALSE;
+            String^ jsonFile = Path::Combine(Path::GetTempPath(), Path::GetRandomFileName());
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                pin_ptr<const wchar_t> wzJsonFile = PtrToStringChars(jsonFile);
+
+                // A string longer than the read buffer forces the reader to grow it.
+                hr = StrAlloc(&sczLong, 200001);
+                NativeAssert::Succeeded(hr, "Failed to allocate long string.");
+
+                for (DWORD i = 0; i < 200000; ++i)
+                {
+                    sczLong[i] = 0 == i % 2 ? L'\x00e9' : L'/';
+                }
+                sczLong[200000] = L'\0';
+
+                hr = JsonInitializeWriterToFile(wzJsonFile, &writer);
+                NativeAssert::Succeeded(hr, "Failed to initialize file writer.");
+                fWriterInitialized = TRUE;
+
+                hr = JsonWriteArrayStart(&writer);
+                NativeAssert::Succeeded(hr, "Failed to start array.");
+
+                for (DWORD i = 0; i < 10000; ++i)
+                {
+                    hr = JsonWriteNumber(&writer, i);
+                    NativeAssert::Succeeded(hr, "Failed to write number.");
+                }
+
+                hr = JsonWriteString(&writer, sczLong);
+                NativeAssert::Succeeded(hr, "Failed to write long string.");
+
+                hr = JsonWriteArrayEnd(&writer);
+                NativeAssert::Succeeded(hr, "Failed to end array.");
+
+                hr = JsonFlushWriter(&writer);
+                NativeAssert::Succeeded(hr, "Failed to flush writer.");
+
+                JsonUninitializeWriter(&writer);
+                fWriterInitialized = FALSE;
+
+                hr = JsonInitializeReaderFromFile(wzJsonFile, &reader);
+                NativeAssert::Succeeded(hr, "Failed to initialize file reader.");
+                fReaderInitialized = TRUE;
+
+                ReadToken(&reader, JSON_TOKEN_ARRAY_START, &value);
+
+                for (;;)
+                {
+                    hr = JsonReadNext(&reader, &token, &value);
+                    NativeAssert::Succeeded(hr, "Failed to read array item.");
+
+                    if (JSON_VALUE_TYPE_NUMBER != value.type)
+                    {
+                        break;
+                    }
+
+                    hr = JsonValueGetNumber(&value, &dwValue);
+                    NativeAssert::Succeeded(hr, "Failed to get number.");
+                    Assert::Equal(cValues, dwValue);
+                    ++cValues;
+                }
+
+                Assert::Equal<DWORD>(10000, cValues);
+                Assert::Equal<int>(JSON_VALUE_TYPE_STRING, value.type);
+
+                hr = JsonValueGetString(&value, &sczValue);
+                NativeAssert::Succeeded(hr, "Failed to get long string.");
+                NativeAssert::StringEqual(sczLong, sczValue);
+
+                ReadToken(&reader, JSON_TOKEN_ARRAY_END, &value);
+
+                hr = JsonReadNext(&reader, &token, &value);
+                NativeAssert::SpecificReturnCode(E_NOMOREITEMS, hr, "Expected end of JSON.");
+            }
+            finally
+            {
+                ReleaseStr(sczValue);
+                ReleaseStr(sczLong);
+                if (fReaderInitialized)
+                {
+                    JsonUninitializeReader(&reader);
+                }
+
+                if (fWriterInitialized)
+                {
+                    JsonUninitializeWriter(&writer);
+                }
+
+                DutilUninitialize();
+
+                if (File::Exists(jsonFile))
+                {
+                    File::Delete(jsonFile);
+                }
+            }
+        }
+
+    private:
+        void ReadToken(JSON_READER* pReader, JSON_TOKEN expectedToken, JSON_VALUE* pValue)
+        {
+            HRESULT hr = S_OK;
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+
+            hr = JsonReadNext(pReader, &token, pValue);
+            NativeAssert::Succeeded(hr, "Failed to read token.");
+            Assert::Equal<int>(expectedToken, token);
+        }
+
+        void ExpectInvalid(LPCWSTR wzJson)
+        {
+            HRESULT hr = S_OK;
+            JSON_READER reader = { };
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+            JSON_VALUE value = { };
+
+            try
+            {
+                hr = JsonInitializeReader(wzJson, &reader);
+                NativeAssert::Succeeded(hr, "Failed to initialize reader.");
+
+                do
+                {
+                    hr = JsonReadNext(&reader, &token, &value);
+                } while (SUCCEEDED(hr));
+
+                NativeAssert::SpecificReturnCode(E_INVALIDDATA, hr, "Expected invalid JSON: {0}", gcnew String(wzJson));
+            }
+            finally
+            {
+                JsonUninitializeReader(&reader);
+            }
+        }
+    };
+
+    public ref class JsonUtilBenchmark
+    {
+    public:
+        JsonUtilBenchmark(ITestOutputHelper^ output)
+        {
+            this->output = output;
+        }
+
+        [Fact]
+        void JsonStreamFiftyMegabyteBenchmark()
+        {
+            const DWORD64 cbTarget = 50 * 1024 * 1024;
+            HRESULT hr = S_OK;
+            JSON_WRITER writer = { };
+            JSON_READER reader = { };
+            JSON_TOKEN token = JSON_TOKEN_NONE;
+            JSON_VALUE value = { };
+            DWORD cRecords = 0;
+            DWORD cStrings = 0;
+            DWORD64 qwSum = 0;
+            DWORD64 qwExpectedSum = 0;
+            DWORD64 qwValue = 0;
+            BOOL fWriterInitialized = FALSE;
+            BOOL fReaderInitialized = FALSE;
+            String^ jsonFile = Path::Combine(Path::GetTempPath(), Path::GetRandomFileName());
+            Stopwatch^ write = gcnew Stopwatch();
+            Stopwatch^ read = gcnew Stopwatch();
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                pin_ptr<const wchar_t> wzJsonFile = PtrToStringChars(jsonFile);
+
+                write->Start();
+                hr = JsonInitializeWriterToFile(wzJsonFile, &writer);
+                NativeAssert::Succeeded(hr, "Failed to initialize file writer.");
+                fWriterInitialized = TRUE;
+
+                hr = JsonWriteArrayStart(&writer);
+                NativeAssert::Succeeded(hr, "Failed to start array.");
+
+                // Records look like trace events: a few keys, strings and numbers.
+                for (; static_cast<DWORD64>(cRecords) * 128 < cbTarget; ++cRecords)
+                {
+                    WriteRecord(&writer, cRecords);
+                    qwExpectedSum += cRecords;
+                }
+
+                hr = JsonWriteArrayEnd(&writer);
+                NativeAssert::Succeeded(hr, "Failed to end array.");
+
+                hr = JsonFlushWriter(&writer);
+                NativeAssert::Succeeded(hr, "Failed to flush writer.");
+
+                JsonUninitializeWriter(&writer);
+                fWriterInitialized = FALSE;
+                write->Stop();
+
+                Int64 cbFile = (gcnew FileInfo(jsonFile))->Length;
+                Assert::True(cbFile >= static_cast<Int64>(cbTarget));
+
+                read->Start();
+                hr = JsonInitializeReaderFromFile(wzJsonFile, &reader);
+                NativeAssert::Succeeded(hr, "Failed to initialize file reader.");
+                fReaderInitialized = TRUE;
+
+                for (;;)
+                {
+                    hr = JsonReadNext(&reader, &token, &value);
+                    if (E_NOMOREITEMS == hr)
+                    {
+                        break;
+                    }
+                    NativeAssert::Succeeded(hr, "Failed to read token.");
+
+                    if (JSON_TOKEN_OBJECT_KEY == token && 2 == value.cch && 0 == memcmp("id", value.pch, 2))
+                    {
+                        hr = JsonReadValue(&reader, &value);
+                        NativeAssert::Succeeded(hr, "Failed to read id.");
+
+                        hr = JsonValueGetNumber64(&value, &qwValue);
+                        NativeAssert::Succeeded(hr, "Failed to get id.");
+
+                        qwSum += qwValue;
+                    }
+                    else if (JSON_TOKEN_VALUE == token && JSON_VALUE_TYPE_STRING == value.type)
+                    {
+                        ++cStrings;
+                    }
+                    else if (JSON_TOKEN_VALUE == token && JSON_VALUE_TYPE_NUMBER == value.type)
+                    {
+                        hr = JsonValueGetNumber64(&value, &qwValue);
+                        NativeAssert::Succeeded(hr, "Failed to get timestamp.");
+                    }
+                }
+                read->Stop();
+
+                Assert::Equal(qwExpectedSum, qwSum);
+                Assert::Equal(cRecords * 2, cStrings);
+
+                this->output->WriteLine("{0} records, {1} bytes: write {2} ms, read {3} ms ({4} MB/s)", cRecords, cbFile, write->ElapsedMilliseconds, read->ElapsedMilliseconds, read->ElapsedMilliseconds ? cbFile / 1024 / 1024 * 1000 / read->ElapsedMilliseconds : 0);
+            }
+            finally
+            {
+                if (fReaderInitialized)
+                {
+                    JsonUninitializeReader(&reader);
+                }
+
+                if (fWriterInitialized)
+                {
+                    JsonUninitializeWriter(&writer);
+                }
+
+                DutilUninitialize();
+
+                if (File::Exists(jsonFile))
+                {
+                    File::Delete(jsonFile);
+                }
+            }
+        }
+
+    private:
+        void WriteRecord(JSON_WRITER* pWriter, DWORD dwRecord)
+        {
+            HRESULT hr = S_OK;
+
+            hr = JsonWriteObjectStart(pWriter);
+            NativeAssert::Succeeded(hr, "Failed to start record.");
+
+            hr = JsonWriteObjectKey(pWriter, L"id");
+            NativeAssert::Succeeded(hr, "Failed to write id key.");
+
+            hr = JsonWriteNumber(pWriter, dwRecord);
+            NativeAssert::Succeeded(hr, "Failed to write id.");
+
+            hr = JsonWriteObjectKey(pWriter, L"name");
+            NativeAssert::Succeeded(hr, "Failed to write name key.");
+
+            hr = JsonWriteString(pWriter, L"ExecuteMsiPackage");
+            NativeAssert::Succeeded(hr, "Failed to write name.");
+
+            hr = JsonWriteObjectKey(pWriter, L"path");
+            NativeAssert::Succeeded(hr, "Failed to write path key.");
+
+            hr = JsonWriteString(pWriter, L"C:\\ProgramData\\Package Cache\\{GUID}\\package.msi");
+            NativeAssert::Succeeded(hr, "Failed to write path.");
+
+            hr = JsonWriteObjectKey(pWriter, L"ts");
+            NativeAssert::Succeeded(hr, "Failed to write timestamp key.");
+
+            hr = JsonWriteNumber64(pWriter, 1000000000ui64 + dwRecord * 17ui64);
+            NativeAssert::Succeeded(hr, "Failed to write timestamp.");
+
+            hr = JsonWriteObjectEnd(pWriter);
+            NativeAssert::Succeeded(hr, "Failed to end record.");
+        }
+
+        ITestOutputHelper^ output;
+    };
+}
@@ -0,0 +1,182 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace System::Diagnostics;
+using namespace System::IO;
+using namespace System::Text;
+using namespace Xunit;
+using namespace Xunit::Abstractions;
+using namespace WixBuildTools::TestSupport;
+
+namespace DutilTests
+{
+    public ref class LocUtil
+    {
+    public:
+        [Fact]
+        void LocUtilLocalizeStringTest()
+        {
+            HRESULT hr = S_OK;
+            WIX_LOCALIZATION* pWixLoc = NULL;
+            LOC_STRING* pLocString = NULL;
+            LOC_CONTROL* pLocControl = NULL;
+            LPWSTR sczText = NULL;
+            String^ wxlFile = Path::Combine(Path::GetTempPath(), Path::GetRandomFileName());
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = XmlInitialize();
+                NativeAssert::Succeeded(hr, "Failed to initialize Xml.");
+
+                File::WriteAllText(wxlFile,
+                    "<WixLocalization Language='1033'>"
+                    "<String Id='Alpha'>Alpha text</String>"
+                    "<String Id='Beta'>Beta has #(loc.Alpha)</String>"
+                    "<String Id='Alpha'>Duplicate Alpha</String>"
+                    "<UI Control='Button' X='1' Y='2'>Button text</UI>"
+                    "</WixLocalization>");
+
+                pin_ptr<const wchar_t> wzWxlFile = PtrToStringChars(wxlFile);
+                hr = LocLoadFromFile(wzWxlFile, &pWixLoc);
+                NativeAssert::Succeeded(hr, "Failed to load localization file.");
+
+                hr = StrAllocString(&sczText, L"#(loc.Alpha), #(loc.Beta), #(loc.Missing), #(loc.Alpha", 0);
+                NativeAssert::Succeeded(hr, "Failed to allocate text.");
+
+                hr = LocLocalizeString(pWixLoc, &sczText);
+                NativeAssert::Succeeded(hr, "Failed to localize text.");
+                NativeAssert::StringEqual(L"Alpha text, Beta has #(loc.Alpha), #(loc.Missing), #(loc.Alpha", sczText);
+
+                hr = LocGetString(pWixLoc, L"#(loc.Alpha)", &pLocString);
+                NativeAssert::Succeeded(hr, "Failed to get Alpha string.");
+                NativeAssert::StringEqual(L"Alpha text", pLocString->wzText);
+
+                hr = LocGetString(pWixLoc, L"#(loc.alpha)", &pLocString);
+                NativeAssert::SpecificReturnCode(E_NOTFOUND, hr, "Expected string ids to be case sensitive.");
+
+                hr = LocGetControl(pWixLoc, L"Button", &pLocControl);
+                NativeAssert::Succeeded(hr, "Failed to get Button control.");
+                Assert::Equal(2, pLocControl->nY);
+                NativeAssert::StringEqual(L"Button text", pLocControl->wzText);
+
+                hr = LocAddString(pWixLoc, L"Gamma", L"Gamma text", FALSE);
+                NativeAssert::Succeeded(hr, "Failed to add Gamma string.");
+
+                hr = LocAddString(pWixLoc, L"Alpha", L"Ignored Alpha", FALSE);
+                NativeAssert::Succeeded(hr, "Failed to add another Alpha string.");
+
+                hr = StrAllocString(&sczText, L"#(loc.Gamma) #(loc.Alpha)", 0);
+                NativeAssert::Succeeded(hr, "Failed to allocate text.");
+
+                hr = LocLocalizeString(pWixLoc, &sczText);
+                NativeAssert::Succeeded(hr, "Failed to localize text.");
+                NativeAssert::StringEqual(L"Gamma text Alpha text", sczText);
+            }
+            finally
+            {
+                ReleaseStr(sczText);
+                LocFree(pWixLoc);
+                XmlUninitialize();
+                DutilUninitialize();
+
+                if (File::Exists(wxlFile))
+                {
+                    File::Delete(wxlFile);
+                }
+            }
+        }
+    };
+
+    public ref class LocUtilBenchmark
+    {
+    public:
+        LocUtilBenchmark(ITestOutputHelper^ output)
+        {
+            this->output = output;
+        }
+
+        [Fact]
+        void LocLocalizeStringBenchmark()
+        {
+            const DWORD cStrings = 5000;
+            const DWORD cTexts = 500;
+            HRESULT hr = S_OK;
+            WIX_LOCALIZATION* pWixLoc = NULL;
+            LPWSTR sczExpected = NULL;
+            LPWSTR sczActual = NULL;
+            String^ wxlFile = Path::Combine(Path::GetTempPath(), Path::GetRandomFileName());
+            StringBuilder^ wxl = gcnew StringBuilder();
+            Stopwatch^ linear = gcnew Stopwatch();
+            Stopwatch^ indexed = gcnew Stopwatch();
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = XmlInitialize();
+                NativeAssert::Succeeded(hr, "Failed to initialize Xml.");
+
+                wxl->Append("<WixLocalization Language='1033'>");
+                for (DWORD i = 0; i < cStrings; ++i)
+                {
+                    wxl->AppendFormat("<String Id='String{0}'>Localized text for string {0}</String>", i);
+                }
+                wxl->Append("</WixLocalization>");
+
+                File::WriteAllText(wxlFile, wxl->ToString());
+
+                pin_ptr<const wchar_t> wzWxlFile = PtrToStringChars(wxlFile);
+                hr = LocLoadFromFile(wzWxlFile, &pWixLoc);
+                NativeAssert::Succeeded(hr, "Failed to load localization file.");
+                Assert::Equal(cStrings, pWixLoc->cLocStrings);
+
+                for (DWORD i = 0; i < cTexts; ++i)
+                {
+                    hr = StrAllocFormatted(&sczExpected, L"Control %u: #(loc.String%u) [#(loc.String%u)]", i, (i * 7) % cStrings, (i * 13) % cStrings);
+                    NativeAssert::Succeeded(hr, "Failed to format text.");
+
+                    hr = StrAllocString(&sczActual, sczExpected, 0);
+                    NativeAssert::Succeeded(hr, "Failed to copy text.");
+
+                    // The previous implementation replaced every string id in turn.
+                    linear->Start();
+                    for (DWORD j = 0; j < pWixLoc->cLocStrings; ++j)
+                    {
+                        hr = StrReplaceStringAll(&sczExpected, pWixLoc->rgLocStrings[j].wzId, pWixLoc->rgLocStrings[j].wzText);
+                        NativeAssert::Succeeded(hr, "Failed to replace string.");
+                    }
+                    linear->Stop();
+
+                    indexed->Start();
+                    hr = LocLocalizeString(pWixLoc, &sczActual);
+                    indexed->Stop();
+                    NativeAssert::Succeeded(hr, "Failed to localize text.");
+
+                    NativeAssert::StringEqual(sczExpected, sczActual);
+                }
+
+                this->output->WriteLine("{0} texts against {1} strings: linear {2} ms, indexed {3} ms", cTexts, cStrings, linear->ElapsedMilliseconds, indexed->ElapsedMilliseconds);
+            }
+            finally
+            {
+                ReleaseStr(sczExpected);
+                ReleaseStr(sczActual);
+                LocFree(pWixLoc);
+                XmlUninitialize();
+                DutilUninitialize();
+
+                if (File::Exists(wxlFile))
+                {
+                    File::Delete(wxlFile);
+                }
+            }
+        }
+
+    private:
+        ITestOutputHelper^ output;
+    };
+}
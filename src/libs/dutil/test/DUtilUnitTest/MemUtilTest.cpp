@@ -3,7 +3,9 @@
 #include "precomp.h"
 
 using namespace System;
+using namespace System::Diagnostics;
 using namespace Xunit;
+using namespace Xunit::Abstractions;
 using namespace WixBuildTools::TestSupport;
 
 namespace DutilTests
@@ -444,6 +446,156 @@ namespace DutilTests
             }
         }
 
+        [Fact]
+        void MemUtilArenaTest()
+        {
+            HRESULT hr = S_OK;
+            MEM_ARENA_HANDLE hArena = NULL;
+            MEM_ARENA_HANDLE hPreviousArena = NULL;
+            MEM_STATISTICS before = { };
+            MEM_STATISTICS after = { };
+            LPWSTR sczFirst = NULL;
+            LPWSTR sczSecond = NULL;
+            LPWSTR sczHeap = NULL;
+            ArrayValue *rgValues = NULL;
+            LPVOID pvSecure = NULL;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                MemStatisticsEnable(TRUE);
+                MemGetStatistics(&before);
+
+                hr = MemArenaCreate(1024 * 1024, &hArena);
+                NativeAssert::Succeeded(hr, "Failed to create arena.");
+
+                hPreviousArena = MemArenaBeginScope(hArena);
+                Assert::True(NULL == hPreviousArena);
+
+                hr = StrAllocString(&sczFirst, L"first", 0);
+                NativeAssert::Succeeded(hr, "Failed to allocate first string.");
+
+                hr = StrAllocString(&sczSecond, L"second", 0);
+                NativeAssert::Succeeded(hr, "Failed to allocate second string.");
+
+                // The last block grows in place, earlier blocks are copied.
+                LPWSTR wzSecond = sczSecond;
+                hr = StrAllocConcat(&sczSecond, L" string", 0);
+                NativeAssert::Succeeded(hr, "Failed to concatenate second string.");
+                Assert::True(wzSecond == sczSecond);
+
+                hr = StrAllocConcat(&sczFirst, L" string", 0);
+                NativeAssert::Succeeded(hr, "Failed to concatenate first string.");
+                NativeAssert::StringEqual(L"first string", sczFirst);
+                NativeAssert::StringEqual(L"second string", sczSecond);
+
+                hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&rgValues), 10, sizeof(ArrayValue), 10);
+                NativeAssert::Succeeded(hr, "Failed to allocate array in arena.");
+                Assert::Equal<SIZE_T>(20 * sizeof(ArrayValue), MemSize(rgValues));
+                for (DWORD i = 0; i < 20; ++i)
+                {
+                    Assert::Equal<DWORD>(0, rgValues[i].dwNum);
+                }
+
+                // Heap scopes nest inside arena scopes.
+                MEM_ARENA_HANDLE hArenaScope = MemArenaBeginScope(NULL);
+                hr = StrAllocString(&sczHeap, L"heap", 0);
+                MemArenaEndScope(hArenaScope);
+                NativeAssert::Succeeded(hr, "Failed to allocate heap string.");
+
+                MemArenaEndScope(hPreviousArena);
+
+                // Outside the scope a reallocation moves the block to the heap.
+                hr = StrAllocConcat(&sczFirst, L" moved to the heap", 0);
+                NativeAssert::Succeeded(hr, "Failed to move first string.");
+                NativeAssert::StringEqual(L"first string moved to the heap", sczFirst);
+
+                hr = MemReAllocSecure(sczSecond, 64 * sizeof(WCHAR), TRUE, &pvSecure);
+                NativeAssert::Succeeded(hr, "Failed to securely reallocate second string.");
+                Assert::True(pvSecure != sczSecond);
+                Assert::True(L'\0' == sczSecond[0]);
+                NativeAssert::StringEqual(L"second string", static_cast<LPCWSTR>(pvSecure));
+
+                // Freeing arena blocks succeeds and does nothing.
+                hr = MemFree(sczSecond);
+                NativeAssert::Succeeded(hr, "Failed to free arena string.");
+                sczSecond = NULL;
+
+                MemGetStatistics(&after);
+                Assert::True(after.cArenaAllocations - before.cArenaAllocations >= 3);
+                Assert::True(after.cbPeak > 0);
+                Assert::True(after.cbPeak >= after.cbCurrent);
+            }
+            finally
+            {
+                ReleaseMem(pvSecure);
+                ReleaseStr(sczHeap);
+                ReleaseStr(sczFirst);
+                ReleaseMem(rgValues);
+                ReleaseMemArena(hArena);
+                MemStatisticsEnable(FALSE);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void MemUtilArenaLimitTest()
+        {
+            HRESULT hr = S_OK;
+            MEM_ARENA_HANDLE rghArenas[16] = { };
+            MEM_ARENA_HANDLE hExtraArena = NULL;
+            MEM_ARENA_HANDLE hPreviousArena = NULL;
+            LPDWORD rgpdwBlocks[16] = { };
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                for (DWORD i = 0; i < countof(rghArenas); ++i)
+                {
+                    hr = MemArenaCreate(0, rghArenas + i);
+                    NativeAssert::Succeeded(hr, "Failed to create arena {0}.", i);
+
+                    hPreviousArena = MemArenaBeginScope(rghArenas[i]);
+                    rgpdwBlocks[i] = static_cast<LPDWORD>(MemAlloc(sizeof(DWORD) * (i + 1), TRUE));
+                    MemArenaEndScope(hPreviousArena);
+                    Assert::True(NULL != rgpdwBlocks[i]);
+
+                    rgpdwBlocks[i][0] = i;
+                }
+
+                hr = MemArenaCreate(0, &hExtraArena);
+                NativeAssert::SpecificReturnCode(E_OUTOFMEMORY, hr, "Expected every arena to be in use.");
+
+                // Each block is found in its own arena, so its size is exact and freeing it does nothing.
+                for (DWORD i = 0; i < countof(rghArenas); ++i)
+                {
+                    Assert::Equal<SIZE_T>(sizeof(DWORD) * (i + 1), MemSize(rgpdwBlocks[i]));
+
+                    hr = MemFree(rgpdwBlocks[i]);
+                    NativeAssert::Succeeded(hr, "Failed to free block in arena {0}.", i);
+                    Assert::Equal<DWORD>(i, rgpdwBlocks[i][0]);
+                }
+
+                // Destroying an arena in the middle frees its slot for the next one.
+                MemArenaDestroy(rghArenas[7]);
+                rghArenas[7] = NULL;
+
+                hr = MemArenaCreate(0, &hExtraArena);
+                NativeAssert::Succeeded(hr, "Failed to create arena in freed slot.");
+            }
+            finally
+            {
+                ReleaseMemArena(hExtraArena);
+                for (DWORD i = 0; i < countof(rghArenas); ++i)
+                {
+                    ReleaseMemArena(rghArenas[i]);
+                }
+                DutilUninitialize();
+            }
+        }
+
     private:
         void SetItem(ArrayValue *pValue, DWORD dwValue)
         {
@@ -505,4 +657,104 @@ namespace DutilTests
             return;
         }
     };
+
+    public ref class MemUtilBenchmark
+    {
+    public:
+        MemUtilBenchmark(ITestOutputHelper^ output)
+        {
+            this->output = output;
+        }
+
+        [Fact]
+        void MemArenaSmallAllocationBenchmark()
+        {
+            const DWORD cStrings = 50000;
+            HRESULT hr = S_OK;
+            MEM_ARENA_HANDLE hArena = NULL;
+            MEM_ARENA_HANDLE hPreviousArena = NULL;
+            LPWSTR* rgsczStrings = NULL;
+            MEM_STATISTICS before = { };
+            MEM_STATISTICS heap = { };
+            MEM_STATISTICS arena = { };
+            Stopwatch^ heapTimer = gcnew Stopwatch();
+            Stopwatch^ arenaTimer = gcnew Stopwatch();
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                MemStatisticsEnable(TRUE);
+
+                rgsczStrings = static_cast<LPWSTR*>(MemAlloc(sizeof(LPWSTR) * cStrings, TRUE));
+                Assert::True(NULL != rgsczStrings);
+
+                // Heap: allocate and free piecemeal like the *Uninitialize functions.
+                MemGetStatistics(&before);
+                heapTimer->Start();
+                AllocateStrings(rgsczStrings, cStrings);
+                heapTimer->Stop();
+                MemGetStatistics(&heap);
+
+                heapTimer->Start();
+                FreeStrings(rgsczStrings, cStrings);
+                heapTimer->Stop();
+
+                hr = MemArenaCreate(0, &hArena);
+                NativeAssert::Succeeded(hr, "Failed to create arena.");
+
+                // Arena: allocate in a scope, the piecemeal frees do nothing and the arena is released at once.
+                arenaTimer->Start();
+                hPreviousArena = MemArenaBeginScope(hArena);
+                AllocateStrings(rgsczStrings, cStrings);
+                MemArenaEndScope(hPreviousArena);
+                arenaTimer->Stop();
+                MemGetStatistics(&arena);
+
+                arenaTimer->Start();
+                FreeStrings(rgsczStrings, cStrings);
+                ReleaseNullMemArena(hArena);
+                arenaTimer->Stop();
+
+                Assert::True(arena.cArenaAllocations - heap.cArenaAllocations >= cStrings);
+
+                this->output->WriteLine("{0} strings: heap {1} ms with {2} allocations, arena {3} ms with {4} arena allocations, peak {5} bytes",
+                    cStrings, heapTimer->ElapsedMilliseconds, heap.cAllocations - before.cAllocations, arenaTimer->ElapsedMilliseconds, arena.cArenaAllocations - heap.cArenaAllocations, arena.cbPeak);
+            }
+            finally
+            {
+                if (rgsczStrings)
+                {
+                    FreeStrings(rgsczStrings, cStrings);
+                }
+
+                ReleaseMem(rgsczStrings);
+                ReleaseMemArena(hArena);
+                MemStatisticsEnable(FALSE);
+                DutilUninitialize();
+            }
+        }
+
+    private:
+        void AllocateStrings(LPWSTR* rgsczStrings, DWORD cStrings)
+        {
+            HRESULT hr = S_OK;
+
+            for (DWORD i = 0; i < cStrings; ++i)
+            {
+                hr = StrAllocFormatted(rgsczStrings + i, L"Package%u", i);
+                NativeAssert::Succeeded(hr, "Failed to allocate string.");
+            }
+        }
+
+        void FreeStrings(LPWSTR* rgsczStrings, DWORD cStrings)
+        {
+            for (DWORD i = 0; i < cStrings; ++i)
+            {
+                ReleaseNullStr(rgsczStrings[i]);
+            }
+        }
+
+        ITestOutputHelper^ output;
+    };
 }
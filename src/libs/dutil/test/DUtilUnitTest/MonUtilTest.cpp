@@ -5,8 +5,10 @@
 
 using namespace System;
 using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
 using namespace System::Runtime::InteropServices;
 using namespace Xunit;
+using namespace Xunit::Abstractions;
 using namespace WixBuildTools::TestSupport;
 
 namespace DutilTests
@@ -37,6 +39,14 @@ namespace DutilTests
         Directory *rgDirectories;
         DWORD cDirectories;
     };
+    struct ChangeResults
+    {
+        CRITICAL_SECTION cs;
+        HRESULT hrFailure;
+        DWORD cNotifications;
+        BOOL *rgfFileSeen;
+        DWORD cDirectories;
+    };
 
     public delegate void MonGeneralDelegate(HRESULT, LPVOID);
 
@@ -44,6 +54,8 @@ namespace DutilTests
 
     public delegate void MonDirectoryDelegate(HRESULT, LPCWSTR, BOOL, LPVOID, LPVOID);
 
+    public delegate void MonDirectoryChangesDelegate(HRESULT, LPCWSTR, BOOL, const MON_DIRECTORY_CHANGE*, DWORD, BOOL, LPVOID, LPVOID);
+
     public delegate void MonRegKeyDelegate(HRESULT, HKEY, LPCWSTR, REG_KEY_BITNESS, BOOL, LPVOID, LPVOID);
 
     static void MonGeneral(
@@ -85,6 +97,44 @@ namespace DutilTests
         pResults->rgDirectories[pResults->cDirectories - 1].fRecursive = fRecursive;
     }
 
+    static void MonDirectoryChanges(
+        __in HRESULT hrResult,
+        __in_z LPCWSTR /*wzPath*/,
+        __in BOOL /*fRecursive*/,
+        __in_ecount(cChanges) const MON_DIRECTORY_CHANGE* rgChanges,
+        __in DWORD cChanges,
+        __in BOOL /*fOverflow*/,
+        __in_opt LPVOID pvContext,
+        __in_opt LPVOID pvDirectoryContext
+        )
+    {
+        ChangeResults *pResults = reinterpret_cast<ChangeResults *>(pvContext);
+        DWORD dwDirectory = static_cast<DWORD>(reinterpret_cast<DWORD_PTR>(pvDirectoryContext));
+
+        ::EnterCriticalSection(&pResults->cs);
+
+        ++pResults->cNotifications;
+
+        if (FAILED(hrResult))
+        {
+            pResults->hrFailure = hrResult;
+        }
+        else if (dwDirectory < pResults->cDirectories)
+        {
+            // The records are only valid during the callback, so just remember whether the file we wrote was reported
+            for (DWORD i = 0; i < cChanges; ++i)
+            {
+                if ((FILE_ACTION_ADDED == rgChanges[i].dwAction || FILE_ACTION_MODIFIED == rgChanges[i].dwAction) &&
+                    CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, rgChanges[i].wzRelativePath, -1, L"file.txt", -1))
+                {
+                    pResults->rgfFileSeen[dwDirectory] = TRUE;
+                }
+            }
+        }
+
+        ::LeaveCriticalSection(&pResults->cs);
+    }
+
     static void MonRegKey(
         __in HRESULT hrResult,
         __in HKEY hkRoot,
@@ -486,4 +536,134 @@ namespace DutilTests
             }
         }
     };
+
+    public ref class MonUtilCompletionPort
+    {
+    public:
+        MonUtilCompletionPort(ITestOutputHelper^ output)
+        {
+            this->output = output;
+        }
+
+        [Fact]
+        void MonUtilCompletionPortStressTest()
+        {
+            const DWORD cDirectories = 2000;
+            const DWORD cWrittenDirectories = 10;
+            const DWORD dwTimeoutInMs = 10000;
+            HRESULT hr = S_OK;
+            MON_HANDLE handle = NULL;
+            LPWSTR sczBaseDir = NULL;
+            LPWSTR sczDir = NULL;
+            LPWSTR sczFile = NULL;
+            DWORD cSeen = 0;
+            List<GCHandle>^ gcHandles = gcnew List<GCHandle>();
+            Stopwatch^ setup = gcnew Stopwatch();
+            Stopwatch^ delivery = gcnew Stopwatch();
+            ChangeResults *pResults = (ChangeResults *)MemAlloc(sizeof(ChangeResults), TRUE);
+            Assert::True(NULL != pResults);
+
+            ::InitializeCriticalSection(&pResults->cs);
+
+            try
+            {
+                pResults->rgfFileSeen = (BOOL *)MemAlloc(sizeof(BOOL) * cDirectories, TRUE);
+                Assert::True(NULL != pResults->rgfFileSeen);
+                pResults->cDirectories = cDirectories;
+
+                MonGeneralDelegate^ fpMonGeneral = gcnew MonGeneralDelegate(MonGeneral);
+                GCHandle gchMonGeneral = GCHandle::Alloc(fpMonGeneral);
+                gcHandles->Add(gchMonGeneral);
+                IntPtr ipMonGeneral = Marshal::GetFunctionPointerForDelegate(fpMonGeneral);
+
+                MonDirectoryChangesDelegate^ fpMonDirectoryChanges = gcnew MonDirectoryChangesDelegate(MonDirectoryChanges);
+                GCHandle gchMonDirectoryChanges = GCHandle::Alloc(fpMonDirectoryChanges);
+                gcHandles->Add(gchMonDirectoryChanges);
+                IntPtr ipMonDirectoryChanges = Marshal::GetFunctionPointerForDelegate(fpMonDirectoryChanges);
+
+                hr = MonCreateEx(&handle, MON_FLAG_DETAILED_DIRECTORY_NOTIFICATIONS, static_cast<PFN_MONGENERAL>(ipMonGeneral.ToPointer()), NULL, NULL, static_cast<PFN_MONDIRECTORYCHANGES>(ipMonDirectoryChanges.ToPointer()), NULL, pResults);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = PathExpand(&sczBaseDir, L"%TEMP%\\MonUtilCompletionPortTest\\", PATH_EXPAND_ENVIRONMENT);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = DirEnsureDelete(sczBaseDir, TRUE, TRUE);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE, E_PATHNOTFOUND);
+
+                for (DWORD i = 0; i < cDirectories; ++i)
+                {
+                    hr = StrAllocFormatted(&sczDir, L"%ls%u\\", sczBaseDir, i);
+                    NativeAssert::ValidReturnCode(hr, S_OK);
+
+                    hr = DirEnsureExists(sczDir, NULL);
+                    NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+
+                    setup->Start();
+                    hr = MonAddDirectory(handle, sczDir, FALSE, SILENCEPERIOD, reinterpret_cast<LPVOID>(static_cast<DWORD_PTR>(i)));
+                    setup->Stop();
+                    NativeAssert::ValidReturnCode(hr, S_OK);
+                }
+
+                // Give the completion port thread time to issue all the reads before anything changes
+                ::Sleep(FULLWAIT);
+
+                delivery->Start();
+                for (DWORD i = 0; i < cWrittenDirectories; ++i)
+                {
+                    hr = StrAllocFormatted(&sczFile, L"%ls%u\\file.txt", sczBaseDir, i * (cDirectories / cWrittenDirectories));
+                    NativeAssert::ValidReturnCode(hr, S_OK);
+
+                    hr = FileFromString(sczFile, 0, L"contents", FILE_ENCODING_UTF16_WITH_BOM);
+                    NativeAssert::ValidReturnCode(hr, S_OK);
+                }
+
+                while (cWrittenDirectories > cSeen && dwTimeoutInMs > delivery->ElapsedMilliseconds)
+                {
+                    ::Sleep(PREWAIT);
+
+                    cSeen = 0;
+                    ::EnterCriticalSection(&pResults->cs);
+                    for (DWORD i = 0; i < cWrittenDirectories; ++i)
+                    {
+                        if (pResults->rgfFileSeen[i * (cDirectories / cWrittenDirectories)])
+                        {
+                            ++cSeen;
+                        }
+                    }
+                    ::LeaveCriticalSection(&pResults->cs);
+                }
+                delivery->Stop();
+
+                NativeAssert::ValidReturnCode(pResults->hrFailure, S_OK);
+                Assert::Equal<DWORD>(cWrittenDirectories, cSeen);
+
+                this->output->WriteLine("{0} directories on one completion port: added in {1} ms, {2} files reported in {3} ms", cDirectories, setup->ElapsedMilliseconds, cSeen, delivery->ElapsedMilliseconds);
+            }
+            finally
+            {
+                ReleaseMon(handle);
+
+                for each (GCHandle gcHandle in gcHandles)
+                {
+                    gcHandle.Free();
+                }
+
+                if (sczBaseDir)
+                {
+                    DirEnsureDelete(sczBaseDir, TRUE, TRUE);
+                }
+
+                ReleaseStr(sczBaseDir);
+                ReleaseStr(sczDir);
+                ReleaseStr(sczFile);
+
+                ::DeleteCriticalSection(&pResults->cs);
+                ReleaseMem(pResults->rgfFileSeen);
+                ReleaseMem(pResults);
+            }
+        }
+
+    private:
+        ITestOutputHelper^ output;
+    };
 }
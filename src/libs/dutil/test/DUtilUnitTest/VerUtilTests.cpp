@@ -3,7 +3,9 @@
 #include "precomp.h"
 
 using namespace System;
+using namespace System::Diagnostics;
 using namespace Xunit;
+using namespace Xunit::Abstractions;
 using namespace WixBuildTools::TestSupport;
 
 namespace DutilTests
@@ -1159,6 +1161,98 @@ namespace DutilTests
             }
         }
 
+        [Fact]
+        void VerPackVersionOnlyPacksVersionsWithoutReleaseLabels()
+        {
+            HRESULT hr = S_OK;
+            VERUTIL_VERSION* pVersion1 = NULL;
+            VERUTIL_VERSION* pVersion2 = NULL;
+            VERUTIL_VERSION* pVersion3 = NULL;
+            VERUTIL_PACKED_VERSION packed1 = { };
+            VERUTIL_PACKED_VERSION packed2 = { };
+            VERUTIL_PACKED_VERSION packed3 = { };
+
+            try
+            {
+                hr = VerParseVersion(L"1.2.3.4+abc", 0, FALSE, &pVersion1);
+                NativeAssert::Succeeded(hr, "Failed to parse version '1.2.3.4+abc'");
+
+                hr = VerParseVersion(L"1.2.4", 0, FALSE, &pVersion2);
+                NativeAssert::Succeeded(hr, "Failed to parse version '1.2.4'");
+
+                hr = VerParseVersion(L"1.2.3.4-beta", 0, FALSE, &pVersion3);
+                NativeAssert::Succeeded(hr, "Failed to parse version '1.2.3.4-beta'");
+
+                hr = VerPackVersion(pVersion1, &packed1);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+                Assert::Equal<DWORD64>(0x0000000100000002ull, packed1.qwHigh);
+                Assert::Equal<DWORD64>(0x0000000300000004ull, packed1.qwLow);
+
+                hr = VerPackVersion(pVersion2, &packed2);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = VerPackVersion(pVersion3, &packed3);
+                NativeAssert::ValidReturnCode(hr, S_FALSE);
+
+                Assert::Equal(-1, VerComparePackedVersions(&packed1, &packed2));
+                Assert::Equal(1, VerComparePackedVersions(&packed2, &packed1));
+                Assert::Equal(0, VerComparePackedVersions(&packed1, &packed1));
+            }
+            finally
+            {
+                ReleaseVerutilVersion(pVersion1);
+                ReleaseVerutilVersion(pVersion2);
+                ReleaseVerutilVersion(pVersion3);
+            }
+        }
+
+        [Fact]
+        void VerCacheReturnsSharedVersions()
+        {
+            HRESULT hr = S_OK;
+            VERUTIL_VERSION_CACHE_HANDLE hCache = NULL;
+            const VERUTIL_VERSION* pVersion1 = NULL;
+            const VERUTIL_VERSION* pVersion2 = NULL;
+            const VERUTIL_VERSION* pVersion3 = NULL;
+            int nResult = 0;
+
+            try
+            {
+                hr = VerCacheCreate(0, &hCache);
+                NativeAssert::Succeeded(hr, "Failed to create version cache");
+
+                hr = VerCacheGetVersion(hCache, L"v1.2.3-beta.1", FALSE, &pVersion1);
+                NativeAssert::Succeeded(hr, "Failed to get version 'v1.2.3-beta.1'");
+
+                hr = VerCacheGetVersion(hCache, L"v1.2.3-beta.1", TRUE, &pVersion2);
+                NativeAssert::Succeeded(hr, "Failed to get version 'v1.2.3-beta.1' again");
+
+                Assert::True(pVersion1 == pVersion2);
+                NativeAssert::StringEqual(L"1.2.3-beta.1", pVersion1->sczVersion);
+                Assert::Equal<WCHAR>(L'v', pVersion1->chPrefix);
+                Assert::Equal<DWORD>(2, pVersion1->cReleaseLabels);
+
+                hr = VerCacheGetVersion(hCache, L"1.2.3.", FALSE, &pVersion3);
+                NativeAssert::Succeeded(hr, "Failed to get version '1.2.3.'");
+                Assert::Equal<BOOL>(TRUE, pVersion3->fInvalid);
+
+                hr = VerCacheGetVersion(hCache, L"1.2.3.", TRUE, &pVersion3);
+                NativeAssert::ValidReturnCode(hr, E_INVALIDARG);
+
+                hr = VerCacheCompareStringVersions(hCache, L"1.2.3", L"1.2.3.0", FALSE, &nResult);
+                NativeAssert::Succeeded(hr, "Failed to compare packed versions");
+                Assert::Equal(0, nResult);
+
+                hr = VerCacheCompareStringVersions(hCache, L"1.2.3", L"v1.2.3-beta.1", FALSE, &nResult);
+                NativeAssert::Succeeded(hr, "Failed to compare versions with release labels");
+                Assert::Equal(1, nResult);
+            }
+            finally
+            {
+                ReleaseVerutilVersionCache(hCache);
+            }
+        }
+
     private:
         void TestVerutilCompareParsedVersions(VERUTIL_VERSION* pVersion1, VERUTIL_VERSION* pVersion2, int nExpectedResult)
         {
@@ -1176,4 +1270,91 @@ namespace DutilTests
             Assert::Equal(nExpectedResult, -nResult);
         }
     };
+
+    public ref class VerUtilBenchmark
+    {
+    public:
+        VerUtilBenchmark(ITestOutputHelper^ output)
+        {
+            this->output = output;
+        }
+
+        [Fact]
+        void VerCacheCompareStringVersionsBenchmark()
+        {
+            const DWORD cVersions = 500;
+            const DWORD cIterations = 20;
+            HRESULT hr = S_OK;
+            VERUTIL_VERSION_CACHE_HANDLE hCache = NULL;
+            LPWSTR* rgsczVersions = NULL;
+            int nUncached = 0;
+            int nCached = 0;
+
+            try
+            {
+                rgsczVersions = static_cast<LPWSTR*>(MemAlloc(sizeof(LPWSTR) * cVersions, TRUE));
+                Assert::True(NULL != rgsczVersions);
+
+                for (DWORD i = 0; i < cVersions; ++i)
+                {
+                    hr = StrAllocFormatted(rgsczVersions + i, 0 == i % 5 ? L"%u.%u.%u-rc.%u" : L"%u.%u.%u.%u", i % 7, i % 13, i % 31, i);
+                    NativeAssert::Succeeded(hr, "Failed to format version {0}", i);
+                }
+
+                hr = VerCacheCreate(cVersions, &hCache);
+                NativeAssert::Succeeded(hr, "Failed to create version cache");
+
+                Stopwatch^ uncached = Stopwatch::StartNew();
+                for (DWORD iIteration = 0; iIteration < cIterations; ++iIteration)
+                {
+                    for (DWORD i = 1; i < cVersions; ++i)
+                    {
+                        int nResult = 0;
+
+                        hr = VerCompareStringVersions(rgsczVersions[i - 1], rgsczVersions[i], FALSE, &nResult);
+                        NativeAssert::Succeeded(hr, "Failed to compare versions");
+
+                        nUncached += nResult;
+                    }
+                }
+                uncached->Stop();
+
+                Stopwatch^ cached = Stopwatch::StartNew();
+                for (DWORD iIteration = 0; iIteration < cIterations; ++iIteration)
+                {
+                    for (DWORD i = 1; i < cVersions; ++i)
+                    {
+                        int nResult = 0;
+
+                        hr = VerCacheCompareStringVersions(hCache, rgsczVersions[i - 1], rgsczVersions[i], FALSE, &nResult);
+                        NativeAssert::Succeeded(hr, "Failed to compare cached versions");
+
+                        nCached += nResult;
+                    }
+                }
+                cached->Stop();
+
+                Assert::Equal(nUncached, nCached);
+
+                this->output->WriteLine("{0} comparisons: uncached {1} ms, cached {2} ms", cIterations * (cVersions - 1), uncached->ElapsedMilliseconds, cached->ElapsedMilliseconds);
+            }
+            finally
+            {
+                ReleaseVerutilVersionCache(hCache);
+
+                if (rgsczVersions)
+                {
+                    for (DWORD i = 0; i < cVersions; ++i)
+                    {
+                        ReleaseStr(rgsczVersions[i]);
+                    }
+
+                    MemFree(rgsczVersions);
+                }
+            }
+        }
+
+    private:
+        ITestOutputHelper^ output;
+    };
 }
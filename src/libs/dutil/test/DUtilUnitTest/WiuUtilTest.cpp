@@ -0,0 +1,428 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+struct WIU_UTIL_TEST_MESSAGES
+{
+    HANDLE hRelease;
+    INT nActionStartResult;
+
+    DWORD cProgress;
+    DWORD dwLastPercentage;
+    DWORD cActionStart;
+    DWORD cActionData;
+    DWORD cError;
+};
+
+static INSTALLUI_HANDLER_RECORD vpfnExternalUIRecord = NULL;
+static LPVOID vpvExternalUIRecordContext = NULL;
+
+static INSTALLUILEVEL WINAPI WiuUtilTest_MsiSetInternalUI(
+    __in INSTALLUILEVEL dwUILevel,
+    __inout_opt HWND* phWnd
+    );
+static UINT WINAPI WiuUtilTest_MsiSetExternalUIRecord(
+    __in_opt INSTALLUI_HANDLER_RECORD puiHandler,
+    __in DWORD dwMessageFilter,
+    __in_opt LPVOID pvContext,
+    __out_opt PINSTALLUI_HANDLER_RECORD ppuiPrevHandler
+    );
+static INT WiuUtilTest_MessageHandler(
+    __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
+    __in_opt LPVOID pvContext
+    );
+static HRESULT WiuUtilTest_SendProgressMessages(
+    __in BOOL fQueueNotifications,
+    __in WIU_UTIL_TEST_MESSAGES* pMessages
+    );
+static INT WiuUtilTest_SendProgressRecord(
+    __in INT iType,
+    __in INT iValue1,
+    __in INT iValue2,
+    __in INT iValue3
+    );
+static INT WiuUtilTest_SendTextRecord(
+    __in INSTALLMESSAGE mt,
+    __in UINT uiFlags,
+    __in_z LPCWSTR wzText
+    );
+static DWORD WINAPI WiuUtilTest_SendActionStartsThreadProc(
+    __in LPVOID pvContext
+    );
+
+using namespace System;
+using namespace Xunit;
+using namespace WixBuildTools::TestSupport;
+
+namespace DutilTests
+{
+    public ref class WiuUtil
+    {
+    public:
+        [Fact]
+        void WiuUtilQueuedProgressIsCoalescedAndDrainedTest()
+        {
+            HRESULT hr = S_OK;
+            WIU_UTIL_TEST_MESSAGES synchronous = { };
+            WIU_UTIL_TEST_MESSAGES queued = { };
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = WiuInitialize();
+                NativeAssert::Succeeded(hr, "Failed to initialize wiutil.");
+
+                WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, WiuUtilTest_MsiSetInternalUI, NULL, NULL, WiuUtilTest_MsiSetExternalUIRecord, NULL);
+
+                // Without the queue every update reaches the handler.
+                synchronous.hRelease = ::CreateEventW(NULL, TRUE, TRUE, NULL);
+                Assert::True(NULL != synchronous.hRelease);
+
+                hr = WiuUtilTest_SendProgressMessages(FALSE, &synchronous);
+                NativeAssert::Succeeded(hr, "Failed to send synchronous progress messages.");
+
+                // Hold the handler on the first update so the rest pile up behind it.
+                queued.hRelease = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+                Assert::True(NULL != queued.hRelease);
+
+                hr = WiuUtilTest_SendProgressMessages(TRUE, &queued);
+                NativeAssert::Succeeded(hr, "Failed to send queued progress messages.");
+
+                Assert::True(1 < synchronous.cProgress);
+                Assert::True(0 < queued.cProgress);
+                Assert::True(queued.cProgress < synchronous.cProgress);
+
+                // Uninitializing delivered the final update that was still queued.
+                Assert::True(0 < synchronous.dwLastPercentage);
+                NativeAssert::Equal<DWORD>(synchronous.dwLastPercentage, queued.dwLastPercentage);
+            }
+            finally
+            {
+                ReleaseHandle(queued.hRelease);
+                ReleaseHandle(synchronous.hRelease);
+
+                WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                WiuUninitialize();
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void WiuUtilQueuedCancelIsReturnedBeforeBlockingMessageTest()
+        {
+            HRESULT hr = S_OK;
+            WIU_MSI_EXECUTE_CONTEXT context = { };
+            WIU_UTIL_TEST_MESSAGES messages = { };
+            BOOL fExternalUIInitialized = FALSE;
+            INT nResult = IDNOACTION;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = WiuInitialize();
+                NativeAssert::Succeeded(hr, "Failed to initialize wiutil.");
+
+                WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, WiuUtilTest_MsiSetInternalUI, NULL, NULL, WiuUtilTest_MsiSetExternalUIRecord, NULL);
+
+                messages.hRelease = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+                Assert::True(NULL != messages.hRelease);
+                messages.nActionStartResult = IDCANCEL;
+
+                hr = WiuInitializeExternalUI(WiuUtilTest_MessageHandler, INSTALLUILEVEL_NONE, NULL, &messages, FALSE, TRUE, &context);
+                NativeAssert::Succeeded(hr, "Failed to initialize external UI.");
+                fExternalUIInitialized = TRUE;
+
+                // The action start is only a notification so it is queued and cannot be answered yet.
+                nResult = WiuUtilTest_SendTextRecord(INSTALLMESSAGE_ACTIONSTART, MB_OK, L"Action");
+                NativeAssert::Equal<INT>(IDNOACTION, nResult);
+
+                ::SetEvent(messages.hRelease);
+
+                // The error needs an answer, but the queued cancel is returned instead of asking the handler.
+                nResult = WiuUtilTest_SendTextRecord(INSTALLMESSAGE_ERROR, MB_OKCANCEL, L"Error");
+                NativeAssert::Equal<INT>(IDCANCEL, nResult);
+                NativeAssert::Equal<DWORD>(1, messages.cActionStart);
+                NativeAssert::Equal<DWORD>(0, messages.cError);
+
+                // The cancel is only returned once.
+                nResult = WiuUtilTest_SendTextRecord(INSTALLMESSAGE_ERROR, MB_OKCANCEL, L"Error");
+                NativeAssert::Equal<INT>(IDNOACTION, nResult);
+                NativeAssert::Equal<DWORD>(1, messages.cError);
+            }
+            finally
+            {
+                if (fExternalUIInitialized)
+                {
+                    WiuUninitializeExternalUI(&context);
+                }
+
+                ReleaseHandle(messages.hRelease);
+
+                WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                WiuUninitialize();
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void WiuUtilQueuedActionDataIsCoalescedTest()
+        {
+            HRESULT hr = S_OK;
+            WIU_MSI_EXECUTE_CONTEXT context = { };
+            WIU_UTIL_TEST_MESSAGES messages = { };
+            BOOL fExternalUIInitialized = FALSE;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = WiuInitialize();
+                NativeAssert::Succeeded(hr, "Failed to initialize wiutil.");
+
+                WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, WiuUtilTest_MsiSetInternalUI, NULL, NULL, WiuUtilTest_MsiSetExternalUIRecord, NULL);
+
+                messages.hRelease = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+                Assert::True(NULL != messages.hRelease);
+
+                hr = WiuInitializeExternalUI(WiuUtilTest_MessageHandler, INSTALLUILEVEL_NONE, NULL, &messages, FALSE, TRUE, &context);
+                NativeAssert::Succeeded(hr, "Failed to initialize external UI.");
+                fExternalUIInitialized = TRUE;
+
+                // Hold the handler on the action start so the action data piles up behind it.
+                WiuUtilTest_SendTextRecord(INSTALLMESSAGE_ACTIONSTART, MB_OK, L"Action");
+
+                for (DWORD i = 0; i < 100; ++i)
+                {
+                    WiuUtilTest_SendTextRecord(INSTALLMESSAGE_ACTIONDATA, MB_OK, L"Data");
+                }
+
+                ::SetEvent(messages.hRelease);
+
+                WiuUninitializeExternalUI(&context);
+                fExternalUIInitialized = FALSE;
+
+                NativeAssert::Equal<DWORD>(1, messages.cActionStart);
+                NativeAssert::Equal<DWORD>(1, messages.cActionData);
+            }
+            finally
+            {
+                if (fExternalUIInitialized)
+                {
+                    WiuUninitializeExternalUI(&context);
+                }
+
+                ReleaseHandle(messages.hRelease);
+
+                WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                WiuUninitialize();
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void WiuUtilQueuedMessagesHoldBackWindowsInstallerWhenFullTest()
+        {
+            HRESULT hr = S_OK;
+            WIU_MSI_EXECUTE_CONTEXT context = { };
+            WIU_UTIL_TEST_MESSAGES messages = { };
+            BOOL fExternalUIInitialized = FALSE;
+            HANDLE hSender = NULL;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = WiuInitialize();
+                NativeAssert::Succeeded(hr, "Failed to initialize wiutil.");
+
+                WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, WiuUtilTest_MsiSetInternalUI, NULL, NULL, WiuUtilTest_MsiSetExternalUIRecord, NULL);
+
+                messages.hRelease = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+                Assert::True(NULL != messages.hRelease);
+
+                hr = WiuInitializeExternalUI(WiuUtilTest_MessageHandler, INSTALLUILEVEL_NONE, NULL, &messages, FALSE, TRUE, &context);
+                NativeAssert::Succeeded(hr, "Failed to initialize external UI.");
+                fExternalUIInitialized = TRUE;
+
+                // Action starts are never coalesced, so with the handler held the sender fills the queue and has to wait.
+                hSender = ::CreateThread(NULL, 0, WiuUtilTest_SendActionStartsThreadProc, NULL, 0, NULL);
+                Assert::True(NULL != hSender);
+
+                NativeAssert::Equal<DWORD>(WAIT_TIMEOUT, ::WaitForSingleObject(hSender, 500));
+
+                ::SetEvent(messages.hRelease);
+
+                NativeAssert::Equal<DWORD>(WAIT_OBJECT_0, ::WaitForSingleObject(hSender, 10000));
+
+                WiuUninitializeExternalUI(&context);
+                fExternalUIInitialized = FALSE;
+
+                NativeAssert::Equal<DWORD>(1000, messages.cActionStart);
+            }
+            finally
+            {
+                if (hSender)
+                {
+                    ::SetEvent(messages.hRelease);
+                    ::WaitForSingleObject(hSender, INFINITE);
+                }
+
+                if (fExternalUIInitialized)
+                {
+                    WiuUninitializeExternalUI(&context);
+                }
+
+                ReleaseHandle(hSender);
+                ReleaseHandle(messages.hRelease);
+
+                WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                WiuUninitialize();
+                DutilUninitialize();
+            }
+        }
+    };
+}
+
+
+static INSTALLUILEVEL WINAPI WiuUtilTest_MsiSetInternalUI(
+    __in INSTALLUILEVEL /*dwUILevel*/,
+    __inout_opt HWND* /*phWnd*/
+    )
+{
+    return INSTALLUILEVEL_DEFAULT;
+}
+
+static UINT WINAPI WiuUtilTest_MsiSetExternalUIRecord(
+    __in_opt INSTALLUI_HANDLER_RECORD puiHandler,
+    __in DWORD /*dwMessageFilter*/,
+    __in_opt LPVOID pvContext,
+    __out_opt PINSTALLUI_HANDLER_RECORD ppuiPrevHandler
+    )
+{
+    if (ppuiPrevHandler)
+    {
+        *ppuiPrevHandler = vpfnExternalUIRecord;
+    }
+
+    vpfnExternalUIRecord = puiHandler;
+    vpvExternalUIRecordContext = pvContext;
+
+    return ERROR_SUCCESS;
+}
+
+static INT WiuUtilTest_MessageHandler(
+    __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
+    __in_opt LPVOID pvContext
+    )
+{
+    WIU_UTIL_TEST_MESSAGES* pMessages = static_cast<WIU_UTIL_TEST_MESSAGES*>(pvContext);
+    INT nResult = IDNOACTION;
+
+    switch (pMessage->type)
+    {
+    case WIU_MSI_EXECUTE_MESSAGE_PROGRESS:
+        ::WaitForSingleObject(pMessages->hRelease, INFINITE);
+
+        ++pMessages->cProgress;
+        pMessages->dwLastPercentage = pMessage->progress.dwPercentage;
+        break;
+
+    case WIU_MSI_EXECUTE_MESSAGE_ERROR:
+        ++pMessages->cError;
+        break;
+
+    case WIU_MSI_EXECUTE_MESSAGE_MSI_MESSAGE:
+        if (INSTALLMESSAGE_ACTIONSTART == pMessage->msiMessage.mt)
+        {
+            ::WaitForSingleObject(pMessages->hRelease, INFINITE);
+
+            ++pMessages->cActionStart;
+            nResult = pMessages->nActionStartResult;
+        }
+        else if (INSTALLMESSAGE_ACTIONDATA == pMessage->msiMessage.mt)
+        {
+            ++pMessages->cActionData;
+        }
+        break;
+    }
+
+    return nResult;
+}
+
+static HRESULT WiuUtilTest_SendProgressMessages(
+    __in BOOL fQueueNotifications,
+    __in WIU_UTIL_TEST_MESSAGES* pMessages
+    )
+{
+    HRESULT hr = S_OK;
+    WIU_MSI_EXECUTE_CONTEXT context = { };
+
+    hr = WiuInitializeExternalUI(WiuUtilTest_MessageHandler, INSTALLUILEVEL_NONE, NULL, pMessages, FALSE, fQueueNotifications, &context);
+    ExitOnFailure(hr, "Failed to initialize external UI.");
+
+    // A forward moving script phase that reports progress with every action data message.
+    WiuUtilTest_SendProgressRecord(0, 1000, 0, 1);
+    WiuUtilTest_SendProgressRecord(1, 10, 1, 0);
+
+    for (DWORD i = 0; i < 100; ++i)
+    {
+        WiuUtilTest_SendTextRecord(INSTALLMESSAGE_ACTIONDATA, MB_OK, L"Data");
+    }
+
+    ::SetEvent(pMessages->hRelease);
+
+    WiuUninitializeExternalUI(&context);
+
+LExit:
+    return hr;
+}
+
+static INT WiuUtilTest_SendProgressRecord(
+    __in INT iType,
+    __in INT iValue1,
+    __in INT iValue2,
+    __in INT iValue3
+    )
+{
+    INT nResult = IDNOACTION;
+    PMSIHANDLE hRecord = ::MsiCreateRecord(4);
+
+    ::MsiRecordSetInteger(hRecord, 1, iType);
+    ::MsiRecordSetInteger(hRecord, 2, iValue1);
+    ::MsiRecordSetInteger(hRecord, 3, iValue2);
+    ::MsiRecordSetInteger(hRecord, 4, iValue3);
+
+    nResult = vpfnExternalUIRecord(vpvExternalUIRecordContext, INSTALLMESSAGE_PROGRESS, hRecord);
+
+    return nResult;
+}
+
+static INT WiuUtilTest_SendTextRecord(
+    __in INSTALLMESSAGE mt,
+    __in UINT uiFlags,
+    __in_z LPCWSTR wzText
+    )
+{
+    INT nResult = IDNOACTION;
+    PMSIHANDLE hRecord = ::MsiCreateRecord(1);
+
+    ::MsiRecordSetStringW(hRecord, 1, wzText);
+
+    nResult = vpfnExternalUIRecord(vpvExternalUIRecordContext, mt | uiFlags, hRecord);
+
+    return nResult;
+}
+
+static DWORD WINAPI WiuUtilTest_SendActionStartsThreadProc(
+    __in LPVOID /*pvContext*/
+    )
+{
+    for (DWORD i = 0; i < 1000; ++i)
+    {
+        WiuUtilTest_SendTextRecord(INSTALLMESSAGE_ACTIONSTART, MB_OK, L"Action");
+    }
+
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include <strsafe.h>
 #include <ShlObj.h>
 #include <sddl.h>
+#include <msiquery.h>
 
 // Include error.h before dutil.h
 #include <dutilsources.h>
@@ -21,6 +22,8 @@
 #include <fileutil.h>
 #include <guidutil.h>
 #include <iniutil.h>
+#include <jsonutil.h>
+#include <locutil.h>
 #include <memutil.h>
 #include <pathutil.h>
 #include <procutil.h>
@@ -30,6 +33,7 @@
 #include <rssutil.h>
 #include <apuputil.h> // NOTE: this must come after atomutil.h and rssutil.h since it uses them.
 #include <uriutil.h>
+#include <wiutil.h>
 #include <xmlutil.h>
 
 #pragma managed
@@ -62,6 +62,8 @@ static DWORD WINAPI LoadThreadProc(
     HANDLE hDirectory = INVALID_HANDLE_VALUE;
     LPWSTR sczDirectory = NULL;
     LPWSTR wzFileName = NULL;
+    DWORD dwLoadStart = 0;
+    PROCESS_MEMORY_COUNTERS pmc = { };
 
     THEME* pTheme = NULL;
     HANDLE_THEME* pHandle = NULL;
@@ -109,6 +111,8 @@ static DWORD WINAPI LoadThreadProc(
         ::SendMessageW(hWnd, WM_THMVWR_THEME_LOAD_BEGIN, 0, 0);
 
         // Try to load the theme file.
+        dwLoadStart = ::GetTickCount();
+
         hr = ThemeLoadFromFile(sczThemePath, &pTheme);
         if (FAILED(hr))
         {
@@ -128,6 +132,14 @@ static DWORD WINAPI LoadThreadProc(
             hr = AllocHandleTheme(pTheme, &pHandle);
             ExitOnFailure(hr, "Failed to allocate handle to theme");
 
+            // Report how long the theme took to load and how much memory the process needed to do it.
+            pHandle->dwLoadMilliseconds = ::GetTickCount() - dwLoadStart;
+
+            if (::GetProcessMemoryInfo(::GetCurrentProcess(), &pmc, sizeof(pmc)))
+            {
+                pHandle->cbPeakWorkingSet = pmc.PeakWorkingSetSize;
+            }
+
             ::SendMessageW(hWnd, WM_THMVWR_NEW_THEME, 0, reinterpret_cast<LPARAM>(pHandle));
             pHandle = NULL;
         }
@@ -5,6 +5,7 @@
 #include <windows.h>
 #include <msiquery.h>
 #include <objbase.h>
+#include <psapi.h>
 #include <shlobj.h>
 #include <shlwapi.h>
 #include <stdlib.h>
@@ -36,6 +37,9 @@ struct HANDLE_THEME
 {
     DWORD cReferences;
     THEME* pTheme;
+
+    DWORD dwLoadMilliseconds;
+    SIZE_T cbPeakWorkingSet;
 };
 
 enum WM_THMVWR
@@ -448,6 +448,7 @@ static void OnNewTheme(
     const THEME_CONTROL* pTreeControl = NULL;
     HANDLE_THEME* pOldHandle = reinterpret_cast<HANDLE_THEME*>(::GetWindowLongPtrW(hWnd, GWLP_USERDATA));
     THEME* pNewTheme = pHandle->pTheme;
+    LPWSTR sczLoadStatistics = NULL;
 
     WCHAR wzSelectedPage[MAX_PATH] = { };
     HTREEITEM htiSelected = NULL;
@@ -470,7 +471,7 @@ static void OnNewTheme(
     if (!ThemeControlExistsById(pTheme, THMVWR_CONTROL_TREE, &pTreeControl))
     {
         TraceError(E_INVALIDSTATE, "Tree control doesn't exist.");
-        return;
+        ExitFunction();
     }
 
     // Remember the currently selected item by name so we can try to automatically select it later.
@@ -521,6 +522,19 @@ static void OnNewTheme(
     {
         ::SendMessage(pTreeControl->hWnd, TVM_SELECTITEM, TVGN_CARET, reinterpret_cast<LPARAM>(htiSelected));
     }
+
+    // Add the load statistics after the application node.
+    if (SUCCEEDED(StrAllocFormatted(&sczLoadStatistics, L"Loaded in %u ms, peak working set %Iu KB", pHandle->dwLoadMilliseconds, pHandle->cbPeakWorkingSet / 1024)))
+    {
+        tvi.hParent = NULL;
+        tvi.hInsertAfter = TVI_LAST;
+        tvi.item.lParam = 0;
+        tvi.item.pszText = sczLoadStatistics;
+        ::SendMessage(pTreeControl->hWnd, TVM_INSERTITEMW, 0, reinterpret_cast<LPARAM>(&tvi));
+    }
+
+LExit:
+    ReleaseStr(sczLoadStatistics);
 }
 
 static BOOL OnThemeLoadingControl(
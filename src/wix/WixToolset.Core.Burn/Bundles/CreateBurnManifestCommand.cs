@@ -164,6 +164,16 @@ namespace WixToolset.Core.Burn.Bundles
                 // write the UX element
                 writer.WriteStartElement("UX");
 
+                if (this.BundleSymbol.ProgressUpdatesPerSecond.HasValue)
+                {
+                    writer.WriteAttributeString("ProgressUpdatesPerSecond", this.BundleSymbol.ProgressUpdatesPerSecond.Value.ToString(CultureInfo.InvariantCulture));
+                }
+
+                if (this.BundleSymbol.ProgressPercentageStep.HasValue)
+                {
+                    writer.WriteAttributeString("ProgressPercentageStep", this.BundleSymbol.ProgressPercentageStep.Value.ToString(CultureInfo.InvariantCulture));
+                }
+
                 // write the UX allPayloads...
                 foreach (var payload in this.UXContainerPayloads)
                 {
@@ -364,6 +374,11 @@ namespace WixToolset.Core.Burn.Bundles
                     writer.WriteAttributeString("Permanent", package.PackageSymbol.Permanent ? "yes" : "no");
                     writer.WriteAttributeString("Vital", package.PackageSymbol.Vital ? "yes" : "no");
 
+                    if (package.PackageSymbol.Parallel)
+                    {
+                        writer.WriteAttributeString("Parallel", "yes");
+                    }
+
                     if (null != package.PackageSymbol.RollbackBoundaryRef)
                     {
                         writer.WriteAttributeString("RollbackBoundaryForward", package.PackageSymbol.RollbackBoundaryRef);
@@ -132,6 +132,8 @@ namespace WixToolset.Core
             string version = null;
             string condition = null;
             string parentName = null;
+            int? progressUpdatesPerSecond = null;
+            int? progressPercentageStep = null;
 
             string fileSystemSafeBundleName = null;
             string logVariablePrefixAndExtension;
@@ -217,6 +219,12 @@ namespace WixToolset.Core
                         case "ParentName":
                             parentName = this.Core.GetAttributeValue(sourceLineNumbers, attrib);
                             break;
+                        case "ProgressPercentageStep":
+                            progressPercentageStep = this.Core.GetAttributeIntegerValue(sourceLineNumbers, attrib, 0, 100);
+                            break;
+                        case "ProgressUpdatesPerSecond":
+                            progressUpdatesPerSecond = this.Core.GetAttributeIntegerValue(sourceLineNumbers, attrib, 0, 1000);
+                            break;
                         case "ProviderKey":
                             // This can't be processed until we create the section.
                             break;
@@ -437,6 +445,8 @@ namespace WixToolset.Core
                     Tag = tag,
                     Platform = this.CurrentPlatform,
                     ParentName = parentName,
+                    ProgressUpdatesPerSecond = progressUpdatesPerSecond,
+                    ProgressPercentageStep = progressPercentageStep,
                 });
 
                 if (!String.IsNullOrEmpty(logVariablePrefixAndExtension))
@@ -2025,6 +2035,7 @@ namespace WixToolset.Core
             var permanent = YesNoType.NotSet;
             var visible = YesNoType.NotSet;
             var vital = YesNoType.Yes;
+            var parallel = YesNoType.NotSet;
             string installArguments = null;
             string repairArguments = null;
             string uninstallArguments = null;
@@ -2135,6 +2146,10 @@ namespace WixToolset.Core
                         case "Vital":
                             vital = this.Core.GetAttributeYesNoValue(sourceLineNumbers, attrib);
                             break;
+                        case "Parallel":
+                            parallel = this.Core.GetAttributeYesNoValue(sourceLineNumbers, attrib);
+                            allowed = (packageType == WixBundlePackageType.Bundle || packageType == WixBundlePackageType.Exe || packageType == WixBundlePackageType.Msu);
+                            break;
                         case "Bundle":
                             bundle = this.Core.GetAttributeYesNoValue(sourceLineNumbers, attrib);
                             allowed = (packageType == WixBundlePackageType.Exe);
@@ -2490,6 +2505,7 @@ namespace WixToolset.Core
                 WixBundlePackageAttributes attributes = 0;
                 attributes |= (YesNoType.Yes == permanent) ? WixBundlePackageAttributes.Permanent : 0;
                 attributes |= (YesNoType.Yes == visible) ? WixBundlePackageAttributes.Visible : 0;
+                attributes |= (YesNoType.Yes == parallel) ? WixBundlePackageAttributes.Parallel : 0;
 
                 var chainPackageSymbol = this.Core.AddSymbol(new WixBundlePackageSymbol(sourceLineNumbers, id)
                 {
@@ -5,6 +5,7 @@ namespace WixToolsetTest.CoreIntegration
     using System;
     using System.Collections.Generic;
     using System.IO;
+    using System.Xml;
     using Example.Extension;
     using WixBuildTools.TestSupport;
     using WixToolset.Core.TestPackage;
@@ -278,6 +279,42 @@ namespace WixToolsetTest.CoreIntegration
             }
         }
 
+        [Fact]
+        public void PopulatesManifestWithProgressThrottle()
+        {
+            var folder = TestData.Get(@"TestData");
+
+            using (var fs = new DisposableFileSystem())
+            {
+                var baseFolder = fs.GetFolder();
+                var intermediateFolder = Path.Combine(baseFolder, "obj");
+                var bundlePath = Path.Combine(baseFolder, @"bin\test.exe");
+                var baFolderPath = Path.Combine(baseFolder, "ba");
+                var extractFolderPath = Path.Combine(baseFolder, "extract");
+
+                var result = WixRunner.Execute(new[]
+                {
+                    "build",
+                    Path.Combine(folder, "BundleWithPackageGroupRef", "MinimalPackageGroup.wxs"),
+                    Path.Combine(folder, "BundleProgressThrottle", "Bundle.wxs"),
+                    "-bindpath", Path.Combine(folder, "SimpleBundle", "data"),
+                    "-intermediateFolder", intermediateFolder,
+                    "-o", bundlePath
+                });
+
+                result.AssertSuccess();
+
+                Assert.True(File.Exists(bundlePath));
+
+                var extractResult = BundleExtractor.ExtractBAContainer(null, bundlePath, baFolderPath, extractFolderPath);
+                extractResult.AssertSuccess();
+
+                var uxElement = (XmlElement)extractResult.ManifestDocument.SelectSingleNode("/burn:BurnManifest/burn:UX", extractResult.ManifestNamespaceManager);
+                Assert.Equal("10", uxElement.GetAttribute("ProgressUpdatesPerSecond"));
+                Assert.Equal("2", uxElement.GetAttribute("ProgressPercentageStep"));
+            }
+        }
+
         [Fact]
         public void PopulatesManifestWithBundleExtensionSearches()
         {